@@ -0,0 +1,642 @@
+/* Copyright (c) 2016, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SCRNCAPT_USE_NEON 1
+#endif
+
+#include "nvscrncapt_utils.h"
+#include "nvscrncapt_convert.h"
+
+/** \hideinitializer \brief Max number of conversion threads */
+#define MAX_CONVERT_THREADS 16
+
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+
+typedef struct {
+    NvScrncaptWindowState *pWindow;
+    unsigned char *pDst;
+    /* Absolute source rows [y0, y1) handled by this band */
+    int y0;
+    int y1;
+    NvScrncaptStatus status;
+    pthread_t thread;
+} ConvertBand;
+
+/*
+ * Byte offset of (x, y) inside a GOB. A GOB is 64 bytes x 8 rows made of
+ * 16-byte x 2-row sectors, laid out as two 32-byte wide halves.
+ */
+static inline unsigned int
+GobOffset(
+    unsigned int x,
+    unsigned int y)
+{
+    return ((x >> 5) << 8) + ((y >> 1) << 6) + (((x >> 4) & 1) << 5) +
+           ((y & 1) << 4) + (x & 15);
+}
+
+/*
+ * Checks the GOB layout used by the tile walker against the library for
+ * the first two GOB rows and columns of a plane.
+ */
+static int
+VerifyGobLayout(
+    unsigned int stride,
+    unsigned int blockHeight)
+{
+    unsigned int x, y;
+    unsigned int base;
+
+    for (y = 0; y < 2 * GOB_HEIGHT_ROWS; y++) {
+        for (x = 0; x < MIN(stride, 2 * GOB_WIDTH_BYTES); x++) {
+            base = NvScrncaptGetBlocklinearOffset(x & ~(GOB_WIDTH_BYTES - 1),
+                    y & ~(GOB_HEIGHT_ROWS - 1), stride, blockHeight);
+            if (NvScrncaptGetBlocklinearOffset(x, y, stride, blockHeight) !=
+                base + GobOffset(x & (GOB_WIDTH_BYTES - 1),
+                                 y & (GOB_HEIGHT_ROWS - 1))) {
+                LOG_DBG("GOB layout mismatch at (%u, %u)\n", x, y);
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Copies bytes [xByte, xByte + numBytes) of rows [y, y + numRows) of a
+ * plane into pitch-linear rows of pDst. Block-linear planes are walked one
+ * GOB at a time so that the library is only queried for GOB base offsets.
+ */
+static void
+DeswizzleRows(
+    const unsigned char *pPlane,
+    unsigned int stride,
+    unsigned int blockHeight,
+    NvScrncaptSurfaceLayout layout,
+    int xByte,
+    int numBytes,
+    int y,
+    int numRows,
+    unsigned char *pDst,
+    int dstPitch)
+{
+    const unsigned char *pGob;
+    int gobX, gobY;
+    int row, rowStart, rowEnd;
+    int sx, lo, hi;
+    int r;
+
+    if (layout == NvScrncaptSurfaceLayout_PitchLinear) {
+        for (r = 0; r < numRows; r++)
+            memcpy(pDst + r * dstPitch,
+                   pPlane + (y + r) * stride + xByte, numBytes);
+        return;
+    }
+
+    for (gobY = y & ~(GOB_HEIGHT_ROWS - 1); gobY < y + numRows;
+         gobY += GOB_HEIGHT_ROWS) {
+        rowStart = MAX(y, gobY);
+        rowEnd = MIN(y + numRows, gobY + GOB_HEIGHT_ROWS);
+
+        for (gobX = xByte & ~(GOB_WIDTH_BYTES - 1); gobX < xByte + numBytes;
+             gobX += GOB_WIDTH_BYTES) {
+            pGob = pPlane + NvScrncaptGetBlocklinearOffset(gobX, gobY,
+                    stride, blockHeight);
+
+            for (row = rowStart; row < rowEnd; row++) {
+                /* Copy the 16-byte sectors overlapping the requested span */
+                for (sx = 0; sx < GOB_WIDTH_BYTES; sx += 16) {
+                    lo = MAX(gobX + sx, xByte);
+                    hi = MIN(gobX + sx + 16, xByte + numBytes);
+                    if (lo >= hi)
+                        continue;
+                    memcpy(pDst + (row - y) * dstPitch + (lo - xByte),
+                           pGob + GobOffset(sx, row - gobY) + (lo - gobX - sx),
+                           hi - lo);
+                }
+            }
+        }
+    }
+}
+
+/* Packs a row of 32-bit RGBA/BGRA pixels into RGB24 */
+static void
+ConvertRowRGBA(
+    const unsigned char *pSrc,
+    unsigned char *pDst,
+    int width,
+    int swapRB)
+{
+    int j = 0;
+
+#ifdef SCRNCAPT_USE_NEON
+    uint8x16x4_t rgba;
+    uint8x16x3_t rgb;
+
+    for (; j + 16 <= width; j += 16) {
+        rgba = vld4q_u8(pSrc + j * 4);
+        rgb.val[0] = swapRB ? rgba.val[2] : rgba.val[0];
+        rgb.val[1] = rgba.val[1];
+        rgb.val[2] = swapRB ? rgba.val[0] : rgba.val[2];
+        vst3q_u8(pDst + j * 3, rgb);
+    }
+#endif
+
+    for (; j < width; j++) {
+        pDst[j * 3 + 0] = pSrc[j * 4 + (swapRB ? 2 : 0)];
+        pDst[j * 3 + 1] = pSrc[j * 4 + 1];
+        pDst[j * 3 + 2] = pSrc[j * 4 + (swapRB ? 0 : 2)];
+    }
+}
+
+/*
+ * Converts a row of YCbCr420SP to RGB24, bit-exact with ConvertYUVToRGB.
+ * chromaPhase is 1 when the row starts on an odd pixel,
+ * i.e. in the middle of a chroma pair.
+ */
+static void
+ConvertRowYUV420SP(
+    const unsigned char *pY,
+    const unsigned char *pUV,
+    unsigned char *pDst,
+    int width,
+    int chromaPhase)
+{
+    int j = 0;
+    int c;
+    unsigned char y;
+    signed char u, v;
+
+#ifdef SCRNCAPT_USE_NEON
+    if (!chromaPhase) {
+        const uint8x8_t bias = vdup_n_u8(0x80);
+        int16x8_t y16[2], u16[2], v16[2];
+        int16x8_t uc, vc;
+        int16x8x2_t uz, vz;
+        uint8x16_t yv;
+        uint8x8x2_t uv;
+        uint8x8_t r8[2], g8[2], b8[2];
+        uint8x16x3_t rgb;
+        int h;
+
+        for (; j + 16 <= width; j += 16) {
+            yv = vld1q_u8(pY + j);
+            uv = vld2_u8(pUV + j);
+
+            /* Same wrap-around as "(signed char)u - 128" */
+            uc = vmovl_s8(vreinterpret_s8_u8(veor_u8(uv.val[0], bias)));
+            vc = vmovl_s8(vreinterpret_s8_u8(veor_u8(uv.val[1], bias)));
+            uz = vzipq_s16(uc, uc);
+            vz = vzipq_s16(vc, vc);
+
+            y16[0] = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(yv)));
+            y16[1] = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(yv)));
+            u16[0] = uz.val[0];
+            u16[1] = uz.val[1];
+            v16[0] = vz.val[0];
+            v16[1] = vz.val[1];
+
+            for (h = 0; h < 2; h++) {
+                int16x8_t r, g, b;
+
+                r = vaddq_s16(y16[h], v16[h]);
+                r = vaddq_s16(r, vshrq_n_s16(v16[h], 2));
+                r = vaddq_s16(r, vshrq_n_s16(v16[h], 3));
+                r = vaddq_s16(r, vshrq_n_s16(v16[h], 5));
+
+                g = vsubq_s16(y16[h], vaddq_s16(vaddq_s16(
+                        vshrq_n_s16(u16[h], 2), vshrq_n_s16(u16[h], 4)),
+                        vshrq_n_s16(u16[h], 5)));
+                g = vsubq_s16(g, vaddq_s16(vaddq_s16(
+                        vshrq_n_s16(v16[h], 1), vshrq_n_s16(v16[h], 3)),
+                        vaddq_s16(vshrq_n_s16(v16[h], 4),
+                                  vshrq_n_s16(v16[h], 5))));
+
+                b = vaddq_s16(y16[h], u16[h]);
+                b = vaddq_s16(b, vshrq_n_s16(u16[h], 1));
+                b = vaddq_s16(b, vshrq_n_s16(u16[h], 2));
+                b = vaddq_s16(b, vshrq_n_s16(u16[h], 6));
+
+                /* Narrowing truncates, like the unsigned char stores */
+                r8[h] = vmovn_u16(vreinterpretq_u16_s16(r));
+                g8[h] = vmovn_u16(vreinterpretq_u16_s16(g));
+                b8[h] = vmovn_u16(vreinterpretq_u16_s16(b));
+            }
+            rgb.val[0] = vcombine_u8(r8[0], r8[1]);
+            rgb.val[1] = vcombine_u8(g8[0], g8[1]);
+            rgb.val[2] = vcombine_u8(b8[0], b8[1]);
+            vst3q_u8(pDst + j * 3, rgb);
+        }
+    }
+#endif
+
+    for (; j < width; j++) {
+        c = (j + chromaPhase) >> 1;
+        y = pY[j];
+        u = (signed char)pUV[c * 2] - 128;
+        v = (signed char)pUV[c * 2 + 1] - 128;
+
+        pDst[j * 3 + 0] = y + v + (v >> 2) + (v >> 3) + (v >> 5);
+        pDst[j * 3 + 1] = y - ((u >> 2) + (u >> 4) + (u >> 5)) - ((v >> 1) +
+                (v >> 3) + (v >> 4) + (v >> 5));
+        pDst[j * 3 + 2] = y + u + (u >> 1) + (u >> 2) + (u >> 6);
+    }
+}
+
+/* Reverses the pixel order of an RGB24 row, for horizontally inverted windows */
+static void
+MirrorRowRGB24(
+    unsigned char *pRow,
+    int width)
+{
+    unsigned char tmp[3];
+    int j;
+
+    for (j = 0; j < width / 2; j++) {
+        memcpy(tmp, pRow + j * 3, 3);
+        memcpy(pRow + j * 3, pRow + (width - j - 1) * 3, 3);
+        memcpy(pRow + (width - j - 1) * 3, tmp, 3);
+    }
+}
+
+static NvScrncaptStatus
+ConvertBandRGB24(
+    ConvertBand *pBand)
+{
+    NvScrncaptWindowState *pWindow = pBand->pWindow;
+    NvScrncaptSurfaceMap *pMap = &pWindow->surfaceMap;
+    int width = pWindow->fbAperture.width;
+    int height = pWindow->fbAperture.height;
+    int startX = pWindow->fbAperture.startX;
+    int startY = pWindow->fbAperture.startY;
+    int isYUV = (pMap->pixelFormat == NvScrncaptColorFormat_YCbCr420SP);
+    unsigned char *pScratch, *pChroma = NULL;
+    unsigned char *pOut;
+    int lumaPitch, chromaPitch = 0, chromaX = 0;
+    int y, yEnd, row, outRow;
+
+    /* One GOB row of de-swizzled source, plus the matching chroma rows */
+    lumaPitch = isYUV ? width : width * 4;
+    if (isYUV) {
+        chromaX = (startX >> 1) * 2;
+        chromaPitch = ((startX + width - 1) >> 1) * 2 + 2 - chromaX;
+    }
+    pScratch = malloc(GOB_HEIGHT_ROWS * lumaPitch +
+                      (GOB_HEIGHT_ROWS / 2 + 1) * chromaPitch);
+    if (!pScratch)
+        return NVSCRNCAPT_STATUS_OUT_OF_MEMORY;
+    if (isYUV)
+        pChroma = pScratch + GOB_HEIGHT_ROWS * lumaPitch;
+
+    for (y = pBand->y0; y < pBand->y1; y = yEnd) {
+        yEnd = MIN((y & ~(GOB_HEIGHT_ROWS - 1)) + GOB_HEIGHT_ROWS, pBand->y1);
+
+        if (isYUV) {
+            DeswizzleRows(pMap->pY, pMap->strideY, pMap->blockHeight,
+                    pMap->surfaceLayout, startX, width,
+                    y, yEnd - y, pScratch, lumaPitch);
+            DeswizzleRows(pMap->pU, pMap->strideUV, pMap->blockHeight,
+                    pMap->surfaceLayout, chromaX, chromaPitch,
+                    y >> 1, ((yEnd - 1) >> 1) - (y >> 1) + 1,
+                    pChroma, chromaPitch);
+        } else {
+            DeswizzleRows(pMap->pRGB, pMap->strideRGB, pMap->blockHeight,
+                    pMap->surfaceLayout, startX * 4, width * 4,
+                    y, yEnd - y, pScratch, lumaPitch);
+        }
+
+        for (row = y; row < yEnd; row++) {
+            outRow = row - startY;
+            if (pWindow->invertV)
+                outRow = height - outRow - 1;
+            pOut = pBand->pDst + (size_t)outRow * width * 3;
+
+            if (isYUV)
+                ConvertRowYUV420SP(pScratch + (row - y) * lumaPitch,
+                        pChroma + ((row >> 1) - (y >> 1)) * chromaPitch,
+                        pOut, width, startX & 1);
+            else
+                ConvertRowRGBA(pScratch + (row - y) * lumaPitch, pOut, width,
+                        pMap->pixelFormat == NvScrncaptColorFormat_B8G8R8A8);
+
+            if (pWindow->invertH)
+                MirrorRowRGB24(pOut, width);
+        }
+    }
+
+    free(pScratch);
+    return NVSCRNCAPT_STATUS_OK;
+}
+
+static void *
+ConvertBandThread(
+    void *pArg)
+{
+    ConvertBand *pBand = (ConvertBand *)pArg;
+
+    pBand->status = ConvertBandRGB24(pBand);
+    return NULL;
+}
+
+static void
+ConvertYUVToRGB(
+    const NvScrncaptPixel *pYUV,
+    NvScrncaptPixel *pRGB)
+{
+    unsigned char y;
+    signed char u, v;
+
+    y = pYUV->y;
+    u = (signed char)pYUV->u - 128;
+    v = (signed char)pYUV->v - 128;
+
+    pRGB->r = y + v + (v >> 2) + (v >> 3) + (v >> 5);
+    pRGB->g = y - ((u >> 2) + (u >> 4) + (u >> 5)) - ((v >> 1) +
+            (v >> 3) + (v >> 4) + (v >> 5));
+    pRGB->b = y + u + (u >> 1) + (u >> 2) + (u >> 6);
+    pRGB->alpha = pYUV->alpha;
+}
+
+static void
+GetPixelRGB(
+    NvScrncaptSurfaceMap *pSurfaceMap,
+    NvScrncaptPixel *pPixel,
+    int x,
+    int y) {
+
+    /* bps = bytes per sample (in each plane) */
+    int bpsRGB;
+    unsigned char *pRGB = pSurfaceMap->pRGB;;
+
+    switch (pSurfaceMap->pixelFormat) {
+        /* Add additional pixel formats here */
+        case NvScrncaptColorFormat_B8G8R8A8:
+        case NvScrncaptColorFormat_R8G8B8A8:
+            bpsRGB = 4;
+            break;
+        default:
+            LOG_WARN("Unsupported pixel format (%d)\n",
+                    pSurfaceMap->pixelFormat);
+            return;
+    }
+
+    switch (pSurfaceMap->surfaceLayout) {
+        case NvScrncaptSurfaceLayout_PitchLinear:
+            pRGB += (y * pSurfaceMap->strideRGB) + (x * bpsRGB);
+            break;
+        case NvScrncaptSurfaceLayout_BlockLinear:
+            pRGB += NvScrncaptGetBlocklinearOffset(x * bpsRGB, y,
+                    pSurfaceMap->strideRGB, pSurfaceMap->blockHeight);
+            break;
+        default:
+            LOG_WARN("Unsupported surface format (%d)\n",
+                    pSurfaceMap->surfaceLayout);
+            return;
+    }
+
+    switch (pSurfaceMap->pixelFormat) {
+        /* Add additional pixel formats here */
+        case NvScrncaptColorFormat_B8G8R8A8:
+            pPixel->r = pRGB[2];
+            pPixel->g = pRGB[1];
+            pPixel->b = pRGB[0];
+            pPixel->alpha = pRGB[3];
+            break;
+        case NvScrncaptColorFormat_R8G8B8A8:
+            pPixel->r = pRGB[0];
+            pPixel->g = pRGB[1];
+            pPixel->b = pRGB[2];
+            pPixel->alpha = pRGB[3];
+            break;
+        default:
+            LOG_WARN("Unsupported pixel format (%d)\n",
+                    pSurfaceMap->pixelFormat);
+            return;
+    }
+}
+
+static void
+GetPixelYUV(
+    NvScrncaptSurfaceMap *pSurfaceMap,
+    NvScrncaptPixel *pPixel,
+    int x,
+    int y) {
+
+    /* bps = bytes per sample (in each plane) */
+    int bpsY, bpsU, bpsV;
+    int xU = 0, xV = 0, yU = 0, yV = 0;
+    unsigned char *pY = pSurfaceMap->pY;
+    unsigned char *pU = pSurfaceMap->pU;
+    unsigned char *pV = pSurfaceMap->pV;
+
+    switch (pSurfaceMap->pixelFormat) {
+        /* Add additional pixel formats here */
+        case NvScrncaptColorFormat_YCbCr420SP:
+            bpsY = 1;
+            bpsU = 2;
+            bpsV = 0;
+            /*
+             * YUV420 is subsample by factor of 2
+             * for both U & V chroma
+             */
+            xU = x >> 1;
+            yU = y >> 1;
+            break;
+        default:
+            LOG_WARN("Unsupported pixel format (%d)\n",
+                    pSurfaceMap->pixelFormat);
+            return;
+    }
+
+    switch (pSurfaceMap->surfaceLayout) {
+        case NvScrncaptSurfaceLayout_PitchLinear:
+            pY += (y * pSurfaceMap->strideY) + (x * bpsY);
+            pU += (yU * pSurfaceMap->strideUV) + (xU * bpsU);
+            pV += (yV * pSurfaceMap->strideUV) + (xV * bpsV);
+            break;
+        case NvScrncaptSurfaceLayout_BlockLinear:
+            pY += NvScrncaptGetBlocklinearOffset(x * bpsY, y,
+                    pSurfaceMap->strideY, pSurfaceMap->blockHeight);
+            pU += NvScrncaptGetBlocklinearOffset(xU * bpsU, yU,
+                    pSurfaceMap->strideUV, pSurfaceMap->blockHeight);
+            pV += NvScrncaptGetBlocklinearOffset(xV * bpsV, yV,
+                    pSurfaceMap->strideUV, pSurfaceMap->blockHeight);
+            break;
+        default:
+            LOG_ERR("Unsupported surface format (%d)\n",
+                    pSurfaceMap->surfaceLayout);
+            return;
+    }
+
+    switch (pSurfaceMap->pixelFormat) {
+        /* Add additional pixel formats here */
+        case NvScrncaptColorFormat_YCbCr420SP:
+            pPixel->y = pY[0];
+            pPixel->u = pU[0];
+            pPixel->v = pU[1];
+            pPixel->alpha = ~0;
+            break;
+        default:
+            LOG_WARN("Unsupported pixel format (%d)\n",
+                    pSurfaceMap->pixelFormat);
+            return;
+    }
+}
+
+static void
+GetPixel(
+    NvScrncaptSurfaceMap *pSurfaceMap,
+    NvScrncaptPixel* pPixel,
+    int x,
+    int y) {
+
+    NvScrncaptPixel yuvPixel = {{0}};
+
+    switch (pSurfaceMap->pixelFormat) {
+        /* Add additional pixel formats here */
+        case NvScrncaptColorFormat_YCbCr420SP:
+            GetPixelYUV(pSurfaceMap, &yuvPixel, x, y);
+            ConvertYUVToRGB(&yuvPixel, pPixel);
+            break;
+        case NvScrncaptColorFormat_B8G8R8A8:
+        case NvScrncaptColorFormat_R8G8B8A8:
+            GetPixelRGB(pSurfaceMap, pPixel, x, y);
+            break;
+        default:
+            LOG_WARN("Unsupported pixel format (%d)\n",
+                    pSurfaceMap->pixelFormat);
+    }
+}
+
+void
+ConvertWindowRGB24PerPixel (
+    NvScrncaptWindowState *pWindow,
+    unsigned char *pDst)
+{
+    unsigned char *pLine;
+    NvScrncaptPixel rgbPixel = {{0}};
+    int fbWidth = pWindow->fbAperture.width;
+    int fbHeight = pWindow->fbAperture.height;
+    int i, j;
+    int x, y;
+
+    for (i = 0; i < fbHeight; i++) {
+
+        pLine = pDst + (size_t)3 * fbWidth * i;
+
+        for (j = 0; j < fbWidth; j++) {
+
+            /* Check for surface inversion */
+            x = pWindow->invertH ? (fbWidth - j - 1) : j;
+            y = pWindow->invertV ? (fbHeight - i - 1) : i;
+
+            /* Account for aperture offset */
+            x += pWindow->fbAperture.startX;
+            y += pWindow->fbAperture.startY;
+
+            /* Get the RGB pixel for this coordinate */
+            GetPixel(&pWindow->surfaceMap, &rgbPixel, x, y);
+
+            *pLine++ = rgbPixel.r;
+            *pLine++ = rgbPixel.g;
+            *pLine++ = rgbPixel.b;
+        }
+    }
+}
+
+int
+CanConvertWindowRGB24 (
+    NvScrncaptWindowState *pWindow)
+{
+    NvScrncaptSurfaceMap *pMap = &pWindow->surfaceMap;
+
+    if (pWindow->fbAperture.width <= 0 || pWindow->fbAperture.height <= 0)
+        return 0;
+
+    if (pMap->surfaceLayout != NvScrncaptSurfaceLayout_PitchLinear &&
+        pMap->surfaceLayout != NvScrncaptSurfaceLayout_BlockLinear)
+        return 0;
+
+    switch (pMap->pixelFormat) {
+        case NvScrncaptColorFormat_B8G8R8A8:
+        case NvScrncaptColorFormat_R8G8B8A8:
+            if (pMap->surfaceLayout == NvScrncaptSurfaceLayout_BlockLinear)
+                return VerifyGobLayout(pMap->strideRGB, pMap->blockHeight);
+            return 1;
+        case NvScrncaptColorFormat_YCbCr420SP:
+            if (pMap->surfaceLayout == NvScrncaptSurfaceLayout_BlockLinear)
+                return VerifyGobLayout(pMap->strideY, pMap->blockHeight) &&
+                       VerifyGobLayout(pMap->strideUV, pMap->blockHeight);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+NvScrncaptStatus
+ConvertWindowRGB24 (
+    NvScrncaptWindowState *pWindow,
+    unsigned char *pDst,
+    int numThreads)
+{
+    ConvertBand bands[MAX_CONVERT_THREADS];
+    NvScrncaptStatus status = NVSCRNCAPT_STATUS_OK;
+    int startY = pWindow->fbAperture.startY;
+    int endY = startY + pWindow->fbAperture.height;
+    int firstGob, numGobRows;
+    int started[MAX_CONVERT_THREADS];
+    int i;
+
+    /* Bands are split on GOB row boundaries so no GOB is walked twice */
+    firstGob = startY / GOB_HEIGHT_ROWS;
+    numGobRows = (endY - 1) / GOB_HEIGHT_ROWS - firstGob + 1;
+    numThreads = MAX(1, MIN(MIN(numThreads, MAX_CONVERT_THREADS), numGobRows));
+
+    for (i = 0; i < numThreads; i++) {
+        bands[i].pWindow = pWindow;
+        bands[i].pDst = pDst;
+        bands[i].y0 = MAX(startY,
+                (firstGob + numGobRows * i / numThreads) * GOB_HEIGHT_ROWS);
+        bands[i].y1 = MIN(endY,
+                (firstGob + numGobRows * (i + 1) / numThreads) * GOB_HEIGHT_ROWS);
+        bands[i].status = NVSCRNCAPT_STATUS_OK;
+        started[i] = 0;
+    }
+
+    /* Band 0 runs on the calling thread, or any band a thread failed for */
+    for (i = 1; i < numThreads; i++) {
+        if (pthread_create(&bands[i].thread, NULL, ConvertBandThread,
+                           &bands[i]) == 0)
+            started[i] = 1;
+        else
+            LOG_WARN("Failed to create conversion thread %d\n", i);
+    }
+
+    for (i = 0; i < numThreads; i++) {
+        if (!started[i])
+            bands[i].status = ConvertBandRGB24(&bands[i]);
+    }
+
+    for (i = 0; i < numThreads; i++) {
+        if (started[i])
+            pthread_join(bands[i].thread, NULL);
+        if (bands[i].status != NVSCRNCAPT_STATUS_OK)
+            status = bands[i].status;
+    }
+
+    return status;
+}
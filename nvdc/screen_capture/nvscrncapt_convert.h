@@ -0,0 +1,78 @@
+/* Copyright (c) 2016, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#ifndef _NVSCRNCAPT_CONVERT_H_
+#define _NVSCRNCAPT_CONVERT_H_
+
+#include <nvscrncapt.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \hideinitializer \brief Width of a GOB in bytes */
+#define GOB_WIDTH_BYTES 64
+
+/** \hideinitializer \brief Height of a GOB in rows */
+#define GOB_HEIGHT_ROWS 8
+
+/**
+ * \brief Checks whether a window can be converted by ConvertWindowRGB24
+ *
+ * Only the pixel formats and layouts handled by the row converters are
+ * accepted. For block-linear surfaces, the GOB layout assumed by the tile
+ * walker is also checked against NvScrncaptGetBlocklinearOffset.
+ *
+ * \param[in] pWindow Captured window
+ * \return 1 if the window can be converted, 0 otherwise
+ */
+int
+CanConvertWindowRGB24 (
+    NvScrncaptWindowState *pWindow);
+
+/**
+ * \brief Converts a captured window into a packed RGB24 image
+ *
+ * Block-linear planes are de-swizzled one GOB row at a time into
+ * pitch-linear scratch rows, which are then converted to RGB24.
+ * Inversion and the framebuffer aperture are applied as in the per-pixel
+ * path. The image is split in bands of GOB rows across numThreads threads.
+ *
+ * \param[in]  pWindow    Captured window
+ * \param[out] pDst       Destination, width * height * 3 bytes
+ * \param[in]  numThreads Number of conversion threads (1 = no threads)
+ * \return NVSCRNCAPT_STATUS_OK on success
+ */
+NvScrncaptStatus
+ConvertWindowRGB24 (
+    NvScrncaptWindowState *pWindow,
+    unsigned char *pDst,
+    int numThreads);
+
+/**
+ * \brief Converts a captured window into a packed RGB24 image, one pixel
+ * at a time
+ *
+ * Reference path for any surface layout and pixel format: every pixel is
+ * located with NvScrncaptGetBlocklinearOffset (block-linear) or the
+ * stride (pitch-linear). Pixels of unsupported formats are not converted.
+ *
+ * \param[in]  pWindow Captured window
+ * \param[out] pDst    Destination, width * height * 3 bytes
+ */
+void
+ConvertWindowRGB24PerPixel (
+    NvScrncaptWindowState *pWindow,
+    unsigned char *pDst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* _NVSCRNCAPT_CONVERT_H_ */
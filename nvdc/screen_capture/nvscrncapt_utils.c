@@ -28,6 +28,7 @@ PrintUsage ()
     LOG_MSG("-t                      Timestamp the RGB capture file.\n");
     LOG_MSG("-m [head-mask]          Mask of heads for screen capture in decimal\n");
     LOG_MSG("-alloc                  Test app will pre-allocate memory\n");
+    LOG_MSG("-j [threads]            Number of threads converting to RGB. Default = 1\n");
 }
 
 int
@@ -44,6 +45,8 @@ ParseArgs (
     // Initialize default args
     args->headMask = ~0;
     args->logLevel = LEVEL_WARN;
+    args->preAllocateMemory = 0;
+    args->numThreads = 1;
     snprintf(args->filePrefix, MAX_STRING_SIZE, "scrncap");
 
     // First look for help request
@@ -96,6 +99,16 @@ ParseArgs (
                 }
             } else if(!strcasecmp(argv[i], "-alloc")) {
                 args->preAllocateMemory = 1;
+            } else if(!strcasecmp(argv[i], "-j")) {
+                if(bDataAvailable) {
+                    args->numThreads = atoi(argv[++i]);
+                    if (args->numThreads < 1) {
+                        printf("Invalid number of threads chosen (%d)\n",
+                               args->numThreads);
+                        printf("Setting number of threads to 1\n");
+                        args->numThreads = 1;
+                    }
+                }
             } else {
                 LOG_ERR("Unsupported option encountered: %s\n", argv[i]);
                 return -1;
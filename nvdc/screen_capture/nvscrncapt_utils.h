@@ -64,6 +64,8 @@ typedef struct {
     unsigned int headMask;
     /* Indicates if app shall pre-allocate memory */
     int preAllocateMemory;
+    /* Number of threads converting each window to RGB */
+    int numThreads;
 } TestArgs;
 
 int
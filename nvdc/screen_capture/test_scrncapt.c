@@ -17,6 +17,7 @@
 #include <nvscrncapt.h>
 
 #include "nvscrncapt_utils.h"
+#include "nvscrncapt_convert.h"
 
 /** Current Log Verbosity Level */
 int currentLogLevel = 0;
@@ -85,187 +86,16 @@ ShowCaptureSummary(
     LOG_INFO("End Capture Summary\n");
 }
 
-static void
-ConvertYUVToRGB(
-    const NvScrncaptPixel *pYUV,
-    NvScrncaptPixel *pRGB)
-{
-    unsigned char y;
-    signed char u, v;
-
-    y = pYUV->y;
-    u = (signed char)pYUV->u - 128;
-    v = (signed char)pYUV->v - 128;
-
-    pRGB->r = y + v + (v >> 2) + (v >> 3) + (v >> 5);
-    pRGB->g = y - ((u >> 2) + (u >> 4) + (u >> 5)) - ((v >> 1) +
-            (v >> 3) + (v >> 4) + (v >> 5));
-    pRGB->b = y + u + (u >> 1) + (u >> 2) + (u >> 6);
-    pRGB->alpha = pYUV->alpha;
-}
-
-static void
-GetPixelRGB(
-    NvScrncaptSurfaceMap *pSurfaceMap,
-    NvScrncaptPixel *pPixel,
-    int x,
-    int y) {
-
-    /* bps = bytes per sample (in each plane) */
-    int bpsRGB;
-    unsigned char *pRGB = pSurfaceMap->pRGB;;
-
-    switch (pSurfaceMap->pixelFormat) {
-        /* Add additional pixel formats here */
-        case NvScrncaptColorFormat_B8G8R8A8:
-        case NvScrncaptColorFormat_R8G8B8A8:
-            bpsRGB = 4;
-            break;
-        default:
-            LOG_WARN("Unsupported pixel format (%d)\n",
-                    pSurfaceMap->pixelFormat);
-            return;
-    }
-
-    switch (pSurfaceMap->surfaceLayout) {
-        case NvScrncaptSurfaceLayout_PitchLinear:
-            pRGB += (y * pSurfaceMap->strideRGB) + (x * bpsRGB);
-            break;
-        case NvScrncaptSurfaceLayout_BlockLinear:
-            pRGB += NvScrncaptGetBlocklinearOffset(x * bpsRGB, y,
-                    pSurfaceMap->strideRGB, pSurfaceMap->blockHeight);
-            break;
-        default:
-            LOG_WARN("Unsupported surface format (%d)\n",
-                    pSurfaceMap->surfaceLayout);
-            return;
-    }
-
-    switch (pSurfaceMap->pixelFormat) {
-        /* Add additional pixel formats here */
-        case NvScrncaptColorFormat_B8G8R8A8:
-            pPixel->r = pRGB[2];
-            pPixel->g = pRGB[1];
-            pPixel->b = pRGB[0];
-            pPixel->alpha = pRGB[3];
-            break;
-        case NvScrncaptColorFormat_R8G8B8A8:
-            pPixel->r = pRGB[0];
-            pPixel->g = pRGB[1];
-            pPixel->b = pRGB[2];
-            pPixel->alpha = pRGB[3];
-            break;
-        default:
-            LOG_WARN("Unsupported pixel format (%d)\n",
-                    pSurfaceMap->pixelFormat);
-            return;
-    }
-}
-
-static void
-GetPixelYUV(
-    NvScrncaptSurfaceMap *pSurfaceMap,
-    NvScrncaptPixel *pPixel,
-    int x,
-    int y) {
-
-    /* bps = bytes per sample (in each plane) */
-    int bpsY, bpsU, bpsV;
-    int xU = 0, xV = 0, yU = 0, yV = 0;
-    unsigned char *pY = pSurfaceMap->pY;
-    unsigned char *pU = pSurfaceMap->pU;
-    unsigned char *pV = pSurfaceMap->pV;
-
-    switch (pSurfaceMap->pixelFormat) {
-        /* Add additional pixel formats here */
-        case NvScrncaptColorFormat_YCbCr420SP:
-            bpsY = 1;
-            bpsU = 2;
-            bpsV = 0;
-            /*
-             * YUV420 is subsample by factor of 2
-             * for both U & V chroma
-             */
-            xU = x >> 1;
-            yU = y >> 1;
-            break;
-        default:
-            LOG_WARN("Unsupported pixel format (%d)\n",
-                    pSurfaceMap->pixelFormat);
-            return;
-    }
-
-    switch (pSurfaceMap->surfaceLayout) {
-        case NvScrncaptSurfaceLayout_PitchLinear:
-            pY += (y * pSurfaceMap->strideY) + (x * bpsY);
-            pU += (yU * pSurfaceMap->strideUV) + (xU * bpsU);
-            pV += (yV * pSurfaceMap->strideUV) + (xV * bpsV);
-            break;
-        case NvScrncaptSurfaceLayout_BlockLinear:
-            pY += NvScrncaptGetBlocklinearOffset(x * bpsY, y,
-                    pSurfaceMap->strideY, pSurfaceMap->blockHeight);
-            pU += NvScrncaptGetBlocklinearOffset(xU * bpsU, yU,
-                    pSurfaceMap->strideUV, pSurfaceMap->blockHeight);
-            pV += NvScrncaptGetBlocklinearOffset(xV * bpsV, yV,
-                    pSurfaceMap->strideUV, pSurfaceMap->blockHeight);
-            break;
-        default:
-            LOG_ERR("Unsupported surface format (%d)\n",
-                    pSurfaceMap->surfaceLayout);
-            return;
-    }
-
-    switch (pSurfaceMap->pixelFormat) {
-        /* Add additional pixel formats here */
-        case NvScrncaptColorFormat_YCbCr420SP:
-            pPixel->y = pY[0];
-            pPixel->u = pU[0];
-            pPixel->v = pU[1];
-            pPixel->alpha = ~0;
-            break;
-        default:
-            LOG_WARN("Unsupported pixel format (%d)\n",
-                    pSurfaceMap->pixelFormat);
-            return;
-    }
-}
-
-static void
-GetPixel(
-    NvScrncaptSurfaceMap *pSurfaceMap,
-    NvScrncaptPixel* pPixel,
-    int x,
-    int y) {
-
-    NvScrncaptPixel yuvPixel = {{0}};
-
-    switch (pSurfaceMap->pixelFormat) {
-        /* Add additional pixel formats here */
-        case NvScrncaptColorFormat_YCbCr420SP:
-            GetPixelYUV(pSurfaceMap, &yuvPixel, x, y);
-            ConvertYUVToRGB(&yuvPixel, pPixel);
-            break;
-        case NvScrncaptColorFormat_B8G8R8A8:
-        case NvScrncaptColorFormat_R8G8B8A8:
-            GetPixelRGB(pSurfaceMap, pPixel, x, y);
-            break;
-        default:
-            LOG_WARN("Unsupported pixel format (%d)\n",
-                    pSurfaceMap->pixelFormat);
-    }
-}
-
 static NvScrncaptStatus
 SaveWindowRGB(
     NvScrncaptWindowState *pWindow,
-    FILE *pCaptureFile) {
+    FILE *pCaptureFile,
+    int numThreads) {
 
-    unsigned char *pLineBuffer = NULL;
-    int lineBufferIdx = 0;
-    NvScrncaptPixel rgbPixel = {{0}};
+    unsigned char *pImageBuffer = NULL;
+    NvScrncaptStatus status = NVSCRNCAPT_STATUS_OK;
+    size_t imageSize;
     int fbWidth, fbHeight;
-    int i, j;
-    int x, y;
 
     fbWidth = pWindow->fbAperture.width;
     fbHeight = pWindow->fbAperture.height;
@@ -275,49 +105,40 @@ SaveWindowRGB(
             fbWidth,
             fbHeight);
 
-    /* Allocate 3x width for R/G/B planes */
-    pLineBuffer = malloc(3 * fbWidth);
-    if (!pLineBuffer) {
+    /* Whole RGB24 image, written out with a single fwrite */
+    imageSize = (size_t)3 * fbWidth * fbHeight;
+    if (!imageSize) {
+        return NVSCRNCAPT_STATUS_OK;
+    }
+    pImageBuffer = malloc(imageSize);
+    if (!pImageBuffer) {
         return NVSCRNCAPT_STATUS_OUT_OF_MEMORY;
     }
 
-    for (i = 0; i < fbHeight; i++) {
-
-        lineBufferIdx = 0;
-
-        for (j = 0; j < fbWidth; j++) {
-
-            /* Check for surface inversion */
-            x = pWindow->invertH ? (fbWidth - j - 1) : j;
-            y = pWindow->invertV ? (fbHeight - i - 1) : i;
-
-            /* Account for aperture offset */
-            x += pWindow->fbAperture.startX;
-            y += pWindow->fbAperture.startY;
-
-            /* Get the RGB pixel for this coordinate */
-            GetPixel(&pWindow->surfaceMap, &rgbPixel, x, y);
-
-            pLineBuffer[lineBufferIdx++] = rgbPixel.r;
-            pLineBuffer[lineBufferIdx++] = rgbPixel.g;
-            pLineBuffer[lineBufferIdx++] = rgbPixel.b;
-
-        }
+    if (CanConvertWindowRGB24(pWindow)) {
+        status = ConvertWindowRGB24(pWindow, pImageBuffer, numThreads);
+    } else {
+        LOG_DBG("Using per-pixel conversion for window %d\n",
+                pWindow->windowIdx);
+        ConvertWindowRGB24PerPixel(pWindow, pImageBuffer);
+    }
 
-        if (!fwrite(pLineBuffer, lineBufferIdx, 1, pCaptureFile)) {
-            LOG_ERR("Failed to write linebuffer to capture file - (%d)\n",
-                    errno);
-            return NVSCRNCAPT_STATUS_ERROR;
-        }
+    if (status == NVSCRNCAPT_STATUS_OK &&
+        !fwrite(pImageBuffer, imageSize, 1, pCaptureFile)) {
+        LOG_ERR("Failed to write image to capture file - (%d)\n",
+                errno);
+        status = NVSCRNCAPT_STATUS_ERROR;
     }
 
-    return NVSCRNCAPT_STATUS_OK;
+    free(pImageBuffer);
+    return status;
 }
 
 static NvScrncaptStatus
 SaveCaptureRGB(
     NvScrncaptResult *pCaptureResult,
-    char *filePrefix)
+    char *filePrefix,
+    int numThreads)
 {
     int i, j;
     char fileName[MAX_STRING_SIZE];
@@ -359,7 +180,7 @@ SaveCaptureRGB(
                     fileName);
 
             gettimeofday(&tm_from, NULL);
-            status = SaveWindowRGB(pWindow, pCaptureFile);
+            status = SaveWindowRGB(pWindow, pCaptureFile, numThreads);
             fclose(pCaptureFile);
             gettimeofday(&tm_to, NULL);
             pCaptureFile = NULL;
@@ -424,7 +245,8 @@ int main(int argc, char *argv[])
     ShowCaptureSummary(pCaptureResult);
 
     /* Save capture to RGB file */
-    status = SaveCaptureRGB(pCaptureResult, testArgs.filePrefix);
+    status = SaveCaptureRGB(pCaptureResult, testArgs.filePrefix,
+            testArgs.numThreads);
 
     /* Cleanup */
     status = NvScrncaptCleanup(pCaptureResult);
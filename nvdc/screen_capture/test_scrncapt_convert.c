@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2016 NVIDIA Corporation.  All Rights Reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * Checks ConvertWindowRGB24 against the per-pixel path on synthetic
+ * surfaces, and measures both in megapixels per second.
+ *
+ * Surfaces are filled with random bytes and read back through
+ * NvScrncaptGetBlocklinearOffset by the per-pixel path, so the check does
+ * not depend on how the test lays out the data. Every block height, pixel
+ * format and layout is covered, with apertures whose width and offset are
+ * not multiples of the GOB width, inversion and several thread counts.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <nvscrncapt.h>
+
+#include "nvscrncapt_utils.h"
+#include "nvscrncapt_convert.h"
+
+/** \hideinitializer \brief Block heights tried, log2 of GOBs per block */
+#define MAX_BLOCK_HEIGHT 5
+
+#define ALIGN(v, a) (((v) + (a) - 1) & ~((a) - 1))
+
+/** Current Log Verbosity Level */
+int currentLogLevel = 0;
+
+static int numFailures = 0;
+
+typedef struct {
+    NvScrncaptColorFormat format;
+    const char *name;
+} TestFormat;
+
+static const TestFormat formats[] = {
+    { NvScrncaptColorFormat_R8G8B8A8,   "R8G8B8A8" },
+    { NvScrncaptColorFormat_B8G8R8A8,   "B8G8R8A8" },
+    { NvScrncaptColorFormat_YCbCr420SP, "YCbCr420SP" },
+};
+
+static double
+GetTimeSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Size of a plane of width x height bytes, taken from the offsets the
+ * library returns so that any block-linear padding is covered.
+ */
+static unsigned int
+PlaneLength(
+    NvScrncaptSurfaceLayout layout,
+    unsigned int stride,
+    unsigned int blockHeight,
+    unsigned int width,
+    unsigned int height)
+{
+    unsigned int x, y, offset, length = 0;
+
+    if (layout == NvScrncaptSurfaceLayout_PitchLinear)
+        return stride * height;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            offset = NvScrncaptGetBlocklinearOffset(x, y, stride, blockHeight);
+            if (offset >= length)
+                length = offset + 1;
+        }
+    }
+
+    return length;
+}
+
+static unsigned char *
+AllocRandomPlane(
+    unsigned int length)
+{
+    unsigned char *pPlane = malloc(length);
+    unsigned int i;
+
+    if (!pPlane)
+        return NULL;
+    for (i = 0; i < length; i++)
+        pPlane[i] = rand();
+
+    return pPlane;
+}
+
+/*
+ * Builds a surface of surfWidth x surfHeight pixels. Rows are padded to a
+ * whole block so that the library offsets stay inside the plane.
+ */
+static int
+CreateSurface(
+    NvScrncaptSurfaceMap *pMap,
+    NvScrncaptColorFormat format,
+    NvScrncaptSurfaceLayout layout,
+    unsigned int blockHeight,
+    int surfWidth,
+    int surfHeight)
+{
+    unsigned int rows, chromaRows;
+
+    memset(pMap, 0, sizeof(*pMap));
+    pMap->pixelFormat = format;
+    pMap->surfaceLayout = layout;
+    pMap->blockHeight = blockHeight;
+
+    rows = ALIGN(surfHeight, GOB_HEIGHT_ROWS << blockHeight);
+    chromaRows = ALIGN((surfHeight + 1) / 2, GOB_HEIGHT_ROWS << blockHeight);
+
+    if (format == NvScrncaptColorFormat_YCbCr420SP) {
+        pMap->strideY = ALIGN(surfWidth, GOB_WIDTH_BYTES);
+        pMap->strideUV = ALIGN((surfWidth + 1) / 2 * 2, GOB_WIDTH_BYTES);
+        pMap->lengthY = PlaneLength(layout, pMap->strideY, blockHeight,
+                pMap->strideY, rows);
+        pMap->lengthU = PlaneLength(layout, pMap->strideUV, blockHeight,
+                pMap->strideUV, chromaRows);
+        pMap->pY = AllocRandomPlane(pMap->lengthY);
+        pMap->pU = AllocRandomPlane(pMap->lengthU);
+        pMap->pV = pMap->pU;
+        return pMap->pY && pMap->pU;
+    }
+
+    pMap->strideRGB = ALIGN(surfWidth * 4, GOB_WIDTH_BYTES);
+    pMap->lengthRGB = PlaneLength(layout, pMap->strideRGB, blockHeight,
+            pMap->strideRGB, rows);
+    pMap->pRGB = AllocRandomPlane(pMap->lengthRGB);
+    return pMap->pRGB != NULL;
+}
+
+static void
+DestroySurface(
+    NvScrncaptSurfaceMap *pMap)
+{
+    free(pMap->pRGB);
+    free(pMap->pY);
+    free(pMap->pU);
+}
+
+static void
+CheckWindow(
+    NvScrncaptWindowState *pWindow,
+    const char *formatName,
+    int numThreads)
+{
+    size_t size = (size_t)3 * pWindow->fbAperture.width *
+                  pWindow->fbAperture.height;
+    unsigned char *pExpected = malloc(size);
+    unsigned char *pActual = malloc(size);
+
+    if (!pExpected || !pActual) {
+        LOG_ERR("Out of memory\n");
+        numFailures++;
+        goto done;
+    }
+
+    if (!CanConvertWindowRGB24(pWindow)) {
+        LOG_ERR("%s bh %u: window not accepted by the GOB converter\n",
+                formatName, pWindow->surfaceMap.blockHeight);
+        numFailures++;
+        goto done;
+    }
+
+    memset(pActual, 0xa5, size);
+    ConvertWindowRGB24PerPixel(pWindow, pExpected);
+    if (ConvertWindowRGB24(pWindow, pActual, numThreads) != NVSCRNCAPT_STATUS_OK ||
+        memcmp(pExpected, pActual, size)) {
+        LOG_ERR("%s %s bh %u: %dx%d at (%d, %d) inv %d/%d threads %d differs\n",
+                formatName,
+                pWindow->surfaceMap.surfaceLayout ==
+                    NvScrncaptSurfaceLayout_BlockLinear ? "BL" : "PL",
+                pWindow->surfaceMap.blockHeight,
+                pWindow->fbAperture.width, pWindow->fbAperture.height,
+                pWindow->fbAperture.startX, pWindow->fbAperture.startY,
+                pWindow->invertH, pWindow->invertV, numThreads);
+        numFailures++;
+    }
+
+done:
+    free(pExpected);
+    free(pActual);
+}
+
+static void
+TestConversion(void)
+{
+    static const int widths[] = { 1, 15, 16, 17, 63, 64, 65, 100, 257 };
+    static const int heights[] = { 1, 7, 9, 33 };
+    static const int starts[][2] = { { 0, 0 }, { 3, 5 }, { 17, 8 } };
+    NvScrncaptWindowState window;
+    NvScrncaptSurfaceLayout layout;
+    unsigned int f, bh, w, h, s;
+    int numChecks = 0;
+
+    for (f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        for (bh = 0; bh <= MAX_BLOCK_HEIGHT + 1; bh++) {
+            /* The extra pass is the pitch-linear layout */
+            layout = bh > MAX_BLOCK_HEIGHT ? NvScrncaptSurfaceLayout_PitchLinear :
+                                             NvScrncaptSurfaceLayout_BlockLinear;
+            for (s = 0; s < sizeof(starts) / sizeof(starts[0]); s++) {
+                for (w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+                    for (h = 0; h < sizeof(heights) / sizeof(heights[0]); h++) {
+                        memset(&window, 0, sizeof(window));
+                        window.fbAperture.startX = starts[s][0];
+                        window.fbAperture.startY = starts[s][1];
+                        window.fbAperture.width = widths[w];
+                        window.fbAperture.height = heights[h];
+                        window.invertH = (w + h) & 1;
+                        window.invertV = ((w + h) >> 1) & 1;
+
+                        if (!CreateSurface(&window.surfaceMap, formats[f].format,
+                                layout, bh > MAX_BLOCK_HEIGHT ? 0 : bh,
+                                starts[s][0] + widths[w] + (w & 3),
+                                starts[s][1] + heights[h])) {
+                            LOG_ERR("Out of memory\n");
+                            numFailures++;
+                            return;
+                        }
+
+                        CheckWindow(&window, formats[f].name, 1 + (h & 1) * 2);
+                        numChecks++;
+                        DestroySurface(&window.surfaceMap);
+                    }
+                }
+            }
+        }
+    }
+
+    LOG_MSG("conversion: %d windows checked\n", numChecks);
+}
+
+static void
+BenchmarkConversion(void)
+{
+    static const int threadCounts[] = { 1, 4 };
+    NvScrncaptWindowState window;
+    unsigned char *pDst;
+    double start, perPixel, walker;
+    double megapixels;
+    unsigned int f, t;
+
+    memset(&window, 0, sizeof(window));
+    window.fbAperture.width = 1920;
+    window.fbAperture.height = 1080;
+    megapixels = 1920 * 1080 / 1e6;
+
+    pDst = malloc((size_t)3 * 1920 * 1080);
+    if (!pDst)
+        return;
+
+    for (f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        if (!CreateSurface(&window.surfaceMap, formats[f].format,
+                NvScrncaptSurfaceLayout_BlockLinear, 4, 1920, 1080))
+            break;
+
+        start = GetTimeSec();
+        ConvertWindowRGB24PerPixel(&window, pDst);
+        perPixel = GetTimeSec() - start;
+        LOG_MSG("%-10s 1920x1080 BL: per-pixel %7.1f MP/s", formats[f].name,
+                megapixels / perPixel);
+
+        for (t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); t++) {
+            start = GetTimeSec();
+            ConvertWindowRGB24(&window, pDst, threadCounts[t]);
+            walker = GetTimeSec() - start;
+            LOG_MSG("  GOB rows x%d %7.1f MP/s", threadCounts[t],
+                    megapixels / walker);
+        }
+        LOG_MSG("\n");
+
+        DestroySurface(&window.surfaceMap);
+    }
+
+    free(pDst);
+}
+
+int
+main(
+    int argc,
+    char *argv[])
+{
+    srand(1);
+
+    TestConversion();
+    if (argc < 2 || strcmp(argv[1], "--no-bench"))
+        BenchmarkConversion();
+
+    LOG_MSG("%s\n", numFailures ? "FAILED" : "PASSED");
+    return numFailures ? 1 : 0;
+}
@@ -56,15 +56,26 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <ctype.h>
+#include <unistd.h>
 #include "nvaudiorender.h"
+#include "audioscript.h"
+
+#define MAX_LINE_TOKENS 16
+#define EOS_POLL_MS     10
+
+typedef struct {
+    NvAudioRenderHandle *pAudioRender;
+    char *pAudioDevice;
+} AppContext;
 
 void printOptions(void);
-int tokenizeline(char *input, char **voString);
+
+static volatile int bEndOfFile;
 
 static void OnEndofFile (void *pClient)
 {
     printf ("End of File Reached\n");
+    bEndOfFile = 1;
 }
 
 void printOptions(void)
@@ -73,131 +84,222 @@ void printOptions(void)
     printf("pa                     (Play .wav file) \n");
     printf("pp                     (Pause/Play file) \n");
     printf("ka                     (Kill playback) \n");
+    printf("w <ms>                 (Waits) \n");
+    printf("we [timeout ms]        (Waits for the end of file) \n");
     printf("q                      (Quits the Program) \n");
     printf("h                      (prints the above information) \n");
+    printf("\nnvaudiorender -s <script> [-l <loops>] runs the above commands"
+           " from a file,\n<loops> times (0 loops forever)\n");
 }
 
+static void closeRender(AppContext *ctx)
+{
+    if (ctx->pAudioRender) {
+        NvAudioRenderClose (ctx->pAudioRender);
+        ctx->pAudioRender = NULL;
+    }
+}
 
-int tokenizeline(char *input, char **voString) {
-    int len = strlen(input);
-    int i=0,k;
-    char strtemp[255];
-    int numstrings = 0;
+// Returns 1 when the command asks to quit
+static int runCommand(AppContext *ctx, const AudioCommand *cmd)
+{
+    NvAudioParams AudioParams;
+    NvAudioState uState;
+    NvResult result = RESULT_OK;
+    unsigned long waited = 0;
 
-    for (i = 0;i < len; i++) {
-        char bQuoted = 0;
-        while (i < len && isspace(input[i])) {
-            i++;
+    switch (cmd->type) {
+    case AUDIO_CMD_HELP:
+        printOptions ();
+        break;
+    case AUDIO_CMD_PLAY:
+        if (ctx->pAudioRender) {
+            printf ("EarlyAudio is already running\n");
+            break;
         }
 
-        if(i < len && input[i] == '"') {
-            bQuoted = 1;
-            i++;
-        }
+        AudioParams.pAudioDevice = ctx->pAudioDevice;
+        AudioParams.EosCallback = OnEndofFile;
+        AudioParams.pClient = NULL;
 
-        k = 0;
-        if (bQuoted) {
-            while (i < len && input[i] != '"') {
-                strtemp[k++] = input[i++];
+        ctx->pAudioRender = NvAudioRenderOpen (&AudioParams);
+        if (ctx->pAudioRender == NULL) {
+            printf ("Failed to create EarlyAudio\n");
+            break;
+        }
+        bEndOfFile = 0;
+        result = NvAudioRenderPlayWav (ctx->pAudioRender, (char *)cmd->arg);
+        if (IsFailed(result)) {
+            printf ("Failed to play file %s\n", cmd->arg);
+        }
+        break;
+    case AUDIO_CMD_PAUSE:
+        if (ctx->pAudioRender) {
+            NvAudioRenderGetState (ctx->pAudioRender, &uState);
+            if (uState == PLAY) {
+                printf ("Setting to PAUSE state\n");
+                NvAudioRenderSetState (ctx->pAudioRender, PAUSE);
             }
-
-            if (i < len && input[i] == '"') {
-                i++;
+            else if (uState == PAUSE) {
+                printf ("Setting to PLAY state\n");
+                NvAudioRenderSetState (ctx->pAudioRender, PLAY);
             }
-            strtemp[k]='\0';
+        }
+        break;
+    case AUDIO_CMD_KILL:
+        closeRender (ctx);
+        break;
+    case AUDIO_CMD_WAIT:
+        usleep (cmd->value * 1000);
+        break;
+    case AUDIO_CMD_WAIT_EOS:
+        while (ctx->pAudioRender && !bEndOfFile &&
+               (!cmd->value || waited < cmd->value)) {
+            usleep (EOS_POLL_MS * 1000);
+            waited += EOS_POLL_MS;
+        }
+        break;
+    case AUDIO_CMD_QUIT:
+        closeRender (ctx);
+        return 1;
+    default:
+        printf ("Unknown Command\n");
+        break;
+    }
+    return 0;
+}
+
+// Builds a command from a line typed at the prompt.  The tokens are
+// terminated in place, so the line itself holds the file argument.
+static int parseLine(char *input, AudioCommand *cmd)
+{
+    AudioToken tokens[MAX_LINE_TOKENS];
+    size_t pos = 0;
+    int numTokens, i;
+
+    numTokens = AudioTokenizeLine(input, strlen(input), &pos,
+                                  tokens, MAX_LINE_TOKENS);
+    if (numTokens < 0) {
+        printf ("Unterminated quote\n");
+        return -1;
+    }
+    if (numTokens == 0) {
+        return -1;
+    }
+    if (numTokens > MAX_LINE_TOKENS) {
+        printf ("Too many arguments\n");
+        return -1;
+    }
+
+    for (i = 0; i < numTokens; i++) {
+        input[tokens[i].offset + tokens[i].length] = '\0';
+    }
+
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->type = AudioCommandLookup(input + tokens[0].offset,
+                                   tokens[0].length);
+    cmd->numTokens = numTokens;
+
+    switch (cmd->type) {
+    case AUDIO_CMD_PLAY:
+        if (numTokens < 2) {
+            printf ("Missing file name\n");
+            return -1;
+        }
+        cmd->arg = input + tokens[1].offset;
+        break;
+    case AUDIO_CMD_WAIT:
+    case AUDIO_CMD_WAIT_EOS:
+        if ((numTokens > 1 &&
+             AudioTokenToUlong(input, &tokens[1], &cmd->value)) ||
+            (numTokens < 2 && cmd->type == AUDIO_CMD_WAIT)) {
+            printf ("Invalid time\n");
+            return -1;
+        }
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+static int runScript(AppContext *ctx, const char *path, unsigned long loops)
+{
+    AudioScript script;
+    unsigned int errLine;
+    unsigned long loop;
+    unsigned int i;
+    int bQuit = 0;
+
+    if (AudioScriptOpen(&script, path, &errLine)) {
+        if (errLine) {
+            printf ("%s:%u: invalid command\n", path, errLine);
         }
         else {
-            while (i < len && !isspace(input[i])) {
-                strtemp[k++] = input[i++] ;
-            }
-            strtemp[k]='\0';
+            printf ("Failed to read %s\n", path);
         }
-        if (k) {
-            voString[numstrings] = (char*)malloc(k + 1);
-            strcpy(voString[numstrings++], strtemp);
+        return -1;
+    }
+
+    for (loop = 0; !bQuit && (!loops || loop < loops); loop++) {
+        for (i = 0; !bQuit && i < script.numCommands; i++) {
+            bQuit = runCommand (ctx, &script.commands[i]);
         }
     }
-    return numstrings;
+
+    AudioScriptClose(&script);
+    closeRender (ctx);
+    return 0;
 }
 
 int main(int argc, char* argv[])
 {
-    NvAudioRenderHandle *pAudioRender = NULL;
-    NvAudioParams AudioParams;
-    NvAudioState uState;
-    char *voString[256] = {0};
+    AppContext ctx;
+    AudioCommand cmd;
     char input[256] = {0};
     char AudioDevice [] = "default";
+    char *pScript = NULL;
+    unsigned long loops = 1;
+    char *end;
     char bQuit = 0;
-    U32 i = 0;
-    U32 numstrings = 0;
-    NvResult result = RESULT_OK;
+    int i;
 
-    while (!bQuit) {
-        printf ("-");
-        fgets (input, 256, stdin);
+    ctx.pAudioRender = NULL;
+    ctx.pAudioDevice = AudioDevice;
 
-        if (input[0] == 0 || !(numstrings = tokenizeline(input,voString))) {
-            continue;
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            pScript = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+            loops = strtoul(argv[++i], &end, 10);
+            if (*end != '\0') {
+                printOptions ();
+                return 1;
+            }
         }
-        else if (!strcmp(voString[0],"h")) {
+        else {
             printOptions ();
+            return 1;
         }
-        else if (!strcmp(voString[0],"pa")) {
-
-            if (pAudioRender) {
-                printf ("EarlyAudio is already running\n");
-                goto freetokens;
-            }
+    }
 
-            AudioParams.pAudioDevice = AudioDevice;
-            AudioParams.EosCallback = OnEndofFile;
-            AudioParams.pClient = NULL;
+    if (pScript) {
+        return runScript (&ctx, pScript, loops) ? 1 : 0;
+    }
 
-            pAudioRender = NvAudioRenderOpen (&AudioParams);
-            if (pAudioRender == NULL) {
-                printf ("Failed to create EarlyAudio\n");
-                goto freetokens;
-            }
-            result = NvAudioRenderPlayWav (pAudioRender, voString[1]);
-            if (IsFailed(result)) {
-                printf ("Failed to play file %s\n", voString[1]);
-                goto freetokens;
-            }
-        }
-        else if (!strcmp(voString[0], "pp")) {
-            if (pAudioRender) {
-                NvAudioRenderGetState (pAudioRender, &uState);
-                if (uState == PLAY) {
-                    printf ("Setting to PAUSE state\n");
-                    NvAudioRenderSetState (pAudioRender, PAUSE);
-                }
-                else if (uState == PAUSE) {
-                    printf ("Setting to PLAY state\n");
-                    NvAudioRenderSetState (pAudioRender, PLAY);
-                }
-            }
-        }
-        else if (!strcmp(voString[0], "ka")) {
-            if (pAudioRender) {
-                NvAudioRenderClose (pAudioRender);
-                pAudioRender = NULL;
-            }
-        }
-        else if (!strcmp(voString[0],"q") || !strcmp(voString[0],"quit")) {
-            if (pAudioRender) {
-                NvAudioRenderClose (pAudioRender);
-                pAudioRender = NULL;
-            }
-            bQuit = 1;
+    while (!bQuit) {
+        printf ("-");
+        if (!fgets (input, 256, stdin)) {
+            break;
         }
-        else
-            printf ("Unknown Command\n");
 
-        freetokens:
-        for(i = 0; i < numstrings; i++) {
-            free(voString[i]);
+        if (parseLine (input, &cmd)) {
+            continue;
         }
+        bQuit = runCommand (&ctx, &cmd);
     }
+
+    closeRender (&ctx);
     return 0;
 }
@@ -0,0 +1,402 @@
+/*
+ * Copyright (c) 2016, NVIDIA Corporation.  All Rights Reserved.
+ *
+ * BY INSTALLING THE SOFTWARE THE USER AGREES TO THE TERMS BELOW.
+ *
+ * User agrees to use the software under carefully controlled conditions
+ * and to inform all employees and contractors who have access to the software
+ * that the source code of the software is confidential and proprietary
+ * information of NVIDIA and is licensed to user as such.  User acknowledges
+ * and agrees that protection of the source code is essential and user shall
+ * retain the source code in strict confidence.  User shall restrict access to
+ * the source code of the software to those employees and contractors of user
+ * who have agreed to be bound by a confidentiality obligation which
+ * incorporates the protections and restrictions substantially set forth
+ * herein, and who have a need to access the source code in order to carry out
+ * the business purpose between NVIDIA and user.  The software provided
+ * herewith to user may only be used so long as the software is used solely
+ * with NVIDIA products and no other third party products (hardware or
+ * software).   The software must carry the NVIDIA copyright notice shown
+ * above.  User must not disclose, copy, duplicate, reproduce, modify,
+ * publicly display, create derivative works of the software other than as
+ * expressly authorized herein.  User must not under any circumstances,
+ * distribute or in any way disseminate the information contained in the
+ * source code and/or the source code itself to third parties except as
+ * expressly agreed to by NVIDIA.  In the event that user discovers any bugs
+ * in the software, such bugs must be reported to NVIDIA and any fixes may be
+ * inserted into the source code of the software by NVIDIA only.  User shall
+ * not modify the source code of the software in any way.  User shall be fully
+ * responsible for the conduct of all of its employees, contractors and
+ * representatives who may in any way violate these restrictions.
+ *
+ * NO WARRANTY
+ * THE ACCOMPANYING SOFTWARE (INCLUDING OBJECT AND SOURCE CODE) PROVIDED BY
+ * NVIDIA TO USER IS PROVIDED "AS IS."  NVIDIA DISCLAIMS ALL WARRANTIES,
+ * EXPRESS, IMPLIED OR STATUTORY, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF TITLE, MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.
+
+ * LIMITATION OF LIABILITY
+ * NVIDIA SHALL NOT BE LIABLE TO USER, USERS CUSTOMERS, OR ANY OTHER PERSON
+ * OR ENTITY CLAIMING THROUGH OR UNDER USER FOR ANY LOSS OF PROFITS, INCOME,
+ * SAVINGS, OR ANY OTHER CONSEQUENTIAL, INCIDENTAL, SPECIAL, PUNITIVE, DIRECT
+ * OR INDIRECT DAMAGES (WHETHER IN AN ACTION IN CONTRACT, TORT OR BASED ON A
+ * WARRANTY), EVEN IF NVIDIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGES.  THESE LIMITATIONS SHALL APPLY NOTWITHSTANDING ANY FAILURE OF THE
+ * ESSENTIAL PURPOSE OF ANY LIMITED REMEDY.  IN NO EVENT SHALL NVIDIAS
+ * AGGREGATE LIABILITY TO USER OR ANY OTHER PERSON OR ENTITY CLAIMING THROUGH
+ * OR UNDER USER EXCEED THE AMOUNT OF MONEY ACTUALLY PAID BY USER TO NVIDIA
+ * FOR THE SOFTWARE PROVIDED HEREWITH.
+ */
+
+//------------------------------------------------------------------------------
+//! \file audioscript.c
+//! \brief Command tokenizer and script parser for nvaudiorender
+//!
+//! A script is mapped and parsed once.  Tokens are (offset, length) views
+//! into the mapping, and every command carries its type and numeric
+//! argument, so replaying a script does no string work or allocation.
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "audioscript.h"
+
+// Tokens looked at while counting: the command and its first argument
+#define COUNT_TOKENS 2
+
+static const struct {
+    const char *name;
+    AudioCommandType type;
+} sCommands[] = {
+    { "h",    AUDIO_CMD_HELP },
+    { "pa",   AUDIO_CMD_PLAY },
+    { "pp",   AUDIO_CMD_PAUSE },
+    { "ka",   AUDIO_CMD_KILL },
+    { "w",    AUDIO_CMD_WAIT },
+    { "we",   AUDIO_CMD_WAIT_EOS },
+    { "q",    AUDIO_CMD_QUIT },
+    { "quit", AUDIO_CMD_QUIT },
+};
+
+int AudioTokenizeLine(const char *text, size_t size, size_t *pos,
+                      AudioToken *tokens, unsigned int maxTokens)
+{
+    size_t i = *pos;
+    size_t start, end;
+    unsigned int numTokens = 0;
+    int bUnterminated = 0;
+
+    while (i < size && text[i] != '\n') {
+        if (isspace((unsigned char)text[i])) {
+            i++;
+            continue;
+        }
+
+        if (text[i] == '"') {
+            start = ++i;
+            while (i < size && text[i] != '"' && text[i] != '\n') {
+                i++;
+            }
+            end = i;
+            if (i < size && text[i] == '"') {
+                i++;
+            }
+            else {
+                bUnterminated = 1;
+            }
+        }
+        else {
+            start = i;
+            while (i < size && !isspace((unsigned char)text[i])) {
+                i++;
+            }
+            end = i;
+        }
+
+        // An empty quoted string is not a token
+        if (end > start) {
+            if (numTokens < maxTokens) {
+                tokens[numTokens].offset = (unsigned int)start;
+                tokens[numTokens].length = (unsigned int)(end - start);
+            }
+            numTokens++;
+        }
+    }
+
+    if (i < size) {
+        i++;
+    }
+    *pos = i;
+
+    return bUnterminated ? -1 : (int)numTokens;
+}
+
+AudioCommandType AudioCommandLookup(const char *name, unsigned int length)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(sCommands) / sizeof(sCommands[0]); i++) {
+        if (!strncmp(sCommands[i].name, name, length) &&
+            sCommands[i].name[length] == '\0') {
+            return sCommands[i].type;
+        }
+    }
+    return AUDIO_CMD_UNKNOWN;
+}
+
+int AudioTokenToUlong(const char *text, const AudioToken *token,
+                      unsigned long *value)
+{
+    const char *digits = text + token->offset;
+    unsigned long result = 0;
+    unsigned int i;
+
+    if (!token->length) {
+        return -1;
+    }
+
+    for (i = 0; i < token->length; i++) {
+        unsigned int digit = (unsigned char)digits[i] - '0';
+
+        if (digit > 9 || result > (ULONG_MAX - digit) / 10) {
+            return -1;
+        }
+        result = result * 10 + digit;
+    }
+
+    *value = result;
+    return 0;
+}
+
+// Checks the command on a line and returns the bytes needed for a copy
+// of its file argument, or -1 if the line is not a valid command
+static long CheckCommand(const char *text, const AudioToken *tokens,
+                         unsigned int numTokens, AudioCommandType *type,
+                         unsigned long *value)
+{
+    *type = AudioCommandLookup(text + tokens[0].offset, tokens[0].length);
+    *value = 0;
+
+    switch (*type) {
+    case AUDIO_CMD_PLAY:
+        if (numTokens != 2) {
+            return -1;
+        }
+        return (long)tokens[1].length + 1;
+    case AUDIO_CMD_WAIT:
+        if (numTokens != 2 || AudioTokenToUlong(text, &tokens[1], value)) {
+            return -1;
+        }
+        return 0;
+    case AUDIO_CMD_WAIT_EOS:
+        if (numTokens > 2 ||
+            (numTokens == 2 && AudioTokenToUlong(text, &tokens[1], value))) {
+            return -1;
+        }
+        return 0;
+    case AUDIO_CMD_UNKNOWN:
+        return -1;
+    default:
+        return numTokens == 1 ? 0 : -1;
+    }
+}
+
+// Moves *pos past the line if it is a comment
+static int SkipComment(const char *text, size_t size, size_t *pos)
+{
+    size_t i = *pos;
+
+    while (i < size && text[i] != '\n' && isspace((unsigned char)text[i])) {
+        i++;
+    }
+    if (i == size || text[i] != '#') {
+        return 0;
+    }
+
+    while (i < size && text[i] != '\n') {
+        i++;
+    }
+    *pos = i < size ? i + 1 : i;
+    return 1;
+}
+
+static void *ArenaAlloc(char *arena, size_t *used, size_t size, size_t align)
+{
+    void *p;
+
+    *used = (*used + align - 1) & ~(align - 1);
+    p = arena + *used;
+    *used += size;
+    return p;
+}
+
+int AudioScriptParse(AudioScript *script, const char *text, size_t size,
+                     unsigned int *errLine)
+{
+    AudioToken first[COUNT_TOKENS];
+    AudioCommandType type;
+    unsigned long value;
+    size_t pos = 0, used = 0;
+    size_t numCommands = 0, numTokens = 0, argBytes = 0;
+    unsigned int line = 0;
+    char *arena = NULL;
+    char *args;
+    long bytes;
+    int n;
+
+    memset(script, 0, sizeof(*script));
+    if (errLine) {
+        *errLine = 0;
+    }
+
+    // Token offsets are 32 bits
+    if (size >= UINT_MAX) {
+        return -1;
+    }
+
+    // First pass: validate and count, so that everything fits in one
+    // allocation
+    while (pos < size) {
+        line++;
+        if (SkipComment(text, size, &pos)) {
+            continue;
+        }
+        n = AudioTokenizeLine(text, size, &pos, first, COUNT_TOKENS);
+        if (n < 0) {
+            goto fail;
+        }
+        if (n == 0) {
+            continue;
+        }
+        bytes = CheckCommand(text, first, n, &type, &value);
+        if (bytes < 0) {
+            goto fail;
+        }
+        numCommands++;
+        numTokens += n;
+        argBytes += bytes;
+    }
+
+    script->text = text;
+    script->size = size;
+    if (!numCommands) {
+        return 0;
+    }
+
+    script->arenaSize = numCommands * sizeof(AudioCommand) +
+                        numTokens * sizeof(AudioToken) + argBytes;
+    arena = malloc(script->arenaSize);
+    if (!arena) {
+        return -1;
+    }
+    script->arena = arena;
+    script->commands = ArenaAlloc(arena, &used,
+                                  numCommands * sizeof(AudioCommand),
+                                  sizeof(void *));
+    script->tokens = ArenaAlloc(arena, &used,
+                                numTokens * sizeof(AudioToken),
+                                sizeof(unsigned int));
+    args = ArenaAlloc(arena, &used, argBytes, 1);
+
+    // Second pass: store the tokens and commands
+    pos = 0;
+    line = 0;
+    while (pos < size) {
+        AudioToken *tokens = script->tokens + script->numTokens;
+        AudioCommand *cmd = script->commands + script->numCommands;
+
+        line++;
+        if (SkipComment(text, size, &pos)) {
+            continue;
+        }
+        n = AudioTokenizeLine(text, size, &pos, tokens,
+                              (unsigned int)(numTokens - script->numTokens));
+        if (n == 0) {
+            continue;
+        }
+
+        bytes = CheckCommand(text, tokens, n, &type, &value);
+        cmd->type = type;
+        cmd->line = line;
+        cmd->firstToken = script->numTokens;
+        cmd->numTokens = n;
+        cmd->value = value;
+        cmd->arg = NULL;
+        if (bytes > 0) {
+            memcpy(args, text + tokens[1].offset, tokens[1].length);
+            args[tokens[1].length] = '\0';
+            cmd->arg = args;
+            args += bytes;
+        }
+
+        script->numTokens += n;
+        script->numCommands++;
+    }
+
+    return 0;
+
+fail:
+    if (errLine) {
+        *errLine = line;
+    }
+    return -1;
+}
+
+int AudioScriptOpen(AudioScript *script, const char *path,
+                    unsigned int *errLine)
+{
+    struct stat st;
+    void *map = NULL;
+    int fd;
+
+    memset(script, 0, sizeof(*script));
+    if (errLine) {
+        *errLine = 0;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size < 0 ||
+        (unsigned long long)st.st_size >= UINT_MAX) {
+        close(fd);
+        return -1;
+    }
+
+    if (st.st_size > 0) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
+
+    if (AudioScriptParse(script, map, st.st_size, errLine)) {
+        if (map) {
+            munmap(map, st.st_size);
+        }
+        return -1;
+    }
+    script->mapped = map != NULL;
+
+    return 0;
+}
+
+void AudioScriptClose(AudioScript *script)
+{
+    if (script->mapped) {
+        munmap((void *)script->text, script->size);
+    }
+    free(script->arena);
+    memset(script, 0, sizeof(*script));
+}
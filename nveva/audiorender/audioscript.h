@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2016, NVIDIA Corporation.  All Rights Reserved.
+ *
+ * BY INSTALLING THE SOFTWARE THE USER AGREES TO THE TERMS BELOW.
+ *
+ * User agrees to use the software under carefully controlled conditions
+ * and to inform all employees and contractors who have access to the software
+ * that the source code of the software is confidential and proprietary
+ * information of NVIDIA and is licensed to user as such.  User acknowledges
+ * and agrees that protection of the source code is essential and user shall
+ * retain the source code in strict confidence.  User shall restrict access to
+ * the source code of the software to those employees and contractors of user
+ * who have agreed to be bound by a confidentiality obligation which
+ * incorporates the protections and restrictions substantially set forth
+ * herein, and who have a need to access the source code in order to carry out
+ * the business purpose between NVIDIA and user.  The software provided
+ * herewith to user may only be used so long as the software is used solely
+ * with NVIDIA products and no other third party products (hardware or
+ * software).   The software must carry the NVIDIA copyright notice shown
+ * above.  User must not disclose, copy, duplicate, reproduce, modify,
+ * publicly display, create derivative works of the software other than as
+ * expressly authorized herein.  User must not under any circumstances,
+ * distribute or in any way disseminate the information contained in the
+ * source code and/or the source code itself to third parties except as
+ * expressly agreed to by NVIDIA.  In the event that user discovers any bugs
+ * in the software, such bugs must be reported to NVIDIA and any fixes may be
+ * inserted into the source code of the software by NVIDIA only.  User shall
+ * not modify the source code of the software in any way.  User shall be fully
+ * responsible for the conduct of all of its employees, contractors and
+ * representatives who may in any way violate these restrictions.
+ *
+ * NO WARRANTY
+ * THE ACCOMPANYING SOFTWARE (INCLUDING OBJECT AND SOURCE CODE) PROVIDED BY
+ * NVIDIA TO USER IS PROVIDED "AS IS."  NVIDIA DISCLAIMS ALL WARRANTIES,
+ * EXPRESS, IMPLIED OR STATUTORY, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF TITLE, MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.
+
+ * LIMITATION OF LIABILITY
+ * NVIDIA SHALL NOT BE LIABLE TO USER, USERS CUSTOMERS, OR ANY OTHER PERSON
+ * OR ENTITY CLAIMING THROUGH OR UNDER USER FOR ANY LOSS OF PROFITS, INCOME,
+ * SAVINGS, OR ANY OTHER CONSEQUENTIAL, INCIDENTAL, SPECIAL, PUNITIVE, DIRECT
+ * OR INDIRECT DAMAGES (WHETHER IN AN ACTION IN CONTRACT, TORT OR BASED ON A
+ * WARRANTY), EVEN IF NVIDIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGES.  THESE LIMITATIONS SHALL APPLY NOTWITHSTANDING ANY FAILURE OF THE
+ * ESSENTIAL PURPOSE OF ANY LIMITED REMEDY.  IN NO EVENT SHALL NVIDIAS
+ * AGGREGATE LIABILITY TO USER OR ANY OTHER PERSON OR ENTITY CLAIMING THROUGH
+ * OR UNDER USER EXCEED THE AMOUNT OF MONEY ACTUALLY PAID BY USER TO NVIDIA
+ * FOR THE SOFTWARE PROVIDED HEREWITH.
+ */
+
+//------------------------------------------------------------------------------
+//! \file audioscript.h
+//! \brief Command tokenizer and script parser for nvaudiorender
+//------------------------------------------------------------------------------
+#ifndef _AUDIOSCRIPT_H_
+#define _AUDIOSCRIPT_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! A token is a view into the text it was read from; nothing is copied
+typedef struct {
+    unsigned int offset;
+    unsigned int length;
+} AudioToken;
+
+typedef enum {
+    AUDIO_CMD_NONE = 0,
+    AUDIO_CMD_HELP,         //!< h
+    AUDIO_CMD_PLAY,         //!< pa <file>
+    AUDIO_CMD_PAUSE,        //!< pp
+    AUDIO_CMD_KILL,         //!< ka
+    AUDIO_CMD_WAIT,         //!< w <ms>
+    AUDIO_CMD_WAIT_EOS,     //!< we [timeout ms]
+    AUDIO_CMD_QUIT,         //!< q, quit
+    AUDIO_CMD_UNKNOWN
+} AudioCommandType;
+
+typedef struct {
+    AudioCommandType type;
+    unsigned int line;          //!< 1-based line in the script
+    unsigned int firstToken;    //!< index into AudioScript.tokens
+    unsigned int numTokens;     //!< including the command itself
+    unsigned long value;        //!< numeric argument of w/we, 0 if none
+    const char *arg;            //!< NUL-terminated file argument of pa
+} AudioCommand;
+
+//! A parsed script.  The commands, the tokens and the copies of the
+//! file arguments share one allocation; text stays mapped until
+//! AudioScriptClose() so that tokens can be read back.
+typedef struct {
+    const char *text;
+    size_t size;
+    AudioCommand *commands;
+    unsigned int numCommands;
+    AudioToken *tokens;
+    unsigned int numTokens;
+    void *arena;
+    size_t arenaSize;
+    int mapped;
+} AudioScript;
+
+//! Splits the line starting at *pos into at most maxTokens tokens and
+//! moves *pos past the line and its newline.  Tokens are separated by
+//! white space; a token starting with '"' runs to the next '"' on the
+//! same line.  Returns the number of tokens on the line, which may be
+//! larger than maxTokens, or -1 if a quote is not closed.
+int AudioTokenizeLine(const char *text, size_t size, size_t *pos,
+                      AudioToken *tokens, unsigned int maxTokens);
+
+//! Maps a command name to its type, AUDIO_CMD_UNKNOWN if there is none
+AudioCommandType AudioCommandLookup(const char *name, unsigned int length);
+
+//! Reads an unsigned decimal token.  Returns 0 on success, -1 if the
+//! token is not a number or does not fit.
+int AudioTokenToUlong(const char *text, const AudioToken *token,
+                      unsigned long *value);
+
+//! Parses size bytes of text.  Blank lines and lines starting with '#'
+//! are skipped.  On failure returns -1 and, if errLine is set, stores
+//! the line that could not be parsed.
+int AudioScriptParse(AudioScript *script, const char *text, size_t size,
+                     unsigned int *errLine);
+
+//! Maps path and parses it with AudioScriptParse()
+int AudioScriptOpen(AudioScript *script, const char *path,
+                    unsigned int *errLine);
+
+void AudioScriptClose(AudioScript *script);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _AUDIOSCRIPT_H_
@@ -0,0 +1,473 @@
+/*
+ * Copyright (c) 2016, NVIDIA Corporation.  All Rights Reserved.
+ *
+ * BY INSTALLING THE SOFTWARE THE USER AGREES TO THE TERMS BELOW.
+ *
+ * User agrees to use the software under carefully controlled conditions
+ * and to inform all employees and contractors who have access to the software
+ * that the source code of the software is confidential and proprietary
+ * information of NVIDIA and is licensed to user as such.  User acknowledges
+ * and agrees that protection of the source code is essential and user shall
+ * retain the source code in strict confidence.  User shall restrict access to
+ * the source code of the software to those employees and contractors of user
+ * who have agreed to be bound by a confidentiality obligation which
+ * incorporates the protections and restrictions substantially set forth
+ * herein, and who have a need to access the source code in order to carry out
+ * the business purpose between NVIDIA and user.  The software provided
+ * herewith to user may only be used so long as the software is used solely
+ * with NVIDIA products and no other third party products (hardware or
+ * software).   The software must carry the NVIDIA copyright notice shown
+ * above.  User must not disclose, copy, duplicate, reproduce, modify,
+ * publicly display, create derivative works of the software other than as
+ * expressly authorized herein.  User must not under any circumstances,
+ * distribute or in any way disseminate the information contained in the
+ * source code and/or the source code itself to third parties except as
+ * expressly agreed to by NVIDIA.  In the event that user discovers any bugs
+ * in the software, such bugs must be reported to NVIDIA and any fixes may be
+ * inserted into the source code of the software by NVIDIA only.  User shall
+ * not modify the source code of the software in any way.  User shall be fully
+ * responsible for the conduct of all of its employees, contractors and
+ * representatives who may in any way violate these restrictions.
+ *
+ * NO WARRANTY
+ * THE ACCOMPANYING SOFTWARE (INCLUDING OBJECT AND SOURCE CODE) PROVIDED BY
+ * NVIDIA TO USER IS PROVIDED "AS IS."  NVIDIA DISCLAIMS ALL WARRANTIES,
+ * EXPRESS, IMPLIED OR STATUTORY, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF TITLE, MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.
+
+ * LIMITATION OF LIABILITY
+ * NVIDIA SHALL NOT BE LIABLE TO USER, USERS CUSTOMERS, OR ANY OTHER PERSON
+ * OR ENTITY CLAIMING THROUGH OR UNDER USER FOR ANY LOSS OF PROFITS, INCOME,
+ * SAVINGS, OR ANY OTHER CONSEQUENTIAL, INCIDENTAL, SPECIAL, PUNITIVE, DIRECT
+ * OR INDIRECT DAMAGES (WHETHER IN AN ACTION IN CONTRACT, TORT OR BASED ON A
+ * WARRANTY), EVEN IF NVIDIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGES.  THESE LIMITATIONS SHALL APPLY NOTWITHSTANDING ANY FAILURE OF THE
+ * ESSENTIAL PURPOSE OF ANY LIMITED REMEDY.  IN NO EVENT SHALL NVIDIAS
+ * AGGREGATE LIABILITY TO USER OR ANY OTHER PERSON OR ENTITY CLAIMING THROUGH
+ * OR UNDER USER EXCEED THE AMOUNT OF MONEY ACTUALLY PAID BY USER TO NVIDIA
+ * FOR THE SOFTWARE PROVIDED HEREWITH.
+ */
+
+//------------------------------------------------------------------------------
+//! \file test_audioscript.c
+//! \brief Tests and parse benchmark for the nvaudiorender script parser
+//!
+//! Every script is parsed from a copy that ends right before an
+//! inaccessible page, so reading past the end of the text faults.
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "audioscript.h"
+
+#define BENCH_LINES     10000
+#define BENCH_LOOPS     200
+
+static int sFailures = 0;
+
+#define CHECK(cond, ...)                                            \
+    do {                                                            \
+        if (!(cond)) {                                              \
+            printf("FAIL %s:%d: ", __func__, __LINE__);             \
+            printf(__VA_ARGS__);                                    \
+            printf("\n");                                           \
+            sFailures++;                                            \
+        }                                                           \
+    } while (0)
+
+//! Text placed at the end of a mapping followed by a PROT_NONE page
+typedef struct {
+    char *base;
+    size_t mapSize;
+    char *text;
+    size_t size;
+} GuardedText;
+
+static double GetTimeSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int GuardText(GuardedText *g, const char *text, size_t size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+    g->size = size;
+    g->mapSize = (size + page - 1) / page * page + page;
+    g->base = mmap(NULL, g->mapSize, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (g->base == MAP_FAILED) {
+        return -1;
+    }
+    mprotect(g->base + g->mapSize - page, page, PROT_NONE);
+    g->text = g->base + g->mapSize - page - size;
+    memcpy(g->text, text, size);
+    return 0;
+}
+
+static void UnguardText(GuardedText *g)
+{
+    munmap(g->base, g->mapSize);
+}
+
+// Parses size bytes of text, returns the result of AudioScriptParse()
+// and leaves the script open for the caller to check and close
+static int Parse(AudioScript *script, GuardedText *g, const char *text,
+                 size_t size, unsigned int *errLine)
+{
+    if (GuardText(g, text, size)) {
+        CHECK(0, "out of memory");
+        memset(script, 0, sizeof(*script));
+        return -1;
+    }
+    return AudioScriptParse(script, g->text, size, errLine);
+}
+
+static int ParseString(AudioScript *script, GuardedText *g, const char *text,
+                       unsigned int *errLine)
+{
+    return Parse(script, g, text, strlen(text), errLine);
+}
+
+static int TokenIs(const AudioScript *script, const AudioCommand *cmd,
+                   unsigned int index, const char *expected)
+{
+    const AudioToken *token = &script->tokens[cmd->firstToken + index];
+
+    return index < cmd->numTokens && token->length == strlen(expected) &&
+           !memcmp(script->text + token->offset, expected, token->length);
+}
+
+// Checks that text is rejected at line errLine
+static void CheckFails(const char *text, unsigned int errLine)
+{
+    AudioScript script;
+    GuardedText g;
+    unsigned int line = 12345;
+
+    CHECK(ParseString(&script, &g, text, &line) == -1,
+          "\"%s\" accepted", text);
+    CHECK(line == errLine, "\"%s\" failed at line %u, expected %u",
+          text, line, errLine);
+    CHECK(script.arena == NULL && script.numCommands == 0,
+          "\"%s\" left a script behind", text);
+    AudioScriptClose(&script);
+    UnguardText(&g);
+}
+
+static void TestComments(void)
+{
+    static const char text[] =
+        "# header with an \"unterminated quote\n"
+        "\n"
+        "   # indented comment\n"
+        "\t#\n"
+        "h\n"
+        "#pa not-a-command\n"
+        "q";
+    AudioScript script;
+    GuardedText g;
+    unsigned int line;
+
+    CHECK(ParseString(&script, &g, text, &line) == 0, "rejected at %u", line);
+    CHECK(script.numCommands == 2, "%u commands", script.numCommands);
+    if (script.numCommands == 2) {
+        CHECK(script.commands[0].type == AUDIO_CMD_HELP &&
+              script.commands[0].line == 5, "h on line %u",
+              script.commands[0].line);
+        CHECK(script.commands[1].type == AUDIO_CMD_QUIT &&
+              script.commands[1].line == 7, "q on line %u",
+              script.commands[1].line);
+    }
+    AudioScriptClose(&script);
+    UnguardText(&g);
+
+    // Only whole lines are comments, and nothing but comments is fine
+    CheckFails("h # trailing\n", 1);
+    CheckFails("h\nh#\n", 2);
+    CHECK(ParseString(&script, &g, "# only\n#\n\n", &line) == 0 &&
+          script.numCommands == 0 && script.arena == NULL,
+          "comment-only script");
+    AudioScriptClose(&script);
+    UnguardText(&g);
+}
+
+static void TestQuotedTokens(void)
+{
+    static const char text[] =
+        "pa \"/a dir/with  spaces.wav\"\r\n"
+        "pa \"\" x.wav\n"
+        "pa \"tab\there\"\n";
+    AudioScript script;
+    AudioToken tokens[4];
+    GuardedText g;
+    unsigned int line;
+    size_t pos;
+    const char *adjacent = "\"x\"y \"\" z";
+
+    CHECK(ParseString(&script, &g, text, &line) == 0, "rejected at %u", line);
+    CHECK(script.numCommands == 3, "%u commands", script.numCommands);
+    if (script.numCommands == 3) {
+        CHECK(script.commands[0].arg &&
+              !strcmp(script.commands[0].arg, "/a dir/with  spaces.wav"),
+              "quoted argument with spaces");
+        CHECK(TokenIs(&script, &script.commands[0], 1,
+                      "/a dir/with  spaces.wav"), "token of the argument");
+        // an empty quoted string is not a token
+        CHECK(script.commands[1].numTokens == 2 && script.commands[1].arg &&
+              !strcmp(script.commands[1].arg, "x.wav"), "empty quotes");
+        CHECK(script.commands[2].arg &&
+              !strcmp(script.commands[2].arg, "tab\there"), "quoted tab");
+    }
+    AudioScriptClose(&script);
+    UnguardText(&g);
+
+    // A closing quote ends the token even without white space after it
+    pos = 0;
+    CHECK(AudioTokenizeLine(adjacent, strlen(adjacent), &pos, tokens, 4) == 3,
+          "adjacent quoted token");
+    CHECK(tokens[0].offset == 1 && tokens[0].length == 1 &&
+          tokens[1].offset == 3 && tokens[1].length == 1 &&
+          tokens[2].offset == 8, "adjacent token offsets");
+
+    // The quote must close on its line
+    CheckFails("pa \"x.wav\n\"\n", 1);
+    CheckFails("h\n\npa \"x.wav", 3);
+    CheckFails("pa \"x\"y\n", 1);
+}
+
+static void TestUnknownCommands(void)
+{
+    static const char *const unknown[] = {
+        "play x.wav", "qu", "Q", "p", "quits", "\"h\"x", "-h", "w5",
+    };
+    AudioScript script;
+    GuardedText g;
+    unsigned int i, line;
+    char text[64];
+
+    for (i = 0; i < sizeof(unknown) / sizeof(unknown[0]); i++) {
+        snprintf(text, sizeof(text), "h\n# c\n%s\nq\n", unknown[i]);
+        CheckFails(text, 3);
+    }
+
+    CHECK(AudioCommandLookup("quit", 4) == AUDIO_CMD_QUIT &&
+          AudioCommandLookup("quit", 1) == AUDIO_CMD_QUIT &&
+          AudioCommandLookup("quit", 2) == AUDIO_CMD_UNKNOWN &&
+          AudioCommandLookup("we", 1) == AUDIO_CMD_WAIT &&
+          AudioCommandLookup("", 0) == AUDIO_CMD_UNKNOWN, "lookup by length");
+
+    // Known commands with the wrong arguments
+    CheckFails("pa\n", 1);
+    CheckFails("pa a b\n", 1);
+    CheckFails("w\n", 1);
+    CheckFails("we 1 2\n", 1);
+    CheckFails("pp now\n", 1);
+
+    // A quoted command name is still a command
+    CHECK(ParseString(&script, &g, "\"w\" \"20\"\n", &line) == 0 &&
+          script.numCommands == 1 && script.commands[0].value == 20,
+          "quoted command");
+    AudioScriptClose(&script);
+    UnguardText(&g);
+}
+
+static void CheckUlong(const char *digits, int expected, unsigned long value)
+{
+    AudioToken token;
+    unsigned long result = 7;
+    GuardedText g;
+
+    if (GuardText(&g, digits, strlen(digits))) {
+        CHECK(0, "out of memory");
+        return;
+    }
+    token.offset = 0;
+    token.length = (unsigned int)strlen(digits);
+    CHECK(AudioTokenToUlong(g.text, &token, &result) == expected,
+          "\"%s\" not %s", digits, expected ? "rejected" : "accepted");
+    CHECK(result == (expected ? 7 : value),
+          "\"%s\" read as %lu", digits, result);
+    UnguardText(&g);
+}
+
+static void TestNumbers(void)
+{
+    char max[32], over[32], times10[48], text[96];
+    AudioScript script;
+    GuardedText g;
+    unsigned int line;
+    size_t len;
+
+    // ULONG_MAX + 1: its last digit is never 9
+    len = snprintf(max, sizeof(max), "%lu", ULONG_MAX);
+    strcpy(over, max);
+    over[len - 1]++;
+    snprintf(times10, sizeof(times10), "%s0", max);
+
+    CheckUlong("0", 0, 0);
+    CheckUlong("000123", 0, 123);
+    CheckUlong(max, 0, ULONG_MAX);
+    CheckUlong(over, -1, 0);
+    CheckUlong(times10, -1, 0);
+    CheckUlong("99999999999999999999999999", -1, 0);
+    CheckUlong("", -1, 0);
+    CheckUlong("-1", -1, 0);
+    CheckUlong("+1", -1, 0);
+    CheckUlong("12x", -1, 0);
+    CheckUlong("1 2", -1, 0);
+
+    snprintf(text, sizeof(text), "w %s\nwe %s", max, max);
+    CHECK(ParseString(&script, &g, text, &line) == 0 &&
+          script.numCommands == 2 &&
+          script.commands[0].value == ULONG_MAX &&
+          script.commands[1].value == ULONG_MAX, "ULONG_MAX in a script");
+    AudioScriptClose(&script);
+    UnguardText(&g);
+
+    snprintf(text, sizeof(text), "w 1\nwe %s\n", over);
+    CheckFails(text, 2);
+    snprintf(text, sizeof(text), "w %s", over);
+    CheckFails(text, 1);
+}
+
+static void TestNoTrailingNewline(void)
+{
+    static const struct {
+        const char *text;
+        AudioCommandType type;
+        unsigned long value;
+        const char *arg;
+    } cases[] = {
+        { "w 5",            AUDIO_CMD_WAIT,     5,  NULL },
+        { "h\nwe 250",      AUDIO_CMD_WAIT_EOS, 250, NULL },
+        { "pa x.wav",       AUDIO_CMD_PLAY,     0,  "x.wav" },
+        { "pa \"a b.wav\"", AUDIO_CMD_PLAY,     0,  "a b.wav" },
+        { "ka\r",           AUDIO_CMD_KILL,     0,  NULL },
+        { "q\n# last",      AUDIO_CMD_QUIT,     0,  NULL },
+        { "quit  \t",       AUDIO_CMD_QUIT,     0,  NULL },
+    };
+    AudioScript script;
+    AudioCommand *last;
+    GuardedText g;
+    unsigned int i, line, expected;
+    char path[] = "/tmp/test_audioscript.XXXXXX";
+    char *text;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    int fd;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        CHECK(ParseString(&script, &g, cases[i].text, &line) == 0,
+              "\"%s\" rejected", cases[i].text);
+        if (!script.numCommands) {
+            CHECK(0, "\"%s\" has no command", cases[i].text);
+        }
+        else {
+            last = &script.commands[script.numCommands - 1];
+            CHECK(last->type == cases[i].type &&
+                  last->value == cases[i].value &&
+                  (cases[i].arg ? last->arg && !strcmp(last->arg, cases[i].arg)
+                                : last->arg == NULL),
+                  "\"%s\" parsed wrong", cases[i].text);
+        }
+        AudioScriptClose(&script);
+        UnguardText(&g);
+    }
+
+    // A mapped script filling its last page, so the byte after it is
+    // not part of the mapping
+    text = malloc(page);
+    fd = mkstemp(path);
+    if (!text || fd < 0) {
+        CHECK(0, "cannot create %s", path);
+        free(text);
+        return;
+    }
+    memset(text, '\n', page);
+    memcpy(text, "# padding", 9);
+    memcpy(text + page - 4, "w 42", 4);
+    for (i = 0, line = 1; i < page - 4; i++) {
+        line += text[i] == '\n';
+    }
+    expected = line;
+    CHECK(write(fd, text, page) == (ssize_t)page, "cannot write %s", path);
+    close(fd);
+
+    CHECK(AudioScriptOpen(&script, path, &line) == 0 && script.mapped &&
+          script.numCommands == 1 && script.commands[0].value == 42 &&
+          script.commands[0].line == expected, "mapped page-sized script");
+    AudioScriptClose(&script);
+    unlink(path);
+    free(text);
+}
+
+static void BenchmarkParse(void)
+{
+    static const char *const lines[] = {
+        "# replay of a chime\n",
+        "pa \"/usr/share/sounds/a chime.wav\"\n",
+        "w 250\n",
+        "pp\n",
+        "w 100\n",
+        "pp\n",
+        "we 3000\n",
+        "ka\n",
+        "\n",
+    };
+    const unsigned int numLines = sizeof(lines) / sizeof(lines[0]);
+    AudioScript script;
+    char *text;
+    size_t size = 0;
+    unsigned int i, line, numCommands = 0;
+    double start, elapsed;
+
+    text = malloc(BENCH_LINES * 64);
+    if (!text) {
+        return;
+    }
+    for (i = 0; i < BENCH_LINES; i++) {
+        strcpy(text + size, lines[i % numLines]);
+        size += strlen(lines[i % numLines]);
+    }
+
+    start = GetTimeSec();
+    for (i = 0; i < BENCH_LOOPS; i++) {
+        if (AudioScriptParse(&script, text, size, &line)) {
+            CHECK(0, "benchmark script rejected at %u", line);
+            break;
+        }
+        numCommands = script.numCommands;
+        AudioScriptClose(&script);
+    }
+    elapsed = (GetTimeSec() - start) / BENCH_LOOPS;
+
+    printf("parse: %u lines, %u commands, %zu bytes in %.1f us: "
+           "%.0f MB/s, %.1f ns per command\n", BENCH_LINES, numCommands,
+           size, elapsed * 1e6, size / 1e6 / elapsed,
+           elapsed * 1e9 / numCommands);
+    free(text);
+}
+
+int main(int argc, char *argv[])
+{
+    TestComments();
+    TestQuotedTokens();
+    TestUnknownCommands();
+    TestNumbers();
+    TestNoTrailingNewline();
+    if (argc < 2 || strcmp(argv[1], "--no-bench")) {
+        BenchmarkParse();
+    }
+
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
@@ -59,83 +59,47 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 #include "nvearlyappdecompression.h"
 #include "nvevatypes.h"
 #include "ga_rle.h"
 #include "lzf.h"
+#include "nea_chunked.h"
 
-int DecompressToBuffer(char *pFileName, void *pOutputBuffer, U32 *pOutputSize);
+int DecompressToBuffer(char *pFileName, void *pOutputBuffer, U32 *pOutputSize, int numThreads);
 void GRLE_Deflate (unsigned char *pInput, int inputSize, unsigned char *pOutput, int *pOutputSize);
 void GRLE_Inflate(unsigned char *pInput, int inputSize, unsigned char *pOutput, int *pOutputSize);
 void DisplayUsage(void);
+void ReportChunkedDecompressRate(unsigned char *pInput, U32 inputSize, unsigned char *pOutput,
+                                 U32 originalSize, int maxThreads);
 
 // Deflate
 // File Name
 void GRLE_Deflate (unsigned char *pInput, int inputSize, unsigned char *pOutput, int *pOutputSize)
 {
-    RLA_GA_Stream encodeStream;
-    if (RLE_GA_EncodeInit(&encodeStream) == RLE_GA_OK) {
-        if (RLE_GA_EncodeReset(&encodeStream) == RLE_GA_OK) {
-            encodeStream.avail_out = *pOutputSize;
-            encodeStream.next_out = pOutput;
-            encodeStream.next_in = pInput;
-            encodeStream.avail_in = inputSize;
-            if (RLE_GA_Encode(&encodeStream,RLE_GA_STREAM_NOT_END) != RLE_GA_OK) {
-                printf("Failed to encode stream\n");
-                *pOutputSize = 0;
-                return;
-            }
-            if (RLE_GA_Encode(&encodeStream,RLE_GA_STREAM_END) == RLE_GA_STATUS_ENCODE_DONE) {
-                *pOutputSize = encodeStream.total_out;
-            } else {
-                printf("Failed to encode stream\n");
-                *pOutputSize = 0;
-            }
-            if (RLE_GA_EncodeEnd(&encodeStream) != RLE_GA_OK) {
-                printf("Failed to end stream\n");
-            }
-        } else {
-            printf("Failed to Reset encoder\n");
-            *pOutputSize = 0;
-        }
+    unsigned int outputSize = (unsigned int)*pOutputSize;
+    if (RLE_GA_EncodeBuffer(pInput, (unsigned int)inputSize, pOutput, &outputSize) == RLE_GA_STATUS_ENCODE_DONE) {
+        *pOutputSize = (int)outputSize;
     } else {
-        printf("Failed to init encoder\n");
+        printf("Failed to encode stream\n");
         *pOutputSize = 0;
     }
 }
 // Inflate
 void GRLE_Inflate(unsigned char *pInput, int inputSize, unsigned char *pOutput, int *pOutputSize)
 {
-    RLA_GA_Stream decodeStream;
-    if (RLE_GA_DecodeInit(&decodeStream) == RLE_GA_OK) {
-        if (RLE_GA_DecodeReset(&decodeStream) == RLE_GA_OK) {
-            decodeStream.avail_in = inputSize;
-            decodeStream.next_in = pInput;
-            decodeStream.avail_out = *pOutputSize;
-            decodeStream.next_out = pOutput;
-            if (RLE_GA_Decode(&decodeStream,RLE_GA_STREAM_END) == RLE_GA_STATUS_DECODE_DONE) {
-                *pOutputSize = decodeStream.total_out;
-            } else {
-                printf("Failed to decode stream\n");
-                *pOutputSize = 0;
-            }
-            if (RLE_GA_DecodeEnd(&decodeStream) != RLE_GA_OK) {
-                printf("Failed to end stream\n");
-            }
-        } else {
-            printf("Failed to Reset decoder\n");
-            *pOutputSize = 0;
-        }
+    unsigned int outputSize = (unsigned int)*pOutputSize;
+    if (RLE_GA_DecodeBuffer(pInput, (unsigned int)inputSize, pOutput, &outputSize) == RLE_GA_STATUS_DECODE_DONE) {
+        *pOutputSize = (int)outputSize;
     } else {
-        printf("Failed to init decoder\n");
+        printf("Failed to decode stream\n");
         *pOutputSize = 0;
     }
-
 }
 
 
 void DisplayUsage(void) {
-     printf("EvaRgbConverter Width Height BlackAlpha nonBlackAlpha InputFile OutputFile [EncodeType]\n");
+     printf("EvaRgbConverter Width Height BlackAlpha nonBlackAlpha InputFile OutputFile [EncodeType [Threads]]\n");
      printf("where\n");
      printf("\tWidth is width of input image\n");
      printf("\tHeight is height of input image\n");
@@ -143,9 +107,41 @@ void DisplayUsage(void) {
      printf("\tnonBlackAlpha is alpha value to use for non black (0-255)\n");
      printf("\tInputFile is a binary file with RGB data\n");
      printf("\tOutputFile is name for output file in Nvidia Early App format\n");
-     printf("\tEncodetype is RLE, LZF, or RAW (default is LZF)\n");
+     printf("\tEncodetype is RLE, LZF, LZFC, or RAW (default is LZF)\n");
+     printf("\t\tLZFC compresses %d KiB chunks independently\n", NEA_CHUNK_SIZE_DEFAULT / 1024);
+     printf("\tThreads is the number of LZFC compression threads (default is 1)\n");
  }
 
+// Decompress a chunked payload with 1, 2, 4 ... up to maxThreads threads
+// and report the throughput of each
+void ReportChunkedDecompressRate(unsigned char *pInput, U32 inputSize, unsigned char *pOutput,
+                                 U32 originalSize, int maxThreads)
+{
+    struct timespec start, end;
+    double seconds;
+    int numThreads = 1;
+    int i;
+    const int repeat = 10;
+
+    for (;;) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < repeat; i++) {
+            if (NeaChunkedDecompress(pInput, inputSize, pOutput, originalSize, numThreads) != originalSize) {
+                printf("Chunked decompression failed\n");
+                return;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("Decompression with %d thread(s): %.1f MB/s\n", numThreads,
+               (double)originalSize * repeat / seconds / (1024 * 1024));
+
+        if (numThreads == maxThreads)
+            break;
+        numThreads = (numThreads * 2 < maxThreads) ? numThreads * 2 : maxThreads;
+    }
+}
+
 int main(int argc, char* argv[])
 {
     short width = 0;
@@ -166,7 +162,8 @@ int main(int argc, char* argv[])
     char nonBlackAlpha;
     NeaFileHeader  fileHeader;
     int readSize, newSize, j;
-    if (argc != 7 && argc != 8) {
+    int numThreads = 1;
+    if (argc < 7 || argc > 9) {
         DisplayUsage();
         return -1;;
     }
@@ -201,19 +198,28 @@ int main(int argc, char* argv[])
 
     fileNameInput = argv[5];
     fileNameOutput = argv[6];
-    if (argc == 8) {
+    if (argc >= 8) {
         if (strcmp("RLE",argv[7]) == 0)
             encodeType = NEA_TYPE_GRLE;
         else if (strcmp("RAW",argv[7]) == 0)
             encodeType = NEA_TYPE_RAW;
         else if (strcmp("LZF",argv[7]) == 0)
             encodeType = NEA_TYPE_LZF;
+        else if (strcmp("LZFC",argv[7]) == 0)
+            encodeType = NEA_TYPE_LZF_CHUNKED;
         else {
             printf("Illegal encode type choice\n");
             return -1;
         }
 
     }
+    if (argc == 9) {
+        numThreads = atoi(argv[8]);
+        if (numThreads < 1 || numThreads > NEA_CHUNK_MAX_THREADS) {
+            printf("Illegal value for threads %d\n",numThreads);
+            return -1;
+        }
+    }
 
     imageSizePixels = width*height;
     if (imageSizePixels == 0) {
@@ -222,6 +228,9 @@ int main(int argc, char* argv[])
     pRgbBuffer = (unsigned char *) malloc(width*height*3);
     pRgbaBuffer = (unsigned char *) malloc(width*height*4);
     outputSizeMax = outputSize = 5*width*height; // More than output could ever be;
+    // except the chunked payload of a tiny image, which carries its chunk table
+    if (outputSizeMax < (int) NeaChunkedMaxSize(imageSizePixels*4, NEA_CHUNK_SIZE_DEFAULT))
+        outputSizeMax = outputSize = (int) NeaChunkedMaxSize(imageSizePixels*4, NEA_CHUNK_SIZE_DEFAULT);
     pOutputBuffer = (unsigned char *) malloc(outputSize);
     if (!pRgbBuffer || !pRgbaBuffer || !pOutputBuffer) {
         printf("ran out of memory\n");
@@ -254,6 +263,20 @@ int main(int argc, char* argv[])
                     case NEA_TYPE_GRLE:
                         GRLE_Deflate(pRgbaBuffer,newSize,pOutputBuffer,&outputSize);
                         break;
+                    case NEA_TYPE_LZF_CHUNKED:
+                        outputSize = (int) NeaChunkedCompress(pRgbaBuffer,(U32)newSize,pOutputBuffer,(U32)outputSize,
+                                                              NEA_CHUNK_SIZE_DEFAULT,numThreads);
+                        if (outputSize == 0) {
+                            printf("Chunked LZF compression failed\n");
+                            fclose(fpOutput);
+                            remove(fileNameOutput);
+                            fclose(fpInput);
+                            free(pRgbaBuffer);
+                            free(pRgbBuffer);
+                            free(pOutputBuffer);
+                            return -1;
+                        }
+                        break;
                     case NEA_TYPE_RAW:
                         memcpy(pOutputBuffer,pRgbaBuffer,newSize);
                         outputSize = newSize;
@@ -279,8 +302,17 @@ int main(int argc, char* argv[])
                 if (fpOutput)
                     fclose(fpOutput);
 
+                if (encodeType == NEA_TYPE_LZF_CHUNKED) {
+                    unsigned char *pScratch = (unsigned char *) malloc(newSize);
+                    if (pScratch) {
+                        ReportChunkedDecompressRate(pOutputBuffer,outputSize,pScratch,newSize,
+                                                    numThreads);
+                        free(pScratch);
+                    }
+                }
+
                 outputSize = outputSizeMax;
-                if (DecompressToBuffer((char*)argv[6], (void*)pOutputBuffer, (U32*)&outputSize) != RESULT_OK) {
+                if (DecompressToBuffer((char*)argv[6], (void*)pOutputBuffer, (U32*)&outputSize, numThreads) != RESULT_OK) {
                     printf("DecompressToBuffer failed\n");
                 }
                 if (outputSize != newSize) {
@@ -307,7 +339,7 @@ int main(int argc, char* argv[])
     return 0;
 }
 
-int DecompressToBuffer(char *pFileName, void *pOutputBuffer, U32 *pOutputSize) {
+int DecompressToBuffer(char *pFileName, void *pOutputBuffer, U32 *pOutputSize, int numThreads) {
     FILE *fpInput;
     NeaFileHeader fileHeader;
     fpInput = fopen(pFileName,"rb");
@@ -320,6 +352,7 @@ int DecompressToBuffer(char *pFileName, void *pOutputBuffer, U32 *pOutputSize) {
                     switch(fileHeader.type) {
                         case NEA_TYPE_LZF:
                         case NEA_TYPE_GRLE:
+                        case NEA_TYPE_LZF_CHUNKED:
                             pTemp = (U8 *) malloc(fileHeader.dataLengthCompressed);
                             if (pTemp) {
                                 if (fread(pTemp,1,fileHeader.dataLengthCompressed,fpInput) == fileHeader.dataLengthCompressed) {
@@ -328,6 +361,11 @@ int DecompressToBuffer(char *pFileName, void *pOutputBuffer, U32 *pOutputSize) {
                                             *pOutputSize = fileHeader.dataLengthOriginal;
                                             nResult = RESULT_OK;
                                         }
+                                    } else if (fileHeader.type == NEA_TYPE_LZF_CHUNKED) {
+                                        if (NeaChunkedDecompress(pTemp,fileHeader.dataLengthCompressed,(U8 *)pOutputBuffer,fileHeader.dataLengthOriginal,numThreads) == fileHeader.dataLengthOriginal) {
+                                            *pOutputSize = fileHeader.dataLengthOriginal;
+                                            nResult = RESULT_OK;
+                                        }
                                     } else {
                                         GRLE_Inflate(pTemp,fileHeader.dataLengthCompressed,(unsigned char *) pOutputBuffer,(int *)pOutputSize);
                                         if (*pOutputSize == fileHeader.dataLengthOriginal)
@@ -55,8 +55,16 @@
 //------------------------------------------------------------------------------
 
 #include <string.h>
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
 #include "ga_rle.h"
 
+#define RLE_GA_MAX_RUN 127
+
 static void clearState(RLA_GA_Stream *pStream)
 {
     pStream->next_in = NULL;  /* next input byte */
@@ -453,3 +461,246 @@ RLE_GA_Status RLE_GA_DecodeEnd(RLA_GA_Stream *pDecodeStream)
     }
     return RLE_GA_ERROR_INVALID_INPUT;
 }
+
+//------------------------------------------------------------------------------
+// Whole buffer fast path.
+//
+// Produces the same bitstream as running RLE_GA_Encode once with
+// RLE_GA_STREAM_END over the whole input, but works on 32-bit pixels:
+// runs and literal spans are found with wide compares and literals are
+// copied with memcpy. The rules mirrored from the state machine are:
+//  - a run of 2..127 equal pixels is written as 0x80|count + pixel
+//  - a literal span ends right before the first two adjacent equal pixels,
+//    after 127 pixels, or at the end of the input; it is written as
+//    count + pixels
+//  - a single trailing pixel is written as a literal of 1
+//------------------------------------------------------------------------------
+
+static uint32_t loadPixel(const unsigned char *p)
+{
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+// Number of leading pixels of p equal to value, up to max
+static unsigned int countEqualPixels(const unsigned char *p, uint32_t value, unsigned int max)
+{
+    unsigned int count = 0;
+
+#if defined(__SSE2__)
+    __m128i ref = _mm_set1_epi32((int)value);
+    while (count + 4 <= max)
+    {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(p + count * 4)), ref));
+        if (mask != 0xFFFF)
+        {
+            while (mask & 0xF)
+            {
+                mask >>= 4;
+                count++;
+            }
+            return count;
+        }
+        count += 4;
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint32x4_t ref = vdupq_n_u32(value);
+    while (count + 4 <= max)
+    {
+        uint32x4_t eq = vceqq_u32(vreinterpretq_u32_u8(vld1q_u8(p + count * 4)), ref);
+        uint64x2_t eq64 = vreinterpretq_u64_u32(eq);
+        if ((vgetq_lane_u64(eq64, 0) & vgetq_lane_u64(eq64, 1)) != UINT64_MAX)
+            break;
+        count += 4;
+    }
+#else
+    uint64_t ref = ((uint64_t)value << 32) | value;
+    while (count + 2 <= max)
+    {
+        uint64_t pair;
+        memcpy(&pair, p + count * 4, 8);
+        if (pair != ref)
+            break;
+        count += 2;
+    }
+#endif
+    while (count < max && loadPixel(p + count * 4) == value)
+        count++;
+    return count;
+}
+
+// Index of the first pixel k in [start, end) equal to pixel k-1, or end
+static unsigned int findAdjacentEqual(const unsigned char *p, unsigned int start, unsigned int end)
+{
+    unsigned int k = start;
+
+#if defined(__SSE2__)
+    while (k + 4 <= end)
+    {
+        __m128i cur = _mm_loadu_si128((const __m128i *)(p + k * 4));
+        __m128i prev = _mm_loadu_si128((const __m128i *)(p + (k - 1) * 4));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(cur, prev)))
+            break;
+        k += 4;
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    while (k + 4 <= end)
+    {
+        uint32x4_t eq = vceqq_u32(vreinterpretq_u32_u8(vld1q_u8(p + k * 4)),
+                                  vreinterpretq_u32_u8(vld1q_u8(p + (k - 1) * 4)));
+        uint64x2_t eq64 = vreinterpretq_u64_u32(eq);
+        if (vgetq_lane_u64(eq64, 0) | vgetq_lane_u64(eq64, 1))
+            break;
+        k += 4;
+    }
+#else
+    while (k + 2 <= end)
+    {
+        uint64_t cur, prev;
+        memcpy(&cur, p + k * 4, 8);
+        memcpy(&prev, p + (k - 1) * 4, 8);
+        // any 32-bit half equal
+        if ((uint32_t)(cur ^ prev) == 0 || ((cur ^ prev) >> 32) == 0)
+            break;
+        k += 2;
+    }
+#endif
+    while (k < end && loadPixel(p + k * 4) != loadPixel(p + (k - 1) * 4))
+        k++;
+    return k;
+}
+
+// Fill count pixels at p with value
+static void fillPixels(unsigned char *p, const unsigned char *value, unsigned int count)
+{
+    unsigned int i = 0;
+
+#if defined(__SSE2__)
+    __m128i v = _mm_set1_epi32((int)loadPixel(value));
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_si128((__m128i *)(p + i * 4), v);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint8x16_t v = vreinterpretq_u8_u32(vdupq_n_u32(loadPixel(value)));
+    for (; i + 4 <= count; i += 4)
+        vst1q_u8(p + i * 4, v);
+#endif
+    for (; i < count; i++)
+        memcpy(p + i * 4, value, 4);
+}
+
+// Streaming encoder over a whole buffer, used for inputs that are not a
+// whole number of pixels
+static RLE_GA_Status encodeBufferStream(const unsigned char *pInput, unsigned int inputSize,
+                                        unsigned char *pOutput, unsigned int *pOutputSize)
+{
+    RLA_GA_Stream stream;
+    RLE_GA_Status status;
+
+    RLE_GA_EncodeInit(&stream);
+    stream.next_in = (unsigned char *)pInput;
+    stream.avail_in = inputSize;
+    stream.next_out = pOutput;
+    stream.avail_out = *pOutputSize;
+    status = RLE_GA_Encode(&stream, RLE_GA_STREAM_END);
+    *pOutputSize = (unsigned int)stream.total_out;
+    RLE_GA_EncodeEnd(&stream);
+    return status;
+}
+
+RLE_GA_Status RLE_GA_EncodeBuffer(const unsigned char *pInput, unsigned int inputSize,
+                                  unsigned char *pOutput, unsigned int *pOutputSize)
+{
+    unsigned int numPixels, pos = 0;
+    unsigned int outPos = 0, outSize;
+    unsigned int count, k, end;
+
+    if (!pInput || !pOutput || !pOutputSize)
+        return RLE_GA_ERROR_INVALID_INPUT;
+    if (inputSize == 0)
+    {
+        *pOutputSize = 0;
+        return RLE_GA_STATUS_ENCODE_DONE;
+    }
+    if (inputSize & 0x3)
+        return encodeBufferStream(pInput, inputSize, pOutput, pOutputSize);
+
+    outSize = *pOutputSize;
+    numPixels = inputSize / 4;
+    while (pos < numPixels)
+    {
+        if (pos + 1 < numPixels && loadPixel(pInput + (pos + 1) * 4) == loadPixel(pInput + pos * 4))
+        {
+            // Compressed run
+            end = numPixels - pos < RLE_GA_MAX_RUN ? numPixels - pos : RLE_GA_MAX_RUN;
+            count = 2 + countEqualPixels(pInput + (pos + 2) * 4, loadPixel(pInput + pos * 4), end - 2);
+            if (outSize - outPos < 5)
+                break;
+            pOutput[outPos] = (unsigned char)(0x80 | count);
+            memcpy(pOutput + outPos + 1, pInput + pos * 4, 4);
+            outPos += 5;
+        }
+        else
+        {
+            // Literal span, ends before the first pair of equal pixels
+            end = numPixels - pos < RLE_GA_MAX_RUN ? numPixels - pos : RLE_GA_MAX_RUN;
+            k = end > 2 ? findAdjacentEqual(pInput + pos * 4, 2, end) : end;
+            count = k < end ? k - 1 : end;
+            if (outSize - outPos < 1 + count * 4)
+                break;
+            pOutput[outPos] = (unsigned char)count;
+            memcpy(pOutput + outPos + 1, pInput + pos * 4, count * 4);
+            outPos += 1 + count * 4;
+        }
+        pos += count;
+    }
+
+    *pOutputSize = outPos;
+    return pos == numPixels ? RLE_GA_STATUS_ENCODE_DONE : RLE_GA_STATUS_OUTPUT_FULL;
+}
+
+RLE_GA_Status RLE_GA_DecodeBuffer(const unsigned char *pInput, unsigned int inputSize,
+                                  unsigned char *pOutput, unsigned int *pOutputSize)
+{
+    unsigned int inPos = 0, outPos = 0, outSize;
+    unsigned int count;
+    unsigned char header;
+
+    if (!pInput || !pOutput || !pOutputSize)
+        return RLE_GA_ERROR_INVALID_INPUT;
+
+    outSize = *pOutputSize;
+    while (inPos < inputSize)
+    {
+        header = pInput[inPos++];
+        count = (header & 0x7F) * 4;
+        if (count == 0)
+            continue;
+        if (outSize - outPos < count)
+        {
+            *pOutputSize = outPos;
+            return RLE_GA_STATUS_OUTPUT_FULL;
+        }
+        // The header has been consumed, so a truncated token must be
+        // reported here rather than by comparing inPos with inputSize
+        if (inputSize - inPos < ((header & 0x80) ? 4 : count))
+        {
+            *pOutputSize = outPos;
+            return RLE_GA_ERROR_INVALID_INPUT;
+        }
+        if (header & 0x80)
+        {
+            fillPixels(pOutput + outPos, pInput + inPos, count / 4);
+            inPos += 4;
+        }
+        else
+        {
+            memcpy(pOutput + outPos, pInput + inPos, count);
+            inPos += count;
+        }
+        outPos += count;
+    }
+
+    *pOutputSize = outPos;
+    return RLE_GA_STATUS_DECODE_DONE;
+}
@@ -140,4 +140,21 @@ RLE_GA_Status RLE_GA_DecodeInit(RLA_GA_Stream *pStream);
 RLE_GA_Status RLE_GA_DecodeReset(RLA_GA_Stream *pDecodeStream);
 RLE_GA_Status RLE_GA_Decode(RLA_GA_Stream *pDecodeStream, RLE_GA_StreamState eStreamState);
 RLE_GA_Status RLE_GA_DecodeEnd(RLA_GA_Stream *pDecodeStream);
+
+// One shot encode/decode of a whole buffer, producing/accepting the same
+// bitstream as the stream functions. *pOutputSize holds the output buffer
+// size on entry and the number of bytes written on return. They return
+// RLE_GA_STATUS_ENCODE_DONE/RLE_GA_STATUS_DECODE_DONE on success.
+//
+// The encoder writes the bytes of a single RLE_GA_Encode call with
+// RLE_GA_STREAM_END. An RLE_GA_STREAM_NOT_END call followed by an
+// RLE_GA_STREAM_END call gives the same bytes, except when the last run or
+// literal span is exactly 127 pixels (e.g. 127 or 254 equal pixels): the
+// second call then writes an empty literal followed by bytes from past its
+// run buffer until RLE_GA_STATUS_OUTPUT_FULL. The buffer encoder ends the
+// stream after the 127 pixel token. An empty input gives an empty stream.
+RLE_GA_Status RLE_GA_EncodeBuffer(const unsigned char *pInput, unsigned int inputSize,
+                                  unsigned char *pOutput, unsigned int *pOutputSize);
+RLE_GA_Status RLE_GA_DecodeBuffer(const unsigned char *pInput, unsigned int inputSize,
+                                  unsigned char *pOutput, unsigned int *pOutputSize);
 #endif
@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2012, NVIDIA Corporation.  All Rights Reserved.
+ *
+ * BY INSTALLING THE SOFTWARE THE USER AGREES TO THE TERMS BELOW.
+ *
+ * User agrees to use the software under carefully controlled conditions
+ * and to inform all employees and contractors who have access to the software
+ * that the source code of the software is confidential and proprietary
+ * information of NVIDIA and is licensed to user as such.  User acknowledges
+ * and agrees that protection of the source code is essential and user shall
+ * retain the source code in strict confidence.  User shall restrict access to
+ * the source code of the software to those employees and contractors of user
+ * who have agreed to be bound by a confidentiality obligation which
+ * incorporates the protections and restrictions substantially set forth
+ * herein, and who have a need to access the source code in order to carry out
+ * the business purpose between NVIDIA and user.  The software provided
+ * herewith to user may only be used so long as the software is used solely
+ * with NVIDIA products and no other third party products (hardware or
+ * software).   The software must carry the NVIDIA copyright notice shown
+ * above.  User must not disclose, copy, duplicate, reproduce, modify,
+ * publicly display, create derivative works of the software other than as
+ * expressly authorized herein.  User must not under any circumstances,
+ * distribute or in any way disseminate the information contained in the
+ * source code and/or the source code itself to third parties except as
+ * expressly agreed to by NVIDIA.  In the event that user discovers any bugs
+ * in the software, such bugs must be reported to NVIDIA and any fixes may be
+ * inserted into the source code of the software by NVIDIA only.  User shall
+ * not modify the source code of the software in any way.  User shall be fully
+ * responsible for the conduct of all of its employees, contractors and
+ * representatives who may in any way violate these restrictions.
+ *
+ * NO WARRANTY
+ * THE ACCOMPANYING SOFTWARE (INCLUDING OBJECT AND SOURCE CODE) PROVIDED BY
+ * NVIDIA TO USER IS PROVIDED "AS IS."  NVIDIA DISCLAIMS ALL WARRANTIES,
+ * EXPRESS, IMPLIED OR STATUTORY, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF TITLE, MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.
+
+ * LIMITATION OF LIABILITY
+ * NVIDIA SHALL NOT BE LIABLE TO USER, USERS CUSTOMERS, OR ANY OTHER PERSON
+ * OR ENTITY CLAIMING THROUGH OR UNDER USER FOR ANY LOSS OF PROFITS, INCOME,
+ * SAVINGS, OR ANY OTHER CONSEQUENTIAL, INCIDENTAL, SPECIAL, PUNITIVE, DIRECT
+ * OR INDIRECT DAMAGES (WHETHER IN AN ACTION IN CONTRACT, TORT OR BASED ON A
+ * WARRANTY), EVEN IF NVIDIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGES.  THESE LIMITATIONS SHALL APPLY NOTWITHSTANDING ANY FAILURE OF THE
+ * ESSENTIAL PURPOSE OF ANY LIMITED REMEDY.  IN NO EVENT SHALL NVIDIAS
+ * AGGREGATE LIABILITY TO USER OR ANY OTHER PERSON OR ENTITY CLAIMING THROUGH
+ * OR UNDER USER EXCEED THE AMOUNT OF MONEY ACTUALLY PAID BY USER TO NVIDIA
+ * FOR THE SOFTWARE PROVIDED HEREWITH.
+ */
+
+//------------------------------------------------------------------------------
+//! \file nea_chunked.c
+//! \brief Parallel compressor/decompressor for chunked LZF NEA payloads.
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "nea_chunked.h"
+#include "lzf.h"
+
+typedef struct NeaChunkJob_s NeaChunkJob;
+typedef int (*NeaChunkFunc)(NeaChunkJob *pJob, U32 index);
+
+struct NeaChunkJob_s {
+    const U8 *pInput;
+    U32 inputSize;          // original (uncompressed) size
+    U8 *pOutput;
+    U32 chunkSize;
+    U32 numChunks;
+    NeaChunkEntry *pEntries;
+    const U8 *pData;        // start of chunk data (decompression)
+    NeaChunkFunc pfnChunk;
+    pthread_mutex_t lock;
+    U32 nextChunk;
+    int failed;
+};
+
+static U32 s_crcTable[256];
+static pthread_once_t s_crcOnce = PTHREAD_ONCE_INIT;
+
+static void CrcInit(void)
+{
+    U32 c;
+    int i, k;
+
+    for (i = 0; i < 256; i++) {
+        c = (U32)i;
+        for (k = 0; k < 8; k++)
+            c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+        s_crcTable[i] = c;
+    }
+}
+
+static U32 Crc32(const U8 *pData, U32 size)
+{
+    U32 c = 0xFFFFFFFF;
+
+    pthread_once(&s_crcOnce, CrcInit);
+    while (size--)
+        c = s_crcTable[(c ^ *pData++) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFF;
+}
+
+static U32 ChunkRawSize(NeaChunkJob *pJob, U32 index)
+{
+    if (index == pJob->numChunks - 1)
+        return pJob->inputSize - index * pJob->chunkSize;
+    return pJob->chunkSize;
+}
+
+// Compress chunk "index" into its own chunkSize slot of the output data
+// area; slots are packed together once all chunks are done.
+static int CompressChunk(NeaChunkJob *pJob, U32 index)
+{
+    U32 rawSize = ChunkRawSize(pJob, index);
+    const U8 *pSrc = pJob->pInput + index * pJob->chunkSize;
+    U8 *pDst = pJob->pOutput + index * pJob->chunkSize;
+    U32 size = 0;
+
+    if (rawSize > 1)
+        size = lzf_compress(pSrc, rawSize, pDst, rawSize - 1);
+    if (size == 0) {
+        // Incompressible, store as is
+        memcpy(pDst, pSrc, rawSize);
+        size = rawSize;
+    }
+    pJob->pEntries[index].compressedSize = size;
+    pJob->pEntries[index].crc = Crc32(pDst, size);
+    return 0;
+}
+
+static int DecompressChunk(NeaChunkJob *pJob, U32 index)
+{
+    U32 rawSize = ChunkRawSize(pJob, index);
+    NeaChunkEntry *pEntry = &pJob->pEntries[index];
+    const U8 *pSrc = pJob->pData + pEntry->offset;
+    U8 *pDst = pJob->pOutput + index * pJob->chunkSize;
+
+    if (Crc32(pSrc, pEntry->compressedSize) != pEntry->crc) {
+        printf("CRC mismatch in chunk %u\n", index);
+        return -1;
+    }
+    if (pEntry->compressedSize == rawSize) {
+        memcpy(pDst, pSrc, rawSize);
+        return 0;
+    }
+    if (lzf_decompress(pSrc, pEntry->compressedSize, pDst, rawSize) != rawSize) {
+        printf("Failed to decompress chunk %u\n", index);
+        return -1;
+    }
+    return 0;
+}
+
+static void *ChunkWorker(void *pArg)
+{
+    NeaChunkJob *pJob = (NeaChunkJob *)pArg;
+    U32 index;
+
+    for (;;) {
+        pthread_mutex_lock(&pJob->lock);
+        if (pJob->failed || pJob->nextChunk == pJob->numChunks) {
+            pthread_mutex_unlock(&pJob->lock);
+            break;
+        }
+        index = pJob->nextChunk++;
+        pthread_mutex_unlock(&pJob->lock);
+
+        if (pJob->pfnChunk(pJob, index) != 0) {
+            pthread_mutex_lock(&pJob->lock);
+            pJob->failed = 1;
+            pthread_mutex_unlock(&pJob->lock);
+        }
+    }
+    return NULL;
+}
+
+// Run pfnChunk over all chunks on up to numThreads threads, the calling
+// thread included. Returns 0 if every chunk succeeded.
+static int RunChunkJob(NeaChunkJob *pJob, int numThreads)
+{
+    pthread_t threads[NEA_CHUNK_MAX_THREADS];
+    int numStarted = 0;
+    int i;
+
+    if (numThreads > NEA_CHUNK_MAX_THREADS)
+        numThreads = NEA_CHUNK_MAX_THREADS;
+    if ((U32)numThreads > pJob->numChunks)
+        numThreads = (int)pJob->numChunks;
+
+    pthread_mutex_init(&pJob->lock, NULL);
+    pJob->nextChunk = 0;
+    pJob->failed = 0;
+
+    for (i = 1; i < numThreads; i++) {
+        if (pthread_create(&threads[numStarted], NULL, ChunkWorker, pJob) != 0)
+            break;
+        numStarted++;
+    }
+    ChunkWorker(pJob);
+    for (i = 0; i < numStarted; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_mutex_destroy(&pJob->lock);
+    return pJob->failed ? -1 : 0;
+}
+
+U32 NeaChunkedMaxSize(U32 inputSize, U32 chunkSize)
+{
+    U32 numChunks = (inputSize + chunkSize - 1) / chunkSize;
+
+    return sizeof(NeaChunkHeader) + numChunks * sizeof(NeaChunkEntry) + inputSize;
+}
+
+U32 NeaChunkedCompress(const U8 *pInput, U32 inputSize, U8 *pOutput, U32 outputSize,
+                       U32 chunkSize, int numThreads)
+{
+    NeaChunkHeader *pHeader = (NeaChunkHeader *)pOutput;
+    NeaChunkJob job;
+    U8 *pData;
+    U32 dataSize = 0;
+    U32 i;
+
+    if (!pInput || !pOutput || !inputSize ||
+        chunkSize < NEA_CHUNK_SIZE_MIN || chunkSize > NEA_CHUNK_SIZE_MAX ||
+        outputSize < NeaChunkedMaxSize(inputSize, chunkSize))
+        return 0;
+
+    memset(&job, 0, sizeof(job));
+    job.pInput = pInput;
+    job.inputSize = inputSize;
+    job.chunkSize = chunkSize;
+    job.numChunks = (inputSize + chunkSize - 1) / chunkSize;
+    job.pEntries = (NeaChunkEntry *)(pOutput + sizeof(NeaChunkHeader));
+    job.pOutput = pData = (U8 *)(job.pEntries + job.numChunks);
+    job.pfnChunk = CompressChunk;
+
+    if (RunChunkJob(&job, numThreads) != 0)
+        return 0;
+
+    // Pack the chunks together; slots only ever move down
+    for (i = 0; i < job.numChunks; i++) {
+        job.pEntries[i].offset = dataSize;
+        if (dataSize != i * chunkSize)
+            memmove(pData + dataSize, pData + i * chunkSize, job.pEntries[i].compressedSize);
+        dataSize += job.pEntries[i].compressedSize;
+    }
+
+    pHeader->chunkSize = chunkSize;
+    pHeader->numChunks = job.numChunks;
+    return (U32)(pData - pOutput) + dataSize;
+}
+
+U32 NeaChunkedDecompress(const U8 *pInput, U32 inputSize, U8 *pOutput, U32 originalSize,
+                         int numThreads)
+{
+    const NeaChunkHeader *pHeader = (const NeaChunkHeader *)pInput;
+    NeaChunkJob job;
+    U32 tableSize, dataSize;
+    U32 i;
+
+    if (!pInput || !pOutput || !originalSize || inputSize < sizeof(NeaChunkHeader))
+        return 0;
+    if (pHeader->chunkSize < NEA_CHUNK_SIZE_MIN || pHeader->chunkSize > NEA_CHUNK_SIZE_MAX ||
+        pHeader->numChunks != (originalSize + pHeader->chunkSize - 1) / pHeader->chunkSize)
+        return 0;
+
+    tableSize = sizeof(NeaChunkHeader) + pHeader->numChunks * sizeof(NeaChunkEntry);
+    if (tableSize > inputSize)
+        return 0;
+    dataSize = inputSize - tableSize;
+
+    memset(&job, 0, sizeof(job));
+    job.pOutput = pOutput;
+    job.inputSize = originalSize;
+    job.chunkSize = pHeader->chunkSize;
+    job.numChunks = pHeader->numChunks;
+    job.pEntries = (NeaChunkEntry *)(pInput + sizeof(NeaChunkHeader));
+    job.pData = pInput + tableSize;
+    job.pfnChunk = DecompressChunk;
+
+    for (i = 0; i < job.numChunks; i++) {
+        if (job.pEntries[i].offset > dataSize ||
+            job.pEntries[i].compressedSize > dataSize - job.pEntries[i].offset ||
+            job.pEntries[i].compressedSize > ChunkRawSize(&job, i))
+            return 0;
+    }
+
+    if (RunChunkJob(&job, numThreads) != 0)
+        return 0;
+    return originalSize;
+}
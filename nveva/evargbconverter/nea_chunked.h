@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2012, NVIDIA Corporation.  All Rights Reserved.
+ *
+ * BY INSTALLING THE SOFTWARE THE USER AGREES TO THE TERMS BELOW.
+ *
+ * User agrees to use the software under carefully controlled conditions
+ * and to inform all employees and contractors who have access to the software
+ * that the source code of the software is confidential and proprietary
+ * information of NVIDIA and is licensed to user as such.  User acknowledges
+ * and agrees that protection of the source code is essential and user shall
+ * retain the source code in strict confidence.  User shall restrict access to
+ * the source code of the software to those employees and contractors of user
+ * who have agreed to be bound by a confidentiality obligation which
+ * incorporates the protections and restrictions substantially set forth
+ * herein, and who have a need to access the source code in order to carry out
+ * the business purpose between NVIDIA and user.  The software provided
+ * herewith to user may only be used so long as the software is used solely
+ * with NVIDIA products and no other third party products (hardware or
+ * software).   The software must carry the NVIDIA copyright notice shown
+ * above.  User must not disclose, copy, duplicate, reproduce, modify,
+ * publicly display, create derivative works of the software other than as
+ * expressly authorized herein.  User must not under any circumstances,
+ * distribute or in any way disseminate the information contained in the
+ * source code and/or the source code itself to third parties except as
+ * expressly agreed to by NVIDIA.  In the event that user discovers any bugs
+ * in the software, such bugs must be reported to NVIDIA and any fixes may be
+ * inserted into the source code of the software by NVIDIA only.  User shall
+ * not modify the source code of the software in any way.  User shall be fully
+ * responsible for the conduct of all of its employees, contractors and
+ * representatives who may in any way violate these restrictions.
+ *
+ * NO WARRANTY
+ * THE ACCOMPANYING SOFTWARE (INCLUDING OBJECT AND SOURCE CODE) PROVIDED BY
+ * NVIDIA TO USER IS PROVIDED "AS IS."  NVIDIA DISCLAIMS ALL WARRANTIES,
+ * EXPRESS, IMPLIED OR STATUTORY, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF TITLE, MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.
+
+ * LIMITATION OF LIABILITY
+ * NVIDIA SHALL NOT BE LIABLE TO USER, USERS CUSTOMERS, OR ANY OTHER PERSON
+ * OR ENTITY CLAIMING THROUGH OR UNDER USER FOR ANY LOSS OF PROFITS, INCOME,
+ * SAVINGS, OR ANY OTHER CONSEQUENTIAL, INCIDENTAL, SPECIAL, PUNITIVE, DIRECT
+ * OR INDIRECT DAMAGES (WHETHER IN AN ACTION IN CONTRACT, TORT OR BASED ON A
+ * WARRANTY), EVEN IF NVIDIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGES.  THESE LIMITATIONS SHALL APPLY NOTWITHSTANDING ANY FAILURE OF THE
+ * ESSENTIAL PURPOSE OF ANY LIMITED REMEDY.  IN NO EVENT SHALL NVIDIAS
+ * AGGREGATE LIABILITY TO USER OR ANY OTHER PERSON OR ENTITY CLAIMING THROUGH
+ * OR UNDER USER EXCEED THE AMOUNT OF MONEY ACTUALLY PAID BY USER TO NVIDIA
+ * FOR THE SOFTWARE PROVIDED HEREWITH.
+ */
+
+//------------------------------------------------------------------------------
+//! \file nea_chunked.h
+//! \brief Chunked LZF payload for Nvidia Early App files.
+//!
+//! The image is split in fixed size chunks that are LZF compressed
+//! independently, so they can be compressed and decompressed in parallel.
+//! The payload following the NeaFileHeader is laid out as:
+//!
+//!   NeaChunkHeader
+//!   NeaChunkEntry[numChunks]
+//!   chunk data, at NeaChunkEntry.offset from the end of the entry table
+//!
+//! A chunk whose compressed size equals its original size is stored as is.
+//------------------------------------------------------------------------------
+
+#ifndef NEA_CHUNKED_H
+#define NEA_CHUNKED_H
+
+#include "nvevatypes.h"
+
+#ifndef NEA_TYPE_LZF_CHUNKED
+#define NEA_TYPE_LZF_CHUNKED        0x10
+#endif
+
+#define NEA_CHUNK_SIZE_MIN          (64 * 1024)
+#define NEA_CHUNK_SIZE_MAX          (256 * 1024)
+#define NEA_CHUNK_SIZE_DEFAULT      (128 * 1024)
+#define NEA_CHUNK_MAX_THREADS       32
+
+typedef struct {
+    U32 chunkSize;      // original size of every chunk but the last
+    U32 numChunks;
+} NeaChunkHeader;
+
+typedef struct {
+    U32 offset;         // from the end of the entry table
+    U32 compressedSize;
+    U32 crc;            // CRC32 of the stored chunk data
+} NeaChunkEntry;
+
+//! Upper bound of the chunked payload size for inputSize bytes
+U32 NeaChunkedMaxSize(U32 inputSize, U32 chunkSize);
+
+//! Compress pInput into a chunked payload using numThreads threads.
+//! Returns the payload size, or 0 on failure.
+U32 NeaChunkedCompress(const U8 *pInput, U32 inputSize, U8 *pOutput, U32 outputSize,
+                       U32 chunkSize, int numThreads);
+
+//! Decompress a chunked payload of originalSize bytes into pOutput using
+//! numThreads threads. Returns originalSize, or 0 on failure (bad table,
+//! CRC or data).
+U32 NeaChunkedDecompress(const U8 *pInput, U32 inputSize, U8 *pOutput, U32 originalSize,
+                         int numThreads);
+
+#endif
@@ -0,0 +1,463 @@
+/*
+ * Copyright (c) 2012, NVIDIA Corporation.  All Rights Reserved.
+ *
+ * BY INSTALLING THE SOFTWARE THE USER AGREES TO THE TERMS BELOW.
+ *
+ * User agrees to use the software under carefully controlled conditions
+ * and to inform all employees and contractors who have access to the software
+ * that the source code of the software is confidential and proprietary
+ * information of NVIDIA and is licensed to user as such.  User acknowledges
+ * and agrees that protection of the source code is essential and user shall
+ * retain the source code in strict confidence.  User shall restrict access to
+ * the source code of the software to those employees and contractors of user
+ * who have agreed to be bound by a confidentiality obligation which
+ * incorporates the protections and restrictions substantially set forth
+ * herein, and who have a need to access the source code in order to carry out
+ * the business purpose between NVIDIA and user.  The software provided
+ * herewith to user may only be used so long as the software is used solely
+ * with NVIDIA products and no other third party products (hardware or
+ * software).   The software must carry the NVIDIA copyright notice shown
+ * above.  User must not disclose, copy, duplicate, reproduce, modify,
+ * publicly display, create derivative works of the software other than as
+ * expressly authorized herein.  User must not under any circumstances,
+ * distribute or in any way disseminate the information contained in the
+ * source code and/or the source code itself to third parties except as
+ * expressly agreed to by NVIDIA.  In the event that user discovers any bugs
+ * in the software, such bugs must be reported to NVIDIA and any fixes may be
+ * inserted into the source code of the software by NVIDIA only.  User shall
+ * not modify the source code of the software in any way.  User shall be fully
+ * responsible for the conduct of all of its employees, contractors and
+ * representatives who may in any way violate these restrictions.
+ *
+ * NO WARRANTY
+ * THE ACCOMPANYING SOFTWARE (INCLUDING OBJECT AND SOURCE CODE) PROVIDED BY
+ * NVIDIA TO USER IS PROVIDED "AS IS."  NVIDIA DISCLAIMS ALL WARRANTIES,
+ * EXPRESS, IMPLIED OR STATUTORY, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF TITLE, MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.
+
+ * LIMITATION OF LIABILITY
+ * NVIDIA SHALL NOT BE LIABLE TO USER, USERS CUSTOMERS, OR ANY OTHER PERSON
+ * OR ENTITY CLAIMING THROUGH OR UNDER USER FOR ANY LOSS OF PROFITS, INCOME,
+ * SAVINGS, OR ANY OTHER CONSEQUENTIAL, INCIDENTAL, SPECIAL, PUNITIVE, DIRECT
+ * OR INDIRECT DAMAGES (WHETHER IN AN ACTION IN CONTRACT, TORT OR BASED ON A
+ * WARRANTY), EVEN IF NVIDIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGES.  THESE LIMITATIONS SHALL APPLY NOTWITHSTANDING ANY FAILURE OF THE
+ * ESSENTIAL PURPOSE OF ANY LIMITED REMEDY.  IN NO EVENT SHALL NVIDIAS
+ * AGGREGATE LIABILITY TO USER OR ANY OTHER PERSON OR ENTITY CLAIMING THROUGH
+ * OR UNDER USER EXCEED THE AMOUNT OF MONEY ACTUALLY PAID BY USER TO NVIDIA
+ * FOR THE SOFTWARE PROVIDED HEREWITH.
+ */
+
+//------------------------------------------------------------------------------
+//! \file test_ga_rle.c
+//! \brief Checks RLE_GA_EncodeBuffer/RLE_GA_DecodeBuffer against the
+//! streaming state machine.
+//!
+//! On whole-pixel inputs the buffer encoder must write the same bytes as the
+//! legacy GRLE_Deflate sequence: RLE_GA_Encode with RLE_GA_STREAM_NOT_END,
+//! then with RLE_GA_STREAM_END. The one exception is an input whose last
+//! token is 127 pixels long, where that sequence does not terminate the
+//! stream and fills the output instead (see ga_rle.h). There the encoder
+//! must match a single RLE_GA_STREAM_END call. Every stream is then decoded
+//! back with both RLE_GA_DecodeBuffer and RLE_GA_Decode.
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ga_rle.h"
+
+#define MAX_RUN             127
+#define BOUNDARY_SLACK      16
+#define RANDOM_IMAGES       20000
+#define MAX_RANDOM_PIXELS   1100
+#define BENCH_WIDTH         1920
+#define BENCH_HEIGHT        1080
+#define BENCH_LOOPS         10
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            s_failures++; \
+        } \
+    } while (0)
+
+static double Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned int WorstCaseSize(unsigned int inputSize)
+{
+    return inputSize + inputSize / (MAX_RUN * 4) + 16;
+}
+
+// The encode sequence of the legacy GRLE_Deflate
+static RLE_GA_Status LegacyEncode(unsigned char *pInput, unsigned int inputSize,
+                                  unsigned char *pOutput, unsigned int *pOutputSize)
+{
+    RLA_GA_Stream stream;
+    RLE_GA_Status status;
+
+    RLE_GA_EncodeInit(&stream);
+    RLE_GA_EncodeReset(&stream);
+    stream.avail_out = *pOutputSize;
+    stream.next_out = pOutput;
+    stream.next_in = pInput;
+    stream.avail_in = inputSize;
+    status = RLE_GA_Encode(&stream, RLE_GA_STREAM_NOT_END);
+    if (status == RLE_GA_OK)
+        status = RLE_GA_Encode(&stream, RLE_GA_STREAM_END);
+    *pOutputSize = (unsigned int)stream.total_out;
+    RLE_GA_EncodeEnd(&stream);
+    return status;
+}
+
+// A single RLE_GA_STREAM_END call over the whole input
+static RLE_GA_Status StreamEncode(unsigned char *pInput, unsigned int inputSize,
+                                  unsigned char *pOutput, unsigned int *pOutputSize)
+{
+    RLA_GA_Stream stream;
+    RLE_GA_Status status;
+
+    RLE_GA_EncodeInit(&stream);
+    stream.avail_out = *pOutputSize;
+    stream.next_out = pOutput;
+    stream.next_in = pInput;
+    stream.avail_in = inputSize;
+    status = RLE_GA_Encode(&stream, RLE_GA_STREAM_END);
+    *pOutputSize = (unsigned int)stream.total_out;
+    RLE_GA_EncodeEnd(&stream);
+    return status;
+}
+
+// The decode sequence of the legacy GRLE_Inflate
+static RLE_GA_Status StreamDecode(unsigned char *pInput, unsigned int inputSize,
+                                  unsigned char *pOutput, unsigned int *pOutputSize)
+{
+    RLA_GA_Stream stream;
+    RLE_GA_Status status;
+
+    RLE_GA_DecodeInit(&stream);
+    RLE_GA_DecodeReset(&stream);
+    stream.avail_in = inputSize;
+    stream.next_in = pInput;
+    stream.avail_out = *pOutputSize;
+    stream.next_out = pOutput;
+    status = RLE_GA_Decode(&stream, RLE_GA_STREAM_END);
+    *pOutputSize = (unsigned int)stream.total_out;
+    RLE_GA_DecodeEnd(&stream);
+    return status;
+}
+
+// Pixel count of the last token of an encoded stream
+static unsigned int LastTokenPixels(const unsigned char *pStream, unsigned int size)
+{
+    unsigned int pos = 0, count = 0;
+
+    while (pos < size) {
+        count = pStream[pos] & 0x7F;
+        pos += 1 + ((pStream[pos] & 0x80) ? 4 : count * 4);
+    }
+    return count;
+}
+
+// Encodes numPixels pixels of pInput with every path and decodes the result
+// back. Returns 1 if the legacy sequence failed on a 127 pixel last token.
+static int CheckImage(unsigned char *pInput, unsigned int numPixels, const char *pName)
+{
+    unsigned int inputSize = numPixels * 4;
+    unsigned int maxSize = WorstCaseSize(inputSize);
+    unsigned char *pNew = malloc(maxSize);
+    unsigned char *pOld = malloc(maxSize);
+    unsigned char *pDecoded = malloc(inputSize + 4);
+    unsigned int newSize = maxSize, oldSize = maxSize, decodedSize;
+    RLE_GA_Status status, legacyStatus;
+    int boundary = 0;
+
+    if (!pNew || !pOld || !pDecoded) {
+        CHECK(0, "out of memory");
+        goto done;
+    }
+
+    status = RLE_GA_EncodeBuffer(pInput, inputSize, pNew, &newSize);
+    CHECK(status == RLE_GA_STATUS_ENCODE_DONE, "%s: encode status %d", pName, status);
+    if (status != RLE_GA_STATUS_ENCODE_DONE)
+        goto done;
+
+    if (numPixels == 0 || LastTokenPixels(pNew, newSize) == MAX_RUN) {
+        // Nothing is left for the second legacy call, which starts an empty
+        // literal and copies from its run buffer until the output is full;
+        // leave it BOUNDARY_SLACK bytes so it stops before reading past that
+        // buffer. An empty input breaks a single RLE_GA_STREAM_END call the
+        // same way, and is encoded as an empty stream.
+        boundary = numPixels != 0;
+        oldSize = newSize + BOUNDARY_SLACK;
+        legacyStatus = LegacyEncode(pInput, inputSize, pOld, &oldSize);
+        CHECK(legacyStatus == RLE_GA_STATUS_OUTPUT_FULL && oldSize == newSize + BOUNDARY_SLACK &&
+              !memcmp(pOld, pNew, newSize) && pOld[newSize] == 0,
+              "%s: legacy encode status %d, %u bytes on a 127 pixel last token",
+              pName, legacyStatus, oldSize);
+
+        oldSize = maxSize;
+        legacyStatus = numPixels ? StreamEncode(pInput, inputSize, pOld, &oldSize) :
+                                   RLE_GA_STATUS_ENCODE_DONE;
+        if (!numPixels)
+            oldSize = 0;
+    } else {
+        legacyStatus = LegacyEncode(pInput, inputSize, pOld, &oldSize);
+    }
+    CHECK(legacyStatus == RLE_GA_STATUS_ENCODE_DONE, "%s: legacy encode status %d",
+          pName, legacyStatus);
+    CHECK(newSize == oldSize && !memcmp(pNew, pOld, newSize),
+          "%s: %u bytes encoded, legacy %u bytes%s", pName, newSize, oldSize,
+          newSize == oldSize ? ", contents differ" : "");
+
+    decodedSize = inputSize;
+    status = RLE_GA_DecodeBuffer(pNew, newSize, pDecoded, &decodedSize);
+    CHECK(status == RLE_GA_STATUS_DECODE_DONE && decodedSize == inputSize &&
+          !memcmp(pDecoded, pInput, inputSize),
+          "%s: RLE_GA_DecodeBuffer status %d, %u bytes", pName, status, decodedSize);
+
+    // One pixel short of room must stop before the token that does not fit
+    if (numPixels) {
+        pDecoded[inputSize - 4] = 0x5A;
+        decodedSize = inputSize - 4;
+        status = RLE_GA_DecodeBuffer(pNew, newSize, pDecoded, &decodedSize);
+        CHECK(status == RLE_GA_STATUS_OUTPUT_FULL && decodedSize <= inputSize - 4 &&
+              pDecoded[inputSize - 4] == 0x5A,
+              "%s: RLE_GA_DecodeBuffer status %d, %u bytes into a short buffer",
+              pName, status, decodedSize);
+    }
+
+    // The state machine rejects an empty output buffer up front
+    if (numPixels) {
+        memset(pDecoded, 0, inputSize);
+        decodedSize = inputSize;
+        status = StreamDecode(pNew, newSize, pDecoded, &decodedSize);
+        CHECK(status == RLE_GA_STATUS_DECODE_DONE && decodedSize == inputSize &&
+              !memcmp(pDecoded, pInput, inputSize),
+              "%s: RLE_GA_Decode status %d, %u bytes", pName, status, decodedSize);
+    }
+
+done:
+    free(pNew);
+    free(pOld);
+    free(pDecoded);
+    return boundary;
+}
+
+static void SetPixel(unsigned char *pImage, unsigned int index, unsigned int value)
+{
+    memcpy(pImage + index * 4, &value, 4);
+}
+
+// Runs of count equal pixels, then literals of count distinct pixels
+static void TestTokenBoundaries(void)
+{
+    static const unsigned int counts[] = { 1, 2, 3, 126, 127, 128, 253, 254, 255, 381 };
+    unsigned char *pImage = malloc((5 + 381) * 4);
+    char name[64];
+    unsigned int c, i, prefix;
+    int boundaries = 0;
+
+    if (!pImage) {
+        CHECK(0, "out of memory");
+        return;
+    }
+
+    for (prefix = 0; prefix <= 5; prefix += 5) {
+        for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+            // The prefix is a literal span that ends before the run
+            for (i = 0; i < prefix; i++)
+                SetPixel(pImage, i, 0x01000000 + i);
+            for (i = 0; i < counts[c]; i++)
+                SetPixel(pImage, prefix + i, 0xFF00FF00);
+            snprintf(name, sizeof(name), "%u literal + %u run", prefix, counts[c]);
+            boundaries += CheckImage(pImage, prefix + counts[c], name);
+
+            for (i = 0; i < prefix; i++)
+                SetPixel(pImage, i, 0x02000000);
+            for (i = 0; i < counts[c]; i++)
+                SetPixel(pImage, prefix + i, 0x03000000 + i);
+            snprintf(name, sizeof(name), "%u run + %u literal", prefix, counts[c]);
+            boundaries += CheckImage(pImage, prefix + counts[c], name);
+        }
+    }
+
+    // 127, 254 and 381 pixel runs and literal spans, with and without prefix
+    CHECK(boundaries == 12, "%d inputs hit the 127 pixel boundary, expected 12", boundaries);
+    free(pImage);
+}
+
+// Palette images with random run lengths, so that runs, literal spans and
+// their 127 pixel limits all occur
+static void TestRandomImages(void)
+{
+    unsigned char *pImage = malloc(MAX_RANDOM_PIXELS * 4);
+    unsigned int palette[4];
+    unsigned int numPixels, pos, length, value, i;
+    char name[64];
+    int n, boundaries = 0;
+
+    if (!pImage) {
+        CHECK(0, "out of memory");
+        return;
+    }
+
+    for (n = 0; n < RANDOM_IMAGES; n++) {
+        for (i = 0; i < 4; i++)
+            palette[i] = (unsigned int)rand() * 2654435761u;
+        numPixels = (unsigned int)rand() % MAX_RANDOM_PIXELS;
+
+        for (pos = 0; pos < numPixels; pos += length) {
+            switch (rand() % 4) {
+                case 0:  length = 1 + rand() % 3; break;
+                case 1:  length = 1 + rand() % 40; break;
+                case 2:  length = 120 + rand() % 16; break;
+                default: length = 250 + rand() % 10; break;
+            }
+            if (length > numPixels - pos)
+                length = numPixels - pos;
+            // Either a run of one palette entry or noise from the whole palette
+            value = palette[rand() % 4];
+            if (rand() % 2) {
+                for (i = 0; i < length; i++)
+                    SetPixel(pImage, pos + i, value);
+            } else {
+                for (i = 0; i < length; i++)
+                    SetPixel(pImage, pos + i, palette[rand() % 4]);
+            }
+        }
+
+        snprintf(name, sizeof(name), "image %d, %u pixels", n, numPixels);
+        boundaries += CheckImage(pImage, numPixels, name);
+    }
+
+    printf("random images: %d checked, %d ending on a 127 pixel token\n",
+           RANDOM_IMAGES, boundaries);
+    free(pImage);
+}
+
+// Every proper prefix that cuts a token must be rejected by the buffer decoder
+static void TestTruncatedStreams(void)
+{
+    unsigned char image[40 * 4];
+    unsigned char encoded[sizeof(image) * 2];
+    unsigned char decoded[sizeof(image)];
+    unsigned int encodedSize = sizeof(encoded), decodedSize, cut, pos;
+    RLE_GA_Status status;
+    int tokenEnd;
+    unsigned int i;
+
+    for (i = 0; i < 40; i++)
+        SetPixel(image, i, i < 10 || i >= 30 ? 0x04000000 + i / 3 : 0x05000000);
+    if (RLE_GA_EncodeBuffer(image, sizeof(image), encoded, &encodedSize) !=
+        RLE_GA_STATUS_ENCODE_DONE) {
+        CHECK(0, "encode failed");
+        return;
+    }
+
+    for (cut = 1; cut < encodedSize; cut++) {
+        // A cut right after a token is a valid shorter stream
+        tokenEnd = 0;
+        for (pos = 0; pos < cut; )
+            pos += 1 + ((encoded[pos] & 0x80) ? 4 : (encoded[pos] & 0x7F) * 4);
+        tokenEnd = pos == cut;
+
+        decodedSize = sizeof(decoded);
+        status = RLE_GA_DecodeBuffer(encoded, cut, decoded, &decodedSize);
+        CHECK(status == (tokenEnd ? RLE_GA_STATUS_DECODE_DONE : RLE_GA_ERROR_INVALID_INPUT),
+              "cut at %u: status %d", cut, status);
+    }
+}
+
+static void Benchmark(void)
+{
+    const unsigned int numPixels = BENCH_WIDTH * BENCH_HEIGHT;
+    const unsigned int inputSize = numPixels * 4;
+    const unsigned int maxSize = WorstCaseSize(inputSize);
+    unsigned char *pImage = malloc(inputSize);
+    unsigned char *pEncoded = malloc(maxSize);
+    unsigned char *pDecoded = malloc(inputSize);
+    unsigned int encodedSize = 0, size, x, y;
+    double start, legacyEncode, newEncode, legacyDecode, newDecode;
+    double megabytes = inputSize / 1e6 * BENCH_LOOPS;
+    int i;
+
+    if (!pImage || !pEncoded || !pDecoded)
+        goto done;
+
+    // A typical early app image: flat background with a noisy gauge
+    for (y = 0; y < BENCH_HEIGHT; y++) {
+        for (x = 0; x < BENCH_WIDTH; x++) {
+            SetPixel(pImage, y * BENCH_WIDTH + x,
+                     (x / 64 + y / 64) % 2 ? 0xFF202020 :
+                     (x > 800 && x < 1100 && y > 400 && y < 700) ? (unsigned int)rand() :
+                     0xFF000000);
+        }
+    }
+
+    start = Now();
+    for (i = 0; i < BENCH_LOOPS; i++) {
+        size = maxSize;
+        LegacyEncode(pImage, inputSize, pEncoded, &size);
+    }
+    legacyEncode = Now() - start;
+
+    start = Now();
+    for (i = 0; i < BENCH_LOOPS; i++) {
+        encodedSize = maxSize;
+        RLE_GA_EncodeBuffer(pImage, inputSize, pEncoded, &encodedSize);
+    }
+    newEncode = Now() - start;
+
+    start = Now();
+    for (i = 0; i < BENCH_LOOPS; i++) {
+        size = inputSize;
+        StreamDecode(pEncoded, encodedSize, pDecoded, &size);
+    }
+    legacyDecode = Now() - start;
+
+    start = Now();
+    for (i = 0; i < BENCH_LOOPS; i++) {
+        size = inputSize;
+        RLE_GA_DecodeBuffer(pEncoded, encodedSize, pDecoded, &size);
+    }
+    newDecode = Now() - start;
+
+    printf("%ux%u, %u bytes encoded\n", BENCH_WIDTH, BENCH_HEIGHT, encodedSize);
+    printf("encode: state machine %.1f MB/s, buffer %.1f MB/s\n",
+           megabytes / legacyEncode, megabytes / newEncode);
+    printf("decode: state machine %.1f MB/s, buffer %.1f MB/s\n",
+           megabytes / legacyDecode, megabytes / newDecode);
+
+done:
+    free(pImage);
+    free(pEncoded);
+    free(pDecoded);
+}
+
+int main(int argc, char *argv[])
+{
+    srand(1);
+
+    TestTokenBoundaries();
+    TestRandomImages();
+    TestTruncatedStreams();
+    if (argc < 2 || strcmp(argv[1], "--no-bench"))
+        Benchmark();
+
+    printf("%s\n", s_failures ? "FAILED" : "PASSED");
+    return s_failures ? 1 : 0;
+}
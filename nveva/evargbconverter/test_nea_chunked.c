@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2012, NVIDIA Corporation.  All Rights Reserved.
+ *
+ * BY INSTALLING THE SOFTWARE THE USER AGREES TO THE TERMS BELOW.
+ *
+ * User agrees to use the software under carefully controlled conditions
+ * and to inform all employees and contractors who have access to the software
+ * that the source code of the software is confidential and proprietary
+ * information of NVIDIA and is licensed to user as such.  User acknowledges
+ * and agrees that protection of the source code is essential and user shall
+ * retain the source code in strict confidence.  User shall restrict access to
+ * the source code of the software to those employees and contractors of user
+ * who have agreed to be bound by a confidentiality obligation which
+ * incorporates the protections and restrictions substantially set forth
+ * herein, and who have a need to access the source code in order to carry out
+ * the business purpose between NVIDIA and user.  The software provided
+ * herewith to user may only be used so long as the software is used solely
+ * with NVIDIA products and no other third party products (hardware or
+ * software).   The software must carry the NVIDIA copyright notice shown
+ * above.  User must not disclose, copy, duplicate, reproduce, modify,
+ * publicly display, create derivative works of the software other than as
+ * expressly authorized herein.  User must not under any circumstances,
+ * distribute or in any way disseminate the information contained in the
+ * source code and/or the source code itself to third parties except as
+ * expressly agreed to by NVIDIA.  In the event that user discovers any bugs
+ * in the software, such bugs must be reported to NVIDIA and any fixes may be
+ * inserted into the source code of the software by NVIDIA only.  User shall
+ * not modify the source code of the software in any way.  User shall be fully
+ * responsible for the conduct of all of its employees, contractors and
+ * representatives who may in any way violate these restrictions.
+ *
+ * NO WARRANTY
+ * THE ACCOMPANYING SOFTWARE (INCLUDING OBJECT AND SOURCE CODE) PROVIDED BY
+ * NVIDIA TO USER IS PROVIDED "AS IS."  NVIDIA DISCLAIMS ALL WARRANTIES,
+ * EXPRESS, IMPLIED OR STATUTORY, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF TITLE, MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.
+
+ * LIMITATION OF LIABILITY
+ * NVIDIA SHALL NOT BE LIABLE TO USER, USERS CUSTOMERS, OR ANY OTHER PERSON
+ * OR ENTITY CLAIMING THROUGH OR UNDER USER FOR ANY LOSS OF PROFITS, INCOME,
+ * SAVINGS, OR ANY OTHER CONSEQUENTIAL, INCIDENTAL, SPECIAL, PUNITIVE, DIRECT
+ * OR INDIRECT DAMAGES (WHETHER IN AN ACTION IN CONTRACT, TORT OR BASED ON A
+ * WARRANTY), EVEN IF NVIDIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGES.  THESE LIMITATIONS SHALL APPLY NOTWITHSTANDING ANY FAILURE OF THE
+ * ESSENTIAL PURPOSE OF ANY LIMITED REMEDY.  IN NO EVENT SHALL NVIDIAS
+ * AGGREGATE LIABILITY TO USER OR ANY OTHER PERSON OR ENTITY CLAIMING THROUGH
+ * OR UNDER USER EXCEED THE AMOUNT OF MONEY ACTUALLY PAID BY USER TO NVIDIA
+ * FOR THE SOFTWARE PROVIDED HEREWITH.
+ */
+
+//------------------------------------------------------------------------------
+//! \file test_nea_chunked.c
+//! \brief Round-trip test for chunked LZF NEA payloads.
+//!
+//! Every input is compressed and decompressed with 1 to TEST_MAX_THREADS
+//! threads. The payload must not depend on the thread count and must decode
+//! back to the input without writing past it. Corrupted chunk data, CRCs and
+//! entry tables must be rejected.
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvevatypes.h"
+#include "nea_chunked.h"
+
+#define TEST_MAX_THREADS    (NEA_CHUNK_MAX_THREADS + 2)
+#define GUARD_SIZE          64
+#define GUARD_BYTE          0xA5
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            s_failures++; \
+        } \
+    } while (0)
+
+typedef enum {
+    FILL_PATTERN,       // compresses well
+    FILL_RANDOM,        // incompressible, chunks are stored as is
+    FILL_MIXED,         // alternates both every 40000 bytes
+} FillType;
+
+static const char *s_fillNames[] = { "pattern", "random", "mixed" };
+
+static void Fill(U8 *pData, U32 size, FillType type)
+{
+    U32 i;
+
+    for (i = 0; i < size; i++) {
+        if (type == FILL_PATTERN || (type == FILL_MIXED && (i / 40000) % 2 == 0))
+            pData[i] = (U8)((i / 4) % 251);
+        else
+            pData[i] = (U8)rand();
+    }
+}
+
+static int GuardIntact(const U8 *pGuard)
+{
+    int i;
+
+    for (i = 0; i < GUARD_SIZE; i++) {
+        if (pGuard[i] != GUARD_BYTE)
+            return 0;
+    }
+    return 1;
+}
+
+// Compress with one thread, then check every thread count gives the same
+// payload and decodes it back. Returns the payload size, 0 on failure.
+static U32 RoundTrip(const U8 *pInput, U32 inputSize, U32 chunkSize, U8 *pPayload,
+                     U8 *pOther, U8 *pOutput, const char *pName)
+{
+    U32 maxSize = NeaChunkedMaxSize(inputSize, chunkSize);
+    U32 size, otherSize;
+    int threads;
+
+    size = NeaChunkedCompress(pInput, inputSize, pPayload, maxSize, chunkSize, 1);
+    CHECK(size != 0 && size <= maxSize, "%s: compress returned %u, max %u", pName, size, maxSize);
+    if (size == 0)
+        return 0;
+
+    for (threads = 1; threads <= TEST_MAX_THREADS; threads++) {
+        otherSize = NeaChunkedCompress(pInput, inputSize, pOther, maxSize, chunkSize, threads);
+        CHECK(otherSize == size && !memcmp(pOther, pPayload, size),
+              "%s: payload differs with %d threads", pName, threads);
+
+        memset(pOutput, 0, inputSize);
+        memset(pOutput + inputSize, GUARD_BYTE, GUARD_SIZE);
+        CHECK(NeaChunkedDecompress(pPayload, size, pOutput, inputSize, threads) == inputSize,
+              "%s: decompress failed with %d threads", pName, threads);
+        CHECK(!memcmp(pOutput, pInput, inputSize),
+              "%s: output differs with %d threads", pName, threads);
+        CHECK(GuardIntact(pOutput + inputSize),
+              "%s: write past the output with %d threads", pName, threads);
+    }
+    return size;
+}
+
+static void TestEmpty(void)
+{
+    U8 input[1] = { 0 };
+    U8 payload[256];
+    U8 output[1];
+
+    CHECK(NeaChunkedCompress(input, 0, payload, sizeof(payload), NEA_CHUNK_SIZE_DEFAULT, 1) == 0,
+          "empty input accepted by compress");
+    CHECK(NeaChunkedDecompress(payload, sizeof(payload), output, 0, 1) == 0,
+          "empty output accepted by decompress");
+}
+
+static void TestRejectBadParameters(void)
+{
+    U32 size = NEA_CHUNK_SIZE_MIN + 1;
+    U32 maxSize = NeaChunkedMaxSize(size, NEA_CHUNK_SIZE_MIN);
+    U8 *pInput = calloc(size, 1);
+    U8 *pPayload = malloc(maxSize);
+
+    if (!pInput || !pPayload) {
+        CHECK(0, "out of memory");
+        goto done;
+    }
+
+    CHECK(NeaChunkedCompress(pInput, size, pPayload, maxSize, NEA_CHUNK_SIZE_MIN - 1, 1) == 0,
+          "chunk size below the minimum accepted");
+    CHECK(NeaChunkedCompress(pInput, size, pPayload, maxSize, NEA_CHUNK_SIZE_MAX + 1, 1) == 0,
+          "chunk size above the maximum accepted");
+    CHECK(NeaChunkedCompress(pInput, size, pPayload, maxSize - 1, NEA_CHUNK_SIZE_MIN, 1) == 0,
+          "output smaller than NeaChunkedMaxSize accepted");
+
+done:
+    free(pInput);
+    free(pPayload);
+}
+
+static void TestSizes(void)
+{
+    static const U32 chunkSizes[] = { NEA_CHUNK_SIZE_MIN, NEA_CHUNK_SIZE_DEFAULT,
+                                      NEA_CHUNK_SIZE_MAX };
+    char name[96];
+    U32 sizes[8];
+    U32 maxInput = 6 * NEA_CHUNK_SIZE_MAX;
+    U8 *pInput = malloc(maxInput);
+    U8 *pPayload = malloc(NeaChunkedMaxSize(maxInput, NEA_CHUNK_SIZE_MIN));
+    U8 *pOther = malloc(NeaChunkedMaxSize(maxInput, NEA_CHUNK_SIZE_MIN));
+    U8 *pOutput = malloc(maxInput + GUARD_SIZE);
+    U32 c, s, chunkSize;
+    int f, numChecks = 0;
+
+    if (!pInput || !pPayload || !pOther || !pOutput) {
+        CHECK(0, "out of memory");
+        goto done;
+    }
+
+    for (c = 0; c < sizeof(chunkSizes) / sizeof(chunkSizes[0]); c++) {
+        chunkSize = chunkSizes[c];
+        sizes[0] = 1;                       // a single byte, below LZF's minimum
+        sizes[1] = 1000;                    // a single short chunk
+        sizes[2] = chunkSize - 1;
+        sizes[3] = chunkSize;               // exactly one chunk
+        sizes[4] = chunkSize + 1;           // one byte in the last chunk
+        sizes[5] = 3 * chunkSize;
+        sizes[6] = 3 * chunkSize + 17;
+        sizes[7] = 5 * chunkSize + chunkSize / 2;
+
+        for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            for (f = FILL_PATTERN; f <= FILL_MIXED; f++) {
+                Fill(pInput, sizes[s], (FillType)f);
+                snprintf(name, sizeof(name), "%u bytes, %s, chunk %u",
+                         sizes[s], s_fillNames[f], chunkSize);
+                RoundTrip(pInput, sizes[s], chunkSize, pPayload, pOther, pOutput, name);
+                numChecks++;
+            }
+        }
+    }
+
+    printf("round trip: %d inputs checked with 1 to %d threads\n", numChecks, TEST_MAX_THREADS);
+
+done:
+    free(pInput);
+    free(pPayload);
+    free(pOther);
+    free(pOutput);
+}
+
+static void TestCorruption(void)
+{
+    const U32 chunkSize = NEA_CHUNK_SIZE_MIN;
+    const U32 inputSize = 4 * chunkSize + 100;
+    const U32 maxSize = NeaChunkedMaxSize(inputSize, chunkSize);
+    U8 *pInput = malloc(inputSize);
+    U8 *pPayload = malloc(maxSize);
+    U8 *pOther = malloc(maxSize);
+    U8 *pOutput = malloc(inputSize + GUARD_SIZE);
+    NeaChunkHeader *pHeader;
+    NeaChunkEntry *pEntries;
+    U8 *pData;
+    U32 size, i;
+
+    if (!pInput || !pPayload || !pOther || !pOutput) {
+        CHECK(0, "out of memory");
+        goto done;
+    }
+
+    // Both stored and compressed chunks
+    Fill(pInput, inputSize, FILL_MIXED);
+    size = RoundTrip(pInput, inputSize, chunkSize, pPayload, pOther, pOutput, "corruption");
+    if (size == 0)
+        goto done;
+
+    pHeader = (NeaChunkHeader *)pOther;
+    pEntries = (NeaChunkEntry *)(pOther + sizeof(NeaChunkHeader));
+    pData = (U8 *)(pEntries + ((NeaChunkHeader *)pPayload)->numChunks);
+
+    for (i = 0; i < ((NeaChunkHeader *)pPayload)->numChunks; i++) {
+        // A flipped bit in the first, middle and last byte of each chunk
+        memcpy(pOther, pPayload, size);
+        pData[pEntries[i].offset] ^= 0x01;
+        CHECK(NeaChunkedDecompress(pOther, size, pOutput, inputSize, 4) == 0,
+              "chunk %u: corrupted first byte not detected", i);
+
+        memcpy(pOther, pPayload, size);
+        pData[pEntries[i].offset + pEntries[i].compressedSize / 2] ^= 0x80;
+        CHECK(NeaChunkedDecompress(pOther, size, pOutput, inputSize, 4) == 0,
+              "chunk %u: corrupted middle byte not detected", i);
+
+        memcpy(pOther, pPayload, size);
+        pData[pEntries[i].offset + pEntries[i].compressedSize - 1] ^= 0x10;
+        CHECK(NeaChunkedDecompress(pOther, size, pOutput, inputSize, 4) == 0,
+              "chunk %u: corrupted last byte not detected", i);
+
+        memcpy(pOther, pPayload, size);
+        pEntries[i].crc ^= 0x00010000;
+        CHECK(NeaChunkedDecompress(pOther, size, pOutput, inputSize, 4) == 0,
+              "chunk %u: corrupted CRC not detected", i);
+
+        memcpy(pOther, pPayload, size);
+        pEntries[i].offset = size;
+        CHECK(NeaChunkedDecompress(pOther, size, pOutput, inputSize, 4) == 0,
+              "chunk %u: offset past the payload accepted", i);
+
+        memcpy(pOther, pPayload, size);
+        pEntries[i].compressedSize = chunkSize + 1;
+        CHECK(NeaChunkedDecompress(pOther, size, pOutput, inputSize, 4) == 0,
+              "chunk %u: compressed size above the chunk size accepted", i);
+    }
+
+    memcpy(pOther, pPayload, size);
+    pHeader->numChunks++;
+    CHECK(NeaChunkedDecompress(pOther, size, pOutput, inputSize, 4) == 0,
+          "chunk count not matching the original size accepted");
+
+    memcpy(pOther, pPayload, size);
+    CHECK(NeaChunkedDecompress(pOther, size - 1, pOutput, inputSize, 4) == 0,
+          "truncated payload accepted");
+
+    CHECK(NeaChunkedDecompress(pPayload, size, pOutput, inputSize, 4) == inputSize,
+          "intact payload rejected after the corruption checks");
+
+done:
+    free(pInput);
+    free(pPayload);
+    free(pOther);
+    free(pOutput);
+}
+
+int main(void)
+{
+    srand(1);
+
+    TestEmpty();
+    TestRejectBadParameters();
+    TestSizes();
+    TestCorruption();
+
+    printf("%s\n", s_failures ? "FAILED" : "PASSED");
+    return s_failures ? 1 : 0;
+}
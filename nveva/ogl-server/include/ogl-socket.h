@@ -52,6 +52,53 @@
 #ifndef __OGL_SOCKET_H__
 #define __OGL_SOCKET_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Framed messages: a header in network byte order followed by len bytes
+ * of payload.  A descriptor can ride along with a message (OGL_MSG_FD)
+ * on Unix-domain sockets.
+ */
+#define OGL_MSG_MAGIC		0x4f474d31	/* "OGM1" */
+#define OGL_MSG_MAX_PAYLOAD	(1 << 20)
+#define OGL_MSG_MAX_BATCH	32
+#define OGL_MSG_MAX_FDS		8
+
+/* message types */
+#define OGL_MSG_MODE		0x0001	/* reply: "<w>x<h>@<mHz>" */
+#define OGL_MSG_PING		0x0002	/* reply: the same payload */
+#define OGL_MSG_SPLASH		0x0003	/* image file in the descriptor */
+#define OGL_MSG_REPLY		0x8000	/* or'ed into the request type */
+#define OGL_MSG_ERROR		0x4000	/* or'ed into failed replies */
+
+/* message flags */
+#define OGL_MSG_FD		0x0001
+
+typedef struct {
+	uint32_t	magic;
+	uint16_t	type;
+	uint16_t	flags;
+	uint32_t	len;
+} ogl_msg_hdr_t;
+
+typedef struct {
+	unsigned	type;
+	const void	*data;	/* received: points into the reader buffer */
+	unsigned	len;
+	int		fd;	/* -1 if none */
+} ogl_msg_t;
+
+/* Buffers received data so that several messages are read per call */
+typedef struct {
+	char		*buf;
+	unsigned	size;
+	unsigned	start;
+	unsigned	end;
+	int		fds[OGL_MSG_MAX_FDS];
+	unsigned	nfds;
+} ogl_msg_reader_t;
+
 #ifdef __cplusplus
 	extern "C" {
 #endif
@@ -66,6 +113,25 @@ extern int oglConnectSocket(int sock, const char *ip, unsigned port);
 extern int oglSendStringSocket(int sock, char *buf);
 extern int oglReceiveStringSocket(int sock, char *buf, unsigned len);
 
+extern int oglCreateUnixSocket(void);
+extern int oglBindUnixSocket(int sock, const char *path);
+extern int oglConnectUnixSocket(int sock, const char *path);
+
+extern int oglSendMessages(int sock, const ogl_msg_t *msgs, unsigned n);
+extern int oglSendMessage(int sock, unsigned type,
+			  const void *data, unsigned len, int fd);
+extern int oglIsMessageSocket(int sock);
+extern int oglReceiveMessageExact(int sock, ogl_msg_t *msg,
+				  void *buf, unsigned size);
+
+extern int oglReaderInit(ogl_msg_reader_t *reader, unsigned size);
+extern void oglReaderRelease(ogl_msg_reader_t *reader);
+extern int oglReaderBuffered(const ogl_msg_reader_t *reader);
+extern int oglReceiveMessage(ogl_msg_reader_t *reader, int sock,
+			     ogl_msg_t *msg);
+
+extern int oglCreatePayloadFd(const void *data, size_t len);
+
 #ifdef __cplusplus
 	}
 #endif
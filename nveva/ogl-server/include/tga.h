@@ -53,6 +53,7 @@
 #define __TGA_H
 
 #include <inttypes.h>
+#include <stdio.h>
 
 /* __FILE__ and __LINE__ are gcc specific */
 #ifndef __FILE__
@@ -146,6 +147,8 @@ struct _TGA {
 	int		last;		/* last error code */
 	TGAHeader	hdr;		/* image header */
 	TGAErrorProc	error;		/* user-defined error proc */
+	tbyte		*map;		/* file mapping, NULL if not mapped */
+	size_t		map_size;	/* size of the mapping */
 };
 
 
@@ -167,6 +170,8 @@ int TGAReadColorMap(TGA *tga, tbyte **cmap, tuint32 flags);
 
 size_t TGAReadScanlines(TGA *tga, tbyte *buf, size_t sln, size_t n, tuint32 flags);
 
+size_t TGADecodeScanlines(TGA *tga, tbyte *buf, tuint32 flags);
+
 int TGAReadImage(TGA *tga, TGAData *data);
 
 int __TGAbgr2rgb(tbyte **buf, size_t size, tbyte *depth, tbyte alpha);
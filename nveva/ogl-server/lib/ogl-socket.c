@@ -49,17 +49,29 @@
  * FOR THE SOFTWARE PROVIDED HEREWITH.
  */
 
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <net/if.h>
 #include <netinet/tcp.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
 
 #include "ogl-socket.h"
 #include "ogl-debug.h"
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 int oglCreateSocket(void)
 {
 	return socket(AF_INET, SOCK_STREAM, 0);
@@ -136,6 +148,7 @@ int oglSendStringSocket(int sock, char *buf)
 			ogl_debug("condition failed");
 			return retval;
 		}
+		buf += retval;
 		len -= retval;
 		sent += retval;
 	}
@@ -162,3 +175,406 @@ int oglReceiveStringSocket(int sock, char *buf, unsigned len)
 	return retval;
 }
 
+int oglCreateUnixSocket(void)
+{
+	return socket(AF_UNIX, SOCK_STREAM, 0);
+}
+
+static int oglUnixAddress(struct sockaddr_un *addr, const char *path)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (!path || strlen(path) >= sizeof(addr->sun_path))
+		return -1;
+
+	strcpy(addr->sun_path, path);
+	return 0;
+}
+
+int oglBindUnixSocket(int sock, const char *path)
+{
+	struct sockaddr_un addr;
+
+	if (oglUnixAddress(&addr, path) < 0) {
+		ogl_debug("condition failed");
+		return -1;
+	}
+
+	unlink(path);
+	return bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+int oglConnectUnixSocket(int sock, const char *path)
+{
+	struct sockaddr_un addr;
+
+	if (oglUnixAddress(&addr, path) < 0) {
+		ogl_debug("condition failed");
+		return -1;
+	}
+
+	return connect(sock, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+/*
+ * Sends n messages with a single sendmsg when the socket takes them all,
+ * headers and payloads are gathered in place.  The descriptors of the
+ * messages go along with the first byte.
+ */
+int oglSendMessages(int sock, const ogl_msg_t *msgs, unsigned n)
+{
+	ogl_msg_hdr_t hdr[OGL_MSG_MAX_BATCH];
+	struct iovec iov[2 * OGL_MSG_MAX_BATCH];
+	int fds[OGL_MSG_MAX_FDS];
+	union {
+		struct cmsghdr cmsg;
+		char buf[CMSG_SPACE(sizeof(fds))];
+	} ctl;
+	struct cmsghdr *cmsg;
+	struct msghdr mh;
+	unsigned i, niov = 0, nfds = 0;
+	ssize_t retval;
+	int sent = 0;
+
+	if (n > OGL_MSG_MAX_BATCH) {
+		ogl_debug("condition failed");
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (msgs[i].len > OGL_MSG_MAX_PAYLOAD) {
+			ogl_debug("condition failed");
+			return -1;
+		}
+
+		hdr[i].magic = htonl(OGL_MSG_MAGIC);
+		hdr[i].type = htons(msgs[i].type);
+		hdr[i].flags = 0;
+		hdr[i].len = htonl(msgs[i].len);
+		if (msgs[i].fd >= 0) {
+			if (nfds == OGL_MSG_MAX_FDS) {
+				ogl_debug("condition failed");
+				return -1;
+			}
+			fds[nfds++] = msgs[i].fd;
+			hdr[i].flags = htons(OGL_MSG_FD);
+		}
+
+		iov[niov].iov_base = &hdr[i];
+		iov[niov++].iov_len = sizeof(hdr[i]);
+		if (msgs[i].len) {
+			iov[niov].iov_base = (void *)msgs[i].data;
+			iov[niov++].iov_len = msgs[i].len;
+		}
+	}
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = niov;
+	if (nfds) {
+		memset(&ctl, 0, sizeof(ctl));
+		mh.msg_control = ctl.buf;
+		mh.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+		cmsg = CMSG_FIRSTHDR(&mh);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+		memcpy(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+	}
+
+	while (mh.msg_iovlen) {
+		retval = sendmsg(sock, &mh, MSG_NOSIGNAL);
+		if (retval < 0) {
+			if (errno == EINTR)
+				continue;
+			ogl_debug("condition failed");
+			return -1;
+		}
+		sent += retval;
+		mh.msg_control = NULL;
+		mh.msg_controllen = 0;
+
+		/* skip what went out of a partial send */
+		while (mh.msg_iovlen && (size_t)retval >= mh.msg_iov->iov_len) {
+			retval -= mh.msg_iov->iov_len;
+			mh.msg_iov++;
+			mh.msg_iovlen--;
+		}
+		if (mh.msg_iovlen) {
+			mh.msg_iov->iov_base = (char *)mh.msg_iov->iov_base + retval;
+			mh.msg_iov->iov_len -= retval;
+		}
+	}
+
+	return sent;
+}
+
+int oglSendMessage(int sock, unsigned type,
+		   const void *data, unsigned len, int fd)
+{
+	ogl_msg_t msg;
+
+	msg.type = type;
+	msg.data = data;
+	msg.len = len;
+	msg.fd = fd;
+	return oglSendMessages(sock, &msg, 1);
+}
+
+/* Returns 1 if the peer talks in messages, 0 for text commands */
+int oglIsMessageSocket(int sock)
+{
+	uint32_t magic;
+	int retval;
+
+	do {
+		retval = recv(sock, &magic, sizeof(magic),
+			      MSG_PEEK | MSG_WAITALL);
+	} while (retval < 0 && errno == EINTR);
+	if (retval < 0) {
+		ogl_debug("condition failed");
+		return retval;
+	}
+
+	return retval == sizeof(magic) && ntohl(magic) == OGL_MSG_MAGIC;
+}
+
+static int oglReceiveAll(int sock, void *buf, unsigned len)
+{
+	unsigned done = 0;
+	int retval;
+
+	while (done < len) {
+		retval = recv(sock, (char *)buf + done, len - done, 0);
+		if (retval < 0 && errno == EINTR)
+			continue;
+		if (retval <= 0)
+			return retval;
+		done += retval;
+	}
+
+	return done;
+}
+
+static int oglParseHeader(ogl_msg_hdr_t *hdr, const void *data)
+{
+	memcpy(hdr, data, sizeof(*hdr));
+	hdr->magic = ntohl(hdr->magic);
+	hdr->type = ntohs(hdr->type);
+	hdr->flags = ntohs(hdr->flags);
+	hdr->len = ntohl(hdr->len);
+
+	return hdr->magic == OGL_MSG_MAGIC && hdr->len <= OGL_MSG_MAX_PAYLOAD;
+}
+
+/*
+ * Reads exactly one message and nothing past it, for sockets that are
+ * handed over to something else afterwards.  Returns 1 for a message,
+ * 0 if the peer closed the connection and a negative value on errors.
+ */
+int oglReceiveMessageExact(int sock, ogl_msg_t *msg, void *buf, unsigned size)
+{
+	ogl_msg_hdr_t hdr;
+	char tmp[sizeof(hdr)];
+	int retval;
+
+	retval = oglReceiveAll(sock, tmp, sizeof(tmp));
+	if (retval <= 0)
+		return retval;
+
+	if (!oglParseHeader(&hdr, tmp) || hdr.len > size) {
+		ogl_debug("condition failed");
+		return -1;
+	}
+
+	retval = oglReceiveAll(sock, buf, hdr.len);
+	if (retval < 0 || (unsigned)retval != hdr.len) {
+		ogl_debug("condition failed");
+		return -1;
+	}
+
+	msg->type = hdr.type;
+	msg->data = buf;
+	msg->len = hdr.len;
+	msg->fd = -1;
+	return 1;
+}
+
+int oglReaderInit(ogl_msg_reader_t *reader, unsigned size)
+{
+	memset(reader, 0, sizeof(*reader));
+	reader->buf = (char *)malloc(size);
+	if (!reader->buf)
+		return -1;
+
+	reader->size = size;
+	return 0;
+}
+
+void oglReaderRelease(ogl_msg_reader_t *reader)
+{
+	while (reader->nfds)
+		close(reader->fds[--reader->nfds]);
+	free(reader->buf);
+	reader->buf = NULL;
+}
+
+/* Size of the message at the start of the buffer, 0 if incomplete */
+static int oglReaderFrame(const ogl_msg_reader_t *reader, ogl_msg_hdr_t *hdr)
+{
+	unsigned avail = reader->end - reader->start;
+
+	if (avail < sizeof(*hdr))
+		return 0;
+
+	if (!oglParseHeader(hdr, reader->buf + reader->start) ||
+	    sizeof(*hdr) + hdr->len > reader->size)
+		return -1;
+
+	if (avail < sizeof(*hdr) + hdr->len)
+		return 0;
+
+	return sizeof(*hdr) + hdr->len;
+}
+
+/* Returns 1 if the next oglReceiveMessage does not need to read */
+int oglReaderBuffered(const ogl_msg_reader_t *reader)
+{
+	ogl_msg_hdr_t hdr;
+
+	return oglReaderFrame(reader, &hdr) != 0;
+}
+
+static int oglReaderFill(ogl_msg_reader_t *reader, int sock)
+{
+	union {
+		struct cmsghdr cmsg;
+		char buf[CMSG_SPACE(OGL_MSG_MAX_FDS * sizeof(int))];
+	} ctl;
+	struct cmsghdr *cmsg;
+	struct msghdr mh;
+	struct iovec iov;
+	unsigned i, n;
+	int retval, fd;
+
+	iov.iov_base = reader->buf + reader->end;
+	iov.iov_len = reader->size - reader->end;
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = ctl.buf;
+	mh.msg_controllen = sizeof(ctl.buf);
+
+	do {
+		retval = recvmsg(sock, &mh, 0);
+	} while (retval < 0 && errno == EINTR);
+	if (retval <= 0)
+		return retval;
+
+	for (cmsg = CMSG_FIRSTHDR(&mh); cmsg; cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+		    cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+
+		n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (i = 0; i < n; i++) {
+			memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int),
+			       sizeof(fd));
+			if (reader->nfds < OGL_MSG_MAX_FDS)
+				reader->fds[reader->nfds++] = fd;
+			else
+				close(fd);
+		}
+	}
+
+	reader->end += retval;
+	return retval;
+}
+
+/*
+ * Returns the next message, reading as much as the socket has when the
+ * buffer does not hold a whole one.  The payload stays in the buffer:
+ * it is valid until the next call, or for as long as oglReaderBuffered
+ * says that call will not read.  Returns 1 for a message, 0 if the peer
+ * closed the connection and a negative value on errors.
+ */
+int oglReceiveMessage(ogl_msg_reader_t *reader, int sock, ogl_msg_t *msg)
+{
+	ogl_msg_hdr_t hdr;
+	int frame, retval;
+
+	while (!(frame = oglReaderFrame(reader, &hdr))) {
+		if (reader->start) {
+			memmove(reader->buf, reader->buf + reader->start,
+				reader->end - reader->start);
+			reader->end -= reader->start;
+			reader->start = 0;
+		}
+
+		retval = oglReaderFill(reader, sock);
+		if (retval <= 0)
+			return retval;
+	}
+
+	if (frame < 0) {
+		ogl_debug("condition failed");
+		return -1;
+	}
+
+	msg->type = hdr.type;
+	msg->data = reader->buf + reader->start + sizeof(hdr);
+	msg->len = hdr.len;
+	msg->fd = -1;
+	if (hdr.flags & OGL_MSG_FD) {
+		if (!reader->nfds) {
+			ogl_debug("condition failed");
+			return -1;
+		}
+		msg->fd = reader->fds[0];
+		reader->nfds--;
+		memmove(reader->fds, reader->fds + 1,
+			reader->nfds * sizeof(int));
+	}
+
+	reader->start += frame;
+	if (reader->start == reader->end)
+		reader->start = reader->end = 0;
+
+	return 1;
+}
+
+/* Puts a bulk payload in a file that can be passed as a descriptor */
+int oglCreatePayloadFd(const void *data, size_t len)
+{
+	char path[] = "/tmp/ogl-payload-XXXXXX";
+	size_t done = 0;
+	ssize_t retval;
+	int fd = -1;
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+	fd = syscall(SYS_memfd_create, "ogl-payload", 0);
+#endif
+	if (fd < 0) {
+		fd = mkstemp(path);
+		if (fd < 0) {
+			ogl_debug("condition failed");
+			return -1;
+		}
+		unlink(path);
+	}
+
+	while (done < len) {
+		retval = write(fd, (const char *)data + done, len - done);
+		if (retval < 0 && errno == EINTR)
+			continue;
+		if (retval <= 0) {
+			ogl_debug("condition failed");
+			close(fd);
+			return -1;
+		}
+		done += retval;
+	}
+
+	lseek(fd, 0, SEEK_SET);
+	return fd;
+}
@@ -52,14 +52,30 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TGA_USE_NEON 1
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define TGA_USE_SSSE3 1
+#endif
 #include "tga.h"
 #include "ogl-image.h"
 
+/* uncompressed images at least this large are decoded in strips */
+#define TGA_STRIP_MIN_SIZE	(2 * 1024 * 1024)
+#define TGA_MAX_STRIPS		4
+
 TGA*
 TGAOpen(const char *file)
 {
 	TGA *tga;
 	FILE *fd;
+	struct stat st;
 
 	tga = (TGA*)calloc(1, sizeof(TGA));
 	if (!tga) {
@@ -76,6 +92,17 @@ TGAOpen(const char *file)
 	tga->off = 0;
 	tga->fd = fd;
 	tga->last = TGA_OK;
+
+	/* the pixel data is decoded straight from a mapping of the file,
+	 * the stream is only used as a fallback */
+	if (fstat(fileno(fd), &st) == 0 && st.st_size > 0) {
+		tga->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+				fileno(fd), 0);
+		if (tga->map == MAP_FAILED)
+			tga->map = NULL;
+		else
+			tga->map_size = st.st_size;
+	}
 	return tga;
 }
 
@@ -84,6 +111,8 @@ void
 TGAClose(TGA *tga)
 {
 	if (tga) {
+		if (tga->map)
+			munmap(tga->map, tga->map_size);
 		fclose(tga->fd);
 		free(tga);
 	}
@@ -111,13 +140,27 @@ TGARead(TGA    *tga,
 	return read;
 }
 
+/* 24-bit and 32-bit images with alpha keep their depth when converted
+ * to RGB, TGADecodeScanlines swaps them while decoding */
+static int
+__TGASwapsInDecode(TGA *tga, tuint32 flags)
+{
+	tbyte bytes = TGA_BYTE_DEPTH(tga->hdr.depth);
+
+	return (flags & TGA_RGB) && !TGA_IS_MAPPED(tga) &&
+		(bytes == 3 || (bytes == 4 && tga->hdr.alpha));
+}
+
 int
 TGAReadImage(TGA     *tga,
 	     TGAData *data)
 {
+	int swapped = 0;
+
 	if (!tga) return 0;
 
-	if (TGAReadHeader(tga) != TGA_OK) {
+	/* TGAReadHeader returns 0 on failure as well */
+	if (TGAReadHeader(tga) != TGA_OK || tga->last != TGA_OK) {
 		TGA_ERROR(tga, tga->last);
 		return 0;
 	}
@@ -139,7 +182,14 @@ TGAReadImage(TGA     *tga,
 			return 0;
 		}
 
-		if (TGAReadScanlines(tga, data->img_data, 0, tga->hdr.height, data->flags) != tga->hdr.height) {
+		if (tga->map) {
+			swapped = __TGASwapsInDecode(tga, data->flags);
+			if (TGADecodeScanlines(tga, data->img_data, data->flags) != tga->hdr.height) {
+				data->flags &= ~TGA_IMAGE_DATA;
+				TGA_ERROR(tga, tga->last);
+				return 0;
+			}
+		} else if (TGAReadScanlines(tga, data->img_data, 0, tga->hdr.height, data->flags) != tga->hdr.height) {
 			data->flags &= ~TGA_IMAGE_DATA;
 			TGA_ERROR(tga, tga->last);
 			return 0;
@@ -153,7 +203,7 @@ TGAReadImage(TGA     *tga,
 			}
 			data->flags |= TGA_COLOR_MAP;
 			tga->last = TGA_OK;
-		} else if (data->flags & TGA_RGB) {
+		} else if ((data->flags & TGA_RGB) && !swapped) {
 			tga->last = __TGAbgr2rgb(&data->img_data,
 						 TGA_IMG_DATA_SIZE(tga),
 						 &tga->hdr.depth, tga->hdr.alpha);
@@ -206,7 +256,6 @@ TGAReadHeader(TGA *tga)
 
 	if (tga->hdr.map_t && tga->hdr.depth != 8) {
 		TGA_ERROR(tga, TGA_UNKNOWN_SUB_FORMAT);
-		free(tga);
 		free(tmp);
 		return 0;
 	}
@@ -218,7 +267,6 @@ TGAReadHeader(TGA *tga)
 	    tga->hdr.depth != 32)
 	{
 		TGA_ERROR(tga, TGA_UNKNOWN_SUB_FORMAT);
-		free(tga);
 		free(tmp);
 		return 0;
 	}
@@ -330,6 +378,144 @@ TGAReadRLE(TGA   *tga,
 	return TGA_OK;
 }
 
+/* Copies n pixels of the given byte depth, swapping the first and the
+ * third byte of each when swap is set.  dst may be the same as src. */
+static void
+__TGACopyPixels(tbyte *dst, const tbyte *src, size_t n, tbyte bytes, int swap)
+{
+	tbyte tmp;
+
+	if (!swap || bytes < 3) {
+		if (dst != src)
+			memcpy(dst, src, n * bytes);
+		return;
+	}
+
+#if defined(TGA_USE_NEON)
+	if (bytes == 3) {
+		uint8x16x3_t v;
+		uint8x16_t t;
+
+		for (; n >= 16; n -= 16) {
+			v = vld3q_u8(src);
+			t = v.val[0];
+			v.val[0] = v.val[2];
+			v.val[2] = t;
+			vst3q_u8(dst, v);
+			src += 48;
+			dst += 48;
+		}
+	} else {
+		uint8x16x4_t v;
+		uint8x16_t t;
+
+		for (; n >= 16; n -= 16) {
+			v = vld4q_u8(src);
+			t = v.val[0];
+			v.val[0] = v.val[2];
+			v.val[2] = t;
+			vst4q_u8(dst, v);
+			src += 64;
+			dst += 64;
+		}
+	}
+#elif defined(TGA_USE_SSSE3)
+	if (bytes == 3) {
+		const __m128i mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7,
+						   6, 11, 10, 9, 14, 13, 12, 15);
+
+		/* 5 pixels per 16 byte load and store, the last byte is
+		 * written again by the next step */
+		for (; n >= 6; n -= 5) {
+			_mm_storeu_si128((__m128i *) dst,
+				_mm_shuffle_epi8(
+					_mm_loadu_si128((const __m128i *) src),
+					mask));
+			src += 15;
+			dst += 15;
+		}
+	} else {
+		const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+						   10, 9, 8, 11, 14, 13, 12, 15);
+
+		for (; n >= 4; n -= 4) {
+			_mm_storeu_si128((__m128i *) dst,
+				_mm_shuffle_epi8(
+					_mm_loadu_si128((const __m128i *) src),
+					mask));
+			src += 16;
+			dst += 16;
+		}
+	}
+#endif
+
+	while (n--) {
+		tmp = src[0];
+		dst[0] = src[2];
+		dst[1] = src[1];
+		dst[2] = tmp;
+		if (bytes == 4)
+			dst[3] = src[3];
+		src += bytes;
+		dst += bytes;
+	}
+}
+
+/* BGRA to RGB, dropping the unused fourth byte */
+static void
+__TGABgra2Rgb(tbyte *dst, const tbyte *src, size_t n)
+{
+#if defined(TGA_USE_NEON)
+	uint8x16x4_t v;
+	uint8x16x3_t o;
+
+	for (; n >= 16; n -= 16) {
+		v = vld4q_u8(src);
+		o.val[0] = v.val[2];
+		o.val[1] = v.val[1];
+		o.val[2] = v.val[0];
+		vst3q_u8(dst, o);
+		src += 64;
+		dst += 48;
+	}
+#elif defined(TGA_USE_SSSE3)
+	const __m128i mask = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9,
+					   8, 14, 13, 12, -1, -1, -1, -1);
+
+	/* 4 pixels per step, the 16 byte store needs 6 pixels of room */
+	for (; n >= 6; n -= 4) {
+		_mm_storeu_si128((__m128i *) dst,
+			_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) src),
+					 mask));
+		src += 16;
+		dst += 12;
+	}
+#endif
+
+	while (n--) {
+		*dst++ = src[2];
+		*dst++ = src[1];
+		*dst++ = src[0];
+		src += 4;
+	}
+}
+
+/* Writes n copies of a pixel, doubling the filled part every step */
+static void
+__TGAFillPixels(tbyte *dst, const tbyte *pixel, size_t n, tbyte bytes)
+{
+	size_t size = n * bytes, done;
+
+	if (bytes == 1) {
+		memset(dst, pixel[0], n);
+		return;
+	}
+
+	memcpy(dst, pixel, bytes);
+	for (done = bytes; done < size; done *= 2)
+		memcpy(dst + done, dst, done < size - done ? done : size - done);
+}
+
 int
 __TGAbgr2rgb(tbyte **buf, size_t size, tbyte *depth, tbyte alpha)
 {
@@ -385,31 +571,18 @@ __TGAbgr2rgb(tbyte **buf, size_t size, tbyte *depth, tbyte alpha)
 		free(*buf);
 		*buf = data;
 	} else if (bytes == 4 && !alpha) {
-		tbyte *dst;
 		tbyte *data;
 
 		data = (tbyte*)malloc(size * 3);
 		if (!data)
 			return TGA_OOM;
 
-		dst = data;
-		while (size--) {
-			*dst++ = src[2];
-			*dst++ = src[1];
-			*dst++ = src[0];
-			src += bytes;
-		}
+		__TGABgra2Rgb(data, src, size);
 		*depth = 24;
 		free(*buf);
 		*buf = data;
 	} else {
-		while (size--) {
-			tbyte tmp = src[0];
-
-			src[0] = src[2];
-			src[2] = tmp;
-			src += bytes;
-		}
+		__TGACopyPixels(src, src, size, bytes, 1);
 		*depth = bytes << 3;
 	}
 
@@ -469,3 +642,168 @@ TGAReadScanlines(TGA	*tga,
 	tga->last = TGA_OK;
 	return read;
 }
+
+/* Rows of a mapped image to decode, in file order */
+typedef struct {
+	const tbyte	*src;
+	tbyte		*buf;
+	size_t		width;
+	size_t		height;
+	size_t		first;
+	size_t		last;
+	tbyte		bytes;
+	int		flip;
+	int		swap;
+} TGAStrip;
+
+static tbyte *
+__TGAStripRow(TGAStrip *strip, size_t row)
+{
+	if (strip->flip)
+		row = strip->height - 1 - row;
+	return strip->buf + row * strip->width * strip->bytes;
+}
+
+static void *
+__TGADecodeStrip(void *data)
+{
+	TGAStrip *strip = (TGAStrip*)data;
+	size_t sln_size = strip->width * strip->bytes;
+	size_t row;
+
+	for (row = strip->first; row < strip->last; row++)
+		__TGACopyPixels(__TGAStripRow(strip, row),
+				strip->src + row * sln_size,
+				strip->width, strip->bytes, strip->swap);
+	return NULL;
+}
+
+/* Packets may go on past the end of a scanline */
+static size_t
+__TGADecodeRLE(TGAStrip *strip, const tbyte *end)
+{
+	const tbyte *src = strip->src;
+	size_t row, x, count, left = 0;
+	size_t bytes = strip->bytes;
+	tbyte pixel[4], *dst;
+	int repeat = 0;
+
+	for (row = 0; row < strip->height; row++) {
+		dst = __TGAStripRow(strip, row);
+		for (x = 0; x < strip->width; x += count) {
+			if (left == 0) {
+				if (src >= end)
+					return row;
+				repeat = *src & 0x80;
+				left = (*src++ & 0x7f) + 1;
+				if (repeat) {
+					if ((size_t)(end - src) < bytes)
+						return row;
+					__TGACopyPixels(pixel, src, 1, bytes,
+							strip->swap);
+					src += bytes;
+				}
+			}
+
+			count = strip->width - x;
+			if (count > left)
+				count = left;
+
+			if (repeat) {
+				__TGAFillPixels(dst, pixel, count, bytes);
+			} else {
+				if ((size_t)(end - src) < count * bytes)
+					return row;
+				__TGACopyPixels(dst, src, count, bytes,
+						strip->swap);
+				src += count * bytes;
+			}
+			dst += count * bytes;
+			left -= count;
+		}
+	}
+
+	return strip->height;
+}
+
+/*
+ * Decodes the whole image from the file mapping, like TGAReadScanlines
+ * for all the scanlines.  With TGA_RGB in flags, 24-bit and 32-bit
+ * images with alpha come out as RGB(A) already.
+ */
+size_t
+TGADecodeScanlines(TGA	   *tga,
+		   tbyte   *buf,
+		   tuint32  flags)
+{
+	TGAStrip strips[TGA_MAX_STRIPS];
+	pthread_t threads[TGA_MAX_STRIPS];
+	const tbyte *end;
+	size_t off, sln_size, read;
+	long cpus;
+	int i, n, started;
+
+	if (!tga || !buf || !tga->map) return 0;
+
+	off = TGA_IMG_DATA_OFF(tga);
+	if (off > tga->map_size) {
+		TGA_ERROR(tga, TGA_SEEK_FAIL);
+		return 0;
+	}
+	end = tga->map + tga->map_size;
+
+	sln_size = TGA_SCANLINE_SIZE(tga);
+	strips[0].src = tga->map + off;
+	strips[0].buf = buf;
+	strips[0].width = tga->hdr.width;
+	strips[0].height = tga->hdr.height;
+	strips[0].bytes = TGA_BYTE_DEPTH(tga->hdr.depth);
+	strips[0].flip = tga->hdr.vert == TGA_TOP;
+	strips[0].swap = __TGASwapsInDecode(tga, flags);
+	tga->hdr.vert = TGA_BOTTOM;
+
+	if (TGA_IS_ENCODED(tga)) {
+		read = __TGADecodeRLE(&strips[0], end);
+		tga->hdr.img_t -= 8;
+	} else {
+		read = tga->hdr.height;
+		if (sln_size && (size_t)(end - strips[0].src) / sln_size < read)
+			read = (end - strips[0].src) / sln_size;
+
+		n = 1;
+		if (read * sln_size >= TGA_STRIP_MIN_SIZE) {
+			cpus = sysconf(_SC_NPROCESSORS_ONLN);
+			if (cpus > TGA_MAX_STRIPS)
+				n = TGA_MAX_STRIPS;
+			else if (cpus > 1)
+				n = cpus;
+		}
+
+		for (i = 0; i < n; i++) {
+			strips[i] = strips[0];
+			strips[i].first = read * i / n;
+			strips[i].last = read * (i + 1) / n;
+		}
+
+		for (started = 1; started < n; started++)
+			if (pthread_create(&threads[started], NULL,
+					   __TGADecodeStrip, &strips[started]))
+				break;
+
+		/* strips no thread could be started for are done here */
+		for (i = started; i < n; i++)
+			__TGADecodeStrip(&strips[i]);
+		__TGADecodeStrip(&strips[0]);
+
+		for (i = 1; i < started; i++)
+			pthread_join(threads[i], NULL);
+	}
+
+	if (read != tga->hdr.height) {
+		TGA_ERROR(tga, TGA_READ_FAIL);
+		return read;
+	}
+
+	tga->last = TGA_OK;
+	return read;
+}
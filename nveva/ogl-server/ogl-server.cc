@@ -49,6 +49,7 @@
  * FOR THE SOFTWARE PROVIDED HEREWITH.
  */
 
+#include <errno.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -91,6 +92,8 @@
 #define OGL_SERVER_NO_DELAY	0
 #define OGL_SERVER_RETRY	0
 #define OGL_SERVER_IFACE	NULL
+#define OGL_SERVER_CONTROL	NULL
+#define OGL_SERVER_CONTROL_BUF	(64 * 1024)
 #define OGL_SERVER_DISPLAY_ID	-1
 #define OGL_SERVER_DISPLAY_MODE	-1
 #define OGL_SERVER_WAYLAND	0
@@ -111,8 +114,10 @@ int no_delay = OGL_SERVER_NO_DELAY;
 int display_id = OGL_SERVER_DISPLAY_ID;
 int display_mode = OGL_SERVER_DISPLAY_MODE;
 char* iface = OGL_SERVER_IFACE;
+char* control_path = OGL_SERVER_CONTROL;
 
 pthread_t thread;
+pthread_t control_thread;
 pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t cond_socket = PTHREAD_COND_INITIALIZER;
 pthread_cond_t cond_stream = PTHREAD_COND_INITIALIZER;
@@ -141,6 +146,11 @@ static EGLSyncKHR streamSync = EGL_NO_SYNC_KHR;
 
 int volatile server_sock = -1;
 int volatile accept_sock = -1;
+int volatile control_sock = -1;
+int volatile control_client = -1;
+
+/* splash image received on the control socket, loaded by the main loop */
+int volatile splash_fd = -1;
 
 int volatile quit;
 
@@ -471,6 +481,8 @@ static void SignalHandler(int sig)
 
 	shutdown(accept_sock, SHUT_RDWR);
 	shutdown(server_sock, SHUT_RDWR);
+	shutdown(control_client, SHUT_RDWR);
+	shutdown(control_sock, SHUT_RDWR);
 	DestroySyncHandle(&streamSync);
 	quit = GL_TRUE;
 }
@@ -485,6 +497,29 @@ static EGLBoolean DrawSplash(void)
 	return eglSwapBuffers(display, surface);
 }
 
+/* Called with the mutex held */
+static void UpdateSplash(void)
+{
+	struct model *m;
+	char path[32];
+
+	if (gles_on) {
+		/* the image loaders take a path */
+		snprintf(path, sizeof(path), "/proc/self/fd/%d", splash_fd);
+		m = ModelGenerateFromFile(&camera, path);
+		if (m) {
+			ModelDelete(splash);
+			splash = m;
+			glClear(GL_COLOR_BUFFER_BIT);
+			DrawSplash();
+		} else {
+			ogl_debug("splash image from control socket failed");
+		}
+	}
+
+	CloseSock(&splash_fd);
+}
+
 static EGLBoolean DrawConsumer(void)
 {
 	EGLBoolean retval;
@@ -583,6 +618,19 @@ static int ProcessOptions(int argc, char **argv)
 				return 0;
 			}
 #endif
+		} else if (!strcmp(argv[i], "--control") ||
+		           !strcmp(argv[i], "-c")) {
+			if (++i < argc) {
+				control_path = strdup(argv[i]);
+				if (!control_path) {
+					printf("out of memory\n");
+					return 0;
+				}
+			} else {
+				ogl_error("control option requires an argument");
+				help(appname);
+				return 0;
+			}
 		} else if (!strcmp(argv[i], "--no-delay") ||
 		           !strcmp(argv[i], "-n")) {
 			no_delay = 1;
@@ -652,6 +700,8 @@ static void help(const char* name)
 		"                      (default :%i)\n"
 		"--retry, -r         : reconnect if client disconnects\n"
 		"                      (default: %s)\n"
+		"--control, -c <path>: unix socket for framed commands\n"
+		"                      (default: %s)\n"
 #if defined(WINDOW_SYSTEM_QNX_SCREEN)
 		"--layer, -y         : layer index\n"
 		"                      (default: specified in screen config file)\n"
@@ -673,6 +723,7 @@ static void help(const char* name)
 		OGL_SERVER_SPLASH,
 		OGL_SERVER_DISPLAY_ID,
 		OGL_SERVER_RETRY ? "on" : "off",
+		OGL_SERVER_CONTROL ? OGL_SERVER_CONTROL : "none",
 #if !defined(WINDOW_SYSTEM_QNX_SCREEN)
 		OGL_SERVER_DISPLAY_MODE,
 		OGL_SERVER_WAYLAND ? "on" : "off",
@@ -680,6 +731,179 @@ static void help(const char* name)
 		OGL_SERVER_GLES_ON ? "on" : "off");
 }
 
+static void GetMode(char *msg, size_t size)
+{
+	unsigned w;
+	unsigned h;
+#if defined(WINDOW_SYSTEM_QNX_SCREEN)
+	w = screen_mode.width;
+	h = screen_mode.height;
+	// Refresh rate in mHz
+	uint32_t refresh = screen_mode.refresh * 1000;
+#else
+	uint64_t refresh;
+	drmModeModeInfo *info = &crtc->mode;
+	w = info->hdisplay;
+	h = info->vdisplay;
+	/* Calculate higher precision (mHz) refresh rate */
+	refresh = (info->clock * 1000000LL / info->htotal +
+		   info->vtotal / 2) / info->vtotal;
+
+	if (info->flags & DRM_MODE_FLAG_INTERLACE)
+		refresh *= 2;
+	if (info->flags & DRM_MODE_FLAG_DBLSCAN)
+		refresh /= 2;
+	if (info->vscan > 1)
+		refresh /= info->vscan;
+#endif
+	/* Hack since full screen doesn't work */
+	hack_size(800, &w, &h);
+
+	snprintf(msg, size, "%ux%u@%u", w, h, (unsigned)refresh);
+}
+
+/* Hands a splash image over to the main loop */
+static int QueueSplash(int fd)
+{
+	if (pthread_mutex_lock(&mutex)) {
+		ogl_error("pthread_mutex_lock failed");
+		return 0;
+	}
+
+	CloseSock(&splash_fd);
+	splash_fd = fd;
+	pthread_cond_signal(&cond_socket);
+	pthread_mutex_unlock(&mutex);
+	return 1;
+}
+
+/*
+ * Serves framed commands on the control socket.  Requests that arrived
+ * together are parsed in place from the receive buffer, their replies
+ * go out together once the buffer holds no further complete request.
+ */
+static void ControlClient(int sock)
+{
+	ogl_msg_reader_t reader;
+	ogl_msg_t req, reply[OGL_MSG_MAX_BATCH];
+	char mode[OGL_MSG_MAX_BATCH][32];
+	unsigned n = 0;
+	int retval;
+
+	if (oglReaderInit(&reader, OGL_SERVER_CONTROL_BUF) < 0) {
+		ogl_error("out of memory");
+		return;
+	}
+
+	while (!quit) {
+		retval = oglReceiveMessage(&reader, sock, &req);
+		if (retval <= 0)
+			break;
+
+		reply[n].type = req.type | OGL_MSG_REPLY;
+		reply[n].data = NULL;
+		reply[n].len = 0;
+		reply[n].fd = -1;
+
+		switch (req.type) {
+		case OGL_MSG_MODE:
+			GetMode(mode[n], sizeof(mode[n]));
+			reply[n].data = mode[n];
+			reply[n].len = strlen(mode[n]);
+			break;
+		case OGL_MSG_PING:
+			/* still in the reader buffer until it is sent */
+			reply[n].data = req.data;
+			reply[n].len = req.len;
+			break;
+		case OGL_MSG_SPLASH:
+			if (req.fd < 0 || !QueueSplash(req.fd)) {
+				reply[n].type |= OGL_MSG_ERROR;
+				CloseSock(&req.fd);
+			}
+			break;
+		default:
+			ogl_debug("unknown control message %u", req.type);
+			reply[n].type |= OGL_MSG_ERROR;
+			CloseSock(&req.fd);
+			break;
+		}
+
+		if (++n == OGL_MSG_MAX_BATCH || !oglReaderBuffered(&reader)) {
+			retval = oglSendMessages(sock, reply, n);
+			n = 0;
+			if (retval < 0) {
+				ogl_debug("oglSendMessages failed");
+				break;
+			}
+		}
+	}
+
+	/*
+	 * Replies are only held back while the reader has another frame;
+	 * if that frame was invalid, answer the valid ones before it.  Their
+	 * payloads are still in the buffer, a failed read does not move it.
+	 */
+	if (n > 0 && oglSendMessages(sock, reply, n) < 0)
+		ogl_debug("oglSendMessages failed");
+
+	oglReaderRelease(&reader);
+}
+
+static void *controlThread(void *param)
+{
+	int retval;
+
+	control_sock = oglCreateUnixSocket();
+	if (control_sock < 0) {
+		ogl_error("oglCreateUnixSocket failed");
+		goto out;
+	}
+
+	retval = oglBindUnixSocket(control_sock, control_path);
+	if (retval < 0) {
+		ogl_error("oglBindUnixSocket failed");
+		goto out;
+	}
+
+	retval = oglListenSocket(control_sock);
+	if (retval < 0) {
+		ogl_error("oglListenSocket failed");
+		goto out;
+	}
+
+	while (!quit) {
+		control_client = accept(control_sock, NULL, NULL);
+		if (control_client < 0) {
+			switch (errno) {
+			case EINTR:
+			case ECONNABORTED:
+				continue;
+			case EMFILE:
+			case ENFILE:
+			case ENOBUFS:
+			case ENOMEM:
+				/* wait for descriptors or memory to be freed */
+				ogl_debug("accept failed, errno %d", errno);
+				usleep(100000);
+				continue;
+			default:
+				/* shut down by SignalHandler, or not usable */
+				if (!quit)
+					ogl_error("accept failed, errno %d", errno);
+				goto out;
+			}
+		}
+
+		ControlClient(control_client);
+		CloseSock(&control_client);
+	}
+
+out:
+	CloseSock(&control_sock);
+	pthread_exit(param);
+}
+
 static void *sockThread(void *param)
 {
 	char msg[64];
@@ -740,42 +964,31 @@ static void *sockThread(void *param)
 			if (accept_sock < 0)
 				ogl_debug("oglCreateAcceptSocket failed");
 		} while (accept_sock < 0);
-		retval = oglReceiveStringSocket(accept_sock, msg, sizeof(msg));
+		retval = oglIsMessageSocket(accept_sock);
 		if (retval > 0) {
-			ogl_debug("received: %s", msg);
-			if (strstr(msg, "mode?")) {
-				unsigned w;
-				unsigned h;
-#if defined(WINDOW_SYSTEM_QNX_SCREEN)
-				w = screen_mode.width;
-				h = screen_mode.height;
-				// Refresh rate in mHz
-				uint32_t refresh = screen_mode.refresh * 1000;
-#else
-				uint64_t refresh;
-				drmModeModeInfo *info = &crtc->mode;
-				w = info->hdisplay;
-				h = info->vdisplay;
-				/* Calculate higher precision (mHz) refresh rate */
-				refresh = (info->clock * 1000000LL / info->htotal +
-					   info->vtotal / 2) / info->vtotal;
-
-				if (info->flags & DRM_MODE_FLAG_INTERLACE)
-					refresh *= 2;
-				if (info->flags & DRM_MODE_FLAG_DBLSCAN)
-					refresh /= 2;
-				if (info->vscan > 1)
-					refresh /= info->vscan;
-#endif
-				/* Hack since full screen doesn't work */
-				hack_size(800, &w, &h);
-
-				sprintf(msg, "%ux%u@%u", w, h, (unsigned)refresh);
-
-
-				retval = oglSendStringSocket(accept_sock, msg);
-				if ((uint)retval != strlen(msg))
-					ogl_debug("oglSendStringSocket failed");
+			ogl_msg_t req;
+
+			/* read no further, the socket goes to the stream */
+			retval = oglReceiveMessageExact(accept_sock, &req,
+							msg, sizeof(msg));
+			if (retval > 0 && req.type == OGL_MSG_MODE) {
+				GetMode(msg, sizeof(msg));
+				retval = oglSendMessage(accept_sock,
+							OGL_MSG_MODE | OGL_MSG_REPLY,
+							msg, strlen(msg), -1);
+				if (retval < 0)
+					ogl_debug("oglSendMessage failed");
+			}
+		} else if (retval == 0) {
+			retval = oglReceiveStringSocket(accept_sock, msg, sizeof(msg));
+			if (retval > 0) {
+				ogl_debug("received: %s", msg);
+				if (strstr(msg, "mode?")) {
+					GetMode(msg, sizeof(msg));
+					retval = oglSendStringSocket(accept_sock, msg);
+					if ((uint)retval != strlen(msg))
+						ogl_debug("oglSendStringSocket failed");
+				}
 			}
 		}
 		retval = pthread_cond_signal(&cond_socket);
@@ -861,6 +1074,14 @@ int main(int argc, char **argv)
 		goto out_crtc;
 	}
 
+	if (control_path) {
+		retval = pthread_create(&control_thread, NULL, controlThread, NULL);
+		if (retval) {
+			ogl_error("pthread_create failed, no control socket");
+			control_path = NULL;
+		}
+	}
+
 	retval = oglInit();
 	if (!retval) {
 		ogl_error("oglInit failed");
@@ -987,6 +1208,11 @@ int main(int argc, char **argv)
 			if (quit)
 				goto out;
 
+			if (splash_fd >= 0) {
+				UpdateSplash();
+				continue;
+			}
+
 			retval = pthread_cond_wait(&cond_socket, &mutex);
 			if (retval) {
 				ogl_error("pthread_cond_wait");
@@ -1144,6 +1370,15 @@ out_pthread:
 	CloseSock(&accept_sock);
 	CloseSock(&server_sock);
 
+	if (control_path) {
+		quit = GL_TRUE;
+		shutdown(control_client, SHUT_RDWR);
+		shutdown(control_sock, SHUT_RDWR);
+		pthread_join(control_thread, NULL);
+		unlink(control_path);
+	}
+	CloseSock(&splash_fd);
+
 out_crtc:
 #if !defined(WINDOW_SYSTEM_QNX_SCREEN)
 	drmModeFreeCrtc(crtc);
@@ -0,0 +1,662 @@
+/*
+ * Copyright (c) 2015, NVIDIA Corporation.  All Rights Reserved.
+ *
+ * BY INSTALLING THE SOFTWARE THE USER AGREES TO THE TERMS BELOW.
+ *
+ * User agrees to use the software under carefully controlled conditions
+ * and to inform all employees and contractors who have access to the software
+ * that the source code of the software is confidential and proprietary
+ * information of NVIDIA and is licensed to user as such.  User acknowledges
+ * and agrees that protection of the source code is essential and user shall
+ * retain the source code in strict confidence.  User shall restrict access to
+ * the source code of the software to those employees and contractors of user
+ * who have agreed to be bound by a confidentiality obligation which
+ * incorporates the protections and restrictions substantially set forth
+ * herein, and who have a need to access the source code in order to carry out
+ * the business purpose between NVIDIA and user.  The software provided
+ * herewith to user may only be used so long as the software is used solely
+ * with NVIDIA products and no other third party products (hardware or
+ * software).   The software must carry the NVIDIA copyright notice shown
+ * above.  User must not disclose, copy, duplicate, reproduce, modify,
+ * publicly display, create derivative works of the software other than as
+ * expressly authorized herein.  User must not under any circumstances,
+ * distribute or in any way disseminate the information contained in the
+ * source code and/or the source code itself to third parties except as
+ * expressly agreed to by NVIDIA.  In the event that user discovers any bugs
+ * in the software, such bugs must be reported to NVIDIA and any fixes may be
+ * inserted into the source code of the software by NVIDIA only.  User shall
+ * not modify the source code of the software in any way.  User shall be fully
+ * responsible for the conduct of all of its employees, contractors and
+ * representatives who may in any way violate these restrictions.
+ *
+ * NO WARRANTY
+ * THE ACCOMPANYING SOFTWARE (INCLUDING OBJECT AND SOURCE CODE) PROVIDED BY
+ * NVIDIA TO USER IS PROVIDED "AS IS."  NVIDIA DISCLAIMS ALL WARRANTIES,
+ * EXPRESS, IMPLIED OR STATUTORY, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF TITLE, MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.
+
+ * LIMITATION OF LIABILITY
+ * NVIDIA SHALL NOT BE LIABLE TO USER, USERS CUSTOMERS, OR ANY OTHER PERSON
+ * OR ENTITY CLAIMING THROUGH OR UNDER USER FOR ANY LOSS OF PROFITS, INCOME,
+ * SAVINGS, OR ANY OTHER CONSEQUENTIAL, INCIDENTAL, SPECIAL, PUNITIVE, DIRECT
+ * OR INDIRECT DAMAGES (WHETHER IN AN ACTION IN CONTRACT, TORT OR BASED ON A
+ * WARRANTY), EVEN IF NVIDIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGES.  THESE LIMITATIONS SHALL APPLY NOTWITHSTANDING ANY FAILURE OF THE
+ * ESSENTIAL PURPOSE OF ANY LIMITED REMEDY.  IN NO EVENT SHALL NVIDIAS
+ * AGGREGATE LIABILITY TO USER OR ANY OTHER PERSON OR ENTITY CLAIMING THROUGH
+ * OR UNDER USER EXCEED THE AMOUNT OF MONEY ACTUALLY PAID BY USER TO NVIDIA
+ * FOR THE SOFTWARE PROVIDED HEREWITH.
+ */
+
+/*
+ * Loopback test and benchmark for the framed messages of ogl-socket.
+ *
+ * The client side talks to an echo server thread over a socketpair.  The
+ * server is written like ControlClient in ogl-server.cc: it answers the
+ * requests found in one read together, at most OGL_MSG_MAX_BATCH at a
+ * time.  Pings come back with their payload, splash requests with a sum
+ * of the bytes of the descriptor they carry.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "ogl-socket.h"
+
+#define TEST_READER_SIZE	(64 * 1024)
+#define TEST_MANY		100
+#define BENCH_COMMANDS		200000
+#define BENCH_FRAME		60000
+#define BENCH_PAYLOAD		(64 << 20)
+#define TEST_TIMEOUT		60	/* seconds, a lost frame hangs */
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+	do { \
+		if (!(cond)) { \
+			printf("FAIL %s:%d: ", __func__, __LINE__); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+			failures++; \
+		} \
+	} while (0)
+
+typedef struct {
+	int		sock[2];	/* client, server */
+	pthread_t	thread;
+	ogl_msg_reader_t reader;
+} loopback_t;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int countFds(void)
+{
+	int fd, n = 0;
+
+	for (fd = 0; fd < 1024; fd++)
+		if (fcntl(fd, F_GETFD) >= 0)
+			n++;
+	return n;
+}
+
+static unsigned long sumFd(int fd)
+{
+	struct stat st;
+	unsigned char *data;
+	unsigned long sum = 0;
+	size_t i;
+
+	if (fstat(fd, &st) < 0 || st.st_size == 0)
+		return 0;
+	data = (unsigned char *)mmap(NULL, st.st_size, PROT_READ,
+				     MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+		return 0;
+	for (i = 0; i < (size_t)st.st_size; i++)
+		sum += data[i];
+	munmap(data, st.st_size);
+	return sum;
+}
+
+static void *echoServer(void *param)
+{
+	int sock = *(int *)param;
+	ogl_msg_reader_t reader;
+	ogl_msg_t req, reply[OGL_MSG_MAX_BATCH];
+	char sum[OGL_MSG_MAX_BATCH][32];
+	unsigned n = 0;
+
+	if (oglReaderInit(&reader, TEST_READER_SIZE) < 0)
+		return NULL;
+
+	while (oglReceiveMessage(&reader, sock, &req) > 0) {
+		reply[n].type = req.type | OGL_MSG_REPLY;
+		reply[n].data = req.data;
+		reply[n].len = req.len;
+		reply[n].fd = -1;
+
+		if (req.type == OGL_MSG_SPLASH) {
+			if (req.fd < 0) {
+				reply[n].type |= OGL_MSG_ERROR;
+			} else {
+				snprintf(sum[n], sizeof(sum[n]), "%lu",
+					 sumFd(req.fd));
+				reply[n].data = sum[n];
+				reply[n].len = strlen(sum[n]);
+				close(req.fd);
+			}
+		}
+
+		if (++n == OGL_MSG_MAX_BATCH || !oglReaderBuffered(&reader)) {
+			if (oglSendMessages(sock, reply, n) < 0)
+				break;
+			n = 0;
+		}
+	}
+
+	/* answered before an invalid frame drops the client */
+	if (n > 0)
+		oglSendMessages(sock, reply, n);
+
+	oglReaderRelease(&reader);
+	close(sock);
+	return NULL;
+}
+
+static int loopbackOpen(loopback_t *lb)
+{
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, lb->sock) < 0)
+		return -1;
+	if (oglReaderInit(&lb->reader, TEST_READER_SIZE) < 0 ||
+	    pthread_create(&lb->thread, NULL, echoServer, &lb->sock[1])) {
+		oglReaderRelease(&lb->reader);
+		close(lb->sock[0]);
+		close(lb->sock[1]);
+		return -1;
+	}
+	return 0;
+}
+
+static void loopbackClose(loopback_t *lb)
+{
+	shutdown(lb->sock[0], SHUT_WR);
+	pthread_join(lb->thread, NULL);
+	close(lb->sock[0]);
+	oglReaderRelease(&lb->reader);
+}
+
+static void fillPayload(char *buf, unsigned len, unsigned seed)
+{
+	unsigned i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (char)(seed * 31 + i * 7 + (i >> 8));
+}
+
+/* A socketpair whose receiving end does not block */
+static int openPair(int sock[2])
+{
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sock) < 0)
+		return -1;
+	fcntl(sock[1], F_SETFL, fcntl(sock[1], F_GETFL) | O_NONBLOCK);
+	return 0;
+}
+
+static int writeAll(int sock, const char *data, size_t len)
+{
+	ssize_t retval;
+
+	while (len) {
+		retval = write(sock, data, len);
+		if (retval <= 0)
+			return -1;
+		data += retval;
+		len -= retval;
+	}
+	return 0;
+}
+
+/*
+ * Receives what the socket holds, stopping when the reader would block.
+ * The reader keeps a partial frame for the next call.
+ */
+static unsigned drain(ogl_msg_reader_t *reader, int sock, ogl_msg_t *msgs,
+		      char payloads[][400], unsigned n)
+{
+	ogl_msg_t msg;
+	int retval;
+
+	while ((retval = oglReceiveMessage(reader, sock, &msg)) > 0) {
+		memcpy(payloads[n], msg.data, msg.len);
+		msgs[n] = msg;
+		msgs[n].data = payloads[n];
+		n++;
+	}
+	CHECK(retval < 0 && (errno == EAGAIN || errno == EWOULDBLOCK),
+	      "reader stopped with %d", retval);
+	return n;
+}
+
+/* Three frames of 0, 5 and 300 bytes written in pieces */
+static void testSplitFrames(void)
+{
+	static const unsigned lens[] = { 0, 5, 300 };
+	ogl_msg_reader_t reader;
+	ogl_msg_t msgs[3];
+	char stream[3 * sizeof(ogl_msg_hdr_t) + 305];
+	char payload[300], payloads[3][400];
+	size_t total = 0, split, i;
+	ogl_msg_hdr_t hdr;
+	unsigned n, k;
+	int sock[2];
+
+	fillPayload(payload, sizeof(payload), 1);
+	for (k = 0; k < 3; k++) {
+		hdr.magic = htonl(OGL_MSG_MAGIC);
+		hdr.type = htons(OGL_MSG_PING);
+		hdr.flags = 0;
+		hdr.len = htonl(lens[k]);
+		memcpy(stream + total, &hdr, sizeof(hdr));
+		memcpy(stream + total + sizeof(hdr), payload, lens[k]);
+		total += sizeof(hdr) + lens[k];
+	}
+
+	/* split once at every offset, then one byte at a time */
+	for (split = 0; split <= total + 1; split++) {
+		if (openPair(sock) < 0 ||
+		    oglReaderInit(&reader, TEST_READER_SIZE) < 0) {
+			CHECK(0, "cannot open a socketpair");
+			return;
+		}
+
+		if (split <= total) {
+			writeAll(sock[0], stream, split);
+			n = drain(&reader, sock[1], msgs, payloads, 0);
+			writeAll(sock[0], stream + split, total - split);
+			n = drain(&reader, sock[1], msgs, payloads, n);
+		} else {
+			for (i = n = 0; i < total; i++) {
+				writeAll(sock[0], stream + i, 1);
+				n = drain(&reader, sock[1], msgs, payloads, n);
+			}
+		}
+
+		CHECK(n == 3, "split at %zu: %u frames", split, n);
+		for (k = 0; k < n && k < 3; k++)
+			CHECK(msgs[k].type == OGL_MSG_PING &&
+			      msgs[k].len == lens[k] && msgs[k].fd == -1 &&
+			      !memcmp(msgs[k].data, payload, lens[k]),
+			      "split at %zu: frame %u differs", split, k);
+
+		oglReaderRelease(&reader);
+		close(sock[0]);
+		close(sock[1]);
+	}
+}
+
+static void testEmptyFrames(loopback_t *lb)
+{
+	ogl_msg_t msgs[OGL_MSG_MAX_BATCH], msg;
+	char buf[16];
+	int sock[2];
+	unsigned k;
+
+	CHECK(oglSendMessage(lb->sock[0], OGL_MSG_PING, NULL, 0, -1) ==
+	      sizeof(ogl_msg_hdr_t), "empty ping not sent");
+	CHECK(oglReceiveMessage(&lb->reader, lb->sock[0], &msg) == 1 &&
+	      msg.type == (OGL_MSG_PING | OGL_MSG_REPLY) && msg.len == 0,
+	      "empty ping not echoed");
+
+	for (k = 0; k < OGL_MSG_MAX_BATCH; k++) {
+		msgs[k].type = OGL_MSG_PING;
+		msgs[k].data = NULL;
+		msgs[k].len = 0;
+		msgs[k].fd = -1;
+	}
+	CHECK(oglSendMessages(lb->sock[0], msgs, OGL_MSG_MAX_BATCH) ==
+	      OGL_MSG_MAX_BATCH * (int)sizeof(ogl_msg_hdr_t),
+	      "empty batch not sent");
+	for (k = 0; k < OGL_MSG_MAX_BATCH; k++)
+		CHECK(oglReceiveMessage(&lb->reader, lb->sock[0], &msg) == 1 &&
+		      msg.len == 0, "empty reply %u", k);
+
+	/* the exact reader stops right after an empty frame */
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sock) < 0) {
+		CHECK(0, "cannot open a socketpair");
+		return;
+	}
+	oglSendMessage(sock[0], OGL_MSG_MODE, NULL, 0, -1);
+	oglSendStringSocket(sock[0], (char *)"mode?");
+	CHECK(oglIsMessageSocket(sock[1]) == 1, "framed peer not detected");
+	CHECK(oglReceiveMessageExact(sock[1], &msg, buf, sizeof(buf)) == 1 &&
+	      msg.type == OGL_MSG_MODE && msg.len == 0, "exact empty frame");
+	CHECK(oglReceiveStringSocket(sock[1], buf, sizeof(buf)) == 5 &&
+	      !strcmp(buf, "mode?"), "exact reader read past the frame");
+	close(sock[0]);
+	close(sock[1]);
+}
+
+/* Writes a raw header and checks that the reader rejects it */
+static void checkRejected(uint32_t magic, uint32_t len, unsigned size,
+			  const char *what)
+{
+	ogl_msg_reader_t reader;
+	ogl_msg_hdr_t hdr;
+	ogl_msg_t msg;
+	char buf[64];
+	int sock[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sock) < 0 ||
+	    oglReaderInit(&reader, size) < 0) {
+		CHECK(0, "cannot open a socketpair");
+		return;
+	}
+
+	hdr.magic = htonl(magic);
+	hdr.type = htons(OGL_MSG_PING);
+	hdr.flags = 0;
+	hdr.len = htonl(len);
+	writeAll(sock[0], (const char *)&hdr, sizeof(hdr));
+	CHECK(oglReceiveMessage(&reader, sock[1], &msg) < 0,
+	      "%s accepted by the reader", what);
+
+	writeAll(sock[0], (const char *)&hdr, sizeof(hdr));
+	CHECK(oglReceiveMessageExact(sock[1], &msg, buf, sizeof(buf)) < 0,
+	      "%s accepted by the exact reader", what);
+
+	oglReaderRelease(&reader);
+	close(sock[0]);
+	close(sock[1]);
+}
+
+static void testOversizedFrames(loopback_t *lb)
+{
+	static char big[TEST_READER_SIZE];
+	ogl_msg_t msg;
+	unsigned len = TEST_READER_SIZE - sizeof(ogl_msg_hdr_t);
+
+	CHECK(oglSendMessage(lb->sock[0], OGL_MSG_PING, big,
+			     OGL_MSG_MAX_PAYLOAD + 1, -1) < 0,
+	      "payload over OGL_MSG_MAX_PAYLOAD sent");
+
+	/* the largest frame the reader buffer holds */
+	fillPayload(big, len, 2);
+	CHECK(oglSendMessage(lb->sock[0], OGL_MSG_PING, big, len, -1) ==
+	      TEST_READER_SIZE, "largest frame not sent");
+	CHECK(oglReceiveMessage(&lb->reader, lb->sock[0], &msg) == 1 &&
+	      msg.len == len && !memcmp(msg.data, big, len),
+	      "largest frame not echoed");
+
+	checkRejected(OGL_MSG_MAGIC, len + 1, TEST_READER_SIZE,
+		      "frame over the reader size");
+	checkRejected(OGL_MSG_MAGIC, OGL_MSG_MAX_PAYLOAD + 1,
+		      2 * OGL_MSG_MAX_PAYLOAD, "payload over OGL_MSG_MAX_PAYLOAD");
+	checkRejected(OGL_MSG_MAGIC ^ 1, 4, TEST_READER_SIZE, "bad magic");
+}
+
+/*
+ * Valid requests and an invalid frame in one write: the valid ones are
+ * answered before the server drops the connection.
+ */
+static void testInvalidFrameAfterRequests(void)
+{
+	static const char *payloads[] = { "a", "bb", "ccc" };
+	char stream[4 * sizeof(ogl_msg_hdr_t) + 6];
+	ogl_msg_hdr_t hdr;
+	loopback_t lb;
+	ogl_msg_t msg;
+	size_t total = 0;
+	unsigned k;
+
+	if (loopbackOpen(&lb) < 0) {
+		CHECK(0, "cannot start the echo server");
+		return;
+	}
+
+	for (k = 0; k < 4; k++) {
+		hdr.magic = htonl(k < 3 ? OGL_MSG_MAGIC : OGL_MSG_MAGIC ^ 1);
+		hdr.type = htons(OGL_MSG_PING);
+		hdr.flags = 0;
+		hdr.len = htonl(k < 3 ? strlen(payloads[k]) : 0);
+		memcpy(stream + total, &hdr, sizeof(hdr));
+		total += sizeof(hdr);
+		if (k < 3) {
+			memcpy(stream + total, payloads[k], strlen(payloads[k]));
+			total += strlen(payloads[k]);
+		}
+	}
+	writeAll(lb.sock[0], stream, total);
+
+	for (k = 0; k < 3; k++)
+		CHECK(oglReceiveMessage(&lb.reader, lb.sock[0], &msg) == 1 &&
+		      msg.len == strlen(payloads[k]) &&
+		      !memcmp(msg.data, payloads[k], msg.len),
+		      "reply %u before the invalid frame lost", k);
+	CHECK(oglReceiveMessage(&lb.reader, lb.sock[0], &msg) == 0,
+	      "connection not closed after the invalid frame");
+
+	loopbackClose(&lb);
+}
+
+/* More requests than one batch, written before any reply is read */
+static void testLargeBatches(loopback_t *lb)
+{
+	ogl_msg_t msgs[TEST_MANY], msg;
+	char payloads[TEST_MANY][16];
+	unsigned k, sent;
+
+	for (k = 0; k < TEST_MANY; k++) {
+		msgs[k].type = OGL_MSG_PING;
+		msgs[k].data = payloads[k];
+		msgs[k].len = snprintf(payloads[k], sizeof(payloads[k]),
+				       "cmd %u", k);
+		msgs[k].fd = -1;
+	}
+
+	CHECK(oglSendMessages(lb->sock[0], msgs, OGL_MSG_MAX_BATCH + 1) < 0,
+	      "batch over OGL_MSG_MAX_BATCH sent");
+
+	for (sent = 0; sent < TEST_MANY; sent += k) {
+		k = TEST_MANY - sent;
+		if (k > OGL_MSG_MAX_BATCH)
+			k = OGL_MSG_MAX_BATCH;
+		CHECK(oglSendMessages(lb->sock[0], msgs + sent, k) > 0,
+		      "batch at %u not sent", sent);
+	}
+
+	for (k = 0; k < TEST_MANY; k++)
+		CHECK(oglReceiveMessage(&lb->reader, lb->sock[0], &msg) == 1 &&
+		      msg.len == msgs[k].len &&
+		      !memcmp(msg.data, payloads[k], msg.len),
+		      "reply %u out of order", k);
+}
+
+static void testFdPassing(loopback_t *lb)
+{
+	ogl_msg_t msgs[2 * OGL_MSG_MAX_FDS], msg;
+	ogl_msg_reader_t reader;
+	unsigned long sums[2 * OGL_MSG_MAX_FDS];
+	char data[4096];
+	int fds[OGL_MSG_MAX_FDS + 1], sock[2];
+	int before = countFds();
+	unsigned k, nfds = 0;
+
+	/* descriptors on every other message of a batch */
+	for (k = 0; k < 2 * OGL_MSG_MAX_FDS; k++) {
+		msgs[k].data = NULL;
+		msgs[k].len = 0;
+		msgs[k].fd = -1;
+		if (k & 1) {
+			msgs[k].type = OGL_MSG_PING;
+			continue;
+		}
+		fillPayload(data, sizeof(data) - k, k);
+		fds[nfds] = oglCreatePayloadFd(data, sizeof(data) - k);
+		CHECK(fds[nfds] >= 0, "no payload descriptor");
+		sums[k] = sumFd(fds[nfds]);
+		msgs[k].type = OGL_MSG_SPLASH;
+		msgs[k].fd = fds[nfds++];
+	}
+	CHECK(oglSendMessages(lb->sock[0], msgs, 2 * OGL_MSG_MAX_FDS) > 0,
+	      "descriptor batch not sent");
+	for (k = 0; k < nfds; k++)
+		close(fds[k]);
+
+	for (k = 0; k < 2 * OGL_MSG_MAX_FDS; k++) {
+		CHECK(oglReceiveMessage(&lb->reader, lb->sock[0], &msg) == 1,
+		      "reply %u missing", k);
+		if (k & 1)
+			continue;
+		CHECK(msg.type == (OGL_MSG_SPLASH | OGL_MSG_REPLY) &&
+		      strtoul((const char *)msg.data, NULL, 10) == sums[k],
+		      "descriptor %u not passed", k / 2);
+	}
+
+	/* a header that claims a descriptor which never came */
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sock) < 0 ||
+	    oglReaderInit(&reader, TEST_READER_SIZE) < 0) {
+		CHECK(0, "cannot open a socketpair");
+		return;
+	}
+	oglSendMessage(sock[0], OGL_MSG_SPLASH, NULL, 0, -1);
+	CHECK(oglReceiveMessage(&reader, sock[1], &msg) == 1 && msg.fd == -1,
+	      "frame without descriptor");
+	{
+		ogl_msg_hdr_t hdr;
+
+		hdr.magic = htonl(OGL_MSG_MAGIC);
+		hdr.type = htons(OGL_MSG_SPLASH);
+		hdr.flags = htons(OGL_MSG_FD);
+		hdr.len = 0;
+		writeAll(sock[0], (const char *)&hdr, sizeof(hdr));
+	}
+	CHECK(oglReceiveMessage(&reader, sock[1], &msg) < 0,
+	      "missing descriptor accepted");
+	oglReaderRelease(&reader);
+	close(sock[0]);
+	close(sock[1]);
+
+	/* more descriptors than one sendmsg carries */
+	for (k = 0; k <= OGL_MSG_MAX_FDS; k++) {
+		fds[k] = oglCreatePayloadFd(data, 1);
+		msgs[k].type = OGL_MSG_SPLASH;
+		msgs[k].data = NULL;
+		msgs[k].len = 0;
+		msgs[k].fd = fds[k];
+	}
+	CHECK(oglSendMessages(lb->sock[0], msgs, OGL_MSG_MAX_FDS + 1) < 0,
+	      "batch over OGL_MSG_MAX_FDS sent");
+	for (k = 0; k <= OGL_MSG_MAX_FDS; k++)
+		close(fds[k]);
+
+	CHECK(countFds() == before, "%d descriptors leaked",
+	      countFds() - before);
+}
+
+static void benchCommands(loopback_t *lb)
+{
+	static const unsigned batches[] = { 1, 8, OGL_MSG_MAX_BATCH };
+	ogl_msg_t msgs[OGL_MSG_MAX_BATCH], msg;
+	char payload[16];
+	double start;
+	unsigned i, b, k;
+
+	for (k = 0; k < OGL_MSG_MAX_BATCH; k++) {
+		msgs[k].type = OGL_MSG_PING;
+		msgs[k].data = payload;
+		msgs[k].len = sizeof(payload);
+		msgs[k].fd = -1;
+	}
+
+	for (b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+		start = now();
+		for (i = 0; i < BENCH_COMMANDS; i += batches[b]) {
+			oglSendMessages(lb->sock[0], msgs, batches[b]);
+			for (k = 0; k < batches[b]; k++)
+				oglReceiveMessage(&lb->reader, lb->sock[0], &msg);
+		}
+		printf("ping, batches of %2u: %8.0f commands/s\n", batches[b],
+		       BENCH_COMMANDS / (now() - start));
+	}
+}
+
+static void benchPayload(loopback_t *lb)
+{
+	char *data = (char *)malloc(BENCH_PAYLOAD);
+	ogl_msg_t msg;
+	size_t off;
+	double start;
+	unsigned len;
+	int fd;
+
+	if (!data)
+		return;
+	fillPayload(data, BENCH_PAYLOAD, 3);
+
+	start = now();
+	for (off = 0; off < BENCH_PAYLOAD; off += len) {
+		len = BENCH_PAYLOAD - off < BENCH_FRAME ?
+		      BENCH_PAYLOAD - off : BENCH_FRAME;
+		oglSendMessage(lb->sock[0], OGL_MSG_PING, data + off, len, -1);
+		oglReceiveMessage(&lb->reader, lb->sock[0], &msg);
+	}
+	printf("%u byte frames, echoed: %6.0f MB/s\n", BENCH_FRAME,
+	       BENCH_PAYLOAD / 1e6 / (now() - start));
+
+	/* including writing the file and the server reading all of it */
+	start = now();
+	fd = oglCreatePayloadFd(data, BENCH_PAYLOAD);
+	if (fd >= 0) {
+		oglSendMessage(lb->sock[0], OGL_MSG_SPLASH, NULL, 0, fd);
+		close(fd);
+		oglReceiveMessage(&lb->reader, lb->sock[0], &msg);
+		printf("descriptor payload:        %6.0f MB/s\n",
+		       BENCH_PAYLOAD / 1e6 / (now() - start));
+	}
+
+	free(data);
+}
+
+int main(int argc, char *argv[])
+{
+	loopback_t lb;
+
+	alarm(TEST_TIMEOUT);
+	if (loopbackOpen(&lb) < 0) {
+		printf("cannot start the echo server\n");
+		return 1;
+	}
+
+	testSplitFrames();
+	testEmptyFrames(&lb);
+	testOversizedFrames(&lb);
+	testInvalidFrameAfterRequests();
+	testLargeBatches(&lb);
+	testFdPassing(&lb);
+	if (argc < 2 || strcmp(argv[1], "--no-bench")) {
+		benchCommands(&lb);
+		benchPayload(&lb);
+	}
+
+	loopbackClose(&lb);
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,713 @@
+/*
+ * Copyright (c) 2015, NVIDIA Corporation.  All Rights Reserved.
+ *
+ * BY INSTALLING THE SOFTWARE THE USER AGREES TO THE TERMS BELOW.
+ *
+ * User agrees to use the software under carefully controlled conditions
+ * and to inform all employees and contractors who have access to the software
+ * that the source code of the software is confidential and proprietary
+ * information of NVIDIA and is licensed to user as such.  User acknowledges
+ * and agrees that protection of the source code is essential and user shall
+ * retain the source code in strict confidence.  User shall restrict access to
+ * the source code of the software to those employees and contractors of user
+ * who have agreed to be bound by a confidentiality obligation which
+ * incorporates the protections and restrictions substantially set forth
+ * herein, and who have a need to access the source code in order to carry out
+ * the business purpose between NVIDIA and user.  The software provided
+ * herewith to user may only be used so long as the software is used solely
+ * with NVIDIA products and no other third party products (hardware or
+ * software).   The software must carry the NVIDIA copyright notice shown
+ * above.  User must not disclose, copy, duplicate, reproduce, modify,
+ * publicly display, create derivative works of the software other than as
+ * expressly authorized herein.  User must not under any circumstances,
+ * distribute or in any way disseminate the information contained in the
+ * source code and/or the source code itself to third parties except as
+ * expressly agreed to by NVIDIA.  In the event that user discovers any bugs
+ * in the software, such bugs must be reported to NVIDIA and any fixes may be
+ * inserted into the source code of the software by NVIDIA only.  User shall
+ * not modify the source code of the software in any way.  User shall be fully
+ * responsible for the conduct of all of its employees, contractors and
+ * representatives who may in any way violate these restrictions.
+ *
+ * NO WARRANTY
+ * THE ACCOMPANYING SOFTWARE (INCLUDING OBJECT AND SOURCE CODE) PROVIDED BY
+ * NVIDIA TO USER IS PROVIDED "AS IS."  NVIDIA DISCLAIMS ALL WARRANTIES,
+ * EXPRESS, IMPLIED OR STATUTORY, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF TITLE, MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.
+
+ * LIMITATION OF LIABILITY
+ * NVIDIA SHALL NOT BE LIABLE TO USER, USERS CUSTOMERS, OR ANY OTHER PERSON
+ * OR ENTITY CLAIMING THROUGH OR UNDER USER FOR ANY LOSS OF PROFITS, INCOME,
+ * SAVINGS, OR ANY OTHER CONSEQUENTIAL, INCIDENTAL, SPECIAL, PUNITIVE, DIRECT
+ * OR INDIRECT DAMAGES (WHETHER IN AN ACTION IN CONTRACT, TORT OR BASED ON A
+ * WARRANTY), EVEN IF NVIDIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGES.  THESE LIMITATIONS SHALL APPLY NOTWITHSTANDING ANY FAILURE OF THE
+ * ESSENTIAL PURPOSE OF ANY LIMITED REMEDY.  IN NO EVENT SHALL NVIDIAS
+ * AGGREGATE LIABILITY TO USER OR ANY OTHER PERSON OR ENTITY CLAIMING THROUGH
+ * OR UNDER USER EXCEED THE AMOUNT OF MONEY ACTUALLY PAID BY USER TO NVIDIA
+ * FOR THE SOFTWARE PROVIDED HEREWITH.
+ */
+
+/*
+ * Checks TGADecodeScanlines, which decodes from the file mapping, against
+ * the stdio decoder TGAReadScanlines, and times TGAReadImage on both.
+ *
+ * The mapped decoder runs on a copy of the mapping placed right before an
+ * inaccessible page, so reading past the mapping size faults.  Truncated
+ * files must decode the same complete rows on both paths and fail the
+ * same way.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "tga.h"
+
+#define TEST_PATH_SIZE	64
+
+static int failures = 0;
+static unsigned int seed = 1;
+static char path[TEST_PATH_SIZE];
+
+#define CHECK(cond, ...) \
+	do { \
+		if (!(cond)) { \
+			printf("FAIL %s:%d: ", __func__, __LINE__); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+			failures++; \
+		} \
+	} while (0)
+
+typedef struct {
+	int	width;
+	int	height;
+	int	depth;
+	int	alpha;
+	int	cmap;	/* 8-bit color-mapped with a 24-bit map */
+	int	rle;
+	int	top;	/* first row in the file is the top one */
+	int	cross;	/* RLE packets run on into the next scanline */
+} TestImage;
+
+/* The mapping copy and the pages it sits in */
+typedef struct {
+	tbyte	*map;
+	size_t	map_size;
+	tbyte	*base;
+	size_t	size;
+} Guard;
+
+static unsigned int
+Rand(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static double
+GetTimeSec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+Describe(const TestImage *img, char *buf, size_t size)
+{
+	snprintf(buf, size, "%dx%d depth %d%s%s%s%s%s",
+		 img->width, img->height, img->depth,
+		 img->alpha ? " alpha" : "", img->cmap ? " cmap" : "",
+		 img->rle ? " rle" : " raw", img->top ? " top" : " bottom",
+		 img->cross ? " cross" : "");
+}
+
+/* Random pixels in runs, so the RLE encoder finds both packet types */
+static void
+MakePixels(const TestImage *img, tbyte *pixels)
+{
+	int bytes = TGA_BYTE_DEPTH(img->depth);
+	int size = img->width * img->height;
+	int x, n, k, i;
+
+	for (x = 0; x < size; x += n) {
+		n = 1 + Rand() % 20;
+		if (x + n > size)
+			n = size - x;
+		for (i = 0; i < bytes; i++)
+			pixels[x * bytes + i] = Rand();
+		for (k = 1; k < n; k++) {
+			for (i = 0; i < bytes; i++)
+				pixels[(x + k) * bytes + i] = (Rand() & 1) ?
+					pixels[x * bytes + i] : Rand();
+			if (Rand() & 1)
+				memcpy(pixels + (x + k) * bytes,
+				       pixels + x * bytes, bytes);
+		}
+	}
+}
+
+/* Encodes count pixels into packets of up to 128 pixels */
+static tbyte *
+EncodeRLE(tbyte *dst, const tbyte *src, int count, int bytes)
+{
+	int x, n;
+
+	for (x = 0; x < count; x += n) {
+		n = 1;
+		while (x + n < count && n < 128 &&
+		       !memcmp(src + (x + n) * bytes, src + x * bytes, bytes))
+			n++;
+		if (n > 1) {
+			*dst++ = 0x80 | (n - 1);
+			memcpy(dst, src + x * bytes, bytes);
+			dst += bytes;
+			continue;
+		}
+
+		while (x + n < count && n < 128 &&
+		       (x + n + 1 >= count ||
+			memcmp(src + (x + n) * bytes,
+			       src + (x + n + 1) * bytes, bytes)))
+			n++;
+		*dst++ = n - 1;
+		memcpy(dst, src + x * bytes, n * bytes);
+		dst += n * bytes;
+	}
+
+	return dst;
+}
+
+/* Builds the file for pixels given in file order, returns its size */
+static size_t
+BuildFile(const TestImage *img, const tbyte *pixels, tbyte **file)
+{
+	int bytes = TGA_BYTE_DEPTH(img->depth);
+	size_t sln_size = (size_t)img->width * bytes;
+	size_t size = TGA_HEADER_SIZE + 3 + 256 * 3 +
+		      (sln_size + img->width + 1) * img->height;
+	tbyte *p;
+	int i, y;
+
+	*file = p = malloc(size);
+	if (!p)
+		return 0;
+
+	memset(p, 0, TGA_HEADER_SIZE);
+	p[0] = 3;
+	p[1] = img->cmap;
+	p[2] = (img->cmap ? 1 : img->depth == 8 ? 3 : 2) + (img->rle ? 8 : 0);
+	if (img->cmap) {
+		p[6] = 1;	/* 256 entries */
+		p[7] = 24;
+	}
+	p[12] = img->width & 0xff;
+	p[13] = img->width >> 8;
+	p[14] = img->height & 0xff;
+	p[15] = img->height >> 8;
+	p[16] = img->depth;
+	p[17] = img->alpha | (img->top ? 0x20 : 0);
+	p += TGA_HEADER_SIZE;
+
+	memcpy(p, "abc", 3);
+	p += 3;
+	if (img->cmap) {
+		for (i = 0; i < 256 * 3; i++)
+			*p++ = Rand();
+	}
+
+	if (!img->rle) {
+		memcpy(p, pixels, sln_size * img->height);
+		p += sln_size * img->height;
+	} else if (img->cross) {
+		p = EncodeRLE(p, pixels, img->width * img->height, bytes);
+	} else {
+		for (y = 0; y < img->height; y++)
+			p = EncodeRLE(p, pixels + y * sln_size, img->width,
+				      bytes);
+	}
+
+	return p - *file;
+}
+
+static int
+WriteFile(const tbyte *data, size_t size)
+{
+	FILE *f = fopen(path, "wb");
+	int ok;
+
+	if (!f)
+		return 0;
+	ok = size == 0 || fwrite(data, size, 1, f) == 1;
+	return fclose(f) == 0 && ok;
+}
+
+/* Opens the file in path for the stdio decoder or the mapped one */
+static TGA *
+Open(int mapped, Guard *guard)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	TGA *tga = TGAOpen(path);
+
+	memset(guard, 0, sizeof(*guard));
+	if (!tga || !tga->map)
+		return tga;
+
+	if (mapped) {
+		guard->size = (tga->map_size + page - 1) / page * page + page;
+		guard->base = mmap(NULL, guard->size, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (guard->base == MAP_FAILED) {
+			guard->base = NULL;
+			return tga;
+		}
+		mprotect(guard->base + guard->size - page, page, PROT_NONE);
+		guard->map_size = tga->map_size;
+		guard->map = guard->base + guard->size - page - tga->map_size;
+		memcpy(guard->map, tga->map, tga->map_size);
+	}
+
+	munmap(tga->map, tga->map_size);
+	tga->map = guard->map;
+	tga->map_size = guard->map_size;
+	return tga;
+}
+
+static void
+Close(TGA *tga, Guard *guard)
+{
+	if (!tga)
+		return;
+	if (guard->base)
+		munmap(guard->base, guard->size);
+	tga->map = NULL;
+	TGAClose(tga);
+}
+
+/* Complete rows land at the same place on both paths */
+static size_t
+RowOffset(const TestImage *img, size_t row)
+{
+	if (img->top)
+		row = img->height - 1 - row;
+	return row * img->width * TGA_BYTE_DEPTH(img->depth);
+}
+
+/*
+ * Decodes the file in path on both paths.  full tells whether the file
+ * is complete, pixels then holds the expected rows in file order.
+ */
+static void
+CheckScanlines(const TestImage *img, const tbyte *pixels, int full,
+	       const char *name)
+{
+	size_t sln_size = (size_t)img->width * TGA_BYTE_DEPTH(img->depth);
+	size_t size = sln_size * img->height;
+	size_t read[2] = { 0, 0 }, row;
+	tbyte *buf[2];
+	Guard guard;
+	TGA *tga;
+	int m;
+
+	buf[0] = malloc(size);
+	buf[1] = malloc(size);
+	if (!buf[0] || !buf[1]) {
+		CHECK(0, "out of memory");
+		goto done;
+	}
+
+	for (m = 0; m < 2; m++) {
+		memset(buf[m], 0xa5, size);
+		tga = Open(m, &guard);
+		if (!tga || TGAReadHeader(tga) != TGA_OK) {
+			Close(tga, &guard);
+			continue;
+		}
+		if (m == 0)
+			read[m] = TGAReadScanlines(tga, buf[m], 0,
+						   img->height, 0);
+		else if (tga->map)
+			read[m] = TGADecodeScanlines(tga, buf[m], 0);
+		Close(tga, &guard);
+	}
+
+	if (full) {
+		CHECK(read[1] == (size_t)img->height, "%s: mapped read %zu rows",
+		      name, read[1]);
+		for (row = 0; row < read[1]; row++) {
+			CHECK(!memcmp(buf[1] + RowOffset(img, row),
+				      pixels + row * sln_size, sln_size),
+			      "%s: mapped row %zu differs", name, row);
+		}
+	}
+
+	/* the stdio decoder starts a new packet on every scanline */
+	if (img->cross) {
+		CHECK(full || read[1] < (size_t)img->height,
+		      "%s: truncated file decoded", name);
+		goto done;
+	}
+
+	CHECK(read[0] == read[1], "%s: %zu rows from stdio, %zu mapped",
+	      name, read[0], read[1]);
+	for (row = 0; row < read[0] && row < read[1]; row++) {
+		CHECK(!memcmp(buf[0] + RowOffset(img, row),
+			      buf[1] + RowOffset(img, row), sln_size),
+		      "%s: row %zu differs", name, row);
+	}
+
+done:
+	free(buf[0]);
+	free(buf[1]);
+}
+
+/*
+ * TGAReadImage on both paths, with and without the RGB conversion.  A
+ * file cut before data_off fails on the two paths with different errors.
+ */
+static void
+CheckReadImage(const TestImage *img, int full, size_t data_off,
+	       size_t file_size, const char *name)
+{
+	static const tuint32 flags[] = { TGA_IMAGE_DATA | TGA_RGB, TGA_IMAGE_DATA };
+	TGAData data[2];
+	TGA *tga[2];
+	Guard guard[2];
+	int ok[2];
+	size_t size;
+	unsigned int f;
+	int m;
+
+	for (f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+		for (m = 0; m < 2; m++) {
+			memset(&data[m], 0, sizeof(data[m]));
+			data[m].flags = flags[f];
+			tga[m] = Open(m, &guard[m]);
+			if (tga[m])
+				TGAReadImage(tga[m], &data[m]);
+			/* TGAReadImage returns TGA_OK on failure too */
+			ok[m] = tga[m] && tga[m]->last == TGA_OK &&
+				(data[m].flags & TGA_IMAGE_DATA);
+		}
+
+		CHECK(!full || ok[1], "%s flags %#x: mapped read failed",
+		      name, flags[f]);
+		CHECK(full || !ok[1], "%s flags %#x: truncated file read",
+		      name, flags[f]);
+
+		if (!tga[0] || !tga[1]) {
+			CHECK(0, "%s: cannot open", name);
+		} else if (img->cross) {
+			/* only the mapped decoder handles these */
+		} else if (ok[0] != ok[1]) {
+			CHECK(0, "%s flags %#x: %s on stdio, %s mapped", name,
+			      flags[f], ok[0] ? "read" : "failed",
+			      ok[1] ? "read" : "failed");
+		} else if (data_off <= file_size && tga[0]->last != tga[1]->last) {
+			CHECK(0, "%s flags %#x: errors %d and %d", name,
+			      flags[f], tga[0]->last, tga[1]->last);
+		} else if (ok[0]) {
+			size = TGA_IMG_DATA_SIZE(tga[0]);
+			CHECK(tga[0]->hdr.depth == tga[1]->hdr.depth &&
+			      size == TGA_IMG_DATA_SIZE(tga[1]) &&
+			      !memcmp(data[0].img_data, data[1].img_data, size),
+			      "%s flags %#x: image data differs", name, flags[f]);
+			CHECK(!data[0].cmap == !data[1].cmap &&
+			      (!data[0].cmap ||
+			       !memcmp(data[0].cmap, data[1].cmap,
+				       TGA_CMAP_SIZE(tga[0]))),
+			      "%s flags %#x: color map differs", name, flags[f]);
+		}
+
+		for (m = 0; m < 2; m++) {
+			free(data[m].img_data);
+			free(data[m].cmap);
+			Close(tga[m], &guard[m]);
+		}
+	}
+}
+
+static void
+TestImages(void)
+{
+	static const TestImage formats[] = {
+		{ 0, 0,  8, 0, 0 },
+		{ 0, 0,  8, 0, 1 },
+		{ 0, 0, 15, 0, 0 },
+		{ 0, 0, 16, 1, 0 },
+		{ 0, 0, 16, 0, 0 },
+		{ 0, 0, 24, 0, 0 },
+		{ 0, 0, 32, 8, 0 },
+		{ 0, 0, 32, 0, 0 },
+	};
+	static const int widths[] = { 1, 2, 3, 5, 16, 17, 31, 64, 100, 333 };
+	TestImage img;
+	tbyte *pixels, *file;
+	size_t size;
+	unsigned int f, w;
+	int kind, top, cases = 0;
+	char name[96];
+
+	for (f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+		for (kind = 0; kind < 3; kind++) {
+			for (top = 0; top < 2; top++) {
+				for (w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+					img = formats[f];
+					img.width = widths[w];
+					img.height = 1 + Rand() % 40;
+					img.rle = kind > 0;
+					img.cross = kind > 1;
+					img.top = top;
+					Describe(&img, name, sizeof(name));
+
+					pixels = malloc((size_t)img.width * img.height * 4);
+					if (!pixels) {
+						CHECK(0, "out of memory");
+						return;
+					}
+					MakePixels(&img, pixels);
+					size = BuildFile(&img, pixels, &file);
+
+					if (!size || !WriteFile(file, size)) {
+						CHECK(0, "cannot write %s", path);
+					} else {
+						CheckScanlines(&img, pixels, 1, name);
+						CheckReadImage(&img, 1, 0, size, name);
+					}
+					cases++;
+
+					free(file);
+					free(pixels);
+				}
+			}
+		}
+	}
+
+	printf("images: %d checked\n", cases);
+}
+
+/* Large enough for the uncompressed decode to be split in strips */
+static void
+TestLargeImage(void)
+{
+	TestImage img = { 1920, 1080, 24 };
+	tbyte *pixels, *file;
+	size_t size;
+	char name[96];
+
+	for (img.top = 0; img.top < 2; img.top++) {
+		Describe(&img, name, sizeof(name));
+		pixels = malloc((size_t)img.width * img.height * 3);
+		if (!pixels) {
+			CHECK(0, "out of memory");
+			return;
+		}
+		MakePixels(&img, pixels);
+		size = BuildFile(&img, pixels, &file);
+		if (!size || !WriteFile(file, size)) {
+			CHECK(0, "cannot write %s", path);
+		} else {
+			CheckScanlines(&img, pixels, 1, name);
+			CheckReadImage(&img, 1, 0, size, name);
+		}
+		free(file);
+		free(pixels);
+	}
+}
+
+static void
+TestTruncated(void)
+{
+	static const TestImage images[] = {
+		{ 37, 30, 24, 0, 0, 0, 0 },
+		{ 37, 30, 24, 0, 0, 0, 1 },
+		{ 37, 30, 32, 8, 0, 1, 0 },
+		{ 37, 30, 32, 8, 0, 1, 1 },
+		{ 37, 30, 16, 0, 0, 1, 1, 1 },
+		{ 37, 30,  8, 0, 1, 1, 0 },
+		{ 700, 9, 32, 0, 0, 0, 0 },
+		{ 700, 9, 32, 8, 0, 1, 1 },
+	};
+	long page = sysconf(_SC_PAGESIZE);
+	TestImage img;
+	tbyte *pixels, *file;
+	size_t size, data_off, cut;
+	unsigned int i;
+	int cuts = 0;
+	char name[128], desc[96];
+
+	for (i = 0; i < sizeof(images) / sizeof(images[0]); i++) {
+		img = images[i];
+		pixels = malloc((size_t)img.width * img.height * 4);
+		if (!pixels) {
+			CHECK(0, "out of memory");
+			return;
+		}
+		MakePixels(&img, pixels);
+		size = BuildFile(&img, pixels, &file);
+		data_off = TGA_HEADER_SIZE + 3 + (img.cmap ? 256 * 3 : 0);
+		Describe(&img, desc, sizeof(desc));
+
+		/* every length through the headers and the first rows, then
+		 * every 7th byte, and the whole pages */
+		for (cut = 0; cut < size; cut += cut < data_off + 64 ? 1 : 7) {
+			snprintf(name, sizeof(name), "%s cut at %zu", desc, cut);
+			if (!WriteFile(file, cut)) {
+				CHECK(0, "cannot write %s", path);
+				break;
+			}
+			CheckScanlines(&img, NULL, 0, name);
+			CheckReadImage(&img, 0, data_off, cut, name);
+			cuts++;
+		}
+		for (cut = page; cut < size; cut += page) {
+			snprintf(name, sizeof(name), "%s cut at %zu", desc, cut);
+			if (WriteFile(file, cut)) {
+				CheckScanlines(&img, NULL, 0, name);
+				CheckReadImage(&img, 0, data_off, cut, name);
+				cuts++;
+			}
+		}
+
+		free(file);
+		free(pixels);
+	}
+
+	printf("truncated: %d files checked\n", cuts);
+}
+
+/* Depths the decoders do not handle fail on both paths */
+static void
+TestBadHeader(void)
+{
+	static const int depths[][2] = { { 7, 0 }, { 24, 1 }, { 0, 0 } };
+	TestImage img = { 4, 4, 8 };
+	TGAData data;
+	Guard guard;
+	TGA *tga;
+	tbyte pixels[16], *file;
+	size_t size;
+	unsigned int i;
+	int m;
+
+	MakePixels(&img, pixels);
+	size = BuildFile(&img, pixels, &file);
+	for (i = 0; size && i < sizeof(depths) / sizeof(depths[0]); i++) {
+		file[1] = depths[i][1];
+		file[16] = depths[i][0];
+		if (!WriteFile(file, size)) {
+			CHECK(0, "cannot write %s", path);
+			break;
+		}
+		for (m = 0; m < 2; m++) {
+			memset(&data, 0, sizeof(data));
+			data.flags = TGA_IMAGE_DATA;
+			tga = Open(m, &guard);
+			if (!tga) {
+				CHECK(0, "cannot open %s", path);
+				continue;
+			}
+			TGAReadImage(tga, &data);
+			CHECK(tga->last == TGA_UNKNOWN_SUB_FORMAT,
+			      "depth %d map %d: error %d", depths[i][0],
+			      depths[i][1], tga->last);
+			free(data.img_data);
+			Close(tga, &guard);
+		}
+	}
+	free(file);
+}
+
+static void
+BenchmarkReadImage(void)
+{
+	static const TestImage images[] = {
+		{ 1920, 1080, 24, 0, 0, 0, 1 },
+		{ 1920, 1080, 24, 0, 0, 1, 1 },
+		{ 1920, 1080, 32, 8, 0, 0, 1 },
+		{ 1920, 1080, 32, 8, 0, 1, 1 },
+		{ 1920, 1080, 32, 0, 0, 0, 1 },
+	};
+	const int loops = 10;
+	TestImage img;
+	TGAData data;
+	TGA *tga;
+	tbyte *pixels, *file;
+	size_t size;
+	double start, elapsed[2];
+	unsigned int i;
+	int m, k;
+	char name[96];
+
+	for (i = 0; i < sizeof(images) / sizeof(images[0]); i++) {
+		img = images[i];
+		pixels = malloc((size_t)img.width * img.height * 4);
+		if (!pixels)
+			return;
+		MakePixels(&img, pixels);
+		size = BuildFile(&img, pixels, &file);
+		if (!size || !WriteFile(file, size)) {
+			free(file);
+			free(pixels);
+			return;
+		}
+
+		for (m = 0; m < 2; m++) {
+			start = GetTimeSec();
+			for (k = 0; k < loops; k++) {
+				memset(&data, 0, sizeof(data));
+				data.flags = TGA_IMAGE_DATA | TGA_RGB;
+				/* the real mapping, without the guard copy */
+				tga = TGAOpen(path);
+				if (!tga)
+					break;
+				if (m == 0 && tga->map) {
+					munmap(tga->map, tga->map_size);
+					tga->map = NULL;
+				}
+				TGAReadImage(tga, &data);
+				free(data.img_data);
+				TGAClose(tga);
+			}
+			elapsed[m] = (GetTimeSec() - start) / loops;
+		}
+
+		Describe(&img, name, sizeof(name));
+		printf("%-32s stdio %6.2f ms, mapped %6.2f ms\n", name,
+		       elapsed[0] * 1e3, elapsed[1] * 1e3);
+
+		free(file);
+		free(pixels);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	int fd;
+
+	snprintf(path, sizeof(path), "/tmp/test_tgaread.XXXXXX");
+	fd = mkstemp(path);
+	if (fd < 0) {
+		printf("cannot create a temporary file\n");
+		return 1;
+	}
+	close(fd);
+
+	TestImages();
+	TestLargeImage();
+	TestTruncated();
+	TestBadHeader();
+	if (argc < 2 || strcmp(argv[1], "--no-bench"))
+		BenchmarkReadImage();
+
+	unlink(path);
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
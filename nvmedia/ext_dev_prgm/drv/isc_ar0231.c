@@ -16,6 +16,7 @@
 #include "nvcommon.h"
 #include "isc_ar0231.h"
 #include "isc_ar0231_setting.h"
+#include "isc_regscript.h"
 
 #define REG_ADDRESS_BYTES     2u
 #define NUM_COMPANDING_KNEE_POINTS  12
@@ -118,8 +119,14 @@ typedef struct {
     NvU32 exposureModeMask;
     NvU8 fuseId[SIZE_FUSE_ID];
     unsigned int configSetIdx;   // 0 - internal sync, 1 - external sync
+    IscRegScriptCache scripts;   // compiled register scripts
 } _DriverHandle;
 
+typedef struct {
+    const NvMediaISCSupportFunctions *funcs;
+    NvMediaISCTransactionHandle *transaction;
+} WriteScriptContext;
+
 static NvMediaStatus
 WriteRegister(NvMediaISCDriverHandle *handle, NvMediaISCTransactionHandle *transaction,
         NvU32 registerNum, NvU32 dataLength, NvU8 *dataBuff);
@@ -149,6 +156,7 @@ DriverCreate(
     }
 
     drvrHandle->funcs = supportFunctions;
+    IscRegScriptCacheInit(&drvrHandle->scripts, REG_DATA_BYTES, ISC_REGSCRIPT_MAX_WRITE);
     drvrHandle->default_setting = ar0231_raw12_default;
     drvrHandle->tempratureData = 0;
 
@@ -210,6 +218,7 @@ DriverDestroy(
         return NVMEDIA_STATUS_BAD_PARAMETER;
     }
 
+    IscRegScriptCacheRelease(&((_DriverHandle *)handle)->scripts);
     free(handle);
 
     return NVMEDIA_STATUS_OK;
@@ -265,43 +274,41 @@ EnableLink(
     return NVMEDIA_STATUS_NOT_SUPPORTED;
 }
 
+static NvMediaStatus
+WriteScriptData(
+    void *context,
+    NvU32 dataLength,
+    const NvU8 *data)
+{
+    const WriteScriptContext *ctx = context;
+
+    return ctx->funcs->Write(ctx->transaction, dataLength, data);
+}
+
 static NvMediaStatus
 WriteArrayWithCommand(
     NvMediaISCDriverHandle *handle,
     NvMediaISCTransactionHandle *transaction,
     const NvU8 *arrayData)
 {
-    const NvMediaISCSupportFunctions *funcs;
-    NvMediaStatus status = NVMEDIA_STATUS_OK;
+    WriteScriptContext ctx;
+    const NvU8 *code;
 
     if((handle == NULL) || (transaction == NULL) || (arrayData == NULL)) {
         return NVMEDIA_STATUS_BAD_PARAMETER;
     }
 
-    funcs = ((_DriverHandle *)handle)->funcs;
-    while(arrayData[0] != (NvU8)'e') {
-        switch (arrayData[0]) {
-            case 'w':
-                status = funcs->Write(
-                    transaction,
-                    arrayData[1],
-                    &arrayData[2]);
-                arrayData += (arrayData[1] + 2u);
-                break;
-            case 'd':
-                (void)usleep((arrayData[1] << 8) + arrayData[2]);
-                arrayData += 3u;
-                break;
-            default:
-                break;
-        }
-
-        if(status != NVMEDIA_STATUS_OK) {
-            break;
-        }
+    // Replay the script compiled on first use, which writes runs of
+    // consecutive registers in one transaction
+    code = IscRegScriptCacheGet(&((_DriverHandle *)handle)->scripts, arrayData);
+    if(code == NULL) {
+        return NVMEDIA_STATUS_ERROR;
     }
 
-    return status;
+    ctx.funcs = ((_DriverHandle *)handle)->funcs;
+    ctx.transaction = transaction;
+
+    return IscRegScriptRun(code, WriteScriptData, NULL, &ctx);
 }
 
 static NvMediaStatus
@@ -15,6 +15,7 @@
 #include "nvmedia_isc.h"
 #include "isc_ar0231_rccb.h"
 #include "isc_ar0231_rccb_setting.h"
+#include "isc_regscript.h"
 
 #define NUM_COMPANDING_KNEE_POINTS  12
 
@@ -158,8 +159,14 @@ typedef struct {
     unsigned char fuseId[SIZE_FUSE_ID];
     unsigned int configSetIdx;   // 0 - internal sync, 1 - external sync
     TempSensCali tempSensCali;
+    IscRegScriptCache scripts;   // compiled register scripts
 } _DriverHandle;
 
+typedef struct {
+    const NvMediaISCSupportFunctions *funcs;
+    NvMediaISCTransactionHandle *transaction;
+} WriteScriptContext;
+
 static NvMediaStatus
 WriteRegister(NvMediaISCDriverHandle *handle, NvMediaISCTransactionHandle *transaction,
         unsigned int registerNum, unsigned int dataLength, unsigned char *dataBuff);
@@ -189,6 +196,7 @@ DriverCreate(
     }
 
     driverHandle->funcs = supportFunctions;
+    IscRegScriptCacheInit(&driverHandle->scripts, REG_DATA_BYTES, ISC_REGSCRIPT_MAX_WRITE);
     driverHandle->default_setting = ar0231_raw12_default_v7;
     driverHandle->tempSensCali.tempratureData[0] = 0;
     driverHandle->tempSensCali.tempratureData[1] = 0;
@@ -254,6 +262,7 @@ DriverDestroy(
         return NVMEDIA_STATUS_BAD_PARAMETER;
     }
 
+    IscRegScriptCacheRelease(&((_DriverHandle *)handle)->scripts);
     free(handle);
 
     return NVMEDIA_STATUS_OK;
@@ -312,43 +321,41 @@ EnableLink(
     return NVMEDIA_STATUS_NOT_SUPPORTED;
 }
 
+static NvMediaStatus
+WriteScriptData(
+    void *context,
+    NvU32 dataLength,
+    const NvU8 *data)
+{
+    const WriteScriptContext *ctx = context;
+
+    return ctx->funcs->Write(ctx->transaction, dataLength, (unsigned char *)data);
+}
+
 static NvMediaStatus
 WriteArrayWithCommand(
     NvMediaISCDriverHandle *handle,
     NvMediaISCTransactionHandle *transaction,
     const unsigned char *arrayData)
 {
-    NvMediaISCSupportFunctions *funcs;
-    NvMediaStatus status = NVMEDIA_STATUS_OK;
+    WriteScriptContext ctx;
+    const NvU8 *code;
 
     if(!handle || !transaction || !arrayData) {
         return NVMEDIA_STATUS_BAD_PARAMETER;
     }
 
-    funcs = ((_DriverHandle *)handle)->funcs;
-    while(arrayData[0] != 'e') {
-        switch (arrayData[0]) {
-            case 'w':
-                status = funcs->Write(
-                    transaction,
-                    arrayData[1],
-                    (unsigned char*)&arrayData[2]);
-                arrayData += (arrayData[1] + 2);
-                break;
-            case 'd':
-                usleep((arrayData[1] << 8) + arrayData[2]);
-                arrayData += 3;
-                break;
-            default:
-                break;
-        }
-
-        if(status != NVMEDIA_STATUS_OK) {
-            break;
-        }
+    // Replay the script compiled on first use, which writes runs of
+    // consecutive registers in one transaction
+    code = IscRegScriptCacheGet(&((_DriverHandle *)handle)->scripts, arrayData);
+    if(code == NULL) {
+        return NVMEDIA_STATUS_ERROR;
     }
 
-    return status;
+    ctx.funcs = ((_DriverHandle *)handle)->funcs;
+    ctx.transaction = transaction;
+
+    return IscRegScriptRun(code, WriteScriptData, NULL, &ctx);
 }
 
 static NvMediaStatus
@@ -13,6 +13,7 @@
 #include "nvmedia_isc.h"
 #include "isc_ov10635.h"
 #include "isc_ov10635_setting.h"
+#include "isc_regscript.h"
 
 #define REGISTER_ADDRESS_BYTES  2
 #define REG_WRITE_BUFFER        32
@@ -29,8 +30,14 @@
 typedef struct {
     NvMediaISCSupportFunctions *funcs;
     const unsigned char **sensor_settings;
+    IscRegScriptCache scripts;   // compiled register scripts
 } _DriverHandle;
 
+typedef struct {
+    NvMediaISCSupportFunctions *funcs;
+    NvMediaISCTransactionHandle *transaction;
+} WriteScriptContext;
+
 static unsigned char ov10635_sync[] = {
     3, 0x38, 0x32, 0x01,
     3, 0x38, 0x33, 0x08,
@@ -55,6 +62,9 @@ DriverCreate(
         return NVMEDIA_STATUS_OUT_OF_MEMORY;
 
     driverHandle->funcs = supportFunctions;
+    // Register auto-increment is not confirmed on the sensor, keep one
+    // transaction per write
+    IscRegScriptCacheInit(&driverHandle->scripts, 1, ISC_REGSCRIPT_NO_MERGE);
     driverHandle->sensor_settings = ov10635_sensor_settings;
 
     *handle = (NvMediaISCDriverHandle *)driverHandle;
@@ -69,6 +79,7 @@ DriverDestroy(
     if(!handle)
         return NVMEDIA_STATUS_BAD_PARAMETER;
 
+    IscRegScriptCacheRelease(&((_DriverHandle *)handle)->scripts);
     free(handle);
 
     return NVMEDIA_STATUS_OK;
@@ -114,62 +125,62 @@ WriteArray(
     return NVMEDIA_STATUS_OK;
 }
 
+static NvMediaStatus
+WriteScriptData(
+    void *context,
+    NvU32 dataLength,
+    const NvU8 *data)
+{
+    const WriteScriptContext *ctx = context;
+    NvMediaStatus status;
+
+    status = ctx->funcs->Write(
+        ctx->transaction,            // transaction
+        dataLength,                  // dataLength
+        (unsigned char*)data);
+#ifdef PRINT_LOG
+    {
+        unsigned char readData[1] = {0};
+
+        usleep(250);
+
+        status = ctx->funcs->Read(
+            ctx->transaction,           // transaction
+            REGISTER_ADDRESS_BYTES,     // regLength
+            (unsigned char*)data,       // regData
+            1,                          // dataLength
+            readData);                  // dataBuff
+
+        printf("++ %.2X%.2X %x\n", (unsigned int)data[0],
+            (unsigned int)data[1],
+            readData[0]);
+    }
+#endif
+    return status;
+}
+
 static NvMediaStatus
 WriteArrayWithCommand(
     NvMediaISCDriverHandle *handle,
     NvMediaISCTransactionHandle *transaction,
     const unsigned char *arrayData)
 {
-    NvMediaISCSupportFunctions *funcs;
-    NvMediaStatus status = NVMEDIA_STATUS_OK;
+    WriteScriptContext ctx;
+    const NvU8 *code;
 
     if(!handle)
         return NVMEDIA_STATUS_BAD_PARAMETER;
 
-    funcs = ((_DriverHandle *)handle)->funcs;
-    while(arrayData[0] != 'e') {
-        switch (arrayData[0]) {
-            case 'w':
-                status = funcs->Write(
-                    transaction,                 // transaction
-                    arrayData[1], // dataLength
-                    (unsigned char*)&arrayData[2]);
-#ifdef PRINT_LOG
-                {
-                    unsigned char data[1] = {0};
-
-                    usleep(250);
-
-                    status = funcs->Read(
-                        transaction,                // transaction
-                        REGISTER_ADDRESS_BYTES,     // regLength
-                        (unsigned char*)&arrayData[2],  // regData
-                        1,                          // dataLength
-                        data);                      // dataBuff
-
-                    printf("++ %.2X%.2X %x\n", (unsigned int)arrayData[2],
-                        (unsigned int)arrayData[3],
-                        data[0]);
-                }
-#endif
-                arrayData += (arrayData[1] + 2);
-
-                break;
-            case 'd':
-                usleep((arrayData[1] << 8) + arrayData[2]);
-                arrayData += 3;
-                break;
-            default:
-                break;
-        }
-
-        if(status != NVMEDIA_STATUS_OK) {
-            break;
-        }
+    // Replay the script compiled on first use, which writes runs of
+    // consecutive registers in one transaction
+    code = IscRegScriptCacheGet(&((_DriverHandle *)handle)->scripts, arrayData);
+    if(!code)
+        return NVMEDIA_STATUS_ERROR;
 
-    }
+    ctx.funcs = ((_DriverHandle *)handle)->funcs;
+    ctx.transaction = transaction;
 
-    return status;
+    return IscRegScriptRun(code, WriteScriptData, NULL, &ctx);
 }
 
 static NvMediaStatus
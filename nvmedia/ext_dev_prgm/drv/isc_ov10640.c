@@ -14,6 +14,7 @@
 #include "nvmedia_isc.h"
 #include "isc_ov10640.h"
 #include "isc_ov10640_setting.h"
+#include "isc_regscript.h"
 #include "log_utils.h"
 
 #define REGISTER_ADDRESS_BYTES  2
@@ -148,8 +149,14 @@ typedef struct {
     float minGain[NVMEDIA_ISC_EXPOSURE_MODE_MAX];
     NvMediaISCModuleConfig moduleCfg;
     unsigned int exposureModeMask;
+    IscRegScriptCache scripts;   // compiled register scripts
 } _DriverHandle;
 
+typedef struct {
+    NvMediaISCSupportFunctions *funcs;
+    NvMediaISCTransactionHandle *transaction;
+} WriteScriptContext;
+
 static const unsigned char ov10640_sync[] = {
     'w', 3, 0x30, 0x8c, 0xb3,
     'w', 3, 0x30, 0x93, 0x01, // row reset to 1. Default value is 0. Without this
@@ -255,6 +262,9 @@ DriverCreate(
         return NVMEDIA_STATUS_OUT_OF_MEMORY;
 
     driverHandle->funcs = supportFunctions;
+    // Register auto-increment is not confirmed on the sensor, keep one
+    // transaction per write
+    IscRegScriptCacheInit(&driverHandle->scripts, 1, ISC_REGSCRIPT_NO_MERGE);
     *handle = (NvMediaISCDriverHandle *)driverHandle;
 
     driverHandle->default_setting = ov10640_default;
@@ -302,6 +312,7 @@ DriverDestroy(
     if(!handle)
         return NVMEDIA_STATUS_BAD_PARAMETER;
 
+    IscRegScriptCacheRelease(&((_DriverHandle *)handle)->scripts);
     free(handle);
 
     return NVMEDIA_STATUS_OK;
@@ -348,61 +359,61 @@ WriteArray(
 }
 
 static NvMediaStatus
-WriteArrayWithCommand(
-    NvMediaISCDriverHandle *handle,
-    NvMediaISCTransactionHandle *transaction,
-    const unsigned char *arrayData)
+WriteScriptData(
+    void *context,
+    NvU32 dataLength,
+    const NvU8 *data)
 {
-    NvMediaISCSupportFunctions *funcs;
-    NvMediaStatus status = NVMEDIA_STATUS_OK;
-
-    if(!handle)
-        return NVMEDIA_STATUS_BAD_PARAMETER;
+    const WriteScriptContext *ctx = context;
+    NvMediaStatus status;
 
-    funcs = ((_DriverHandle *)handle)->funcs;
-    while(arrayData[0] != 'e') {
-        switch (arrayData[0]) {
-            case 'w':
-                status = funcs->Write(
-                    transaction,                 // transaction
-                    arrayData[1], // dataLength
-                    (unsigned char*)&arrayData[2]);
+    status = ctx->funcs->Write(
+        ctx->transaction,            // transaction
+        dataLength,                  // dataLength
+        (unsigned char*)data);
 #ifdef PRINT_LOG
-                {
-                    unsigned char data[1] = {0};
+    {
+        unsigned char readData[1] = {0};
 
-                    usleep(250);
+        usleep(250);
 
-                    status = funcs->Read(
-                        transaction,                // transaction
-                        REGISTER_ADDRESS_BYTES,     // regLength
-                        (unsigned char*)&arrayData[2],  // regData
-                        1,                          // dataLength
-                        data);                      // dataBuff
+        status = ctx->funcs->Read(
+            ctx->transaction,           // transaction
+            REGISTER_ADDRESS_BYTES,     // regLength
+            (unsigned char*)data,       // regData
+            1,                          // dataLength
+            readData);                  // dataBuff
 
-                    printf("++ %.2X%.2X %x\n", (unsigned int)arrayData[2],
-                        (unsigned int)arrayData[3],
-                        data[0]);
-                }
+        printf("++ %.2X%.2X %x\n", (unsigned int)data[0],
+            (unsigned int)data[1],
+            readData[0]);
+    }
 #endif
-                arrayData += (arrayData[1] + 2);
+    return status;
+}
 
-                break;
-            case 'd':
-                usleep((arrayData[1] << 8) + arrayData[2]);
-                arrayData += 3;
-                break;
-            default:
-                break;
-        }
+static NvMediaStatus
+WriteArrayWithCommand(
+    NvMediaISCDriverHandle *handle,
+    NvMediaISCTransactionHandle *transaction,
+    const unsigned char *arrayData)
+{
+    WriteScriptContext ctx;
+    const NvU8 *code;
 
-        if(status != NVMEDIA_STATUS_OK) {
-            break;
-        }
+    if(!handle)
+        return NVMEDIA_STATUS_BAD_PARAMETER;
 
-    }
+    // Replay the script compiled on first use, which writes runs of
+    // consecutive registers in one transaction
+    code = IscRegScriptCacheGet(&((_DriverHandle *)handle)->scripts, arrayData);
+    if(!code)
+        return NVMEDIA_STATUS_ERROR;
 
-    return status;
+    ctx.funcs = ((_DriverHandle *)handle)->funcs;
+    ctx.transaction = transaction;
+
+    return IscRegScriptRun(code, WriteScriptData, NULL, &ctx);
 }
 
 static NvMediaStatus
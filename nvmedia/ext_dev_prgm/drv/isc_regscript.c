@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION.  All rights reserved. All
+ * information contained herein is proprietary and confidential to NVIDIA
+ * Corporation.  Any use, reproduction, or disclosure without the written
+ * permission of NVIDIA Corporation is prohibited.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "log_utils.h"
+#include "isc_regscript.h"
+
+/* Returns the length of a 'w'/'d'/'e' script, 0 if it is malformed */
+static NvU32
+GetSourceLength(
+    const NvU8 *source)
+{
+    const NvU8 *p = source;
+
+    while(p[0] != (NvU8)'e') {
+        switch(p[0]) {
+            case 'w':
+                if(p[1] < ISC_REGSCRIPT_ADDRESS_BYTES) {
+                    return 0;
+                }
+                p += p[1] + 2u;
+                break;
+            case 'd':
+                p += 3u;
+                break;
+            default:
+                return 0;
+        }
+    }
+
+    return (NvU32)(p - source) + 1u;
+}
+
+NvMediaStatus
+IscRegScriptCompile(
+    const NvU8 *source,
+    NvU32 regBytes,
+    NvU32 maxWrite,
+    NvU8 **code,
+    NvU32 *codeLength)
+{
+    NvU8 *out, *burst = NULL, *delay = NULL;
+    NvU32 length, addr, dataLength, nextAddr = 0, usec;
+    NvMediaBool aligned;
+
+    if((source == NULL) || (code == NULL) || (regBytes == 0u) ||
+       (maxWrite > ISC_REGSCRIPT_MAX_WRITE)) {
+        return NVMEDIA_STATUS_BAD_PARAMETER;
+    }
+
+    length = GetSourceLength(source);
+    if(length == 0u) {
+        LOG_ERR("%s: Malformed register script\n", __func__);
+        return NVMEDIA_STATUS_BAD_PARAMETER;
+    }
+
+    /* Every command compiles to at most its own size */
+    *code = out = malloc(length);
+    if(out == NULL) {
+        return NVMEDIA_STATUS_OUT_OF_MEMORY;
+    }
+
+    while(source[0] != (NvU8)'e') {
+        if(source[0] == (NvU8)'d') {
+            usec = ((NvU32)source[1] << 8) + source[2];
+            if((delay != NULL) &&
+               (((NvU32)delay[1] << 8) + delay[2] + usec <= 0xffffu)) {
+                usec += ((NvU32)delay[1] << 8) + delay[2];
+            } else {
+                delay = out;
+                out += 3u;
+            }
+            delay[0] = ISC_REGSCRIPT_OP_DELAY;
+            delay[1] = (NvU8)(usec >> 8);
+            delay[2] = (NvU8)(usec & 0xffu);
+            burst = NULL;
+            source += 3u;
+            continue;
+        }
+
+        addr = ((NvU32)source[2] << 8) + source[3];
+        dataLength = source[1] - ISC_REGSCRIPT_ADDRESS_BYTES;
+        aligned = ((dataLength != 0u) && ((dataLength % regBytes) == 0u) &&
+                   ((addr % regBytes) == 0u)) ? NVMEDIA_TRUE : NVMEDIA_FALSE;
+
+        if((burst != NULL) && aligned && (addr == nextAddr) &&
+           (burst[1] + dataLength <= maxWrite)) {
+            /* Next registers of the open burst */
+            (void)memcpy(out, &source[4], dataLength);
+            burst[1] += (NvU8)dataLength;
+            out += dataLength;
+        } else {
+            out[0] = ISC_REGSCRIPT_OP_WRITE;
+            (void)memcpy(&out[1], &source[1], source[1] + 1u);
+            burst = aligned ? out : NULL;
+            out += source[1] + 2u;
+        }
+        nextAddr = addr + dataLength;
+        delay = NULL;
+        source += source[1] + 2u;
+    }
+    *out++ = ISC_REGSCRIPT_OP_END;
+
+    if(codeLength != NULL) {
+        *codeLength = (NvU32)(out - *code);
+    }
+
+    return NVMEDIA_STATUS_OK;
+}
+
+NvMediaStatus
+IscRegScriptRun(
+    const NvU8 *code,
+    IscRegScriptWriteFunc write,
+    IscRegScriptDelayFunc delay,
+    void *context)
+{
+    NvMediaStatus status = NVMEDIA_STATUS_OK;
+    NvU32 usec;
+
+    if((code == NULL) || (write == NULL)) {
+        return NVMEDIA_STATUS_BAD_PARAMETER;
+    }
+
+    while(code[0] != ISC_REGSCRIPT_OP_END) {
+        switch(code[0]) {
+            case ISC_REGSCRIPT_OP_WRITE:
+                status = write(context, code[1], &code[2]);
+                code += code[1] + 2u;
+                break;
+            case ISC_REGSCRIPT_OP_DELAY:
+                usec = ((NvU32)code[1] << 8) + code[2];
+                if(delay != NULL) {
+                    delay(context, usec);
+                } else {
+                    (void)usleep(usec);
+                }
+                code += 3u;
+                break;
+            default:
+                return NVMEDIA_STATUS_ERROR;
+        }
+
+        if(status != NVMEDIA_STATUS_OK) {
+            break;
+        }
+    }
+
+    return status;
+}
+
+void
+IscRegScriptCacheInit(
+    IscRegScriptCache *cache,
+    NvU32 regBytes,
+    NvU32 maxWrite)
+{
+    (void)memset(cache, 0, sizeof(*cache));
+    cache->regBytes = regBytes;
+    cache->maxWrite = maxWrite;
+}
+
+const NvU8 *
+IscRegScriptCacheGet(
+    IscRegScriptCache *cache,
+    const NvU8 *source)
+{
+    IscRegScriptCacheEntry *entry;
+    NvU32 i;
+
+    for(i = 0u; i < cache->numEntries; i++) {
+        if(cache->entries[i].source == source) {
+            return cache->entries[i].code;
+        }
+    }
+
+    if(cache->numEntries == ISC_REGSCRIPT_CACHE_SIZE) {
+        LOG_ERR("%s: Too many register scripts\n", __func__);
+        return NULL;
+    }
+
+    entry = &cache->entries[cache->numEntries];
+    if(IscRegScriptCompile(source, cache->regBytes, cache->maxWrite,
+                           &entry->code, NULL) != NVMEDIA_STATUS_OK) {
+        return NULL;
+    }
+    entry->source = source;
+    cache->numEntries++;
+
+    return entry->code;
+}
+
+void
+IscRegScriptCacheRelease(
+    IscRegScriptCache *cache)
+{
+    NvU32 i;
+
+    for(i = 0u; i < cache->numEntries; i++) {
+        free(cache->entries[i].code);
+    }
+    cache->numEntries = 0u;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION.  All rights reserved. All
+ * information contained herein is proprietary and confidential to NVIDIA
+ * Corporation.  Any use, reproduction, or disclosure without the written
+ * permission of NVIDIA Corporation is prohibited.
+ */
+
+#ifndef _ISC_REGSCRIPT_H_
+#define _ISC_REGSCRIPT_H_
+
+#include "nvcommon.h"
+#include "nvmedia.h"
+
+/*
+ * Register scripts in the setting headers are lists of commands:
+ *   'w', n, <n bytes: register address, data>   one I2C write
+ *   'd', hi, lo                                 delay in microseconds
+ *   'e'                                         end
+ * They are compiled once into a bytecode in which writes of consecutive
+ * registers are merged into one burst, relying on the register address
+ * auto-increment:
+ *   ISC_REGSCRIPT_OP_WRITE, n, <n bytes>        one I2C write
+ *   ISC_REGSCRIPT_OP_DELAY, hi, lo              delay in microseconds
+ *   ISC_REGSCRIPT_OP_END
+ */
+#define ISC_REGSCRIPT_OP_END        0x00
+#define ISC_REGSCRIPT_OP_WRITE      0x01
+#define ISC_REGSCRIPT_OP_DELAY      0x02
+
+#define ISC_REGSCRIPT_ADDRESS_BYTES 2
+#define ISC_REGSCRIPT_MAX_WRITE     255
+/* maxWrite that keeps every write as it is, for devices whose address
+ * auto-increment has not been confirmed */
+#define ISC_REGSCRIPT_NO_MERGE      0
+#define ISC_REGSCRIPT_CACHE_SIZE    16
+
+typedef NvMediaStatus (*IscRegScriptWriteFunc)(void *context, NvU32 dataLength,
+                                               const NvU8 *data);
+typedef void (*IscRegScriptDelayFunc)(void *context, NvU32 usec);
+
+typedef struct {
+    const NvU8     *source;
+    NvU8           *code;
+} IscRegScriptCacheEntry;
+
+/* Compiled scripts of one driver handle, keyed by their source array */
+typedef struct {
+    IscRegScriptCacheEntry entries[ISC_REGSCRIPT_CACHE_SIZE];
+    NvU32           numEntries;
+    NvU32           regBytes;   /* register width, writes are merged only
+                                 * when they cover whole registers */
+    NvU32           maxWrite;   /* longest write, address included */
+} IscRegScriptCache;
+
+/* Compiles a 'w'/'d'/'e' script, merging writes into bursts of at most
+ * maxWrite bytes.  *code is allocated and must be freed. */
+NvMediaStatus
+IscRegScriptCompile(
+    const NvU8 *source,
+    NvU32 regBytes,
+    NvU32 maxWrite,
+    NvU8 **code,
+    NvU32 *codeLength);
+
+/* Replays compiled code.  A NULL delay function sleeps. */
+NvMediaStatus
+IscRegScriptRun(
+    const NvU8 *code,
+    IscRegScriptWriteFunc write,
+    IscRegScriptDelayFunc delay,
+    void *context);
+
+void
+IscRegScriptCacheInit(
+    IscRegScriptCache *cache,
+    NvU32 regBytes,
+    NvU32 maxWrite);
+
+/* Returns the compiled code for source, compiling it on first use */
+const NvU8 *
+IscRegScriptCacheGet(
+    IscRegScriptCache *cache,
+    const NvU8 *source);
+
+void
+IscRegScriptCacheRelease(
+    IscRegScriptCache *cache);
+
+#endif /* _ISC_REGSCRIPT_H_ */
@@ -0,0 +1,451 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION.  All rights reserved. All
+ * information contained herein is proprietary and confidential to NVIDIA
+ * Corporation.  Any use, reproduction, or disclosure without the written
+ * permission of NVIDIA Corporation is prohibited.
+ */
+
+/*
+ * Replays every register script of the drivers through the compiler and
+ * through the loop the drivers used before, into a fake I2C device with
+ * an auto-incrementing register map, and compares the results.
+ *
+ * Both replays must leave the same register map, write the same
+ * registers, and reach every delay with the same registers written and
+ * the same total delay.  Scripts compiled with ISC_REGSCRIPT_NO_MERGE
+ * must also issue exactly the same transactions.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nvmedia.h"
+#include "isc_regscript.h"
+#include "test_isc_regscript.h"
+
+#define MAX_DELAYS      256
+#define MAX_SELECTED    32
+#define BENCH_LOOPS     2000
+#define I2C_BUS_HZ      400000
+/* Bits on the bus per byte, and per transaction for start and the
+ * device address */
+#define I2C_BYTE_BITS   9
+#define I2C_START_BITS  10
+
+static int numFailures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if(!(cond)) { \
+            printf("FAIL %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            numFailures++; \
+        } \
+    } while(0)
+
+typedef struct {
+    NvU32           hash;       /* registers written before the delay */
+    NvU32           usec;
+} FakeDelayEvent;
+
+/* A device with 16-bit register addresses that auto-increment per byte */
+typedef struct {
+    NvU8            regs[65536];
+    NvU8            written[65536];
+    NvU32           numWrites;
+    NvU32           numBytes;
+    NvU32           maxWrite;
+    NvU32           transactionHash;
+    FakeDelayEvent  delays[MAX_DELAYS];
+    NvU32           numDelays;
+    NvMediaBool     recordDelays;
+} FakeDevice;
+
+static const struct {
+    const char *driver;
+    const TestRegScript *scripts;
+    NvU32 (*GetSelected)(const NvU8 **scripts, NvU32 maxScripts);
+} drivers[] = {
+    { "ar0231",      testRegScriptsAR0231,     TestRegScriptsSelectedAR0231 },
+    { "ar0231_rccb", testRegScriptsAR0231RCCB, TestRegScriptsSelectedAR0231RCCB },
+    { "ov10635",     testRegScriptsOV10635,    TestRegScriptsSelectedOV10635 },
+    { "ov10640",     testRegScriptsOV10640,    TestRegScriptsSelectedOV10640 },
+};
+
+#define NUM_DRIVERS (sizeof(drivers) / sizeof(drivers[0]))
+
+static FakeDevice legacyDevice, compiledDevice;
+
+static double
+GetTimeSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* FNV-1a */
+static NvU32
+Hash(NvU32 hash, const NvU8 *data, NvU32 length)
+{
+    NvU32 i;
+
+    for(i = 0; i < length; i++)
+        hash = (hash ^ data[i]) * 16777619u;
+
+    return hash;
+}
+
+static void
+ResetDevice(FakeDevice *device, NvMediaBool recordDelays)
+{
+    memset(device, 0, sizeof(FakeDevice));
+    device->transactionHash = 2166136261u;
+    device->recordDelays = recordDelays;
+}
+
+static NvMediaStatus
+FakeWrite(void *context, NvU32 dataLength, const NvU8 *data)
+{
+    FakeDevice *device = context;
+    NvU32 addr, i;
+
+    if(dataLength < ISC_REGSCRIPT_ADDRESS_BYTES)
+        return NVMEDIA_STATUS_BAD_PARAMETER;
+
+    addr = ((NvU32)data[0] << 8) + data[1];
+    for(i = ISC_REGSCRIPT_ADDRESS_BYTES; i < dataLength; i++) {
+        device->regs[addr & 0xffff] = data[i];
+        device->written[addr & 0xffff] = 1;
+        addr++;
+    }
+
+    device->numWrites++;
+    device->numBytes += dataLength;
+    if(dataLength > device->maxWrite)
+        device->maxWrite = dataLength;
+    device->transactionHash = Hash(device->transactionHash, (NvU8 *)&dataLength,
+                                   sizeof(dataLength));
+    device->transactionHash = Hash(device->transactionHash, data, dataLength);
+
+    return NVMEDIA_STATUS_OK;
+}
+
+/* Delays with no write in between are one delay */
+static void
+FakeDelay(void *context, NvU32 usec)
+{
+    FakeDevice *device = context;
+    NvU32 hash;
+
+    if(!device->recordDelays)
+        return;
+
+    hash = Hash(2166136261u, device->regs, sizeof(device->regs));
+    hash = Hash(hash, device->written, sizeof(device->written));
+
+    if(device->numDelays && device->delays[device->numDelays - 1].hash == hash) {
+        device->delays[device->numDelays - 1].usec += usec;
+    } else if(device->numDelays < MAX_DELAYS) {
+        device->delays[device->numDelays].hash = hash;
+        device->delays[device->numDelays].usec = usec;
+        device->numDelays++;
+    }
+}
+
+/* The loop the drivers ran before IscRegScriptRun() */
+static void
+LegacyRun(const NvU8 *arrayData, FakeDevice *device)
+{
+    while(arrayData[0] != 'e') {
+        switch(arrayData[0]) {
+            case 'w':
+                FakeWrite(device, arrayData[1], &arrayData[2]);
+                arrayData += arrayData[1] + 2;
+                break;
+            case 'd':
+                FakeDelay(device, (arrayData[1] << 8) + arrayData[2]);
+                arrayData += 3;
+                break;
+            default:
+                return;
+        }
+    }
+}
+
+static NvU32
+TotalDelay(const FakeDevice *device)
+{
+    NvU32 i, usec = 0;
+
+    for(i = 0; i < device->numDelays; i++)
+        usec += device->delays[i].usec;
+
+    return usec;
+}
+
+/* Bus time of the writes at I2C_BUS_HZ, in milliseconds */
+static double
+BusTimeMs(NvU32 numWrites, NvU32 numBytes)
+{
+    return (numWrites * I2C_START_BITS + numBytes * I2C_BYTE_BITS) * 1e3 /
+           I2C_BUS_HZ;
+}
+
+static void
+CheckScript(const char *driver, const TestRegScript *script,
+            double *legacyMs, double *compiledMs)
+{
+    NvU8 *code = NULL;
+    NvU32 codeLength, i;
+
+    CHECK(IscRegScriptCompile(script->source, script->regBytes,
+                              script->maxWrite, &code, &codeLength) ==
+          NVMEDIA_STATUS_OK, "%s: %s does not compile", driver, script->name);
+    if(!code)
+        return;
+
+    ResetDevice(&legacyDevice, NVMEDIA_TRUE);
+    ResetDevice(&compiledDevice, NVMEDIA_TRUE);
+    LegacyRun(script->source, &legacyDevice);
+    CHECK(IscRegScriptRun(code, FakeWrite, FakeDelay, &compiledDevice) ==
+          NVMEDIA_STATUS_OK, "%s: %s replay failed", driver, script->name);
+
+    CHECK(!memcmp(legacyDevice.regs, compiledDevice.regs,
+                  sizeof(legacyDevice.regs)) &&
+          !memcmp(legacyDevice.written, compiledDevice.written,
+                  sizeof(legacyDevice.written)),
+          "%s: %s leaves a different register map", driver, script->name);
+    CHECK(legacyDevice.numDelays < MAX_DELAYS &&
+          legacyDevice.numDelays == compiledDevice.numDelays,
+          "%s: %s has %u delays, compiled %u", driver, script->name,
+          legacyDevice.numDelays, compiledDevice.numDelays);
+    for(i = 0; i < legacyDevice.numDelays && i < compiledDevice.numDelays; i++) {
+        CHECK(legacyDevice.delays[i].hash == compiledDevice.delays[i].hash &&
+              legacyDevice.delays[i].usec == compiledDevice.delays[i].usec,
+              "%s: %s delay %u differs", driver, script->name, i);
+    }
+
+    if(script->maxWrite == ISC_REGSCRIPT_NO_MERGE) {
+        CHECK(legacyDevice.numWrites == compiledDevice.numWrites &&
+              legacyDevice.transactionHash == compiledDevice.transactionHash,
+              "%s: %s merged writes", driver, script->name);
+    } else {
+        CHECK(compiledDevice.numWrites <= legacyDevice.numWrites &&
+              compiledDevice.maxWrite <= script->maxWrite,
+              "%s: %s: %u writes of up to %u bytes", driver, script->name,
+              compiledDevice.numWrites, compiledDevice.maxWrite);
+    }
+
+    printf("%-12s %-44s writes %4u -> %4u, bus %6.2f -> %6.2f ms, "
+           "delay %u us\n", driver, script->name, legacyDevice.numWrites,
+           compiledDevice.numWrites,
+           BusTimeMs(legacyDevice.numWrites, legacyDevice.numBytes),
+           BusTimeMs(compiledDevice.numWrites, compiledDevice.numBytes),
+           TotalDelay(&compiledDevice));
+    *legacyMs += BusTimeMs(legacyDevice.numWrites, legacyDevice.numBytes);
+    *compiledMs += BusTimeMs(compiledDevice.numWrites, compiledDevice.numBytes);
+
+    free(code);
+}
+
+/* Every script a driver picks from its setting tables is in its list */
+static void
+CheckSelected(NvU32 d)
+{
+    const NvU8 *selected[MAX_SELECTED];
+    const TestRegScript *script;
+    NvU32 i, count;
+
+    count = drivers[d].GetSelected(selected, MAX_SELECTED);
+    CHECK(count <= MAX_SELECTED, "%s selects %u scripts", drivers[d].driver,
+          count);
+    for(i = 0; i < count && i < MAX_SELECTED; i++) {
+        for(script = drivers[d].scripts; script->name; script++) {
+            if(script->source == selected[i])
+                break;
+        }
+        CHECK(script->name != NULL, "%s: selected script %u is not tested",
+              drivers[d].driver, i);
+    }
+}
+
+static void
+TestDriverScripts(void)
+{
+    const TestRegScript *script;
+    double legacyMs = 0, compiledMs = 0;
+    NvU32 d, numScripts = 0;
+
+    for(d = 0; d < NUM_DRIVERS; d++) {
+        CheckSelected(d);
+        for(script = drivers[d].scripts; script->name; script++) {
+            CheckScript(drivers[d].driver, script, &legacyMs, &compiledMs);
+            numScripts++;
+        }
+    }
+
+    printf("%u scripts, bus time at %u kHz %.1f -> %.1f ms\n", numScripts,
+           I2C_BUS_HZ / 1000, legacyMs, compiledMs);
+}
+
+static NvU32
+CountWrites(const NvU8 *source, NvU32 regBytes, NvU32 maxWrite)
+{
+    NvU8 *code;
+
+    if(IscRegScriptCompile(source, regBytes, maxWrite, &code, NULL) !=
+       NVMEDIA_STATUS_OK)
+        return 0;
+    ResetDevice(&compiledDevice, NVMEDIA_TRUE);
+    IscRegScriptRun(code, FakeWrite, FakeDelay, &compiledDevice);
+    free(code);
+
+    return compiledDevice.numWrites;
+}
+
+static void
+TestCompiler(void)
+{
+    static const NvU8 shortWrite[] = { 'w', 1, 0x30, 'e' };
+    static const NvU8 badCommand[] = { 'w', 3, 0x30, 0x00, 0x01, 'x', 'e' };
+    static const NvU8 empty[] = { 'e' };
+    static const NvU8 delays[] = {
+        'd', 0xff, 0xff, 'd', 0x00, 0x01, 'd', 0x00, 0x02, 'e'
+    };
+    /* 0x3000-0x3009 in writes of 2, 2, 1, 1, 2 and 2 bytes */
+    static const NvU8 run[] = {
+        'w', 4, 0x30, 0x00, 1, 2,
+        'w', 4, 0x30, 0x02, 3, 4,
+        'w', 3, 0x30, 0x04, 5,
+        'w', 3, 0x30, 0x05, 6,
+        'w', 4, 0x30, 0x06, 7, 8,
+        'w', 4, 0x30, 0x08, 9, 10,
+        'e'
+    };
+    /* A delay between consecutive registers keeps them apart */
+    static const NvU8 split[] = {
+        'w', 3, 0x30, 0x00, 1, 'd', 0x00, 0x0a, 'w', 3, 0x30, 0x01, 2, 'e'
+    };
+    IscRegScriptCache cache;
+    const NvU8 *code;
+    NvU8 *compiled;
+    NvU32 length;
+
+    CHECK(IscRegScriptCompile(shortWrite, 2, ISC_REGSCRIPT_MAX_WRITE, &compiled,
+                              &length) == NVMEDIA_STATUS_BAD_PARAMETER,
+          "write without a register address");
+    CHECK(IscRegScriptCompile(badCommand, 2, ISC_REGSCRIPT_MAX_WRITE, &compiled,
+                              &length) == NVMEDIA_STATUS_BAD_PARAMETER,
+          "unknown command");
+    CHECK(IscRegScriptCompile(run, 0, ISC_REGSCRIPT_MAX_WRITE, &compiled,
+                              &length) == NVMEDIA_STATUS_BAD_PARAMETER,
+          "no register width");
+    CHECK(IscRegScriptCompile(run, 1, ISC_REGSCRIPT_MAX_WRITE + 1, &compiled,
+                              &length) == NVMEDIA_STATUS_BAD_PARAMETER,
+          "write limit above ISC_REGSCRIPT_MAX_WRITE");
+
+    if(IscRegScriptCompile(empty, 1, ISC_REGSCRIPT_MAX_WRITE, &compiled,
+                           &length) == NVMEDIA_STATUS_OK) {
+        CHECK(length == 1 && compiled[0] == ISC_REGSCRIPT_OP_END,
+              "empty script is %u bytes", length);
+        free(compiled);
+    } else {
+        CHECK(0, "empty script");
+    }
+
+    /* Adjacent delays are summed while they fit */
+    if(IscRegScriptCompile(delays, 1, ISC_REGSCRIPT_MAX_WRITE, &compiled,
+                           &length) == NVMEDIA_STATUS_OK) {
+        ResetDevice(&compiledDevice, NVMEDIA_TRUE);
+        IscRegScriptRun(compiled, FakeWrite, FakeDelay, &compiledDevice);
+        CHECK(length == 7 && TotalDelay(&compiledDevice) == 0xffff + 3,
+              "delays compiled to %u bytes, %u us", length,
+              TotalDelay(&compiledDevice));
+        free(compiled);
+    } else {
+        CHECK(0, "delays");
+    }
+
+    CHECK(CountWrites(run, 1, ISC_REGSCRIPT_MAX_WRITE) == 1,
+          "byte registers not merged");
+    CHECK(CountWrites(run, 1, 6) == 3, "write limit of 6 bytes");
+    /* The 1-byte writes of 16-bit registers stay apart, and the write
+     * after them starts a new burst */
+    CHECK(CountWrites(run, 2, ISC_REGSCRIPT_MAX_WRITE) == 4,
+          "partial 16-bit registers merged");
+    CHECK(CountWrites(run, 1, ISC_REGSCRIPT_NO_MERGE) == 6, "merged with "
+          "ISC_REGSCRIPT_NO_MERGE");
+    CHECK(CountWrites(split, 1, ISC_REGSCRIPT_MAX_WRITE) == 2,
+          "merged across a delay");
+
+    /* Each source is compiled once */
+    IscRegScriptCacheInit(&cache, 1, ISC_REGSCRIPT_MAX_WRITE);
+    code = IscRegScriptCacheGet(&cache, run);
+    CHECK(code && code == IscRegScriptCacheGet(&cache, run) &&
+          cache.numEntries == 1, "cached script compiled again");
+    CHECK(IscRegScriptCacheGet(&cache, badCommand) == NULL &&
+          cache.numEntries == 1, "malformed script cached");
+    IscRegScriptCacheRelease(&cache);
+    CHECK(cache.numEntries == 0, "cache not released");
+}
+
+static void
+BenchmarkReplay(void)
+{
+    const TestRegScript *script;
+    double start, legacy, compiled, compile;
+    NvU8 *code;
+    NvU32 d, i;
+
+    for(d = 0; d < NUM_DRIVERS; d++) {
+        script = drivers[d].scripts;
+        if(IscRegScriptCompile(script->source, script->regBytes,
+                               script->maxWrite, &code, NULL) !=
+           NVMEDIA_STATUS_OK)
+            continue;
+
+        ResetDevice(&legacyDevice, NVMEDIA_FALSE);
+        ResetDevice(&compiledDevice, NVMEDIA_FALSE);
+
+        start = GetTimeSec();
+        for(i = 0; i < BENCH_LOOPS; i++)
+            LegacyRun(script->source, &legacyDevice);
+        legacy = GetTimeSec() - start;
+
+        start = GetTimeSec();
+        for(i = 0; i < BENCH_LOOPS; i++)
+            IscRegScriptRun(code, FakeWrite, FakeDelay, &compiledDevice);
+        compiled = GetTimeSec() - start;
+        free(code);
+
+        start = GetTimeSec();
+        for(i = 0; i < BENCH_LOOPS; i++) {
+            if(IscRegScriptCompile(script->source, script->regBytes,
+                                   script->maxWrite, &code, NULL) ==
+               NVMEDIA_STATUS_OK)
+                free(code);
+        }
+        compile = GetTimeSec() - start;
+
+        printf("%-12s %-36s replay: legacy %7.2f us, compiled %7.2f us; "
+               "compile %6.2f us\n", drivers[d].driver, script->name,
+               legacy * 1e6 / BENCH_LOOPS, compiled * 1e6 / BENCH_LOOPS,
+               compile * 1e6 / BENCH_LOOPS);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    TestCompiler();
+    TestDriverScripts();
+    if(argc < 2 || strcmp(argv[1], "--no-bench"))
+        BenchmarkReplay();
+
+    printf("%s\n", numFailures ? "FAILED" : "PASSED");
+    return numFailures ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION.  All rights reserved. All
+ * information contained herein is proprietary and confidential to NVIDIA
+ * Corporation.  Any use, reproduction, or disclosure without the written
+ * permission of NVIDIA Corporation is prohibited.
+ */
+
+#ifndef _TEST_ISC_REGSCRIPT_H_
+#define _TEST_ISC_REGSCRIPT_H_
+
+#include "nvcommon.h"
+
+/* A 'w'/'d'/'e' script of a driver, with the regBytes and maxWrite its
+ * IscRegScriptCacheInit() call uses */
+typedef struct {
+    const char     *name;
+    const NvU8     *source;
+    NvU32           regBytes;
+    NvU32           maxWrite;
+} TestRegScript;
+
+/* Each table ends with a NULL name.  The setting headers of the drivers
+ * cannot share a translation unit, so test_isc_regscript_scripts.c is
+ * built once per driver. */
+extern const TestRegScript testRegScriptsAR0231[];
+extern const TestRegScript testRegScriptsAR0231RCCB[];
+extern const TestRegScript testRegScriptsOV10635[];
+extern const TestRegScript testRegScriptsOV10640[];
+
+/* Store up to maxScripts of the scripts the driver picks from its
+ * setting tables, NULL entries left out, and return how many there are */
+NvU32 TestRegScriptsSelectedAR0231(const NvU8 **scripts, NvU32 maxScripts);
+NvU32 TestRegScriptsSelectedAR0231RCCB(const NvU8 **scripts, NvU32 maxScripts);
+NvU32 TestRegScriptsSelectedOV10635(const NvU8 **scripts, NvU32 maxScripts);
+NvU32 TestRegScriptsSelectedOV10640(const NvU8 **scripts, NvU32 maxScripts);
+
+#endif /* _TEST_ISC_REGSCRIPT_H_ */
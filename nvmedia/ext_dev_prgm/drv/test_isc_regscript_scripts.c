@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION.  All rights reserved. All
+ * information contained herein is proprietary and confidential to NVIDIA
+ * Corporation.  Any use, reproduction, or disclosure without the written
+ * permission of NVIDIA Corporation is prohibited.
+ */
+
+/*
+ * Register scripts of one driver for test_isc_regscript, selected with
+ * -DTEST_REGSCRIPT_<DRIVER>.  Only the arrays the driver replays with
+ * WriteArrayWithCommand() are listed; the scripts the driver picks from
+ * its setting tables are returned too, so that the test can check that
+ * none is missing from the list.
+ */
+#include <stddef.h>
+
+#include "nvmedia_isc.h"
+#include "isc_regscript.h"
+#include "test_isc_regscript.h"
+
+#define SCRIPT(name, regBytes, maxWrite) { #name, name, regBytes, maxWrite }
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+static NvU32
+AddSelected(const NvU8 **scripts, NvU32 maxScripts, NvU32 count,
+            const NvU8 *script)
+{
+    if(!script)
+        return count;
+    if(count < maxScripts)
+        scripts[count] = script;
+
+    return count + 1;
+}
+
+#if defined(TEST_REGSCRIPT_AR0231)
+
+#include "isc_ar0231.h"
+#include "isc_ar0231_setting.h"
+
+const TestRegScript testRegScriptsAR0231[] = {
+    SCRIPT(ar0231_raw12_default, 2, ISC_REGSCRIPT_MAX_WRITE),
+    SCRIPT(ar0231_raw12_default_v3, 2, ISC_REGSCRIPT_MAX_WRITE),
+    SCRIPT(ar0231_raw12_default_v4, 2, ISC_REGSCRIPT_MAX_WRITE),
+    SCRIPT(ar0231_raw12_comp_1920x1008_36fps, 2, ISC_REGSCRIPT_MAX_WRITE),
+    SCRIPT(ar0231_raw12_comp_1920x1208_30fps, 2, ISC_REGSCRIPT_MAX_WRITE),
+    SCRIPT(ar0231_raw12_comp_1920x1008_36fps_extsync, 2, ISC_REGSCRIPT_MAX_WRITE),
+    SCRIPT(ar0231_raw12_comp_1920x1208_30fps_extsync, 2, ISC_REGSCRIPT_MAX_WRITE),
+    { NULL, NULL, 0, 0 }
+};
+
+NvU32
+TestRegScriptsSelectedAR0231(const NvU8 **scripts, NvU32 maxScripts)
+{
+    const TimingSettingAR0231 *timing = &ar0231_timing[0][0];
+    NvU32 i, count = 0;
+
+    for(i = 0; i < sizeof(ar0231_timing) / sizeof(TimingSettingAR0231); i++)
+        count = AddSelected(scripts, maxScripts, count, timing[i].settings);
+
+    return count;
+}
+
+#elif defined(TEST_REGSCRIPT_AR0231_RCCB)
+
+#include "isc_ar0231_rccb.h"
+#include "isc_ar0231_rccb_setting.h"
+
+const TestRegScript testRegScriptsAR0231RCCB[] = {
+    SCRIPT(ar0231_raw12_default_v7, 2, ISC_REGSCRIPT_MAX_WRITE),
+    SCRIPT(ar0231_raw12_default_v6, 2, ISC_REGSCRIPT_MAX_WRITE),
+    SCRIPT(ar0231_raw12_default_v4, 2, ISC_REGSCRIPT_MAX_WRITE),
+    SCRIPT(ar0231_raw12_comp_1920x1008_36fps, 2, ISC_REGSCRIPT_MAX_WRITE),
+    SCRIPT(ar0231_raw12_comp_1920x1208_30fps, 2, ISC_REGSCRIPT_MAX_WRITE),
+    SCRIPT(ar0231_raw12_comp_1920x1208_20fps, 2, ISC_REGSCRIPT_MAX_WRITE),
+    SCRIPT(ar0231_raw12_comp_1920x1008_36fps_extsync, 2, ISC_REGSCRIPT_MAX_WRITE),
+    SCRIPT(ar0231_raw12_comp_1920x1208_30fps_extsync, 2, ISC_REGSCRIPT_MAX_WRITE),
+    SCRIPT(ar0231_raw12_comp_1920x1208_20fps_extsync, 2, ISC_REGSCRIPT_MAX_WRITE),
+    { NULL, NULL, 0, 0 }
+};
+
+NvU32
+TestRegScriptsSelectedAR0231RCCB(const NvU8 **scripts, NvU32 maxScripts)
+{
+    const TimingSettingAR0231 *timing = &ar0231_timing[0][0];
+    NvU32 i, count = 0;
+
+    for(i = 0; i < sizeof(ar0231_timing) / sizeof(TimingSettingAR0231); i++)
+        count = AddSelected(scripts, maxScripts, count, timing[i].settings);
+
+    return count;
+}
+
+#elif defined(TEST_REGSCRIPT_OV10635)
+
+#include "isc_ov10635.h"
+#include "isc_ov10635_setting.h"
+
+const TestRegScript testRegScriptsOV10635[] = {
+    SCRIPT(ov10635_422p8_1280x800, 1, ISC_REGSCRIPT_NO_MERGE),
+    { NULL, NULL, 0, 0 }
+};
+
+NvU32
+TestRegScriptsSelectedOV10635(const NvU8 **scripts, NvU32 maxScripts)
+{
+    NvU32 i, count = 0;
+
+    for(i = 0; i < ARRAY_SIZE(ov10635_sensor_settings); i++)
+        count = AddSelected(scripts, maxScripts, count, ov10635_sensor_settings[i]);
+
+    return count;
+}
+
+#elif defined(TEST_REGSCRIPT_OV10640)
+
+#include "isc_ov10640.h"
+#include "isc_ov10640_setting.h"
+
+const TestRegScript testRegScriptsOV10640[] = {
+    SCRIPT(ov10640_default, 1, ISC_REGSCRIPT_NO_MERGE),
+    SCRIPT(ov10640_raw12_comp_1280x800_emb, 1, ISC_REGSCRIPT_NO_MERGE),
+    SCRIPT(ov10640_raw12_comp_1280x1080_emb, 1, ISC_REGSCRIPT_NO_MERGE),
+    SCRIPT(ov10640_raw12_1280x800_osc24_pll_setting, 1, ISC_REGSCRIPT_NO_MERGE),
+    SCRIPT(ov10640_raw12_1280x800_osc25_pll_setting, 1, ISC_REGSCRIPT_NO_MERGE),
+    SCRIPT(ov10640_raw12_1280x1080_osc24_pll_setting, 1, ISC_REGSCRIPT_NO_MERGE),
+    SCRIPT(ov10640_raw12_1280x1080_osc25_pll_setting, 1, ISC_REGSCRIPT_NO_MERGE),
+    { NULL, NULL, 0, 0 }
+};
+
+NvU32
+TestRegScriptsSelectedOV10640(const NvU8 **scripts, NvU32 maxScripts)
+{
+    NvU32 i, j, count = 0;
+
+    count = AddSelected(scripts, maxScripts, count, ov10640_default);
+    for(i = 0; i < ARRAY_SIZE(ov10640_settings); i++) {
+        count = AddSelected(scripts, maxScripts, count, ov10640_settings[i]);
+        for(j = 0; j < ARRAY_SIZE(ov10640_pll_settings); j++)
+            count = AddSelected(scripts, maxScripts, count,
+                                ov10640_pll_settings[j][i]);
+    }
+
+    return count;
+}
+
+#else
+#error "Define the driver whose scripts to build, e.g. -DTEST_REGSCRIPT_AR0231"
+#endif
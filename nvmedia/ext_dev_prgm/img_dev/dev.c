@@ -5,6 +5,7 @@
  * permission of NVIDIA Corporation is prohibited.
  */
 #include "stdio.h"
+#include "string.h"
 #include "dev_priv.h"
 #include "dev_list.h"
 #include "log_utils.h"
@@ -13,6 +14,7 @@ ExtImgDevice *
 ExtImgDevInit(ExtImgDevParam *configParam)
 {
     ImgDevDriver *imgDev = NULL;
+    ExtImgDevice *device = NULL;
 
     if(!configParam)
         return NULL;
@@ -24,7 +26,11 @@ ExtImgDevInit(ExtImgDevParam *configParam)
     if(!imgDev->Init)
         return NULL;
 
-    return imgDev->Init(configParam);
+    device = imgDev->Init(configParam);
+    if(device)
+        device->i2cDevice = configParam->i2cDevice;
+
+    return device;
 }
 
 void
@@ -55,12 +61,73 @@ ExtImgDevStart(ExtImgDevice *device)
     if(!imgDev)
         return NVMEDIA_STATUS_BAD_PARAMETER;
 
+    if(imgDev->ScheduleStart)
+        return ExtImgDevStartMultiple(&device, 1);
+
     if(imgDev->Start)
         return imgDev->Start(device);
 
     return NVMEDIA_STATUS_OK;
 }
 
+static NvMediaStatus
+StartTask(void *context, NvU32 index)
+{
+    ExtImgDevice *device = context;
+
+    return ((ImgDevDriver *)device->driver)->Start(device);
+}
+
+NvMediaStatus
+ExtImgDevStartMultiple(
+    ExtImgDevice **devices,
+    NvU32 numDevices)
+{
+    ImgDevDriver *imgDev = NULL;
+    ImgBringup *bringup = NULL;
+    ImgBringupTask task;
+    NvMediaStatus status = NVMEDIA_STATUS_OK;
+    NvU32 i;
+
+    if(!devices)
+        return NVMEDIA_STATUS_BAD_PARAMETER;
+
+    bringup = ImgBringupCreate(0);
+    if(!bringup)
+        return NVMEDIA_STATUS_OUT_OF_MEMORY;
+
+    for(i = 0; i < numDevices; i++) {
+        if(!devices[i] || !devices[i]->driver) {
+            status = NVMEDIA_STATUS_BAD_PARAMETER;
+            goto done;
+        }
+
+        imgDev = (ImgDevDriver *)devices[i]->driver;
+        if(imgDev->ScheduleStart) {
+            status = imgDev->ScheduleStart(devices[i], bringup, 0, NULL);
+        } else if(imgDev->Start) {
+            // Drivers without a schedule keep their bus for the whole start
+            memset(&task, 0, sizeof(task));
+            task.name = imgDev->name;
+            task.func = StartTask;
+            task.context = devices[i];
+            task.bus = devices[i]->i2cDevice;
+            status = ImgBringupAddTask(bringup, &task, 0, NULL, NULL);
+        }
+        if(status != NVMEDIA_STATUS_OK) {
+            LOG_ERR("%s: Failed to schedule start of %s\n", __func__, imgDev->name);
+            goto done;
+        }
+    }
+
+    status = ImgBringupRun(bringup);
+
+done:
+    ImgBringupDestroy(bringup);
+
+    return status;
+}
+
 void
 ExtImgDevStop(ExtImgDevice *device)
 {
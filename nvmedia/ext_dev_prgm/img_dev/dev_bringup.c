@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION.  All rights reserved. All
+ * information contained herein is proprietary and confidential to NVIDIA
+ * Corporation.  Any use, reproduction, or disclosure without the written
+ * permission of NVIDIA Corporation is prohibited.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "log_utils.h"
+#include "dev_bringup.h"
+
+typedef enum {
+    TASK_WAITING,
+    TASK_RUNNING,
+    TASK_DONE,
+} TaskState;
+
+typedef struct {
+    ImgBringupTask  task;
+    NvU32           deps[IMG_BRINGUP_MAX_DEPS];
+    NvU32           numDeps;
+    NvU32           pending;  /* dependencies not done yet */
+    NvU32           busSlot;  /* index into busy[], or IMG_BRINGUP_NO_BUS */
+    TaskState       state;
+} BringupTask;
+
+struct ImgBringup {
+    BringupTask     tasks[IMG_BRINGUP_MAX_TASKS];
+    NvU32           numTasks;
+    NvU32           buses[IMG_BRINGUP_MAX_BUSES];
+    NvMediaBool     busy[IMG_BRINGUP_MAX_BUSES];
+    NvU32           numBuses;
+    NvU32           numThreads;
+    NvU32           numDone;
+    NvMediaStatus   status;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+};
+
+static NvMediaStatus
+GetBusSlot(ImgBringup *bringup, NvU32 bus, NvU32 *slot)
+{
+    NvU32 i;
+
+    if(bus == IMG_BRINGUP_NO_BUS) {
+        *slot = IMG_BRINGUP_NO_BUS;
+        return NVMEDIA_STATUS_OK;
+    }
+
+    for(i = 0; i < bringup->numBuses; i++) {
+        if(bringup->buses[i] == bus) {
+            *slot = i;
+            return NVMEDIA_STATUS_OK;
+        }
+    }
+
+    if(bringup->numBuses == IMG_BRINGUP_MAX_BUSES) {
+        LOG_ERR("%s: Too many buses\n", __func__);
+        return NVMEDIA_STATUS_OUT_OF_MEMORY;
+    }
+
+    bringup->buses[bringup->numBuses] = bus;
+    *slot = bringup->numBuses++;
+    return NVMEDIA_STATUS_OK;
+}
+
+/* Lowest id first keeps each chain in the order it was described */
+static BringupTask *
+PickTask(ImgBringup *bringup)
+{
+    BringupTask *t;
+    NvU32 i;
+
+    for(i = 0; i < bringup->numTasks; i++) {
+        t = &bringup->tasks[i];
+        if(t->state != TASK_WAITING || t->pending)
+            continue;
+        if(t->busSlot != IMG_BRINGUP_NO_BUS && bringup->busy[t->busSlot])
+            continue;
+        return t;
+    }
+
+    return NULL;
+}
+
+static void
+CompleteTask(ImgBringup *bringup, BringupTask *done, NvMediaStatus status)
+{
+    NvU32 id = done - bringup->tasks;
+    NvU32 i, j;
+
+    done->state = TASK_DONE;
+    bringup->numDone++;
+
+    if(status != NVMEDIA_STATUS_OK) {
+        LOG_ERR("%s: %s failed\n", __func__, done->task.name);
+        if(bringup->status == NVMEDIA_STATUS_OK)
+            bringup->status = status;
+    }
+
+    /* Only later tasks can depend on this one */
+    for(i = id + 1; i < bringup->numTasks; i++) {
+        for(j = 0; j < bringup->tasks[i].numDeps; j++) {
+            if(bringup->tasks[i].deps[j] == id)
+                bringup->tasks[i].pending--;
+        }
+    }
+
+    pthread_cond_broadcast(&bringup->cond);
+}
+
+static void *
+WorkerThread(void *arg)
+{
+    ImgBringup *bringup = arg;
+    NvMediaStatus status;
+    BringupTask *t;
+
+    pthread_mutex_lock(&bringup->lock);
+
+    while(bringup->status == NVMEDIA_STATUS_OK &&
+          bringup->numDone < bringup->numTasks) {
+        t = PickTask(bringup);
+        if(!t) {
+            pthread_cond_wait(&bringup->cond, &bringup->lock);
+            continue;
+        }
+
+        t->state = TASK_RUNNING;
+        if(t->busSlot != IMG_BRINGUP_NO_BUS)
+            bringup->busy[t->busSlot] = NVMEDIA_TRUE;
+        pthread_mutex_unlock(&bringup->lock);
+
+        LOG_DBG("%s: %s\n", __func__, t->task.name);
+        status = t->task.func ?
+                 t->task.func(t->task.context, t->task.index) :
+                 NVMEDIA_STATUS_OK;
+
+        if(t->busSlot != IMG_BRINGUP_NO_BUS) {
+            pthread_mutex_lock(&bringup->lock);
+            bringup->busy[t->busSlot] = NVMEDIA_FALSE;
+            pthread_cond_broadcast(&bringup->cond);
+            pthread_mutex_unlock(&bringup->lock);
+        }
+
+        if(status == NVMEDIA_STATUS_OK && t->task.settleUs)
+            usleep(t->task.settleUs);
+
+        pthread_mutex_lock(&bringup->lock);
+        CompleteTask(bringup, t, status);
+    }
+
+    /* Wake the other workers so they see the failure or the end */
+    pthread_cond_broadcast(&bringup->cond);
+    pthread_mutex_unlock(&bringup->lock);
+
+    return NULL;
+}
+
+ImgBringup *
+ImgBringupCreate(NvU32 numThreads)
+{
+    ImgBringup *bringup;
+
+    if(numThreads > IMG_BRINGUP_MAX_THREADS)
+        return NULL;
+
+    bringup = calloc(1, sizeof(ImgBringup));
+    if(!bringup) {
+        LOG_ERR("%s: out of memory\n", __func__);
+        return NULL;
+    }
+
+    bringup->numThreads = numThreads ? numThreads : IMG_BRINGUP_DEFAULT_THREADS;
+    pthread_mutex_init(&bringup->lock, NULL);
+    pthread_cond_init(&bringup->cond, NULL);
+
+    return bringup;
+}
+
+void
+ImgBringupDestroy(ImgBringup *bringup)
+{
+    if(!bringup)
+        return;
+
+    pthread_cond_destroy(&bringup->cond);
+    pthread_mutex_destroy(&bringup->lock);
+    free(bringup);
+}
+
+NvMediaStatus
+ImgBringupAddTask(
+    ImgBringup *bringup,
+    const ImgBringupTask *task,
+    NvU32 numDeps,
+    const NvU32 *deps,
+    NvU32 *taskId)
+{
+    BringupTask *t;
+    NvMediaStatus status;
+    NvU32 i;
+
+    if(!bringup || !task || (numDeps && !deps))
+        return NVMEDIA_STATUS_BAD_PARAMETER;
+
+    if(numDeps > IMG_BRINGUP_MAX_DEPS)
+        return NVMEDIA_STATUS_BAD_PARAMETER;
+
+    for(i = 0; i < numDeps; i++) {
+        if(deps[i] >= bringup->numTasks)
+            return NVMEDIA_STATUS_BAD_PARAMETER;
+    }
+
+    if(bringup->numTasks == IMG_BRINGUP_MAX_TASKS) {
+        LOG_ERR("%s: Too many tasks\n", __func__);
+        return NVMEDIA_STATUS_OUT_OF_MEMORY;
+    }
+
+    t = &bringup->tasks[bringup->numTasks];
+    memset(t, 0, sizeof(BringupTask));
+
+    status = GetBusSlot(bringup, task->bus, &t->busSlot);
+    if(status != NVMEDIA_STATUS_OK)
+        return status;
+
+    t->task = *task;
+    if(!t->task.name)
+        t->task.name = "";
+    if(numDeps)
+        memcpy(t->deps, deps, numDeps * sizeof(NvU32));
+    t->numDeps = numDeps;
+
+    if(taskId)
+        *taskId = bringup->numTasks;
+    bringup->numTasks++;
+
+    return NVMEDIA_STATUS_OK;
+}
+
+NvMediaStatus
+ImgBringupRun(ImgBringup *bringup)
+{
+    pthread_t threads[IMG_BRINGUP_MAX_THREADS];
+    NvU32 numThreads = 0;
+    NvU32 i;
+
+    if(!bringup)
+        return NVMEDIA_STATUS_BAD_PARAMETER;
+
+    for(i = 0; i < bringup->numTasks; i++) {
+        bringup->tasks[i].state = TASK_WAITING;
+        bringup->tasks[i].pending = bringup->tasks[i].numDeps;
+    }
+    memset(bringup->busy, 0, sizeof(bringup->busy));
+    bringup->numDone = 0;
+    bringup->status = NVMEDIA_STATUS_OK;
+
+    /* No more threads than tasks */
+    while(numThreads < bringup->numThreads && numThreads < bringup->numTasks) {
+        if(pthread_create(&threads[numThreads], NULL, WorkerThread, bringup))
+            break;
+        numThreads++;
+    }
+
+    if(bringup->numTasks && !numThreads) {
+        LOG_ERR("%s: Failed to create worker threads\n", __func__);
+        return NVMEDIA_STATUS_ERROR;
+    }
+
+    for(i = 0; i < numThreads; i++)
+        pthread_join(threads[i], NULL);
+
+    return bringup->status;
+}
@@ -0,0 +1,57 @@
+/* Copyright (c) 2017, NVIDIA CORPORATION.  All rights reserved. All
+ * information contained herein is proprietary and confidential to NVIDIA
+ * Corporation.  Any use, reproduction, or disclosure without the written
+ * permission of NVIDIA Corporation is prohibited.
+ */
+#ifndef _DEV_BRINGUP_H_
+#define _DEV_BRINGUP_H_
+
+#include "nvcommon.h"
+#include "nvmedia.h"
+
+/*
+ * Bring-up scheduler: a start sequence is a graph of steps.  Each step
+ * runs once all its dependencies are done, on a small thread pool.
+ * Steps that name the same I2C bus never run at the same time, while
+ * steps on different buses and settle delays overlap freely.
+ */
+
+#define IMG_BRINGUP_MAX_TASKS       64
+#define IMG_BRINGUP_MAX_DEPS        8
+#define IMG_BRINGUP_MAX_BUSES       8
+#define IMG_BRINGUP_MAX_THREADS     8
+#define IMG_BRINGUP_DEFAULT_THREADS 4
+
+/* Bus value of a step that does not touch I2C */
+#define IMG_BRINGUP_NO_BUS          0xFFFFFFFF
+
+typedef NvMediaStatus (*ImgBringupFunc)(void *context, NvU32 index);
+
+typedef struct {
+    const char     *name;
+    ImgBringupFunc  func;      /* NULL for a pure delay */
+    void           *context;
+    NvU32           index;     /* passed to func, e.g. the link number */
+    NvU32           bus;       /* held while func runs */
+    NvU32           settleUs;  /* waited after func with the bus released */
+} ImgBringupTask;
+
+typedef struct ImgBringup ImgBringup;
+
+/* numThreads 0 selects IMG_BRINGUP_DEFAULT_THREADS */
+ImgBringup *ImgBringupCreate(NvU32 numThreads);
+
+void ImgBringupDestroy(ImgBringup *bringup);
+
+/* Adds a step that runs after the numDeps steps in deps; deps must have
+ * been added before, so the graph cannot have a cycle.  The new step's
+ * id is stored in taskId when it is not NULL. */
+NvMediaStatus ImgBringupAddTask(ImgBringup *bringup, const ImgBringupTask *task,
+                                NvU32 numDeps, const NvU32 *deps,
+                                NvU32 *taskId);
+
+/* Runs all steps and returns the first failure.  Once a step fails no
+ * further steps are started. */
+NvMediaStatus ImgBringupRun(ImgBringup *bringup);
+
+#endif /* _DEV_BRINGUP_H_ */
@@ -5,6 +5,8 @@
  * permission of NVIDIA Corporation is prohibited.
  */
 #include <string.h>
+#include <dlfcn.h>
+#include <pthread.h>
 #include "log_utils.h"
 #include "dev_list.h"
 #include "ref_max9286_9271_ov10635.h"
@@ -19,39 +21,278 @@
 #include "ref_max9286_96705_ov2718_xc7027.h"
 #include "tpg.h"
 
+#define IF_9286_9271    (IMG_DEV_IF_MAX9286 | IMG_DEV_IF_MAX9271)
+#define IF_9286_96705   (IMG_DEV_IF_MAX9286 | IMG_DEV_IF_MAX96705)
+#define IF_9288_96705   (IMG_DEV_IF_MAX9288 | IMG_DEV_IF_MAX96705)
+
+static const struct {
+    ImgDevDriver *(*GetDriver)(void);
+    NvU32 interfaces;
+} builtinDevices[MAX_IMG_DEV_SUPPORTED] = {
+    [REF_MAX9286_9271_OV10635] =
+        { GetDriver_ref_max9286_9271_ov10635, IF_9286_9271 },
+    [REF_MAX9286_9271_OV10640] =
+        { GetDriver_ref_max9286_9271_ov10640, IF_9286_9271 },
+    [C_MAX9286_9271_OV10640LSOFF] =
+        { GetDriver_c_max9286_9271_ov10640lsoff, IF_9286_9271 },
+    [C_MAX9286_9271_OV10640] =
+        { GetDriver_c_max9286_9271_ov10640, IF_9286_9271 },
+    [D_MAX9286_9271_MT9V024] =
+        { GetDriver_d_max9286_9271_mt9v024, IF_9286_9271 },
+    [REF_MAX9286_96705_AR0231RCCB] =
+        { GetDriver_ref_max9286_96705_ar0231rccb, IF_9286_96705 },
+    [REF_MAX9286_96705_AR0231] =
+        { GetDriver_ref_max9286_96705_ar0231, IF_9286_96705 },
+    [REF_MAX9288_96705_OV10635] =
+        { GetDriver_ref_max9288_96705_ov10635, IF_9288_96705 },
+    [M_MAX9288_96705_AR0140] =
+        { GetDriver_m_max9288_96705_ar0140, IF_9288_96705 },
+    [TPG] =
+        { GetDriver_tpg, IMG_DEV_IF_TPG },
+    [REF_MAX9286_96705_OV2718_XC7027] =
+        { GetDriver_ref_max9286_96705_ov2718_xc7027, IF_9286_96705 },
+};
+
+typedef struct {
+    ImgDevDriverInfo    info;
+    size_t              nameLen;
+} ImgDevEntry;
+
+/* Drivers are kept in registration order.  sorted[] orders them by name
+ * for binary search, and parent[] links each sorted position to the
+ * longest other name that is a prefix of its name, so that the longest
+ * prefix of a module name is found without scanning the table. */
+static struct {
+    ImgDevEntry     entries[MAX_IMG_DEV_REGISTERED];
+    NvU32           numEntries;
+    NvU32           sorted[MAX_IMG_DEV_REGISTERED];
+    NvS32           parent[MAX_IMG_DEV_REGISTERED];
+    NvU64           byInterface[IMG_DEV_IF_BITS]; /* entry bitmaps */
+} devList;
+
+static pthread_rwlock_t devListLock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_once_t devListOnce = PTHREAD_ONCE_INIT;
+
+#define SORTED_ENTRY(pos) (&devList.entries[devList.sorted[pos]])
+
+/* Returns the last sorted position whose name is not after name, or -1 */
+static NvS32
+FindPredecessor(const char *name)
+{
+    NvS32 low = 0, high = (NvS32)devList.numEntries - 1;
+
+    while(low <= high) {
+        NvS32 mid = (low + high) / 2;
+
+        if(strcmp(SORTED_ENTRY(mid)->info.driver->name, name) <= 0)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+
+    return high;
+}
+
+/* Starting from the predecessor of name, returns the sorted position of
+ * the longest name that is a prefix of name, or -1.  Every name between
+ * that prefix and name starts with the prefix, so it is on the parent
+ * chain of the predecessor. */
+static NvS32
+MatchPrefix(const char *name, NvS32 pos)
+{
+    while(pos >= 0) {
+        const ImgDevEntry *entry = SORTED_ENTRY(pos);
+        const char *devName = entry->info.driver->name;
+        size_t common = 0;
+
+        while(common < entry->nameLen && name[common] == devName[common])
+            common++;
+        if(common == entry->nameLen)
+            return pos;
+
+        /* Only a parent no longer than the common part can match */
+        do {
+            pos = devList.parent[pos];
+        } while(pos >= 0 && SORTED_ENTRY(pos)->nameLen > common);
+    }
+
+    return -1;
+}
+
+static NvMediaStatus
+AddDevice(ImgDevDriver *driver, NvU32 interfaces)
+{
+    NvU32 index = devList.numEntries;
+    NvS32 pos;
+    NvU32 i;
+
+    if(!driver || !driver->name || !driver->name[0]) {
+        LOG_ERR("%s: Bad parameter\n", __func__);
+        return NVMEDIA_STATUS_BAD_PARAMETER;
+    }
+
+    if(index == MAX_IMG_DEV_REGISTERED) {
+        LOG_ERR("%s: Too many drivers, can't add %s\n", __func__, driver->name);
+        return NVMEDIA_STATUS_ERROR;
+    }
+
+    pos = FindPredecessor(driver->name);
+    if(pos >= 0 && !strcmp(SORTED_ENTRY(pos)->info.driver->name, driver->name)) {
+        LOG_ERR("%s: Driver %s is already registered\n", __func__, driver->name);
+        return NVMEDIA_STATUS_ERROR;
+    }
+
+    devList.entries[index].info.driver = driver;
+    devList.entries[index].info.interfaces = interfaces;
+    devList.entries[index].nameLen = strlen(driver->name);
+    for(i = 0; i < IMG_DEV_IF_BITS; i++) {
+        if(interfaces & (1 << i))
+            devList.byInterface[i] |= (NvU64)1 << index;
+    }
+
+    memmove(&devList.sorted[pos + 2], &devList.sorted[pos + 1],
+            (index - (pos + 1)) * sizeof(devList.sorted[0]));
+    devList.sorted[pos + 1] = index;
+    devList.numEntries++;
+
+    /* A name's longest prefix sorts before it, so the parents can be
+     * found in order with the links already computed */
+    for(i = 0; i < devList.numEntries; i++)
+        devList.parent[i] = MatchPrefix(SORTED_ENTRY(i)->info.driver->name,
+                                         (NvS32)i - 1);
+
+    return NVMEDIA_STATUS_OK;
+}
+
+static void
+RegisterBuiltinDevices(void)
+{
+    NvU32 i;
+
+    for(i = 0; i < MAX_IMG_DEV_SUPPORTED; i++)
+        AddDevice(builtinDevices[i].GetDriver(), builtinDevices[i].interfaces);
+}
+
 ImgDevDriver *ImgGetDevice(char *moduleName)
 {
-    NvS32 i;
-    ImgDevDriver *devices[MAX_IMG_DEV_SUPPORTED] = {
-        GetDriver_ref_max9286_9271_ov10635(),
-        GetDriver_ref_max9286_9271_ov10640(),
-        GetDriver_c_max9286_9271_ov10640lsoff(),
-        GetDriver_c_max9286_9271_ov10640(),
-        GetDriver_d_max9286_9271_mt9v024(),
-        GetDriver_ref_max9286_96705_ar0231rccb(),
-        GetDriver_ref_max9286_96705_ar0231(),
-        GetDriver_ref_max9288_96705_ov10635(),
-        GetDriver_m_max9288_96705_ar0140(),
-        GetDriver_tpg(),
-        GetDriver_ref_max9286_96705_ov2718_xc7027()
-    };
+    ImgDevDriver *driver = NULL;
+    NvS32 pos;
 
     if(!moduleName) {
-        LOG_ERR("%s: Bad parameter for module name%s\n", __func__);
+        LOG_ERR("%s: Bad parameter for module name\n", __func__);
         return NULL;
     }
 
-    for(i = 0; i < MAX_IMG_DEV_SUPPORTED; i++) {
-        /* module name can have device name and version number,
-         * so module name can be longer than device name.
-         * therefore, comparing string needs length of the device name */
-        if(!strncmp(moduleName, devices[i]->name, strlen(devices[i]->name))) {
-            LOG_DBG("%s: Found the driver for %s\n", __func__, moduleName);
-            return devices[i];
-        }
+    pthread_once(&devListOnce, RegisterBuiltinDevices);
+
+    /* module name can have device name and version number,
+     * so module name can be longer than device name.
+     * therefore, the longest device name that starts it is chosen */
+    pthread_rwlock_rdlock(&devListLock);
+    pos = MatchPrefix(moduleName, FindPredecessor(moduleName));
+    if(pos >= 0)
+        driver = SORTED_ENTRY(pos)->info.driver;
+    pthread_rwlock_unlock(&devListLock);
+
+    if(!driver) {
+        LOG_ERR("%s: Can't find driver for %s\n", __func__, moduleName);
+        return NULL;
     }
 
-    LOG_ERR("%s: Can't find driver for %s\n", __func__, moduleName);
+    LOG_DBG("%s: Found the driver for %s\n", __func__, moduleName);
+    return driver;
+}
 
-    return NULL;
-};
+NvU32
+ImgGetDevicesByInterface(
+    NvU32 interfaces,
+    ImgDevDriverInfo *drivers,
+    NvU32 maxDrivers)
+{
+    NvU64 matches;
+    NvU32 i, count = 0;
+
+    if(interfaces >> IMG_DEV_IF_BITS)
+        return 0;
+
+    pthread_once(&devListOnce, RegisterBuiltinDevices);
+
+    pthread_rwlock_rdlock(&devListLock);
+    matches = devList.numEntries == MAX_IMG_DEV_REGISTERED ? ~(NvU64)0 :
+              ((NvU64)1 << devList.numEntries) - 1;
+    for(i = 0; i < IMG_DEV_IF_BITS; i++) {
+        if(interfaces & (1 << i))
+            matches &= devList.byInterface[i];
+    }
+
+    for(i = 0; matches; i++, matches >>= 1) {
+        if(!(matches & 1))
+            continue;
+        if(drivers && count < maxDrivers)
+            drivers[count] = devList.entries[i].info;
+        count++;
+    }
+    pthread_rwlock_unlock(&devListLock);
+
+    return count;
+}
+
+NvMediaStatus
+ImgRegisterDevice(ImgDevDriver *driver, NvU32 interfaces)
+{
+    NvMediaStatus status;
+
+    pthread_once(&devListOnce, RegisterBuiltinDevices);
+
+    pthread_rwlock_wrlock(&devListLock);
+    status = AddDevice(driver, interfaces);
+    pthread_rwlock_unlock(&devListLock);
+
+    if(status == NVMEDIA_STATUS_OK)
+        LOG_DBG("%s: Registered %s\n", __func__, driver->name);
+
+    return status;
+}
+
+NvMediaStatus
+ImgLoadDeviceLibrary(const char *path)
+{
+    ImgDevGetDriversFunc getDrivers;
+    const ImgDevDriverInfo *drivers;
+    NvU32 i, numDrivers = 0, numAdded = 0;
+    NvMediaStatus status = NVMEDIA_STATUS_OK;
+    void *handle;
+
+    if(!path) {
+        LOG_ERR("%s: Bad parameter\n", __func__);
+        return NVMEDIA_STATUS_BAD_PARAMETER;
+    }
+
+    handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if(!handle) {
+        LOG_ERR("%s: Can't load %s: %s\n", __func__, path, dlerror());
+        return NVMEDIA_STATUS_ERROR;
+    }
+
+    getDrivers = (ImgDevGetDriversFunc)dlsym(handle, IMG_DEV_LIBRARY_SYMBOL);
+    drivers = getDrivers ? getDrivers(&numDrivers) : NULL;
+    if(!drivers) {
+        LOG_ERR("%s: %s has no drivers\n", __func__, path);
+        dlclose(handle);
+        return NVMEDIA_STATUS_ERROR;
+    }
+
+    for(i = 0; i < numDrivers; i++) {
+        if(ImgRegisterDevice(drivers[i].driver, drivers[i].interfaces) ==
+           NVMEDIA_STATUS_OK)
+            numAdded++;
+        else
+            status = NVMEDIA_STATUS_ERROR;
+    }
+
+    /* The registered drivers point into the library */
+    if(!numAdded)
+        dlclose(handle);
+
+    return status;
+}
@@ -23,6 +23,43 @@ typedef enum {
     MAX_IMG_DEV_SUPPORTED,
 } ImgDevicesList;
 
+/* Maximum number of drivers, built-in and registered */
+#define MAX_IMG_DEV_REGISTERED      64
+
+/* Chips a driver talks to; a driver can be looked up by any combination */
+typedef enum {
+    IMG_DEV_IF_MAX9286      = (1 << 0),  /* quad GMSL deserializer */
+    IMG_DEV_IF_MAX9288      = (1 << 1),  /* single GMSL deserializer */
+    IMG_DEV_IF_MAX9271      = (1 << 2),  /* serializer */
+    IMG_DEV_IF_MAX96705     = (1 << 3),  /* serializer */
+    IMG_DEV_IF_TPG          = (1 << 4),  /* test pattern, no link */
+    IMG_DEV_IF_BITS         = 5,
+} ImgDevInterface;
+
+typedef struct {
+    ImgDevDriver   *driver;
+    NvU32           interfaces;  /* ImgDevInterface mask */
+} ImgDevDriverInfo;
+
+/* A driver library loaded with ImgLoadDeviceLibrary() exports this
+ * function; it returns its drivers and stores their number */
+#define IMG_DEV_LIBRARY_SYMBOL      "ImgDevGetDrivers"
+typedef const ImgDevDriverInfo *(*ImgDevGetDriversFunc)(NvU32 *numDrivers);
+
+/* Returns the driver whose name is the longest prefix of moduleName;
+ * module names may carry a version after the driver name */
 ImgDevDriver *ImgGetDevice(char *moduleName);
 
+/* Stores up to maxDrivers drivers that talk to all chips in interfaces
+ * (0 for all drivers) and returns the number of matching drivers */
+NvU32 ImgGetDevicesByInterface(NvU32 interfaces, ImgDevDriverInfo *drivers,
+                               NvU32 maxDrivers);
+
+/* Adds a driver; its name must not be registered already */
+NvMediaStatus ImgRegisterDevice(ImgDevDriver *driver, NvU32 interfaces);
+
+/* Loads a driver library and registers its drivers.  The library stays
+ * loaded for the life of the process. */
+NvMediaStatus ImgLoadDeviceLibrary(const char *path);
+
 #endif /* _DEV_LIST_H_ */
@@ -8,6 +8,7 @@
 #define _DEV_PRIV_H_
 
 #include "img_dev.h"
+#include "dev_bringup.h"
 
 typedef struct {
     char                       *resolution; /* resolution, ex)"1280x800" */
@@ -31,6 +32,10 @@ typedef struct {
     ImgProperty    *properties;
     NvU32          numProperties;
     NvMediaStatus (*Start)(ExtImgDevice *device);
+    /* Optional, used instead of Start: adds the start sequence as steps
+     * on the device's I2C bus after the steps in deps */
+    NvMediaStatus (*ScheduleStart)(ExtImgDevice *device, ImgBringup *bringup,
+                                   NvU32 numDeps, const NvU32 *deps);
 } ImgDevDriver;
 
 #endif /* _DEV_PRIV_H_ */
@@ -20,7 +20,7 @@ extern "C" {
 /* Major Version number */
 #define EXTIMGDEV_VERSION_MAJOR   1
 /* Minor Version number */
-#define EXTIMGDEV_VERSION_MINOR   8
+#define EXTIMGDEV_VERSION_MINOR   9
 
 #define MAX_AGGREGATE_IMAGES 4
 
@@ -127,6 +127,7 @@ typedef struct {
     NvMediaBool                 simulator;
     NvMediaISCDevice           *iscSensor2[MAX_AGGREGATE_IMAGES];
     NvMediaISCDevice           *iscBroadcastSensor2;
+    NvU32                       i2cDevice; /* bus the device is controlled on */
 } ExtImgDevice;
 
 ExtImgDevice *
@@ -138,6 +139,16 @@ ExtImgDevDeinit(ExtImgDevice *device);
 NvMediaStatus
 ExtImgDevStart(ExtImgDevice *device);
 
+/*
+ * Starts several devices at once.  Devices on different I2C buses are
+ * brought up in parallel; on a shared bus only the register accesses are
+ * serialized and the settle delays of the devices overlap.
+ */
+NvMediaStatus
+ExtImgDevStartMultiple(
+    ExtImgDevice **devices,
+    NvU32 numDevices);
+
 void
 ExtImgDevStop(ExtImgDevice *device);
 
@@ -199,6 +210,10 @@ ExtImgDevCheckVersion(
  * - Added enableExtSync in \ref ExtImgDevParam and ExtImgDevProperty
  * - Added dutyRatio in \ref ExtImgDevParam and ExtImgDevProperty
  *
+ * <b> Version 1.9 </b> Oct 18, 2017
+ * - Added \ref ExtImgDevStartMultiple API
+ * - Added i2cDevice in \ref ExtImgDevice
+ *
  */
 
 #ifdef __cplusplus
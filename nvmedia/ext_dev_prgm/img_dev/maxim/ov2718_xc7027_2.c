@@ -22,11 +22,13 @@
 #define REG_WRITE_BUFFER        32
 
 
-static NvMediaISCSupportFunctions  *g_I2c_func = NULL;
-static NvMediaISCTransactionHandle *g_transaction = NULL;
+/* Set and used within one SetDeviceConfig call; per thread so devices
+ * started in parallel do not write through each other's transaction */
+static __thread NvMediaISCSupportFunctions  *g_I2c_func = NULL;
+static __thread NvMediaISCTransactionHandle *g_transaction = NULL;
 
-static NvMediaISCSupportFunctions  *g_I2c_func_ov = NULL;
-static NvMediaISCTransactionHandle *g_transaction_ov = NULL;
+static __thread NvMediaISCSupportFunctions  *g_I2c_func_ov = NULL;
+static __thread NvMediaISCTransactionHandle *g_transaction_ov = NULL;
 
 
 static int OV2718MIPI_write_cmos_sensor(unsigned short addr, unsigned char para);
@@ -834,105 +834,215 @@ failed:
 }
 
 static NvMediaStatus
-Start(ExtImgDevice *device)
+StartIsp(void *context, NvU32 index)
 {
+    ExtImgDevice *device = context;
+
+    LOG_DBG("%s: Enable streaming\n", __func__);
+    return NvMediaISCSetDeviceConfig(device->iscBroadcastSensor,
+                                     ISC_CONFIG_XC7027_ENABLE_STREAMING);
+}
+
+static NvMediaStatus
+EnableIspBypass(void *context, NvU32 index)
+{
+    ExtImgDevice *device = context;
+
+    return NvMediaISCSetDeviceConfig(device->iscBroadcastSensor,
+                                     ISC_CONFIG_XC7027_I2C_BYPASS_ON);
+}
+
+static NvMediaStatus
+StartSensor(void *context, NvU32 index)
+{
+    ExtImgDevice *device = context;
+
+    if(!device->iscBroadcastSensor2)
+        return NVMEDIA_STATUS_OK;
+
+    LOG_DBG("%s: Enable streaming2\n", __func__);
+    return NvMediaISCSetDeviceConfig(device->iscBroadcastSensor2,
+                                     ISC_CONFIG_OV2718_ENABLE_STREAMING);
+}
+
+static NvMediaStatus
+DisableIspBypass(void *context, NvU32 index)
+{
+    ExtImgDevice *device = context;
+
+    return NvMediaISCSetDeviceConfig(device->iscBroadcastSensor,
+                                     ISC_CONFIG_XC7027_I2C_BYPASS_OFF);
+}
+
+static NvMediaStatus
+EnableSerialLink(void *context, NvU32 index)
+{
+    ExtImgDevice *device = context;
+
+    LOG_DBG("%s: Enable serial link\n", __func__);
+    return NvMediaISCSetDeviceConfig(device->iscBroadcastSerializer,
+                                     ISC_CONFIG_MAX96705_ENABLE_SERIAL_LINK);
+}
+
+static NvMediaStatus
+CheckVideoLink(void *context, NvU32 index)
+{
+    ExtImgDevice *device = context;
     NvMediaStatus status;
+    NvU32 timeout = 5000;
+
+    LOG_DBG("%s: Get Link(%d) Status\n", __func__, device->remapIdx[index]);
+    do {
+        // Check Video Link
+        usleep(10);
+        status = NvMediaISCGetLinkStatus(device->iscDeserializer, device->remapIdx[index]);
+        timeout--;
+    } while ((status != NVMEDIA_STATUS_OK) && (timeout));
+
+    if(status != NVMEDIA_STATUS_OK)
+        LOG_ERR("%s: Video Link(%d) is not detected\n", __func__, device->remapIdx[index]);
+
+    return status;
+}
+
+static NvMediaStatus
+EnableCsiOut(void *context, NvU32 index)
+{
+    ExtImgDevice *device = context;
+
+    LOG_DBG("%s: Enable csi out\n", __func__);
+    return NvMediaISCSetDeviceConfig(device->iscDeserializer,
+                                     ISC_CONFIG_MAX9286_ENABLE_CSI_OUT);
+}
+
+/* Steps with a function hold the device's I2C bus, delays do not */
+static NvMediaStatus
+AddStep(
+    ImgBringup *bringup,
+    ExtImgDevice *device,
+    const char *name,
+    ImgBringupFunc func,
+    NvU32 index,
+    NvU32 settleUs,
+    NvU32 numDeps,
+    const NvU32 *deps,
+    NvU32 *taskId)
+{
+    ImgBringupTask task;
+
+    task.name = name;
+    task.func = func;
+    task.context = device;
+    task.index = index;
+    task.bus = func ? device->i2cDevice : IMG_BRINGUP_NO_BUS;
+    task.settleUs = settleUs;
+
+    return ImgBringupAddTask(bringup, &task, numDeps, deps, taskId);
+}
+
+/*
+ * Start sequence: ISP -> sensor behind the ISP's I2C bypass -> serializer
+ * -> video link of each camera -> deserializer CSI out.  Each arrow waits
+ * for the previous step and its settle time; the bus is only held while
+ * registers are accessed, so another device on the same bus can be
+ * programmed during this device's delays.
+ */
+static NvMediaStatus
+ScheduleStart(
+    ExtImgDevice *device,
+    ImgBringup *bringup,
+    NvU32 numDeps,
+    const NvU32 *deps)
+{
+    NvMediaStatus status = NVMEDIA_STATUS_OK;
+    NvU32 prev[IMG_BRINGUP_MAX_DEPS];
+    NvU32 numPrev = numDeps;
+    NvU32 links[MAX_AGGREGATE_IMAGES];
     NvU32 i;
 
-    if(!device)
+    if(!device || !bringup || numDeps > IMG_BRINGUP_MAX_DEPS)
         return NVMEDIA_STATUS_BAD_PARAMETER;
 
-    // Enable csi out
+    if(numDeps)
+        memcpy(prev, deps, numDeps * sizeof(NvU32));
+
     if(device->iscBroadcastSensor) {
         if(device->property.enableExtSync) {
             // Wait for PLL locked
-            usleep(50000);
+            status = AddStep(bringup, device, "pll lock", NULL, 0, 50000,
+                             numPrev, prev, &prev[0]);
+            if(status != NVMEDIA_STATUS_OK)
+                return status;
+            numPrev = 1;
         }
 
-        LOG_DBG("%s: Enable streaming\n", __func__);
-        status = NvMediaISCSetDeviceConfig(device->iscBroadcastSensor,
-                                           ISC_CONFIG_XC7027_ENABLE_STREAMING);
-        if (status != NVMEDIA_STATUS_OK) {
-            LOG_ERR("%s: Failed to enable sensor streaming\n", __func__);
+        status = AddStep(bringup, device, "isp streaming", StartIsp, 0, 0,
+                         numPrev, prev, &prev[0]);
+        if(status != NVMEDIA_STATUS_OK)
             return status;
-        }
+        numPrev = 1;
     }
-	
-	#ifdef USE_OV2718
-	status = NvMediaISCSetDeviceConfig(device->iscBroadcastSensor,
-									   ISC_CONFIG_XC7027_I2C_BYPASS_ON);
-	if (status != NVMEDIA_STATUS_OK) {
-		LOG_ERR("%s: Failed to enable ISC_CONFIG_XC7027_I2C_BYPASS_ON\n", __func__);
-		return status;
-	}
-
-	usleep(50000);
 
-	if(device->iscBroadcastSensor2){
-        if(device->property.enableExtSync) {
-            // Wait for PLL locked
-            usleep(50000);
-        }
+#ifdef USE_OV2718
+    status = AddStep(bringup, device, "isp i2c bypass on", EnableIspBypass, 0, 50000,
+                     numPrev, prev, &prev[0]);
+    if(status != NVMEDIA_STATUS_OK)
+        return status;
+    numPrev = 1;
 
-        LOG_DBG("%s: Enable streaming2\n", __func__);
-        status = NvMediaISCSetDeviceConfig(device->iscBroadcastSensor2,
-                                           ISC_CONFIG_OV2718_ENABLE_STREAMING);
-        if (status != NVMEDIA_STATUS_OK) {
-            LOG_ERR("%s: Failed to enable sensor streaming2\n", __func__);
+    if(device->iscBroadcastSensor2 && device->property.enableExtSync) {
+        // Wait for PLL locked
+        status = AddStep(bringup, device, "pll lock 2", NULL, 0, 50000,
+                         numPrev, prev, &prev[0]);
+        if(status != NVMEDIA_STATUS_OK)
             return status;
-        }
-	}
+    }
 
-	usleep(50000);
+    status = AddStep(bringup, device, "sensor streaming", StartSensor, 0, 50000,
+                     numPrev, prev, &prev[0]);
+    if(status != NVMEDIA_STATUS_OK)
+        return status;
+
+    status = AddStep(bringup, device, "isp i2c bypass off", DisableIspBypass, 0, 0,
+                     numPrev, prev, &prev[0]);
+    if(status != NVMEDIA_STATUS_OK)
+        return status;
+#endif
 
-	status = NvMediaISCSetDeviceConfig(device->iscBroadcastSensor,
-									   ISC_CONFIG_XC7027_I2C_BYPASS_OFF);
-	if (status != NVMEDIA_STATUS_OK) {
-		LOG_ERR("%s: Failed to enable ISC_CONFIG_XC7027_I2C_BYPASS_OFF\n", __func__);
-		return status;
-	}
-	#endif
-	
     if(device->iscBroadcastSerializer) {
-        // Enable each serial link
-        LOG_DBG("%s: Enable serial link\n", __func__);
-        status = NvMediaISCSetDeviceConfig(device->iscBroadcastSerializer,
-                                           ISC_CONFIG_MAX96705_ENABLE_SERIAL_LINK);
-        if(status != NVMEDIA_STATUS_OK) {
-            LOG_ERR("%s: Failed to enable serial link\n", __func__);
+        // Enable each serial link, wait 5ms
+        status = AddStep(bringup, device, "serial link", EnableSerialLink, 0, 5000,
+                         numPrev, prev, &prev[0]);
+        if(status != NVMEDIA_STATUS_OK)
             return status;
-        }
-        usleep(5000);  //wait 5ms
+        numPrev = 1;
     }
 
     // TODO: Without this sleep, sometimes aggregator can't detect video link,
     // once we find the way the timing, will remove this delay
-    if(!device->simulator) {
+    if(!device->simulator && device->sensorsNum) {
         for(i = 0; i < device->sensorsNum; i++) {
-            NvU32 timeout = 5000;
-            LOG_DBG("%s: Get Link(%d) Status\n", __func__, device->remapIdx[i]);
-            do {
-                // Check Video Link
-                usleep(10);
-                status = NvMediaISCGetLinkStatus(device->iscDeserializer, device->remapIdx[i]);
-                timeout--;
-            } while ((status != NVMEDIA_STATUS_OK) && (timeout));
-
-            if(status != NVMEDIA_STATUS_OK) {
-                LOG_ERR("%s: Video Link(%d) is not detected\n", __func__, device->remapIdx[i]);
+            status = AddStep(bringup, device, "video link", CheckVideoLink, i, 0,
+                             numPrev, prev, &links[i]);
+            if(status != NVMEDIA_STATUS_OK)
                 return status;
-            }
         }
+        memcpy(prev, links, device->sensorsNum * sizeof(NvU32));
+        numPrev = device->sensorsNum;
     }
 
     if(device->property.enableExtSync) {
         // Wait for about 6 VSYNC for cameras to synchronize with extra 1 VSYNC
-        usleep(7 * 1000000u / device->property.frameRate);
+        status = AddStep(bringup, device, "camera sync", NULL, 0,
+                         7 * 1000000u / device->property.frameRate,
+                         numPrev, prev, &prev[0]);
+        if(status != NVMEDIA_STATUS_OK)
+            return status;
+        numPrev = 1;
     }
 
-    LOG_DBG("%s: Enable csi out\n", __func__);
-    return NvMediaISCSetDeviceConfig(device->iscDeserializer,
-                                     ISC_CONFIG_MAX9286_ENABLE_CSI_OUT);
+    return AddStep(bringup, device, "csi out", EnableCsiOut, 0, 0,
+                   numPrev, prev, NULL);
 }
 
 static NvMediaStatus
@@ -974,7 +1084,7 @@ static ImgDevDriver device = {
     .name = "ref_max9286_96705_ov2718_xc7027",
     .Init = Init,
     .Deinit = Deinit,
-    .Start = Start,
+    .ScheduleStart = ScheduleStart,
     .RegisterCallback = RegisterCallback,
     .GetError = GetError,
     .properties = properties,
@@ -0,0 +1,432 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION.  All rights reserved. All
+ * information contained herein is proprietary and confidential to NVIDIA
+ * Corporation.  Any use, reproduction, or disclosure without the written
+ * permission of NVIDIA Corporation is prohibited.
+ */
+
+/*
+ * Tests the bring-up scheduler against a stub I2C bus, and measures the
+ * start time of several aggregators against starting them one by one.
+ *
+ * Every stub transaction sleeps while it holds its bus and counts an
+ * overlap when another transaction is on the same bus, so a step that
+ * runs while another step holds its bus is caught.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "dev_bringup.h"
+
+#define NUM_BUSES           4
+#define TRANSACTION_US      100
+#define MAX_STEPS           IMG_BRINGUP_MAX_TASKS
+
+/* One aggregator with four cameras, shaped like the ov2718/xc7027
+ * start; the register tables are a tenth of the real ones */
+#define CAMERAS_PER_AGG     4
+#define ISP_WRITES          236
+#define ISP_WRITE_PAUSE_US  500
+#define SENSOR_WRITES       184
+
+static int numFailures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if(!(cond)) { \
+            printf("FAIL %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            numFailures++; \
+        } \
+    } while(0)
+
+/* What a step did, in the order steps started and ended */
+typedef struct {
+    NvU32       bus;
+    NvU32       writes;
+    NvU32       pauseUs;    /* after each write, bus released */
+    NvMediaBool fail;
+    double      start;
+    double      end;
+    NvMediaBool ran;
+} Step;
+
+static struct {
+    int         users[NUM_BUSES];
+    int         overlaps;
+    int         running;    /* steps in their function, under lock */
+    int         maxRunning;
+    pthread_mutex_t lock;
+} stubBus = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static Step steps[MAX_STEPS];
+
+static double
+GetTimeSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+ResetStubBus(void)
+{
+    stubBus.running = stubBus.maxRunning = stubBus.overlaps = 0;
+    memset(stubBus.users, 0, sizeof(stubBus.users));
+    memset(steps, 0, sizeof(steps));
+}
+
+static void
+BusTransfer(NvU32 bus)
+{
+    if(__sync_fetch_and_add(&stubBus.users[bus], 1) != 0)
+        __sync_fetch_and_add(&stubBus.overlaps, 1);
+    usleep(TRANSACTION_US);
+    __sync_fetch_and_sub(&stubBus.users[bus], 1);
+}
+
+static NvMediaStatus
+StepFunc(void *context, NvU32 index)
+{
+    Step *step = &((Step *)context)[index];
+    NvU32 i;
+
+    step->ran = NVMEDIA_TRUE;
+    step->start = GetTimeSec();
+    pthread_mutex_lock(&stubBus.lock);
+    if(++stubBus.running > stubBus.maxRunning)
+        stubBus.maxRunning = stubBus.running;
+    pthread_mutex_unlock(&stubBus.lock);
+
+    for(i = 0; i < step->writes; i++) {
+        BusTransfer(step->bus);
+        if(step->pauseUs)
+            usleep(step->pauseUs);
+    }
+
+    pthread_mutex_lock(&stubBus.lock);
+    stubBus.running--;
+    pthread_mutex_unlock(&stubBus.lock);
+    step->end = GetTimeSec();
+
+    return step->fail ? NVMEDIA_STATUS_ERROR : NVMEDIA_STATUS_OK;
+}
+
+static NvMediaStatus
+AddStep(ImgBringup *bringup, NvU32 index, NvU32 bus, NvU32 writes,
+        NvU32 settleUs, NvU32 numDeps, const NvU32 *deps)
+{
+    ImgBringupTask task;
+    NvU32 taskId = ~0u;
+    NvMediaStatus status;
+
+    memset(&task, 0, sizeof(task));
+    task.name = "step";
+    task.func = StepFunc;
+    task.context = steps;
+    task.index = index;
+    task.bus = bus;
+    task.settleUs = settleUs;
+    steps[index].bus = bus;
+    steps[index].writes = writes;
+
+    status = ImgBringupAddTask(bringup, &task, numDeps, deps, &taskId);
+    if(status == NVMEDIA_STATUS_OK)
+        CHECK(taskId == index, "step %u got id %u", index, taskId);
+
+    return status;
+}
+
+/* Two chains on two buses with settle times, and a step joining them */
+static void
+TestDependencyOrder(void)
+{
+    static const struct {
+        NvU32 bus;
+        NvU32 settleUs;
+        NvU32 numDeps;
+        NvU32 deps[2];
+    } graph[] = {
+        { 0, 20000, 0, { 0 } },     /* 0 */
+        { 0, 0,     1, { 0 } },     /* 1 */
+        { 0, 0,     1, { 1 } },     /* 2 */
+        { 1, 0,     0, { 0 } },     /* 3 */
+        { 1, 10000, 1, { 3 } },     /* 4 */
+        { 1, 0,     0, { 0 } },     /* 5: same bus as 3 and 4, no deps */
+        { IMG_BRINGUP_NO_BUS, 0, 2, { 2, 4 } },
+        { 0, 0,     2, { 6, 5 } },
+    };
+    const NvU32 numSteps = sizeof(graph) / sizeof(graph[0]);
+    ImgBringup *bringup;
+    NvU32 i, j, dep;
+
+    ResetStubBus();
+    bringup = ImgBringupCreate(4);
+    if(!bringup) {
+        CHECK(0, "cannot create a scheduler");
+        return;
+    }
+
+    /* The joining step has no bus and makes no transfers */
+    for(i = 0; i < numSteps; i++) {
+        CHECK(AddStep(bringup, i, graph[i].bus,
+                      graph[i].bus == IMG_BRINGUP_NO_BUS ? 0 : 20,
+                      graph[i].settleUs, graph[i].numDeps, graph[i].deps) ==
+              NVMEDIA_STATUS_OK, "step %u not added", i);
+    }
+
+    CHECK(ImgBringupRun(bringup) == NVMEDIA_STATUS_OK, "run failed");
+
+    for(i = 0; i < numSteps; i++) {
+        CHECK(steps[i].ran, "step %u did not run", i);
+        for(j = 0; j < graph[i].numDeps; j++) {
+            dep = graph[i].deps[j];
+            /* settle is waited after the step, before its dependents */
+            CHECK(steps[i].start >= steps[dep].end +
+                  graph[dep].settleUs / 1e6,
+                  "step %u started %.1f ms after step %u ended, settle %u us",
+                  i, (steps[i].start - steps[dep].end) * 1e3, dep,
+                  graph[dep].settleUs);
+        }
+        /* Steps of one bus never run at the same time */
+        for(j = 0; j < i; j++) {
+            if(graph[i].bus == IMG_BRINGUP_NO_BUS || graph[i].bus != graph[j].bus)
+                continue;
+            CHECK(steps[i].start >= steps[j].end || steps[j].start >= steps[i].end,
+                  "steps %u and %u on bus %u overlap", j, i, graph[i].bus);
+        }
+    }
+    CHECK(stubBus.overlaps == 0, "%d overlapping transactions", stubBus.overlaps);
+    CHECK(stubBus.maxRunning > 1, "the two buses never ran in parallel");
+
+    /* The same graph runs again */
+    for(i = 0; i < numSteps; i++)
+        steps[i].ran = NVMEDIA_FALSE;
+    CHECK(ImgBringupRun(bringup) == NVMEDIA_STATUS_OK, "second run failed");
+    for(i = 0; i < numSteps; i++)
+        CHECK(steps[i].ran, "step %u did not run again", i);
+
+    ImgBringupDestroy(bringup);
+}
+
+static void
+TestRejectedGraphs(void)
+{
+    NvU32 deps[IMG_BRINGUP_MAX_DEPS + 1] = { 0 };
+    ImgBringupTask task;
+    ImgBringup *bringup;
+    NvU32 i;
+
+    CHECK(ImgBringupCreate(IMG_BRINGUP_MAX_THREADS + 1) == NULL,
+          "too many threads accepted");
+
+    ResetStubBus();
+    bringup = ImgBringupCreate(0);
+    if(!bringup) {
+        CHECK(0, "cannot create a scheduler");
+        return;
+    }
+
+    /* A step can only depend on steps added before it */
+    deps[0] = 0;
+    CHECK(AddStep(bringup, 0, 0, 1, 0, 1, deps) == NVMEDIA_STATUS_BAD_PARAMETER,
+          "dependency on itself accepted");
+    CHECK(AddStep(bringup, 0, 0, 1, 0, 0, NULL) == NVMEDIA_STATUS_OK,
+          "first step");
+    deps[0] = 1;
+    CHECK(AddStep(bringup, 1, 0, 1, 0, 1, deps) == NVMEDIA_STATUS_BAD_PARAMETER,
+          "dependency on itself accepted");
+    deps[0] = 5;
+    CHECK(AddStep(bringup, 1, 0, 1, 0, 1, deps) == NVMEDIA_STATUS_BAD_PARAMETER,
+          "forward dependency accepted");
+    CHECK(AddStep(bringup, 1, 0, 1, 0, 1, NULL) == NVMEDIA_STATUS_BAD_PARAMETER,
+          "missing dependency list accepted");
+    memset(deps, 0, sizeof(deps));
+    CHECK(AddStep(bringup, 1, 0, 1, 0, IMG_BRINGUP_MAX_DEPS + 1, deps) ==
+          NVMEDIA_STATUS_BAD_PARAMETER, "too many dependencies accepted");
+    CHECK(ImgBringupAddTask(bringup, NULL, 0, NULL, NULL) ==
+          NVMEDIA_STATUS_BAD_PARAMETER, "NULL step accepted");
+
+    /* Only as many buses as the scheduler tracks */
+    for(i = 1; i < IMG_BRINGUP_MAX_BUSES; i++)
+        CHECK(AddStep(bringup, i, 100 + i, 0, 0, 0, NULL) == NVMEDIA_STATUS_OK,
+              "bus %u not accepted", 100 + i);
+    CHECK(AddStep(bringup, i, 200, 0, 0, 0, NULL) != NVMEDIA_STATUS_OK,
+          "bus %u of %u accepted", i + 1, IMG_BRINGUP_MAX_BUSES);
+    memset(&task, 0, sizeof(task));
+    task.bus = IMG_BRINGUP_NO_BUS;
+    CHECK(ImgBringupAddTask(bringup, &task, 0, NULL, NULL) == NVMEDIA_STATUS_OK,
+          "delay step rejected with all buses used");
+
+    /* The rejected steps are not part of the graph */
+    CHECK(ImgBringupRun(bringup) == NVMEDIA_STATUS_OK, "run failed");
+    ImgBringupDestroy(bringup);
+
+    CHECK(ImgBringupRun(NULL) == NVMEDIA_STATUS_BAD_PARAMETER, "NULL run");
+}
+
+/* A chain on one bus next to an independent slower chain on another */
+static void
+TestStopAfterFailure(void)
+{
+    ImgBringup *bringup;
+    NvU32 i, dep;
+
+    ResetStubBus();
+    bringup = ImgBringupCreate(2);
+    if(!bringup) {
+        CHECK(0, "cannot create a scheduler");
+        return;
+    }
+
+    for(i = 0; i < 6; i++) {
+        dep = i - 1;
+        AddStep(bringup, i, 0, 5, 0, i ? 1 : 0, &dep);
+    }
+    steps[3].fail = NVMEDIA_TRUE;
+    for(i = 6; i < 12; i++) {
+        dep = i - 1;
+        AddStep(bringup, i, 1, 50, 0, i > 6 ? 1 : 0, &dep);
+    }
+
+    CHECK(ImgBringupRun(bringup) == NVMEDIA_STATUS_ERROR,
+          "failed step not reported");
+    for(i = 0; i < 4; i++)
+        CHECK(steps[i].ran, "step %u before the failure did not run", i);
+    for(i = 4; i < 6; i++)
+        CHECK(!steps[i].ran, "step %u after the failure ran", i);
+    /* The other chain stops too; at most the step it was running ends */
+    CHECK(steps[6].ran && !steps[7].ran,
+          "other bus ran %d steps after the failure",
+          steps[7].ran + steps[8].ran + steps[9].ran);
+    for(i = 6; i < 12; i++) {
+        CHECK(!steps[i].ran || steps[i].start <= steps[3].end,
+              "step %u started after the failure", i);
+    }
+
+    /* A step that fails with its settle time does not wait for it */
+    ImgBringupDestroy(bringup);
+    ResetStubBus();
+    bringup = ImgBringupCreate(1);
+    if(!bringup)
+        return;
+    AddStep(bringup, 0, 0, 1, 2000000, 0, NULL);
+    steps[0].fail = NVMEDIA_TRUE;
+    {
+        double start = GetTimeSec();
+
+        CHECK(ImgBringupRun(bringup) == NVMEDIA_STATUS_ERROR &&
+              GetTimeSec() - start < 1.0, "failed step waited its settle time");
+    }
+    ImgBringupDestroy(bringup);
+}
+
+/*
+ * One aggregator: ISP, I2C bypass on, sensor, bypass off, serializer,
+ * the video link of each camera, then CSI out.  Returns the number of
+ * steps added from firstStep, or 0 on failure.
+ */
+static NvU32
+AddAggregator(ImgBringup *bringup, NvU32 firstStep, NvU32 bus)
+{
+    NvU32 s = firstStep, prev, links[CAMERAS_PER_AGG], i;
+
+    if(AddStep(bringup, s, bus, ISP_WRITES, 0, 0, NULL))
+        return 0;
+    steps[s].pauseUs = ISP_WRITE_PAUSE_US;
+    prev = s++;
+    if(AddStep(bringup, s, bus, 3, 50000, 1, &prev))
+        return 0;
+    prev = s++;
+    if(AddStep(bringup, s, bus, SENSOR_WRITES, 50000, 1, &prev))
+        return 0;
+    prev = s++;
+    if(AddStep(bringup, s, bus, 3, 0, 1, &prev))
+        return 0;
+    prev = s++;
+    if(AddStep(bringup, s, bus, 1, 5000, 1, &prev))
+        return 0;
+    prev = s++;
+    for(i = 0; i < CAMERAS_PER_AGG; i++) {
+        if(AddStep(bringup, s, bus, 1, 0, 1, &prev))
+            return 0;
+        links[i] = s++;
+    }
+    if(AddStep(bringup, s, bus, 1, 0, CAMERAS_PER_AGG, links))
+        return 0;
+
+    return ++s - firstStep;
+}
+
+/* Starts numAggs aggregators on numBuses buses; one scheduler per
+ * aggregator run one after another is the sequential start */
+static double
+StartAggregators(NvU32 numAggs, NvU32 numBuses, NvMediaBool together)
+{
+    ImgBringup *bringup = NULL;
+    NvU32 a, numSteps = 0, added;
+    double start = GetTimeSec();
+
+    ResetStubBus();
+    for(a = 0; a < numAggs; a++) {
+        if(!bringup) {
+            bringup = ImgBringupCreate(0);
+            if(!bringup)
+                return 0;
+            numSteps = 0;
+        }
+        added = AddAggregator(bringup, numSteps, a % numBuses);
+        CHECK(added, "aggregator %u not added", a);
+        numSteps += added;
+        if(!together || a == numAggs - 1) {
+            CHECK(ImgBringupRun(bringup) == NVMEDIA_STATUS_OK,
+                  "aggregator %u failed", a);
+            ImgBringupDestroy(bringup);
+            bringup = NULL;
+        }
+    }
+    CHECK(stubBus.overlaps == 0, "%d overlapping transactions",
+          stubBus.overlaps);
+
+    return GetTimeSec() - start;
+}
+
+static void
+BenchmarkStart(void)
+{
+    NvU32 numAggs, shared;
+    double sequential, scheduled;
+
+    for(shared = 0; shared < 2; shared++) {
+        for(numAggs = 1; numAggs <= NUM_BUSES; numAggs *= 2) {
+            sequential = StartAggregators(numAggs, shared ? 1 : numAggs,
+                                          NVMEDIA_FALSE);
+            scheduled = StartAggregators(numAggs, shared ? 1 : numAggs,
+                                         NVMEDIA_TRUE);
+            printf("%2u cameras, %u aggregator%s on %-10s one by one %6.0f ms, "
+                   "together %6.0f ms, x%.2f\n", numAggs * CAMERAS_PER_AGG,
+                   numAggs, numAggs > 1 ? "s" : " ",
+                   shared ? "one bus:" : "own buses:",
+                   sequential * 1e3, scheduled * 1e3, sequential / scheduled);
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    TestDependencyOrder();
+    TestRejectedGraphs();
+    TestStopAfterFailure();
+    if(argc < 2 || strcmp(argv[1], "--no-bench"))
+        BenchmarkStart();
+
+    printf("%s\n", numFailures ? "FAILED" : "PASSED");
+    return numFailures ? 1 : 0;
+}
@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION.  All rights reserved. All
+ * information contained herein is proprietary and confidential to NVIDIA
+ * Corporation.  Any use, reproduction, or disclosure without the written
+ * permission of NVIDIA Corporation is prohibited.
+ */
+
+/*
+ * Checks the driver registry against the linear table it replaced, and
+ * measures the lookup.
+ *
+ * Every built-in name, each of its prefixes and each of them followed by
+ * another character is looked up both ways.  Drivers registered at run
+ * time must not replace a registered name, must win over a shorter name
+ * they extend, and must show up in the interface queries.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "log_utils.h"
+#include "dev_list.h"
+#include "ref_max9286_9271_ov10635.h"
+#include "ref_max9286_9271_ov10640.h"
+#include "c_max9286_9271_ov10640.h"
+#include "d_max9286_9271_mt9v024.h"
+#include "ref_max9286_96705_ar0231.h"
+#include "ref_max9288_96705_ov10635.h"
+#include "m_max9288_96705_ar0140.h"
+#include "ref_max9286_96705_ar0231_rccb.h"
+#include "c_max9286_9271_ov10640lsoff.h"
+#include "ref_max9286_96705_ov2718_xc7027.h"
+#include "tpg.h"
+
+#define BENCH_LOOKUPS   2000000
+#define NAME_LENGTH     80
+
+static int numFailures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if(!(cond)) { \
+            printf("FAIL %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            numFailures++; \
+        } \
+    } while(0)
+
+/* The table ImgGetDevice() scanned before the registry, in its order */
+static ImgDevDriver *(*const legacyDevices[MAX_IMG_DEV_SUPPORTED])(void) = {
+    GetDriver_ref_max9286_9271_ov10635,
+    GetDriver_ref_max9286_9271_ov10640,
+    GetDriver_c_max9286_9271_ov10640lsoff,
+    GetDriver_c_max9286_9271_ov10640,
+    GetDriver_d_max9286_9271_mt9v024,
+    GetDriver_ref_max9286_96705_ar0231rccb,
+    GetDriver_ref_max9286_96705_ar0231,
+    GetDriver_ref_max9288_96705_ov10635,
+    GetDriver_m_max9288_96705_ar0140,
+    GetDriver_tpg,
+    GetDriver_ref_max9286_96705_ov2718_xc7027,
+};
+
+static double
+GetTimeSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static ImgDevDriver *
+LegacyGetDevice(const char *moduleName)
+{
+    ImgDevDriver *driver;
+    NvU32 i;
+
+    for(i = 0; i < MAX_IMG_DEV_SUPPORTED; i++) {
+        driver = legacyDevices[i]();
+        if(!strncmp(moduleName, driver->name, strlen(driver->name)))
+            return driver;
+    }
+
+    return NULL;
+}
+
+/* The longest registered name that starts moduleName, by brute force */
+static ImgDevDriver *
+ScanGetDevice(const char *moduleName)
+{
+    ImgDevDriverInfo drivers[MAX_IMG_DEV_REGISTERED];
+    ImgDevDriver *best = NULL;
+    size_t length, bestLength = 0;
+    NvU32 i, count;
+
+    count = ImgGetDevicesByInterface(0, drivers, MAX_IMG_DEV_REGISTERED);
+    for(i = 0; i < count && i < MAX_IMG_DEV_REGISTERED; i++) {
+        length = strlen(drivers[i].driver->name);
+        if(length >= bestLength &&
+           !strncmp(moduleName, drivers[i].driver->name, length)) {
+            best = drivers[i].driver;
+            bestLength = length;
+        }
+    }
+
+    return best;
+}
+
+static void
+CheckLookup(const char *moduleName, ImgDevDriver *expected)
+{
+    ImgDevDriver *driver = ImgGetDevice((char *)moduleName);
+
+    CHECK(driver == expected, "\"%s\" found %s, expected %s", moduleName,
+          driver ? driver->name : "nothing",
+          expected ? expected->name : "nothing");
+}
+
+static void
+TestBuiltinLookup(void)
+{
+    static const char extensions[] = "\x01 -_0129aAzZ~\x7f";
+    ImgDevDriver *driver;
+    char name[NAME_LENGTH];
+    size_t length, cut;
+    NvU32 i, e;
+
+    CHECK(ImgGetDevicesByInterface(0, NULL, 0) == MAX_IMG_DEV_SUPPORTED,
+          "%u built-in drivers", ImgGetDevicesByInterface(0, NULL, 0));
+
+    for(i = 0; i < MAX_IMG_DEV_SUPPORTED; i++) {
+        driver = legacyDevices[i]();
+        length = strlen(driver->name);
+        CheckLookup(driver->name, driver);
+
+        /* Every prefix of the name, alone and followed by one character,
+         * resolves as the old table did */
+        for(cut = 0; cut <= length; cut++) {
+            memcpy(name, driver->name, cut);
+            name[cut] = '\0';
+            CheckLookup(name, LegacyGetDevice(name));
+            for(e = 0; e < sizeof(extensions) - 1; e++) {
+                name[cut] = extensions[e];
+                name[cut + 1] = '\0';
+                CheckLookup(name, LegacyGetDevice(name));
+            }
+        }
+
+        /* Module names carry a version after the driver name */
+        snprintf(name, sizeof(name), "%s_v2.1", driver->name);
+        CheckLookup(name, LegacyGetDevice(name));
+    }
+
+    CHECK(ImgGetDevice(NULL) == NULL, "NULL module name");
+}
+
+static void
+TestInterfaces(void)
+{
+    static const struct {
+        NvU32 interfaces;
+        NvU32 count;
+    } queries[] = {
+        { IMG_DEV_IF_MAX9286,                       8 },
+        { IMG_DEV_IF_MAX9288,                       2 },
+        { IMG_DEV_IF_MAX9271,                       5 },
+        { IMG_DEV_IF_MAX96705,                      5 },
+        { IMG_DEV_IF_TPG,                           1 },
+        { IMG_DEV_IF_MAX9286 | IMG_DEV_IF_MAX96705, 3 },
+        { IMG_DEV_IF_MAX9288 | IMG_DEV_IF_MAX9271,  0 },
+        { IMG_DEV_IF_MAX9286 | IMG_DEV_IF_TPG,      0 },
+    };
+    ImgDevDriverInfo drivers[MAX_IMG_DEV_REGISTERED];
+    NvU32 q, i, count;
+
+    for(q = 0; q < sizeof(queries) / sizeof(queries[0]); q++) {
+        count = ImgGetDevicesByInterface(queries[q].interfaces, drivers,
+                                         MAX_IMG_DEV_REGISTERED);
+        CHECK(count == queries[q].count, "interfaces %#x: %u drivers",
+              queries[q].interfaces, count);
+        for(i = 0; i < count && i < MAX_IMG_DEV_REGISTERED; i++) {
+            CHECK((drivers[i].interfaces & queries[q].interfaces) ==
+                  queries[q].interfaces, "interfaces %#x: %s has %#x",
+                  queries[q].interfaces, drivers[i].driver->name,
+                  drivers[i].interfaces);
+        }
+    }
+
+    /* Drivers come in registration order, and maxDrivers only limits
+     * how many are stored */
+    count = ImgGetDevicesByInterface(IMG_DEV_IF_MAX9286 | IMG_DEV_IF_MAX96705,
+                                     drivers, 1);
+    CHECK(count == 3 &&
+          drivers[0].driver == GetDriver_ref_max9286_96705_ar0231rccb(),
+          "first of %u MAX9286/MAX96705 drivers is %s", count,
+          drivers[0].driver->name);
+
+    CHECK(ImgGetDevicesByInterface(1 << IMG_DEV_IF_BITS, drivers,
+                                   MAX_IMG_DEV_REGISTERED) == 0,
+          "unknown interface bit");
+}
+
+static void
+TestRegistration(void)
+{
+    static ImgDevDriver longer = { .name = "ref_max9286_96705_ar0231rccb_v3" };
+    static ImgDevDriver duplicate = { .name = "tpg" };
+    static ImgDevDriver first = { .name = "c_max9286_9271_ov10640" };
+    static ImgDevDriver plugin = { .name = "x_max9288_9271_foo" };
+    static ImgDevDriver empty = { .name = "" };
+    ImgDevDriverInfo drivers[MAX_IMG_DEV_REGISTERED];
+    NvU32 count;
+
+    CHECK(ImgRegisterDevice(NULL, 0) == NVMEDIA_STATUS_BAD_PARAMETER,
+          "NULL driver");
+    CHECK(ImgRegisterDevice(&empty, 0) == NVMEDIA_STATUS_BAD_PARAMETER,
+          "empty name");
+
+    /* A name is registered once, whatever the interfaces */
+    CHECK(ImgRegisterDevice(&duplicate, IMG_DEV_IF_TPG) != NVMEDIA_STATUS_OK,
+          "duplicate of a built-in name");
+    CHECK(ImgRegisterDevice(&first, IMG_DEV_IF_TPG) != NVMEDIA_STATUS_OK,
+          "duplicate of the first name in order");
+    CHECK(ImgRegisterDevice(GetDriver_tpg(), 0) != NVMEDIA_STATUS_OK,
+          "built-in driver registered twice");
+    CheckLookup("tpg", GetDriver_tpg());
+
+    CHECK(ImgRegisterDevice(&longer, IMG_DEV_IF_MAX9286 | IMG_DEV_IF_MAX96705) ==
+          NVMEDIA_STATUS_OK, "longer name");
+    CHECK(ImgRegisterDevice(&longer, IMG_DEV_IF_TPG) != NVMEDIA_STATUS_OK,
+          "registered name registered again");
+    CHECK(ImgRegisterDevice(&plugin, IMG_DEV_IF_MAX9288 | IMG_DEV_IF_MAX9271) ==
+          NVMEDIA_STATUS_OK, "new interface combination");
+
+    /* The longest name wins, older names still match what they prefix */
+    CheckLookup("ref_max9286_96705_ar0231rccb_v3", &longer);
+    CheckLookup("ref_max9286_96705_ar0231rccb_v3.1", &longer);
+    CheckLookup("ref_max9286_96705_ar0231rccb_v2",
+                GetDriver_ref_max9286_96705_ar0231rccb());
+    CheckLookup("ref_max9286_96705_ar0231_v3",
+                GetDriver_ref_max9286_96705_ar0231());
+    CheckLookup("x_max9288_9271_foo", &plugin);
+
+    CHECK(ImgGetDevicesByInterface(0, NULL, 0) == MAX_IMG_DEV_SUPPORTED + 2,
+          "%u drivers after registration", ImgGetDevicesByInterface(0, NULL, 0));
+    CHECK(ImgGetDevicesByInterface(IMG_DEV_IF_MAX9286 | IMG_DEV_IF_MAX96705,
+                                   NULL, 0) == 4, "MAX9286/MAX96705 drivers");
+    count = ImgGetDevicesByInterface(IMG_DEV_IF_MAX9288 | IMG_DEV_IF_MAX9271,
+                                     drivers, MAX_IMG_DEV_REGISTERED);
+    CHECK(count == 1 && drivers[0].driver == &plugin &&
+          drivers[0].interfaces == (IMG_DEV_IF_MAX9288 | IMG_DEV_IF_MAX9271),
+          "MAX9288/MAX9271 drivers");
+    CHECK(ImgGetDevicesByInterface(IMG_DEV_IF_TPG, NULL, 0) == 1,
+          "a rejected duplicate changed the TPG drivers");
+
+    CHECK(ImgLoadDeviceLibrary("/nonexistent/libimgdev.so") != NVMEDIA_STATUS_OK,
+          "missing library");
+}
+
+/* Fills the registry with nested names and compares every lookup with a
+ * scan of all registered names */
+static void
+TestFullRegistry(void)
+{
+    static ImgDevDriver extra[MAX_IMG_DEV_REGISTERED];
+    static char names[MAX_IMG_DEV_REGISTERED][NAME_LENGTH];
+    static ImgDevDriver overflow = { .name = "overflow" };
+    static const char *const queries[] = {
+        "nest", "nest0", "nest00000", "nest000001", "nest0000000000000000000",
+        "nest1", "nes", "ref_max9286_96705_ar0231rccb_v3aaa",
+        "ref_max9286_96705_ar0231rccb_v3aab", "ref_max9286_96705_ar0231rcc",
+        "ref_max9286_96705_ar0231rccb_v3a_v1", "tpg_aaaaaaaa", "tpga",
+    };
+    char name[NAME_LENGTH];
+    NvU32 i, depth, registered;
+
+    registered = ImgGetDevicesByInterface(0, NULL, 0);
+    for(i = 0; registered < MAX_IMG_DEV_REGISTERED; i++) {
+        depth = i / 3 + 1;
+        if(i % 3 == 0)
+            snprintf(names[i], NAME_LENGTH, "nest%0*d", depth, 0);
+        else if(i % 3 == 1)
+            snprintf(names[i], NAME_LENGTH, "ref_max9286_96705_ar0231rccb_v3%.*s",
+                     depth, "aaaaaaaaaaaaaaaaaaaaaaaaaa");
+        else
+            snprintf(names[i], NAME_LENGTH, "tpg_%.*s", depth,
+                     "aaaaaaaaaaaaaaaaaaaaaaaaaa");
+        extra[i].name = names[i];
+        CHECK(ImgRegisterDevice(&extra[i], IMG_DEV_IF_TPG) == NVMEDIA_STATUS_OK,
+              "%s not registered", names[i]);
+        registered++;
+    }
+
+    CHECK(ImgGetDevicesByInterface(0, NULL, 0) == MAX_IMG_DEV_REGISTERED,
+          "%u drivers in a full registry", ImgGetDevicesByInterface(0, NULL, 0));
+    CHECK(ImgRegisterDevice(&overflow, 0) != NVMEDIA_STATUS_OK,
+          "driver added to a full registry");
+
+    for(i = 0; i < sizeof(queries) / sizeof(queries[0]); i++)
+        CheckLookup(queries[i], ScanGetDevice(queries[i]));
+    for(i = 0; i < MAX_IMG_DEV_REGISTERED && names[i][0]; i++) {
+        CheckLookup(names[i], &extra[i]);
+        strcpy(name, names[i]);
+        name[strlen(name) - 1] = '~';
+        CheckLookup(name, ScanGetDevice(name));
+    }
+}
+
+static void
+BenchmarkLookup(const char *label)
+{
+    static const char *const moduleNames[] = {
+        "ref_max9286_96705_ov2718_xc7027",
+        "ref_max9286_9271_ov10635_v2",
+        "tpg",
+        "m_max9288_96705_ar0140",
+    };
+    volatile ImgDevDriver *sink;
+    double start, legacy, registry;
+    NvU32 i;
+
+    start = GetTimeSec();
+    for(i = 0; i < BENCH_LOOKUPS; i++)
+        sink = LegacyGetDevice(moduleNames[i & 3]);
+    legacy = GetTimeSec() - start;
+
+    start = GetTimeSec();
+    for(i = 0; i < BENCH_LOOKUPS; i++)
+        sink = ImgGetDevice((char *)moduleNames[i & 3]);
+    registry = GetTimeSec() - start;
+    (void)sink;
+
+    printf("lookup, %u drivers registered (%s): linear table %.1f ns, "
+           "registry %.1f ns\n", ImgGetDevicesByInterface(0, NULL, 0), label,
+           legacy * 1e9 / BENCH_LOOKUPS, registry * 1e9 / BENCH_LOOKUPS);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int bench = argc < 2 || strcmp(argv[1], "--no-bench");
+
+    TestBuiltinLookup();
+    TestInterfaces();
+    if(bench)
+        BenchmarkLookup("built-in");
+    TestRegistration();
+    TestFullRegistry();
+    if(bench)
+        BenchmarkLookup("full");
+
+    printf("%s\n", numFailures ? "FAILED" : "PASSED");
+    return numFailures ? 1 : 0;
+}
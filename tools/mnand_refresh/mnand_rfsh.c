@@ -21,6 +21,7 @@
 #include <stdarg.h>
 #include <syslog.h>
 #include <nvmnand.h>
+#include "rfsh_journal.h"
 
 /* common functions */
 #define max(a,b) (((a) > (b)) ? (a) : (b))
@@ -373,6 +374,80 @@ static int load_info(char *file_name, info_node **head, int num_blocks)
     return res;
 }
 
+/*
+ * Rebuild linked list from the records held in the journal ring, oldest
+ * first. The ring already limits history to the most recent entries.
+ */
+static int load_info_from_journal(rfsh_journal *journal, info_node **head)
+{
+    uint32_t i;
+    time_t date_time;
+    double rfsh_prg;
+
+    if (!head)
+        return 1;
+    free_info(head);
+    for (i = 0; i < rfsh_journal_count(journal); i++) {
+        if (rfsh_journal_get(journal, i, &date_time, &rfsh_prg) ||
+            add_info(head, date_time, rfsh_prg, 0))
+            return 1;
+    }
+    return *head ? 0 : 1;
+}
+
+/*
+ * Append to the journal the list nodes not yet persisted. *journaled holds
+ * the number of leading list nodes already in the journal.
+ */
+static int save_info(rfsh_journal *journal, info_node **head, int *journaled)
+{
+    info_node *node;
+
+    if (!head || !journaled)
+        return 1;
+    for (node = *head; node; node = node->next) {
+        if (node->index < *journaled)
+            continue;
+        if (rfsh_journal_append(journal, node->date_time, node->rfsh_progress))
+            return 1;
+        (*journaled)++;
+    }
+    return 0;
+}
+
+/*
+ * Open the persistence file as a journal. A file in the older text format
+ * is converted in place, keeping its last max_entries lines.
+ */
+static int open_journal(char *file_name, rfsh_journal *journal, int num_blocks, int max_entries)
+{
+    info_node *legacy_list = NULL;
+    info_node *node;
+    int res;
+
+    switch (rfsh_journal_open(journal, file_name, max_entries)) {
+        case RFSH_JOURNAL_OK:
+            return 0;
+        case RFSH_JOURNAL_LEGACY:
+            break;
+        default:
+            return 1;
+    }
+
+    VERBOSE_PRINTF(1, "Converting %s to journal format\n", file_name);
+    if (load_info(file_name, &legacy_list, num_blocks) == 0) {
+        for (node = legacy_list; node; node = node->next)
+            rfsh_journal_import(journal, node->date_time, node->rfsh_progress);
+    }
+    free_info(&legacy_list);
+    res = rfsh_journal_compact(journal);
+    if (res)
+        rfsh_journal_close(journal);
+    return res;
+}
+
+//#define DEBUG_DUMP_INFO
+#ifdef DEBUG_DUMP_INFO
 /* Convert linked list node to string pointed by p, up to len characters */
 static int node_to_str(info_node *node, char *p, int len)
 {
@@ -392,48 +467,6 @@ static int node_to_str(info_node *node, char *p, int len)
     return 0;
 }
 
-/*
- * Save historic linked list to file, up to max_entries. If list longer
- * than max_entries, only the list tail is saved.
- */
-static int save_info(char *file_name, info_node **head, int max_entries)
-{
-    int res = 1;
-    FILE *fp;
-    char buf[100];
-    info_node *node;
-    int total_count;
-
-    if (!head)
-        return res;
-    fp = fopen(file_name, "w");
-    if (fp == NULL)
-        return res;
-    node = *head;
-    total_count = count_info(head);
-    while (node) {
-        /*
-         * If no limit in number of nodes in file, write node.
-         * If limit is set, but total list doesn't pass it, write node.
-         * If limit set and list exceeds it, write only nodes from beginning
-         *   and end of list, skipping nodes in the center.
-         */
-        if (max_entries == 0 ||
-            total_count <= max_entries ||
-            node->index >= total_count - max_entries) {
-            if (node_to_str(node, buf, sizeof(buf)) == 0) {
-                if (fputs(buf, fp) >= 0)
-                    res = 0;
-            }
-        }
-        node = node->next;
-    }
-    fclose(fp);
-    return res;
-}
-
-//#define DEBUG_DUMP_INFO
-#ifdef DEBUG_DUMP_INFO
 /* Display linked list info (debug) */
 static void dump_info(info_node **head)
 {
@@ -581,6 +614,8 @@ int main(int argc, char **argv)
     MNAND_STATUS mnand_status;
     mnand_chip chip;
     info_node *info_list = NULL;
+    rfsh_journal journal = { .fd = -1, };
+    int journaled = 0;
     int mnand_bound = 0;
     int mnand_fd = -1;
     int res = 1;
@@ -789,13 +824,19 @@ int main(int argc, char **argv)
         }
     }
 
+    if (open_journal(file_path, &journal, blk_count, MAX_LINES_IN_FILE)) {
+        VERBOSE_PRINTF(0, "Failed to open persistent data %s\n", file_path);
+        goto exit_out;
+    }
+
 recalc:
 
     clock_gettime(CLOCK_MONOTONIC, &ts);
     cur_time = start_time + (ts.tv_sec - base_time); /* Getting the cur_time */
 
-    /* Try to load info from existing file */
-    if (load_info(file_path, &info_list, blk_count)) {
+    /* Load info recovered from the journal */
+    journaled = rfsh_journal_count(&journal);
+    if (load_info_from_journal(&journal, &info_list)) {
         VERBOSE_PRINTF(0, "Could not find valid stored info.\n");
         valid_stored_info = 0;
         if (catchup_mode) {
@@ -860,7 +901,7 @@ recalc:
             res = refresh_loop(&chip, rfsh_delay, 0, desired_progress);
         }
         if ((s_stop == 0) && (res >= 0)) {
-            res = save_info(file_path, &info_list, MAX_LINES_IN_FILE);
+            res = save_info(&journal, &info_list, &journaled);
             if (res) {
                 printf("Failed to save persistent data\n");
                 goto exit_out;
@@ -897,7 +938,7 @@ recalc:
     dump_info(&info_list);
 
     /* Update file content (if valid date was provided) */
-    res = save_info(file_path, &info_list, MAX_LINES_IN_FILE);
+    res = save_info(&journal, &info_list, &journaled);
     if (res) {
         VERBOSE_PRINTF(0, "Failed to save persistent data\n");
         goto exit_out;
@@ -916,6 +957,8 @@ exit_out:
     if (info_list)
         free_info(&info_list);
 
+    rfsh_journal_close(&journal);
+
     if (catchup_mode) {
         int fd = -1;
 
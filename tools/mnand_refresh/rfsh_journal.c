@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/stat.h>
+#include "rfsh_journal.h"
+
+#define RECOVERY_CHUNK_RECORDS 256
+
+static uint32_t s_crc_table[256];
+static int s_crc_table_ready = 0;
+
+static void crc32_init(void)
+{
+    uint32_t c;
+    int i, k;
+
+    for (i = 0; i < 256; i++) {
+        c = (uint32_t)i;
+        for (k = 0; k < 8; k++)
+            c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+        s_crc_table[i] = c;
+    }
+    s_crc_table_ready = 1;
+}
+
+static uint32_t crc32(const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    uint32_t c = 0xffffffff;
+
+    if (!s_crc_table_ready)
+        crc32_init();
+    while (len--)
+        c = s_crc_table[(c ^ *p++) & 0xff] ^ (c >> 8);
+    return c ^ 0xffffffff;
+}
+
+static void fill_hdr(rfsh_journal_hdr *hdr)
+{
+    hdr->magic = RFSH_JOURNAL_MAGIC;
+    hdr->version = RFSH_JOURNAL_VERSION;
+    hdr->rec_size = sizeof(rfsh_journal_rec);
+    hdr->crc = crc32(hdr, offsetof(rfsh_journal_hdr, crc));
+}
+
+static int hdr_is_valid(rfsh_journal_hdr *hdr)
+{
+    return hdr->magic == RFSH_JOURNAL_MAGIC &&
+        hdr->version == RFSH_JOURNAL_VERSION &&
+        hdr->rec_size == sizeof(rfsh_journal_rec) &&
+        hdr->crc == crc32(hdr, offsetof(rfsh_journal_hdr, crc));
+}
+
+static void fill_rec(rfsh_journal_rec *rec, uint32_t seq, time_t date_time, double rfsh_progress)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->magic = RFSH_JOURNAL_REC_MAGIC;
+    rec->seq = seq;
+    rec->date_time = (int64_t)date_time;
+    rec->rfsh_progress = rfsh_progress;
+    rec->crc = crc32(rec, offsetof(rfsh_journal_rec, crc));
+}
+
+static int rec_is_valid(rfsh_journal_rec *rec)
+{
+    return rec->magic == RFSH_JOURNAL_REC_MAGIC &&
+        rec->crc == crc32(rec, offsetof(rfsh_journal_rec, crc));
+}
+
+static off_t rec_offset(uint32_t index)
+{
+    return (off_t)sizeof(rfsh_journal_hdr) + (off_t)index * sizeof(rfsh_journal_rec);
+}
+
+static void ring_push(rfsh_journal *j, rfsh_journal_rec *rec)
+{
+    uint32_t slot;
+
+    if (j->ring_count < j->ring_size) {
+        slot = (j->ring_head + j->ring_count) % j->ring_size;
+        j->ring_count++;
+    } else {
+        /* ring full, overwrite the oldest record */
+        slot = j->ring_head;
+        j->ring_head = (j->ring_head + 1) % j->ring_size;
+    }
+    j->ring[slot] = *rec;
+}
+
+/* Make a rename() in the journal directory durable */
+static void sync_dir(const char *path)
+{
+    char *path_copy;
+    int fd;
+
+    path_copy = strdup(path);
+    if (!path_copy)
+        return;
+    fd = open(dirname(path_copy), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    free(path_copy);
+}
+
+/*
+ * Scan records following the header, stopping at the first record that is
+ * short, fails its CRC or breaks the sequence. Everything past that point
+ * is the remainder of an interrupted append and gets truncated.
+ */
+static int recover(rfsh_journal *j)
+{
+    rfsh_journal_rec *buf;
+    ssize_t len;
+    uint32_t index = 0;
+    uint32_t n, i;
+    int first = 1;
+    int done = 0;
+
+    buf = malloc(RECOVERY_CHUNK_RECORDS * sizeof(rfsh_journal_rec));
+    if (!buf)
+        return 1;
+
+    while (!done) {
+        len = pread(j->fd, buf, RECOVERY_CHUNK_RECORDS * sizeof(rfsh_journal_rec),
+            rec_offset(index));
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            free(buf);
+            return 1;
+        }
+        n = len / sizeof(rfsh_journal_rec);
+        if (n < RECOVERY_CHUNK_RECORDS)
+            done = 1;
+        for (i = 0; i < n; i++) {
+            if (!rec_is_valid(&buf[i]) || (!first && buf[i].seq != j->next_seq)) {
+                done = 1;
+                break;
+            }
+            first = 0;
+            j->next_seq = buf[i].seq + 1;
+            ring_push(j, &buf[i]);
+            index++;
+        }
+    }
+    free(buf);
+
+    j->file_records = index;
+    if (ftruncate(j->fd, rec_offset(index)) != 0)
+        return 1;
+    return 0;
+}
+
+rfsh_journal_status rfsh_journal_open(rfsh_journal *j, const char *path, uint32_t ring_size)
+{
+    rfsh_journal_hdr hdr;
+    struct stat st;
+    ssize_t len;
+
+    if (!j || !path || ring_size == 0)
+        return RFSH_JOURNAL_ERROR;
+    memset(j, 0, sizeof(*j));
+    j->fd = -1;
+    j->ring_size = ring_size;
+    j->ring = calloc(ring_size, sizeof(rfsh_journal_rec));
+    j->path = strdup(path);
+    if (!j->ring || !j->path)
+        goto fail;
+
+    j->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (j->fd < 0)
+        goto fail;
+    if (fstat(j->fd, &st) != 0)
+        goto fail;
+
+    if (st.st_size == 0) {
+        /* fresh journal */
+        fill_hdr(&hdr);
+        if (pwrite(j->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || fdatasync(j->fd) != 0)
+            goto fail;
+        return RFSH_JOURNAL_OK;
+    }
+
+    len = pread(j->fd, &hdr, sizeof(hdr), 0);
+    if (len != sizeof(hdr) || !hdr_is_valid(&hdr)) {
+        /* leave foreign content alone, caller decides whether to migrate it */
+        close(j->fd);
+        j->fd = -1;
+        return RFSH_JOURNAL_LEGACY;
+    }
+
+    if (recover(j))
+        goto fail;
+    return RFSH_JOURNAL_OK;
+
+fail:
+    rfsh_journal_close(j);
+    return RFSH_JOURNAL_ERROR;
+}
+
+void rfsh_journal_close(rfsh_journal *j)
+{
+    if (!j)
+        return;
+    if (j->fd >= 0)
+        close(j->fd);
+    j->fd = -1;
+    free(j->ring);
+    j->ring = NULL;
+    free(j->path);
+    j->path = NULL;
+    j->ring_count = 0;
+    j->ring_head = 0;
+}
+
+void rfsh_journal_import(rfsh_journal *j, time_t date_time, double rfsh_progress)
+{
+    rfsh_journal_rec rec;
+
+    fill_rec(&rec, j->next_seq++, date_time, rfsh_progress);
+    ring_push(j, &rec);
+}
+
+int rfsh_journal_append(rfsh_journal *j, time_t date_time, double rfsh_progress)
+{
+    rfsh_journal_rec rec;
+
+    if (!j || j->fd < 0)
+        return 1;
+
+    fill_rec(&rec, j->next_seq, date_time, rfsh_progress);
+    if (pwrite(j->fd, &rec, sizeof(rec), rec_offset(j->file_records)) != sizeof(rec))
+        return 1;
+    if (fdatasync(j->fd) != 0)
+        return 1;
+
+    j->next_seq++;
+    j->file_records++;
+    ring_push(j, &rec);
+
+    /*
+     * The record is durable at this point; a failed compaction only means
+     * the file keeps growing until the next attempt.
+     */
+    if (j->file_records >= j->ring_size * RFSH_JOURNAL_COMPACT_RATIO)
+        rfsh_journal_compact(j);
+    return 0;
+}
+
+int rfsh_journal_compact(rfsh_journal *j)
+{
+    rfsh_journal_hdr hdr;
+    uint8_t *buf;
+    char *tmp_path;
+    size_t len;
+    uint32_t i;
+    int fd;
+    int res = 1;
+
+    if (!j || !j->path)
+        return 1;
+
+    tmp_path = malloc(strlen(j->path) + 5);
+    len = sizeof(hdr) + j->ring_count * sizeof(rfsh_journal_rec);
+    buf = malloc(len);
+    if (!tmp_path || !buf)
+        goto out;
+    sprintf(tmp_path, "%s.tmp", j->path);
+
+    /* header and all ring records go out in a single write */
+    fill_hdr(&hdr);
+    memcpy(buf, &hdr, sizeof(hdr));
+    for (i = 0; i < j->ring_count; i++)
+        memcpy(buf + rec_offset(i), &j->ring[(j->ring_head + i) % j->ring_size],
+            sizeof(rfsh_journal_rec));
+
+    fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        goto out;
+    if (pwrite(fd, buf, len, 0) != (ssize_t)len || fsync(fd) != 0) {
+        close(fd);
+        unlink(tmp_path);
+        goto out;
+    }
+    if (rename(tmp_path, j->path) != 0) {
+        close(fd);
+        unlink(tmp_path);
+        goto out;
+    }
+    sync_dir(j->path);
+
+    if (j->fd >= 0)
+        close(j->fd);
+    j->fd = fd;
+    j->file_records = j->ring_count;
+    res = 0;
+
+out:
+    free(buf);
+    free(tmp_path);
+    return res;
+}
+
+uint32_t rfsh_journal_count(rfsh_journal *j)
+{
+    return j ? j->ring_count : 0;
+}
+
+int rfsh_journal_get(rfsh_journal *j, uint32_t i, time_t *date_time, double *rfsh_progress)
+{
+    rfsh_journal_rec *rec;
+
+    if (!j || i >= j->ring_count)
+        return 1;
+    rec = &j->ring[(j->ring_head + i) % j->ring_size];
+    if (date_time)
+        *date_time = (time_t)rec->date_time;
+    if (rfsh_progress)
+        *rfsh_progress = rec->rfsh_progress;
+    return 0;
+}
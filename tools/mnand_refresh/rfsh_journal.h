@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+#ifndef __RFSH_JOURNAL_H_INCLUDED
+#define __RFSH_JOURNAL_H_INCLUDED
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Append-only refresh history journal.
+ *
+ * The file is a fixed header followed by fixed-size records. Each record
+ * carries a sequence number and a CRC32, so that after a power loss the
+ * journal is recovered by scanning up to the last valid record. Only the
+ * most recent ring_size records are kept in memory; the file is compacted
+ * down to those once it grows past RFSH_JOURNAL_COMPACT_RATIO times that.
+ */
+
+#define RFSH_JOURNAL_MAGIC          0x4a46524d /* "MRFJ" */
+#define RFSH_JOURNAL_REC_MAGIC      0x4352464d /* "MFRC" */
+#define RFSH_JOURNAL_VERSION        1
+#define RFSH_JOURNAL_COMPACT_RATIO  4
+
+typedef enum {
+    RFSH_JOURNAL_OK = 0,
+    RFSH_JOURNAL_ERROR,
+    RFSH_JOURNAL_LEGACY, /* file exists but is not a journal */
+} rfsh_journal_status;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t rec_size;
+    uint32_t crc;
+} rfsh_journal_hdr;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    int64_t date_time;
+    double rfsh_progress;
+    uint32_t reserved;
+    uint32_t crc; /* covers all preceding fields */
+} rfsh_journal_rec;
+
+typedef struct {
+    int fd;
+    char *path;
+    uint32_t next_seq;
+    uint32_t file_records;  /* valid records currently in the file */
+    uint32_t ring_size;
+    uint32_t ring_head;     /* slot of the oldest record */
+    uint32_t ring_count;
+    rfsh_journal_rec *ring;
+} rfsh_journal;
+
+/*
+ * Open (or create) the journal at path and recover its content into the
+ * ring. A torn tail left by a power loss is truncated away.
+ * Returns RFSH_JOURNAL_LEGACY without modifying the file if it holds data
+ * in another format; the journal is then empty and can be populated with
+ * rfsh_journal_import() followed by rfsh_journal_compact().
+ */
+rfsh_journal_status rfsh_journal_open(rfsh_journal *j, const char *path, uint32_t ring_size);
+void rfsh_journal_close(rfsh_journal *j);
+
+/* Append one record with a single pwrite + fdatasync. Returns 0 on success. */
+int rfsh_journal_append(rfsh_journal *j, time_t date_time, double rfsh_progress);
+
+/* Add a record to the in-memory ring only (no I/O). */
+void rfsh_journal_import(rfsh_journal *j, time_t date_time, double rfsh_progress);
+
+/* Atomically rewrite the file with the ring content. Returns 0 on success. */
+int rfsh_journal_compact(rfsh_journal *j);
+
+/* Number of records in the ring, and access to them (0 is the oldest). */
+uint32_t rfsh_journal_count(rfsh_journal *j);
+int rfsh_journal_get(rfsh_journal *j, uint32_t i, time_t *date_time, double *rfsh_progress);
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+/*
+ * Crash-injection test and append benchmark for the refresh journal.
+ *
+ * A journal is written, then cut at every byte offset as a power loss in
+ * the middle of an append would leave it. Each cut copy must recover
+ * exactly the records that were completely on disk, and be truncated back
+ * to a record boundary.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "rfsh_journal.h"
+
+#define TEST_RECORDS    16
+#define BENCH_RECORDS   1000
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __func__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            s_failures++; \
+        } \
+    } while (0)
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int read_file(const char *path, uint8_t **data, size_t *len)
+{
+    struct stat st;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 1;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 1;
+    }
+    *len = st.st_size;
+    *data = malloc(*len ? *len : 1);
+    if (!*data || read(fd, *data, *len) != (ssize_t)*len) {
+        close(fd);
+        return 1;
+    }
+    close(fd);
+    return 0;
+}
+
+static int write_file(const char *path, const uint8_t *data, size_t len)
+{
+    int fd;
+    int res = 0;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return 1;
+    if (write(fd, data, len) != (ssize_t)len)
+        res = 1;
+    close(fd);
+    return res;
+}
+
+static off_t file_size(const char *path)
+{
+    struct stat st;
+
+    return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
+/* Records written by make_journal(): record i holds (1000 + i, i / 4.0) */
+static int make_journal(const char *path, uint32_t records)
+{
+    rfsh_journal j;
+    uint32_t i;
+
+    unlink(path);
+    if (rfsh_journal_open(&j, path, records) != RFSH_JOURNAL_OK)
+        return 1;
+    for (i = 0; i < records; i++) {
+        if (rfsh_journal_append(&j, 1000 + i, i / 4.0)) {
+            rfsh_journal_close(&j);
+            return 1;
+        }
+    }
+    rfsh_journal_close(&j);
+    return 0;
+}
+
+static void check_records(rfsh_journal *j, uint32_t expected, size_t cut)
+{
+    time_t date_time;
+    double progress;
+    uint32_t i;
+
+    CHECK(rfsh_journal_count(j) == expected, "cut at %zu: %u records, expected %u",
+        cut, rfsh_journal_count(j), expected);
+    for (i = 0; i < rfsh_journal_count(j) && i < expected; i++) {
+        rfsh_journal_get(j, i, &date_time, &progress);
+        CHECK(date_time == (time_t)(1000 + i) && progress == i / 4.0,
+            "cut at %zu: record %u holds (%ld, %f)", cut, i, (long)date_time, progress);
+    }
+}
+
+static void test_truncate_every_offset(const char *dir)
+{
+    char path[256], cut_path[256];
+    const size_t hdr = sizeof(rfsh_journal_hdr);
+    const size_t rec = sizeof(rfsh_journal_rec);
+    rfsh_journal j;
+    rfsh_journal_status status;
+    uint8_t *data;
+    size_t len, cut;
+    uint32_t whole;
+
+    snprintf(path, sizeof(path), "%s/journal", dir);
+    snprintf(cut_path, sizeof(cut_path), "%s/journal.cut", dir);
+    if (make_journal(path, TEST_RECORDS) || read_file(path, &data, &len)) {
+        CHECK(0, "cannot create journal");
+        return;
+    }
+    CHECK(len == hdr + TEST_RECORDS * rec, "journal is %zu bytes", len);
+
+    for (cut = 0; cut <= len; cut++) {
+        write_file(cut_path, data, cut);
+        status = rfsh_journal_open(&j, cut_path, TEST_RECORDS);
+
+        if (cut == 0) {
+            /* an empty file is a fresh journal */
+            CHECK(status == RFSH_JOURNAL_OK, "cut at 0: status %d", status);
+            check_records(&j, 0, cut);
+        } else if (cut < hdr) {
+            /* a torn header is not recognized; the file is left alone */
+            CHECK(status == RFSH_JOURNAL_LEGACY, "cut at %zu: status %d", cut, status);
+            CHECK(file_size(cut_path) == (off_t)cut, "cut at %zu: file modified", cut);
+        } else {
+            whole = (cut - hdr) / rec;
+            CHECK(status == RFSH_JOURNAL_OK, "cut at %zu: status %d", cut, status);
+            check_records(&j, whole, cut);
+            CHECK(file_size(cut_path) == (off_t)(hdr + whole * rec),
+                "cut at %zu: file is %ld bytes after recovery", cut, (long)file_size(cut_path));
+
+            /* the recovered journal must take new records after the cut */
+            CHECK(rfsh_journal_append(&j, 1000 + whole, whole / 4.0) == 0,
+                "cut at %zu: append failed", cut);
+            rfsh_journal_close(&j);
+            status = rfsh_journal_open(&j, cut_path, TEST_RECORDS + 1);
+            check_records(&j, whole + 1, cut);
+        }
+        rfsh_journal_close(&j);
+    }
+
+    free(data);
+    unlink(cut_path);
+    unlink(path);
+}
+
+/* A record whose bytes are all present but corrupted ends the journal */
+static void test_corrupt_tail(const char *dir)
+{
+    char path[256];
+    const size_t hdr = sizeof(rfsh_journal_hdr);
+    const size_t rec = sizeof(rfsh_journal_rec);
+    rfsh_journal j;
+    uint8_t *data;
+    size_t len;
+
+    snprintf(path, sizeof(path), "%s/journal", dir);
+    if (make_journal(path, TEST_RECORDS) || read_file(path, &data, &len)) {
+        CHECK(0, "cannot create journal");
+        return;
+    }
+
+    data[hdr + (TEST_RECORDS - 2) * rec + 12] ^= 0x01;
+    write_file(path, data, len);
+    CHECK(rfsh_journal_open(&j, path, TEST_RECORDS) == RFSH_JOURNAL_OK, "open failed");
+    check_records(&j, TEST_RECORDS - 2, len);
+    rfsh_journal_close(&j);
+
+    free(data);
+    unlink(path);
+}
+
+static void bench_append(const char *dir)
+{
+    char path[256];
+    rfsh_journal j;
+    double start, elapsed;
+    uint32_t i;
+
+    snprintf(path, sizeof(path), "%s/journal", dir);
+    unlink(path);
+    if (rfsh_journal_open(&j, path, BENCH_RECORDS / RFSH_JOURNAL_COMPACT_RATIO / 2)
+            != RFSH_JOURNAL_OK) {
+        CHECK(0, "cannot create journal");
+        return;
+    }
+
+    start = now();
+    for (i = 0; i < BENCH_RECORDS; i++)
+        rfsh_journal_append(&j, 1000 + i, i / 4.0);
+    elapsed = now() - start;
+    rfsh_journal_close(&j);
+    unlink(path);
+
+    printf("append: %u records in %.1f ms, %.1f us per record (incl. fdatasync, compaction)\n",
+        BENCH_RECORDS, elapsed * 1e3, elapsed * 1e6 / BENCH_RECORDS);
+}
+
+int main(int argc, char **argv)
+{
+    char dir[] = "/tmp/rfsh_journal_test.XXXXXX";
+
+    if (!mkdtemp(dir)) {
+        printf("cannot create a temporary directory\n");
+        return 1;
+    }
+
+    test_truncate_every_offset(dir);
+    test_corrupt_tail(dir);
+    if (argc < 2 || strcmp(argv[1], "--no-bench"))
+        bench_append(dir);
+
+    rmdir(dir);
+    printf("%s\n", s_failures ? "FAILED" : "PASSED");
+    return s_failures ? 1 : 0;
+}
@@ -109,6 +109,10 @@ struct wlContextCommon {
 	struct wl_surface		*pointer_surface;
 	enum   cursor_type		current_cursor;
 	uint32_t			enter_serial;
+
+	const char			**preloaded_paths;
+	cairo_surface_t			**preloaded_images;
+	int				preloaded_count;
 };
 
 struct wlContextStruct {
@@ -928,12 +932,93 @@ create_ivisurface(struct wlContextStruct *p_wlCtx,
 	drawImage(p_wlCtx);
 }
 
+static void
+preload_add(const char **paths, int *count, const char *path)
+{
+	int i;
+
+	if (path == NULL)
+		return;
+	for (i = 0; i < *count; i++)
+		if (strcmp(paths[i], path) == 0)
+			return;
+
+	paths[(*count)++] = path;
+}
+
+/**
+ * Decodes all images the widgets use at once, on several threads,
+ * instead of one after the other as each widget is created
+ */
+static void
+preload_images(struct wlContextCommon *cmm)
+{
+	struct hmi_homescreen_setting *setting = cmm->hmi_setting;
+	struct hmi_homescreen_launcher *launcher;
+	const char **paths;
+	int count = 0;
+
+	paths = xzalloc((7 + wl_list_length(&setting->launcher_list)) *
+			sizeof(*paths));
+
+	if (strcmp(setting->background_type, "image") == 0)
+		preload_add(paths, &count, setting->background.filePath);
+
+	if (setting->use_panel_flag) {
+		preload_add(paths, &count, setting->panel.filePath);
+		preload_add(paths, &count, setting->tiling.filePath);
+		preload_add(paths, &count, setting->sidebyside.filePath);
+		preload_add(paths, &count, setting->fullscreen.filePath);
+		preload_add(paths, &count, setting->random.filePath);
+		preload_add(paths, &count, setting->home.filePath);
+
+		wl_list_for_each(launcher, &setting->launcher_list, link)
+			preload_add(paths, &count, launcher->icon);
+	}
+
+	cmm->preloaded_paths = paths;
+	cmm->preloaded_images = xzalloc((count + 1) *
+					sizeof(cairo_surface_t *));
+	cmm->preloaded_count = count;
+	load_cairo_surfaces(paths, cmm->preloaded_images, count);
+}
+
+static void
+release_preloaded_images(struct wlContextCommon *cmm)
+{
+	int i;
+
+	for (i = 0; i < cmm->preloaded_count; i++)
+		if (cmm->preloaded_images[i])
+			cairo_surface_destroy(cmm->preloaded_images[i]);
+
+	free(cmm->preloaded_paths);
+	free(cmm->preloaded_images);
+	cmm->preloaded_paths = NULL;
+	cmm->preloaded_images = NULL;
+	cmm->preloaded_count = 0;
+}
+
+static cairo_surface_t *
+load_preloaded_image(struct wlContextCommon *cmm, const char *imageFile)
+{
+	int i;
+
+	for (i = 0; i < cmm->preloaded_count; i++)
+		if (cmm->preloaded_images[i] &&
+		    strcmp(cmm->preloaded_paths[i], imageFile) == 0)
+			return cairo_surface_reference(cmm->preloaded_images[i]);
+
+	return load_cairo_surface(imageFile);
+}
+
 static void
 create_ivisurfaceFromFile(struct wlContextStruct *p_wlCtx,
 			  uint32_t id_surface,
 			  const char *imageFile)
 {
-	cairo_surface_t *surface = load_cairo_surface(imageFile);
+	cairo_surface_t *surface = load_preloaded_image(p_wlCtx->cmm,
+							 imageFile);
 
 	if (NULL == surface) {
 		fprintf(stderr, "Failed to load_cairo_surface %s\n", imageFile);
@@ -1281,6 +1366,8 @@ int main(int argc, char **argv)
 	wlCtx_HomeButton.cmm = &wlCtxCommon;
 	wlCtx_WorkSpaceBackGround.cmm = &wlCtxCommon;
 
+	preload_images(&wlCtxCommon);
+
 	/* create desktop widgets */
 	/*
 	 * If the background-type is set to none.
@@ -1325,6 +1412,8 @@ int main(int argc, char **argv)
 				   hmi_setting->home.filePath);
 	}
 
+	release_preloaded_images(&wlCtxCommon);
+
 	UI_ready(wlCtxCommon.hmiCtrl);
 
 	while (ret != -1)
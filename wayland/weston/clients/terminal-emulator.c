@@ -0,0 +1,1901 @@
+/*
+ * Copyright © 2008 Kristian Høgsberg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <wchar.h>
+
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+#include "terminal-emulator.h"
+
+static void
+init_state_machine(struct utf8_state_machine *machine)
+{
+	machine->state = utf8state_start;
+	machine->len = 0;
+	machine->s.ch = 0;
+}
+
+static enum utf8_state
+utf8_next_char(struct utf8_state_machine *machine, unsigned char c)
+{
+	switch(machine->state) {
+	case utf8state_start:
+	case utf8state_accept:
+	case utf8state_reject:
+		machine->s.ch = 0;
+		machine->len = 0;
+		if (c == 0xC0 || c == 0xC1) {
+			/* overlong encoding, reject */
+			machine->state = utf8state_reject;
+		} else if ((c & 0x80) == 0) {
+			/* single byte, accept */
+			machine->s.byte[machine->len++] = c;
+			machine->state = utf8state_accept;
+			machine->unicode = c;
+		} else if ((c & 0xC0) == 0x80) {
+			/* parser out of sync, ignore byte */
+			machine->state = utf8state_start;
+		} else if ((c & 0xE0) == 0xC0) {
+			/* start of two byte sequence */
+			machine->s.byte[machine->len++] = c;
+			machine->state = utf8state_expect1;
+			machine->unicode = c & 0x1f;
+		} else if ((c & 0xF0) == 0xE0) {
+			/* start of three byte sequence */
+			machine->s.byte[machine->len++] = c;
+			machine->state = utf8state_expect2;
+			machine->unicode = c & 0x0f;
+		} else if ((c & 0xF8) == 0xF0) {
+			/* start of four byte sequence */
+			machine->s.byte[machine->len++] = c;
+			machine->state = utf8state_expect3;
+			machine->unicode = c & 0x07;
+		} else {
+			/* overlong encoding, reject */
+			machine->state = utf8state_reject;
+		}
+		break;
+	case utf8state_expect3:
+		machine->s.byte[machine->len++] = c;
+		machine->unicode = (machine->unicode << 6) | (c & 0x3f);
+		if ((c & 0xC0) == 0x80) {
+			/* all good, continue */
+			machine->state = utf8state_expect2;
+		} else {
+			/* missing extra byte, reject */
+			machine->state = utf8state_reject;
+		}
+		break;
+	case utf8state_expect2:
+		machine->s.byte[machine->len++] = c;
+		machine->unicode = (machine->unicode << 6) | (c & 0x3f);
+		if ((c & 0xC0) == 0x80) {
+			/* all good, continue */
+			machine->state = utf8state_expect1;
+		} else {
+			/* missing extra byte, reject */
+			machine->state = utf8state_reject;
+		}
+		break;
+	case utf8state_expect1:
+		machine->s.byte[machine->len++] = c;
+		machine->unicode = (machine->unicode << 6) | (c & 0x3f);
+		if ((c & 0xC0) == 0x80) {
+			/* all good, accept */
+			machine->state = utf8state_accept;
+		} else {
+			/* missing extra byte, reject */
+			machine->state = utf8state_reject;
+		}
+		break;
+	default:
+		machine->state = utf8state_reject;
+		break;
+	}
+
+	return machine->state;
+}
+
+static uint32_t
+get_unicode(union utf8_char utf8)
+{
+	struct utf8_state_machine machine;
+	int i;
+
+	init_state_machine(&machine);
+	for (i = 0; i < 4; i++) {
+		utf8_next_char(&machine, utf8.byte[i]);
+		if (machine.state == utf8state_accept ||
+		    machine.state == utf8state_reject)
+			break;
+	}
+
+	if (machine.state == utf8state_reject)
+		return 0xfffd;
+
+	return machine.unicode;
+}
+
+bool
+is_wide(union utf8_char utf8)
+{
+	uint32_t unichar;
+
+	if (utf8.byte[0] < 0x80)
+		return false;
+
+	unichar = get_unicode(utf8);
+	return wcwidth(unichar) > 1;
+}
+
+struct char_sub CS_US[] = {
+	{{{0, }}, {{0, }}}
+};
+static struct char_sub CS_UK[] = {
+	{{{'#', 0, }}, {{0xC2, 0xA3, 0, }}}, /* POUND: £ */
+	{{{0, }}, {{0, }}}
+};
+static struct char_sub CS_SPECIAL[] = {
+	{{{'`', 0, }}, {{0xE2, 0x99, 0xA6, 0}}}, /* diamond: ♦ */
+	{{{'a', 0, }}, {{0xE2, 0x96, 0x92, 0}}}, /* 50% cell: ▒ */
+	{{{'b', 0, }}, {{0xE2, 0x90, 0x89, 0}}}, /* HT: ␉ */
+	{{{'c', 0, }}, {{0xE2, 0x90, 0x8C, 0}}}, /* FF: ␌ */
+	{{{'d', 0, }}, {{0xE2, 0x90, 0x8D, 0}}}, /* CR: ␍ */
+	{{{'e', 0, }}, {{0xE2, 0x90, 0x8A, 0}}}, /* LF: ␊ */
+	{{{'f', 0, }}, {{0xC2, 0xB0, 0, }}}, /* Degree: ° */
+	{{{'g', 0, }}, {{0xC2, 0xB1, 0, }}}, /* Plus/Minus: ± */
+	{{{'h', 0, }}, {{0xE2, 0x90, 0xA4, 0}}}, /* NL: ␤ */
+	{{{'i', 0, }}, {{0xE2, 0x90, 0x8B, 0}}}, /* VT: ␋ */
+	{{{'j', 0, }}, {{0xE2, 0x94, 0x98, 0}}}, /* CN_RB: ┘ */
+	{{{'k', 0, }}, {{0xE2, 0x94, 0x90, 0}}}, /* CN_RT: ┐ */
+	{{{'l', 0, }}, {{0xE2, 0x94, 0x8C, 0}}}, /* CN_LT: ┌ */
+	{{{'m', 0, }}, {{0xE2, 0x94, 0x94, 0}}}, /* CN_LB: └ */
+	{{{'n', 0, }}, {{0xE2, 0x94, 0xBC, 0}}}, /* CROSS: ┼ */
+	{{{'o', 0, }}, {{0xE2, 0x8E, 0xBA, 0}}}, /* Horiz. Scan Line 1: ⎺ */
+	{{{'p', 0, }}, {{0xE2, 0x8E, 0xBB, 0}}}, /* Horiz. Scan Line 3: ⎻ */
+	{{{'q', 0, }}, {{0xE2, 0x94, 0x80, 0}}}, /* Horiz. Scan Line 5: ─ */
+	{{{'r', 0, }}, {{0xE2, 0x8E, 0xBC, 0}}}, /* Horiz. Scan Line 7: ⎼ */
+	{{{'s', 0, }}, {{0xE2, 0x8E, 0xBD, 0}}}, /* Horiz. Scan Line 9: ⎽ */
+	{{{'t', 0, }}, {{0xE2, 0x94, 0x9C, 0}}}, /* TR: ├ */
+	{{{'u', 0, }}, {{0xE2, 0x94, 0xA4, 0}}}, /* TL: ┤ */
+	{{{'v', 0, }}, {{0xE2, 0x94, 0xB4, 0}}}, /* TU: ┴ */
+	{{{'w', 0, }}, {{0xE2, 0x94, 0xAC, 0}}}, /* TD: ┬ */
+	{{{'x', 0, }}, {{0xE2, 0x94, 0x82, 0}}}, /* V: │ */
+	{{{'y', 0, }}, {{0xE2, 0x89, 0xA4, 0}}}, /* LE: ≤ */
+	{{{'z', 0, }}, {{0xE2, 0x89, 0xA5, 0}}}, /* GE: ≥ */
+	{{{'{', 0, }}, {{0xCF, 0x80, 0, }}}, /* PI: π */
+	{{{'|', 0, }}, {{0xE2, 0x89, 0xA0, 0}}}, /* NEQ: ≠ */
+	{{{'}', 0, }}, {{0xC2, 0xA3, 0, }}}, /* POUND: £ */
+	{{{'~', 0, }}, {{0xE2, 0x8B, 0x85, 0}}}, /* DOT: ⋅ */
+	{{{0, }}, {{0, }}}
+};
+
+static void
+apply_char_set(character_set cs, union utf8_char *utf8)
+{
+	int i = 0;
+
+	while (cs[i].match.byte[0]) {
+		if ((*utf8).ch == cs[i].match.ch) {
+			*utf8 = cs[i].replace;
+			break;
+		}
+		i++;
+	}
+}
+
+struct key_map KM_NORMAL[] = {
+	{ XKB_KEY_Left,  1, '[', 'D' },
+	{ XKB_KEY_Right, 1, '[', 'C' },
+	{ XKB_KEY_Up,    1, '[', 'A' },
+	{ XKB_KEY_Down,  1, '[', 'B' },
+	{ XKB_KEY_Home,  1, '[', 'H' },
+	{ XKB_KEY_End,   1, '[', 'F' },
+	{ 0, 0, 0, 0 }
+};
+struct key_map KM_APPLICATION[] = {
+	{ XKB_KEY_Left,          1, 'O', 'D' },
+	{ XKB_KEY_Right,         1, 'O', 'C' },
+	{ XKB_KEY_Up,            1, 'O', 'A' },
+	{ XKB_KEY_Down,          1, 'O', 'B' },
+	{ XKB_KEY_Home,          1, 'O', 'H' },
+	{ XKB_KEY_End,           1, 'O', 'F' },
+	{ XKB_KEY_KP_Enter,      1, 'O', 'M' },
+	{ XKB_KEY_KP_Multiply,   1, 'O', 'j' },
+	{ XKB_KEY_KP_Add,        1, 'O', 'k' },
+	{ XKB_KEY_KP_Separator,  1, 'O', 'l' },
+	{ XKB_KEY_KP_Subtract,   1, 'O', 'm' },
+	{ XKB_KEY_KP_Divide,     1, 'O', 'o' },
+	{ 0, 0, 0, 0 }
+};
+
+static void
+attr_init(struct attr *data_attr, struct attr attr, int n)
+{
+	int i;
+	for (i = 0; i < n; i++) {
+		data_attr[i] = attr;
+	}
+}
+
+#define ESC_FLAG_WHAT	0x01
+#define ESC_FLAG_GT	0x02
+#define ESC_FLAG_BANG	0x04
+#define ESC_FLAG_CASH	0x08
+#define ESC_FLAG_SQUOTE 0x10
+#define ESC_FLAG_DQUOTE	0x20
+#define ESC_FLAG_SPACE	0x40
+
+/* Create default tab stops, every 8 characters */
+static void
+terminal_init_tabs(struct terminal *terminal)
+{
+	int i = 0;
+
+	while (i < terminal->width) {
+		if (i % 8 == 0)
+			terminal->tab_ruler[i] = 1;
+		else
+			terminal->tab_ruler[i] = 0;
+		i++;
+	}
+}
+
+void
+terminal_init(struct terminal *terminal)
+{
+	terminal->curr_attr = terminal->color_scheme->default_attr;
+	terminal->origin_mode = 0;
+	terminal->mode = MODE_SHOW_CURSOR |
+			 MODE_AUTOREPEAT |
+			 MODE_ALT_SENDS_ESC |
+			 MODE_AUTOWRAP;
+
+	terminal->row = 0;
+	terminal->column = 0;
+
+	terminal->g0 = CS_US;
+	terminal->g1 = CS_US;
+	terminal->cs = terminal->g0;
+	terminal->key_mode = KM_NORMAL;
+
+	terminal->saved_g0 = terminal->g0;
+	terminal->saved_g1 = terminal->g1;
+	terminal->saved_cs = terminal->cs;
+
+	terminal->saved_attr = terminal->curr_attr;
+	terminal->saved_origin_mode = terminal->origin_mode;
+	terminal->saved_row = terminal->row;
+	terminal->saved_column = terminal->column;
+
+	init_state_machine(&terminal->state_machine);
+
+	if (terminal->tab_ruler != NULL) terminal_init_tabs(terminal);
+}
+
+static union utf8_char *
+terminal_line_data(struct terminal *terminal, uint32_t line)
+{
+	return (void *) terminal->data + line * terminal->data_pitch;
+}
+
+static struct attr *
+terminal_line_attr(struct terminal *terminal, uint32_t line)
+{
+	return (void *) terminal->data_attr + line * terminal->attr_pitch;
+}
+
+static uint32_t
+terminal_line(struct terminal *terminal, int row)
+{
+	int index;
+
+	index = (row + terminal->start) & (terminal->buffer_height - 1);
+
+	return terminal->line_map[index];
+}
+
+static void
+terminal_mark_dirty(struct terminal *terminal, uint32_t line)
+{
+	terminal->dirty[line / 32] |= 1u << (line % 32);
+}
+
+bool
+terminal_line_is_dirty(struct terminal *terminal, uint32_t line)
+{
+	return terminal->dirty[line / 32] & (1u << (line % 32));
+}
+
+void
+terminal_clear_dirty(struct terminal *terminal)
+{
+	memset(terminal->dirty, 0, terminal->buffer_height / 8);
+}
+
+/* Rows returned by these are about to be written to, so the line
+ * behind them is marked dirty for the renderer. */
+static union utf8_char *
+terminal_get_row(struct terminal *terminal, int row)
+{
+	uint32_t line = terminal_line(terminal, row);
+
+	terminal_mark_dirty(terminal, line);
+
+	return terminal_line_data(terminal, line);
+}
+
+static struct attr*
+terminal_get_attr_row(struct terminal *terminal, int row)
+{
+	uint32_t line = terminal_line(terminal, row);
+
+	terminal_mark_dirty(terminal, line);
+
+	return terminal_line_attr(terminal, line);
+}
+
+static void
+terminal_clear_row(struct terminal *terminal, int row)
+{
+	memset(terminal_get_row(terminal, row), 0, terminal->data_pitch);
+	attr_init(terminal_get_attr_row(terminal, row),
+		  terminal->curr_attr, terminal->width);
+}
+
+struct history_line {
+	uint32_t width;		/* cells in the row when it was saved */
+	uint32_t cells;		/* cells before the blank tail */
+	uint32_t runs;		/* attribute runs */
+	uint32_t size;		/* bytes of text */
+	struct attr tail;	/* attribute of the blank tail */
+	unsigned char data[];	/* attribute runs, then text */
+};
+
+struct history_run {
+	uint32_t length;
+	struct attr attr;
+};
+
+/* The text of a history line is the UTF-8 of each cell, with these
+ * standing in for cells that are not a single UTF-8 sequence. */
+#define HISTORY_CELL_RAW	0xfe	/* followed by the four cell bytes */
+#define HISTORY_CELL_SPACER	0xff	/* right half of a wide character */
+
+static int
+utf8_length(unsigned char c)
+{
+	if (c < 0x80)
+		return 1;
+	else if (c >= 0xc2 && c <= 0xdf)
+		return 2;
+	else if ((c & 0xf0) == 0xe0)
+		return 3;
+	else if (c >= 0xf0 && c <= 0xf7)
+		return 4;
+
+	return 0;
+}
+
+static bool
+attr_equal(struct attr a, struct attr b)
+{
+	return a.fg == b.fg && a.bg == b.bg && a.a == b.a && a.s == b.s;
+}
+
+/* Returns the encoded size of the cell, p may be NULL to only count */
+static int
+history_encode_cell(union utf8_char c, unsigned char *p)
+{
+	int i, len;
+
+	if (c.ch == 0x200B) {
+		if (p)
+			p[0] = HISTORY_CELL_SPACER;
+		return 1;
+	}
+
+	len = utf8_length(c.byte[0]);
+	for (i = len; len > 0 && i < 4; i++)
+		if (c.byte[i] != 0)
+			len = 0;
+
+	if (len == 0) {
+		if (p) {
+			p[0] = HISTORY_CELL_RAW;
+			memcpy(p + 1, c.byte, 4);
+		}
+		return 5;
+	}
+
+	if (p)
+		memcpy(p, c.byte, len);
+
+	return len;
+}
+
+static struct history_line *
+history_line_encode(const union utf8_char *data, const struct attr *attr,
+		    int width)
+{
+	struct history_line *line;
+	struct history_run *run;
+	unsigned char *p;
+	struct attr tail;
+	int i, cells, runs, size;
+
+	/* Trailing empty cells are stored as a single tail attribute */
+	tail = attr[width - 1];
+	cells = width;
+	while (cells > 0 && data[cells - 1].ch == 0 &&
+	       attr_equal(attr[cells - 1], tail))
+		cells--;
+
+	runs = 0;
+	size = 0;
+	for (i = 0; i < cells; i++) {
+		if (i == 0 || !attr_equal(attr[i], attr[i - 1]))
+			runs++;
+		size += history_encode_cell(data[i], NULL);
+	}
+
+	line = xmalloc(sizeof *line + runs * sizeof *run + size);
+	line->width = width;
+	line->cells = cells;
+	line->runs = runs;
+	line->size = size;
+	line->tail = tail;
+
+	run = (struct history_run *) line->data;
+	for (i = 0; i < cells; i++) {
+		if (i == 0 || !attr_equal(attr[i], attr[i - 1])) {
+			if (i > 0)
+				run++;
+			run->length = 0;
+			run->attr = attr[i];
+		}
+		run->length++;
+	}
+
+	p = line->data + runs * sizeof *run;
+	for (i = 0; i < cells; i++)
+		p += history_encode_cell(data[i], p);
+
+	return line;
+}
+
+static void
+history_line_decode(const struct history_line *line,
+		    union utf8_char *data, struct attr *attr, int width)
+{
+	const struct history_run *run = (const void *) line->data;
+	const unsigned char *p = line->data + line->runs * sizeof *run;
+	uint32_t i, j;
+	int col, len;
+
+	col = 0;
+	for (i = 0; i < line->runs; i++)
+		for (j = 0; j < run[i].length && col < width; j++)
+			attr[col++] = run[i].attr;
+	attr_init(&attr[col], line->tail, width - col);
+
+	memset(data, 0, width * sizeof *data);
+	for (col = 0; col < (int) line->cells && col < width; col++) {
+		if (p[0] == HISTORY_CELL_SPACER) {
+			data[col].ch = 0x200B;
+			p++;
+		} else if (p[0] == HISTORY_CELL_RAW) {
+			memcpy(data[col].byte, p + 1, 4);
+			p += 5;
+		} else {
+			len = utf8_length(p[0]);
+			memcpy(data[col].byte, p, len);
+			p += len;
+		}
+	}
+}
+
+static void
+terminal_history_push(struct terminal *terminal, int row)
+{
+	struct terminal_history *history = &terminal->history;
+	struct history_line *line;
+	uint32_t id;
+
+	if (history->size == 0)
+		return;
+
+	if (history->lines == NULL)
+		history->lines = xzalloc(history->size * sizeof *history->lines);
+
+	id = terminal_line(terminal, row);
+	line = history_line_encode(terminal_line_data(terminal, id),
+				   terminal_line_attr(terminal, id),
+				   terminal->width);
+
+	if (history->count == history->size) {
+		free(history->lines[history->first]);
+		history->lines[history->first] = line;
+		history->first = (history->first + 1) % history->size;
+	} else {
+		history->lines[(history->first + history->count) %
+			       history->size] = line;
+		history->count++;
+	}
+}
+
+uint32_t
+terminal_get_view_row(struct terminal *terminal, int row,
+		      union utf8_char **data, struct attr **attr)
+{
+	struct terminal_history *history = &terminal->history;
+	int line = row - (int) terminal->view;
+	uint32_t id, index;
+
+	if (line >= -(int) terminal->scrollback) {
+		id = terminal_line(terminal, line);
+		*data = terminal_line_data(terminal, id);
+		*attr = terminal_line_attr(terminal, id);
+		return id;
+	}
+
+	/* Rows above the ring come from the history, 1 is the newest */
+	index = -line - terminal->scrollback;
+	if (index <= history->count) {
+		id = (history->first + history->count - index) %
+			history->size;
+		history_line_decode(history->lines[id],
+				    terminal->history_data,
+				    terminal->history_attr, terminal->width);
+	} else {
+		memset(terminal->history_data, 0, terminal->data_pitch);
+		attr_init(terminal->history_attr,
+			  terminal->color_scheme->default_attr,
+			  terminal->width);
+	}
+
+	*data = terminal->history_data;
+	*attr = terminal->history_attr;
+
+	return TERMINAL_NO_LINE;
+}
+
+/* Positive lines scroll the view back, returns how far it moved */
+int
+terminal_scroll_view(struct terminal *terminal, int lines)
+{
+	int max = terminal->scrollback + terminal->history.count;
+	int view = terminal->view + lines;
+
+	if (view < 0)
+		view = 0;
+	else if (view > max)
+		view = max;
+
+	lines = view - terminal->view;
+	terminal->view = view;
+	terminal->selection_start_row += lines;
+	terminal->selection_end_row += lines;
+
+	return lines;
+}
+
+static void
+terminal_scroll_buffer(struct terminal *terminal, int d)
+{
+	int max = terminal->buffer_height - terminal->height;
+	int i, lost;
+
+	if (d > terminal->height)
+		d = terminal->height;
+	else if (d < -terminal->height)
+		d = -terminal->height;
+
+	if (d > 0) {
+		/* Once the ring is full the new rows at the bottom reuse
+		 * the oldest lines, which move to the history. */
+		lost = (int) terminal->scrollback + d - max;
+		for (i = 0; i < lost; i++)
+			terminal_history_push(terminal,
+					      i - (int) terminal->scrollback);
+
+		terminal->start += d;
+		terminal->scrollback = MIN((int) terminal->scrollback + d, max);
+		for (i = terminal->height - d; i < terminal->height; i++)
+			terminal_clear_row(terminal, i);
+	} else {
+		terminal->start += d;
+		if (terminal->scrollback > (uint32_t) -d)
+			terminal->scrollback += d;
+		else
+			terminal->scrollback = 0;
+		for (i = 0; i < -d; i++)
+			terminal_clear_row(terminal, i);
+	}
+
+	terminal->selection_start_row -= d;
+	terminal->selection_end_row -= d;
+}
+
+static void
+terminal_reverse_lines(struct terminal *terminal, int first, int last)
+{
+	uint32_t mask = terminal->buffer_height - 1;
+	uint32_t *map = terminal->line_map;
+	uint32_t a, b, tmp;
+
+	for (; first < last; first++, last--) {
+		a = (first + terminal->start) & mask;
+		b = (last + terminal->start) & mask;
+		tmp = map[a];
+		map[a] = map[b];
+		map[b] = tmp;
+	}
+}
+
+/* Rotate rows top..bottom up by d by permuting the line map, the
+ * cells themselves stay where they are. */
+static void
+terminal_rotate_lines(struct terminal *terminal, int top, int bottom, int d)
+{
+	terminal_reverse_lines(terminal, top, top + d - 1);
+	terminal_reverse_lines(terminal, top + d, bottom);
+	terminal_reverse_lines(terminal, top, bottom);
+}
+
+static void
+terminal_scroll_window(struct terminal *terminal, int d)
+{
+	int i;
+	int window_height;
+
+	// scrolling range is inclusive
+	window_height = terminal->margin_bottom - terminal->margin_top + 1;
+	d = d % (window_height + 1);
+	if (d < 0) {
+		d = 0 - d;
+		terminal_rotate_lines(terminal, terminal->margin_top,
+				      terminal->margin_bottom,
+				      window_height - d);
+		for (i = terminal->margin_top; i < (terminal->margin_top + d); i++)
+			terminal_clear_row(terminal, i);
+	} else {
+		terminal_rotate_lines(terminal, terminal->margin_top,
+				      terminal->margin_bottom, d);
+		for (i = terminal->margin_bottom - d + 1; i <= terminal->margin_bottom; i++)
+			terminal_clear_row(terminal, i);
+	}
+}
+
+static void
+terminal_scroll(struct terminal *terminal, int d)
+{
+	if (terminal->margin_top == 0 && terminal->margin_bottom == terminal->height - 1)
+		terminal_scroll_buffer(terminal, d);
+	else
+		terminal_scroll_window(terminal, d);
+}
+
+static void
+terminal_shift_line(struct terminal *terminal, int d)
+{
+	union utf8_char *row;
+	struct attr *attr_row;
+
+	row = terminal_get_row(terminal, terminal->row);
+	attr_row = terminal_get_attr_row(terminal, terminal->row);
+
+	if ((terminal->width + d) <= terminal->column)
+		d = terminal->column + 1 - terminal->width;
+	if ((terminal->column + d) >= terminal->width)
+		d = terminal->width - terminal->column - 1;
+
+	if (d < 0) {
+		d = 0 - d;
+		memmove(&row[terminal->column],
+		        &row[terminal->column + d],
+			(terminal->width - terminal->column - d) * sizeof(union utf8_char));
+		memmove(&attr_row[terminal->column], &attr_row[terminal->column + d],
+		        (terminal->width - terminal->column - d) * sizeof(struct attr));
+		memset(&row[terminal->width - d], 0, d * sizeof(union utf8_char));
+		attr_init(&attr_row[terminal->width - d], terminal->curr_attr, d);
+	} else {
+		memmove(&row[terminal->column + d], &row[terminal->column],
+			(terminal->width - terminal->column - d) * sizeof(union utf8_char));
+		memmove(&attr_row[terminal->column + d], &attr_row[terminal->column],
+			(terminal->width - terminal->column - d) * sizeof(struct attr));
+		memset(&row[terminal->column], 0, d * sizeof(union utf8_char));
+		attr_init(&attr_row[terminal->column], terminal->curr_attr, d);
+	}
+}
+
+void
+terminal_resize_cells(struct terminal *terminal,
+		      int width, int height)
+{
+	union utf8_char *data;
+	struct attr *data_attr;
+	char *tab_ruler;
+	int data_pitch, attr_pitch;
+	int i, l, d, total_rows, lost, keep, first_new;
+	uint32_t uheight = height, line;
+
+	if (uheight > terminal->buffer_height)
+		height = terminal->buffer_height;
+
+	if (terminal->width == width && terminal->height == height)
+		return;
+
+	if (terminal->line_map == NULL) {
+		terminal->line_map = xmalloc(terminal->buffer_height *
+					     sizeof *terminal->line_map);
+		terminal->dirty = xzalloc(terminal->buffer_height / 8);
+	}
+
+	if (terminal->data && width <= terminal->max_width) {
+		d = 0;
+		if (height < terminal->height && height <= terminal->row)
+			d = terminal->height - height;
+		else if (height > terminal->height &&
+			 terminal->height - 1 == terminal->row)
+			d = -MIN(height - terminal->height,
+				 (int) terminal->scrollback);
+
+		terminal->start += d;
+		terminal->row -= d;
+		terminal->scrollback += d;
+
+		/* Rows below the old screen are new, with a full ring
+		 * they are the oldest lines which go to the history. */
+		lost = (int) terminal->scrollback + height -
+			(int) terminal->buffer_height;
+		for (i = 0; i < lost; i++)
+			terminal_history_push(terminal,
+					      i - (int) terminal->scrollback);
+		if (lost > 0)
+			terminal->scrollback -= lost;
+
+		first_new = terminal->height - d;
+	} else {
+		terminal->max_width = width;
+		data_pitch = width * sizeof(union utf8_char);
+		data = xzalloc(data_pitch * terminal->buffer_height);
+		attr_pitch = width * sizeof(struct attr);
+		data_attr = xmalloc(attr_pitch * terminal->buffer_height);
+		tab_ruler = xzalloc(width);
+		attr_init(data_attr, terminal->curr_attr,
+			  width * terminal->buffer_height);
+
+		keep = 0;
+		if (terminal->data && terminal->data_attr) {
+			if (width > terminal->width)
+				l = terminal->width;
+			else
+				l = width;
+
+			if (terminal->height > height) {
+				total_rows = height;
+				i = 1 + terminal->row - height;
+				if (i > 0) {
+					terminal->start += i;
+					terminal->row = terminal->row - i;
+					terminal->scrollback += i;
+				}
+			} else {
+				total_rows = terminal->height;
+			}
+
+			/* Keep what fits of the scrollback above the screen */
+			keep = MIN((int) terminal->scrollback,
+				   (int) terminal->buffer_height - height);
+			for (i = terminal->scrollback; i > keep; i--)
+				terminal_history_push(terminal, -i);
+
+			for (i = 0; i < keep + total_rows; i++) {
+				line = terminal_line(terminal, i - keep);
+				memcpy(&data[width * i],
+				       terminal_line_data(terminal, line),
+				       l * sizeof(union utf8_char));
+				memcpy(&data_attr[width * i],
+				       terminal_line_attr(terminal, line),
+				       l * sizeof(struct attr));
+			}
+
+			free(terminal->data);
+			free(terminal->data_attr);
+			free(terminal->tab_ruler);
+			free(terminal->history_data);
+			free(terminal->history_attr);
+		}
+
+		terminal->data_pitch = data_pitch;
+		terminal->attr_pitch = attr_pitch;
+		terminal->data = data;
+		terminal->data_attr = data_attr;
+		terminal->tab_ruler = tab_ruler;
+		terminal->history_data = xmalloc(data_pitch);
+		terminal->history_attr = xmalloc(attr_pitch);
+		terminal->end += keep - terminal->start;
+		terminal->start = keep;
+		terminal->scrollback = keep;
+		for (line = 0; line < terminal->buffer_height; line++)
+			terminal->line_map[line] = line;
+		memset(terminal->dirty, 0xff, terminal->buffer_height / 8);
+
+		first_new = height;
+	}
+
+	terminal->margin_bottom =
+		height - (terminal->height - terminal->margin_bottom);
+	terminal->width = width;
+	terminal->height = height;
+	terminal_init_tabs(terminal);
+
+	for (i = first_new; i < height; i++)
+		terminal_clear_row(terminal, i);
+
+	terminal->view = MIN(terminal->view,
+			     terminal->scrollback + terminal->history.count);
+}
+
+void
+terminal_free_cells(struct terminal *terminal)
+{
+	struct terminal_history *history = &terminal->history;
+	uint32_t i;
+
+	for (i = 0; i < history->count; i++)
+		free(history->lines[(history->first + i) % history->size]);
+	free(history->lines);
+
+	free(terminal->data);
+	free(terminal->data_attr);
+	free(terminal->tab_ruler);
+	free(terminal->history_data);
+	free(terminal->history_attr);
+	free(terminal->line_map);
+	free(terminal->dirty);
+}
+
+void
+terminal_write(struct terminal *terminal, const char *data, size_t length)
+{
+	if (write(terminal->master, data, length) < 0)
+		abort();
+	terminal->send_cursor_position = 1;
+}
+
+static void
+handle_char(struct terminal *terminal, union utf8_char utf8);
+
+static void
+handle_sgr(struct terminal *terminal, int code);
+
+static void
+handle_term_parameter(struct terminal *terminal, int code, int sr)
+{
+	int i;
+
+	if (terminal->escape_flags & ESC_FLAG_WHAT) {
+		switch(code) {
+		case 1:  /* DECCKM */
+			if (sr)	terminal->key_mode = KM_APPLICATION;
+			else	terminal->key_mode = KM_NORMAL;
+			break;
+		case 2:  /* DECANM */
+			/* No VT52 support yet */
+			terminal->g0 = CS_US;
+			terminal->g1 = CS_US;
+			terminal->cs = terminal->g0;
+			break;
+		case 3:  /* DECCOLM */
+			if (sr)
+				terminal_resize(terminal, 132, 24);
+			else
+				terminal_resize(terminal, 80, 24);
+
+			/* set columns, but also home cursor and clear screen */
+			terminal->row = 0; terminal->column = 0;
+			for (i = 0; i < terminal->height; i++) {
+				memset(terminal_get_row(terminal, i),
+				    0, terminal->data_pitch);
+				attr_init(terminal_get_attr_row(terminal, i),
+				    terminal->curr_attr, terminal->width);
+			}
+			break;
+		case 5:  /* DECSCNM */
+			if (sr)	terminal->mode |=  MODE_INVERSE;
+			else	terminal->mode &= ~MODE_INVERSE;
+			break;
+		case 6:  /* DECOM */
+			terminal->origin_mode = sr;
+			if (terminal->origin_mode)
+				terminal->row = terminal->margin_top;
+			else
+				terminal->row = 0;
+			terminal->column = 0;
+			break;
+		case 7:  /* DECAWM */
+			if (sr)	terminal->mode |=  MODE_AUTOWRAP;
+			else	terminal->mode &= ~MODE_AUTOWRAP;
+			break;
+		case 8:  /* DECARM */
+			if (sr)	terminal->mode |=  MODE_AUTOREPEAT;
+			else	terminal->mode &= ~MODE_AUTOREPEAT;
+			break;
+		case 12:  /* Very visible cursor (CVVIS) */
+			/* FIXME: What do we do here. */
+			break;
+		case 25:
+			if (sr)	terminal->mode |=  MODE_SHOW_CURSOR;
+			else	terminal->mode &= ~MODE_SHOW_CURSOR;
+			break;
+		case 1034:   /* smm/rmm, meta mode on/off */
+			/* ignore */
+			break;
+		case 1037:   /* deleteSendsDel */
+			if (sr)	terminal->mode |=  MODE_DELETE_SENDS_DEL;
+			else	terminal->mode &= ~MODE_DELETE_SENDS_DEL;
+			break;
+		case 1039:   /* altSendsEscape */
+			if (sr)	terminal->mode |=  MODE_ALT_SENDS_ESC;
+			else	terminal->mode &= ~MODE_ALT_SENDS_ESC;
+			break;
+		case 1049:   /* rmcup/smcup, alternate screen */
+			/* Ignore.  Should be possible to implement,
+			 * but it's kind of annoying. */
+			break;
+		default:
+			fprintf(stderr, "Unknown parameter: ?%d\n", code);
+			break;
+		}
+	} else {
+		switch(code) {
+		case 4:  /* IRM */
+			if (sr)	terminal->mode |=  MODE_IRM;
+			else	terminal->mode &= ~MODE_IRM;
+			break;
+		case 20: /* LNM */
+			if (sr)	terminal->mode |=  MODE_LF_NEWLINE;
+			else	terminal->mode &= ~MODE_LF_NEWLINE;
+			break;
+		default:
+			fprintf(stderr, "Unknown parameter: %d\n", code);
+			break;
+		}
+	}
+}
+
+static void
+handle_dcs(struct terminal *terminal)
+{
+}
+
+static void
+handle_osc(struct terminal *terminal)
+{
+	char *p;
+	int code;
+
+	terminal->escape[terminal->escape_length++] = '\0';
+	p = &terminal->escape[2];
+	code = strtol(p, &p, 10);
+	if (*p == ';') p++;
+
+	switch (code) {
+	case 0: /* Icon name and window title */
+	case 1: /* Icon label */
+	case 2: /* Window title*/
+		free(terminal->title);
+		terminal->title = strdup(p);
+		terminal_set_title(terminal, p);
+		break;
+	case 7: /* shell cwd as uri */
+		break;
+	default:
+		fprintf(stderr, "Unknown OSC escape code %d, text %s\n",
+			code, p);
+		break;
+	}
+}
+
+static void
+handle_escape(struct terminal *terminal)
+{
+	union utf8_char *row;
+	struct attr *attr_row;
+	char *p;
+	int i, count, x, y, top, bottom;
+	int args[10], set[10] = { 0, };
+	char response[MAX_RESPONSE] = {0, };
+	struct rectangle allocation;
+
+	terminal->escape[terminal->escape_length++] = '\0';
+	i = 0;
+	p = &terminal->escape[2];
+	while ((isdigit(*p) || *p == ';') && i < 10) {
+		if (*p == ';') {
+			if (!set[i]) {
+				args[i] = 0;
+				set[i] = 1;
+			}
+			p++;
+			i++;
+		} else {
+			args[i] = strtol(p, &p, 10);
+			set[i] = 1;
+		}
+	}
+
+	switch (*p) {
+	case '@':    /* ICH */
+		count = set[0] ? args[0] : 1;
+		if (count == 0) count = 1;
+		terminal_shift_line(terminal, count);
+		break;
+	case 'A':    /* CUU */
+		count = set[0] ? args[0] : 1;
+		if (count == 0) count = 1;
+		if (terminal->row - count >= terminal->margin_top)
+			terminal->row -= count;
+		else
+			terminal->row = terminal->margin_top;
+		break;
+	case 'B':    /* CUD */
+		count = set[0] ? args[0] : 1;
+		if (count == 0) count = 1;
+		if (terminal->row + count <= terminal->margin_bottom)
+			terminal->row += count;
+		else
+			terminal->row = terminal->margin_bottom;
+		break;
+	case 'C':    /* CUF */
+		count = set[0] ? args[0] : 1;
+		if (count == 0) count = 1;
+		if ((terminal->column + count) < terminal->width)
+			terminal->column += count;
+		else
+			terminal->column = terminal->width - 1;
+		break;
+	case 'D':    /* CUB */
+		count = set[0] ? args[0] : 1;
+		if (count == 0) count = 1;
+		if ((terminal->column - count) >= 0)
+			terminal->column -= count;
+		else
+			terminal->column = 0;
+		break;
+	case 'E':    /* CNL */
+		count = set[0] ? args[0] : 1;
+		if (terminal->row + count <= terminal->margin_bottom)
+			terminal->row += count;
+		else
+			terminal->row = terminal->margin_bottom;
+		terminal->column = 0;
+		break;
+	case 'F':    /* CPL */
+		count = set[0] ? args[0] : 1;
+		if (terminal->row - count >= terminal->margin_top)
+			terminal->row -= count;
+		else
+			terminal->row = terminal->margin_top;
+		terminal->column = 0;
+		break;
+	case 'G':    /* CHA */
+		y = set[0] ? args[0] : 1;
+		y = y <= 0 ? 1 : y > terminal->width ? terminal->width : y;
+
+		terminal->column = y - 1;
+		break;
+	case 'f':    /* HVP */
+	case 'H':    /* CUP */
+		x = (set[1] ? args[1] : 1) - 1;
+		x = x < 0 ? 0 :
+		    (x >= terminal->width ? terminal->width - 1 : x);
+
+		y = (set[0] ? args[0] : 1) - 1;
+		if (terminal->origin_mode) {
+			y += terminal->margin_top;
+			y = y < terminal->margin_top ? terminal->margin_top :
+			    (y > terminal->margin_bottom ? terminal->margin_bottom : y);
+		} else {
+			y = y < 0 ? 0 :
+			    (y >= terminal->height ? terminal->height - 1 : y);
+		}
+
+		terminal->row = y;
+		terminal->column = x;
+		break;
+	case 'I':    /* CHT */
+		count = set[0] ? args[0] : 1;
+		if (count == 0) count = 1;
+		while (count > 0 && terminal->column < terminal->width) {
+			if (terminal->tab_ruler[terminal->column]) count--;
+			terminal->column++;
+		}
+		terminal->column--;
+		break;
+	case 'J':    /* ED */
+		row = terminal_get_row(terminal, terminal->row);
+		attr_row = terminal_get_attr_row(terminal, terminal->row);
+		if (!set[0] || args[0] == 0 || args[0] > 2) {
+			memset(&row[terminal->column],
+			       0, (terminal->width - terminal->column) * sizeof(union utf8_char));
+			attr_init(&attr_row[terminal->column],
+			       terminal->curr_attr, terminal->width - terminal->column);
+			for (i = terminal->row + 1; i < terminal->height; i++) {
+				memset(terminal_get_row(terminal, i),
+				    0, terminal->data_pitch);
+				attr_init(terminal_get_attr_row(terminal, i),
+				    terminal->curr_attr, terminal->width);
+			}
+		} else if (args[0] == 1) {
+			memset(row, 0, (terminal->column+1) * sizeof(union utf8_char));
+			attr_init(attr_row, terminal->curr_attr, terminal->column+1);
+			for (i = 0; i < terminal->row; i++) {
+				memset(terminal_get_row(terminal, i),
+				    0, terminal->data_pitch);
+				attr_init(terminal_get_attr_row(terminal, i),
+				    terminal->curr_attr, terminal->width);
+			}
+		} else if (args[0] == 2) {
+			/* Clear screen by scrolling contents out */
+			count = terminal->end - terminal->start;
+			if (count > 0)
+				terminal_scroll_buffer(terminal, count);
+			else
+				for (i = 0; i < terminal->height; i++)
+					terminal_clear_row(terminal, i);
+		}
+		break;
+	case 'K':    /* EL */
+		row = terminal_get_row(terminal, terminal->row);
+		attr_row = terminal_get_attr_row(terminal, terminal->row);
+		if (!set[0] || args[0] == 0 || args[0] > 2) {
+			memset(&row[terminal->column], 0,
+			    (terminal->width - terminal->column) * sizeof(union utf8_char));
+			attr_init(&attr_row[terminal->column], terminal->curr_attr,
+			    terminal->width - terminal->column);
+		} else if (args[0] == 1) {
+			memset(row, 0, (terminal->column+1) * sizeof(union utf8_char));
+			attr_init(attr_row, terminal->curr_attr, terminal->column+1);
+		} else if (args[0] == 2) {
+			memset(row, 0, terminal->data_pitch);
+			attr_init(attr_row, terminal->curr_attr, terminal->width);
+		}
+		break;
+	case 'L':    /* IL */
+		count = set[0] ? args[0] : 1;
+		if (count == 0) count = 1;
+		if (terminal->row >= terminal->margin_top &&
+			terminal->row < terminal->margin_bottom)
+		{
+			top = terminal->margin_top;
+			terminal->margin_top = terminal->row;
+			terminal_scroll(terminal, 0 - count);
+			terminal->margin_top = top;
+		} else if (terminal->row == terminal->margin_bottom) {
+			memset(terminal_get_row(terminal, terminal->row),
+			       0, terminal->data_pitch);
+			attr_init(terminal_get_attr_row(terminal, terminal->row),
+				terminal->curr_attr, terminal->width);
+		}
+		break;
+	case 'M':    /* DL */
+		count = set[0] ? args[0] : 1;
+		if (count == 0) count = 1;
+		if (terminal->row >= terminal->margin_top &&
+			terminal->row < terminal->margin_bottom)
+		{
+			top = terminal->margin_top;
+			terminal->margin_top = terminal->row;
+			terminal_scroll(terminal, count);
+			terminal->margin_top = top;
+		} else if (terminal->row == terminal->margin_bottom) {
+			memset(terminal_get_row(terminal, terminal->row),
+			       0, terminal->data_pitch);
+		}
+		break;
+	case 'P':    /* DCH */
+		count = set[0] ? args[0] : 1;
+		if (count == 0) count = 1;
+		terminal_shift_line(terminal, 0 - count);
+		break;
+	case 'S':    /* SU */
+		terminal_scroll(terminal, set[0] ? args[0] : 1);
+		break;
+	case 'T':    /* SD */
+		terminal_scroll(terminal, 0 - (set[0] ? args[0] : 1));
+		break;
+	case 'X':    /* ECH */
+		count = set[0] ? args[0] : 1;
+		if (count == 0) count = 1;
+		if ((terminal->column + count) > terminal->width)
+			count = terminal->width - terminal->column;
+		row = terminal_get_row(terminal, terminal->row);
+		attr_row = terminal_get_attr_row(terminal, terminal->row);
+		memset(&row[terminal->column], 0, count * sizeof(union utf8_char));
+		attr_init(&attr_row[terminal->column], terminal->curr_attr, count);
+		break;
+	case 'Z':    /* CBT */
+		count = set[0] ? args[0] : 1;
+		if (count == 0) count = 1;
+		while (count > 0 && terminal->column >= 0) {
+			if (terminal->tab_ruler[terminal->column]) count--;
+			terminal->column--;
+		}
+		terminal->column++;
+		break;
+	case '`':    /* HPA */
+		y = set[0] ? args[0] : 1;
+		y = y <= 0 ? 1 : y > terminal->width ? terminal->width : y;
+
+		terminal->column = y - 1;
+		break;
+	case 'b':    /* REP */
+		count = set[0] ? args[0] : 1;
+		if (count == 0) count = 1;
+		if (terminal->last_char.byte[0])
+			for (i = 0; i < count; i++)
+				handle_char(terminal, terminal->last_char);
+		terminal->last_char.byte[0] = 0;
+		break;
+	case 'c':    /* Primary DA */
+		terminal_write(terminal, "\e[?6c", 5);
+		break;
+	case 'd':    /* VPA */
+		x = set[0] ? args[0] : 1;
+		x = x <= 0 ? 1 : x > terminal->height ? terminal->height : x;
+
+		terminal->row = x - 1;
+		break;
+	case 'g':    /* TBC */
+		if (!set[0] || args[0] == 0) {
+			terminal->tab_ruler[terminal->column] = 0;
+		} else if (args[0] == 3) {
+			memset(terminal->tab_ruler, 0, terminal->width);
+		}
+		break;
+	case 'h':    /* SM */
+		for (i = 0; i < 10 && set[i]; i++) {
+			handle_term_parameter(terminal, args[i], 1);
+		}
+		break;
+	case 'l':    /* RM */
+		for (i = 0; i < 10 && set[i]; i++) {
+			handle_term_parameter(terminal, args[i], 0);
+		}
+		break;
+	case 'm':    /* SGR */
+		for (i = 0; i < 10; i++) {
+			if (i <= 7 && set[i] && set[i + 1] &&
+				set[i + 2] && args[i + 1] == 5)
+			{
+				if (args[i] == 38) {
+					handle_sgr(terminal, args[i + 2] + 256);
+					break;
+				} else if (args[i] == 48) {
+					handle_sgr(terminal, args[i + 2] + 512);
+					break;
+				}
+			}
+			if (set[i]) {
+				handle_sgr(terminal, args[i]);
+			} else if (i == 0) {
+				handle_sgr(terminal, 0);
+				break;
+			} else {
+				break;
+			}
+		}
+		break;
+	case 'n':    /* DSR */
+		i = set[0] ? args[0] : 0;
+		if (i == 0 || i == 5) {
+			terminal_write(terminal, "\e[0n", 4);
+		} else if (i == 6) {
+			snprintf(response, MAX_RESPONSE, "\e[%d;%dR",
+			         terminal->origin_mode ?
+				     terminal->row+terminal->margin_top : terminal->row+1,
+				 terminal->column+1);
+			terminal_write(terminal, response, strlen(response));
+		}
+ 		break;
+	case 'r':
+		if (!set[0]) {
+			terminal->margin_top = 0;
+			terminal->margin_bottom = terminal->height-1;
+			terminal->row = 0;
+			terminal->column = 0;
+		} else {
+			top = (set[0] ? args[0] : 1) - 1;
+			top = top < 0 ? 0 :
+			      (top >= terminal->height ? terminal->height - 1 : top);
+			bottom = (set[1] ? args[1] : 1) - 1;
+			bottom = bottom < 0 ? 0 :
+			         (bottom >= terminal->height ? terminal->height - 1 : bottom);
+			if (bottom > top) {
+				terminal->margin_top = top;
+				terminal->margin_bottom = bottom;
+			} else {
+				terminal->margin_top = 0;
+				terminal->margin_bottom = terminal->height-1;
+			}
+			if (terminal->origin_mode)
+				terminal->row = terminal->margin_top;
+			else
+				terminal->row = 0;
+			terminal->column = 0;
+		}
+		break;
+	case 's':
+		terminal->saved_row = terminal->row;
+		terminal->saved_column = terminal->column;
+		break;
+	case 't':    /* windowOps */
+		if (!set[0]) break;
+		switch (args[0]) {
+		case 4:  /* resize px */
+			if (set[1] && set[2]) {
+				terminal_schedule_resize(terminal,
+							 args[2], args[1]);
+			}
+			break;
+		case 8:  /* resize ch */
+			if (set[1] && set[2]) {
+				terminal_resize(terminal, args[2], args[1]);
+			}
+			break;
+		case 13: /* report position */
+			terminal_get_allocation(terminal, &allocation);
+			snprintf(response, MAX_RESPONSE, "\e[3;%d;%dt",
+				 allocation.x, allocation.y);
+			terminal_write(terminal, response, strlen(response));
+			break;
+		case 14: /* report px */
+			terminal_get_allocation(terminal, &allocation);
+			snprintf(response, MAX_RESPONSE, "\e[4;%d;%dt",
+				 allocation.height, allocation.width);
+			terminal_write(terminal, response, strlen(response));
+			break;
+		case 18: /* report ch */
+			snprintf(response, MAX_RESPONSE, "\e[9;%d;%dt",
+				 terminal->height, terminal->width);
+			terminal_write(terminal, response, strlen(response));
+			break;
+		case 21: /* report title */
+			snprintf(response, MAX_RESPONSE, "\e]l%s\e\\",
+				 terminal->title);
+			terminal_write(terminal, response, strlen(response));
+			break;
+		default:
+			if (args[0] >= 24)
+				terminal_resize(terminal, terminal->width, args[0]);
+			else
+				fprintf(stderr, "Unimplemented windowOp %d\n", args[0]);
+			break;
+		}
+	case 'u':
+		terminal->row = terminal->saved_row;
+		terminal->column = terminal->saved_column;
+		break;
+	default:
+		fprintf(stderr, "Unknown CSI escape: %c\n", *p);
+		break;
+	}
+}
+
+static void
+handle_non_csi_escape(struct terminal *terminal, char code)
+{
+	switch(code) {
+	case 'M':    /* RI */
+		terminal->row -= 1;
+		if (terminal->row < terminal->margin_top) {
+			terminal->row = terminal->margin_top;
+			terminal_scroll(terminal, -1);
+		}
+		break;
+	case 'E':    /* NEL */
+		terminal->column = 0;
+		// fallthrough
+	case 'D':    /* IND */
+		terminal->row += 1;
+		if (terminal->row > terminal->margin_bottom) {
+			terminal->row = terminal->margin_bottom;
+			terminal_scroll(terminal, +1);
+		}
+		break;
+	case 'c':    /* RIS */
+		terminal_init(terminal);
+		break;
+	case 'H':    /* HTS */
+		terminal->tab_ruler[terminal->column] = 1;
+		break;
+	case '7':    /* DECSC */
+		terminal->saved_row = terminal->row;
+		terminal->saved_column = terminal->column;
+		terminal->saved_attr = terminal->curr_attr;
+		terminal->saved_origin_mode = terminal->origin_mode;
+		terminal->saved_cs = terminal->cs;
+		terminal->saved_g0 = terminal->g0;
+		terminal->saved_g1 = terminal->g1;
+		break;
+	case '8':    /* DECRC */
+		terminal->row = terminal->saved_row;
+		terminal->column = terminal->saved_column;
+		terminal->curr_attr = terminal->saved_attr;
+		terminal->origin_mode = terminal->saved_origin_mode;
+		terminal->cs = terminal->saved_cs;
+		terminal->g0 = terminal->saved_g0;
+		terminal->g1 = terminal->saved_g1;
+		break;
+	case '=':    /* DECPAM */
+		terminal->key_mode = KM_APPLICATION;
+		break;
+	case '>':    /* DECPNM */
+		terminal->key_mode = KM_NORMAL;
+		break;
+	default:
+		fprintf(stderr, "Unknown escape code: %c\n", code);
+		break;
+	}
+}
+
+static void
+handle_special_escape(struct terminal *terminal, char special, char code)
+{
+	union utf8_char *row;
+	int i, j;
+
+	if (special == '#') {
+		switch(code) {
+		case '8':
+			/* fill with 'E', no cheap way to do this */
+			for (i = 0; i < terminal->height; i++) {
+				row = terminal_get_row(terminal, i);
+				memset(row, 0, terminal->data_pitch);
+				for (j = 0; j < terminal->width; j++)
+					row[j].byte[0] = 'E';
+			}
+			break;
+		default:
+			fprintf(stderr, "Unknown HASH escape #%c\n", code);
+			break;
+		}
+	} else if (special == '(' || special == ')') {
+		switch(code) {
+		case '0':
+			if (special == '(')
+				terminal->g0 = CS_SPECIAL;
+			else
+				terminal->g1 = CS_SPECIAL;
+			break;
+		case 'A':
+			if (special == '(')
+				terminal->g0 = CS_UK;
+			else
+				terminal->g1 = CS_UK;
+			break;
+		case 'B':
+			if (special == '(')
+				terminal->g0 = CS_US;
+			else
+				terminal->g1 = CS_US;
+			break;
+		default:
+			fprintf(stderr, "Unknown character set %c\n", code);
+			break;
+		}
+	} else {
+		fprintf(stderr, "Unknown special escape %c%c\n", special, code);
+	}
+}
+
+static void
+handle_sgr(struct terminal *terminal, int code)
+{
+	switch(code) {
+	case 0:
+		terminal->curr_attr = terminal->color_scheme->default_attr;
+		break;
+	case 1:
+		terminal->curr_attr.a |= ATTRMASK_BOLD;
+		if (terminal->curr_attr.fg < 8)
+			terminal->curr_attr.fg += 8;
+		break;
+	case 4:
+		terminal->curr_attr.a |= ATTRMASK_UNDERLINE;
+		break;
+	case 5:
+		terminal->curr_attr.a |= ATTRMASK_BLINK;
+		break;
+	case 8:
+		terminal->curr_attr.a |= ATTRMASK_CONCEALED;
+		break;
+	case 2:
+	case 21:
+	case 22:
+		terminal->curr_attr.a &= ~ATTRMASK_BOLD;
+		if (terminal->curr_attr.fg < 16 && terminal->curr_attr.fg >= 8)
+			terminal->curr_attr.fg -= 8;
+		break;
+	case 24:
+		terminal->curr_attr.a &= ~ATTRMASK_UNDERLINE;
+		break;
+	case 25:
+		terminal->curr_attr.a &= ~ATTRMASK_BLINK;
+		break;
+	case 7:
+	case 26:
+		terminal->curr_attr.a |= ATTRMASK_INVERSE;
+		break;
+	case 27:
+		terminal->curr_attr.a &= ~ATTRMASK_INVERSE;
+		break;
+	case 28:
+		terminal->curr_attr.a &= ~ATTRMASK_CONCEALED;
+		break;
+	case 39:
+		terminal->curr_attr.fg = terminal->color_scheme->default_attr.fg;
+		break;
+	case 49:
+		terminal->curr_attr.bg = terminal->color_scheme->default_attr.bg;
+		break;
+	default:
+		if (code >= 30 && code <= 37) {
+			terminal->curr_attr.fg = code - 30;
+			if (terminal->curr_attr.a & ATTRMASK_BOLD)
+				terminal->curr_attr.fg += 8;
+		} else if (code >= 40 && code <= 47) {
+			terminal->curr_attr.bg = code - 40;
+		} else if (code >= 90 && code <= 97) {
+			terminal->curr_attr.fg = code - 90 + 8;
+		} else if (code >= 100 && code <= 107) {
+			terminal->curr_attr.bg = code - 100 + 8;
+		} else if (code >= 256 && code < 512) {
+			terminal->curr_attr.fg = code - 256;
+		} else if (code >= 512 && code < 768) {
+			terminal->curr_attr.bg = code - 512;
+		} else {
+			fprintf(stderr, "Unknown SGR code: %d\n", code);
+		}
+		break;
+	}
+}
+
+/* Returns 1 if c was special, otherwise 0 */
+static int
+handle_special_char(struct terminal *terminal, char c)
+{
+	union utf8_char *row;
+	struct attr *attr_row;
+
+	switch(c) {
+	case '\r':
+		terminal->column = 0;
+		break;
+	case '\n':
+		if (terminal->mode & MODE_LF_NEWLINE) {
+			terminal->column = 0;
+		}
+		/* fallthrough */
+	case '\v':
+	case '\f':
+		terminal->row++;
+		if (terminal->row > terminal->margin_bottom) {
+			terminal->row = terminal->margin_bottom;
+			terminal_scroll(terminal, +1);
+		}
+
+		break;
+	case '\t':
+		row = terminal_get_row(terminal, terminal->row);
+		attr_row = terminal_get_attr_row(terminal, terminal->row);
+		while (terminal->column < terminal->width) {
+			if (terminal->mode & MODE_IRM)
+				terminal_shift_line(terminal, +1);
+
+			if (row[terminal->column].byte[0] == '\0') {
+				row[terminal->column].byte[0] = ' ';
+				row[terminal->column].byte[1] = '\0';
+				attr_row[terminal->column] = terminal->curr_attr;
+			}
+
+			terminal->column++;
+			if (terminal->tab_ruler[terminal->column]) break;
+		}
+		if (terminal->column >= terminal->width) {
+			terminal->column = terminal->width - 1;
+		}
+
+		break;
+	case '\b':
+		if (terminal->column >= terminal->width) {
+			terminal->column = terminal->width - 2;
+		} else if (terminal->column > 0) {
+			terminal->column--;
+		} else if (terminal->mode & MODE_AUTOWRAP) {
+			terminal->column = terminal->width - 1;
+			terminal->row -= 1;
+			if (terminal->row < terminal->margin_top) {
+				terminal->row = terminal->margin_top;
+				terminal_scroll(terminal, -1);
+			}
+		}
+
+		break;
+	case '\a':
+		/* Bell */
+		break;
+	case '\x0E': /* SO */
+		terminal->cs = terminal->g1;
+		break;
+	case '\x0F': /* SI */
+		terminal->cs = terminal->g0;
+		break;
+	case '\0':
+		break;
+	default:
+		return 0;
+	}
+
+	return 1;
+}
+
+static void
+handle_char(struct terminal *terminal, union utf8_char utf8)
+{
+	union utf8_char *row;
+	struct attr *attr_row;
+
+	if (handle_special_char(terminal, utf8.byte[0])) return;
+
+	apply_char_set(terminal->cs, &utf8);
+
+	/* There are a whole lot of non-characters, control codes,
+	 * and formatting codes that should probably be ignored,
+	 * for example: */
+	if (strncmp((char*) utf8.byte, "\xEF\xBB\xBF", 3) == 0) {
+		/* BOM, ignore */
+		return;
+	}
+
+	/* Some of these non-characters should be translated, e.g.: */
+	if (utf8.byte[0] < 32) {
+		utf8.byte[0] = utf8.byte[0] + 64;
+	}
+
+	/* handle right margin effects */
+	if (terminal->column >= terminal->width) {
+		if (terminal->mode & MODE_AUTOWRAP) {
+			terminal->column = 0;
+			terminal->row += 1;
+			if (terminal->row > terminal->margin_bottom) {
+				terminal->row = terminal->margin_bottom;
+				terminal_scroll(terminal, +1);
+			}
+		} else {
+			terminal->column--;
+ 		}
+ 	}
+
+	row = terminal_get_row(terminal, terminal->row);
+	attr_row = terminal_get_attr_row(terminal, terminal->row);
+
+	if (terminal->mode & MODE_IRM)
+		terminal_shift_line(terminal, +1);
+	row[terminal->column] = utf8;
+	attr_row[terminal->column++] = terminal->curr_attr;
+
+	if (terminal->row + terminal->start + 1 > terminal->end)
+		terminal->end = terminal->row + terminal->start + 1;
+
+	/* cursor jump for wide character. */
+	if (is_wide(utf8))
+		row[terminal->column++].ch = 0x200B; /* space glyph */
+
+	if (utf8.ch != terminal->last_char.ch)
+		terminal->last_char = utf8;
+}
+
+static void
+escape_append_utf8(struct terminal *terminal, union utf8_char utf8)
+{
+	int len, i;
+
+	if ((utf8.byte[0] & 0x80) == 0x00)       len = 1;
+	else if ((utf8.byte[0] & 0xE0) == 0xC0)  len = 2;
+	else if ((utf8.byte[0] & 0xF0) == 0xE0)  len = 3;
+	else if ((utf8.byte[0] & 0xF8) == 0xF0)  len = 4;
+	else                                     len = 1;  /* Invalid, cannot happen */
+
+	if (terminal->escape_length + len <= MAX_ESCAPE) {
+		for (i = 0; i < len; i++)
+			terminal->escape[terminal->escape_length + i] = utf8.byte[i];
+		terminal->escape_length += len;
+	} else if (terminal->escape_length < MAX_ESCAPE) {
+		terminal->escape[terminal->escape_length++] = 0;
+	}
+}
+
+void
+terminal_data(struct terminal *terminal, const char *data, size_t length)
+{
+	unsigned int i;
+	union utf8_char utf8;
+	enum utf8_state parser_state;
+
+	/* New output snaps the view back to the bottom */
+	if (length > 0 && terminal->view)
+		terminal_scroll_view(terminal, -(int) terminal->view);
+
+	for (i = 0; i < length; i++) {
+		parser_state =
+			utf8_next_char(&terminal->state_machine, data[i]);
+		switch(parser_state) {
+		case utf8state_accept:
+			utf8.ch = terminal->state_machine.s.ch;
+			break;
+		case utf8state_reject:
+			/* the unicode replacement character */
+			utf8.byte[0] = 0xEF;
+			utf8.byte[1] = 0xBF;
+			utf8.byte[2] = 0xBD;
+			utf8.byte[3] = 0x00;
+			break;
+		default:
+			continue;
+		}
+
+		/* assume escape codes never use non-ASCII characters */
+		switch (terminal->state) {
+		case escape_state_escape:
+			escape_append_utf8(terminal, utf8);
+			switch (utf8.byte[0]) {
+			case 'P':  /* DCS */
+				terminal->state = escape_state_dcs;
+				break;
+			case '[':  /* CSI */
+				terminal->state = escape_state_csi;
+				break;
+			case ']':  /* OSC */
+				terminal->state = escape_state_osc;
+				break;
+			case '#':
+			case '(':
+			case ')':  /* special */
+				terminal->state = escape_state_special;
+				break;
+			case '^':  /* PM (not implemented) */
+			case '_':  /* APC (not implemented) */
+				terminal->state = escape_state_ignore;
+				break;
+			default:
+				terminal->state = escape_state_normal;
+				handle_non_csi_escape(terminal, utf8.byte[0]);
+				break;
+			}
+			continue;
+		case escape_state_csi:
+			if (handle_special_char(terminal, utf8.byte[0]) != 0) {
+				/* do nothing */
+			} else if (utf8.byte[0] == '?') {
+				terminal->escape_flags |= ESC_FLAG_WHAT;
+			} else if (utf8.byte[0] == '>') {
+				terminal->escape_flags |= ESC_FLAG_GT;
+			} else if (utf8.byte[0] == '!') {
+				terminal->escape_flags |= ESC_FLAG_BANG;
+			} else if (utf8.byte[0] == '$') {
+				terminal->escape_flags |= ESC_FLAG_CASH;
+			} else if (utf8.byte[0] == '\'') {
+				terminal->escape_flags |= ESC_FLAG_SQUOTE;
+			} else if (utf8.byte[0] == '"') {
+				terminal->escape_flags |= ESC_FLAG_DQUOTE;
+			} else if (utf8.byte[0] == ' ') {
+				terminal->escape_flags |= ESC_FLAG_SPACE;
+			} else {
+				escape_append_utf8(terminal, utf8);
+				if (terminal->escape_length >= MAX_ESCAPE)
+					terminal->state = escape_state_normal;
+			}
+
+			if (isalpha(utf8.byte[0]) || utf8.byte[0] == '@' ||
+				utf8.byte[0] == '`')
+			{
+				terminal->state = escape_state_normal;
+				handle_escape(terminal);
+			} else {
+			}
+			continue;
+		case escape_state_inner_escape:
+			if (utf8.byte[0] == '\\') {
+				terminal->state = escape_state_normal;
+				if (terminal->outer_state == escape_state_dcs) {
+					handle_dcs(terminal);
+				} else if (terminal->outer_state == escape_state_osc) {
+					handle_osc(terminal);
+				}
+			} else if (utf8.byte[0] == '\e') {
+				terminal->state = terminal->outer_state;
+				escape_append_utf8(terminal, utf8);
+				if (terminal->escape_length >= MAX_ESCAPE)
+					terminal->state = escape_state_normal;
+			} else {
+				terminal->state = terminal->outer_state;
+				if (terminal->escape_length < MAX_ESCAPE)
+					terminal->escape[terminal->escape_length++] = '\e';
+				escape_append_utf8(terminal, utf8);
+				if (terminal->escape_length >= MAX_ESCAPE)
+					terminal->state = escape_state_normal;
+			}
+			continue;
+		case escape_state_dcs:
+		case escape_state_osc:
+		case escape_state_ignore:
+			if (utf8.byte[0] == '\e') {
+				terminal->outer_state = terminal->state;
+				terminal->state = escape_state_inner_escape;
+			} else if (utf8.byte[0] == '\a' && terminal->state == escape_state_osc) {
+				terminal->state = escape_state_normal;
+				handle_osc(terminal);
+			} else {
+				escape_append_utf8(terminal, utf8);
+				if (terminal->escape_length >= MAX_ESCAPE)
+					terminal->state = escape_state_normal;
+			}
+			continue;
+		case escape_state_special:
+			escape_append_utf8(terminal, utf8);
+			terminal->state = escape_state_normal;
+			if (isdigit(utf8.byte[0]) || isalpha(utf8.byte[0])) {
+				handle_special_escape(terminal, terminal->escape[1],
+				                      utf8.byte[0]);
+			}
+			continue;
+		default:
+			break;
+		}
+
+		/* this is valid, because ASCII characters are never used to
+		 * introduce a multibyte sequence in UTF-8 */
+		if (utf8.byte[0] == '\e') {
+			terminal->state = escape_state_escape;
+			terminal->outer_state = escape_state_normal;
+			terminal->escape[0] = '\e';
+			terminal->escape_length = 1;
+			terminal->escape_flags = 0;
+		} else {
+			handle_char(terminal, utf8);
+		} /* if */
+	} /* for */
+}
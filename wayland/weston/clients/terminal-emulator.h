@@ -0,0 +1,254 @@
+/*
+ * Copyright © 2008 Kristian Høgsberg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef WESTON_TERMINAL_EMULATOR_H
+#define WESTON_TERMINAL_EMULATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <cairo.h>
+
+#include <wayland-client.h>
+
+#include "window.h"
+
+#define ATTRMASK_BOLD		0x01
+#define ATTRMASK_UNDERLINE	0x02
+#define ATTRMASK_BLINK		0x04
+#define ATTRMASK_INVERSE	0x08
+#define ATTRMASK_CONCEALED	0x10
+
+/* Buffer sizes */
+#define MAX_RESPONSE		256
+#define MAX_ESCAPE		255
+
+/* Terminal modes */
+#define MODE_SHOW_CURSOR	0x00000001
+#define MODE_INVERSE		0x00000002
+#define MODE_AUTOWRAP		0x00000004
+#define MODE_AUTOREPEAT		0x00000008
+#define MODE_LF_NEWLINE		0x00000010
+#define MODE_IRM		0x00000020
+#define MODE_DELETE_SENDS_DEL	0x00000040
+#define MODE_ALT_SENDS_ESC	0x00000080
+
+/* Rows of the line store, must be a power of two */
+#define TERMINAL_BUFFER_HEIGHT	1024
+
+/* Line id returned for rows decoded from the scrollback history */
+#define TERMINAL_NO_LINE	0xffffffff
+
+union utf8_char {
+	unsigned char byte[4];
+	uint32_t ch;
+};
+
+enum utf8_state {
+	utf8state_start,
+	utf8state_accept,
+	utf8state_reject,
+	utf8state_expect3,
+	utf8state_expect2,
+	utf8state_expect1
+};
+
+struct utf8_state_machine {
+	enum utf8_state state;
+	int len;
+	union utf8_char s;
+	uint32_t unicode;
+};
+
+struct char_sub {
+	union utf8_char match;
+	union utf8_char replace;
+};
+/* Set last char_sub match to NULL char */
+typedef struct char_sub *character_set;
+
+struct key_map {
+	int sym;
+	int num;
+	char escape;
+	char code;
+};
+/* Set last key_sub sym to NULL */
+typedef struct key_map *keyboard_mode;
+
+extern struct key_map KM_NORMAL[];
+extern struct key_map KM_APPLICATION[];
+
+struct terminal_color { double r, g, b, a; };
+struct attr {
+	unsigned char fg, bg;
+	char a;        /* attributes format:
+	                * 76543210
+			*    cilub */
+	char s;        /* in selection */
+};
+struct color_scheme {
+	struct terminal_color palette[16];
+	char border;
+	struct attr default_attr;
+};
+
+enum escape_state {
+	escape_state_normal = 0,
+	escape_state_escape,
+	escape_state_dcs,
+	escape_state_csi,
+	escape_state_osc,
+	escape_state_inner_escape,
+	escape_state_ignore,
+	escape_state_special
+};
+
+struct history_line;
+
+/* Rows that fall off the top of the line store are kept run-length
+ * encoded in a ring of at most size lines, oldest first. */
+struct terminal_history {
+	struct history_line **lines;
+	uint32_t first, count, size;
+};
+
+struct terminal {
+	struct window *window;
+	struct widget *widget;
+	struct display *display;
+	char *title;
+	union utf8_char *data;
+	struct task io_task;
+	char *tab_ruler;
+	struct attr *data_attr;
+	struct attr curr_attr;
+	uint32_t mode;
+	char origin_mode;
+	char saved_origin_mode;
+	struct attr saved_attr;
+	union utf8_char last_char;
+	int margin_top, margin_bottom;
+	character_set cs, g0, g1;
+	character_set saved_cs, saved_g0, saved_g1;
+	keyboard_mode key_mode;
+	int data_pitch, attr_pitch;  /* The width in bytes of a line */
+	int width, height, row, column, max_width;
+	uint32_t buffer_height;
+	uint32_t start, end;
+	uint32_t *line_map;	/* ring slot -> line of data/data_attr */
+	uint32_t *dirty;	/* bit per line, set when the line changes */
+	uint32_t scrollback;	/* lines kept in the ring above the screen */
+	uint32_t view;		/* lines the view is scrolled back by */
+	struct terminal_history history;
+	union utf8_char *history_data;	/* a decoded history line */
+	struct attr *history_attr;
+	wl_fixed_t smooth_scroll;
+	int saved_row, saved_column;
+	int send_cursor_position;
+	int fd, master;
+	uint32_t modifiers;
+	char escape[MAX_ESCAPE+1];
+	int escape_length;
+	enum escape_state state;
+	enum escape_state outer_state;
+	int escape_flags;
+	struct utf8_state_machine state_machine;
+	int margin;
+	struct color_scheme *color_scheme;
+	struct terminal_color color_table[256];
+	cairo_font_extents_t extents;
+	double average_width;
+	cairo_scaled_font_t *font_normal, *font_bold;
+	uint32_t hide_cursor_serial;
+	int size_in_title;
+
+	/* The text area is rendered into one of two surfaces and rows
+	 * that did not change are copied over from the other one. */
+	cairo_surface_t *text_surface[2];
+	uint32_t *drawn_line[2];
+	int *line_row;
+	int current, text_width, text_height, text_scale;
+	int drawn_row, drawn_column;
+	int drawn_selection[4];
+	uint32_t drawn_mode;
+	cairo_glyph_t glyph_cache[2][128][4];
+	int8_t glyph_count[2][128];
+
+	struct wl_data_source *selection;
+	uint32_t click_time;
+	int dragging, click_count;
+	int selection_start_x, selection_start_y;
+	int selection_end_x, selection_end_y;
+	int selection_start_row, selection_start_col;
+	int selection_end_row, selection_end_col;
+	struct wl_list link;
+};
+
+void
+terminal_init(struct terminal *terminal);
+
+void
+terminal_resize_cells(struct terminal *terminal, int width, int height);
+
+void
+terminal_free_cells(struct terminal *terminal);
+
+void
+terminal_data(struct terminal *terminal, const char *data, size_t length);
+
+void
+terminal_write(struct terminal *terminal, const char *data, size_t length);
+
+bool
+is_wide(union utf8_char utf8);
+
+uint32_t
+terminal_get_view_row(struct terminal *terminal, int row,
+		      union utf8_char **data, struct attr **attr);
+
+int
+terminal_scroll_view(struct terminal *terminal, int lines);
+
+bool
+terminal_line_is_dirty(struct terminal *terminal, uint32_t line);
+
+void
+terminal_clear_dirty(struct terminal *terminal);
+
+/* Provided by the frontend */
+
+void
+terminal_resize(struct terminal *terminal, int columns, int rows);
+
+void
+terminal_schedule_resize(struct terminal *terminal,
+			 int32_t width, int32_t height);
+
+void
+terminal_get_allocation(struct terminal *terminal,
+			struct rectangle *allocation);
+
+void
+terminal_set_title(struct terminal *terminal, const char *title);
+
+#endif
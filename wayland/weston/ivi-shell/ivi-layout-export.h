@@ -567,6 +567,47 @@ struct ivi_layout_interface {
 				void *target, size_t size,
 				int32_t x, int32_t y,
 				int32_t width, int32_t height);
+
+	/**
+	 * \brief get a handle of ivi_surface
+	 *
+	 * Unlike the id, a handle only ever refers to the ivi_surface it was
+	 * taken from. Once that ivi_surface is destroyed, the handle no
+	 * longer resolves, even if a new ivi_surface is created with the
+	 * same id.
+	 *
+	 * \return handle of ivi_surface
+	 * \return 0 if the method call was failed
+	 */
+	uint64_t (*get_handle_of_surface)(struct ivi_layout_surface *ivisurf);
+
+	/**
+	 * \brief get ivi_layout_surface from a handle of ivi_surface
+	 *
+	 * \return (struct ivi_layout_surface *)
+	 *              if the method call was successful
+	 * \return NULL if the ivi_surface of the handle does not exist anymore
+	 */
+	struct ivi_layout_surface *
+		(*get_surface_from_handle)(uint64_t handle);
+
+	/**
+	 * \brief get a handle of ivi_layer
+	 *
+	 * \return handle of ivi_layer
+	 * \return 0 if the method call was failed
+	 */
+	uint64_t (*get_handle_of_layer)(struct ivi_layout_layer *ivilayer);
+
+	/**
+	 * \brief get ivi_layout_layer from a handle of ivi_layer
+	 *
+	 * \return (struct ivi_layout_layer *)
+	 *              if the method call was successful
+	 * \return NULL if the ivi_layer of the handle does not exist anymore
+	 */
+	struct ivi_layout_layer *
+		(*get_layer_from_handle)(uint64_t handle);
 };
 
 #ifdef __cplusplus
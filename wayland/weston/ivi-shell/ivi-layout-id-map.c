@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ivi-layout-id-map.h"
+
+#define ID_MAP_MIN_SIZE 16
+
+/* Marks a slot whose entry was removed, so that probing goes past it. */
+static char tombstone;
+#define TOMBSTONE ((void *)&tombstone)
+
+static uint32_t
+id_hash(uint32_t id)
+{
+	/* ivi ids are often small and sequential, so mix the bits */
+	id ^= id >> 16;
+	id *= 0x45d9f3b;
+	id ^= id >> 16;
+
+	return id;
+}
+
+static struct ivi_layout_id_map_entry *
+find_slot(const struct ivi_layout_id_map *map, uint32_t id)
+{
+	uint32_t mask = map->size - 1;
+	uint32_t i = id_hash(id) & mask;
+	struct ivi_layout_id_map_entry *entry;
+
+	for (;;) {
+		entry = &map->entries[i];
+		if (entry->object == NULL)
+			return NULL;
+		if (entry->object != TOMBSTONE && entry->id == id)
+			return entry;
+		i = (i + 1) & mask;
+	}
+}
+
+static void
+place(struct ivi_layout_id_map *map, uint32_t id, void *object)
+{
+	uint32_t mask = map->size - 1;
+	uint32_t i = id_hash(id) & mask;
+
+	while (map->entries[i].object != NULL)
+		i = (i + 1) & mask;
+
+	map->entries[i].id = id;
+	map->entries[i].object = object;
+	map->count++;
+	map->used++;
+}
+
+/*
+ * Rebuilds the table without tombstones, growing it so that it stays
+ * at most half full after the next insertion.
+ */
+static int
+rehash(struct ivi_layout_id_map *map)
+{
+	struct ivi_layout_id_map_entry *old = map->entries;
+	uint32_t old_size = map->size;
+	uint32_t size = ID_MAP_MIN_SIZE;
+	uint32_t i;
+
+	while ((map->count + 1) * 2 > size)
+		size *= 2;
+
+	map->entries = calloc(size, sizeof *map->entries);
+	if (map->entries == NULL) {
+		map->entries = old;
+		return -1;
+	}
+
+	map->size = size;
+	map->count = 0;
+	map->used = 0;
+
+	for (i = 0; i < old_size; i++) {
+		if (old[i].object != NULL && old[i].object != TOMBSTONE)
+			place(map, old[i].id, old[i].object);
+	}
+
+	free(old);
+
+	return 0;
+}
+
+void
+ivi_layout_id_map_init(struct ivi_layout_id_map *map)
+{
+	memset(map, 0, sizeof *map);
+}
+
+void
+ivi_layout_id_map_release(struct ivi_layout_id_map *map)
+{
+	free(map->entries);
+	ivi_layout_id_map_init(map);
+}
+
+int
+ivi_layout_id_map_insert(struct ivi_layout_id_map *map,
+			 uint32_t id, void *object)
+{
+	struct ivi_layout_id_map_entry *entry;
+
+	if (map->size != 0) {
+		entry = find_slot(map, id);
+		if (entry != NULL) {
+			entry->object = object;
+			return 0;
+		}
+	}
+
+	/* keep the load, tombstones included, under 3/4 */
+	if ((map->used + 1) * 4 > map->size * 3) {
+		if (rehash(map) < 0)
+			return -1;
+	}
+
+	place(map, id, object);
+
+	return 0;
+}
+
+void
+ivi_layout_id_map_remove(struct ivi_layout_id_map *map,
+			 uint32_t id, void *object)
+{
+	struct ivi_layout_id_map_entry *entry;
+
+	if (map->size == 0)
+		return;
+
+	entry = find_slot(map, id);
+	if (entry == NULL || entry->object != object)
+		return;
+
+	entry->object = TOMBSTONE;
+	map->count--;
+}
+
+void *
+ivi_layout_id_map_lookup(const struct ivi_layout_id_map *map, uint32_t id)
+{
+	struct ivi_layout_id_map_entry *entry;
+
+	if (map->size == 0)
+		return NULL;
+
+	entry = find_slot(map, id);
+	if (entry == NULL)
+		return NULL;
+
+	return entry->object;
+}
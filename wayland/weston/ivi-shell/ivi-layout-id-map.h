@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IVI_LAYOUT_ID_MAP_H_
+#define _IVI_LAYOUT_ID_MAP_H_
+
+#include <stdint.h>
+
+/**
+ * Open-addressing hash table from ivi id to ivi_layout_surface or
+ * ivi_layout_layer, so that lookups by id do not walk the surface and
+ * layer lists. Collisions are resolved by linear probing; removed entries
+ * are left as tombstones until the next rehash.
+ */
+struct ivi_layout_id_map_entry {
+	uint32_t id;
+	void *object;
+};
+
+struct ivi_layout_id_map {
+	struct ivi_layout_id_map_entry *entries;
+	uint32_t size;		/* number of slots, a power of two */
+	uint32_t count;		/* live entries */
+	uint32_t used;		/* live entries and tombstones */
+};
+
+void
+ivi_layout_id_map_init(struct ivi_layout_id_map *map);
+
+void
+ivi_layout_id_map_release(struct ivi_layout_id_map *map);
+
+/**
+ * Maps id to object, replacing any previous mapping of id.
+ *
+ * \return 0 on success, -1 if memory could not be allocated
+ */
+int
+ivi_layout_id_map_insert(struct ivi_layout_id_map *map,
+			 uint32_t id, void *object);
+
+/**
+ * Removes the mapping of id, but only if it still refers to object.
+ */
+void
+ivi_layout_id_map_remove(struct ivi_layout_id_map *map,
+			 uint32_t id, void *object);
+
+void *
+ivi_layout_id_map_lookup(const struct ivi_layout_id_map *map, uint32_t id);
+
+#endif /* _IVI_LAYOUT_ID_MAP_H_ */
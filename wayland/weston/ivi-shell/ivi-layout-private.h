@@ -28,12 +28,27 @@
 
 #include "compositor.h"
 #include "ivi-layout-export.h"
+#include "ivi-layout-id-map.h"
+
+/**
+ * What ivi_layout_commit_changes has to recompute for an ivi_surface or
+ * ivi_layer. Bits are collected from the notification event_mask on each
+ * commit and are only cleared once the node has been updated, so changes
+ * made while a node is invisible are applied when it becomes visible.
+ */
+enum ivi_layout_dirty {
+	IVI_LAYOUT_DIRTY_OPACITY   = (1 << 0),
+	IVI_LAYOUT_DIRTY_TRANSFORM = (1 << 1),
+	IVI_LAYOUT_DIRTY_ALL       = IVI_LAYOUT_DIRTY_OPACITY |
+				     IVI_LAYOUT_DIRTY_TRANSFORM
+};
 
 struct ivi_layout_surface {
 	struct wl_list link;
 	struct wl_signal property_changed;
 	int32_t update_count;
 	uint32_t id_surface;
+	uint32_t generation;
 
 	struct ivi_layout *layout;
 	struct ivi_layout_layer *on_layer;
@@ -52,12 +67,26 @@ struct ivi_layout_surface {
 		struct wl_list link;
 		struct wl_list layer_list;
 	} order;
+
+	uint32_t dirty;
+
+	struct {
+		/* surface-local to layer-local coordinates */
+		struct weston_matrix matrix;
+		/* state of the ivi_layer when the view was last updated */
+		uint32_t layer_transform_serial;
+		uint32_t layer_opacity_serial;
+		/* weston_surface size the mask was computed for */
+		int32_t surface_width;
+		int32_t surface_height;
+	} cached;
 };
 
 struct ivi_layout_layer {
 	struct wl_list link;
 	struct wl_signal property_changed;
 	uint32_t id_layer;
+	uint32_t generation;
 
 	struct ivi_layout *layout;
 	struct ivi_layout_screen *on_screen;
@@ -77,6 +106,22 @@ struct ivi_layout_layer {
 	} order;
 
 	int32_t ref_count;
+
+	uint32_t dirty;
+
+	struct {
+		/* layer-local to global coordinates */
+		struct weston_matrix matrix;
+		/* bumped whenever the matrix or the opacity is updated */
+		uint32_t transform_serial;
+		uint32_t opacity_serial;
+		/* weston_output geometry the matrix was computed for */
+		struct weston_output *output;
+		int32_t output_x;
+		int32_t output_y;
+		int32_t output_width;
+		int32_t output_height;
+	} cached;
 };
 
 struct ivi_layout {
@@ -86,6 +131,16 @@ struct ivi_layout {
 	struct wl_list layer_list;
 	struct wl_list screen_list;
 
+	/* id -> ivi_layout_surface / ivi_layout_layer */
+	struct ivi_layout_id_map surface_map;
+	struct ivi_layout_id_map layer_map;
+
+	/* stamped into every surface and layer created, see handles */
+	uint32_t generation;
+
+	/* source of ivi_layer cached serials, never 0 */
+	uint32_t serial;
+
 	struct {
 		struct wl_signal created;
 		struct wl_signal removed;
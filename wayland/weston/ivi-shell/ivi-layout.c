@@ -49,7 +49,9 @@
  *    frame just before the cancellation.
  *
  * 4/ According properties, set transformation by using weston_matrix and
- *    weston_view per ivi_surfaces and ivi_layers in while loop.
+ *    weston_view per ivi_surfaces and ivi_layers in while loop. Only
+ *    ivi_surfaces whose properties, or the properties of whose ivi_layer,
+ *    changed since the last commit are updated. See enum ivi_layout_dirty.
  * 5/ Set damage and trigger transform by using weston_view_geometry_dirty.
  * 6/ Notify update of properties.
  * 7/ Trigger composition by weston_compositor_schedule_repaint.
@@ -108,34 +110,39 @@ get_instance(void)
 }
 
 /**
- * Internal API to add/remove an ivi_layer to/from ivi_screen.
+ * Internal API to look up an ivi_surface/ivi_layer by its id.
  */
 static struct ivi_layout_surface *
-get_surface(struct wl_list *surf_list, uint32_t id_surface)
+get_surface(struct ivi_layout *layout, uint32_t id_surface)
 {
-	struct ivi_layout_surface *ivisurf;
-
-	wl_list_for_each(ivisurf, surf_list, link) {
-		if (ivisurf->id_surface == id_surface) {
-			return ivisurf;
-		}
-	}
-
-	return NULL;
+	return ivi_layout_id_map_lookup(&layout->surface_map, id_surface);
 }
 
 static struct ivi_layout_layer *
-get_layer(struct wl_list *layer_list, uint32_t id_layer)
+get_layer(struct ivi_layout *layout, uint32_t id_layer)
 {
-	struct ivi_layout_layer *ivilayer;
+	return ivi_layout_id_map_lookup(&layout->layer_map, id_layer);
+}
 
-	wl_list_for_each(ivilayer, layer_list, link) {
-		if (ivilayer->id_layer == id_layer) {
-			return ivilayer;
-		}
-	}
+/**
+ * Handles given to controllers pair the id with the generation of the
+ * object, so a handle kept across the destruction of an ivi_surface or
+ * ivi_layer does not resolve to a later one created with the same id.
+ * Generation 0 is never used, so handle 0 is always invalid.
+ */
+static uint32_t
+next_generation(struct ivi_layout *layout)
+{
+	if (++layout->generation == 0)
+		++layout->generation;
 
-	return NULL;
+	return layout->generation;
+}
+
+static uint64_t
+make_handle(uint32_t generation, uint32_t id)
+{
+	return ((uint64_t)generation << 32) | id;
 }
 
 static struct weston_view *
@@ -185,6 +192,8 @@ ivi_layout_surface_destroy(struct ivi_layout_surface *ivisurf)
 	wl_list_remove(&ivisurf->pending.link);
 	wl_list_remove(&ivisurf->order.link);
 	wl_list_remove(&ivisurf->link);
+	ivi_layout_id_map_remove(&layout->surface_map,
+				 ivisurf->id_surface, ivisurf);
 
 	wl_signal_emit(&layout->surface_notification.removed, ivisurf);
 
@@ -455,12 +464,65 @@ calc_inverse_matrix_transform(const struct weston_matrix *matrix,
 }
 
 /**
- * This computes the whole transformation matrix:m from surface-local
- * coordinates to multi-screen coordinates, which are global coordinates.
- * It is assumed that weston_view::geometry.{x,y} are zero.
- *
- * Additionally, this computes the mask on surface-local coordinates as an
- * ivi_rectangle. This can be set to weston_view_set_mask.
+ * The whole transformation matrix from surface-local coordinates to
+ * multi-screen coordinates, which are global coordinates, is computed by
+ * three steps,
+ * - surface-local coordinates to layer-local coordinates
+ * - layer-local coordinates to single screen-local coordinates
+ * - single screen-local coordinates to multi-screen coordinates.
+ * The first step only depends on the ivi_surface and the others only on
+ * the ivi_layer and its screen, so both parts are cached separately and
+ * multiplied when either changes. It is assumed that
+ * weston_view::geometry.{x,y} are zero.
+ */
+static void
+calc_surface_to_layer_matrix(struct ivi_layout_surface *ivisurf,
+			     struct weston_matrix *m)
+{
+	const struct ivi_layout_surface_properties *sp = &ivisurf->prop;
+	struct ivi_rectangle surface_source_rect = { sp->source_x,
+						     sp->source_y,
+						     sp->source_width,
+						     sp->source_height };
+	struct ivi_rectangle surface_dest_rect =   { sp->dest_x,
+						     sp->dest_y,
+						     sp->dest_width,
+						     sp->dest_height };
+
+	weston_matrix_init(m);
+	calc_transformation_matrix(&surface_source_rect,
+				   &surface_dest_rect,
+				   sp->orientation, m);
+}
+
+static void
+calc_layer_to_global_matrix(struct ivi_layout_screen *iviscrn,
+			    struct ivi_layout_layer *ivilayer,
+			    struct weston_matrix *m)
+{
+	const struct ivi_layout_layer_properties *lp = &ivilayer->prop;
+	struct weston_output *output = iviscrn->output;
+	struct ivi_rectangle layer_source_rect =   { lp->source_x,
+						     lp->source_y,
+						     lp->source_width,
+						     lp->source_height };
+	struct ivi_rectangle layer_dest_rect =     { lp->dest_x,
+						     lp->dest_y,
+						     lp->dest_width,
+						     lp->dest_height };
+
+	weston_matrix_init(m);
+	calc_transformation_matrix(&layer_source_rect,
+				   &layer_dest_rect,
+				   lp->orientation, m);
+
+	weston_matrix_translate(m, output->x, output->y, 0.0f);
+}
+
+/**
+ * This computes the mask on surface-local coordinates as an ivi_rectangle
+ * from the whole transformation matrix:m. This can be set to
+ * weston_view_set_mask.
  *
  * The mask is computed by following steps
  * - destination rectangle of layer is transformed to multi-screen coordinates,
@@ -478,12 +540,11 @@ calc_inverse_matrix_transform(const struct weston_matrix *matrix,
  *   source rectangle of ivi_surface.
  */
 static void
-calc_surface_to_global_matrix_and_mask_to_weston_surface(
-	struct ivi_layout_screen  *iviscrn,
-	struct ivi_layout_layer *ivilayer,
-	struct ivi_layout_surface *ivisurf,
-	struct weston_matrix *m,
-	struct ivi_rectangle *result)
+calc_mask_to_weston_surface(struct ivi_layout_screen  *iviscrn,
+			    struct ivi_layout_layer *ivilayer,
+			    struct ivi_layout_surface *ivisurf,
+			    const struct weston_matrix *m,
+			    struct ivi_rectangle *result)
 {
 	const struct ivi_layout_surface_properties *sp = &ivisurf->prop;
 	const struct ivi_layout_layer_properties *lp = &ivilayer->prop;
@@ -496,18 +557,6 @@ calc_surface_to_global_matrix_and_mask_to_weston_surface(
 						     sp->source_y,
 						     sp->source_width,
 						     sp->source_height };
-	struct ivi_rectangle surface_dest_rect =   { sp->dest_x,
-						     sp->dest_y,
-						     sp->dest_width,
-						     sp->dest_height };
-	struct ivi_rectangle layer_source_rect =   { lp->source_x,
-						     lp->source_y,
-						     lp->source_width,
-						     lp->source_height };
-	struct ivi_rectangle layer_dest_rect =     { lp->dest_x,
-						     lp->dest_y,
-						     lp->dest_width,
-						     lp->dest_height };
 	struct ivi_rectangle screen_dest_rect =    { output->x,
 						     output->y,
 						     output->width,
@@ -520,25 +569,6 @@ calc_surface_to_global_matrix_and_mask_to_weston_surface(
 	struct ivi_rectangle surface_result;
 	struct ivi_rectangle layer_dest_rect_in_global_intersected;
 
-	/*
-	 * the whole transformation matrix:m from surface-local
-	 * coordinates to global coordinates, which is computed by
-	 * two steps,
-	 * - surface-local coordinates to layer-local coordinates
-	 * - layer-local coordinates to single screen-local coordinates
-	 * - single screen-local coordinates to multi-screen coordinates,
-	 *   which are global coordinates.
-	 */
-	calc_transformation_matrix(&surface_source_rect,
-				   &surface_dest_rect,
-				   sp->orientation, m);
-
-	calc_transformation_matrix(&layer_source_rect,
-				   &layer_dest_rect,
-				   lp->orientation, m);
-
-	weston_matrix_translate(m, output->x, output->y, 0.0f);
-
 	/* this intersected ivi_rectangle would be used for masking
 	 * weston_surface
 	 */
@@ -559,6 +589,73 @@ calc_surface_to_global_matrix_and_mask_to_weston_surface(
 				      result);
 }
 
+static uint32_t
+dirty_from_event_mask(uint32_t event_mask)
+{
+	const uint32_t transform_mask = IVI_NOTIFICATION_SOURCE_RECT |
+					IVI_NOTIFICATION_DEST_RECT |
+					IVI_NOTIFICATION_DIMENSION |
+					IVI_NOTIFICATION_POSITION |
+					IVI_NOTIFICATION_ORIENTATION;
+	uint32_t dirty = 0;
+
+	if (event_mask & IVI_NOTIFICATION_OPACITY)
+		dirty |= IVI_LAYOUT_DIRTY_OPACITY;
+
+	if (event_mask & transform_mask)
+		dirty |= IVI_LAYOUT_DIRTY_TRANSFORM;
+
+	/* visibility, render order and anything else: redo everything */
+	if (event_mask & ~(IVI_NOTIFICATION_OPACITY | transform_mask))
+		dirty |= IVI_LAYOUT_DIRTY_ALL;
+
+	return dirty;
+}
+
+static uint32_t
+next_serial(struct ivi_layout *layout)
+{
+	if (++layout->serial == 0)
+		++layout->serial;
+
+	return layout->serial;
+}
+
+static void
+update_layer_prop(struct ivi_layout *layout,
+		  struct ivi_layout_screen *iviscrn,
+		  struct ivi_layout_layer *ivilayer)
+{
+	struct weston_output *output = iviscrn->output;
+
+	/*
+	 * the matrix and the masks of the views depend on where the output
+	 * is, and on which output the layer is
+	 */
+	if (ivilayer->cached.output != output ||
+	    ivilayer->cached.output_x != output->x ||
+	    ivilayer->cached.output_y != output->y ||
+	    ivilayer->cached.output_width != output->width ||
+	    ivilayer->cached.output_height != output->height)
+		ivilayer->dirty |= IVI_LAYOUT_DIRTY_TRANSFORM;
+
+	if (ivilayer->dirty & IVI_LAYOUT_DIRTY_TRANSFORM) {
+		calc_layer_to_global_matrix(iviscrn, ivilayer,
+					    &ivilayer->cached.matrix);
+		ivilayer->cached.transform_serial = next_serial(layout);
+		ivilayer->cached.output = output;
+		ivilayer->cached.output_x = output->x;
+		ivilayer->cached.output_y = output->y;
+		ivilayer->cached.output_width = output->width;
+		ivilayer->cached.output_height = output->height;
+	}
+
+	if (ivilayer->dirty & IVI_LAYOUT_DIRTY_OPACITY)
+		ivilayer->cached.opacity_serial = next_serial(layout);
+
+	ivilayer->dirty = 0;
+}
+
 static void
 update_prop(struct ivi_layout_screen  *iviscrn,
 	    struct ivi_layout_layer *ivilayer,
@@ -566,33 +663,57 @@ update_prop(struct ivi_layout_screen  *iviscrn,
 {
 	struct weston_view *tmpview;
 	struct ivi_rectangle r;
+	uint32_t dirty = ivisurf->dirty;
 	bool can_calc = true;
 
+	/* pick up changes of the ivi_layer since this view was updated */
+	if (ivisurf->cached.layer_transform_serial !=
+	    ivilayer->cached.transform_serial)
+		dirty |= IVI_LAYOUT_DIRTY_TRANSFORM;
+
+	if (ivisurf->cached.layer_opacity_serial !=
+	    ivilayer->cached.opacity_serial)
+		dirty |= IVI_LAYOUT_DIRTY_OPACITY;
+
+	/* the mask depends on the size of weston_surface */
+	if (ivisurf->cached.surface_width != ivisurf->surface->width ||
+	    ivisurf->cached.surface_height != ivisurf->surface->height)
+		dirty |= IVI_LAYOUT_DIRTY_TRANSFORM;
+
 	/*In case of no prop change, this just returns*/
-	if (!ivilayer->prop.event_mask && !ivisurf->prop.event_mask)
+	if (!dirty)
 		return;
 
-	update_opacity(ivilayer, ivisurf);
-
 	tmpview = get_weston_view(ivisurf);
 	assert(tmpview != NULL);
 
-	if (ivisurf->prop.source_width == 0 || ivisurf->prop.source_height == 0) {
-		weston_log("ivi-shell: source rectangle is not yet set by ivi_layout_surface_set_source_rectangle\n");
-		can_calc = false;
-	}
+	if (dirty & IVI_LAYOUT_DIRTY_OPACITY)
+		update_opacity(ivilayer, ivisurf);
 
-	if (ivisurf->prop.dest_width == 0 || ivisurf->prop.dest_height == 0) {
-		weston_log("ivi-shell: destination rectangle is not yet set by ivi_layout_surface_set_destination_rectangle\n");
-		can_calc = false;
+	if (dirty & IVI_LAYOUT_DIRTY_TRANSFORM) {
+		if (ivisurf->prop.source_width == 0 || ivisurf->prop.source_height == 0) {
+			weston_log("ivi-shell: source rectangle is not yet set by ivi_layout_surface_set_source_rectangle\n");
+			can_calc = false;
+		}
+
+		if (ivisurf->prop.dest_width == 0 || ivisurf->prop.dest_height == 0) {
+			weston_log("ivi-shell: destination rectangle is not yet set by ivi_layout_surface_set_destination_rectangle\n");
+			can_calc = false;
+		}
 	}
 
-	if (can_calc) {
+	if ((dirty & IVI_LAYOUT_DIRTY_TRANSFORM) && can_calc) {
+		if (ivisurf->dirty & IVI_LAYOUT_DIRTY_TRANSFORM)
+			calc_surface_to_layer_matrix(ivisurf,
+						     &ivisurf->cached.matrix);
+
 		wl_list_remove(&ivisurf->transform.link);
-		weston_matrix_init(&ivisurf->transform.matrix);
+		ivisurf->transform.matrix = ivisurf->cached.matrix;
+		weston_matrix_multiply(&ivisurf->transform.matrix,
+				       &ivilayer->cached.matrix);
 
-		calc_surface_to_global_matrix_and_mask_to_weston_surface(
-			iviscrn, ivilayer, ivisurf, &ivisurf->transform.matrix, &r);
+		calc_mask_to_weston_surface(iviscrn, ivilayer, ivisurf,
+					    &ivisurf->transform.matrix, &r);
 
 		weston_view_set_mask(tmpview, r.x, r.y, r.width, r.height);
 		wl_list_insert(&tmpview->geometry.transformation_list,
@@ -601,9 +722,16 @@ update_prop(struct ivi_layout_screen  *iviscrn,
 		weston_view_set_transform_parent(tmpview, NULL);
 	}
 
+	ivisurf->dirty = 0;
+	ivisurf->cached.layer_transform_serial = ivilayer->cached.transform_serial;
+	ivisurf->cached.layer_opacity_serial = ivilayer->cached.opacity_serial;
+	ivisurf->cached.surface_width = ivisurf->surface->width;
+	ivisurf->cached.surface_height = ivisurf->surface->height;
+
 	ivisurf->update_count++;
 
-	weston_view_geometry_dirty(tmpview);
+	if (dirty & IVI_LAYOUT_DIRTY_TRANSFORM)
+		weston_view_geometry_dirty(tmpview);
 
 	weston_surface_damage(ivisurf->surface);
 }
@@ -615,6 +743,16 @@ commit_changes(struct ivi_layout *layout)
 	struct ivi_layout_layer   *ivilayer = NULL;
 	struct ivi_layout_surface *ivisurf  = NULL;
 
+	/*
+	 * Collect what changed since the last commit. Invisible nodes keep
+	 * their dirty bits until they are visible again.
+	 */
+	wl_list_for_each(ivilayer, &layout->layer_list, link)
+		ivilayer->dirty |= dirty_from_event_mask(ivilayer->prop.event_mask);
+
+	wl_list_for_each(ivisurf, &layout->surface_list, link)
+		ivisurf->dirty |= dirty_from_event_mask(ivisurf->prop.event_mask);
+
 	wl_list_for_each(iviscrn, &layout->screen_list, link) {
 		wl_list_for_each(ivilayer, &iviscrn->order.layer_list, order.link) {
 			/*
@@ -624,6 +762,8 @@ commit_changes(struct ivi_layout *layout)
 			if (ivilayer->prop.visibility == false)
 				continue;
 
+			update_layer_prop(layout, iviscrn, ivilayer);
+
 			wl_list_for_each(ivisurf, &ivilayer->order.surface_list, order.link) {
 				/*
 				 * If ivilayer is invisible, weston_view of ivisurf doesn't
@@ -1012,31 +1152,59 @@ ivi_layout_get_id_of_layer(struct ivi_layout_layer *ivilayer)
 static struct ivi_layout_layer *
 ivi_layout_get_layer_from_id(uint32_t id_layer)
 {
-	struct ivi_layout *layout = get_instance();
-	struct ivi_layout_layer *ivilayer = NULL;
+	return get_layer(get_instance(), id_layer);
+}
 
-	wl_list_for_each(ivilayer, &layout->layer_list, link) {
-		if (ivilayer->id_layer == id_layer) {
-			return ivilayer;
-		}
+struct ivi_layout_surface *
+ivi_layout_get_surface_from_id(uint32_t id_surface)
+{
+	return get_surface(get_instance(), id_surface);
+}
+
+static uint64_t
+ivi_layout_get_handle_of_surface(struct ivi_layout_surface *ivisurf)
+{
+	if (ivisurf == NULL) {
+		weston_log("ivi_layout_get_handle_of_surface: invalid argument\n");
+		return 0;
 	}
 
-	return NULL;
+	return make_handle(ivisurf->generation, ivisurf->id_surface);
 }
 
-struct ivi_layout_surface *
-ivi_layout_get_surface_from_id(uint32_t id_surface)
+static struct ivi_layout_surface *
+ivi_layout_get_surface_from_handle(uint64_t handle)
 {
-	struct ivi_layout *layout = get_instance();
-	struct ivi_layout_surface *ivisurf = NULL;
+	struct ivi_layout_surface *ivisurf;
 
-	wl_list_for_each(ivisurf, &layout->surface_list, link) {
-		if (ivisurf->id_surface == id_surface) {
-			return ivisurf;
-		}
+	ivisurf = get_surface(get_instance(), (uint32_t)handle);
+	if (ivisurf == NULL || ivisurf->generation != (uint32_t)(handle >> 32))
+		return NULL;
+
+	return ivisurf;
+}
+
+static uint64_t
+ivi_layout_get_handle_of_layer(struct ivi_layout_layer *ivilayer)
+{
+	if (ivilayer == NULL) {
+		weston_log("ivi_layout_get_handle_of_layer: invalid argument\n");
+		return 0;
 	}
 
-	return NULL;
+	return make_handle(ivilayer->generation, ivilayer->id_layer);
+}
+
+static struct ivi_layout_layer *
+ivi_layout_get_layer_from_handle(uint64_t handle)
+{
+	struct ivi_layout_layer *ivilayer;
+
+	ivilayer = get_layer(get_instance(), (uint32_t)handle);
+	if (ivilayer == NULL || ivilayer->generation != (uint32_t)(handle >> 32))
+		return NULL;
+
+	return ivilayer;
 }
 
 static int32_t
@@ -1270,7 +1438,7 @@ ivi_layout_layer_create_with_dimension(uint32_t id_layer,
 	struct ivi_layout *layout = get_instance();
 	struct ivi_layout_layer *ivilayer = NULL;
 
-	ivilayer = get_layer(&layout->layer_list, id_layer);
+	ivilayer = get_layer(layout, id_layer);
 	if (ivilayer != NULL) {
 		weston_log("id_layer is already created\n");
 		++ivilayer->ref_count;
@@ -1283,10 +1451,18 @@ ivi_layout_layer_create_with_dimension(uint32_t id_layer,
 		return NULL;
 	}
 
+	if (ivi_layout_id_map_insert(&layout->layer_map, id_layer, ivilayer) < 0) {
+		weston_log("fails to allocate memory\n");
+		free(ivilayer);
+		return NULL;
+	}
+
 	ivilayer->ref_count = 1;
 	wl_signal_init(&ivilayer->property_changed);
 	ivilayer->layout = layout;
 	ivilayer->id_layer = id_layer;
+	ivilayer->generation = next_generation(layout);
+	ivilayer->dirty = IVI_LAYOUT_DIRTY_ALL;
 
 	init_layer_properties(&ivilayer->prop, width, height);
 
@@ -1325,6 +1501,8 @@ ivi_layout_layer_destroy(struct ivi_layout_layer *ivilayer)
 	wl_list_remove(&ivilayer->pending.link);
 	wl_list_remove(&ivilayer->order.link);
 	wl_list_remove(&ivilayer->link);
+	ivi_layout_id_map_remove(&layout->layer_map,
+				 ivilayer->id_layer, ivilayer);
 
 	free(ivilayer);
 }
@@ -1907,7 +2085,7 @@ ivi_layout_surface_create(struct weston_surface *wl_surface,
 		return NULL;
 	}
 
-	ivisurf = get_surface(&layout->surface_list, id_surface);
+	ivisurf = get_surface(layout, id_surface);
 	if (ivisurf != NULL) {
 		if (ivisurf->surface != NULL) {
 			weston_log("id_surface(%d) is already created\n", id_surface);
@@ -1921,9 +2099,17 @@ ivi_layout_surface_create(struct weston_surface *wl_surface,
 		return NULL;
 	}
 
+	if (ivi_layout_id_map_insert(&layout->surface_map, id_surface, ivisurf) < 0) {
+		weston_log("fails to allocate memory\n");
+		free(ivisurf);
+		return NULL;
+	}
+
 	wl_signal_init(&ivisurf->property_changed);
 	ivisurf->id_surface = id_surface;
+	ivisurf->generation = next_generation(layout);
 	ivisurf->layout = layout;
+	ivisurf->dirty = IVI_LAYOUT_DIRTY_ALL;
 
 	ivisurf->surface = wl_surface;
 
@@ -1964,6 +2150,9 @@ ivi_layout_init_with_compositor(struct weston_compositor *ec)
 	wl_list_init(&layout->layer_list);
 	wl_list_init(&layout->screen_list);
 
+	ivi_layout_id_map_init(&layout->surface_map);
+	ivi_layout_id_map_init(&layout->layer_map);
+
 	wl_signal_init(&layout->layer_notification.created);
 	wl_signal_init(&layout->layer_notification.removed);
 
@@ -2049,6 +2238,14 @@ static struct ivi_layout_interface ivi_layout_interface = {
 	 */
 	.surface_get_size		= ivi_layout_surface_get_size,
 	.surface_dump			= ivi_layout_surface_dump,
+
+	/**
+	 * generation-counted handles
+	 */
+	.get_handle_of_surface		= ivi_layout_get_handle_of_surface,
+	.get_surface_from_handle	= ivi_layout_get_surface_from_handle,
+	.get_handle_of_layer		= ivi_layout_get_handle_of_layer,
+	.get_layer_from_handle		= ivi_layout_get_layer_from_handle,
 };
 
 int
@@ -32,6 +32,10 @@
 #include <limits.h>
 #include <math.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "filter.h"
 #include "libinput-util.h"
 #include "filter-private.h"
@@ -138,6 +142,26 @@ struct pointer_tracker {
 	int dir;
 };
 
+/* The adaptive profiles are piecewise linear in the velocity, capped at
+ * a maximum factor. For the ones we know, the segments are precomputed
+ * whenever the speed changes, so the three profile evaluations per
+ * event are done inline instead of through accel->profile.
+ *
+ * Segment i covers velocities below end[i] not covered by an earlier
+ * segment, the last one ends at INFINITY. The factor is
+ * min(max_factor, slope * v + offset) * scale.
+ */
+#define ACCEL_CURVE_SEGMENTS 3
+
+struct accel_curve {
+	int nsegments;				/* 0: call the profile */
+	double end[ACCEL_CURVE_SEGMENTS];	/* units/us */
+	double slope[ACCEL_CURVE_SEGMENTS];	/* 1/(units/us) */
+	double offset[ACCEL_CURVE_SEGMENTS];	/* unitless */
+	double max_factor;			/* unitless */
+	double scale;				/* unitless */
+};
+
 struct pointer_accelerator {
 	struct motion_filter base;
 
@@ -154,6 +178,8 @@ struct pointer_accelerator {
 	double incline;		/* incline of the function */
 
 	double dpi_factor;
+
+	struct accel_curve curve;
 };
 
 struct pointer_accelerator_flat {
@@ -228,6 +254,48 @@ calculate_velocity_after_timeout(struct pointer_tracker *tracker)
 					  tracker->time + MOTION_TIMEOUT);
 }
 
+/* Fills in the velocity relative to each tracker but the current one,
+ * indexed by offset. Computing all of them up front, two at a time,
+ * is cheaper than one hypot() and division per tracker in the scan
+ * below, which for steady motion visits every tracker anyway. */
+static void
+calculate_tracker_velocities(struct pointer_accelerator *accel,
+			     uint64_t time,
+			     double velocities[NUM_POINTER_TRACKERS])
+{
+	double dx[NUM_POINTER_TRACKERS],
+	       dy[NUM_POINTER_TRACKERS],
+	       tdelta[NUM_POINTER_TRACKERS];
+	struct pointer_tracker *tracker;
+	unsigned int offset;
+
+	dx[0] = dy[0] = 0.0;
+	tdelta[0] = 1.0;
+	for (offset = 1; offset < NUM_POINTER_TRACKERS; offset++) {
+		tracker = tracker_by_offset(accel, offset);
+		dx[offset] = tracker->delta.x;
+		dy[offset] = tracker->delta.y;
+		tdelta[offset] = time - tracker->time + 1;
+	}
+
+#if defined(__SSE2__)
+	for (offset = 0; offset < NUM_POINTER_TRACKERS; offset += 2) {
+		__m128d x = _mm_loadu_pd(&dx[offset]),
+			y = _mm_loadu_pd(&dy[offset]),
+			t = _mm_loadu_pd(&tdelta[offset]);
+		__m128d length = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(x, x),
+							_mm_mul_pd(y, y)));
+
+		_mm_storeu_pd(&velocities[offset], _mm_div_pd(length, t));
+	}
+#else
+	for (offset = 0; offset < NUM_POINTER_TRACKERS; offset++)
+		velocities[offset] = sqrt(dx[offset] * dx[offset] +
+					  dy[offset] * dy[offset]) /
+				     tdelta[offset];
+#endif
+}
+
 static double
 calculate_velocity(struct pointer_accelerator *accel, uint64_t time)
 {
@@ -236,10 +304,13 @@ calculate_velocity(struct pointer_accelerator *accel, uint64_t time)
 	double result = 0.0;
 	double initial_velocity = 0.0;
 	double velocity_diff;
+	double velocities[NUM_POINTER_TRACKERS]; /* units/us */
 	unsigned int offset;
 
 	unsigned int dir = tracker_by_offset(accel, 0)->dir;
 
+	calculate_tracker_velocities(accel, time, velocities);
+
 	/* Find least recent vector within a timelimit, maximum velocity diff
 	 * and direction threshold. */
 	for (offset = 1; offset < NUM_POINTER_TRACKERS; offset++) {
@@ -253,7 +324,7 @@ calculate_velocity(struct pointer_accelerator *accel, uint64_t time)
 			break;
 		}
 
-		velocity = calculate_tracker_velocity(tracker, time);
+		velocity = velocities[offset];
 
 		/* Stop if direction changed */
 		dir &= tracker->dir;
@@ -280,10 +351,26 @@ calculate_velocity(struct pointer_accelerator *accel, uint64_t time)
 	return result; /* units/us */
 }
 
-static double
+static inline double
+accel_curve_evaluate(const struct accel_curve *curve, double velocity)
+{
+	int i = 0;
+
+	while (i < curve->nsegments - 1 && velocity >= curve->end[i])
+		i++;
+
+	return min(curve->max_factor,
+		   curve->slope[i] * velocity + curve->offset[i]) *
+	       curve->scale;
+}
+
+static inline double
 acceleration_profile(struct pointer_accelerator *accel,
 		     void *data, double velocity, uint64_t time)
 {
+	if (accel->curve.nsegments > 0)
+		return accel_curve_evaluate(&accel->curve, velocity);
+
 	return accel->profile(&accel->base, data, velocity, time);
 }
 
@@ -506,6 +593,69 @@ accelerator_destroy(struct motion_filter *filter)
 	free(accel);
 }
 
+/* The segments of pointer_accel_profile_linear(), for velocities scaled
+ * by speed_scale before and factors by factor_scale after the profile */
+static void
+accel_curve_set_linear(struct accel_curve *curve,
+		       double max_accel,
+		       double threshold,
+		       double incline,
+		       double speed_scale,
+		       double factor_scale)
+{
+	curve->nsegments = 3;
+
+	/* deceleration below 0.07 units/ms */
+	curve->end[0] = v_ms2us(0.07) / speed_scale;
+	curve->slope[0] = v_us2ms(10) * speed_scale;
+	curve->offset[0] = 0.3;
+
+	/* 1:1 up to the threshold */
+	curve->end[1] = threshold / speed_scale;
+	curve->slope[1] = 0.0;
+	curve->offset[1] = 1.0;
+
+	/* the incline above it */
+	curve->end[2] = INFINITY;
+	curve->slope[2] = v_us2ms(incline) * speed_scale;
+	curve->offset[2] = 1.0 - v_us2ms(incline) * threshold;
+
+	curve->max_factor = max_accel;
+	curve->scale = factor_scale;
+}
+
+static void
+accel_curve_update(struct pointer_accelerator *accel)
+{
+	struct accel_curve *curve = &accel->curve;
+	double dpi_factor = accel->dpi_factor;
+
+	if (accel->profile == pointer_accel_profile_linear) {
+		accel_curve_set_linear(curve,
+				       accel->accel,
+				       accel->threshold,
+				       accel->incline,
+				       1.0, 1.0);
+	} else if (accel->profile == touchpad_accel_profile_linear) {
+		accel_curve_set_linear(curve,
+				       accel->accel,
+				       accel->threshold,
+				       accel->incline,
+				       TP_MAGIC_SLOWDOWN,
+				       TP_MAGIC_SLOWDOWN);
+	} else if (accel->profile == pointer_accel_profile_linear_low_dpi ||
+		   accel->profile == trackpoint_accel_profile) {
+		accel_curve_set_linear(curve,
+				       accel->accel / dpi_factor,
+				       accel->threshold * dpi_factor,
+				       accel->incline,
+				       1.0, 1.0);
+	} else {
+		/* the x230 profile is left alone, see its comment */
+		curve->nsegments = 0;
+	}
+}
+
 static bool
 accelerator_set_speed(struct motion_filter *filter,
 		      double speed_adjustment)
@@ -531,6 +681,8 @@ accelerator_set_speed(struct motion_filter *filter,
 	accel_filter->incline = DEFAULT_INCLINE + speed_adjustment * 0.75;
 
 	filter->speed_adjustment = speed_adjustment;
+	accel_curve_update(accel_filter);
+
 	return true;
 }
 
@@ -780,6 +932,7 @@ create_pointer_accelerator_filter_linear(int dpi)
 
 	filter->base.interface = &accelerator_interface;
 	filter->profile = pointer_accel_profile_linear;
+	accel_curve_update(filter);
 
 	return &filter->base;
 }
@@ -804,6 +957,7 @@ create_pointer_accelerator_filter_linear_low_dpi(int dpi)
 
 	filter->base.interface = &accelerator_interface_low_dpi;
 	filter->profile = pointer_accel_profile_linear_low_dpi;
+	accel_curve_update(filter);
 
 	return &filter->base;
 }
@@ -828,6 +982,7 @@ create_pointer_accelerator_filter_touchpad(int dpi)
 
 	filter->base.interface = &accelerator_interface_touchpad;
 	filter->profile = touchpad_accel_profile_linear;
+	accel_curve_update(filter);
 
 	return &filter->base;
 }
@@ -894,6 +1049,7 @@ create_pointer_accelerator_filter_trackpoint(int dpi)
 	filter->threshold = DEFAULT_THRESHOLD;
 	filter->accel = DEFAULT_ACCELERATION;
 	filter->incline = DEFAULT_INCLINE;
+	accel_curve_update(filter);
 
 	return &filter->base;
 }
@@ -113,6 +113,31 @@ struct libinput_interface_backend {
 				  const char *seat_name);
 };
 
+/* The event structs, one slab each. */
+enum event_slab_type {
+	EVENT_SLAB_DEVICE_NOTIFY,
+	EVENT_SLAB_KEYBOARD,
+	EVENT_SLAB_POINTER,
+	EVENT_SLAB_TOUCH,
+	EVENT_SLAB_GESTURE,
+	EVENT_SLAB_TABLET_TOOL,
+	EVENT_SLAB_TABLET_PAD,
+	EVENT_SLAB_COUNT,
+};
+
+#define EVENT_SLAB_CHUNK_SIZE 32
+
+/* Events are carved out of chunks of EVENT_SLAB_CHUNK_SIZE objects and
+ * go back to the free list when destroyed; the chunks are only
+ * released with the context, so a steady event stream stops calling
+ * malloc once the slabs have grown to the peak queue depth. */
+struct event_slab {
+	size_t object_size;
+	void *free_list;
+	struct list chunks;
+	unsigned int nchunks;
+};
+
 struct libinput {
 	int epoll_fd;
 	struct list source_destroy_list;
@@ -125,12 +150,15 @@ struct libinput {
 		int fd;
 	} timer;
 
+	/* events_len is always a power of two */
 	struct libinput_event **events;
 	size_t events_count;
 	size_t events_len;
 	size_t events_in;
 	size_t events_out;
 
+	struct event_slab event_slabs[EVENT_SLAB_COUNT];
+
 	struct list tool_list;
 
 	const struct libinput_interface *interface;
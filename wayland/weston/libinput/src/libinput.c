@@ -159,6 +159,161 @@ struct libinput_event_tablet_pad {
 	} strip;
 };
 
+static const size_t event_slab_object_size[EVENT_SLAB_COUNT] = {
+	[EVENT_SLAB_DEVICE_NOTIFY] = sizeof(struct libinput_event_device_notify),
+	[EVENT_SLAB_KEYBOARD] = sizeof(struct libinput_event_keyboard),
+	[EVENT_SLAB_POINTER] = sizeof(struct libinput_event_pointer),
+	[EVENT_SLAB_TOUCH] = sizeof(struct libinput_event_touch),
+	[EVENT_SLAB_GESTURE] = sizeof(struct libinput_event_gesture),
+	[EVENT_SLAB_TABLET_TOOL] = sizeof(struct libinput_event_tablet_tool),
+	[EVENT_SLAB_TABLET_PAD] = sizeof(struct libinput_event_tablet_pad),
+};
+
+struct event_slab_chunk {
+	struct list link;
+	/* EVENT_SLAB_CHUNK_SIZE objects of object_size follow, aligned
+	 * for the uint64_t and double members of the events */
+	uint64_t objects[];
+};
+
+struct event_slab_free {
+	struct event_slab_free *next;
+};
+
+static enum event_slab_type
+event_slab_type(enum libinput_event_type type)
+{
+	switch (type) {
+	case LIBINPUT_EVENT_NONE:
+		abort();
+	case LIBINPUT_EVENT_DEVICE_ADDED:
+	case LIBINPUT_EVENT_DEVICE_REMOVED:
+		return EVENT_SLAB_DEVICE_NOTIFY;
+	case LIBINPUT_EVENT_KEYBOARD_KEY:
+		return EVENT_SLAB_KEYBOARD;
+	case LIBINPUT_EVENT_POINTER_MOTION:
+	case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
+	case LIBINPUT_EVENT_POINTER_BUTTON:
+	case LIBINPUT_EVENT_POINTER_AXIS:
+		return EVENT_SLAB_POINTER;
+	case LIBINPUT_EVENT_TOUCH_DOWN:
+	case LIBINPUT_EVENT_TOUCH_UP:
+	case LIBINPUT_EVENT_TOUCH_MOTION:
+	case LIBINPUT_EVENT_TOUCH_CANCEL:
+	case LIBINPUT_EVENT_TOUCH_FRAME:
+		return EVENT_SLAB_TOUCH;
+	case LIBINPUT_EVENT_TABLET_TOOL_AXIS:
+	case LIBINPUT_EVENT_TABLET_TOOL_PROXIMITY:
+	case LIBINPUT_EVENT_TABLET_TOOL_TIP:
+	case LIBINPUT_EVENT_TABLET_TOOL_BUTTON:
+		return EVENT_SLAB_TABLET_TOOL;
+	case LIBINPUT_EVENT_TABLET_PAD_BUTTON:
+	case LIBINPUT_EVENT_TABLET_PAD_RING:
+	case LIBINPUT_EVENT_TABLET_PAD_STRIP:
+		return EVENT_SLAB_TABLET_PAD;
+	case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
+	case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
+	case LIBINPUT_EVENT_GESTURE_SWIPE_END:
+	case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
+	case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
+	case LIBINPUT_EVENT_GESTURE_PINCH_END:
+		return EVENT_SLAB_GESTURE;
+	}
+
+	abort();
+}
+
+static void
+event_slabs_init(struct libinput *libinput)
+{
+	struct event_slab *slab;
+	size_t align = sizeof(uint64_t);
+	int i;
+
+	for (i = 0; i < EVENT_SLAB_COUNT; i++) {
+		slab = &libinput->event_slabs[i];
+		slab->object_size = (event_slab_object_size[i] + align - 1) /
+				    align * align;
+		slab->free_list = NULL;
+		list_init(&slab->chunks);
+		slab->nchunks = 0;
+	}
+}
+
+static void
+event_slabs_destroy(struct libinput *libinput)
+{
+	struct event_slab_chunk *chunk, *tmp;
+	int i;
+
+	for (i = 0; i < EVENT_SLAB_COUNT; i++) {
+		list_for_each_safe(chunk, tmp,
+				   &libinput->event_slabs[i].chunks, link)
+			free(chunk);
+		list_init(&libinput->event_slabs[i].chunks);
+		libinput->event_slabs[i].free_list = NULL;
+		libinput->event_slabs[i].nchunks = 0;
+	}
+}
+
+static bool
+event_slab_grow(struct event_slab *slab)
+{
+	struct event_slab_chunk *chunk;
+	struct event_slab_free *object;
+	char *objects;
+	int i;
+
+	chunk = malloc(sizeof *chunk +
+		       EVENT_SLAB_CHUNK_SIZE * slab->object_size);
+	if (!chunk)
+		return false;
+
+	list_insert(&slab->chunks, &chunk->link);
+	slab->nchunks++;
+
+	/* thread the new objects onto the free list back to front, so
+	 * they are handed out in address order */
+	objects = (char *) chunk->objects;
+	for (i = EVENT_SLAB_CHUNK_SIZE - 1; i >= 0; i--) {
+		object = (struct event_slab_free *)
+			(objects + i * slab->object_size);
+		object->next = slab->free_list;
+		slab->free_list = object;
+	}
+
+	return true;
+}
+
+/* Returns a zeroed event from the device's context. */
+static void *
+event_alloc(struct libinput_device *device, enum event_slab_type type)
+{
+	struct event_slab *slab;
+	struct event_slab_free *object;
+
+	slab = &device->seat->libinput->event_slabs[type];
+	if (!slab->free_list && !event_slab_grow(slab))
+		return NULL;
+
+	object = slab->free_list;
+	slab->free_list = object->next;
+	memset(object, 0, slab->object_size);
+
+	return object;
+}
+
+static void
+event_free(struct libinput *libinput, struct libinput_event *event)
+{
+	struct event_slab *slab;
+	struct event_slab_free *object = (struct event_slab_free *) event;
+
+	slab = &libinput->event_slabs[event_slab_type(event->type)];
+	object->next = slab->free_list;
+	slab->free_list = object;
+}
+
 static void
 libinput_default_log_func(struct libinput *libinput,
 			  enum libinput_log_priority priority,
@@ -1558,12 +1713,13 @@ libinput_init(struct libinput *libinput,
 	if (libinput->epoll_fd < 0)
 		return -1;
 
-	libinput->events_len = 4;
+	libinput->events_len = 32;
 	libinput->events = zalloc(libinput->events_len * sizeof(*libinput->events));
 	if (!libinput->events) {
 		close(libinput->epoll_fd);
 		return -1;
 	}
+	event_slabs_init(libinput);
 
 	libinput->log_handler = libinput_default_log_func;
 	libinput->log_priority = LIBINPUT_LOG_PRIORITY_ERROR;
@@ -1633,6 +1789,7 @@ libinput_unref(struct libinput *libinput)
 	       libinput_event_destroy(event);
 
 	free(libinput->events);
+	event_slabs_destroy(libinput);
 
 	list_for_each_safe(seat, next_seat, &libinput->seat_list, link) {
 		list_for_each_safe(device, next_device,
@@ -1677,9 +1834,14 @@ libinput_event_tablet_pad_destroy(struct libinput_event_tablet_pad *event)
 LIBINPUT_EXPORT void
 libinput_event_destroy(struct libinput_event *event)
 {
+	struct libinput *libinput;
+
 	if (event == NULL)
 		return;
 
+	/* the device reference may be the last one */
+	libinput = event->device->seat->libinput;
+
 	switch(event->type) {
 	case LIBINPUT_EVENT_TABLET_TOOL_PROXIMITY:
 	case LIBINPUT_EVENT_TABLET_TOOL_AXIS:
@@ -1698,10 +1860,9 @@ libinput_event_destroy(struct libinput_event *event)
 		break;
 	}
 
-	if (event->device)
-		libinput_device_unref(event->device);
+	libinput_device_unref(event->device);
 
-	free(event);
+	event_free(libinput, event);
 }
 
 int
@@ -1972,7 +2133,7 @@ notify_added_device(struct libinput_device *device)
 {
 	struct libinput_event_device_notify *added_device_event;
 
-	added_device_event = zalloc(sizeof *added_device_event);
+	added_device_event = event_alloc(device, EVENT_SLAB_DEVICE_NOTIFY);
 	if (!added_device_event)
 		return;
 
@@ -1986,7 +2147,7 @@ notify_removed_device(struct libinput_device *device)
 {
 	struct libinput_event_device_notify *removed_device_event;
 
-	removed_device_event = zalloc(sizeof *removed_device_event);
+	removed_device_event = event_alloc(device, EVENT_SLAB_DEVICE_NOTIFY);
 	if (!removed_device_event)
 		return;
 
@@ -2045,7 +2206,7 @@ keyboard_notify_key(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_KEYBOARD))
 		return;
 
-	key_event = zalloc(sizeof *key_event);
+	key_event = event_alloc(device, EVENT_SLAB_KEYBOARD);
 	if (!key_event)
 		return;
 
@@ -2074,7 +2235,7 @@ pointer_notify_motion(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_POINTER))
 		return;
 
-	motion_event = zalloc(sizeof *motion_event);
+	motion_event = event_alloc(device, EVENT_SLAB_POINTER);
 	if (!motion_event)
 		return;
 
@@ -2099,7 +2260,7 @@ pointer_notify_motion_absolute(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_POINTER))
 		return;
 
-	motion_absolute_event = zalloc(sizeof *motion_absolute_event);
+	motion_absolute_event = event_alloc(device, EVENT_SLAB_POINTER);
 	if (!motion_absolute_event)
 		return;
 
@@ -2125,7 +2286,7 @@ pointer_notify_button(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_POINTER))
 		return;
 
-	button_event = zalloc(sizeof *button_event);
+	button_event = event_alloc(device, EVENT_SLAB_POINTER);
 	if (!button_event)
 		return;
 
@@ -2158,7 +2319,7 @@ pointer_notify_axis(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_POINTER))
 		return;
 
-	axis_event = zalloc(sizeof *axis_event);
+	axis_event = event_alloc(device, EVENT_SLAB_POINTER);
 	if (!axis_event)
 		return;
 
@@ -2187,7 +2348,7 @@ touch_notify_touch_down(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_TOUCH))
 		return;
 
-	touch_event = zalloc(sizeof *touch_event);
+	touch_event = event_alloc(device, EVENT_SLAB_TOUCH);
 	if (!touch_event)
 		return;
 
@@ -2215,7 +2376,7 @@ touch_notify_touch_motion(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_TOUCH))
 		return;
 
-	touch_event = zalloc(sizeof *touch_event);
+	touch_event = event_alloc(device, EVENT_SLAB_TOUCH);
 	if (!touch_event)
 		return;
 
@@ -2242,7 +2403,7 @@ touch_notify_touch_up(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_TOUCH))
 		return;
 
-	touch_event = zalloc(sizeof *touch_event);
+	touch_event = event_alloc(device, EVENT_SLAB_TOUCH);
 	if (!touch_event)
 		return;
 
@@ -2266,7 +2427,7 @@ touch_notify_frame(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_TOUCH))
 		return;
 
-	touch_event = zalloc(sizeof *touch_event);
+	touch_event = event_alloc(device, EVENT_SLAB_TOUCH);
 	if (!touch_event)
 		return;
 
@@ -2289,7 +2450,7 @@ tablet_notify_axis(struct libinput_device *device,
 {
 	struct libinput_event_tablet_tool *axis_event;
 
-	axis_event = zalloc(sizeof *axis_event);
+	axis_event = event_alloc(device, EVENT_SLAB_TABLET_TOOL);
 	if (!axis_event)
 		return;
 
@@ -2321,7 +2482,7 @@ tablet_notify_proximity(struct libinput_device *device,
 {
 	struct libinput_event_tablet_tool *proximity_event;
 
-	proximity_event = zalloc(sizeof *proximity_event);
+	proximity_event = event_alloc(device, EVENT_SLAB_TABLET_TOOL);
 	if (!proximity_event)
 		return;
 
@@ -2352,7 +2513,7 @@ tablet_notify_tip(struct libinput_device *device,
 {
 	struct libinput_event_tablet_tool *tip_event;
 
-	tip_event = zalloc(sizeof *tip_event);
+	tip_event = event_alloc(device, EVENT_SLAB_TABLET_TOOL);
 	if (!tip_event)
 		return;
 
@@ -2385,7 +2546,7 @@ tablet_notify_button(struct libinput_device *device,
 	struct libinput_event_tablet_tool *button_event;
 	int32_t seat_button_count;
 
-	button_event = zalloc(sizeof *button_event);
+	button_event = event_alloc(device, EVENT_SLAB_TABLET_TOOL);
 	if (!button_event)
 		return;
 
@@ -2420,7 +2581,7 @@ tablet_pad_notify_button(struct libinput_device *device,
 	struct libinput_event_tablet_pad *button_event;
 	unsigned int mode;
 
-	button_event = zalloc(sizeof *button_event);
+	button_event = event_alloc(device, EVENT_SLAB_TABLET_PAD);
 	if (!button_event)
 		return;
 
@@ -2451,7 +2612,7 @@ tablet_pad_notify_ring(struct libinput_device *device,
 	struct libinput_event_tablet_pad *ring_event;
 	unsigned int mode;
 
-	ring_event = zalloc(sizeof *ring_event);
+	ring_event = event_alloc(device, EVENT_SLAB_TABLET_PAD);
 	if (!ring_event)
 		return;
 
@@ -2483,7 +2644,7 @@ tablet_pad_notify_strip(struct libinput_device *device,
 	struct libinput_event_tablet_pad *strip_event;
 	unsigned int mode;
 
-	strip_event = zalloc(sizeof *strip_event);
+	strip_event = event_alloc(device, EVENT_SLAB_TABLET_PAD);
 	if (!strip_event)
 		return;
 
@@ -2520,7 +2681,7 @@ gesture_notify(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_GESTURE))
 		return;
 
-	gesture_event = zalloc(sizeof *gesture_event);
+	gesture_event = event_alloc(device, EVENT_SLAB_GESTURE);
 	if (!gesture_event)
 		return;
 
@@ -2647,6 +2808,7 @@ libinput_post_event(struct libinput *libinput,
 			log_error(libinput,
 				  "Failed to reallocate event ring buffer. "
 				  "Events may be discarded\n");
+			event_free(libinput, event);
 			return;
 		}
 
@@ -2666,12 +2828,12 @@ libinput_post_event(struct libinput *libinput,
 		libinput->events_len = events_len;
 	}
 
-	if (event->device)
-		libinput_device_ref(event->device);
+	libinput_device_ref(event->device);
 
 	libinput->events_count = events_count;
 	events[libinput->events_in] = event;
-	libinput->events_in = (libinput->events_in + 1) % libinput->events_len;
+	libinput->events_in = (libinput->events_in + 1) &
+			      (libinput->events_len - 1);
 }
 
 LIBINPUT_EXPORT struct libinput_event *
@@ -2684,7 +2846,7 @@ libinput_get_event(struct libinput *libinput)
 
 	event = libinput->events[libinput->events_out];
 	libinput->events_out =
-		(libinput->events_out + 1) % libinput->events_len;
+		(libinput->events_out + 1) & (libinput->events_len - 1);
 	libinput->events_count--;
 
 	return event;
@@ -0,0 +1,229 @@
+/*
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Times the event queue: a fake device posts pointer motion and key events
+ * straight into a context through the same notify functions evdev uses,
+ * and the events are then read and destroyed in bursts.  No uinput device
+ * or evdev fd is involved, so only event allocation, the ring and
+ * destruction are measured.
+ *
+ * Usage: event-bench [events per burst size]
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libinput.h"
+#include "libinput-private.h"
+#include "evdev.h"
+
+#define DEFAULT_EVENTS 2000000
+
+struct fake_seat {
+	struct libinput_seat base;
+};
+
+static int
+fake_open_restricted(const char *path, int flags, void *user_data)
+{
+	return -1;
+}
+
+static void
+fake_close_restricted(int fd, void *user_data)
+{
+}
+
+static const struct libinput_interface interface = {
+	.open_restricted = fake_open_restricted,
+	.close_restricted = fake_close_restricted,
+};
+
+static int
+fake_resume(struct libinput *libinput)
+{
+	return 0;
+}
+
+static void
+fake_suspend(struct libinput *libinput)
+{
+}
+
+static void
+fake_destroy(struct libinput *libinput)
+{
+}
+
+static const struct libinput_interface_backend interface_backend = {
+	.resume = fake_resume,
+	.suspend = fake_suspend,
+	.destroy = fake_destroy,
+};
+
+static void
+fake_seat_destroy(struct libinput_seat *seat)
+{
+	free(seat);
+}
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static unsigned int
+event_slab_chunks(struct libinput *li)
+{
+	unsigned int i, nchunks = 0;
+
+	for (i = 0; i < EVENT_SLAB_COUNT; i++)
+		nchunks += li->event_slabs[i].nchunks;
+
+	return nchunks;
+}
+
+/* Every fourth event is a key press or release, the rest pointer motion */
+static void
+post_events(struct evdev_device *device, uint64_t time, unsigned int count)
+{
+	struct normalized_coords delta = { 1.0, -1.0 };
+	struct device_float_coords raw = { 1.0, -1.0 };
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (i % 4 == 3)
+			keyboard_notify_key(&device->base, time, KEY_A,
+					    (i / 4) % 2 ?
+					    LIBINPUT_KEY_STATE_RELEASED :
+					    LIBINPUT_KEY_STATE_PRESSED);
+		else
+			pointer_notify_motion(&device->base, time,
+					      &delta, &raw);
+	}
+}
+
+static int
+run_burst(struct libinput *li, struct evdev_device *device,
+	  unsigned int burst, unsigned int nevents)
+{
+	struct libinput_event **events;
+	uint64_t start, t_post = 0, t_get = 0, t_destroy = 0;
+	unsigned int nchunks, round, nrounds, i;
+	size_t events_len;
+
+	events = malloc(burst * sizeof(*events));
+	if (!events)
+		return 1;
+
+	/* the first burst sizes the slabs and the ring */
+	post_events(device, 0, burst);
+	for (i = 0; i < burst; i++)
+		libinput_event_destroy(libinput_get_event(li));
+	nchunks = event_slab_chunks(li);
+	events_len = li->events_len;
+
+	nrounds = nevents / burst;
+	for (round = 0; round < nrounds; round++) {
+		start = now_ns();
+		post_events(device, round, burst);
+		t_post += now_ns() - start;
+
+		start = now_ns();
+		for (i = 0; i < burst; i++)
+			events[i] = libinput_get_event(li);
+		t_get += now_ns() - start;
+
+		start = now_ns();
+		for (i = 0; i < burst; i++)
+			libinput_event_destroy(events[i]);
+		t_destroy += now_ns() - start;
+	}
+
+	free(events);
+
+	printf("burst %4u: post %6.1f ns, get %5.1f ns, destroy %5.1f ns per event, "
+	       "%u slab chunks, ring %zu\n",
+	       burst,
+	       (double)t_post / (nrounds * burst),
+	       (double)t_get / (nrounds * burst),
+	       (double)t_destroy / (nrounds * burst),
+	       event_slab_chunks(li),
+	       li->events_len);
+
+	/* steady state must not allocate */
+	if (event_slab_chunks(li) != nchunks || li->events_len != events_len) {
+		fprintf(stderr, "burst %u: slabs or ring grew after the first burst\n",
+			burst);
+		return 1;
+	}
+
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	static const unsigned int bursts[] = { 1, 8, 64, 512, 4096 };
+	struct libinput *li;
+	struct fake_seat *seat;
+	struct evdev_device *device;
+	unsigned int nevents = DEFAULT_EVENTS;
+	unsigned int i;
+	int rc = 0;
+
+	if (argc > 1)
+		nevents = strtoul(argv[1], NULL, 10);
+
+	li = zalloc(sizeof(*li));
+	seat = zalloc(sizeof(*seat));
+	device = zalloc(sizeof(*device));
+	if (!li || !seat || !device ||
+	    libinput_init(li, &interface, &interface_backend, NULL) != 0) {
+		fprintf(stderr, "failed to create the context\n");
+		return 1;
+	}
+
+	libinput_seat_init(&seat->base, li, "seat0", "default",
+			   fake_seat_destroy);
+
+	/* not on the seat's device list, so the context never destroys it;
+	 * the reference taken here keeps event destruction from doing so */
+	libinput_device_init(&device->base, &seat->base);
+	device->seat_caps = EVDEV_DEVICE_POINTER | EVDEV_DEVICE_KEYBOARD;
+
+	for (i = 0; i < ARRAY_LENGTH(bursts); i++)
+		rc |= run_burst(li, device, bursts[i], nevents);
+
+	libinput_unref(li);
+	free(device);
+
+	return rc;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <config.h>
+
+#include <check.h>
+#include <libinput.h>
+
+#include "litest.h"
+#include "libinput-util.h"
+#include "libinput-private.h"
+
+static unsigned int
+event_slab_chunks(struct libinput *li)
+{
+	unsigned int i, nchunks = 0;
+
+	for (i = 0; i < EVENT_SLAB_COUNT; i++)
+		nchunks += li->event_slabs[i].nchunks;
+
+	return nchunks;
+}
+
+static unsigned int
+drain_and_count_events(struct libinput *li)
+{
+	struct libinput_event *event;
+	unsigned int count = 0;
+
+	libinput_dispatch(li);
+	while ((event = libinput_get_event(li))) {
+		libinput_event_destroy(event);
+		count++;
+	}
+
+	return count;
+}
+
+START_TEST(event_slab_recycle)
+{
+	struct litest_device *dev = litest_current_device();
+	struct libinput *li = dev->libinput;
+	unsigned int nchunks, count, i, round;
+	const unsigned int nevents = 100;
+	size_t events_len;
+
+	litest_drain_events(li);
+
+	/* queue a burst without reading, so the slab and the ring grow to
+	 * the burst size once */
+	for (i = 0; i < nevents; i++) {
+		litest_event(dev, EV_REL, REL_X, 1);
+		litest_event(dev, EV_SYN, SYN_REPORT, 0);
+	}
+	count = drain_and_count_events(li);
+	ck_assert_int_eq(count, nevents);
+
+	nchunks = li->event_slabs[EVENT_SLAB_POINTER].nchunks;
+	ck_assert_int_le(nchunks,
+			 (nevents + EVENT_SLAB_CHUNK_SIZE - 1) /
+			 EVENT_SLAB_CHUNK_SIZE);
+	events_len = li->events_len;
+	ck_assert_int_ge(events_len, nevents);
+	ck_assert_int_eq(events_len & (events_len - 1), 0);
+
+	/* the same bursts again come entirely from recycled events */
+	for (round = 0; round < 20; round++) {
+		for (i = 0; i < nevents; i++) {
+			litest_event(dev, EV_REL, REL_Y, -1);
+			litest_event(dev, EV_SYN, SYN_REPORT, 0);
+		}
+		count = drain_and_count_events(li);
+		ck_assert_int_eq(count, nevents);
+		ck_assert_int_eq(li->event_slabs[EVENT_SLAB_POINTER].nchunks,
+				 nchunks);
+		ck_assert_int_eq(li->events_len, events_len);
+	}
+}
+END_TEST
+
+START_TEST(event_slab_touchpad_replay)
+{
+	struct litest_device *dev = litest_current_device();
+	struct libinput *li = dev->libinput;
+	unsigned int nchunks = 0, count, round;
+	size_t events_len = 0;
+
+	litest_drain_events(li);
+
+	/* fast one finger swipes back and forth, read after each swipe */
+	for (round = 0; round < 20; round++) {
+		litest_touch_down(dev, 0, 20, 20);
+		litest_touch_move_to(dev, 0, 20, 20, 80, 80, 50, 0);
+		litest_touch_move_to(dev, 0, 80, 80, 20, 20, 50, 0);
+		litest_touch_up(dev, 0);
+		count = drain_and_count_events(li);
+		ck_assert_int_gt(count, 0);
+
+		/* the first swipes size the slabs, the later ones don't
+		 * allocate */
+		if (round < 2) {
+			nchunks = event_slab_chunks(li);
+			events_len = li->events_len;
+			continue;
+		}
+		ck_assert_int_eq(event_slab_chunks(li), nchunks);
+		ck_assert_int_eq(li->events_len, events_len);
+	}
+}
+END_TEST
+
+void
+litest_setup_tests_events(void)
+{
+	litest_add_for_device("events:slab", event_slab_recycle, LITEST_MOUSE);
+	litest_add("events:slab", event_slab_touchpad_replay, LITEST_TOUCHPAD, LITEST_ANY);
+}
@@ -3263,6 +3263,7 @@ main(int argc, char **argv)
 	litest_setup_tests_keyboard();
 	litest_setup_tests_device();
 	litest_setup_tests_gestures();
+	litest_setup_tests_events();
 
 	if (mode == LITEST_MODE_LIST) {
 		litest_list_tests(&all_tests);
@@ -29,6 +29,7 @@
 #include <getopt.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <filter.h>
@@ -153,17 +154,357 @@ print_accel_func(struct motion_filter *filter, accel_profile_func_t profile)
 	}
 }
 
+/* The filter as it was before the profiles were tabulated and the
+ * tracker velocities vectorized, one hypot() and profile call at a
+ * time. Kept here so the compare mode can check the filter against it.
+ */
+#define REF_NUM_TRACKERS 16
+#define REF_MOTION_TIMEOUT ms2us(1000)
+#define REF_MAX_VELOCITY_DIFF (1/1000.0) /* units/us */
+
+struct reference_filter {
+	struct motion_filter *filter; /* for the profile parameters */
+	accel_profile_func_t profile;
+	double dpi_scale;
+	double last_velocity;
+	struct {
+		struct normalized_coords delta;
+		uint64_t time;
+		int dir;
+	} trackers[REF_NUM_TRACKERS];
+	int cur_tracker;
+};
+
+static double
+reference_tracker_velocity(struct reference_filter *ref,
+			   int offset, uint64_t time)
+{
+	int i = (ref->cur_tracker + REF_NUM_TRACKERS - offset) %
+		REF_NUM_TRACKERS;
+	double tdelta = time - ref->trackers[i].time + 1;
+
+	return normalized_length(ref->trackers[i].delta) / tdelta;
+}
+
+static double
+reference_velocity(struct reference_filter *ref, uint64_t time)
+{
+	double velocity, result = 0.0, initial_velocity = 0.0;
+	unsigned int dir = ref->trackers[ref->cur_tracker].dir;
+	int offset, i;
+
+	for (offset = 1; offset < REF_NUM_TRACKERS; offset++) {
+		i = (ref->cur_tracker + REF_NUM_TRACKERS - offset) %
+		    REF_NUM_TRACKERS;
+
+		if (time - ref->trackers[i].time > REF_MOTION_TIMEOUT ||
+		    ref->trackers[i].time > time) {
+			if (offset == 1)
+				result = reference_tracker_velocity(ref,
+					offset,
+					ref->trackers[i].time +
+					REF_MOTION_TIMEOUT);
+			break;
+		}
+
+		velocity = reference_tracker_velocity(ref, offset, time);
+
+		dir &= ref->trackers[i].dir;
+		if (dir == 0) {
+			if (offset == 1)
+				result = velocity;
+			break;
+		}
+
+		if (initial_velocity == 0.0) {
+			result = initial_velocity = velocity;
+		} else {
+			if (fabs(initial_velocity - velocity) >
+			    REF_MAX_VELOCITY_DIFF)
+				break;
+			result = velocity;
+		}
+	}
+
+	return result;
+}
+
+static struct normalized_coords
+reference_dispatch(struct reference_filter *ref,
+		   const struct normalized_coords *unaccelerated,
+		   uint64_t time)
+{
+	struct normalized_coords delta, accelerated;
+	double velocity, factor;
+	int i;
+
+	delta.x = unaccelerated->x * ref->dpi_scale;
+	delta.y = unaccelerated->y * ref->dpi_scale;
+
+	for (i = 0; i < REF_NUM_TRACKERS; i++) {
+		ref->trackers[i].delta.x += delta.x;
+		ref->trackers[i].delta.y += delta.y;
+	}
+	ref->cur_tracker = (ref->cur_tracker + 1) % REF_NUM_TRACKERS;
+	ref->trackers[ref->cur_tracker].delta.x = 0.0;
+	ref->trackers[ref->cur_tracker].delta.y = 0.0;
+	ref->trackers[ref->cur_tracker].time = time;
+	ref->trackers[ref->cur_tracker].dir = normalized_get_direction(delta);
+
+	velocity = reference_velocity(ref, time);
+	factor = ref->profile(ref->filter, NULL, velocity, time);
+	factor += ref->profile(ref->filter, NULL, ref->last_velocity, time);
+	factor += 4.0 * ref->profile(ref->filter, NULL,
+				     (ref->last_velocity + velocity) / 2,
+				     time);
+	factor /= 6.0;
+	ref->last_velocity = velocity;
+
+	accelerated.x = factor * delta.x;
+	accelerated.y = factor * delta.y;
+
+	return accelerated;
+}
+
+struct filter_type {
+	const char *name;
+	struct motion_filter *(*create)(int dpi);
+	accel_profile_func_t profile;
+	bool scale_by_dpi; /* the filter works in device units */
+};
+
+static const struct filter_type filter_types[] = {
+	{ "linear", create_pointer_accelerator_filter_linear,
+	  pointer_accel_profile_linear, false },
+	{ "low-dpi", create_pointer_accelerator_filter_linear_low_dpi,
+	  pointer_accel_profile_linear_low_dpi, true },
+	{ "touchpad", create_pointer_accelerator_filter_touchpad,
+	  touchpad_accel_profile_linear, false },
+	{ "x230", create_pointer_accelerator_filter_lenovo_x230,
+	  touchpad_lenovo_x230_accel_profile, false },
+	{ "trackpoint", create_pointer_accelerator_filter_trackpoint,
+	  trackpoint_accel_profile, true },
+};
+
+static const struct filter_type *
+find_filter_type(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(filter_types); i++) {
+		if (streq(filter_types[i].name, name))
+			return &filter_types[i];
+	}
+
+	return NULL;
+}
+
+/* A mix of slow and fast strokes, direction changes and pauses longer
+ * than the motion timeout, at the given event rate */
+static void
+generate_motion(struct normalized_coords *deltas, uint64_t *times,
+		int nevents, int hz)
+{
+	uint64_t time = ms2us(5000);
+	double speed = 1.0, angle = 0.0;
+	int i;
+
+	srand(1);
+	for (i = 0; i < nevents; i++) {
+		if (rand() % 200 == 0)
+			time += ms2us(1000 + rand() % 1000);
+		else
+			time += us(1000000 / hz);
+
+		if (rand() % 40 == 0)
+			angle = (rand() % 360) * M_PI / 180.0;
+		if (rand() % 20 == 0)
+			speed = (rand() % 4000) / 100.0 / (hz / 125.0);
+
+		deltas[i].x = speed * cos(angle) + (rand() % 100 - 50) / 200.0;
+		deltas[i].y = speed * sin(angle) + (rand() % 100 - 50) / 200.0;
+		times[i] = time;
+	}
+}
+
+static double
+max_relative_diff(const struct normalized_coords *a,
+		  const struct normalized_coords *b,
+		  int n)
+{
+	double diff, max = 0.0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		diff = fabs(a[i].x - b[i].x) / max(1.0, fabs(b[i].x)) +
+		       fabs(a[i].y - b[i].y) / max(1.0, fabs(b[i].y));
+		if (diff > max)
+			max = diff;
+	}
+
+	return max;
+}
+
+static void
+reference_init(struct reference_filter *ref,
+	       const struct filter_type *type,
+	       struct motion_filter *filter,
+	       int dpi)
+{
+	memset(ref, 0, sizeof *ref);
+	ref->filter = filter;
+	ref->profile = type->profile;
+	ref->dpi_scale = type->scale_by_dpi ?
+		min(1.0, dpi / (double)DEFAULT_MOUSE_DPI) : 1.0;
+}
+
+/* Replays the deltas through the reference and filter_dispatch(),
+ * returns the largest difference */
+static double
+compare_replay(const struct filter_type *type, int dpi, double speed,
+	       const struct normalized_coords *deltas, const uint64_t *times,
+	       int nevents, struct normalized_coords *out[2])
+{
+	struct reference_filter ref;
+	struct motion_filter *filter;
+	int i;
+
+	filter = type->create(dpi);
+	assert(filter);
+	filter_set_speed(filter, speed);
+	reference_init(&ref, type, filter, dpi);
+
+	for (i = 0; i < nevents; i++) {
+		out[0][i] = reference_dispatch(&ref, &deltas[i], times[i]);
+		out[1][i] = filter_dispatch(filter, &deltas[i], NULL, times[i]);
+	}
+
+	filter_destroy(filter);
+
+	return max_relative_diff(out[1], out[0], nevents);
+}
+
+static int
+compare_filters(int dpi)
+{
+	const double speeds[] = { -1.0, -0.5, 0.0, 0.3, 1.0 };
+	const int rates[] = { 125, 1000 };
+	const int nevents = 20000;
+	struct normalized_coords *deltas, *out[2];
+	uint64_t *times;
+	const struct filter_type *type;
+	double diff, worst = 0.0;
+	unsigned int t, s, r;
+	int i, failed = 0;
+
+	deltas = calloc(nevents, sizeof *deltas);
+	times = calloc(nevents, sizeof *times);
+	for (i = 0; i < 2; i++) {
+		out[i] = calloc(nevents, sizeof *out[i]);
+		assert(out[i]);
+	}
+	assert(deltas && times);
+
+	for (r = 0; r < ARRAY_LENGTH(rates); r++) {
+		generate_motion(deltas, times, nevents, rates[r]);
+
+		for (t = 0; t < ARRAY_LENGTH(filter_types); t++) {
+			type = &filter_types[t];
+			for (s = 0; s < ARRAY_LENGTH(speeds); s++) {
+				diff = compare_replay(type, dpi, speeds[s],
+						      deltas, times, nevents,
+						      out);
+				printf("%-10s %4dHz speed %5.2f: "
+				       "max difference %g\n",
+				       type->name, rates[r], speeds[s], diff);
+				worst = max(worst, diff);
+				if (diff > 1e-9)
+					failed = 1;
+			}
+		}
+	}
+
+	printf("worst difference %g: %s\n", worst, failed ? "FAIL" : "ok");
+
+	free(deltas);
+	free(times);
+	for (i = 0; i < 2; i++)
+		free(out[i]);
+
+	return failed;
+}
+
+static double
+seconds_since(const struct timespec *begin)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - begin->tv_sec) +
+	       (now.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+static void
+benchmark_filter(const struct filter_type *type, int dpi, double speed)
+{
+	const int nevents = 1000000;
+	struct normalized_coords *deltas, *out;
+	uint64_t *times;
+	struct reference_filter ref;
+	struct motion_filter *filter;
+	struct timespec begin;
+	double reference, single;
+	int i;
+
+	deltas = calloc(nevents, sizeof *deltas);
+	out = calloc(nevents, sizeof *out);
+	times = calloc(nevents, sizeof *times);
+	assert(deltas && out && times);
+	generate_motion(deltas, times, nevents, 1000);
+
+	filter = type->create(dpi);
+	assert(filter);
+	filter_set_speed(filter, speed);
+	reference_init(&ref, type, filter, dpi);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < nevents; i++)
+		out[i] = reference_dispatch(&ref, &deltas[i], times[i]);
+	reference = seconds_since(&begin);
+	filter_destroy(filter);
+
+	filter = type->create(dpi);
+	filter_set_speed(filter, speed);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < nevents; i++)
+		out[i] = filter_dispatch(filter, &deltas[i], NULL, times[i]);
+	single = seconds_since(&begin);
+	filter_destroy(filter);
+
+	printf("%s: %.1f Mevents/s reference, %.1f libinput\n",
+	       type->name,
+	       nevents / reference / 1e6,
+	       nevents / single / 1e6);
+
+	free(deltas);
+	free(out);
+	free(times);
+}
+
 static void
 usage(void)
 {
 	printf("Usage: %s [options] [dx1] [dx2] [...] > gnuplot.data\n", program_invocation_short_name);
 	printf("\n"
 	       "Options:\n"
-	       "--mode=<motion|accel|delta|sequence> \n"
+	       "--mode=<motion|accel|delta|sequence|compare|benchmark> \n"
 	       "	motion   ... print motion to accelerated motion (default)\n"
 	       "	delta    ... print delta to accelerated delta\n"
 	       "	accel    ... print accel factor\n"
 	       "	sequence ... print motion for custom delta sequence\n"
+	       "	compare  ... replay generated motion through all filters and\n"
+	       "	             compare with the reference implementation\n"
+	       "	benchmark... time the filter against the reference\n"
 	       "--maxdx=<double>  ... in motion mode only. Stop increasing dx at maxdx\n"
 	       "--steps=<double>  ... in motion and delta modes only. Increase dx by step each round\n"
 	       "--speed=<double>  ... accel speed [-1, 1], default 0\n"
@@ -194,11 +535,14 @@ main(int argc, char **argv)
 	bool print_accel = false,
 	     print_motion = true,
 	     print_delta = false,
-	     print_sequence = false;
+	     print_sequence = false,
+	     compare = false,
+	     benchmark = false;
 	double custom_deltas[1024];
 	double speed = 0.0;
 	int dpi = 1000;
 	const char *filter_type = "linear";
+	const struct filter_type *type;
 	accel_profile_func_t profile = NULL;
 
 	enum {
@@ -240,6 +584,10 @@ main(int argc, char **argv)
 				print_delta = true;
 			else if (streq(optarg, "sequence"))
 				print_sequence = true;
+			else if (streq(optarg, "compare"))
+				compare = true;
+			else if (streq(optarg, "benchmark"))
+				benchmark = true;
 			else {
 				usage();
 				return 1;
@@ -282,26 +630,23 @@ main(int argc, char **argv)
 		}
 	}
 
-	if (streq(filter_type, "linear")) {
-		filter = create_pointer_accelerator_filter_linear(dpi);
-		profile = pointer_accel_profile_linear;
-	} else if (streq(filter_type, "low-dpi")) {
-		filter = create_pointer_accelerator_filter_linear_low_dpi(dpi);
-		profile = pointer_accel_profile_linear_low_dpi;
-	} else if (streq(filter_type, "touchpad")) {
-		filter = create_pointer_accelerator_filter_touchpad(dpi);
-		profile = touchpad_accel_profile_linear;
-	} else if (streq(filter_type, "x230")) {
-		filter = create_pointer_accelerator_filter_lenovo_x230(dpi);
-		profile = touchpad_lenovo_x230_accel_profile;
-	} else if (streq(filter_type, "trackpoint")) {
-		filter = create_pointer_accelerator_filter_trackpoint(dpi);
-		profile = trackpoint_accel_profile;
-	} else {
+	if (compare)
+		return compare_filters(dpi);
+
+	type = find_filter_type(filter_type);
+	if (!type) {
 		fprintf(stderr, "Invalid filter type %s\n", filter_type);
 		return 1;
 	}
 
+	if (benchmark) {
+		benchmark_filter(type, dpi, speed);
+		return 0;
+	}
+
+	filter = type->create(dpi);
+	profile = type->profile;
+
 	assert(filter != NULL);
 	filter_set_speed(filter, speed);
 
@@ -0,0 +1,203 @@
+/* Generated by wayland-scanner 1.11.0 */
+
+#ifndef WESTON_FRAME_TIMING_CLIENT_PROTOCOL_H
+#define WESTON_FRAME_TIMING_CLIENT_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "wayland-client.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @page page_weston_frame_timing The weston_frame_timing protocol
+ * @section page_ifaces_weston_frame_timing Interfaces
+ * - @subpage page_iface_weston_frame_timing - frame timing statistics
+ * @section page_copyright_weston_frame_timing Copyright
+ * <pre>
+ *
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ * </pre>
+ */
+struct weston_frame_timing;
+struct wl_output;
+
+/**
+ * @page page_iface_weston_frame_timing weston_frame_timing
+ * @section page_iface_weston_frame_timing_desc Description
+ *
+ * Debugging interface to the frame timing histograms weston keeps for
+ * each output. It is only advertised when weston runs with --debug.
+ *
+ * All durations are in microseconds.
+ * @section page_iface_weston_frame_timing_api API
+ * See @ref iface_weston_frame_timing.
+ */
+/**
+ * @defgroup iface_weston_frame_timing The weston_frame_timing interface
+ *
+ * Debugging interface to the frame timing histograms weston keeps for
+ * each output. It is only advertised when weston runs with --debug.
+ *
+ * All durations are in microseconds.
+ */
+extern const struct wl_interface weston_frame_timing_interface;
+
+#ifndef WESTON_FRAME_TIMING_STAGE_ENUM
+#define WESTON_FRAME_TIMING_STAGE_ENUM
+enum weston_frame_timing_stage {
+	/**
+	 * from the start of a repaint to its submission
+	 */
+	WESTON_FRAME_TIMING_STAGE_REPAINT = 0,
+	/**
+	 * from the submission of a repaint to its presentation
+	 */
+	WESTON_FRAME_TIMING_STAGE_LATENCY = 1,
+	/**
+	 * between two presentations of a running repaint loop
+	 */
+	WESTON_FRAME_TIMING_STAGE_INTERVAL = 2,
+};
+#endif /* WESTON_FRAME_TIMING_STAGE_ENUM */
+
+/**
+ * @ingroup iface_weston_frame_timing
+ * @struct weston_frame_timing_listener
+ */
+struct weston_frame_timing_listener {
+	/**
+	 * the histogram of one stage
+	 *
+	 * The buckets are an array of uint32_t sample counts, each
+	 * bucket covering bucket_width microseconds; the last bucket also
+	 * counts the samples beyond it. min, max and mean are zero when
+	 * there are no samples.
+	 * @param stage stage, see the stage enum
+	 */
+	void (*histogram)(void *data,
+			  struct weston_frame_timing *weston_frame_timing,
+			  uint32_t stage,
+			  uint32_t samples,
+			  uint32_t min,
+			  uint32_t max,
+			  uint32_t mean,
+			  uint32_t bucket_width,
+			  struct wl_array *buckets);
+	/**
+	 * all histograms of the output were sent
+	 *
+	 */
+	void (*done)(void *data,
+		     struct weston_frame_timing *weston_frame_timing);
+};
+
+/**
+ * @ingroup weston_frame_timing_iface
+ */
+static inline int
+weston_frame_timing_add_listener(struct weston_frame_timing *weston_frame_timing,
+				 const struct weston_frame_timing_listener *listener, void *data)
+{
+	return wl_proxy_add_listener((struct wl_proxy *) weston_frame_timing,
+				     (void (**)(void)) listener, data);
+}
+
+#define WESTON_FRAME_TIMING_DESTROY	0
+#define WESTON_FRAME_TIMING_GET_HISTOGRAMS	1
+#define WESTON_FRAME_TIMING_RESET	2
+
+/**
+ * @ingroup iface_weston_frame_timing
+ */
+#define WESTON_FRAME_TIMING_DESTROY_SINCE_VERSION	1
+/**
+ * @ingroup iface_weston_frame_timing
+ */
+#define WESTON_FRAME_TIMING_GET_HISTOGRAMS_SINCE_VERSION	1
+/**
+ * @ingroup iface_weston_frame_timing
+ */
+#define WESTON_FRAME_TIMING_RESET_SINCE_VERSION	1
+
+/** @ingroup iface_weston_frame_timing */
+static inline void
+weston_frame_timing_set_user_data(struct weston_frame_timing *weston_frame_timing, void *user_data)
+{
+	wl_proxy_set_user_data((struct wl_proxy *) weston_frame_timing, user_data);
+}
+
+/** @ingroup iface_weston_frame_timing */
+static inline void *
+weston_frame_timing_get_user_data(struct weston_frame_timing *weston_frame_timing)
+{
+	return wl_proxy_get_user_data((struct wl_proxy *) weston_frame_timing);
+}
+
+static inline uint32_t
+weston_frame_timing_get_version(struct weston_frame_timing *weston_frame_timing)
+{
+	return wl_proxy_get_version((struct wl_proxy *) weston_frame_timing);
+}
+
+/**
+ * @ingroup iface_weston_frame_timing
+ */
+static inline void
+weston_frame_timing_destroy(struct weston_frame_timing *weston_frame_timing)
+{
+	wl_proxy_marshal((struct wl_proxy *) weston_frame_timing,
+			 WESTON_FRAME_TIMING_DESTROY);
+
+	wl_proxy_destroy((struct wl_proxy *) weston_frame_timing);
+}
+
+/**
+ * @ingroup iface_weston_frame_timing
+ *
+ * The compositor replies with one histogram event for each stage,
+ * followed by a done event.
+ */
+static inline void
+weston_frame_timing_get_histograms(struct weston_frame_timing *weston_frame_timing, struct wl_output *output)
+{
+	wl_proxy_marshal((struct wl_proxy *) weston_frame_timing,
+			 WESTON_FRAME_TIMING_GET_HISTOGRAMS, output);
+}
+
+/**
+ * @ingroup iface_weston_frame_timing
+ */
+static inline void
+weston_frame_timing_reset(struct weston_frame_timing *weston_frame_timing, struct wl_output *output)
+{
+	wl_proxy_marshal((struct wl_proxy *) weston_frame_timing,
+			 WESTON_FRAME_TIMING_RESET, output);
+}
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
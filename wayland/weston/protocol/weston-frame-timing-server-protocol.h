@@ -0,0 +1,156 @@
+/* Generated by wayland-scanner 1.11.0 */
+
+#ifndef WESTON_FRAME_TIMING_SERVER_PROTOCOL_H
+#define WESTON_FRAME_TIMING_SERVER_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "wayland-server.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+struct wl_client;
+struct wl_resource;
+
+/**
+ * @page page_weston_frame_timing The weston_frame_timing protocol
+ * @section page_ifaces_weston_frame_timing Interfaces
+ * - @subpage page_iface_weston_frame_timing - frame timing statistics
+ * @section page_copyright_weston_frame_timing Copyright
+ * <pre>
+ *
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ * </pre>
+ */
+struct weston_frame_timing;
+struct wl_output;
+
+/**
+ * @page page_iface_weston_frame_timing weston_frame_timing
+ * @section page_iface_weston_frame_timing_desc Description
+ *
+ * Debugging interface to the frame timing histograms weston keeps for
+ * each output. It is only advertised when weston runs with --debug.
+ *
+ * All durations are in microseconds.
+ * @section page_iface_weston_frame_timing_api API
+ * See @ref iface_weston_frame_timing.
+ */
+/**
+ * @defgroup iface_weston_frame_timing The weston_frame_timing interface
+ *
+ * Debugging interface to the frame timing histograms weston keeps for
+ * each output. It is only advertised when weston runs with --debug.
+ *
+ * All durations are in microseconds.
+ */
+extern const struct wl_interface weston_frame_timing_interface;
+
+#ifndef WESTON_FRAME_TIMING_STAGE_ENUM
+#define WESTON_FRAME_TIMING_STAGE_ENUM
+enum weston_frame_timing_stage {
+	/**
+	 * from the start of a repaint to its submission
+	 */
+	WESTON_FRAME_TIMING_STAGE_REPAINT = 0,
+	/**
+	 * from the submission of a repaint to its presentation
+	 */
+	WESTON_FRAME_TIMING_STAGE_LATENCY = 1,
+	/**
+	 * between two presentations of a running repaint loop
+	 */
+	WESTON_FRAME_TIMING_STAGE_INTERVAL = 2,
+};
+#endif /* WESTON_FRAME_TIMING_STAGE_ENUM */
+
+/**
+ * @ingroup iface_weston_frame_timing
+ * @struct weston_frame_timing_interface
+ */
+struct weston_frame_timing_interface {
+	/**
+	 * unbind from the frame timing interface
+	 *
+	 */
+	void (*destroy)(struct wl_client *client,
+			struct wl_resource *resource);
+	/**
+	 * request the histograms of an output
+	 *
+	 * The compositor replies with one histogram event for each
+	 * stage, followed by a done event.
+	 */
+	void (*get_histograms)(struct wl_client *client,
+			       struct wl_resource *resource,
+			       struct wl_resource *output);
+	/**
+	 * clear the histograms of an output
+	 *
+	 */
+	void (*reset)(struct wl_client *client,
+		      struct wl_resource *resource,
+		      struct wl_resource *output);
+};
+
+#define WESTON_FRAME_TIMING_HISTOGRAM	0
+#define WESTON_FRAME_TIMING_DONE	1
+
+/**
+ * @ingroup iface_weston_frame_timing
+ */
+#define WESTON_FRAME_TIMING_HISTOGRAM_SINCE_VERSION	1
+/**
+ * @ingroup iface_weston_frame_timing
+ */
+#define WESTON_FRAME_TIMING_DONE_SINCE_VERSION	1
+
+/**
+ * @ingroup iface_weston_frame_timing
+ * Sends an histogram event to the client owning the resource.
+ * @param resource_ The client's resource
+ * @param stage stage, see the stage enum
+ */
+static inline void
+weston_frame_timing_send_histogram(struct wl_resource *resource_, uint32_t stage, uint32_t samples, uint32_t min, uint32_t max, uint32_t mean, uint32_t bucket_width, struct wl_array *buckets)
+{
+	wl_resource_post_event(resource_, WESTON_FRAME_TIMING_HISTOGRAM, stage, samples, min, max, mean, bucket_width, buckets);
+}
+
+/**
+ * @ingroup iface_weston_frame_timing
+ * Sends an done event to the client owning the resource.
+ * @param resource_ The client's resource
+ */
+static inline void
+weston_frame_timing_send_done(struct wl_resource *resource_)
+{
+	wl_resource_post_event(resource_, WESTON_FRAME_TIMING_DONE);
+}
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -37,6 +37,7 @@
 
 #include "shared/helpers.h"
 #include "image-loader.h"
+#include "image-blur.h"
 #include "config-parser.h"
 
 void
@@ -49,93 +50,102 @@ surface_flush_device(cairo_surface_t *surface)
 		cairo_device_flush(device);
 }
 
+/* The shadow used to be blurred with a 71 tap gaussian, exp(-f² / 71),
+ * which blur_image() approximates with the matching sigma. */
+#define SHADOW_BLUR_SIGMA sqrt(71 / 2.0)
+
 static int
 blur_surface(cairo_surface_t *surface, int margin)
 {
-	int32_t width, height, stride, x, y, z, w;
-	uint8_t *src, *dst;
-	uint32_t *s, *d, a, p;
-	int i, j, k, size, half;
-	uint32_t kernel[71];
-	double f;
-
-	size = ARRAY_LENGTH(kernel);
-	width = cairo_image_surface_get_width(surface);
-	height = cairo_image_surface_get_height(surface);
-	stride = cairo_image_surface_get_stride(surface);
-	src = cairo_image_surface_get_data(surface);
-
-	dst = malloc(height * stride);
-	if (dst == NULL)
-		return -1;
-
-	half = size / 2;
-	a = 0;
-	for (i = 0; i < size; i++) {
-		f = (i - half);
-		kernel[i] = exp(- f * f / ARRAY_LENGTH(kernel)) * 10000;
-		a += kernel[i];
-	}
+	int ret;
+
+	cairo_surface_flush(surface);
+	ret = blur_image(cairo_image_surface_get_data(surface),
+			 cairo_image_surface_get_width(surface),
+			 cairo_image_surface_get_height(surface),
+			 cairo_image_surface_get_stride(surface),
+			 SHADOW_BLUR_SIGMA, margin);
+	cairo_surface_mark_dirty(surface);
 
-	for (i = 0; i < height; i++) {
-		s = (uint32_t *) (src + i * stride);
-		d = (uint32_t *) (dst + i * stride);
-		for (j = 0; j < width; j++) {
-			if (margin < j && j < width - margin) {
-				d[j] = s[j];
-				continue;
-			}
-
-			x = 0;
-			y = 0;
-			z = 0;
-			w = 0;
-			for (k = 0; k < size; k++) {
-				if (j - half + k < 0 || j - half + k >= width)
-					continue;
-				p = s[j - half + k];
-
-				x += (p >> 24) * kernel[k];
-				y += ((p >> 16) & 0xff) * kernel[k];
-				z += ((p >> 8) & 0xff) * kernel[k];
-				w += (p & 0xff) * kernel[k];
-			}
-			d[j] = (x / a << 24) | (y / a << 16) | (z / a << 8) | w / a;
-		}
+	return ret;
+}
+
+/* Blurred shadows, shared by every theme that asks for the same one.
+ * The cache holds no reference: an entry goes away with the last
+ * theme using its surface. */
+struct shadow_entry {
+	struct wl_list link;
+	int width, height, radius, margin;
+	cairo_surface_t *surface;
+};
+
+static struct wl_list shadow_cache = { &shadow_cache, &shadow_cache };
+static cairo_user_data_key_t shadow_entry_key;
+
+static void
+shadow_entry_destroy(void *data)
+{
+	struct shadow_entry *entry = data;
+
+	wl_list_remove(&entry->link);
+	free(entry);
+}
+
+/* Returns a width x height shadow of a rounded rectangle inset by
+ * margin on each side, blurred, to be drawn in nine pieces by
+ * render_shadow(). */
+static cairo_surface_t *
+shadow_get(int width, int height, int radius, int margin)
+{
+	struct shadow_entry *entry;
+	cairo_surface_t *surface;
+	cairo_t *cr;
+
+	wl_list_for_each(entry, &shadow_cache, link) {
+		if (entry->width == width && entry->height == height &&
+		    entry->radius == radius && entry->margin == margin)
+			return cairo_surface_reference(entry->surface);
 	}
 
-	for (i = 0; i < height; i++) {
-		s = (uint32_t *) (dst + i * stride);
-		d = (uint32_t *) (src + i * stride);
-		for (j = 0; j < width; j++) {
-			if (margin <= i && i < height - margin) {
-				d[j] = s[j];
-				continue;
-			}
-
-			x = 0;
-			y = 0;
-			z = 0;
-			w = 0;
-			for (k = 0; k < size; k++) {
-				if (i - half + k < 0 || i - half + k >= height)
-					continue;
-				s = (uint32_t *) (dst + (i - half + k) * stride);
-				p = s[j];
-
-				x += (p >> 24) * kernel[k];
-				y += ((p >> 16) & 0xff) * kernel[k];
-				z += ((p >> 8) & 0xff) * kernel[k];
-				w += (p & 0xff) * kernel[k];
-			}
-			d[j] = (x / a << 24) | (y / a << 16) | (z / a << 8) | w / a;
-		}
+	surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+					     width, height);
+	cr = cairo_create(surface);
+	cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+	cairo_set_source_rgba(cr, 0, 0, 0, 1);
+	rounded_rect(cr, margin, margin, width - margin, height - margin,
+		     radius);
+	cairo_fill(cr);
+	if (cairo_status(cr) != CAIRO_STATUS_SUCCESS)
+		goto err_surface;
+	cairo_destroy(cr);
+	cr = NULL;
+
+	if (blur_surface(surface, (width > height ? width : height) / 2) == -1)
+		goto err_surface;
+
+	entry = malloc(sizeof *entry);
+	if (entry == NULL)
+		goto err_surface;
+	entry->width = width;
+	entry->height = height;
+	entry->radius = radius;
+	entry->margin = margin;
+	entry->surface = surface;
+	if (cairo_surface_set_user_data(surface, &shadow_entry_key, entry,
+					shadow_entry_destroy) !=
+	    CAIRO_STATUS_SUCCESS) {
+		free(entry);
+		goto err_surface;
 	}
+	wl_list_insert(&shadow_cache, &entry->link);
 
-	free(dst);
-	cairo_surface_mark_dirty(surface);
+	return surface;
 
-	return 0;
+ err_surface:
+	if (cr)
+		cairo_destroy(cr);
+	cairo_surface_destroy(surface);
+	return NULL;
 }
 
 void
@@ -340,18 +350,12 @@ rounded_rect(cairo_t *cr, int x0, int y0, int x1, int y1, int radius)
 	cairo_close_path(cr);
 }
 
-cairo_surface_t *
-load_cairo_surface(const char *filename)
+static cairo_surface_t *
+cairo_surface_for_image(pixman_image_t *image)
 {
-	pixman_image_t *image;
 	int width, height, stride;
 	void *data;
 
-	image = load_image(filename);
-	if (image == NULL) {
-		return NULL;
-	}
-
 	data = pixman_image_get_data(image);
 	width = pixman_image_get_width(image);
 	height = pixman_image_get_height(image);
@@ -361,6 +365,39 @@ load_cairo_surface(const char *filename)
 						   width, height, stride);
 }
 
+cairo_surface_t *
+load_cairo_surface(const char *filename)
+{
+	pixman_image_t *image;
+
+	image = load_image(filename);
+	if (image == NULL) {
+		return NULL;
+	}
+
+	return cairo_surface_for_image(image);
+}
+
+int
+load_cairo_surfaces(const char * const *filenames,
+		    cairo_surface_t **surfaces, int count)
+{
+	pixman_image_t **images;
+	int i, loaded;
+
+	images = calloc(count, sizeof *images);
+	if (images == NULL)
+		return 0;
+
+	loaded = load_images(filenames, images, count);
+	for (i = 0; i < count; i++)
+		surfaces[i] = images[i] ?
+			cairo_surface_for_image(images[i]) : NULL;
+	free(images);
+
+	return loaded;
+}
+
 void
 theme_set_background_source(struct theme *t, cairo_t *cr, uint32_t flags)
 {
@@ -391,16 +428,8 @@ theme_create(void)
 	t->width = 6;
 	t->titlebar_height = 27;
 	t->frame_radius = 3;
-	t->shadow = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 128, 128);
-	cr = cairo_create(t->shadow);
-	cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
-	cairo_set_source_rgba(cr, 0, 0, 0, 1);
-	rounded_rect(cr, 32, 32, 96, 96, t->frame_radius);
-	cairo_fill(cr);
-	if (cairo_status (cr) != CAIRO_STATUS_SUCCESS)
-		goto err_shadow;
-	cairo_destroy(cr);
-	if (blur_surface(t->shadow, 64) == -1)
+	t->shadow = shadow_get(128, 128, t->frame_radius, 32);
+	if (t->shadow == NULL)
 		goto err_shadow;
 
 	t->active_frame =
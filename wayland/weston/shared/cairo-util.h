@@ -48,6 +48,10 @@ rounded_rect(cairo_t *cr, int x0, int y0, int x1, int y1, int radius);
 cairo_surface_t *
 load_cairo_surface(const char *filename);
 
+int
+load_cairo_surfaces(const char * const *filenames,
+		    cairo_surface_t **surfaces, int count);
+
 struct theme {
 	cairo_surface_t *active_frame;
 	cairo_surface_t *inactive_frame;
@@ -25,6 +25,7 @@
 
 #include "config.h"
 
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,6 +34,7 @@
 #include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
@@ -40,21 +42,82 @@
 #include <wayland-util.h>
 #include "config-parser.h"
 #include "helpers.h"
+#include "zalloc.h"
 
 struct weston_config_entry {
 	char *key;
 	char *value;
 	struct wl_list link;
+
+	/* Values already converted by the typed getters, as a mask of
+	 * enum config_value_type; valid is set for the ones that
+	 * converted without error. */
+	uint32_t parsed;
+	uint32_t valid;
+	int32_t int_value;
+	uint32_t uint_value;
+	double double_value;
+	int bool_value;
 };
 
 struct weston_config_section {
 	char *name;
+	struct weston_config *config;
 	struct wl_list entry_list;
 	struct wl_list link;
 };
 
+enum config_value_type {
+	CONFIG_VALUE_INT = 1 << 0,
+	CONFIG_VALUE_UINT = 1 << 1,
+	CONFIG_VALUE_DOUBLE = 1 << 2,
+	CONFIG_VALUE_BOOL = 1 << 3
+};
+
+/* Section names, keys and values are interned, so the same string
+ * always lives at the same address and the index below can compare
+ * keys by pointer. */
+struct config_string {
+	uint32_t hash;
+	uint32_t length;
+	char data[];
+};
+
+enum config_slot_type {
+	CONFIG_SLOT_EMPTY = 0,
+	CONFIG_SLOT_SECTION,	/* name -> first section */
+	CONFIG_SLOT_SELECTOR,	/* name, key, value -> first section */
+	CONFIG_SLOT_ENTRY	/* section, key -> first entry */
+};
+
+struct config_slot {
+	uint32_t type;
+	uint32_t hash;
+	const void *keys[3];
+	void *item;
+};
+
+#define CONFIG_ARENA_BLOCK_SIZE 16384
+
+struct config_arena_block {
+	struct config_arena_block *next;
+	size_t size;
+	size_t used;
+	char data[];
+};
+
 struct weston_config {
 	struct wl_list section_list;
+	struct config_arena_block *arena;
+
+	struct config_string **strings;
+	uint32_t strings_size;
+	uint32_t strings_count;
+
+	struct config_slot *index;
+	uint32_t index_size;
+	uint32_t index_count;
+
 	char path[PATH_MAX];
 };
 
@@ -115,19 +178,272 @@ open_config_file(struct weston_config *c, const char *name)
 	return open(c->path, O_RDONLY | O_CLOEXEC);
 }
 
+static void *
+config_arena_alloc(struct weston_config *config, size_t size)
+{
+	struct config_arena_block *block = config->arena;
+	size_t block_size;
+	void *p;
+
+	size = (size + 7) & ~(size_t) 7;
+	if (block == NULL || block->size - block->used < size) {
+		block_size = size > CONFIG_ARENA_BLOCK_SIZE ?
+			size : CONFIG_ARENA_BLOCK_SIZE;
+		block = malloc(sizeof *block + block_size);
+		if (block == NULL)
+			return NULL;
+		block->size = block_size;
+		block->used = 0;
+		block->next = config->arena;
+		config->arena = block;
+	}
+
+	p = block->data + block->used;
+	block->used += size;
+
+	return p;
+}
+
+static uint32_t
+config_hash_string(const char *s, size_t length)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < length; i++)
+		hash = (hash ^ (uint8_t) s[i]) * 16777619u;
+
+	return hash;
+}
+
+static uint32_t
+config_hash_keys(uint32_t type, const void *a, const void *b, const void *c)
+{
+	uint64_t hash = type;
+
+	hash = (hash ^ (uintptr_t) a) * 0x9e3779b97f4a7c15ull;
+	hash = (hash ^ (uintptr_t) b) * 0x9e3779b97f4a7c15ull;
+	hash = (hash ^ (uintptr_t) c) * 0x9e3779b97f4a7c15ull;
+
+	return hash >> 32;
+}
+
+static struct config_string **
+config_string_slot(struct weston_config *config,
+		   const char *s, size_t length, uint32_t hash)
+{
+	struct config_string **slot;
+	uint32_t mask = config->strings_size - 1;
+	uint32_t i;
+
+	for (i = hash & mask; ; i = (i + 1) & mask) {
+		slot = &config->strings[i];
+		if (*slot == NULL)
+			return slot;
+		if ((*slot)->hash == hash && (*slot)->length == length &&
+		    memcmp((*slot)->data, s, length) == 0)
+			return slot;
+	}
+}
+
+/* Returns the interned copy of str, or NULL if no section name, key or
+ * value in the file is equal to str. */
+static const char *
+config_lookup_string(struct weston_config *config, const char *str)
+{
+	struct config_string **slot;
+	size_t length;
+
+	if (str == NULL || config->strings_size == 0)
+		return NULL;
+
+	length = strlen(str);
+	slot = config_string_slot(config, str, length,
+				  config_hash_string(str, length));
+
+	return *slot ? (*slot)->data : NULL;
+}
+
+static int
+config_grow_strings(struct weston_config *config)
+{
+	struct config_string **old = config->strings;
+	uint32_t old_size = config->strings_size;
+	uint32_t i;
+
+	config->strings_size = old_size ? old_size * 2 : 256;
+	config->strings = calloc(config->strings_size, sizeof *config->strings);
+	if (config->strings == NULL) {
+		config->strings = old;
+		config->strings_size = old_size;
+		return -1;
+	}
+
+	for (i = 0; i < old_size; i++)
+		if (old[i])
+			*config_string_slot(config, old[i]->data,
+					    old[i]->length, old[i]->hash) =
+				old[i];
+	free(old);
+
+	return 0;
+}
+
+static char *
+config_intern(struct weston_config *config, const char *s, size_t length)
+{
+	struct config_string **slot, *string;
+	uint32_t hash = config_hash_string(s, length);
+
+	if ((config->strings_count + 1) * 4 > config->strings_size * 3 &&
+	    config_grow_strings(config) < 0)
+		return NULL;
+
+	slot = config_string_slot(config, s, length, hash);
+	if (*slot)
+		return (*slot)->data;
+
+	string = config_arena_alloc(config, sizeof *string + length + 1);
+	if (string == NULL)
+		return NULL;
+	string->hash = hash;
+	string->length = length;
+	memcpy(string->data, s, length);
+	string->data[length] = '\0';
+
+	*slot = string;
+	config->strings_count++;
+
+	return string->data;
+}
+
+static struct config_slot *
+config_index_slot(struct weston_config *config, uint32_t type, uint32_t hash,
+		  const void *a, const void *b, const void *c)
+{
+	struct config_slot *slot;
+	uint32_t mask = config->index_size - 1;
+	uint32_t i;
+
+	for (i = hash & mask; ; i = (i + 1) & mask) {
+		slot = &config->index[i];
+		if (slot->type == CONFIG_SLOT_EMPTY)
+			return slot;
+		if (slot->type == type && slot->hash == hash &&
+		    slot->keys[0] == a && slot->keys[1] == b &&
+		    slot->keys[2] == c)
+			return slot;
+	}
+}
+
+static void *
+config_index_find(struct weston_config *config, uint32_t type,
+		  const void *a, const void *b, const void *c)
+{
+	struct config_slot *slot;
+
+	if (config->index_size == 0)
+		return NULL;
+
+	slot = config_index_slot(config, type,
+				 config_hash_keys(type, a, b, c), a, b, c);
+
+	return slot->item;
+}
+
+static int
+config_grow_index(struct weston_config *config)
+{
+	struct config_slot *old = config->index, *slot;
+	uint32_t old_size = config->index_size;
+	uint32_t i;
+
+	config->index_size = old_size ? old_size * 2 : 256;
+	config->index = calloc(config->index_size, sizeof *config->index);
+	if (config->index == NULL) {
+		config->index = old;
+		config->index_size = old_size;
+		return -1;
+	}
+
+	for (i = 0; i < old_size; i++) {
+		if (old[i].type == CONFIG_SLOT_EMPTY)
+			continue;
+		slot = config_index_slot(config, old[i].type, old[i].hash,
+					 old[i].keys[0], old[i].keys[1],
+					 old[i].keys[2]);
+		*slot = old[i];
+	}
+	free(old);
+
+	return 0;
+}
+
+/* Adds item to the index unless the keys are already taken, since
+ * lookups return the first match in file order.  Returns 1 if the item
+ * was added, 0 if an earlier one was kept and -1 on allocation failure. */
+static int
+config_index_add(struct weston_config *config, uint32_t type,
+		 const void *a, const void *b, const void *c, void *item)
+{
+	struct config_slot *slot;
+	uint32_t hash = config_hash_keys(type, a, b, c);
+
+	if ((config->index_count + 1) * 4 > config->index_size * 3 &&
+	    config_grow_index(config) < 0)
+		return -1;
+
+	slot = config_index_slot(config, type, hash, a, b, c);
+	if (slot->type != CONFIG_SLOT_EMPTY)
+		return 0;
+
+	slot->type = type;
+	slot->hash = hash;
+	slot->keys[0] = a;
+	slot->keys[1] = b;
+	slot->keys[2] = c;
+	slot->item = item;
+	config->index_count++;
+
+	return 1;
+}
+
+/* Sizes the tables for a file of the given size, assuming lines of
+ * about 16 bytes, so parsing a typical file never rehashes. */
+static int
+config_reserve(struct weston_config *config, size_t file_size)
+{
+	size_t lines = file_size / 16;
+	uint32_t size = 256;
+
+	while (size < lines * 2 && size < (1u << 24))
+		size *= 2;
+
+	config->strings = calloc(size, sizeof *config->strings);
+	config->index = calloc(size * 2, sizeof *config->index);
+	if (config->strings == NULL || config->index == NULL)
+		return -1;
+	config->strings_size = size;
+	config->index_size = size * 2;
+
+	return 0;
+}
+
 static struct weston_config_entry *
 config_section_get_entry(struct weston_config_section *section,
 			 const char *key)
 {
-	struct weston_config_entry *e;
+	const char *k;
 
 	if (section == NULL)
 		return NULL;
-	wl_list_for_each(e, &section->entry_list, link)
-		if (strcmp(e->key, key) == 0)
-			return e;
 
-	return NULL;
+	k = config_lookup_string(section->config, key);
+	if (k == NULL)
+		return NULL;
+
+	return config_index_find(section->config, CONFIG_SLOT_ENTRY,
+				 section, k, NULL);
 }
 
 WL_EXPORT
@@ -135,22 +451,77 @@ struct weston_config_section *
 weston_config_get_section(struct weston_config *config, const char *section,
 			  const char *key, const char *value)
 {
-	struct weston_config_section *s;
-	struct weston_config_entry *e;
+	const char *name, *k, *v;
 
 	if (config == NULL)
 		return NULL;
-	wl_list_for_each(s, &config->section_list, link) {
-		if (strcmp(s->name, section) != 0)
-			continue;
-		if (key == NULL)
-			return s;
-		e = config_section_get_entry(s, key);
-		if (e && strcmp(e->value, value) == 0)
-			return s;
+
+	name = config_lookup_string(config, section);
+	if (name == NULL)
+		return NULL;
+	if (key == NULL)
+		return config_index_find(config, CONFIG_SLOT_SECTION,
+					 name, NULL, NULL);
+
+	k = config_lookup_string(config, key);
+	v = config_lookup_string(config, value);
+	if (k == NULL || v == NULL)
+		return NULL;
+
+	return config_index_find(config, CONFIG_SLOT_SELECTOR, name, k, v);
+}
+
+static void
+config_entry_parse(struct weston_config_entry *entry,
+		   enum config_value_type type)
+{
+	char *end = NULL;
+
+	switch (type) {
+	case CONFIG_VALUE_INT:
+		entry->int_value = strtol(entry->value, &end, 0);
+		break;
+	case CONFIG_VALUE_UINT:
+		entry->uint_value = strtoul(entry->value, &end, 0);
+		break;
+	case CONFIG_VALUE_DOUBLE:
+		entry->double_value = strtod(entry->value, &end);
+		break;
+	case CONFIG_VALUE_BOOL:
+		entry->bool_value = strcmp(entry->value, "true") == 0;
+		if (entry->bool_value || strcmp(entry->value, "false") == 0)
+			entry->valid |= type;
+		break;
+	}
+
+	entry->parsed |= type;
+	if (end && *end == '\0')
+		entry->valid |= type;
+}
+
+/* Looks up key and converts its value once, later calls return the
+ * cached result.  Returns NULL with errno set if there is no valid
+ * value. */
+static struct weston_config_entry *
+config_section_get_value(struct weston_config_section *section,
+			 const char *key, enum config_value_type type)
+{
+	struct weston_config_entry *entry;
+
+	entry = config_section_get_entry(section, key);
+	if (entry == NULL) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	if (!(entry->parsed & type))
+		config_entry_parse(entry, type);
+	if (!(entry->valid & type)) {
+		errno = EINVAL;
+		return NULL;
 	}
 
-	return NULL;
+	return entry;
 }
 
 WL_EXPORT
@@ -160,21 +531,14 @@ weston_config_section_get_int(struct weston_config_section *section,
 			      int32_t *value, int32_t default_value)
 {
 	struct weston_config_entry *entry;
-	char *end;
 
-	entry = config_section_get_entry(section, key);
+	entry = config_section_get_value(section, key, CONFIG_VALUE_INT);
 	if (entry == NULL) {
 		*value = default_value;
-		errno = ENOENT;
 		return -1;
 	}
 
-	*value = strtol(entry->value, &end, 0);
-	if (*end != '\0') {
-		*value = default_value;
-		errno = EINVAL;
-		return -1;
-	}
+	*value = entry->int_value;
 
 	return 0;
 }
@@ -186,21 +550,14 @@ weston_config_section_get_uint(struct weston_config_section *section,
 			       uint32_t *value, uint32_t default_value)
 {
 	struct weston_config_entry *entry;
-	char *end;
 
-	entry = config_section_get_entry(section, key);
+	entry = config_section_get_value(section, key, CONFIG_VALUE_UINT);
 	if (entry == NULL) {
 		*value = default_value;
-		errno = ENOENT;
 		return -1;
 	}
 
-	*value = strtoul(entry->value, &end, 0);
-	if (*end != '\0') {
-		*value = default_value;
-		errno = EINVAL;
-		return -1;
-	}
+	*value = entry->uint_value;
 
 	return 0;
 }
@@ -212,21 +569,14 @@ weston_config_section_get_double(struct weston_config_section *section,
 				 double *value, double default_value)
 {
 	struct weston_config_entry *entry;
-	char *end;
 
-	entry = config_section_get_entry(section, key);
+	entry = config_section_get_value(section, key, CONFIG_VALUE_DOUBLE);
 	if (entry == NULL) {
 		*value = default_value;
-		errno = ENOENT;
 		return -1;
 	}
 
-	*value = strtod(entry->value, &end);
-	if (*end != '\0') {
-		*value = default_value;
-		errno = EINVAL;
-		return -1;
-	}
+	*value = entry->double_value;
 
 	return 0;
 }
@@ -262,22 +612,13 @@ weston_config_section_get_bool(struct weston_config_section *section,
 {
 	struct weston_config_entry *entry;
 
-	entry = config_section_get_entry(section, key);
+	entry = config_section_get_value(section, key, CONFIG_VALUE_BOOL);
 	if (entry == NULL) {
 		*value = default_value;
-		errno = ENOENT;
 		return -1;
 	}
 
-	if (strcmp(entry->value, "false") == 0)
-		*value = 0;
-	else if (strcmp(entry->value, "true") == 0)
-		*value = 1;
-	else {
-		*value = default_value;
-		errno = EINVAL;
-		return -1;
-	}
+	*value = entry->bool_value;
 
 	return 0;
 }
@@ -307,19 +648,23 @@ weston_config_get_name_from_env(void)
 }
 
 static struct weston_config_section *
-config_add_section(struct weston_config *config, const char *name)
+config_add_section(struct weston_config *config,
+		   const char *name, size_t length)
 {
 	struct weston_config_section *section;
 
-	section = malloc(sizeof *section);
+	section = config_arena_alloc(config, sizeof *section);
 	if (section == NULL)
 		return NULL;
 
-	section->name = strdup(name);
-	if (section->name == NULL) {
-		free(section);
+	section->name = config_intern(config, name, length);
+	if (section->name == NULL)
+		return NULL;
+	section->config = config;
+
+	if (config_index_add(config, CONFIG_SLOT_SECTION,
+			     section->name, NULL, NULL, section) < 0)
 		return NULL;
-	}
 
 	wl_list_init(&section->entry_list);
 	wl_list_insert(config->section_list.prev, &section->link);
@@ -329,43 +674,106 @@ config_add_section(struct weston_config *config, const char *name)
 
 static struct weston_config_entry *
 section_add_entry(struct weston_config_section *section,
-		  const char *key, const char *value)
+		  const char *key, size_t key_length,
+		  const char *value, size_t value_length)
 {
+	struct weston_config *config = section->config;
 	struct weston_config_entry *entry;
+	int first;
 
-	entry = malloc(sizeof *entry);
+	entry = config_arena_alloc(config, sizeof *entry);
 	if (entry == NULL)
 		return NULL;
+	memset(entry, 0, sizeof *entry);
 
-	entry->key = strdup(key);
-	if (entry->key == NULL) {
-		free(entry);
+	entry->key = config_intern(config, key, key_length);
+	entry->value = config_intern(config, value, value_length);
+	if (entry->key == NULL || entry->value == NULL)
 		return NULL;
-	}
 
-	entry->value = strdup(value);
-	if (entry->value == NULL) {
-		free(entry->key);
-		free(entry);
+	/* Only the first occurrence of a key in a section is visible,
+	 * both to lookups and to weston_config_get_section() selectors. */
+	first = config_index_add(config, CONFIG_SLOT_ENTRY,
+				 section, entry->key, NULL, entry);
+	if (first > 0)
+		first = config_index_add(config, CONFIG_SLOT_SELECTOR,
+					 section->name, entry->key,
+					 entry->value, section);
+	if (first < 0)
 		return NULL;
-	}
 
 	wl_list_insert(section->entry_list.prev, &entry->link);
 
 	return entry;
 }
 
+static int
+config_parse_buffer(struct weston_config *config,
+		    const char *buffer, size_t size)
+{
+	const char *line, *end = buffer + size;
+	const char *eol, *next, *p, *value;
+	struct weston_config_section *section = NULL;
+
+	for (line = buffer; line < end; line = next) {
+		eol = memchr(line, '\n', end - line);
+		if (eol) {
+			next = eol + 1;
+		} else {
+			eol = end;
+			next = end;
+		}
+
+		switch (line[0]) {
+		case '#':
+		case '\n':
+			continue;
+		case '[':
+			p = memchr(line + 1, ']', eol - line - 1);
+			if (!p || p + 1 != eol || eol == end) {
+				fprintf(stderr, "malformed "
+					"section header: %.*s\n",
+					(int)(eol - line), line);
+				return -1;
+			}
+			section = config_add_section(config, line + 1,
+						     p - line - 1);
+			if (section == NULL)
+				return -1;
+			continue;
+		default:
+			p = memchr(line, '=', eol - line);
+			if (!p || p == line || !section) {
+				fprintf(stderr, "malformed "
+					"config line: %.*s\n",
+					(int)(eol - line), line);
+				return -1;
+			}
+
+			value = p + 1;
+			while (value < eol && isspace(*value))
+				value++;
+			while (eol > value && isspace(eol[-1]))
+				eol--;
+			if (!section_add_entry(section, line, p - line,
+					       value, eol - value))
+				return -1;
+			continue;
+		}
+	}
+
+	return 0;
+}
+
 struct weston_config *
 weston_config_parse(const char *name)
 {
-	FILE *fp;
-	char line[512], *p;
 	struct stat filestat;
 	struct weston_config *config;
-	struct weston_config_section *section = NULL;
-	int i, fd;
+	void *map = NULL;
+	int fd, ret;
 
-	config = malloc(sizeof *config);
+	config = zalloc(sizeof *config);
 	if (config == NULL)
 		return NULL;
 
@@ -384,55 +792,30 @@ weston_config_parse(const char *name)
 		return NULL;
 	}
 
-	fp = fdopen(fd, "r");
-	if (fp == NULL) {
-		free(config);
-		return NULL;
+	/* The whole file is parsed in one pass over a read-only mapping;
+	 * everything that outlives the parse is copied into the arena. */
+	if (filestat.st_size > 0) {
+		map = mmap(NULL, filestat.st_size, PROT_READ, MAP_PRIVATE,
+			   fd, 0);
+		if (map == MAP_FAILED) {
+			close(fd);
+			free(config);
+			return NULL;
+		}
 	}
+	close(fd);
 
-	while (fgets(line, sizeof line, fp)) {
-		switch (line[0]) {
-		case '#':
-		case '\n':
-			continue;
-		case '[':
-			p = strchr(&line[1], ']');
-			if (!p || p[1] != '\n') {
-				fprintf(stderr, "malformed "
-					"section header: %s\n", line);
-				fclose(fp);
-				weston_config_destroy(config);
-				return NULL;
-			}
-			p[0] = '\0';
-			section = config_add_section(config, &line[1]);
-			continue;
-		default:
-			p = strchr(line, '=');
-			if (!p || p == line || !section) {
-				fprintf(stderr, "malformed "
-					"config line: %s\n", line);
-				fclose(fp);
-				weston_config_destroy(config);
-				return NULL;
-			}
+	ret = config_reserve(config, filestat.st_size);
+	if (ret == 0)
+		ret = config_parse_buffer(config, map, filestat.st_size);
+	if (map)
+		munmap(map, filestat.st_size);
 
-			p[0] = '\0';
-			p++;
-			while (isspace(*p))
-				p++;
-			i = strlen(p);
-			while (i > 0 && isspace(p[i - 1])) {
-				p[i - 1] = '\0';
-				i--;
-			}
-			section_add_entry(section, line, p);
-			continue;
-		}
+	if (ret < 0) {
+		weston_config_destroy(config);
+		return NULL;
 	}
 
-	fclose(fp);
-
 	return config;
 }
 
@@ -468,21 +851,17 @@ weston_config_next_section(struct weston_config *config,
 void
 weston_config_destroy(struct weston_config *config)
 {
-	struct weston_config_section *s, *next_s;
-	struct weston_config_entry *e, *next_e;
+	struct config_arena_block *block, *next;
 
 	if (config == NULL)
 		return;
 
-	wl_list_for_each_safe(s, next_s, &config->section_list, link) {
-		wl_list_for_each_safe(e, next_e, &s->entry_list, link) {
-			free(e->key);
-			free(e->value);
-			free(e);
-		}
-		free(s->name);
-		free(s);
+	for (block = config->arena; block; block = next) {
+		next = block->next;
+		free(block);
 	}
 
+	free(config->strings);
+	free(config->index);
 	free(config);
 }
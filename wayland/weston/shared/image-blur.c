@@ -0,0 +1,298 @@
+/*
+ * Copyright © 2008 Kristian Høgsberg
+ * Copyright © 2012 Intel Corporation
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "shared/helpers.h"
+#include "image-blur.h"
+
+/* Columns per strip of the vertical pass: the running sums of a strip
+ * stay in L1 while the pass walks down the rows. */
+#define BLUR_STRIP 64
+
+/* The box sums live in 16 bit lanes, which holds 255 * 257. */
+#define BLUR_MAX_RADIUS 127
+
+/* Picks the three box radii whose combined variance is closest to
+ * sigma², as two boxes of one odd width and one of the next. */
+static void
+box_radii(double sigma, int radius[3])
+{
+	double variance = sigma * sigma, ideal;
+	int lower, m, i, w;
+
+	ideal = sqrt(12 * variance / 3 + 1);
+	lower = floor(ideal);
+	if (lower % 2 == 0)
+		lower--;
+	if (lower < 1)
+		lower = 1;
+
+	m = round((12 * variance - 3 * lower * lower - 12 * lower - 9) /
+		  (-4.0 * lower - 4));
+
+	for (i = 0; i < 3; i++) {
+		w = i < m ? lower : lower + 2;
+		radius[i] = MIN((w - 1) / 2, BLUR_MAX_RADIUS);
+	}
+}
+
+/* One pixel with a channel in each 16 bit lane of a uint64_t, so a
+ * single add moves all four channels of a running sum.  The lanes
+ * never borrow: a sum only loses pixels it has gained before. */
+static inline uint64_t
+widen(uint32_t p)
+{
+	return (p & 0xff) |
+	       (uint64_t) (p & 0xff00) << 8 |
+	       (uint64_t) (p & 0xff0000) << 16 |
+	       (uint64_t) (p >> 24) << 48;
+}
+
+/* Divides each lane by the box width, as a rounded multiply by the
+ * 16 bit reciprocal. */
+static inline uint32_t
+narrow(uint64_t sum, uint32_t bias, uint32_t mul)
+{
+	uint32_t c0, c1, c2, c3;
+
+	c0 = (((uint32_t) sum & 0xffff) + bias) * mul >> 16;
+	c1 = (((uint32_t) (sum >> 16) & 0xffff) + bias) * mul >> 16;
+	c2 = (((uint32_t) (sum >> 32) & 0xffff) + bias) * mul >> 16;
+	c3 = ((uint32_t) (sum >> 48) + bias) * mul >> 16;
+
+	return c0 | c1 << 8 | c2 << 16 | c3 << 24;
+}
+
+static void
+box_line(const uint32_t *in, uint32_t *out, int n, int r)
+{
+	uint32_t w = 2 * r + 1, bias = w / 2, mul = (65536 + bias) / w;
+	uint64_t sum = 0;
+	int i;
+
+	if (r == 0) {
+		memcpy(out, in, n * sizeof *out);
+		return;
+	}
+
+	for (i = 0; i < r && i < n; i++)
+		sum += widen(in[i]);
+
+	for (i = 0; i < n; i++) {
+		if (i + r < n)
+			sum += widen(in[i + r]);
+		out[i] = narrow(sum, bias, mul);
+		if (i - r >= 0)
+			sum -= widen(in[i - r]);
+	}
+}
+
+/* The vertical box over a strip of n columns.  Every row of the strip
+ * is read and written in one go, the running sums of all columns
+ * advancing together; the vector paths take two pixels at a time. */
+static void
+box_strip(const uint32_t *in, int in_stride, uint32_t *out, int out_stride,
+	  int n, int height, int r)
+{
+	uint32_t w = 2 * r + 1, bias = w / 2, mul = (65536 + bias) / w;
+	uint64_t sum[BLUR_STRIP];
+	const uint32_t *add, *sub;
+	uint32_t *d;
+	int x = 0, y, pairs = 0;
+
+#if defined(__SSE2__)
+	__m128i vsum[BLUR_STRIP / 2], vbias, vmul, zero, v;
+
+	pairs = n / 2;
+	vbias = _mm_set1_epi16(bias);
+	vmul = _mm_set1_epi16(mul);
+	zero = _mm_setzero_si128();
+	for (x = 0; x < pairs; x++)
+		vsum[x] = zero;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	uint16x8_t vsum[BLUR_STRIP / 2], vbias, v;
+	uint16x4_t vmul;
+
+	pairs = n / 2;
+	vbias = vdupq_n_u16(bias);
+	vmul = vdup_n_u16(mul);
+	for (x = 0; x < pairs; x++)
+		vsum[x] = vdupq_n_u16(0);
+#endif
+	for (x = pairs * 2; x < n; x++)
+		sum[x] = 0;
+
+	for (y = -r; y < height; y++) {
+		add = y + r < height ? in + (y + r) * in_stride : NULL;
+		sub = y - r >= 0 ? in + (y - r) * in_stride : NULL;
+		d = y >= 0 ? out + y * out_stride : NULL;
+
+#if defined(__SSE2__)
+		for (x = 0; x < pairs; x++) {
+			if (add)
+				vsum[x] = _mm_add_epi16(vsum[x],
+					_mm_unpacklo_epi8(_mm_loadl_epi64(
+					(const __m128i *) (add + 2 * x)), zero));
+			if (d) {
+				v = _mm_mulhi_epu16(_mm_add_epi16(vsum[x],
+								  vbias), vmul);
+				_mm_storel_epi64((__m128i *) (d + 2 * x),
+						 _mm_packus_epi16(v, v));
+			}
+			if (sub)
+				vsum[x] = _mm_sub_epi16(vsum[x],
+					_mm_unpacklo_epi8(_mm_loadl_epi64(
+					(const __m128i *) (sub + 2 * x)), zero));
+		}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+		for (x = 0; x < pairs; x++) {
+			if (add)
+				vsum[x] = vaddw_u8(vsum[x], vld1_u8(
+					(const uint8_t *) (add + 2 * x)));
+			if (d) {
+				v = vaddq_u16(vsum[x], vbias);
+				v = vcombine_u16(
+					vshrn_n_u32(vmull_u16(vget_low_u16(v),
+							      vmul), 16),
+					vshrn_n_u32(vmull_u16(vget_high_u16(v),
+							      vmul), 16));
+				vst1_u8((uint8_t *) (d + 2 * x), vmovn_u16(v));
+			}
+			if (sub)
+				vsum[x] = vsubw_u8(vsum[x], vld1_u8(
+					(const uint8_t *) (sub + 2 * x)));
+		}
+#endif
+		for (x = pairs * 2; x < n; x++) {
+			if (add)
+				sum[x] += widen(add[x]);
+			if (d)
+				d[x] = narrow(sum[x], bias, mul);
+			if (sub)
+				sum[x] -= widen(sub[x]);
+		}
+	}
+}
+
+static void
+box_columns(const uint32_t *in, int in_stride, uint32_t *out, int out_stride,
+	    int width, int height, int r)
+{
+	int x, y;
+
+	if (r == 0) {
+		for (y = 0; y < height; y++)
+			memcpy(out + y * out_stride, in + y * in_stride,
+			       width * sizeof *out);
+		return;
+	}
+
+	for (x = 0; x < width; x += BLUR_STRIP)
+		box_strip(in + x, in_stride, out + x, out_stride,
+			  MIN(BLUR_STRIP, width - x), height, r);
+}
+
+int
+blur_image(void *data, int width, int height, int stride,
+	   double sigma, int margin)
+{
+	uint32_t *image = data, *row, *line, *a, *b;
+	int radius[3], pitch = stride / 4;
+	int x, y, pad, w, h;
+
+	if (width <= 0 || height <= 0)
+		return 0;
+
+	/* What the first pass spreads past the edge is still there for
+	 * the next ones to pull back in, so the scratch buffers reach
+	 * pad pixels beyond the image on each side. */
+	box_radii(sigma, radius);
+	pad = radius[0] + radius[1] + radius[2];
+	w = width + 2 * pad;
+	h = height + 2 * pad;
+
+	line = malloc(2 * w * sizeof *line);
+	a = calloc(width * h, sizeof *a);
+	b = malloc(width * h * sizeof *b);
+	if (line == NULL || a == NULL || b == NULL) {
+		free(line);
+		free(a);
+		free(b);
+		return -1;
+	}
+
+	/* Horizontal: three boxes along each padded row, the result in
+	 * the rows of a past the top padding. */
+	for (y = 0; y < height; y++) {
+		row = image + y * pitch;
+		memset(line, 0, w * sizeof *line);
+		memcpy(line + pad, row, width * sizeof *row);
+		box_line(line, line + w, w, radius[0]);
+		box_line(line + w, line, w, radius[1]);
+		box_line(line, line + w, w, radius[2]);
+		for (x = 0; x < width; x++)
+			a[(y + pad) * width + x] =
+				margin < x && x < width - margin ?
+				row[x] : line[w + pad + x];
+	}
+
+	/* The rows the vertical pass keeps are final already. */
+	for (y = 0; y < height; y++) {
+		if (margin <= y && y < height - margin)
+			memcpy(image + y * pitch, a + (y + pad) * width,
+			       width * sizeof *image);
+	}
+
+	/* Vertical: a -> b -> a -> b over the padded height. */
+	box_columns(a, width, b, width, width, h, radius[0]);
+	box_columns(b, width, a, width, width, h, radius[1]);
+	box_columns(a, width, b, width, width, h, radius[2]);
+	for (y = 0; y < height; y++) {
+		if (margin <= y && y < height - margin)
+			continue;
+		memcpy(image + y * pitch, b + (y + pad) * width,
+		       width * sizeof *image);
+	}
+
+	free(line);
+	free(a);
+	free(b);
+
+	return 0;
+}
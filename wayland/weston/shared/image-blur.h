@@ -0,0 +1,56 @@
+/*
+ * Copyright © 2008 Kristian Høgsberg
+ * Copyright © 2012 Intel Corporation
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_IMAGE_BLUR_H
+#define WESTON_IMAGE_BLUR_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/* Blurs the a8r8g8b8 (or any other four byte per pixel) image in
+ * place.  The gaussian of the given sigma is approximated by three
+ * box filters in each direction, so the cost does not depend on the
+ * radius.  Pixels outside the image count as transparent black.
+ *
+ * Like the gaussian it replaces, the blur leaves alone the columns
+ * more than margin pixels from the left and right edges in the
+ * horizontal pass and the rows at least margin pixels from the top and
+ * bottom in the vertical pass; pass a margin of half the size or more
+ * to blur everything.
+ *
+ * The stride is in bytes and must be a multiple of four.  Returns -1
+ * if the scratch buffers cannot be allocated, 0 otherwise. */
+int
+blur_image(void *data, int width, int height, int stride,
+	   double sigma, int margin);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* WESTON_IMAGE_BLUR_H */
@@ -0,0 +1,203 @@
+/*
+ * Copyright © 2008-2012 Kristian Høgsberg
+ * Copyright © 2012 Intel Corporation
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__GNUC__) && !defined(__SSSE3__)
+#define IMAGE_CONVERT_SSSE3_DISPATCH 1
+#include <tmmintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && \
+	!defined(__ARM_BIG_ENDIAN)
+#define IMAGE_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+#include "image-convert.h"
+
+/* The exact (a * c + 127) / 255 that the loaders have always used */
+static inline uint8_t
+multiply_alpha(int alpha, int color)
+{
+	int temp = (alpha * color) + 0x80;
+
+	return ((temp + (temp >> 8)) >> 8);
+}
+
+/* Converts the pixels below end, from the last one down, so the
+ * wider output never overwrites input that is still to be read. */
+static void
+rgb_to_xrgb_scalar(uint8_t *row, int end)
+{
+	uint8_t *s;
+	uint32_t *d;
+
+	s = row + (end - 1) * 3;
+	d = (uint32_t *) (row + (end - 1) * 4);
+	while (s >= row) {
+		*d = 0xff000000 | (s[0] << 16) | (s[1] << 8) | (s[2] << 0);
+		s -= 3;
+		d--;
+	}
+}
+
+#if defined(__SSSE3__) || defined(IMAGE_CONVERT_SSSE3_DISPATCH)
+
+/* Four pixels per step, highest first.  Each 16 byte load reads four
+ * bytes past the group's twelve, which are either already converted
+ * output or, for the last group, still inside the width * 4 row. */
+#ifdef IMAGE_CONVERT_SSSE3_DISPATCH
+__attribute__((target("ssse3")))
+#endif
+static int
+rgb_to_xrgb_ssse3(uint8_t *row, int width)
+{
+	const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1,
+					      8, 7, 6, -1, 11, 10, 9, -1);
+	const __m128i alpha = _mm_set1_epi32(0xff000000);
+	__m128i v;
+	int i;
+
+	for (i = width; i >= 4; i -= 4) {
+		v = _mm_loadu_si128((const __m128i *) (row + (i - 4) * 3));
+		v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha);
+		_mm_storeu_si128((__m128i *) (row + (i - 4) * 4), v);
+	}
+
+	return i;
+}
+
+#endif
+
+void
+image_rgb_to_xrgb(uint8_t *row, int width)
+{
+	int end = width;
+
+#if defined(__SSSE3__)
+	end = rgb_to_xrgb_ssse3(row, width);
+#elif defined(IMAGE_CONVERT_SSSE3_DISPATCH)
+	if (__builtin_cpu_supports("ssse3"))
+		end = rgb_to_xrgb_ssse3(row, width);
+#elif defined(IMAGE_CONVERT_NEON)
+	uint8x8x3_t rgb;
+	uint8x8x4_t bgra;
+
+	bgra.val[3] = vdup_n_u8(0xff);
+	for (; end >= 8; end -= 8) {
+		rgb = vld3_u8(row + (end - 8) * 3);
+		bgra.val[0] = rgb.val[2];
+		bgra.val[1] = rgb.val[1];
+		bgra.val[2] = rgb.val[0];
+		vst4_u8(row + (end - 8) * 4, bgra);
+	}
+#endif
+
+	rgb_to_xrgb_scalar(row, end);
+}
+
+#if defined(__SSE2__)
+
+/* Two pixels in 16 bit lanes.  The alpha lane is multiplied by 255,
+ * which the rounding division turns back into alpha. */
+static inline __m128i
+premultiply_sse2(__m128i px)
+{
+	const __m128i round = _mm_set1_epi16(0x80);
+	const __m128i opaque = _mm_setr_epi16(0, 0, 0, 0xff, 0, 0, 0, 0xff);
+	__m128i alpha, t;
+
+	alpha = _mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3));
+	alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+	alpha = _mm_or_si128(alpha, opaque);
+
+	t = _mm_add_epi16(_mm_mullo_epi16(px, alpha), round);
+	t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+
+	/* RGBA to BGRA, which is a8r8g8b8 in memory */
+	t = _mm_shufflelo_epi16(t, _MM_SHUFFLE(3, 0, 1, 2));
+	return _mm_shufflehi_epi16(t, _MM_SHUFFLE(3, 0, 1, 2));
+}
+
+#endif
+
+void
+image_premultiply_rgba(uint8_t *data, int count)
+{
+	uint8_t *p = data, alpha, red, green, blue;
+	int i = 0;
+
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i v, lo, hi;
+
+	for (; i + 4 <= count; i += 4, p += 16) {
+		v = _mm_loadu_si128((const __m128i *) p);
+		lo = premultiply_sse2(_mm_unpacklo_epi8(v, zero));
+		hi = premultiply_sse2(_mm_unpackhi_epi8(v, zero));
+		_mm_storeu_si128((__m128i *) p, _mm_packus_epi16(lo, hi));
+	}
+#elif defined(IMAGE_CONVERT_NEON)
+	uint8x8x4_t rgba, bgra;
+	uint16x8_t t;
+	int c;
+
+	for (; i + 8 <= count; i += 8, p += 32) {
+		rgba = vld4_u8(p);
+		for (c = 0; c < 3; c++) {
+			t = vmull_u8(rgba.val[c], rgba.val[3]);
+			bgra.val[2 - c] = vraddhn_u16(t, vrshrq_n_u16(t, 8));
+		}
+		bgra.val[3] = rgba.val[3];
+		vst4_u8(p, bgra);
+	}
+#endif
+
+	for (; i < count; i++, p += 4) {
+		alpha = p[3];
+		red = p[0];
+		green = p[1];
+		blue = p[2];
+
+		if (alpha == 0) {
+			red = green = blue = 0;
+		} else if (alpha != 0xff) {
+			red = multiply_alpha(alpha, red);
+			green = multiply_alpha(alpha, green);
+			blue = multiply_alpha(alpha, blue);
+		}
+
+		*(uint32_t *) p = ((uint32_t) alpha << 24) |
+			(red << 16) | (green << 8) | blue;
+	}
+}
@@ -30,10 +30,17 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <png.h>
 #include <pixman.h>
 
 #include "shared/helpers.h"
+#include "image-convert.h"
 #include "image-loader.h"
 
 #ifdef HAVE_JPEG
@@ -58,21 +65,6 @@ pixman_image_destroy_func(pixman_image_t *image, void *data)
 
 #ifdef HAVE_JPEG
 
-static void
-swizzle_row(JSAMPLE *row, JDIMENSION width)
-{
-	JSAMPLE *s;
-	uint32_t *d;
-
-	s = row + (width - 1) * 3;
-	d = (uint32_t *) (row + (width - 1) * 4);
-	while (s >= row) {
-		*d = 0xff000000 | (s[0] << 16) | (s[1] << 8) | (s[2] << 0);
-		s -= 3;
-		d--;
-	}
-}
-
 static void
 error_exit(j_common_ptr cinfo)
 {
@@ -119,7 +111,7 @@ load_jpeg(FILE *fp)
 
 		jpeg_read_scanlines(&cinfo, rows, ARRAY_LENGTH(rows));
 		for (i = 0; first + i < cinfo.output_scanline; i++)
-			swizzle_row(rows[i], cinfo.output_width);
+			image_rgb_to_xrgb(rows[i], cinfo.output_width);
 	}
 
 	jpeg_finish_decompress(&cinfo);
@@ -148,43 +140,12 @@ load_jpeg(FILE *fp)
 
 #endif
 
-static inline int
-multiply_alpha(int alpha, int color)
-{
-    int temp = (alpha * color) + 0x80;
-
-    return ((temp + (temp >> 8)) >> 8);
-}
-
 static void
 premultiply_data(png_structp   png,
 		 png_row_infop row_info,
 		 png_bytep     data)
 {
-    unsigned int i;
-    png_bytep p;
-
-    for (i = 0, p = data; i < row_info->rowbytes; i += 4, p += 4) {
-	png_byte  alpha = p[3];
-	uint32_t w;
-
-	if (alpha == 0) {
-		w = 0;
-	} else {
-		png_byte red   = p[0];
-		png_byte green = p[1];
-		png_byte blue  = p[2];
-
-		if (alpha != 0xff) {
-			red   = multiply_alpha(alpha, red);
-			green = multiply_alpha(alpha, green);
-			blue  = multiply_alpha(alpha, blue);
-		}
-		w = (alpha << 24) | (red << 16) | (green << 8) | (blue << 0);
-	}
-
-	* (uint32_t *) p = w;
-    }
+	image_premultiply_rgba(data, row_info->rowbytes / 4);
 }
 
 static void
@@ -392,13 +353,220 @@ static const struct image_loader loaders[] = {
 	{ { 'R', 'I', 'F', 'F' }, 4, load_webp }
 };
 
+/* Decoded images can be kept in a cache directory, one file per source
+ * image named after a hash of its real path.  The file holds the
+ * header, the path and the premultiplied pixels, and is mapped on a
+ * hit as long as the size and mtime recorded for the source still
+ * match. */
+
+#define IMAGE_CACHE_MAGIC "wimgc\0\0\1"
+#define IMAGE_CACHE_ALIGN 64
+
+struct image_cache_header {
+	char magic[8];
+	uint64_t file_size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride;
+	uint32_t format;
+	uint32_t path_length;
+	uint32_t data_offset;
+};
+
+struct image_cache {
+	char key[PATH_MAX];
+	char path[PATH_MAX];
+	struct stat source;
+};
+
+struct image_mapping {
+	void *addr;
+	size_t length;
+};
+
+static int
+image_cache_init(struct image_cache *cache, const char *filename, int fd)
+{
+	const char *dir = getenv(WESTON_IMAGE_CACHE_DIR_ENV_VAR);
+	uint64_t hash = 0xcbf29ce484222325ull;
+	const char *p;
+
+	if (dir == NULL || dir[0] == '\0')
+		return -1;
+
+	if (fstat(fd, &cache->source) < 0)
+		return -1;
+
+	if (!realpath(filename, cache->key))
+		snprintf(cache->key, sizeof cache->key, "%s", filename);
+
+	for (p = cache->key; *p; p++)
+		hash = (hash ^ (uint8_t) *p) * 0x100000001b3ull;
+
+	if (snprintf(cache->path, sizeof cache->path, "%s/%016llx.image",
+		     dir, (unsigned long long) hash) >= (int) sizeof cache->path)
+		return -1;
+
+	return 0;
+}
+
+static void
+image_mapping_destroy_func(pixman_image_t *image, void *data)
+{
+	struct image_mapping *mapping = data;
+
+	munmap(mapping->addr, mapping->length);
+	free(mapping);
+}
+
+static pixman_image_t *
+image_cache_lookup(struct image_cache *cache)
+{
+	const struct image_cache_header *header;
+	struct image_mapping *mapping;
+	pixman_image_t *image;
+	struct stat st;
+	size_t length = strlen(cache->key);
+	char *map;
+	int fd;
+
+	fd = open(cache->path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof *header) {
+		close(fd);
+		return NULL;
+	}
+
+	/* Private and writable, so users can draw on the image without
+	 * touching the cache file. */
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		   fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	header = (const struct image_cache_header *) map;
+	if (memcmp(header->magic, IMAGE_CACHE_MAGIC, sizeof header->magic) ||
+	    header->file_size != (uint64_t) cache->source.st_size ||
+	    header->mtime_sec != cache->source.st_mtim.tv_sec ||
+	    header->mtime_nsec != cache->source.st_mtim.tv_nsec ||
+	    header->format != PIXMAN_a8r8g8b8 ||
+	    header->stride < header->width * 4 ||
+	    header->path_length != length ||
+	    header->data_offset < sizeof *header + length ||
+	    header->data_offset % IMAGE_CACHE_ALIGN ||
+	    header->data_offset + (uint64_t) header->stride * header->height >
+		    (uint64_t) st.st_size ||
+	    memcmp(map + sizeof *header, cache->key, length) != 0)
+		goto err_unmap;
+
+	mapping = malloc(sizeof *mapping);
+	if (mapping == NULL)
+		goto err_unmap;
+	mapping->addr = map;
+	mapping->length = st.st_size;
+
+	image = pixman_image_create_bits(PIXMAN_a8r8g8b8,
+					 header->width, header->height,
+					 (uint32_t *) (map + header->data_offset),
+					 header->stride);
+	if (image == NULL) {
+		free(mapping);
+		goto err_unmap;
+	}
+
+	pixman_image_set_destroy_function(image, image_mapping_destroy_func,
+					  mapping);
+
+	return image;
+
+err_unmap:
+	munmap(map, st.st_size);
+	return NULL;
+}
+
+static int
+write_all(int fd, const void *data, size_t size)
+{
+	const char *p = data;
+	ssize_t n;
+
+	while (size > 0) {
+		n = write(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		p += n;
+		size -= n;
+	}
+
+	return 0;
+}
+
+/* Writes the image under a temporary name and renames it into place,
+ * so concurrent loaders never map a partial file.  Failures only mean
+ * the next load decodes again. */
+static void
+image_cache_store(struct image_cache *cache, pixman_image_t *image)
+{
+	static const char zero[IMAGE_CACHE_ALIGN];
+	struct image_cache_header header;
+	char tmp[PATH_MAX + 8];
+	const char *data;
+	size_t length = strlen(cache->key), offset;
+	int fd, i, ok;
+
+	if (pixman_image_get_format(image) != PIXMAN_a8r8g8b8)
+		return;
+
+	offset = sizeof header + length;
+	offset = (offset + IMAGE_CACHE_ALIGN - 1) & ~(IMAGE_CACHE_ALIGN - 1);
+
+	memset(&header, 0, sizeof header);
+	memcpy(header.magic, IMAGE_CACHE_MAGIC, sizeof header.magic);
+	header.file_size = cache->source.st_size;
+	header.mtime_sec = cache->source.st_mtim.tv_sec;
+	header.mtime_nsec = cache->source.st_mtim.tv_nsec;
+	header.width = pixman_image_get_width(image);
+	header.height = pixman_image_get_height(image);
+	header.stride = header.width * 4;
+	header.format = PIXMAN_a8r8g8b8;
+	header.path_length = length;
+	header.data_offset = offset;
+
+	snprintf(tmp, sizeof tmp, "%s.XXXXXX", cache->path);
+	fd = mkostemp(tmp, O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	ok = write_all(fd, &header, sizeof header) == 0 &&
+	     write_all(fd, cache->key, length) == 0 &&
+	     write_all(fd, zero, offset - sizeof header - length) == 0;
+
+	data = (const char *) pixman_image_get_data(image);
+	for (i = 0; ok && i < (int) header.height; i++)
+		ok = write_all(fd, data + i * pixman_image_get_stride(image),
+			       header.stride) == 0;
+
+	close(fd);
+	if (!ok || rename(tmp, cache->path) < 0)
+		unlink(tmp);
+}
+
 pixman_image_t *
 load_image(const char *filename)
 {
+	struct image_cache cache;
 	pixman_image_t *image;
 	unsigned char header[4];
 	FILE *fp;
 	unsigned int i;
+	int cached;
 
 	if (!filename || !*filename)
 		return NULL;
@@ -409,6 +577,15 @@ load_image(const char *filename)
 		return NULL;
 	}
 
+	cached = image_cache_init(&cache, filename, fileno(fp)) == 0;
+	if (cached) {
+		image = image_cache_lookup(&cache);
+		if (image) {
+			fclose(fp);
+			return image;
+		}
+	}
+
 	if (fread(header, sizeof header, 1, fp) != 1) {
 		fclose(fp);
 		fprintf(stderr, "%s: unable to read file header\n", filename);
@@ -434,7 +611,76 @@ load_image(const char *filename)
 	} else if (!image) {
 		/* load probably printed something, but just in case */
 		fprintf(stderr, "%s: error reading image\n", filename);
+	} else if (cached) {
+		image_cache_store(&cache, image);
 	}
 
 	return image;
 }
+
+#define IMAGE_LOADER_MAX_THREADS 4
+
+struct image_batch {
+	const char * const *filenames;
+	pixman_image_t **images;
+	int count;
+
+	pthread_mutex_t mutex;
+	int next;
+};
+
+static void *
+image_batch_worker(void *data)
+{
+	struct image_batch *batch = data;
+	int i;
+
+	for (;;) {
+		pthread_mutex_lock(&batch->mutex);
+		i = batch->next++;
+		pthread_mutex_unlock(&batch->mutex);
+
+		if (i >= batch->count)
+			return NULL;
+
+		batch->images[i] = load_image(batch->filenames[i]);
+	}
+}
+
+int
+load_images(const char * const *filenames, pixman_image_t **images,
+	    int count)
+{
+	pthread_t threads[IMAGE_LOADER_MAX_THREADS - 1];
+	struct image_batch batch;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int nthreads, i, loaded = 0;
+
+	batch.filenames = filenames;
+	batch.images = images;
+	batch.count = count;
+	batch.next = 0;
+	pthread_mutex_init(&batch.mutex, NULL);
+
+	/* The calling thread decodes too */
+	nthreads = MIN(count, IMAGE_LOADER_MAX_THREADS);
+	if (cpus > 0)
+		nthreads = MIN(nthreads, cpus);
+	for (i = 0; i < nthreads - 1; i++)
+		if (pthread_create(&threads[i], NULL,
+				   image_batch_worker, &batch) != 0)
+			break;
+	nthreads = i;
+
+	image_batch_worker(&batch);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	pthread_mutex_destroy(&batch.mutex);
+
+	for (i = 0; i < count; i++)
+		if (images[i])
+			loaded++;
+
+	return loaded;
+}
@@ -28,7 +28,16 @@
 
 #include <pixman.h>
 
+/* When set, decoded images are cached in this directory */
+#define WESTON_IMAGE_CACHE_DIR_ENV_VAR "WESTON_IMAGE_CACHE_DIR"
+
 pixman_image_t *
 load_image(const char *filename);
 
+/* Loads count images on up to four threads.  images[i] is NULL where
+ * filenames[i] failed to load; returns the number that loaded. */
+int
+load_images(const char * const *filenames, pixman_image_t **images,
+	    int count);
+
 #endif
@@ -31,6 +31,12 @@
 #include <stdlib.h>
 #include <math.h>
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #ifdef IN_WESTON
 #include <wayland-server.h>
 #else
@@ -46,8 +52,21 @@
  *  1  5  9 13
  *  2  6 10 14
  *  3  7 11 15
+ *
+ * A matrix whose type does not have WESTON_MATRIX_TRANSFORM_OTHER is a
+ * 2D affine transformation, with z only scaled and translated:
+ *  a  c  0 tx
+ *  b  d  0 ty
+ *  0  0  s tz
+ *  0  0  0  1
+ * and one of type 0 is the identity. The fast paths below rely on it.
  */
 
+#define WESTON_MATRIX_TRANSFORM_AFFINE		\
+	(WESTON_MATRIX_TRANSFORM_TRANSLATE |	\
+	 WESTON_MATRIX_TRANSFORM_SCALE |	\
+	 WESTON_MATRIX_TRANSFORM_ROTATE)
+
 WL_EXPORT void
 weston_matrix_init(struct weston_matrix *matrix)
 {
@@ -64,9 +83,37 @@ WL_EXPORT void
 weston_matrix_multiply(struct weston_matrix *m, const struct weston_matrix *n)
 {
 	struct weston_matrix tmp;
+	int i;
+
+	/* column i of the result is n times column i of m */
+#if defined(__SSE__)
+	__m128 c0 = _mm_loadu_ps(&n->d[0]), c1 = _mm_loadu_ps(&n->d[4]);
+	__m128 c2 = _mm_loadu_ps(&n->d[8]), c3 = _mm_loadu_ps(&n->d[12]);
+	__m128 r;
+
+	for (i = 0; i < 16; i += 4) {
+		r = _mm_mul_ps(c0, _mm_set1_ps(m->d[i]));
+		r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(m->d[i + 1])));
+		r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(m->d[i + 2])));
+		r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(m->d[i + 3])));
+		_mm_storeu_ps(&tmp.d[i], r);
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	float32x4_t c0 = vld1q_f32(&n->d[0]), c1 = vld1q_f32(&n->d[4]);
+	float32x4_t c2 = vld1q_f32(&n->d[8]), c3 = vld1q_f32(&n->d[12]);
+	float32x4_t r;
+
+	for (i = 0; i < 16; i += 4) {
+		r = vmulq_n_f32(c0, m->d[i]);
+		r = vmlaq_n_f32(r, c1, m->d[i + 1]);
+		r = vmlaq_n_f32(r, c2, m->d[i + 2]);
+		r = vmlaq_n_f32(r, c3, m->d[i + 3]);
+		vst1q_f32(&tmp.d[i], r);
+	}
+#else
 	const float *row, *column;
 	div_t d;
-	int i, j;
+	int j;
 
 	for (i = 0; i < 16; i++) {
 		tmp.d[i] = 0;
@@ -76,6 +123,7 @@ weston_matrix_multiply(struct weston_matrix *m, const struct weston_matrix *n)
 		for (j = 0; j < 4; j++)
 			tmp.d[i] += row[j] * column[j * 4];
 	}
+#endif
 	tmp.type = m->type | n->type;
 	memcpy(m, &tmp, sizeof tmp);
 }
@@ -113,10 +161,29 @@ weston_matrix_rotate_xy(struct weston_matrix *matrix, float cos, float sin)
 	weston_matrix_multiply(matrix, &translate);
 }
 
-/* v <- m * v */
-WL_EXPORT void
-weston_matrix_transform(struct weston_matrix *matrix, struct weston_vector *v)
+static inline void
+transform_general(const struct weston_matrix *matrix, struct weston_vector *v)
 {
+#if defined(__SSE__)
+	__m128 r;
+
+	r = _mm_mul_ps(_mm_loadu_ps(&matrix->d[0]), _mm_set1_ps(v->f[0]));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&matrix->d[4]),
+				     _mm_set1_ps(v->f[1])));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&matrix->d[8]),
+				     _mm_set1_ps(v->f[2])));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&matrix->d[12]),
+				     _mm_set1_ps(v->f[3])));
+	_mm_storeu_ps(v->f, r);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	float32x4_t r;
+
+	r = vmulq_n_f32(vld1q_f32(&matrix->d[0]), v->f[0]);
+	r = vmlaq_n_f32(r, vld1q_f32(&matrix->d[4]), v->f[1]);
+	r = vmlaq_n_f32(r, vld1q_f32(&matrix->d[8]), v->f[2]);
+	r = vmlaq_n_f32(r, vld1q_f32(&matrix->d[12]), v->f[3]);
+	vst1q_f32(v->f, r);
+#else
 	int i, j;
 	struct weston_vector t;
 
@@ -127,6 +194,84 @@ weston_matrix_transform(struct weston_matrix *matrix, struct weston_vector *v)
 	}
 
 	*v = t;
+#endif
+}
+
+/* v <- m * v */
+WL_EXPORT void
+weston_matrix_transform(struct weston_matrix *matrix, struct weston_vector *v)
+{
+	const float *d = matrix->d;
+	float x = v->f[0], y = v->f[1], z = v->f[2], w = v->f[3];
+
+	switch (matrix->type) {
+	case 0:
+		return;
+	case WESTON_MATRIX_TRANSFORM_TRANSLATE:
+		v->f[0] = x + d[12] * w;
+		v->f[1] = y + d[13] * w;
+		v->f[2] = z + d[14] * w;
+		return;
+	case WESTON_MATRIX_TRANSFORM_TRANSLATE | WESTON_MATRIX_TRANSFORM_SCALE:
+	case WESTON_MATRIX_TRANSFORM_SCALE:
+		v->f[0] = d[0] * x + d[12] * w;
+		v->f[1] = d[5] * y + d[13] * w;
+		v->f[2] = d[10] * z + d[14] * w;
+		return;
+	default:
+		break;
+	}
+
+	if (matrix->type & WESTON_MATRIX_TRANSFORM_OTHER) {
+		transform_general(matrix, v);
+		return;
+	}
+
+	v->f[0] = d[0] * x + d[4] * y + d[12] * w;
+	v->f[1] = d[1] * x + d[5] * y + d[13] * w;
+	v->f[2] = d[10] * z + d[14] * w;
+}
+
+/* (x[i], y[i]) <- m * (x[i], y[i], 0, 1) for n points, divided by w.
+ * Returns -1 if w was too close to 0 for any point, those are set to 0. */
+WL_EXPORT int
+weston_matrix_transform_xy(const struct weston_matrix *matrix,
+			   float *x, float *y, int n)
+{
+	const float *d = matrix->d;
+	struct weston_vector v;
+	int i, ret = 0;
+	float tx;
+
+	if (!(matrix->type & WESTON_MATRIX_TRANSFORM_OTHER)) {
+		for (i = 0; i < n; i++) {
+			tx = d[0] * x[i] + d[4] * y[i] + d[12];
+			y[i] = d[1] * x[i] + d[5] * y[i] + d[13];
+			x[i] = tx;
+		}
+
+		return 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		v.f[0] = x[i];
+		v.f[1] = y[i];
+		v.f[2] = 0.0f;
+		v.f[3] = 1.0f;
+		transform_general(matrix, &v);
+
+		if (fabsf(v.f[3]) < 1e-6) {
+			x[i] = 0;
+			y[i] = 0;
+			ret = -1;
+			continue;
+		}
+
+		x[i] = v.f[0] / v.f[3];
+		y[i] = v.f[1] / v.f[3];
+	}
+
+	return ret;
 }
 
 static inline void
@@ -256,21 +401,77 @@ inverse_transform(const double *LU, const unsigned *p, float *v)
 		v[j] = b[j];
 }
 
+/* The inverse of a matrix without WESTON_MATRIX_TRANSFORM_OTHER, with
+ * the same non-invertible limit as the LU decomposition. */
+static int
+invert_affine(struct weston_matrix *inverse,
+	      const struct weston_matrix *matrix)
+{
+	const float *m = matrix->d;
+	double det, a, b, c, e, s, tx, ty, tz;
+	unsigned int type = matrix->type;
+
+	det = (double)m[0] * m[5] - (double)m[4] * m[1];
+	if (fabs(det) < 1e-9 || fabs(m[10]) < 1e-9)
+		return -1;
+
+	a = m[5] / det;
+	b = -m[1] / det;
+	c = -m[4] / det;
+	e = m[0] / det;
+	s = 1.0 / m[10];
+	tx = m[12];
+	ty = m[13];
+	tz = m[14];
+
+	/* inverse may be matrix */
+	weston_matrix_init(inverse);
+	inverse->d[0] = a;
+	inverse->d[1] = b;
+	inverse->d[4] = c;
+	inverse->d[5] = e;
+	inverse->d[10] = s;
+	inverse->d[12] = -(a * tx + c * ty);
+	inverse->d[13] = -(b * tx + e * ty);
+	inverse->d[14] = -s * tz;
+	inverse->type = type;
+
+	return 0;
+}
+
 WL_EXPORT int
 weston_matrix_invert(struct weston_matrix *inverse,
 		     const struct weston_matrix *matrix)
 {
 	double LU[16];		/* column-major */
 	unsigned perm[4];	/* permutation */
-	unsigned c;
+	unsigned c, type = matrix->type;
+
+	switch (type) {
+	case 0:
+		weston_matrix_init(inverse);
+		return 0;
+	case WESTON_MATRIX_TRANSFORM_TRANSLATE:
+		*inverse = *matrix;
+		inverse->d[12] = -matrix->d[12];
+		inverse->d[13] = -matrix->d[13];
+		inverse->d[14] = -matrix->d[14];
+		return 0;
+	default:
+		break;
+	}
+
+	if (!(type & WESTON_MATRIX_TRANSFORM_OTHER))
+		return invert_affine(inverse, matrix);
 
 	if (matrix_invert(LU, perm, matrix) < 0)
 		return -1;
 
+	/* inverse may be matrix */
 	weston_matrix_init(inverse);
 	for (c = 0; c < 4; ++c)
 		inverse_transform(LU, perm, &inverse->d[c * 4]);
-	inverse->type = matrix->type;
+	inverse->type = type;
 
 	return 0;
 }
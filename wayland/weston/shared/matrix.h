@@ -38,6 +38,9 @@ enum weston_matrix_transform_type {
 	WESTON_MATRIX_TRANSFORM_OTHER		= (1 << 3),
 };
 
+/* The type says which of the transformations the matrix was built from.
+ * Code filling in d directly has to set it, to OTHER if nothing else
+ * fits: the multiply, transform and invert fast paths trust it. */
 struct weston_matrix {
 	float d[16];
 	unsigned int type;
@@ -60,6 +63,9 @@ void
 weston_matrix_rotate_xy(struct weston_matrix *matrix, float cos, float sin);
 void
 weston_matrix_transform(struct weston_matrix *matrix, struct weston_vector *v);
+int
+weston_matrix_transform_xy(const struct weston_matrix *matrix,
+			   float *x, float *y, int n);
 
 int
 weston_matrix_invert(struct weston_matrix *inverse,
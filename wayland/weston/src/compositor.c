@@ -52,6 +52,7 @@
 #include <errno.h>
 
 #include "timeline.h"
+#include "frame-stats.h"
 
 #include "compositor.h"
 #include "scaler-server-protocol.h"
@@ -1007,6 +1008,7 @@ weston_view_move_to_plane(struct weston_view *view,
 
 	weston_view_damage_below(view);
 	view->plane = plane;
+	view->surface->compositor->clip_generation++;
 	weston_surface_damage(view->surface);
 }
 
@@ -1125,6 +1127,10 @@ weston_surface_assign_output(struct weston_surface *es)
 	}
 	pixman_region32_fini(&region);
 
+	/* sub-surfaces are only in the view list while mapped */
+	if (!es->output != !new_output)
+		es->compositor->scene_generation++;
+
 	es->output = new_output;
 	weston_surface_update_output_mask(es, mask);
 }
@@ -1346,6 +1352,7 @@ weston_view_update_transform(struct weston_view *view)
 	struct weston_view *parent = view->geometry.parent;
 	struct weston_layer *layer;
 	pixman_region32_t mask;
+	pixman_region32_t old_opaque;
 
 	if (!view->transform.dirty)
 		return;
@@ -1358,6 +1365,8 @@ weston_view_update_transform(struct weston_view *view)
 	weston_view_damage_below(view);
 
 	pixman_region32_fini(&view->transform.boundingbox);
+	pixman_region32_init(&old_opaque);
+	pixman_region32_copy(&old_opaque, &view->transform.opaque);
 	pixman_region32_fini(&view->transform.opaque);
 	pixman_region32_init(&view->transform.opaque);
 
@@ -1383,6 +1392,10 @@ weston_view_update_transform(struct weston_view *view)
 		pixman_region32_fini(&mask);
 	}
 
+	if (!pixman_region32_equal(&old_opaque, &view->transform.opaque))
+		view->transform.opaque_dirty = 1;
+	pixman_region32_fini(&old_opaque);
+
 	if (parent) {
 		if (parent->geometry.scissor_enabled) {
 			view->geometry.scissor_enabled = true;
@@ -1864,6 +1877,7 @@ weston_view_unmap(struct weston_view *view)
 	if (!weston_view_is_mapped(view))
 		return;
 
+	view->surface->compositor->scene_generation++;
 	weston_view_damage_below(view);
 	view->output = NULL;
 	view->plane = NULL;
@@ -1899,6 +1913,7 @@ weston_surface_unmap(struct weston_surface *surface)
 	wl_list_for_each(view, &surface->views, surface_link)
 		weston_view_unmap(view);
 	surface->output = NULL;
+	surface->compositor->scene_generation++;
 }
 
 static void
@@ -1918,6 +1933,9 @@ weston_view_destroy(struct weston_view *view)
 
 	assert(wl_list_empty(&view->geometry.child_list));
 
+	/* the address may be reused by a new view in the same place */
+	view->surface->compositor->scene_generation++;
+
 	if (weston_view_is_mapped(view)) {
 		weston_view_unmap(view);
 		weston_compositor_build_view_list(view->surface->compositor);
@@ -2111,12 +2129,18 @@ surface_flush_damage(struct weston_surface *surface)
 	pixman_region32_clear(&surface->damage);
 }
 
+/* Adds the surface damage of the view, except where it is hidden by the
+ * opaque region above it, to the damage of its plane.
+ */
 static void
-view_accumulate_damage(struct weston_view *view,
-		       pixman_region32_t *opaque)
+view_add_plane_damage(struct weston_view *view,
+		      pixman_region32_t *above)
 {
 	pixman_region32_t damage;
 
+	if (!pixman_region32_not_empty(&view->surface->damage))
+		return;
+
 	pixman_region32_init(&damage);
 	if (view->transform.enabled) {
 		pixman_box32_t *extents;
@@ -2131,12 +2155,20 @@ view_accumulate_damage(struct weston_view *view,
 
 	pixman_region32_intersect(&damage, &damage,
 				  &view->transform.boundingbox);
-	pixman_region32_subtract(&damage, &damage, opaque);
+	pixman_region32_subtract(&damage, &damage, above);
 	pixman_region32_union(&view->plane->damage,
 			      &view->plane->damage, &damage);
 	pixman_region32_fini(&damage);
+}
+
+static void
+view_accumulate_damage(struct weston_view *view,
+		       pixman_region32_t *opaque)
+{
+	view_add_plane_damage(view, opaque);
 	pixman_region32_copy(&view->clip, opaque);
 	pixman_region32_union(opaque, opaque, &view->transform.opaque);
+	view->transform.opaque_dirty = 0;
 }
 
 static void
@@ -2145,27 +2177,56 @@ compositor_accumulate_damage(struct weston_compositor *ec)
 	struct weston_plane *plane;
 	struct weston_view *ev;
 	pixman_region32_t opaque, clip;
+	bool reuse, reuse_views;
+
+	/* The clip of a view only depends on the opaque regions of the
+	 * views above it on its plane, and the clip of a plane on the
+	 * planes above it. As long as the view list and the planes are
+	 * unchanged, the clips of the last repaint are kept down to the
+	 * first view whose opaque region changed.
+	 */
+	reuse = ec->clip_valid_generation == ec->clip_generation;
 
 	pixman_region32_init(&clip);
 
 	wl_list_for_each(plane, &ec->plane_list, link) {
-		pixman_region32_copy(&plane->clip, &clip);
+		if (reuse)
+			pixman_region32_copy(&clip, &plane->clip);
+		else
+			pixman_region32_copy(&plane->clip, &clip);
 
 		pixman_region32_init(&opaque);
+		reuse_views = reuse;
 
 		wl_list_for_each(ev, &ec->view_list, link) {
 			if (ev->plane != plane)
 				continue;
 
+			if (reuse_views && !ev->transform.opaque_dirty) {
+				view_add_plane_damage(ev, &ev->clip);
+				continue;
+			}
+
+			if (reuse_views) {
+				pixman_region32_copy(&opaque, &ev->clip);
+				reuse_views = false;
+			}
+
 			view_accumulate_damage(ev, &opaque);
 		}
 
-		pixman_region32_union(&clip, &clip, &opaque);
+		if (!reuse_views) {
+			pixman_region32_union(&clip, &clip, &opaque);
+			reuse = false;
+		}
+
 		pixman_region32_fini(&opaque);
 	}
 
 	pixman_region32_fini(&clip);
 
+	ec->clip_valid_generation = ec->clip_generation;
+
 	wl_list_for_each(ev, &ec->view_list, link)
 		ev->surface->touched = false;
 
@@ -2294,23 +2355,83 @@ view_list_add(struct weston_compositor *compositor,
 static void
 weston_compositor_build_view_list(struct weston_compositor *compositor)
 {
-	struct weston_view *view;
+	struct weston_view *view, **recorded;
 	struct weston_layer *layer;
+	bool recorded_all = true;
 
 	wl_list_for_each(layer, &compositor->layer_list, link)
 		wl_list_for_each(view, &layer->view_list.link, layer_link.link)
 			surface_stash_subsurface_views(view->surface);
 
 	wl_list_init(&compositor->view_list);
+	compositor->view_list_layer_views.size = 0;
 	wl_list_for_each(layer, &compositor->layer_list, link) {
 		wl_list_for_each(view, &layer->view_list.link, layer_link.link) {
 			view_list_add(compositor, view);
+
+			recorded = wl_array_add(&compositor->view_list_layer_views,
+						sizeof *recorded);
+			if (recorded)
+				*recorded = view;
+			else
+				recorded_all = false;
 		}
 	}
 
 	wl_list_for_each(layer, &compositor->layer_list, link)
 		wl_list_for_each(view, &layer->view_list.link, layer_link.link)
 			surface_free_unused_subsurface_views(view->surface);
+
+	compositor->clip_generation++;
+	compositor->view_list_generation = compositor->scene_generation;
+	if (!recorded_all)
+		compositor->view_list_generation--;
+}
+
+/* Layers and their views are often restacked by shells with plain
+ * wl_list operations, which do not bump scene_generation, so the views
+ * of the layers are also compared with the ones the list was built from.
+ * The recorded pointers are only compared, never dereferenced.
+ */
+static bool
+weston_compositor_view_list_is_current(struct weston_compositor *compositor)
+{
+	struct weston_view **recorded = compositor->view_list_layer_views.data;
+	size_t count = compositor->view_list_layer_views.size /
+		       sizeof *recorded;
+	struct weston_view *view;
+	struct weston_layer *layer;
+	size_t i = 0;
+
+	if (compositor->view_list_generation != compositor->scene_generation)
+		return false;
+
+	wl_list_for_each(layer, &compositor->layer_list, link) {
+		wl_list_for_each(view, &layer->view_list.link, layer_link.link) {
+			if (i == count || recorded[i] != view)
+				return false;
+			i++;
+		}
+	}
+
+	return i == count;
+}
+
+/* Brings the view list and the view transforms up to date, rebuilding
+ * the list only if the scene graph changed since it was last built.
+ */
+static void
+weston_compositor_update_view_list(struct weston_compositor *compositor)
+{
+	struct weston_view *view;
+
+	if (!weston_compositor_view_list_is_current(compositor)) {
+		weston_compositor_build_view_list(compositor);
+		return;
+	}
+
+	wl_list_for_each(view, &compositor->view_list, link)
+		weston_view_update_transform(view);
 }
 
 static void
@@ -2347,15 +2468,18 @@ weston_output_repaint(struct weston_output *output)
 	struct weston_frame_callback *cb, *cnext;
 	struct wl_list frame_callback_list;
 	pixman_region32_t output_damage;
+	struct timespec now;
 	int r;
 
 	if (output->destroying)
 		return 0;
 
 	TL_POINT("core_repaint_begin", TLP_OUTPUT(output), TLP_END);
+	weston_compositor_read_presentation_clock(ec, &now);
+	weston_frame_stats_repaint_begin(output->frame_stats, &now);
 
-	/* Rebuild the surface list and update surface transforms up front. */
-	weston_compositor_build_view_list(ec);
+	/* Update the surface list and surface transforms up front. */
+	weston_compositor_update_view_list(ec);
 
 	if (output->assign_planes && !output->disable_planes) {
 		output->assign_planes(output);
@@ -2392,6 +2516,10 @@ weston_output_repaint(struct weston_output *output)
 		weston_output_update_matrix(output);
 
 	r = output->repaint(output, &output_damage);
+	if (r == 0) {
+		weston_compositor_read_presentation_clock(ec, &now);
+		weston_frame_stats_repaint_submitted(output->frame_stats, &now);
+	}
 
 	pixman_region32_fini(&output_damage);
 
@@ -2418,6 +2546,7 @@ static void
 weston_output_schedule_repaint_reset(struct weston_output *output)
 {
 	output->repaint_scheduled = 0;
+	weston_frame_stats_loop_idle(output->frame_stats);
 	TL_POINT("core_repaint_exit_loop", TLP_OUTPUT(output), TLP_END);
 }
 
@@ -2452,6 +2581,9 @@ weston_output_finish_frame(struct weston_output *output,
 	TL_POINT("core_repaint_finished", TLP_OUTPUT(output),
 		 TLP_VBLANK(stamp), TLP_END);
 
+	if (presented_flags != WP_PRESENTATION_FEEDBACK_INVALID)
+		weston_frame_stats_presented(output->frame_stats, stamp);
+
 	refresh_nsec = millihz_to_nsec(output->current_mode->refresh);
 	weston_presentation_feedback_present_list(&output->feedback_list,
 						  output, refresh_nsec, stamp,
@@ -2714,12 +2846,26 @@ static void
 weston_surface_commit_subsurface_order(struct weston_surface *surface)
 {
 	struct weston_subsurface *sub;
+	struct wl_list *link = surface->subsurface_list.next;
+
+	/* most commits do not restack, keep the view list then */
+	wl_list_for_each(sub, &surface->subsurface_list_pending,
+			 parent_link_pending) {
+		if (link != &sub->parent_link)
+			break;
+		link = link->next;
+	}
+	if (&sub->parent_link_pending == &surface->subsurface_list_pending &&
+	    link == &surface->subsurface_list)
+		return;
 
 	wl_list_for_each_reverse(sub, &surface->subsurface_list_pending,
 				 parent_link_pending) {
 		wl_list_remove(&sub->parent_link);
 		wl_list_insert(&surface->subsurface_list, &sub->parent_link);
 	}
+
+	surface->compositor->scene_generation++;
 }
 
 static void
@@ -3293,6 +3439,7 @@ subsurface_configure(struct weston_surface *surface, int32_t dx, int32_t dy)
 
 		surface->output = output;
 		weston_surface_update_output_mask(surface, 1u << output->id);
+		compositor->scene_generation++;
 	}
 }
 
@@ -3579,6 +3726,8 @@ subsurface_set_desync(struct wl_client *client, struct wl_resource *resource)
 static void
 weston_subsurface_unlink_parent(struct weston_subsurface *sub)
 {
+	sub->parent->compositor->scene_generation++;
+
 	wl_list_remove(&sub->parent_link);
 	wl_list_remove(&sub->parent_link_pending);
 	wl_list_remove(&sub->parent_destroy_listener.link);
@@ -3645,6 +3794,8 @@ weston_subsurface_link_parent(struct weston_subsurface *sub,
 	wl_list_insert(&parent->subsurface_list, &sub->parent_link);
 	wl_list_insert(&parent->subsurface_list_pending,
 		       &sub->parent_link_pending);
+
+	parent->compositor->scene_generation++;
 }
 
 static void
@@ -3689,6 +3840,7 @@ weston_subsurface_destroy(struct weston_subsurface *sub)
 		assert(sub->parent_destroy_listener.notify == NULL);
 		wl_list_remove(&sub->parent_link);
 		wl_list_remove(&sub->parent_link_pending);
+		sub->surface->compositor->scene_generation++;
 	}
 
 	wl_list_remove(&sub->surface_destroy_listener.link);
@@ -3753,6 +3905,7 @@ weston_subsurface_create_for_parent(struct weston_surface *parent)
 	wl_list_insert(&parent->subsurface_list, &sub->parent_link);
 	wl_list_insert(&parent->subsurface_list_pending,
 		       &sub->parent_link_pending);
+	parent->compositor->scene_generation++;
 
 	return sub;
 }
@@ -4002,6 +4155,7 @@ weston_plane_release(struct weston_plane *plane)
 	}
 
 	wl_list_remove(&plane->link);
+	plane->compositor->clip_generation++;
 }
 
 WL_EXPORT void
@@ -4013,6 +4167,8 @@ weston_compositor_stack_plane(struct weston_compositor *ec,
 		wl_list_insert(above->link.prev, &plane->link);
 	else
 		wl_list_insert(&ec->plane_list, &plane->link);
+
+	ec->clip_generation++;
 }
 
 static void unbind_resource(struct wl_resource *resource)
@@ -4108,6 +4264,7 @@ weston_output_destroy(struct weston_output *output)
 	wl_signal_emit(&output->destroy_signal, output);
 
 	free(output->name);
+	weston_frame_stats_destroy(output->frame_stats);
 	pixman_region32_fini(&output->region);
 	pixman_region32_fini(&output->previous_damage);
 	output->compositor->output_id_pool &= ~(1u << output->id);
@@ -4295,6 +4452,8 @@ weston_output_init(struct weston_output *output, struct weston_compositor *c,
 	wl_list_init(&output->feedback_list);
 	wl_list_init(&output->link);
 
+	output->frame_stats = weston_frame_stats_create();
+
 	loop = wl_display_get_event_loop(c->wl_display);
 	output->repaint_timer = wl_event_loop_add_timer(loop,
 					output_repaint_timer_handler, output);
@@ -4727,6 +4886,7 @@ weston_compositor_create(struct wl_display *display, void *user_data)
 		goto fail;
 
 	wl_list_init(&ec->view_list);
+	wl_array_init(&ec->view_list_layer_views);
 	wl_list_init(&ec->plane_list);
 	wl_list_init(&ec->layer_list);
 	wl_list_init(&ec->seat_list);
@@ -4983,6 +5143,7 @@ weston_compositor_destroy(struct weston_compositor *compositor)
 
 	if (compositor->backend)
 		compositor->backend->destroy(compositor);
+	wl_array_release(&compositor->view_list_layer_views);
 	free(compositor);
 }
 
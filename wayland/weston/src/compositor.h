@@ -58,6 +58,7 @@ struct weston_output;
 struct input_method;
 struct weston_pointer;
 struct linux_dmabuf_buffer;
+struct weston_frame_stats;
 
 enum weston_keyboard_modifier {
 	MODIFIER_CTRL = (1 << 0),
@@ -237,6 +238,7 @@ struct weston_output {
 			  uint16_t *b);
 
 	struct weston_timeline_object timeline;
+	struct weston_frame_stats *frame_stats;
 };
 
 enum weston_pointer_motion_mask {
@@ -756,6 +758,16 @@ struct weston_compositor {
 	struct wl_list layer_list;
 	struct wl_list view_list;	/* struct weston_view::link */
 	struct wl_list plane_list;
+
+	/* Lets weston_output_repaint() skip rebuilding view_list and
+	 * recomputing the view and plane clip regions when the scene graph
+	 * has not changed since the last repaint.
+	 */
+	uint32_t scene_generation;	/* bumped on structural changes */
+	uint32_t view_list_generation;	/* scene_generation of view_list */
+	struct wl_array view_list_layer_views; /* layer views, top first */
+	uint32_t clip_generation;	/* bumped when clips become stale */
+	uint32_t clip_valid_generation;
 	struct wl_list key_binding_list;
 	struct wl_list modifier_binding_list;
 	struct wl_list button_binding_list;
@@ -928,6 +940,9 @@ struct weston_view {
 	 */
 	struct {
 		int dirty;
+		/* opaque changed since the last repaint, the clip of
+		 * the views below must be recomputed */
+		int opaque_dirty;
 
 		/* Approximations in global coordinates:
 		 * - boundingbox is guaranteed to include the whole view in
@@ -1587,6 +1602,9 @@ tty_activate_vt(struct tty *tty, int vt);
 void
 screenshooter_create(struct weston_compositor *ec);
 
+int
+weston_compositor_enable_frame_timing(struct weston_compositor *compositor);
+
 enum weston_screenshooter_outcome {
 	WESTON_SCREENSHOOTER_SUCCESS,
 	WESTON_SCREENSHOOTER_NO_MEMORY,
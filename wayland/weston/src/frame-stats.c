@@ -0,0 +1,255 @@
+/*
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "compositor.h"
+#include "frame-stats.h"
+#include "weston-frame-timing-server-protocol.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+
+struct weston_frame_stats *
+weston_frame_stats_create(void)
+{
+	struct weston_frame_stats *stats;
+
+	stats = zalloc(sizeof *stats);
+	if (!stats)
+		return NULL;
+
+	weston_frame_stats_reset(stats);
+
+	return stats;
+}
+
+void
+weston_frame_stats_destroy(struct weston_frame_stats *stats)
+{
+	free(stats);
+}
+
+void
+weston_frame_stats_reset(struct weston_frame_stats *stats)
+{
+	int i;
+
+	for (i = 0; i < WESTON_FRAME_STAGE_COUNT; i++) {
+		memset(&stats->stage[i], 0, sizeof stats->stage[i]);
+		stats->stage[i].min_nsec = UINT64_MAX;
+	}
+}
+
+static void
+histogram_add(struct weston_frame_histogram *h,
+	      const struct timespec *from, const struct timespec *to)
+{
+	struct timespec d;
+	int64_t nsec;
+	uint64_t bucket;
+
+	timespec_sub(&d, to, from);
+	nsec = timespec_to_nsec(&d);
+	if (nsec < 0)
+		return;
+
+	bucket = nsec / WESTON_FRAME_STATS_BUCKET_NSEC;
+	if (bucket >= WESTON_FRAME_STATS_BUCKETS)
+		bucket = WESTON_FRAME_STATS_BUCKETS - 1;
+
+	h->buckets[bucket]++;
+	h->samples++;
+	h->sum_nsec += nsec;
+	if ((uint64_t)nsec < h->min_nsec)
+		h->min_nsec = nsec;
+	if ((uint64_t)nsec > h->max_nsec)
+		h->max_nsec = nsec;
+}
+
+void
+weston_frame_stats_repaint_begin(struct weston_frame_stats *stats,
+				 const struct timespec *now)
+{
+	if (!stats)
+		return;
+
+	stats->repaint_begin = *now;
+}
+
+void
+weston_frame_stats_repaint_submitted(struct weston_frame_stats *stats,
+				     const struct timespec *now)
+{
+	if (!stats)
+		return;
+
+	histogram_add(&stats->stage[WESTON_FRAME_STAGE_REPAINT],
+		      &stats->repaint_begin, now);
+	stats->submitted = *now;
+	stats->submit_pending = true;
+}
+
+void
+weston_frame_stats_presented(struct weston_frame_stats *stats,
+			     const struct timespec *stamp)
+{
+	if (!stats)
+		return;
+
+	if (stats->submit_pending)
+		histogram_add(&stats->stage[WESTON_FRAME_STAGE_LATENCY],
+			      &stats->submitted, stamp);
+
+	if (stats->has_presented)
+		histogram_add(&stats->stage[WESTON_FRAME_STAGE_INTERVAL],
+			      &stats->presented, stamp);
+
+	stats->presented = *stamp;
+	stats->submit_pending = false;
+	stats->has_presented = true;
+}
+
+void
+weston_frame_stats_loop_idle(struct weston_frame_stats *stats)
+{
+	if (!stats)
+		return;
+
+	stats->submit_pending = false;
+	stats->has_presented = false;
+}
+
+static void
+frame_timing_destroy(struct wl_client *client, struct wl_resource *resource)
+{
+	wl_resource_destroy(resource);
+}
+
+static uint32_t
+nsec_to_usec(uint64_t nsec)
+{
+	uint64_t usec = nsec / 1000;
+
+	return usec > UINT32_MAX ? UINT32_MAX : usec;
+}
+
+static void
+send_histogram(struct wl_resource *resource, uint32_t stage,
+	       const struct weston_frame_histogram *h)
+{
+	struct wl_array buckets;
+	uint32_t min = 0, max = 0, mean = 0;
+
+	wl_array_init(&buckets);
+	if (!wl_array_add(&buckets, sizeof h->buckets)) {
+		wl_resource_post_no_memory(resource);
+		return;
+	}
+	memcpy(buckets.data, h->buckets, sizeof h->buckets);
+
+	if (h->samples) {
+		min = nsec_to_usec(h->min_nsec);
+		max = nsec_to_usec(h->max_nsec);
+		mean = nsec_to_usec(h->sum_nsec / h->samples);
+	}
+
+	weston_frame_timing_send_histogram(resource, stage, h->samples,
+					   min, max, mean,
+					   WESTON_FRAME_STATS_BUCKET_NSEC / 1000,
+					   &buckets);
+	wl_array_release(&buckets);
+}
+
+static void
+frame_timing_get_histograms(struct wl_client *client,
+			    struct wl_resource *resource,
+			    struct wl_resource *output_resource)
+{
+	struct weston_output *output =
+		wl_resource_get_user_data(output_resource);
+	struct weston_frame_stats *stats = output->frame_stats;
+	uint32_t i;
+
+	if (stats) {
+		for (i = 0; i < WESTON_FRAME_STAGE_COUNT; i++)
+			send_histogram(resource, i, &stats->stage[i]);
+	}
+
+	weston_frame_timing_send_done(resource);
+}
+
+static void
+frame_timing_reset(struct wl_client *client,
+		   struct wl_resource *resource,
+		   struct wl_resource *output_resource)
+{
+	struct weston_output *output =
+		wl_resource_get_user_data(output_resource);
+
+	if (output->frame_stats)
+		weston_frame_stats_reset(output->frame_stats);
+}
+
+static const struct weston_frame_timing_interface frame_timing_implementation = {
+	frame_timing_destroy,
+	frame_timing_get_histograms,
+	frame_timing_reset,
+};
+
+static void
+bind_frame_timing(struct wl_client *client,
+		  void *data, uint32_t version, uint32_t id)
+{
+	struct wl_resource *resource;
+
+	resource = wl_resource_create(client, &weston_frame_timing_interface,
+				      1, id);
+	if (resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+
+	wl_resource_set_implementation(resource, &frame_timing_implementation,
+				       data, NULL);
+}
+
+/** Advertise the weston_frame_timing debugging global
+ *
+ * \param compositor The compositor instance.
+ * \return 0 on success, -1 on failure.
+ */
+WL_EXPORT int
+weston_compositor_enable_frame_timing(struct weston_compositor *compositor)
+{
+	if (!wl_global_create(compositor->wl_display,
+			      &weston_frame_timing_interface, 1,
+			      compositor, bind_frame_timing))
+		return -1;
+
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_FRAME_STATS_H
+#define WESTON_FRAME_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Per-output histograms of the frame timing, always collected since the
+ * cost is a couple of clock reads per frame:
+ *   REPAINT   from the start of the repaint to its submission
+ *   LATENCY   from the submission to the presentation
+ *   INTERVAL  between two presentations of a running repaint loop
+ */
+
+enum weston_frame_stage {
+	WESTON_FRAME_STAGE_REPAINT = 0,
+	WESTON_FRAME_STAGE_LATENCY,
+	WESTON_FRAME_STAGE_INTERVAL,
+	WESTON_FRAME_STAGE_COUNT
+};
+
+#define WESTON_FRAME_STATS_BUCKETS		128
+#define WESTON_FRAME_STATS_BUCKET_NSEC		250000
+
+/* the last bucket also holds everything longer */
+struct weston_frame_histogram {
+	uint32_t buckets[WESTON_FRAME_STATS_BUCKETS];
+	uint32_t samples;
+	uint64_t sum_nsec;
+	uint64_t min_nsec;
+	uint64_t max_nsec;
+};
+
+struct weston_frame_stats {
+	struct weston_frame_histogram stage[WESTON_FRAME_STAGE_COUNT];
+
+	struct timespec repaint_begin;
+	struct timespec submitted;
+	struct timespec presented;
+	bool submit_pending;
+	bool has_presented;
+};
+
+/* The recording functions below accept NULL, for an output whose
+ * statistics could not be allocated. */
+struct weston_frame_stats *
+weston_frame_stats_create(void);
+
+void
+weston_frame_stats_destroy(struct weston_frame_stats *stats);
+
+void
+weston_frame_stats_reset(struct weston_frame_stats *stats);
+
+void
+weston_frame_stats_repaint_begin(struct weston_frame_stats *stats,
+				 const struct timespec *now);
+
+void
+weston_frame_stats_repaint_submitted(struct weston_frame_stats *stats,
+				     const struct timespec *now);
+
+void
+weston_frame_stats_presented(struct weston_frame_stats *stats,
+			     const struct timespec *stamp);
+
+/* The repaint loop stopped, the next presentation starts a new interval. */
+void
+weston_frame_stats_loop_idle(struct weston_frame_stats *stats);
+
+#endif /* WESTON_FRAME_STATS_H */
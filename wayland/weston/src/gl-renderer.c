@@ -205,6 +205,8 @@ struct gl_renderer {
 
 	struct wl_array vertices;
 	struct wl_array vtxcnt;
+	struct wl_array clip_quads;
+	struct clip_arena clip_arena;
 
 	EGLOutputLayerEXT *overlays;
 	struct gl_renderer_overlay_data *overlay_data;
@@ -439,79 +441,45 @@ gl_renderer_print_egl_error_state(void)
 		egl_error_string(code), (long)code);
 }
 
-#define max(a, b) (((a) > (b)) ? (a) : (b))
-#define min(a, b) (((a) > (b)) ? (b) : (a))
-
 /*
- * Compute the boundary vertices of the intersection of the global coordinate
- * aligned rectangle 'rect', and an arbitrary quadrilateral produced from
- * 'surf_rect' when transformed from surface coordinates into global coordinates.
- * The vertices are written to 'ex' and 'ey', and the return value is the
- * number of vertices. Vertices are produced in clockwise winding order.
- * Guarantees to produce either zero vertices, or 3-8 vertices with non-zero
- * polygon area.
+ * Transform the surface coordinate aligned rectangles 'surf_rects' into
+ * global coordinates. Each becomes an arbitrary quadrilateral, whose
+ * intersection with a global coordinate aligned rectangle is then found
+ * by clip_quads(): either nothing or 3-8 vertices with non-zero polygon
+ * area, in clockwise winding order.
  */
-static int
-calculate_edges(struct weston_view *ev, pixman_box32_t *rect,
-		pixman_box32_t *surf_rect, GLfloat *ex, GLfloat *ey)
+static struct clip_quad *
+transform_surface_rects(struct weston_view *ev, struct wl_array *array,
+			pixman_box32_t *surf_rects, int nsurf)
 {
+	struct clip_quad *quads, *q;
+	int i, k;
 
-	struct clip_context ctx;
-	int i, n;
-	GLfloat min_x, max_x, min_y, max_y;
-	struct polygon8 surf = {
-		{ surf_rect->x1, surf_rect->x2, surf_rect->x2, surf_rect->x1 },
-		{ surf_rect->y1, surf_rect->y1, surf_rect->y2, surf_rect->y2 },
-		4
-	};
-
-	ctx.clip.x1 = rect->x1;
-	ctx.clip.y1 = rect->y1;
-	ctx.clip.x2 = rect->x2;
-	ctx.clip.y2 = rect->y2;
-
-	/* transform surface to screen space: */
-	for (i = 0; i < surf.n; i++)
-		weston_view_to_global_float(ev, surf.x[i], surf.y[i],
-					    &surf.x[i], &surf.y[i]);
-
-	/* find bounding box: */
-	min_x = max_x = surf.x[0];
-	min_y = max_y = surf.y[0];
+	array->size = 0;
+	quads = wl_array_add(array, nsurf * sizeof *quads);
+	if (!quads)
+		return NULL;
 
-	for (i = 1; i < surf.n; i++) {
-		min_x = min(min_x, surf.x[i]);
-		max_x = max(max_x, surf.x[i]);
-		min_y = min(min_y, surf.y[i]);
-		max_y = max(max_y, surf.y[i]);
+	for (i = 0; i < nsurf; i++) {
+		q = &quads[i];
+		q->x[0] = q->x[3] = surf_rects[i].x1;
+		q->x[1] = q->x[2] = surf_rects[i].x2;
+		q->y[0] = q->y[1] = surf_rects[i].y1;
+		q->y[2] = q->y[3] = surf_rects[i].y2;
+
+		if (!ev->transform.enabled) {
+			for (k = 0; k < 4; k++) {
+				q->x[k] += ev->geometry.x;
+				q->y[k] += ev->geometry.y;
+			}
+		} else if (weston_matrix_transform_xy(&ev->transform.matrix,
+						      q->x, q->y, 4) < 0) {
+			weston_log("warning: numerical instability in %s(), "
+				   "divisor close to 0\n", __func__);
+		}
 	}
 
-	/* First, simple bounding box check to discard early transformed
-	 * surface rects that do not intersect with the clip region:
-	 */
-	if ((min_x >= ctx.clip.x2) || (max_x <= ctx.clip.x1) ||
-	    (min_y >= ctx.clip.y2) || (max_y <= ctx.clip.y1))
-		return 0;
-
-	/* Simple case, bounding box edges are parallel to surface edges,
-	 * there will be only four edges.  We just need to clip the surface
-	 * vertices to the clip rect bounds:
-	 */
-	if (!ev->transform.enabled)
-		return clip_simple(&ctx, &surf, ex, ey);
-
-	/* Transformed case: use a general polygon clipping algorithm to
-	 * clip the surface rectangle with each side of 'rect'.
-	 * The algorithm is Sutherland-Hodgman, as explained in
-	 * http://www.codeguru.com/cpp/misc/misc/graphics/article.php/c8965/Polygon-Clipping.htm
-	 * but without looking at any of that code.
-	 */
-	n = clip_transformed(&ctx, &surf, ex, ey);
-
-	if (n < 3)
-		return 0;
-
-	return n;
+	return quads;
 }
 
 static bool
@@ -574,7 +542,10 @@ texture_region(struct weston_view *ev, pixman_region32_t *region,
 	unsigned int *vtxcnt, nvtx = 0;
 	pixman_box32_t *rects, *surf_rects;
 	pixman_box32_t *raw_rects;
-	int i, j, k, nrects, nsurf, raw_nrects;
+	struct clip_arena *arena = &gr->clip_arena;
+	struct clip_context ctx;
+	struct clip_quad *quads;
+	int i, j, k, nrects, nsurf, raw_nrects, first;
 	bool used_band_compression;
 	raw_rects = pixman_region32_rectangles(region, &raw_nrects);
 	surf_rects = pixman_region32_rectangles(surf_region, &nsurf);
@@ -596,34 +567,46 @@ texture_region(struct weston_view *ev, pixman_region32_t *region,
 	inv_width = 1.0 / gs->pitch;
         inv_height = 1.0 / gs->height;
 
+	quads = transform_surface_rects(ev, &gr->clip_quads,
+					surf_rects, nsurf);
+	if (!quads)
+		nrects = 0;
+
 	for (i = 0; i < nrects; i++) {
-		pixman_box32_t *rect = &rects[i];
-		for (j = 0; j < nsurf; j++) {
-			pixman_box32_t *surf_rect = &surf_rects[j];
-			GLfloat sx, sy, bx, by;
-			GLfloat ex[8], ey[8];          /* edge points in screen space */
-			int n;
-
-			/* The transformed surface, after clipping to the clip region,
-			 * can have as many as eight sides, emitted as a triangle-fan.
-			 * The first vertex in the triangle fan can be chosen arbitrarily,
-			 * since the area is guaranteed to be convex.
-			 *
-			 * If a corner of the transformed surface falls outside of the
-			 * clip region, instead of emitting one vertex for the corner
-			 * of the surface, up to two are emitted for two corresponding
-			 * intersection point(s) between the surface and the clip region.
-			 *
-			 * To do this, we first calculate the (up to eight) points that
-			 * form the intersection of the clip rect and the transformed
-			 * surface.
-			 */
-			n = calculate_edges(ev, rect, surf_rect, ex, ey);
-			if (n < 3)
-				continue;
+		GLfloat sx, sy, bx, by;
+		GLfloat *ex, *ey;	/* edge points in screen space */
+
+		ctx.clip.x1 = rects[i].x1;
+		ctx.clip.y1 = rects[i].y1;
+		ctx.clip.x2 = rects[i].x2;
+		ctx.clip.y2 = rects[i].y2;
+
+		/* The transformed surface, after clipping to the clip region,
+		 * can have as many as eight sides, emitted as a triangle-fan.
+		 * The first vertex in the triangle fan can be chosen arbitrarily,
+		 * since the area is guaranteed to be convex.
+		 *
+		 * If a corner of the transformed surface falls outside of the
+		 * clip region, instead of emitting one vertex for the corner
+		 * of the surface, up to two are emitted for two corresponding
+		 * intersection point(s) between the surface and the clip region.
+		 *
+		 * To do this, we first calculate the (up to eight) points that
+		 * form the intersection of the clip rect and each transformed
+		 * surface rect, all the surface rects at once.
+		 */
+		clip_arena_reset(arena);
+		if (clip_quads(&ctx, quads, nsurf, ev->transform.enabled,
+			       arena) < 0)
+			break;
+
+		first = 0;
+		for (j = 0; j < arena->npolygons; j++) {
+			ex = arena->x + first;
+			ey = arena->y + first;
 
 			/* emit edge points: */
-			for (k = 0; k < n; k++) {
+			for (k = 0; k < arena->n[j]; k++) {
 				weston_view_from_global_float(ev, ex[k], ey[k],
 							      &sx, &sy);
 				/* position: */
@@ -641,7 +624,8 @@ texture_region(struct weston_view *ev, pixman_region32_t *region,
 				}
 			}
 
-			vtxcnt[nvtx++] = n;
+			vtxcnt[nvtx++] = arena->n[j];
+			first += arena->n[j];
 		}
 	}
 
@@ -3436,6 +3420,8 @@ gl_renderer_destroy(struct weston_compositor *ec)
 
 	wl_array_release(&gr->vertices);
 	wl_array_release(&gr->vtxcnt);
+	wl_array_release(&gr->clip_quads);
+	clip_arena_release(&gr->clip_arena);
 
 	if (gr->fragment_binding)
 		weston_binding_destroy(gr->fragment_binding);
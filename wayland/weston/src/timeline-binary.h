@@ -0,0 +1,97 @@
+/*
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_TIMELINE_BINARY_H
+#define WESTON_TIMELINE_BINARY_H
+
+#include <stdint.h>
+
+/*
+ * Layout of the binary timeline log, in host byte order.
+ *
+ * The file starts with a weston_timeline_file_header, followed by chunks.
+ * Each chunk is a weston_timeline_chunk header and the records one thread
+ * emitted since the previous chunk of that thread. Records start with a
+ * weston_timeline_record header, are padded to 8 bytes, and never span
+ * chunks. Names and objects are described by a record of their own before
+ * the first point record that refers to them; ids are unique within a
+ * file.
+ */
+
+#define WESTON_TIMELINE_MAGIC		0x4e4c5457	/* "WTLN" */
+#define WESTON_TIMELINE_VERSION		1
+
+struct weston_timeline_file_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t clock_id;
+	uint32_t reserved;
+};
+
+enum weston_timeline_chunk_type {
+	WESTON_TIMELINE_CHUNK_RECORDS = 1,
+};
+
+struct weston_timeline_chunk {
+	uint32_t type;		/* enum weston_timeline_chunk_type */
+	uint32_t size;		/* bytes of records after this header */
+	uint32_t thread;	/* index of the emitting thread */
+	uint32_t dropped;	/* points lost before these records */
+};
+
+enum weston_timeline_record_type {
+	WESTON_TIMELINE_RECORD_PAD = 0,	/* to be skipped */
+	WESTON_TIMELINE_RECORD_NAME,	/* id, NUL-terminated name */
+	WESTON_TIMELINE_RECORD_OUTPUT,	/* id, NUL-terminated output name */
+	WESTON_TIMELINE_RECORD_SURFACE,	/* id, main surface id,
+					 * NUL-terminated description */
+	WESTON_TIMELINE_RECORD_POINT,	/* id of the name, point data */
+};
+
+struct weston_timeline_record {
+	uint16_t type;		/* enum weston_timeline_record_type */
+	uint16_t size;		/* bytes including this header */
+	uint32_t id;
+};
+
+#define WESTON_TIMELINE_NO_VBLANK	UINT64_MAX
+
+struct weston_timeline_point_record {
+	struct weston_timeline_record base;
+	uint64_t time;		/* nanoseconds */
+	uint32_t output;	/* 0 if none */
+	uint32_t surface;	/* 0 if none */
+	uint64_t vblank;	/* nanoseconds, or WESTON_TIMELINE_NO_VBLANK */
+	uint8_t args[8];	/* enum timeline_type of the arguments in the
+				 * order given, up to the first TLT_END */
+};
+
+struct weston_timeline_surface_record {
+	struct weston_timeline_record base;
+	uint32_t main_surface;	/* 0 if this is a main surface */
+	char desc[];		/* empty if there is no description */
+};
+
+#endif /* WESTON_TIMELINE_BINARY_H */
@@ -0,0 +1,463 @@
+/*
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Converts a binary timeline log written by weston into the JSON lines
+ * weston used to write directly, or into the Chrome trace event format
+ * for chrome://tracing and compatible viewers.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "timeline.h"
+#include "timeline-binary.h"
+#include "shared/config-parser.h"
+#include "shared/helpers.h"
+
+struct converter {
+	FILE *out;
+	bool chrome;
+	bool first_event;
+
+	/* descriptions by id, NULL if unknown */
+	char **strings;
+	uint32_t string_count;
+
+	uint64_t dropped;
+};
+
+static const char *
+lookup(struct converter *conv, uint32_t id)
+{
+	if (id >= conv->string_count)
+		return NULL;
+
+	return conv->strings[id];
+}
+
+static int
+remember(struct converter *conv, uint32_t id, const char *str)
+{
+	char **strings;
+	uint32_t count;
+
+	if (id >= conv->string_count) {
+		count = conv->string_count ? conv->string_count : 64;
+		while (count <= id)
+			count *= 2;
+
+		strings = realloc(conv->strings, count * sizeof *strings);
+		if (!strings)
+			return -1;
+
+		memset(strings + conv->string_count, 0,
+		       (count - conv->string_count) * sizeof *strings);
+		conv->strings = strings;
+		conv->string_count = count;
+	}
+
+	free(conv->strings[id]);
+	conv->strings[id] = strdup(str);
+
+	return conv->strings[id] ? 0 : -1;
+}
+
+/* the string after a record header, or NULL if not terminated */
+static const char *
+record_string(const struct weston_timeline_record *rec, size_t offset)
+{
+	const char *str = (const char *)rec + offset;
+
+	if (offset >= rec->size || !memchr(str, '\0', rec->size - offset))
+		return NULL;
+
+	return str;
+}
+
+static void
+print_json_string(FILE *fp, const char *str)
+{
+	if (!str || !str[0]) {
+		fprintf(fp, "null");
+		return;
+	}
+
+	fprintf(fp, "\"%s\"", str);
+}
+
+static void
+print_escaped(FILE *fp, const char *str)
+{
+	const char *p;
+
+	fputc('"', fp);
+	for (p = str; *p; p++) {
+		if (*p == '"' || *p == '\\')
+			fprintf(fp, "\\%c", *p);
+		else if ((unsigned char)*p < 0x20)
+			fprintf(fp, "\\u%04x", *p);
+		else
+			fputc(*p, fp);
+	}
+	fputc('"', fp);
+}
+
+static void
+print_time(FILE *fp, uint64_t nsec)
+{
+	fprintf(fp, "[%" PRId64 ", %ld]",
+		(int64_t)(nsec / 1000000000), (long)(nsec % 1000000000));
+}
+
+static void
+json_output(struct converter *conv, const struct weston_timeline_record *rec,
+	    const char *name)
+{
+	fprintf(conv->out, "{ \"id\":%u, \"type\":\"weston_output\", \"name\":",
+		rec->id);
+	print_json_string(conv->out, name);
+	fprintf(conv->out, " }\n");
+}
+
+static void
+json_surface(struct converter *conv,
+	     const struct weston_timeline_surface_record *rec,
+	     const char *desc)
+{
+	fprintf(conv->out, "{ \"id\":%u, \"type\":\"weston_surface\", \"desc\":",
+		rec->base.id);
+	print_json_string(conv->out, desc);
+	if (rec->main_surface)
+		fprintf(conv->out, ", \"main_surface\":%u", rec->main_surface);
+	fprintf(conv->out, " }\n");
+}
+
+static void
+json_point(struct converter *conv,
+	   const struct weston_timeline_point_record *pt, const char *name)
+{
+	unsigned i;
+
+	fprintf(conv->out, "{ \"T\":");
+	print_time(conv->out, pt->time);
+	fprintf(conv->out, ", \"N\":\"%s\"", name);
+
+	for (i = 0; i < ARRAY_LENGTH(pt->args) && pt->args[i] != TLT_END; i++) {
+		switch (pt->args[i]) {
+		case TLT_OUTPUT:
+			fprintf(conv->out, ", \"wo\":%u", pt->output);
+			break;
+		case TLT_SURFACE:
+			fprintf(conv->out, ", \"ws\":%u", pt->surface);
+			break;
+		case TLT_VBLANK:
+			fprintf(conv->out, ", \"vblank\":");
+			print_time(conv->out, pt->vblank);
+			break;
+		}
+	}
+
+	fprintf(conv->out, " }\n");
+}
+
+static void
+chrome_point(struct converter *conv,
+	     const struct weston_timeline_point_record *pt, const char *name)
+{
+	const char *phase = "i";
+	const char *label;
+
+	/* a repaint is a slice on the track of its output */
+	if (strcmp(name, "core_repaint_begin") == 0)
+		phase = "B";
+	else if (strcmp(name, "core_repaint_posted") == 0)
+		phase = "E";
+
+	fprintf(conv->out, "%s\n{ \"name\":",
+		conv->first_event ? "" : ",");
+	conv->first_event = false;
+
+	print_escaped(conv->out, phase[0] == 'i' ? name : "repaint");
+	fprintf(conv->out, ", \"ph\":\"%s\", \"ts\":%" PRIu64 ".%03u, "
+		"\"pid\":1, \"tid\":%u",
+		phase, pt->time / 1000, (unsigned)(pt->time % 1000),
+		pt->output);
+	if (phase[0] == 'i')
+		fprintf(conv->out, ", \"s\":\"t\"");
+
+	fprintf(conv->out, ", \"args\":{ ");
+	if (pt->surface) {
+		fprintf(conv->out, "\"ws\":%u", pt->surface);
+		label = lookup(conv, pt->surface);
+		if (label && label[0]) {
+			fprintf(conv->out, ", \"desc\":");
+			print_escaped(conv->out, label);
+		}
+		if (pt->vblank != WESTON_TIMELINE_NO_VBLANK)
+			fprintf(conv->out, ", ");
+	}
+	if (pt->vblank != WESTON_TIMELINE_NO_VBLANK)
+		fprintf(conv->out, "\"vblank_us\":%" PRIu64 ".%03u",
+			pt->vblank / 1000, (unsigned)(pt->vblank % 1000));
+	fprintf(conv->out, " } }");
+}
+
+static void
+chrome_output(struct converter *conv, uint32_t id, const char *name)
+{
+	fprintf(conv->out, "%s\n{ \"name\":\"thread_name\", \"ph\":\"M\", "
+		"\"pid\":1, \"tid\":%u, \"args\":{ \"name\":",
+		conv->first_event ? "" : ",", id);
+	conv->first_event = false;
+	print_escaped(conv->out, name && name[0] ? name : "output");
+	fprintf(conv->out, " } }");
+}
+
+static int
+convert_record(struct converter *conv,
+	       const struct weston_timeline_record *rec)
+{
+	const struct weston_timeline_surface_record *srec;
+	const struct weston_timeline_point_record *pt;
+	const char *str;
+
+	switch (rec->type) {
+	case WESTON_TIMELINE_RECORD_PAD:
+		return 0;
+	case WESTON_TIMELINE_RECORD_NAME:
+		str = record_string(rec, sizeof *rec);
+		if (!str)
+			return -1;
+		return remember(conv, rec->id, str);
+	case WESTON_TIMELINE_RECORD_OUTPUT:
+		str = record_string(rec, sizeof *rec);
+		if (!str)
+			return -1;
+		if (conv->chrome)
+			chrome_output(conv, rec->id, str);
+		else
+			json_output(conv, rec, str);
+		return remember(conv, rec->id, str);
+	case WESTON_TIMELINE_RECORD_SURFACE:
+		srec = (const struct weston_timeline_surface_record *)rec;
+		str = record_string(rec, sizeof *srec);
+		if (!str)
+			return -1;
+		if (!conv->chrome)
+			json_surface(conv, srec, str);
+		return remember(conv, rec->id, str);
+	case WESTON_TIMELINE_RECORD_POINT:
+		pt = (const struct weston_timeline_point_record *)rec;
+		if (rec->size < sizeof *pt)
+			return -1;
+		str = lookup(conv, rec->id);
+		if (!str) {
+			fprintf(stderr, "point refers to unknown name %u\n",
+				rec->id);
+			return -1;
+		}
+		if (conv->chrome)
+			chrome_point(conv, pt, str);
+		else
+			json_point(conv, pt, str);
+		return 0;
+	default:
+		/* from a newer writer, skip */
+		return 0;
+	}
+}
+
+static int
+convert_chunk(struct converter *conv, const uint8_t *data, uint32_t size)
+{
+	const struct weston_timeline_record *rec;
+	uint32_t pos = 0;
+
+	while (pos < size) {
+		if (size - pos < sizeof *rec)
+			return -1;
+
+		rec = (const struct weston_timeline_record *)(data + pos);
+		if (rec->size < sizeof *rec || rec->size > size - pos ||
+		    rec->size % 8)
+			return -1;
+
+		if (convert_record(conv, rec) < 0)
+			return -1;
+
+		pos += rec->size;
+	}
+
+	return 0;
+}
+
+static int
+convert(struct converter *conv, FILE *in)
+{
+	struct weston_timeline_file_header header;
+	struct weston_timeline_chunk chunk;
+	uint64_t *data = NULL;
+	uint32_t capacity = 0;
+	uint64_t *tmp;
+	int ret = -1;
+
+	if (fread(&header, sizeof header, 1, in) != 1 ||
+	    header.magic != WESTON_TIMELINE_MAGIC) {
+		fprintf(stderr, "not a weston timeline log\n");
+		return -1;
+	}
+
+	if (header.version != WESTON_TIMELINE_VERSION) {
+		fprintf(stderr, "unsupported timeline log version %u\n",
+			header.version);
+		return -1;
+	}
+
+	if (conv->chrome)
+		fprintf(conv->out, "{ \"displayTimeUnit\":\"ms\", "
+			"\"traceEvents\":[");
+
+	while (fread(&chunk, sizeof chunk, 1, in) == 1) {
+		if (chunk.size > capacity) {
+			tmp = realloc(data, chunk.size);
+			if (!tmp) {
+				fprintf(stderr, "out of memory\n");
+				goto out;
+			}
+			data = tmp;
+			capacity = chunk.size;
+		}
+
+		if (fread(data, 1, chunk.size, in) != chunk.size) {
+			fprintf(stderr, "truncated chunk, ignored\n");
+			break;
+		}
+
+		if (chunk.dropped)
+			fprintf(stderr, "warning: thread %u dropped %u "
+				"points before offset %ld\n", chunk.thread,
+				chunk.dropped, ftell(in) - (long)chunk.size);
+		conv->dropped += chunk.dropped;
+
+		if (chunk.type != WESTON_TIMELINE_CHUNK_RECORDS)
+			continue;
+
+		if (convert_chunk(conv, (const uint8_t *)data,
+				  chunk.size) < 0) {
+			fprintf(stderr, "malformed chunk at offset %ld\n",
+				ftell(in) - (long)chunk.size);
+			goto out;
+		}
+	}
+
+	ret = 0;
+
+out:
+	if (conv->chrome)
+		fprintf(conv->out, "\n] }\n");
+
+	free(data);
+
+	return ret;
+}
+
+static void
+usage(int exit_code)
+{
+	fprintf(stderr,
+		"Usage: weston-timeline-convert [OPTIONS] FILE.wtl\n\n"
+		"Converts a weston timeline log, by default into the JSON\n"
+		"lines older weston versions wrote.\n\n"
+		"  --chrome\t\tWrite the Chrome trace event format instead\n"
+		"  -o, --output=FILE\tWrite to FILE rather than stdout\n"
+		"  -h, --help\t\tThis help message\n");
+
+	exit(exit_code);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct converter conv;
+	FILE *in;
+	char *output = NULL;
+	int32_t chrome = 0;
+	int32_t help = 0;
+	uint32_t i;
+	int ret;
+
+	const struct weston_option options[] = {
+		{ WESTON_OPTION_BOOLEAN, "chrome", 0, &chrome },
+		{ WESTON_OPTION_STRING, "output", 'o', &output },
+		{ WESTON_OPTION_BOOLEAN, "help", 'h', &help },
+	};
+
+	parse_options(options, ARRAY_LENGTH(options), &argc, argv);
+	if (help || argc != 2 || argv[1][0] == '-')
+		usage(help ? EXIT_SUCCESS : EXIT_FAILURE);
+
+	memset(&conv, 0, sizeof conv);
+	conv.chrome = chrome;
+	conv.first_event = true;
+
+	in = fopen(argv[1], "rb");
+	if (!in) {
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	conv.out = output ? fopen(output, "w") : stdout;
+	if (!conv.out) {
+		perror(output);
+		fclose(in);
+		return EXIT_FAILURE;
+	}
+
+	ret = convert(&conv, in);
+
+	if (conv.dropped)
+		fprintf(stderr, "warning: %" PRIu64 " points were dropped "
+			"while recording\n", conv.dropped);
+
+	fclose(in);
+	if (conv.out != stdout && fclose(conv.out) != 0) {
+		perror(output);
+		ret = -1;
+	}
+
+	for (i = 0; i < conv.string_count; i++)
+		free(conv.strings[i]);
+	free(conv.strings);
+	free(output);
+
+	return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -27,30 +27,280 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
 #include <errno.h>
 #include <string.h>
 #include <time.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "timeline.h"
+#include "timeline-binary.h"
 #include "compositor.h"
 #include "file-util.h"
+#include "shared/helpers.h"
+
+/*
+ * Timeline points are encoded into a ring buffer of the emitting thread,
+ * without locks or system calls besides reading the clock. A flusher
+ * thread moves the contents of the rings into the log file, in chunks.
+ * When a ring is full, points are dropped and the loss is recorded.
+ * weston-timeline-convert turns the log into JSON or a Chrome trace.
+ *
+ * Outputs and surfaces must only be passed from the compositor thread.
+ */
+
+#define RING_SIZE		(256 * 1024)	/* power of two */
+#define FLUSH_INTERVAL_MS	20
+#define MAX_RING_NAMES		64
+#define MAX_STRING		511
+#define MAX_STAGED_OBJECTS	4
+
+struct timeline_ring {
+	struct wl_list link;		/* timeline_log::rings */
+	uint8_t *data;
+	uint32_t head;			/* advanced by the emitting thread */
+	uint32_t tail;			/* advanced by the flusher */
+	uint32_t dropped;
+	uint32_t thread;
+	int dead;			/* the thread has exited */
+
+	/* names already described in this series, emitting thread only */
+	unsigned series;
+	struct {
+		const char *name;
+		uint32_t id;
+	} names[MAX_RING_NAMES];
+	unsigned name_count;
+};
 
 struct timeline_log {
-	clock_t clk_id;
+	clockid_t clk_id;
 	FILE *file;
 	unsigned series;
 	struct wl_listener compositor_destroy_listener;
+
+	pthread_mutex_t mutex;		/* protects the fields below */
+	pthread_cond_t cond;
+	struct wl_list rings;
+	uint32_t thread_count;
+	bool stop;
+	pthread_t flusher;
 };
 
 WL_EXPORT int weston_timeline_enabled_;
-static struct timeline_log timeline_ = { CLOCK_MONOTONIC, NULL, 0 };
+static struct timeline_log timeline_ = {
+	.clk_id = CLOCK_MONOTONIC,
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.rings = { &timeline_.rings, &timeline_.rings },
+};
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static void
+ring_release(void *data)
+{
+	struct timeline_ring *ring = data;
+
+	/* freed by the flusher once drained */
+	__atomic_store_n(&ring->dead, 1, __ATOMIC_RELEASE);
+}
+
+static void
+ring_key_create(void)
+{
+	pthread_key_create(&ring_key, ring_release);
+}
+
+static struct timeline_ring *
+timeline_get_ring(void)
+{
+	struct timeline_ring *ring;
+
+	pthread_once(&ring_key_once, ring_key_create);
+
+	ring = pthread_getspecific(ring_key);
+	if (ring)
+		return ring;
+
+	ring = zalloc(sizeof *ring);
+	if (!ring)
+		return NULL;
+
+	ring->data = malloc(RING_SIZE);
+	if (!ring->data || pthread_setspecific(ring_key, ring) != 0) {
+		free(ring->data);
+		free(ring);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&timeline_.mutex);
+	ring->thread = timeline_.thread_count++;
+	wl_list_insert(timeline_.rings.prev, &ring->link);
+	pthread_mutex_unlock(&timeline_.mutex);
+
+	return ring;
+}
+
+/* Appends a block of records, or counts a dropped point. */
+static bool
+ring_write(struct timeline_ring *ring, const void *data, uint32_t size)
+{
+	struct weston_timeline_record *wrap;
+	uint32_t head = ring->head;
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	uint32_t offset = head & (RING_SIZE - 1);
+	uint32_t used = head - tail;
+	uint32_t skip = 0;
+
+	/* blocks are contiguous, a zero-sized pad record marks a skip
+	 * to the start of the ring */
+	if (offset + size > RING_SIZE)
+		skip = RING_SIZE - offset;
+
+	if (used + skip + size > RING_SIZE) {
+		__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+		return false;
+	}
+
+	if (skip) {
+		wrap = (struct weston_timeline_record *)(ring->data + offset);
+		wrap->type = WESTON_TIMELINE_RECORD_PAD;
+		wrap->size = 0;
+		wrap->id = 0;
+		offset = 0;
+	}
+
+	memcpy(ring->data + offset, data, size);
+	__atomic_store_n(&ring->head, head + skip + size, __ATOMIC_RELEASE);
+
+	/* wake the flusher early rather than drop points */
+	if (used < RING_SIZE / 2 && used + skip + size >= RING_SIZE / 2)
+		pthread_cond_signal(&timeline_.cond);
+
+	return true;
+}
+
+/* Writes what the ring holds as one chunk. Called with the mutex held. */
+static int
+ring_flush(struct timeline_ring *ring, FILE *fp)
+{
+	const struct weston_timeline_record *rec;
+	struct weston_timeline_chunk chunk;
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	uint32_t start[2], length[2];
+	uint32_t pos, offset;
+	int segments = 0;
+	int i;
+
+	chunk.type = WESTON_TIMELINE_CHUNK_RECORDS;
+	chunk.size = 0;
+	chunk.thread = ring->thread;
+	chunk.dropped = __atomic_exchange_n(&ring->dropped, 0,
+					    __ATOMIC_RELAXED);
+
+	/* the records are in at most two pieces, split by one skip */
+	for (pos = ring->tail; pos != head; pos += rec->size) {
+		offset = pos & (RING_SIZE - 1);
+		rec = (const struct weston_timeline_record *)
+			(ring->data + offset);
+
+		if (rec->type == WESTON_TIMELINE_RECORD_PAD && rec->size == 0) {
+			pos += RING_SIZE - offset;
+			if (pos == head)
+				break;
+			offset = 0;
+			rec = (const struct weston_timeline_record *)ring->data;
+		}
+
+		if (segments == 0 ||
+		    start[segments - 1] + length[segments - 1] != offset) {
+			assert(segments < 2);
+			start[segments] = offset;
+			length[segments] = 0;
+			segments++;
+		}
+		length[segments - 1] += rec->size;
+		chunk.size += rec->size;
+	}
+
+	if (chunk.size == 0 && chunk.dropped == 0)
+		return 0;
+
+	if (fwrite(&chunk, sizeof chunk, 1, fp) != 1)
+		return -1;
+
+	for (i = 0; i < segments; i++) {
+		if (fwrite(ring->data + start[i], length[i], 1, fp) != 1)
+			return -1;
+	}
+
+	__atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/* Called with the mutex held. */
+static void
+timeline_flush_all(FILE *fp)
+{
+	struct timeline_ring *ring, *tmp;
+	int dead;
+
+	wl_list_for_each_safe(ring, tmp, &timeline_.rings, link) {
+		dead = __atomic_load_n(&ring->dead, __ATOMIC_ACQUIRE);
+
+		if (ring_flush(ring, fp) < 0) {
+			weston_log("Timeline error writing the log: %s\n",
+				   strerror(errno));
+			break;
+		}
+
+		if (dead) {
+			wl_list_remove(&ring->link);
+			free(ring->data);
+			free(ring);
+		}
+	}
+
+	fflush(fp);
+}
+
+static void *
+timeline_flusher(void *data)
+{
+	FILE *fp = data;
+	struct timespec deadline;
+
+	pthread_mutex_lock(&timeline_.mutex);
+	while (1) {
+		timeline_flush_all(fp);
+		if (timeline_.stop)
+			break;
+
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += FLUSH_INTERVAL_MS * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&timeline_.cond, &timeline_.mutex,
+				       &deadline);
+	}
+	pthread_mutex_unlock(&timeline_.mutex);
+
+	return NULL;
+}
 
 static int
 weston_timeline_do_open(void)
 {
 	const char *prefix = "weston-timeline-";
-	const char *suffix = ".log";
+	const char *suffix = ".wtl";
+	struct weston_timeline_file_header header;
+	struct timeline_ring *ring;
 	char fname[1000];
 
 	timeline_.file = file_create_dated(prefix, suffix,
@@ -71,6 +321,29 @@ weston_timeline_do_open(void)
 		return -1;
 	}
 
+	/* anything left over belongs to the previous log */
+	pthread_mutex_lock(&timeline_.mutex);
+	wl_list_for_each(ring, &timeline_.rings, link) {
+		ring->tail = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		__atomic_store_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&timeline_.mutex);
+
+	memset(&header, 0, sizeof header);
+	header.magic = WESTON_TIMELINE_MAGIC;
+	header.version = WESTON_TIMELINE_VERSION;
+	header.clock_id = timeline_.clk_id;
+
+	timeline_.stop = false;
+	if (fwrite(&header, sizeof header, 1, timeline_.file) != 1 ||
+	    pthread_create(&timeline_.flusher, NULL, timeline_flusher,
+			   timeline_.file) != 0) {
+		weston_log("Cannot start the timeline log '%s'\n", fname);
+		fclose(timeline_.file);
+		timeline_.file = NULL;
+		return -1;
+	}
+
 	weston_log("Opened timeline file '%s'\n", fname);
 
 	return 0;
@@ -82,7 +355,7 @@ timeline_notify_destroy(struct wl_listener *listener, void *data)
 	weston_timeline_close();
 }
 
-void
+WL_EXPORT void
 weston_timeline_open(struct weston_compositor *compositor)
 {
 	if (weston_timeline_enabled_)
@@ -101,7 +374,7 @@ weston_timeline_open(struct weston_compositor *compositor)
 	weston_timeline_enabled_ = 1;
 }
 
-void
+WL_EXPORT void
 weston_timeline_close(void)
 {
 	if (!weston_timeline_enabled_)
@@ -111,55 +384,146 @@ weston_timeline_close(void)
 
 	wl_list_remove(&timeline_.compositor_destroy_listener.link);
 
+	/* the flusher writes out everything left before it stops */
+	pthread_mutex_lock(&timeline_.mutex);
+	timeline_.stop = true;
+	pthread_cond_signal(&timeline_.cond);
+	pthread_mutex_unlock(&timeline_.mutex);
+	pthread_join(timeline_.flusher, NULL);
+
 	fclose(timeline_.file);
 	timeline_.file = NULL;
 	weston_log("Timeline log file closed.\n");
 }
 
+/* The records of one point, put together before going into the ring. */
 struct timeline_emit_context {
-	FILE *cur;
-	FILE *out;
+	struct timeline_ring *ring;
 	unsigned series;
+
+	uint64_t buf[512];
+	uint32_t len;
+	bool overflow;
+
+	struct weston_timeline_object *objects[MAX_STAGED_OBJECTS];
+	int object_count;
+	const char *name;		/* to remember once committed */
+	uint32_t name_id;
+
+	uint32_t output;
+	uint32_t surface;
+	uint64_t vblank;
+	uint8_t args[8];
+	unsigned arg_count;
 };
 
-static unsigned
+static uint32_t
 timeline_new_id(void)
 {
-	static unsigned idc;
+	static uint32_t idc;
+	uint32_t id;
+
+	do
+		id = __atomic_add_fetch(&idc, 1, __ATOMIC_RELAXED);
+	while (id == 0);
+
+	return id;
+}
+
+static struct weston_timeline_record *
+stage_record(struct timeline_emit_context *ctx, uint16_t type, uint32_t id,
+	     size_t size)
+{
+	struct weston_timeline_record *rec;
+
+	size = (size + 7) & ~(size_t)7;
+	if (ctx->len + size > sizeof(ctx->buf)) {
+		ctx->overflow = true;
+		return NULL;
+	}
+
+	rec = (struct weston_timeline_record *)((uint8_t *)ctx->buf +
+						 ctx->len);
+	memset(rec, 0, size);
+	rec->type = type;
+	rec->size = size;
+	rec->id = id;
+	ctx->len += size;
+
+	return rec;
+}
 
-	if (++idc == 0)
-		++idc;
+static void
+stage_string_record(struct timeline_emit_context *ctx, uint16_t type,
+		    uint32_t id, const char *str)
+{
+	struct weston_timeline_record *rec;
+	size_t len = str ? strnlen(str, MAX_STRING) : 0;
 
-	return idc;
+	rec = stage_record(ctx, type, id, sizeof *rec + len + 1);
+	if (rec && len)
+		memcpy(rec + 1, str, len);
 }
 
+/*
+ * Whether the object is to be described in this point. The object is
+ * only marked as described once the point made it into the ring.
+ */
 static int
 check_series(struct timeline_emit_context *ctx,
 	     struct weston_timeline_object *to)
 {
-	if (to->series == 0 || to->series != ctx->series) {
-		to->series = ctx->series;
+	if (to->series == 0 || to->series != ctx->series)
 		to->id = timeline_new_id();
-		return 1;
+	else if (!to->force_refresh)
+		return 0;
+
+	if (ctx->object_count == MAX_STAGED_OBJECTS) {
+		ctx->overflow = true;
+		return 0;
 	}
+	ctx->objects[ctx->object_count++] = to;
+
+	return 1;
+}
 
-	if (to->force_refresh) {
-		to->force_refresh = 0;
-		return 1;
+static uint32_t
+stage_name(struct timeline_emit_context *ctx, const char *name)
+{
+	struct timeline_ring *ring = ctx->ring;
+	unsigned i;
+
+	/* names are string literals, so the pointer is the key */
+	for (i = 0; i < ring->name_count; i++) {
+		if (ring->names[i].name == name)
+			return ring->names[i].id;
 	}
 
-	return 0;
+	ctx->name = name;
+	ctx->name_id = timeline_new_id();
+	stage_string_record(ctx, WESTON_TIMELINE_RECORD_NAME,
+			    ctx->name_id, name);
+
+	return ctx->name_id;
 }
 
 static void
-fprint_quoted_string(FILE *fp, const char *str)
+commit_staged(struct timeline_emit_context *ctx)
 {
-	if (!str) {
-		fprintf(fp, "null");
-		return;
+	struct timeline_ring *ring = ctx->ring;
+	int i;
+
+	for (i = 0; i < ctx->object_count; i++) {
+		ctx->objects[i]->series = ctx->series;
+		ctx->objects[i]->force_refresh = 0;
 	}
 
-	fprintf(fp, "\"%s\"", str);
+	/* with the table full, the name is just described again */
+	if (ctx->name && ring->name_count < MAX_RING_NAMES) {
+		ring->names[ring->name_count].name = ctx->name;
+		ring->names[ring->name_count].id = ctx->name_id;
+		ring->name_count++;
+	}
 }
 
 static int
@@ -167,15 +531,11 @@ emit_weston_output(struct timeline_emit_context *ctx, void *obj)
 {
 	struct weston_output *o = obj;
 
-	if (check_series(ctx, &o->timeline)) {
-		fprintf(ctx->out, "{ \"id\":%u, "
-			"\"type\":\"weston_output\", \"name\":",
-			o->timeline.id);
-		fprint_quoted_string(ctx->out, o->name);
-		fprintf(ctx->out, " }\n");
-	}
+	if (check_series(ctx, &o->timeline))
+		stage_string_record(ctx, WESTON_TIMELINE_RECORD_OUTPUT,
+				    o->timeline.id, o->name);
 
-	fprintf(ctx->cur, "\"wo\":%u", o->timeline.id);
+	ctx->output = o->timeline.id;
 
 	return 1;
 }
@@ -184,9 +544,11 @@ static void
 check_weston_surface_description(struct timeline_emit_context *ctx,
 				 struct weston_surface *s)
 {
+	struct weston_timeline_surface_record *rec;
 	struct weston_surface *mains;
-	char d[512];
-	char mainstr[32];
+	uint32_t main_id = 0;
+	char d[MAX_STRING + 1];
+	size_t len;
 
 	if (!check_series(ctx, &s->timeline))
 		return;
@@ -194,20 +556,21 @@ check_weston_surface_description(struct timeline_emit_context *ctx,
 	mains = weston_surface_get_main_surface(s);
 	if (mains != s) {
 		check_weston_surface_description(ctx, mains);
-		if (snprintf(mainstr, sizeof(mainstr),
-			     ", \"main_surface\":%u", mains->timeline.id) < 0)
-			mainstr[0] = '\0';
-	} else {
-		mainstr[0] = '\0';
+		main_id = mains->timeline.id;
 	}
 
 	if (!s->get_label || s->get_label(s, d, sizeof(d)) < 0)
 		d[0] = '\0';
+	len = strnlen(d, MAX_STRING);
+
+	rec = (struct weston_timeline_surface_record *)
+		stage_record(ctx, WESTON_TIMELINE_RECORD_SURFACE,
+			     s->timeline.id, sizeof *rec + len + 1);
+	if (!rec)
+		return;
 
-	fprintf(ctx->out, "{ \"id\":%u, "
-		"\"type\":\"weston_surface\", \"desc\":", s->timeline.id);
-	fprint_quoted_string(ctx->out, d[0] ? d : NULL);
-	fprintf(ctx->out, "%s }\n", mainstr);
+	rec->main_surface = main_id;
+	memcpy(rec->desc, d, len);
 }
 
 static int
@@ -216,7 +579,7 @@ emit_weston_surface(struct timeline_emit_context *ctx, void *obj)
 	struct weston_surface *s = obj;
 
 	check_weston_surface_description(ctx, s);
-	fprintf(ctx->cur, "\"ws\":%u", s->timeline.id);
+	ctx->surface = s->timeline.id;
 
 	return 1;
 }
@@ -226,8 +589,7 @@ emit_vblank_timestamp(struct timeline_emit_context *ctx, void *obj)
 {
 	struct timespec *ts = obj;
 
-	fprintf(ctx->cur, "\"vblank\":[%" PRId64 ", %ld]",
-		(int64_t)ts->tv_sec, ts->tv_nsec);
+	ctx->vblank = (uint64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
 
 	return 1;
 }
@@ -247,23 +609,32 @@ weston_timeline_point(const char *name, ...)
 	struct timespec ts;
 	enum timeline_type otype;
 	void *obj;
-	char buf[512];
 	struct timeline_emit_context ctx;
+	struct weston_timeline_point_record *point;
+	uint32_t name_id;
 
 	clock_gettime(timeline_.clk_id, &ts);
 
-	ctx.out = timeline_.file;
-	ctx.cur = fmemopen(buf, sizeof(buf), "w");
-	ctx.series = timeline_.series;
-
-	if (!ctx.cur) {
-		weston_log("Timeline error in fmemopen, closing.\n");
-		weston_timeline_close();
+	ctx.ring = timeline_get_ring();
+	if (!ctx.ring)
 		return;
+
+	if (ctx.ring->series != timeline_.series) {
+		ctx.ring->series = timeline_.series;
+		ctx.ring->name_count = 0;
 	}
 
-	fprintf(ctx.cur, "{ \"T\":[%" PRId64 ", %ld], \"N\":\"%s\"",
-		(int64_t)ts.tv_sec, ts.tv_nsec, name);
+	ctx.series = timeline_.series;
+	ctx.len = 0;
+	ctx.overflow = false;
+	ctx.object_count = 0;
+	ctx.name = NULL;
+	ctx.output = 0;
+	ctx.surface = 0;
+	ctx.vblank = WESTON_TIMELINE_NO_VBLANK;
+	ctx.arg_count = 0;
+
+	name_id = stage_name(&ctx, name);
 
 	va_start(argp, name);
 	while (1) {
@@ -272,21 +643,26 @@ weston_timeline_point(const char *name, ...)
 			break;
 
 		obj = va_arg(argp, void *);
-		if (type_dispatch[otype]) {
-			fprintf(ctx.cur, ", ");
-			type_dispatch[otype](&ctx, obj);
-		}
+		if (type_dispatch[otype] && type_dispatch[otype](&ctx, obj) &&
+		    ctx.arg_count < ARRAY_LENGTH(ctx.args))
+			ctx.args[ctx.arg_count++] = otype;
 	}
 	va_end(argp);
 
-	fprintf(ctx.cur, " }\n");
-	fflush(ctx.cur);
-	if (ferror(ctx.cur)) {
-		weston_log("Timeline error in constructing entry, closing.\n");
-		weston_timeline_close();
-	} else {
-		fprintf(ctx.out, "%s", buf);
+	point = (struct weston_timeline_point_record *)
+		stage_record(&ctx, WESTON_TIMELINE_RECORD_POINT, name_id,
+			     sizeof *point);
+	if (ctx.overflow) {
+		__atomic_fetch_add(&ctx.ring->dropped, 1, __ATOMIC_RELAXED);
+		return;
 	}
 
-	fclose(ctx.cur);
+	point->time = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	point->output = ctx.output;
+	point->surface = ctx.surface;
+	point->vblank = ctx.vblank;
+	memcpy(point->args, ctx.args, ctx.arg_count);
+
+	if (ring_write(ctx.ring, ctx.buf, ctx.len))
+		commit_staged(&ctx);
 }
@@ -25,6 +25,11 @@
 #include <assert.h>
 #include <float.h>
 #include <math.h>
+#include <stdlib.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
 
 #include "vertex-clipping.h"
 
@@ -282,6 +287,30 @@ clip_polygon_bottom(struct clip_context *ctx, const struct polygon8 *src,
 #define min(a, b) (((a) > (b)) ? (b) : (a))
 #define clip(x, a, b)  min(max(x, a), b)
 
+/* Copies the polygon without the vertices equal to the previous one. */
+static int
+remove_duplicates(const struct polygon8 *surf, float *ex, float *ey)
+{
+	int i, n;
+
+	ex[0] = surf->x[0];
+	ey[0] = surf->y[0];
+	n = 1;
+	for (i = 1; i < surf->n; i++) {
+		if (float_difference(ex[n - 1], surf->x[i]) == 0.0f &&
+		    float_difference(ey[n - 1], surf->y[i]) == 0.0f)
+			continue;
+		ex[n] = surf->x[i];
+		ey[n] = surf->y[i];
+		n++;
+	}
+	if (float_difference(ex[n - 1], surf->x[0]) == 0.0f &&
+	    float_difference(ey[n - 1], surf->y[0]) == 0.0f)
+		n--;
+
+	return n;
+}
+
 int
 clip_simple(struct clip_context *ctx,
 	    struct polygon8 *surf,
@@ -303,28 +332,273 @@ clip_transformed(struct clip_context *ctx,
 		 float *ey)
 {
 	struct polygon8 polygon;
-	int i, n;
 
 	polygon.n = clip_polygon_left(ctx, surf, polygon.x, polygon.y);
 	surf->n = clip_polygon_right(ctx, &polygon, surf->x, surf->y);
 	polygon.n = clip_polygon_top(ctx, surf, polygon.x, polygon.y);
 	surf->n = clip_polygon_bottom(ctx, &polygon, surf->x, surf->y);
 
-	/* Get rid of duplicate vertices */
-	ex[0] = surf->x[0];
-	ey[0] = surf->y[0];
-	n = 1;
-	for (i = 1; i < surf->n; i++) {
-		if (float_difference(ex[n - 1], surf->x[i]) == 0.0f &&
-		    float_difference(ey[n - 1], surf->y[i]) == 0.0f)
-			continue;
-		ex[n] = surf->x[i];
-		ey[n] = surf->y[i];
-		n++;
+	return remove_duplicates(surf, ex, ey);
+}
+
+void
+clip_arena_init(struct clip_arena *arena)
+{
+	arena->x = NULL;
+	arena->y = NULL;
+	arena->n = NULL;
+	arena->quad = NULL;
+	arena->npolygons = 0;
+	arena->nvertices = 0;
+	arena->size = 0;
+}
+
+void
+clip_arena_release(struct clip_arena *arena)
+{
+	free(arena->x);
+	free(arena->y);
+	free(arena->n);
+	free(arena->quad);
+	clip_arena_init(arena);
+}
+
+void
+clip_arena_reset(struct clip_arena *arena)
+{
+	arena->npolygons = 0;
+	arena->nvertices = 0;
+}
+
+/* Makes room for n more polygons of up to 8 vertices. */
+static int
+clip_arena_reserve(struct clip_arena *arena, int n)
+{
+	int size = arena->size ? arena->size : 16;
+	void *x, *y, *count, *quad;
+
+	if (arena->npolygons + n <= arena->size)
+		return 0;
+
+	while (size < arena->npolygons + n)
+		size *= 2;
+
+	x = realloc(arena->x, size * 8 * sizeof *arena->x);
+	if (x)
+		arena->x = x;
+	y = realloc(arena->y, size * 8 * sizeof *arena->y);
+	if (y)
+		arena->y = y;
+	count = realloc(arena->n, size * sizeof *arena->n);
+	if (count)
+		arena->n = count;
+	quad = realloc(arena->quad, size * sizeof *arena->quad);
+	if (quad)
+		arena->quad = quad;
+	if (!x || !y || !count || !quad)
+		return -1;
+
+	arena->size = size;
+
+	return 0;
+}
+
+static void
+clip_arena_add(struct clip_arena *arena, int quad, int n)
+{
+	if (n < 3)
+		return;
+
+	arena->n[arena->npolygons] = n;
+	arena->quad[arena->npolygons] = quad;
+	arena->npolygons++;
+	arena->nvertices += n;
+}
+
+enum quad_class {
+	QUAD_REJECT,		/* bounding box outside of the clip rect */
+	QUAD_ACCEPT,		/* all inside, as clip_transformed() sees it */
+	QUAD_AXIS_ALIGNED,	/* a rectangle, clamping is enough */
+	QUAD_GENERAL,
+};
+
+/* Classifies four quads at a time, from their vertices k in lane i of
+ * x[k] and y[k]. */
+#if defined(__SSE__)
+static void
+classify_quads(const struct clip_context *ctx,
+	       __m128 x[4], __m128 y[4], enum quad_class *class)
+{
+	__m128 x1 = _mm_set1_ps(ctx->clip.x1), x2 = _mm_set1_ps(ctx->clip.x2);
+	__m128 y1 = _mm_set1_ps(ctx->clip.y1), y2 = _mm_set1_ps(ctx->clip.y2);
+	__m128 min_x, max_x, min_y, max_y, reject, inside, aligned;
+	int i, reject_mask, inside_mask, aligned_mask;
+
+	min_x = _mm_min_ps(_mm_min_ps(x[0], x[1]), _mm_min_ps(x[2], x[3]));
+	max_x = _mm_max_ps(_mm_max_ps(x[0], x[1]), _mm_max_ps(x[2], x[3]));
+	min_y = _mm_min_ps(_mm_min_ps(y[0], y[1]), _mm_min_ps(y[2], y[3]));
+	max_y = _mm_max_ps(_mm_max_ps(y[0], y[1]), _mm_max_ps(y[2], y[3]));
+
+	reject = _mm_or_ps(_mm_or_ps(_mm_cmpge_ps(min_x, x2),
+				     _mm_cmple_ps(max_x, x1)),
+			   _mm_or_ps(_mm_cmpge_ps(min_y, y2),
+				     _mm_cmple_ps(max_y, y1)));
+	inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(min_x, x1),
+				       _mm_cmplt_ps(max_x, x2)),
+			    _mm_and_ps(_mm_cmpge_ps(min_y, y1),
+				       _mm_cmplt_ps(max_y, y2)));
+	/* edges 0-1 and 2-3 horizontal, or vertical */
+	aligned = _mm_or_ps(
+		_mm_and_ps(_mm_and_ps(_mm_cmpeq_ps(y[0], y[1]),
+				      _mm_cmpeq_ps(y[2], y[3])),
+			   _mm_and_ps(_mm_cmpeq_ps(x[1], x[2]),
+				      _mm_cmpeq_ps(x[3], x[0]))),
+		_mm_and_ps(_mm_and_ps(_mm_cmpeq_ps(x[0], x[1]),
+				      _mm_cmpeq_ps(x[2], x[3])),
+			   _mm_and_ps(_mm_cmpeq_ps(y[1], y[2]),
+				      _mm_cmpeq_ps(y[3], y[0]))));
+
+	reject_mask = _mm_movemask_ps(reject);
+	inside_mask = _mm_movemask_ps(inside);
+	aligned_mask = _mm_movemask_ps(aligned);
+	for (i = 0; i < 4; i++) {
+		if (reject_mask & (1 << i))
+			class[i] = QUAD_REJECT;
+		else if (inside_mask & (1 << i))
+			class[i] = QUAD_ACCEPT;
+		else if (aligned_mask & (1 << i))
+			class[i] = QUAD_AXIS_ALIGNED;
+		else
+			class[i] = QUAD_GENERAL;
 	}
-	if (float_difference(ex[n - 1], surf->x[0]) == 0.0f &&
-	    float_difference(ey[n - 1], surf->y[0]) == 0.0f)
-		n--;
+}
+#endif
 
-	return n;
+static enum quad_class
+classify_quad(const struct clip_context *ctx, const struct clip_quad *quad)
+{
+	const float *x = quad->x, *y = quad->y;
+	float min_x, max_x, min_y, max_y;
+	int i;
+
+	min_x = max_x = x[0];
+	min_y = max_y = y[0];
+	for (i = 1; i < 4; i++) {
+		min_x = min(min_x, x[i]);
+		max_x = max(max_x, x[i]);
+		min_y = min(min_y, y[i]);
+		max_y = max(max_y, y[i]);
+	}
+
+	if (min_x >= ctx->clip.x2 || max_x <= ctx->clip.x1 ||
+	    min_y >= ctx->clip.y2 || max_y <= ctx->clip.y1)
+		return QUAD_REJECT;
+
+	if (min_x >= ctx->clip.x1 && max_x < ctx->clip.x2 &&
+	    min_y >= ctx->clip.y1 && max_y < ctx->clip.y2)
+		return QUAD_ACCEPT;
+
+	if ((y[0] == y[1] && y[2] == y[3] && x[1] == x[2] && x[3] == x[0]) ||
+	    (x[0] == x[1] && x[2] == x[3] && y[1] == y[2] && y[3] == y[0]))
+		return QUAD_AXIS_ALIGNED;
+
+	return QUAD_GENERAL;
+}
+
+/* Appends the polygon clip_transformed() makes of a quad. */
+static void
+clip_quad(struct clip_context *ctx, const struct clip_quad *quad,
+	  enum quad_class class, int index, struct clip_arena *arena)
+{
+	float *ex = arena->x + arena->nvertices;
+	float *ey = arena->y + arena->nvertices;
+	struct polygon8 polygon;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		polygon.x[i] = quad->x[i];
+		polygon.y[i] = quad->y[i];
+	}
+	polygon.n = 4;
+
+	switch (class) {
+	case QUAD_REJECT:
+		return;
+	case QUAD_ACCEPT:
+		break;
+	case QUAD_AXIS_ALIGNED:
+		/* the intersection of two rectangles, maybe starting from
+		 * another corner than Sutherland-Hodgman would */
+		for (i = 0; i < 4; i++) {
+			polygon.x[i] = clip(polygon.x[i],
+					    ctx->clip.x1, ctx->clip.x2);
+			polygon.y[i] = clip(polygon.y[i],
+					    ctx->clip.y1, ctx->clip.y2);
+		}
+		break;
+	case QUAD_GENERAL:
+		clip_arena_add(arena, index,
+			       clip_transformed(ctx, &polygon, ex, ey));
+		return;
+	}
+
+	clip_arena_add(arena, index, remove_duplicates(&polygon, ex, ey));
+}
+
+int
+clip_quads(struct clip_context *ctx, const struct clip_quad *quads, int n,
+	   int transformed, struct clip_arena *arena)
+{
+	enum quad_class class[4];
+	int first = arena->npolygons, i = 0, j, k;
+	float *ex, *ey;
+#if defined(__SSE__)
+	__m128 x[4], y[4];
+#endif
+
+	if (clip_arena_reserve(arena, n) < 0)
+		return -1;
+
+	if (!transformed) {
+		/* clip_simple(), no need to look closer */
+		for (i = 0; i < n; i++) {
+			if (classify_quad(ctx, &quads[i]) == QUAD_REJECT)
+				continue;
+
+			ex = arena->x + arena->nvertices;
+			ey = arena->y + arena->nvertices;
+			for (k = 0; k < 4; k++) {
+				ex[k] = clip(quads[i].x[k],
+					     ctx->clip.x1, ctx->clip.x2);
+				ey[k] = clip(quads[i].y[k],
+					     ctx->clip.y1, ctx->clip.y2);
+			}
+			clip_arena_add(arena, i, 4);
+		}
+
+		return arena->npolygons - first;
+	}
+
+#if defined(__SSE__)
+	for (; i + 4 <= n; i += 4) {
+		/* vertex k of the four quads in x[k] and y[k] */
+		for (k = 0; k < 4; k++) {
+			x[k] = _mm_loadu_ps(quads[i + k].x);
+			y[k] = _mm_loadu_ps(quads[i + k].y);
+		}
+		_MM_TRANSPOSE4_PS(x[0], x[1], x[2], x[3]);
+		_MM_TRANSPOSE4_PS(y[0], y[1], y[2], y[3]);
+
+		classify_quads(ctx, x, y, class);
+		for (j = 0; j < 4; j++)
+			clip_quad(ctx, &quads[i + j], class[j], i + j, arena);
+	}
+#endif
+
+	for (; i < n; i++) {
+		class[0] = classify_quad(ctx, &quads[i]);
+		clip_quad(ctx, &quads[i], class[0], i, arena);
+	}
+
+	return arena->npolygons - first;
 }
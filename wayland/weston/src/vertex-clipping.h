@@ -61,6 +61,40 @@ int
 clip_transformed(struct clip_context *ctx,
 		 struct polygon8 *surf,
 		 float *ex,
-		 float *ey);\
+		 float *ey);
+
+struct clip_quad {
+	float x[4];
+	float y[4];
+};
+
+/* The polygons made by clip_quads(), one after the other. The buffers
+ * are kept between calls, clip_arena_reset() only empties them. */
+struct clip_arena {
+	float *x, *y;		/* vertices of all the polygons */
+	int *n;			/* vertex count of each polygon */
+	int *quad;		/* index of the quad it was clipped from */
+	int npolygons;
+	int nvertices;
+	int size;		/* room for polygons, of up to 8 vertices */
+};
+
+void
+clip_arena_init(struct clip_arena *arena);
+
+void
+clip_arena_release(struct clip_arena *arena);
+
+void
+clip_arena_reset(struct clip_arena *arena);
+
+/* Clips n quads against ctx->clip, like clip_simple() or, when
+ * transformed, clip_transformed() would one by one. Appends the
+ * polygons with 3 or more vertices to the arena, returns how many or -1
+ * on allocation failure. Axis aligned quads of a transformed surface
+ * may start from another corner than with clip_transformed(). */
+int
+clip_quads(struct clip_context *ctx, const struct clip_quad *quads, int n,
+	   int transformed, struct clip_arena *arena);
 
 #endif
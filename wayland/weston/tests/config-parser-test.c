@@ -32,6 +32,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <unistd.h>
+#include <time.h>
 
 #include "config-parser.h"
 
@@ -166,6 +167,39 @@ static struct zuc_fixture config_test_t4 = {
 	.set_up = setup_test_config_failing,
 };
 
+static struct zuc_fixture config_test_t5 = {
+	.data =
+	"[output]\n"
+	"name=LVDS1\n"
+	"scale=2\n"
+	"name=VGA1\n"
+	"\n"
+	"[output]\n"
+	"name=VGA1\n"
+	"scale=0x10\n"
+	"ratio=1.5\n"
+	"mode= preferred\t\n"
+	"enabled=\n"
+	"[output]\n"
+	"name=HDMI1\n"
+	"scale=-1",
+	.set_up = setup_test_config,
+	.tear_down = cleanup_test_config
+};
+
+static struct zuc_fixture config_test_t6 = {
+	.data =
+	"# header on the last line needs a newline\n"
+	"[bambam]",
+	.set_up = setup_test_config_failing,
+};
+
+static struct zuc_fixture config_test_t7 = {
+	.data = "",
+	.set_up = setup_test_config,
+	.tear_down = cleanup_test_config
+};
+
 ZUC_TEST_F(config_test_t0, comment_only, data)
 {
 	struct weston_config *config = data;
@@ -457,3 +491,242 @@ ZUC_TEST(config_test, section_from_null)
 	section = weston_config_get_section(NULL, "bucket", NULL, NULL);
 	ZUC_ASSERT_NULL(section);
 }
+
+ZUC_TEST_F(config_test_t5, first_key_wins, data)
+{
+	char *s;
+	int r;
+	struct weston_config_section *section;
+	struct weston_config *config = data;
+
+	section = weston_config_get_section(config, "output", NULL, NULL);
+	r = weston_config_section_get_string(section, "name", &s, NULL);
+
+	ZUC_ASSERTG_EQ(0, r, out_free);
+	ZUC_ASSERTG_STREQ("LVDS1", s, out_free);
+
+out_free:
+	free(s);
+}
+
+ZUC_TEST_F(config_test_t5, selector_uses_first_key, data)
+{
+	int r;
+	int32_t n;
+	struct weston_config_section *section;
+	struct weston_config *config = data;
+
+	/* The first section also has name=VGA1, but after name=LVDS1 */
+	section = weston_config_get_section(config, "output", "name", "VGA1");
+	r = weston_config_section_get_int(section, "scale", &n, 0);
+
+	ZUC_ASSERT_EQ(0, r);
+	ZUC_ASSERT_EQ(16, n);
+}
+
+ZUC_TEST_F(config_test_t5, selector_missing, data)
+{
+	struct weston_config_section *section;
+	struct weston_config *config = data;
+
+	section = weston_config_get_section(config, "output", "name", "DP1");
+	ZUC_ASSERT_NULL(section);
+	section = weston_config_get_section(config, "output", "mode", "2");
+	ZUC_ASSERT_NULL(section);
+	section = weston_config_get_section(config, "scale", "name", "VGA1");
+	ZUC_ASSERT_NULL(section);
+}
+
+ZUC_TEST_F(config_test_t5, last_line_without_newline, data)
+{
+	int r;
+	int32_t n;
+	struct weston_config_section *section;
+	struct weston_config *config = data;
+
+	section = weston_config_get_section(config, "output", "name", "HDMI1");
+	r = weston_config_section_get_int(section, "scale", &n, 0);
+
+	ZUC_ASSERT_EQ(0, r);
+	ZUC_ASSERT_EQ(-1, n);
+}
+
+ZUC_TEST_F(config_test_t5, value_trimmed, data)
+{
+	char *s;
+	int r;
+	struct weston_config_section *section;
+	struct weston_config *config = data;
+
+	section = weston_config_get_section(config, "output", "name", "VGA1");
+	r = weston_config_section_get_string(section, "mode", &s, NULL);
+
+	ZUC_ASSERTG_EQ(0, r, out_free);
+	ZUC_ASSERTG_STREQ("preferred", s, out_free);
+
+out_free:
+	free(s);
+}
+
+ZUC_TEST_F(config_test_t5, cached_values, data)
+{
+	int i, r, b;
+	int32_t n;
+	double d;
+	struct weston_config_section *section;
+	struct weston_config *config = data;
+
+	section = weston_config_get_section(config, "output", "name", "VGA1");
+
+	/* Every lookup of the same key must give the same answer, whether
+	 * or not the value was converted before. */
+	for (i = 0; i < 3; i++) {
+		r = weston_config_section_get_int(section, "ratio", &n, 7);
+		ZUC_ASSERT_EQ(-1, r);
+		ZUC_ASSERT_EQ(EINVAL, errno);
+		ZUC_ASSERT_EQ(7, n);
+
+		r = weston_config_section_get_double(section, "ratio", &d, 0);
+		ZUC_ASSERT_EQ(0, r);
+		ZUC_ASSERT_EQ(1.5, d);
+
+		r = weston_config_section_get_bool(section, "ratio", &b, 1);
+		ZUC_ASSERT_EQ(-1, r);
+		ZUC_ASSERT_EQ(EINVAL, errno);
+		ZUC_ASSERT_EQ(1, b);
+
+		r = weston_config_section_get_bool(section, "enabled", &b, 1);
+		ZUC_ASSERT_EQ(-1, r);
+		ZUC_ASSERT_EQ(EINVAL, errno);
+		ZUC_ASSERT_EQ(1, b);
+	}
+}
+
+ZUC_TEST_F(config_test_t5, next_section, data)
+{
+	const char *name;
+	int i;
+	struct weston_config_section *section;
+	struct weston_config *config = data;
+
+	section = NULL;
+	i = 0;
+	while (weston_config_next_section(config, &section, &name)) {
+		ZUC_ASSERT_STREQ("output", name);
+		i++;
+	}
+
+	ZUC_ASSERT_EQ(3, i);
+}
+
+ZUC_TEST_F(config_test_t6, doesnt_parse, data)
+{
+	struct weston_config *config = data;
+	ZUC_ASSERT_NULL(config);
+}
+
+ZUC_TEST_F(config_test_t7, empty_file, data)
+{
+	struct weston_config_section *section;
+	struct weston_config *config = data;
+
+	ZUC_ASSERT_NOT_NULL(config);
+	section = weston_config_get_section(config, "foo", NULL, NULL);
+	ZUC_ASSERT_NULL(section);
+}
+
+ZUC_TEST(config_test, long_lines)
+{
+	struct weston_config_section *section;
+	struct weston_config *config;
+	char *text, *p, *s = NULL;
+	int r;
+
+	/* fgets() used to split lines at 512 bytes */
+	text = malloc(4096);
+	ZUC_ASSERT_NOT_NULL(text);
+	strcpy(text, "[launcher]\npath=");
+	p = text + strlen(text);
+	memset(p, 'x', 2000);
+	strcpy(p + 2000, "\nicon=foo.png\n");
+
+	config = load_config(text);
+	free(text);
+	ZUC_ASSERT_NOT_NULL(config);
+
+	section = weston_config_get_section(config, "launcher", NULL, NULL);
+	r = weston_config_section_get_string(section, "path", &s, NULL);
+	ZUC_ASSERTG_EQ(0, r, out);
+	ZUC_ASSERTG_EQ(2000, (int)strlen(s), out);
+	free(s);
+	s = NULL;
+
+	r = weston_config_section_get_string(section, "icon", &s, NULL);
+	ZUC_ASSERTG_EQ(0, r, out);
+	ZUC_ASSERTG_STREQ("foo.png", s, out);
+
+out:
+	free(s);
+	weston_config_destroy(config);
+}
+
+static double
+seconds_since(const struct timespec *begin)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - begin->tv_sec) +
+		(now.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+ZUC_TEST(config_test, benchmark)
+{
+	const int nsections = 2000, nlookups = 2000000;
+	struct weston_config_section *section;
+	struct weston_config *config;
+	struct timespec begin;
+	char *text, *p, name[32];
+	int32_t scale;
+	int i, j, r, found = 0;
+	double parse_time, lookup_time;
+
+	text = malloc(nsections * 256);
+	ZUC_ASSERT_NOT_NULL(text);
+	p = text;
+	p += sprintf(p, "[core]\nmodules=xwayland.so\n\n");
+	for (i = 0; i < nsections; i++)
+		p += sprintf(p, "[output]\n"
+			     "# output %d\n"
+			     "name=OUT-%d\n"
+			     "mode=1920x1080\n"
+			     "scale=%d\n"
+			     "transform=normal\n"
+			     "seat=seat%d\n\n",
+			     i, i, 1 + i % 3, i % 7);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	config = load_config(text);
+	parse_time = seconds_since(&begin);
+	free(text);
+	ZUC_ASSERT_NOT_NULL(config);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0, j = 0; i < nlookups; i++) {
+		j = (j + 7919) % nsections;
+		snprintf(name, sizeof name, "OUT-%d", j);
+		section = weston_config_get_section(config, "output",
+						    "name", name);
+		r = weston_config_section_get_int(section, "scale",
+						  &scale, 1);
+		if (r == 0 && scale == 1 + j % 3)
+			found++;
+	}
+	lookup_time = seconds_since(&begin);
+	weston_config_destroy(config);
+
+	ZUC_ASSERT_EQ(nlookups, found);
+	printf("loaded %d sections in %.2f ms, %.2f M lookups/s\n",
+	       nsections, parse_time * 1e3, nlookups / lookup_time / 1e6);
+}
@@ -0,0 +1,313 @@
+/*
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "weston-test-runner.h"
+
+#include "shared/helpers.h"
+#include "shared/image-blur.h"
+
+/* The kernel theme_create() used to blur the shadow with, and the
+ * sigma it corresponds to: exp(-f² / 71) is exp(-f² / 2σ²). */
+#define REFERENCE_TAPS 71
+#define REFERENCE_SIGMA sqrt(REFERENCE_TAPS / 2.0)
+
+/* The old 71 tap gaussian of cairo-util.c, on a plain buffer. */
+static void
+reference_blur(uint32_t *src, int width, int height, int margin)
+{
+	int32_t x, y, z, w;
+	uint32_t *s, *d, *dst, a, p;
+	int i, j, k, size, half;
+	uint32_t kernel[REFERENCE_TAPS];
+	double f;
+
+	size = ARRAY_LENGTH(kernel);
+	dst = malloc(width * height * sizeof *dst);
+	assert(dst);
+
+	half = size / 2;
+	a = 0;
+	for (i = 0; i < size; i++) {
+		f = (i - half);
+		kernel[i] = exp(- f * f / ARRAY_LENGTH(kernel)) * 10000;
+		a += kernel[i];
+	}
+
+	for (i = 0; i < height; i++) {
+		s = src + i * width;
+		d = dst + i * width;
+		for (j = 0; j < width; j++) {
+			if (margin < j && j < width - margin) {
+				d[j] = s[j];
+				continue;
+			}
+
+			x = y = z = w = 0;
+			for (k = 0; k < size; k++) {
+				if (j - half + k < 0 || j - half + k >= width)
+					continue;
+				p = s[j - half + k];
+
+				x += (p >> 24) * kernel[k];
+				y += ((p >> 16) & 0xff) * kernel[k];
+				z += ((p >> 8) & 0xff) * kernel[k];
+				w += (p & 0xff) * kernel[k];
+			}
+			d[j] = (x / a << 24) | (y / a << 16) |
+			       (z / a << 8) | w / a;
+		}
+	}
+
+	for (i = 0; i < height; i++) {
+		d = src + i * width;
+		for (j = 0; j < width; j++) {
+			if (margin <= i && i < height - margin) {
+				d[j] = dst[i * width + j];
+				continue;
+			}
+
+			x = y = z = w = 0;
+			for (k = 0; k < size; k++) {
+				if (i - half + k < 0 || i - half + k >= height)
+					continue;
+				p = dst[(i - half + k) * width + j];
+
+				x += (p >> 24) * kernel[k];
+				y += ((p >> 16) & 0xff) * kernel[k];
+				z += ((p >> 8) & 0xff) * kernel[k];
+				w += (p & 0xff) * kernel[k];
+			}
+			d[j] = (x / a << 24) | (y / a << 16) |
+			       (z / a << 8) | w / a;
+		}
+	}
+
+	free(dst);
+}
+
+/* The shadow theme_create() draws: an opaque black square inset by a
+ * quarter of the size. */
+static uint32_t *
+shadow_image(int size)
+{
+	uint32_t *image;
+	int x, y;
+
+	image = calloc(size * size, sizeof *image);
+	assert(image);
+	for (y = size / 4; y < size * 3 / 4; y++)
+		for (x = size / 4; x < size * 3 / 4; x++)
+			image[y * size + x] = 0xff000000;
+
+	return image;
+}
+
+static int
+channel_diff(uint32_t p, uint32_t q)
+{
+	int i, d, max = 0;
+
+	for (i = 0; i < 32; i += 8) {
+		d = abs((int) ((p >> i) & 0xff) - (int) ((q >> i) & 0xff));
+		if (d > max)
+			max = d;
+	}
+
+	return max;
+}
+
+static int
+image_diff(const uint32_t *a, const uint32_t *b, int n, double *mean)
+{
+	int i, d, max = 0;
+	double total = 0;
+
+	for (i = 0; i < n; i++) {
+		d = channel_diff(a[i], b[i]);
+		total += d;
+		if (d > max)
+			max = d;
+	}
+	*mean = total / n;
+
+	return max;
+}
+
+TEST(shadow_matches_gaussian)
+{
+	uint32_t *expected, *image;
+	int size = 128, max;
+	double mean;
+
+	expected = shadow_image(size);
+	image = shadow_image(size);
+
+	reference_blur(expected, size, size, size / 2);
+	assert(blur_image(image, size, size, size * 4,
+			  REFERENCE_SIGMA, size / 2) == 0);
+
+	max = image_diff(expected, image, size * size, &mean);
+	fprintf(stderr, "shadow: max diff %d, mean diff %.3f\n", max, mean);
+	assert(max <= 6);
+	assert(mean < 1.0);
+
+	free(expected);
+	free(image);
+}
+
+TEST(margin_keeps_interior)
+{
+	uint32_t *source, *expected, *image;
+	int width = 200, height = 150, margin = 40, x, y, max;
+	double mean;
+
+	source = malloc(width * height * sizeof *source);
+	expected = malloc(width * height * sizeof *expected);
+	image = malloc(width * height * sizeof *image);
+	assert(source && expected && image);
+
+	/* smooth, so that the box and gaussian blurs can be compared */
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++)
+			source[y * width + x] =
+				(uint32_t) ((x + y) / 2) << 24 |
+				(uint32_t) (x / 2) << 16 |
+				(uint32_t) y << 8 |
+				(uint32_t) (128 + 100 * sin(x / 10.0));
+
+	memcpy(expected, source, width * height * sizeof *source);
+	memcpy(image, source, width * height * sizeof *source);
+	reference_blur(expected, width, height, margin);
+	assert(blur_image(image, width, height, width * 4,
+			  REFERENCE_SIGMA, margin) == 0);
+
+	/* pixels neither pass touches keep their value exactly */
+	for (y = margin; y < height - margin; y++)
+		for (x = margin + 1; x < width - margin; x++)
+			assert(image[y * width + x] ==
+			       source[y * width + x]);
+
+	max = image_diff(expected, image, width * height, &mean);
+	fprintf(stderr, "margin: max diff %d, mean diff %.3f\n", max, mean);
+	assert(max <= 6);
+	assert(mean < 1.0);
+
+	free(source);
+	free(expected);
+	free(image);
+}
+
+TEST(padded_stride)
+{
+	uint32_t *packed, *padded;
+	int width = 37, height = 21, pitch = 48, x, y;
+
+	packed = calloc(width * height, sizeof *packed);
+	padded = calloc(pitch * height, sizeof *padded);
+	assert(packed && padded);
+
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++) {
+			packed[y * width + x] = (uint32_t) random();
+			padded[y * pitch + x] = packed[y * width + x];
+		}
+	for (y = 0; y < height; y++)
+		for (x = width; x < pitch; x++)
+			padded[y * pitch + x] = 0xdeadbeef;
+
+	assert(blur_image(packed, width, height, width * 4, 3.0, width) == 0);
+	assert(blur_image(padded, width, height, pitch * 4, 3.0, width) == 0);
+
+	for (y = 0; y < height; y++) {
+		assert(memcmp(packed + y * width, padded + y * pitch,
+			      width * sizeof *packed) == 0);
+		for (x = width; x < pitch; x++)
+			assert(padded[y * pitch + x] == 0xdeadbeef);
+	}
+
+	free(packed);
+	free(padded);
+}
+
+static double
+seconds_since(const struct timespec *begin)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - begin->tv_sec) +
+	       (now.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+TEST(blur_benchmark)
+{
+	static const struct {
+		int width, height;
+	} sizes[] = {
+		{ 128, 128 },	/* the theme shadow */
+		{ 640, 480 },
+		{ 1280, 720 },
+	};
+	struct timespec begin;
+	uint32_t *image;
+	double gaussian, box;
+	unsigned int i;
+	int width, height, k, rounds;
+
+	for (i = 0; i < ARRAY_LENGTH(sizes); i++) {
+		width = sizes[i].width;
+		height = sizes[i].height;
+		rounds = 128 * 128 * 4 / (width * height);
+		if (rounds < 1)
+			rounds = 1;
+		image = calloc(width * height, sizeof *image);
+		assert(image);
+
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		for (k = 0; k < rounds; k++)
+			reference_blur(image, width, height, width);
+		gaussian = seconds_since(&begin) / rounds;
+
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		for (k = 0; k < rounds * 16; k++)
+			blur_image(image, width, height, width * 4,
+				   REFERENCE_SIGMA, width);
+		box = seconds_since(&begin) / (rounds * 16);
+
+		fprintf(stderr, "%dx%d: gaussian %.3f ms, box %.3f ms\n",
+			width, height, gaussian * 1e3, box * 1e3);
+		free(image);
+	}
+}
@@ -0,0 +1,503 @@
+/*
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <png.h>
+#include <pixman.h>
+
+#include "weston-test-runner.h"
+
+#include "shared/helpers.h"
+#include "shared/image-convert.h"
+#include "shared/image-loader.h"
+
+#define MAX_IMAGES 64
+
+/* The per pixel conversions the loaders used before image-convert.c */
+static void
+reference_swizzle_row(uint8_t *row, int width)
+{
+	uint8_t *s;
+	uint32_t *d;
+
+	s = row + (width - 1) * 3;
+	d = (uint32_t *) (row + (width - 1) * 4);
+	while (s >= row) {
+		*d = 0xff000000 | (s[0] << 16) | (s[1] << 8) | (s[2] << 0);
+		s -= 3;
+		d--;
+	}
+}
+
+static inline int
+reference_multiply_alpha(int alpha, int color)
+{
+	int temp = (alpha * color) + 0x80;
+
+	return ((temp + (temp >> 8)) >> 8);
+}
+
+static void
+reference_premultiply(uint8_t *data, int count)
+{
+	uint8_t *p;
+	uint32_t w;
+	int i;
+
+	for (i = 0, p = data; i < count; i++, p += 4) {
+		uint8_t alpha = p[3];
+
+		if (alpha == 0) {
+			w = 0;
+		} else {
+			uint8_t red = p[0];
+			uint8_t green = p[1];
+			uint8_t blue = p[2];
+
+			if (alpha != 0xff) {
+				red = reference_multiply_alpha(alpha, red);
+				green = reference_multiply_alpha(alpha, green);
+				blue = reference_multiply_alpha(alpha, blue);
+			}
+			w = ((uint32_t) alpha << 24) | (red << 16) |
+			    (green << 8) | (blue << 0);
+		}
+
+		*(uint32_t *) p = w;
+	}
+}
+
+/* load_png() without its premultiply step, so the reference path
+ * above can be applied to the rows instead. */
+static uint8_t *
+reference_load_png(const char *filename, int *width, int *height)
+{
+	png_struct *png;
+	png_info *info;
+	png_uint_32 w, h;
+	int depth, color_type, interlace;
+	uint8_t *data, **rows;
+	FILE *fp;
+	int i;
+
+	fp = fopen(filename, "rb");
+	assert(fp);
+	png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	info = png_create_info_struct(png);
+	assert(png && info);
+
+	png_init_io(png, fp);
+	png_read_info(png, info);
+	png_get_IHDR(png, info, &w, &h, &depth, &color_type, &interlace,
+		     NULL, NULL);
+
+	if (color_type == PNG_COLOR_TYPE_PALETTE)
+		png_set_palette_to_rgb(png);
+	if (color_type == PNG_COLOR_TYPE_GRAY)
+		png_set_expand_gray_1_2_4_to_8(png);
+	if (png_get_valid(png, info, PNG_INFO_tRNS))
+		png_set_tRNS_to_alpha(png);
+	if (depth == 16)
+		png_set_strip_16(png);
+	if (depth < 8)
+		png_set_packing(png);
+	if (color_type == PNG_COLOR_TYPE_GRAY ||
+	    color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+		png_set_gray_to_rgb(png);
+	if (interlace != PNG_INTERLACE_NONE)
+		png_set_interlace_handling(png);
+	png_set_filler(png, 0xff, PNG_FILLER_AFTER);
+	png_read_update_info(png, info);
+
+	data = malloc(w * h * 4);
+	rows = malloc(h * sizeof *rows);
+	assert(data && rows);
+	for (i = 0; i < (int) h; i++)
+		rows[i] = data + i * w * 4;
+	png_read_image(png, rows);
+	png_read_end(png, info);
+
+	png_destroy_read_struct(&png, &info, NULL);
+	free(rows);
+	fclose(fp);
+
+	reference_premultiply(data, w * h);
+	*width = w;
+	*height = h;
+
+	return data;
+}
+
+static const char *
+data_dir(void)
+{
+	static char path[256];
+	const char *srcdir = getenv("abs_top_srcdir");
+
+	snprintf(path, sizeof path, "%s/data", srcdir ? srcdir : ".");
+
+	return path;
+}
+
+/* The PNG files shipped in data/, which are what clients load */
+static int
+list_images(char *names[MAX_IMAGES])
+{
+	struct dirent *entry;
+	DIR *dir;
+	size_t length;
+	int count = 0;
+
+	dir = opendir(data_dir());
+	assert(dir);
+	while ((entry = readdir(dir)) && count < MAX_IMAGES) {
+		length = strlen(entry->d_name);
+		if (length < 4 ||
+		    strcmp(entry->d_name + length - 4, ".png") != 0)
+			continue;
+		assert(asprintf(&names[count], "%s/%s",
+				data_dir(), entry->d_name) > 0);
+		count++;
+	}
+	closedir(dir);
+	assert(count > 0);
+
+	return count;
+}
+
+static void
+free_images(char *names[], pixman_image_t *images[], int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (images && images[i])
+			pixman_image_unref(images[i]);
+		if (names)
+			free(names[i]);
+	}
+}
+
+static int
+images_equal(pixman_image_t *a, pixman_image_t *b)
+{
+	const uint8_t *pa, *pb;
+	int y, width, height;
+
+	width = pixman_image_get_width(a);
+	height = pixman_image_get_height(a);
+	if (width != pixman_image_get_width(b) ||
+	    height != pixman_image_get_height(b))
+		return 0;
+
+	pa = (const uint8_t *) pixman_image_get_data(a);
+	pb = (const uint8_t *) pixman_image_get_data(b);
+	for (y = 0; y < height; y++)
+		if (memcmp(pa + y * pixman_image_get_stride(a),
+			   pb + y * pixman_image_get_stride(b),
+			   width * 4) != 0)
+			return 0;
+
+	return 1;
+}
+
+TEST(rgb_to_xrgb_matches_reference)
+{
+	uint8_t a[4 * 67], b[4 * 67];
+	int width, i;
+
+	srand(1);
+	for (width = 1; width <= 67; width++) {
+		for (i = 0; i < width * 4; i++)
+			a[i] = b[i] = rand();
+
+		reference_swizzle_row(a, width);
+		image_rgb_to_xrgb(b, width);
+		assert(memcmp(a, b, width * 4) == 0);
+	}
+}
+
+TEST(premultiply_matches_reference)
+{
+	const int count = 256 * 256;
+	uint8_t *a, *b;
+	int i, offset;
+
+	a = malloc(count * 4);
+	b = malloc(count * 4);
+	assert(a && b);
+
+	/* every alpha against every color value, and unaligned tails */
+	for (offset = 0; offset < 8; offset++) {
+		for (i = 0; i < count; i++) {
+			a[i * 4 + 0] = i & 0xff;
+			a[i * 4 + 1] = ~i & 0xff;
+			a[i * 4 + 2] = (i * 7) & 0xff;
+			a[i * 4 + 3] = i >> 8;
+		}
+		memcpy(b, a, count * 4);
+
+		reference_premultiply(a, count - offset);
+		image_premultiply_rgba(b, count - offset);
+		assert(memcmp(a, b, count * 4) == 0);
+	}
+
+	free(a);
+	free(b);
+}
+
+TEST(png_matches_reference)
+{
+	char *names[MAX_IMAGES];
+	pixman_image_t *image;
+	uint8_t *reference;
+	int count, i, y, width, height, stride;
+
+	unsetenv(WESTON_IMAGE_CACHE_DIR_ENV_VAR);
+	count = list_images(names);
+	for (i = 0; i < count; i++) {
+		reference = reference_load_png(names[i], &width, &height);
+		image = load_image(names[i]);
+		assert(image);
+		assert(pixman_image_get_width(image) == width);
+		assert(pixman_image_get_height(image) == height);
+
+		stride = pixman_image_get_stride(image);
+		for (y = 0; y < height; y++)
+			assert(memcmp((uint8_t *) pixman_image_get_data(image) +
+				      y * stride,
+				      reference + y * width * 4,
+				      width * 4) == 0);
+
+		pixman_image_unref(image);
+		free(reference);
+	}
+
+	free_images(names, NULL, count);
+}
+
+TEST(load_images_matches_serial)
+{
+	char *names[MAX_IMAGES + 1];
+	pixman_image_t *serial[MAX_IMAGES + 1], *batch[MAX_IMAGES + 1];
+	int count, i;
+
+	unsetenv(WESTON_IMAGE_CACHE_DIR_ENV_VAR);
+	count = list_images(names);
+	names[count++] = strdup("/nonexistent.png");
+
+	for (i = 0; i < count; i++)
+		serial[i] = load_image(names[i]);
+	assert(load_images((const char * const *) names, batch, count) ==
+	       count - 1);
+
+	for (i = 0; i < count - 1; i++)
+		assert(batch[i] && images_equal(serial[i], batch[i]));
+	assert(batch[count - 1] == NULL);
+
+	free_images(NULL, serial, count);
+	free_images(names, batch, count);
+}
+
+static void
+copy_file(const char *from, const char *to)
+{
+	char buffer[4096];
+	FILE *in, *out;
+	size_t n;
+
+	in = fopen(from, "rb");
+	out = fopen(to, "wb");
+	assert(in && out);
+	while ((n = fread(buffer, 1, sizeof buffer, in)) > 0)
+		assert(fwrite(buffer, 1, n, out) == n);
+	fclose(in);
+	fclose(out);
+}
+
+static int
+count_cache_files(const char *dir)
+{
+	struct dirent *entry;
+	DIR *d;
+	int count = 0;
+
+	d = opendir(dir);
+	assert(d);
+	while ((entry = readdir(d)))
+		if (entry->d_name[0] != '.')
+			count++;
+	closedir(d);
+
+	return count;
+}
+
+static void
+remove_dir(const char *dir)
+{
+	struct dirent *entry;
+	char path[512];
+	DIR *d;
+
+	d = opendir(dir);
+	assert(d);
+	while ((entry = readdir(d))) {
+		if (entry->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof path, "%s/%s", dir, entry->d_name);
+		unlink(path);
+	}
+	closedir(d);
+	rmdir(dir);
+}
+
+TEST(cache_hit_and_invalidation)
+{
+	char dir[] = "/tmp/weston-image-cache-test-XXXXXX";
+	char *names[MAX_IMAGES], source[512], cache[512];
+	pixman_image_t *uncached, *stored, *mapped, *expected, *changed;
+	struct timespec times[2] = { { 0, 0 }, { 1000000000, 0 } };
+	int count;
+
+	assert(mkdtemp(dir));
+	count = list_images(names);
+	assert(count >= 2);
+	snprintf(source, sizeof source, "%s/source.png", dir);
+	copy_file(names[0], source);
+	snprintf(cache, sizeof cache, "%s/cache", dir);
+	assert(mkdir(cache, 0700) == 0);
+
+	unsetenv(WESTON_IMAGE_CACHE_DIR_ENV_VAR);
+	uncached = load_image(source);
+	expected = load_image(names[1]);
+	assert(uncached && expected);
+	assert(count_cache_files(cache) == 0);
+
+	setenv(WESTON_IMAGE_CACHE_DIR_ENV_VAR, cache, 1);
+	stored = load_image(source);
+	assert(count_cache_files(cache) == 1);
+	mapped = load_image(source);
+	assert(stored && mapped);
+	assert(images_equal(uncached, stored));
+	assert(images_equal(uncached, mapped));
+
+	/* drawing on a mapped image must not reach the cache file */
+	memset(pixman_image_get_data(mapped), 0x5a, 16);
+	pixman_image_unref(mapped);
+	mapped = load_image(source);
+	assert(images_equal(uncached, mapped));
+	pixman_image_unref(mapped);
+
+	/* a different file at the same path is decoded again and
+	 * replaces the cached copy */
+	copy_file(names[1], source);
+	assert(utimensat(AT_FDCWD, source, times, 0) == 0);
+	changed = load_image(source);
+	assert(changed && images_equal(expected, changed));
+	assert(count_cache_files(cache) == 1);
+	mapped = load_image(source);
+	assert(mapped && images_equal(expected, mapped));
+
+	unsetenv(WESTON_IMAGE_CACHE_DIR_ENV_VAR);
+	pixman_image_unref(uncached);
+	pixman_image_unref(expected);
+	pixman_image_unref(stored);
+	pixman_image_unref(changed);
+	pixman_image_unref(mapped);
+	free_images(names, NULL, count);
+	remove_dir(cache);
+	remove_dir(dir);
+}
+
+static double
+seconds_since(const struct timespec *begin)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - begin->tv_sec) +
+	       (now.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+/* Loading every image in data/, as a client starting up would */
+TEST(startup_benchmark)
+{
+	const int rounds = 10;
+	char dir[] = "/tmp/weston-image-cache-test-XXXXXX";
+	char *names[MAX_IMAGES];
+	pixman_image_t *images[MAX_IMAGES];
+	struct timespec begin;
+	double serial, batch, mapped;
+	int count, i, k;
+
+	unsetenv(WESTON_IMAGE_CACHE_DIR_ENV_VAR);
+	count = list_images(names);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (k = 0; k < rounds; k++) {
+		for (i = 0; i < count; i++)
+			images[i] = load_image(names[i]);
+		free_images(NULL, images, count);
+	}
+	serial = seconds_since(&begin) / rounds;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (k = 0; k < rounds; k++) {
+		load_images((const char * const *) names, images, count);
+		free_images(NULL, images, count);
+	}
+	batch = seconds_since(&begin) / rounds;
+
+	assert(mkdtemp(dir));
+	setenv(WESTON_IMAGE_CACHE_DIR_ENV_VAR, dir, 1);
+	load_images((const char * const *) names, images, count);
+	free_images(NULL, images, count);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (k = 0; k < rounds; k++) {
+		for (i = 0; i < count; i++)
+			images[i] = load_image(names[i]);
+		free_images(NULL, images, count);
+	}
+	mapped = seconds_since(&begin) / rounds;
+	unsetenv(WESTON_IMAGE_CACHE_DIR_ENV_VAR);
+	remove_dir(dir);
+
+	fprintf(stderr, "%d images: serial %.2f ms, load_images %.2f ms, "
+		"cached %.2f ms\n", count, serial * 1e3, batch * 1e3,
+		mapped * 1e3);
+	free_images(names, NULL, count);
+}
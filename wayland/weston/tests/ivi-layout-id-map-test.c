@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "weston-test-runner.h"
+
+#include "shared/helpers.h"
+#include "ivi-shell/ivi-layout-id-map.h"
+
+#define NUM_OBJECTS 4096
+
+struct object {
+	uint32_t id;
+};
+
+static struct object objects[NUM_OBJECTS];
+
+static uint32_t
+object_id(int i)
+{
+	/* spread ids the way controllers tend to allocate them */
+	return (i % 2) ? 0x10000 + i : 1000 * i;
+}
+
+static void
+insert_all(struct ivi_layout_id_map *map)
+{
+	int i;
+
+	for (i = 0; i < NUM_OBJECTS; i++) {
+		objects[i].id = object_id(i);
+		assert(ivi_layout_id_map_insert(map, objects[i].id,
+						&objects[i]) == 0);
+	}
+}
+
+TEST(id_map_empty)
+{
+	struct ivi_layout_id_map map;
+
+	ivi_layout_id_map_init(&map);
+
+	assert(ivi_layout_id_map_lookup(&map, 0) == NULL);
+	assert(ivi_layout_id_map_lookup(&map, 42) == NULL);
+	ivi_layout_id_map_remove(&map, 42, &objects[0]);
+	assert(map.count == 0);
+
+	ivi_layout_id_map_release(&map);
+}
+
+TEST(id_map_insert_lookup)
+{
+	struct ivi_layout_id_map map;
+	int i;
+
+	ivi_layout_id_map_init(&map);
+	insert_all(&map);
+
+	assert(map.count == NUM_OBJECTS);
+	assert((map.size & (map.size - 1)) == 0);
+	assert(map.used * 4 <= map.size * 3);
+
+	for (i = 0; i < NUM_OBJECTS; i++)
+		assert(ivi_layout_id_map_lookup(&map, object_id(i)) ==
+		       &objects[i]);
+
+	assert(ivi_layout_id_map_lookup(&map, 1) == NULL);
+	assert(ivi_layout_id_map_lookup(&map, 0x10000) == NULL);
+
+	ivi_layout_id_map_release(&map);
+}
+
+TEST(id_map_replace)
+{
+	struct ivi_layout_id_map map;
+	struct object a, b;
+
+	ivi_layout_id_map_init(&map);
+
+	assert(ivi_layout_id_map_insert(&map, 7, &a) == 0);
+	assert(ivi_layout_id_map_insert(&map, 7, &b) == 0);
+	assert(map.count == 1);
+	assert(ivi_layout_id_map_lookup(&map, 7) == &b);
+
+	/* removing the stale object must not drop the current mapping */
+	ivi_layout_id_map_remove(&map, 7, &a);
+	assert(ivi_layout_id_map_lookup(&map, 7) == &b);
+
+	ivi_layout_id_map_remove(&map, 7, &b);
+	assert(ivi_layout_id_map_lookup(&map, 7) == NULL);
+	assert(map.count == 0);
+
+	ivi_layout_id_map_release(&map);
+}
+
+TEST(id_map_remove)
+{
+	struct ivi_layout_id_map map;
+	int i;
+
+	ivi_layout_id_map_init(&map);
+	insert_all(&map);
+
+	for (i = 0; i < NUM_OBJECTS; i += 2)
+		ivi_layout_id_map_remove(&map, object_id(i), &objects[i]);
+
+	assert(map.count == NUM_OBJECTS / 2);
+
+	for (i = 0; i < NUM_OBJECTS; i++) {
+		if (i % 2)
+			assert(ivi_layout_id_map_lookup(&map, object_id(i)) ==
+			       &objects[i]);
+		else
+			assert(ivi_layout_id_map_lookup(&map, object_id(i)) ==
+			       NULL);
+	}
+
+	ivi_layout_id_map_release(&map);
+}
+
+TEST(id_map_churn)
+{
+	struct ivi_layout_id_map map;
+	uint32_t size;
+	int i, round;
+
+	ivi_layout_id_map_init(&map);
+	insert_all(&map);
+	size = map.size;
+
+	/*
+	 * Creating and destroying objects with ever new ids must not grow
+	 * the table: tombstones are dropped by rehashing in place.
+	 */
+	for (round = 1; round <= 16; round++) {
+		for (i = 0; i < NUM_OBJECTS; i++) {
+			ivi_layout_id_map_remove(&map, objects[i].id,
+						 &objects[i]);
+			objects[i].id = object_id(i) + round * 0x1000000;
+			assert(ivi_layout_id_map_insert(&map, objects[i].id,
+							&objects[i]) == 0);
+		}
+
+		assert(map.count == NUM_OBJECTS);
+		assert(map.size == size);
+		assert(map.used * 4 <= map.size * 3);
+	}
+
+	for (i = 0; i < NUM_OBJECTS; i++)
+		assert(ivi_layout_id_map_lookup(&map, objects[i].id) ==
+		       &objects[i]);
+
+	ivi_layout_id_map_release(&map);
+}
+
+static double
+elapsed_ns(const struct timespec *begin, const struct timespec *end)
+{
+	return (end->tv_sec - begin->tv_sec) * 1e9 +
+	       (end->tv_nsec - begin->tv_nsec);
+}
+
+/*
+ * Compares the lookup cost against the list walk it replaces, with as
+ * many surfaces and layers as a busy IVI system might have.
+ */
+TEST(id_map_benchmark)
+{
+	struct ivi_layout_id_map map;
+	struct timespec begin, end;
+	unsigned found = 0;
+	int i, j;
+
+	ivi_layout_id_map_init(&map);
+	insert_all(&map);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < NUM_OBJECTS; i++)
+		found += ivi_layout_id_map_lookup(&map, object_id(i)) != NULL;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	assert(found == NUM_OBJECTS);
+	printf("hash lookup: %.1f ns per id (%d objects)\n",
+	       elapsed_ns(&begin, &end) / NUM_OBJECTS, NUM_OBJECTS);
+
+	found = 0;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < NUM_OBJECTS; i++) {
+		for (j = 0; j < NUM_OBJECTS; j++) {
+			if (objects[j].id == object_id(i)) {
+				found++;
+				break;
+			}
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	assert(found == NUM_OBJECTS);
+	printf("linear scan: %.1f ns per id (%d objects)\n",
+	       elapsed_ns(&begin, &end) / NUM_OBJECTS, NUM_OBJECTS);
+
+	ivi_layout_id_map_release(&map);
+}
@@ -38,4 +38,7 @@
 
 #define IVI_TEST_SURFACE_COUNT (3)
 
+/* for tests which need a realistically busy scene */
+#define IVI_TEST_MANY_SURFACE_COUNT (512)
+
 #endif /* IVI_TEST_H */
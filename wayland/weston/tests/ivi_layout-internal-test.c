@@ -30,6 +30,7 @@
 #include <signal.h>
 #include <string.h>
 #include <stdbool.h>
+#include <time.h>
 
 #include "src/compositor.h"
 #include "ivi-shell/ivi-layout-export.h"
@@ -548,6 +549,103 @@ test_get_layer_after_destory_layer(struct test_context *ctx)
 	iassert(ivilayer == NULL);
 }
 
+static void
+test_layer_handle(struct test_context *ctx)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_layer *ivilayer;
+	uint64_t handle;
+	uint64_t new_handle;
+
+	iassert(lyt->get_handle_of_layer(NULL) == 0);
+	iassert(lyt->get_layer_from_handle(0) == NULL);
+
+	ivilayer = lyt->layer_create_with_dimension(IVI_TEST_LAYER_ID(0), 200, 300);
+	iassert(ivilayer != NULL);
+
+	handle = lyt->get_handle_of_layer(ivilayer);
+	iassert(handle != 0);
+	iassert(lyt->get_layer_from_handle(handle) == ivilayer);
+
+	lyt->layer_destroy(ivilayer);
+	iassert(lyt->get_layer_from_handle(handle) == NULL);
+
+	/* the same id must not revive a stale handle */
+	ivilayer = lyt->layer_create_with_dimension(IVI_TEST_LAYER_ID(0), 200, 300);
+	iassert(ivilayer != NULL);
+	iassert(lyt->get_layer_from_handle(handle) == NULL);
+
+	new_handle = lyt->get_handle_of_layer(ivilayer);
+	iassert(new_handle != handle);
+	iassert(lyt->get_layer_from_handle(new_handle) == ivilayer);
+
+	lyt->layer_destroy(ivilayer);
+}
+
+#define MANY_LAYER_NUM 4096
+
+static double
+elapsed_ms(const struct timespec *begin, const struct timespec *end)
+{
+	return (end->tv_sec - begin->tv_sec) * 1e3 +
+	       (end->tv_nsec - begin->tv_nsec) / 1e6;
+}
+
+static void
+test_layer_create_many(struct test_context *ctx)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_layer **ivilayers;
+	struct ivi_layout_layer **array = NULL;
+	struct timespec begin, end;
+	int32_t length = 0;
+	int i;
+
+	ivilayers = calloc(MANY_LAYER_NUM, sizeof *ivilayers);
+	if (!iassert(ivilayers != NULL))
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < MANY_LAYER_NUM; i++) {
+		ivilayers[i] = lyt->layer_create_with_dimension(
+					IVI_TEST_LAYER_ID(i), 200, 300);
+		iassert(ivilayers[i] != NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	weston_log("%d layers created in %.2f ms\n",
+		   MANY_LAYER_NUM, elapsed_ms(&begin, &end));
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < MANY_LAYER_NUM; i++)
+		iassert(lyt->get_layer_from_id(IVI_TEST_LAYER_ID(i)) == ivilayers[i]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	weston_log("%d layers looked up by id in %.2f ms\n",
+		   MANY_LAYER_NUM, elapsed_ms(&begin, &end));
+
+	iassert(lyt->get_layers(&length, &array) == IVI_SUCCEEDED);
+	iassert(length == MANY_LAYER_NUM);
+	free(array);
+
+	/* destroy every other layer, the rest must still be found */
+	for (i = 0; i < MANY_LAYER_NUM; i += 2)
+		lyt->layer_destroy(ivilayers[i]);
+
+	for (i = 0; i < MANY_LAYER_NUM; i++) {
+		if (i % 2)
+			iassert(lyt->get_layer_from_id(IVI_TEST_LAYER_ID(i)) ==
+				ivilayers[i]);
+		else
+			iassert(lyt->get_layer_from_id(IVI_TEST_LAYER_ID(i)) ==
+				NULL);
+	}
+
+	for (i = 1; i < MANY_LAYER_NUM; i += 2)
+		lyt->layer_destroy(ivilayers[i]);
+
+	lyt->commit_changes();
+	free(ivilayers);
+}
+
 static void
 test_screen_render_order(struct test_context *ctx)
 {
@@ -911,6 +1009,8 @@ run_internal_tests(void *data)
 	test_commit_changes_after_destination_rectangle_set_layer_destroy(ctx);
 	test_layer_create_duplicate(ctx);
 	test_get_layer_after_destory_layer(ctx);
+	test_layer_handle(ctx);
+	test_layer_create_many(ctx);
 
 	test_screen_render_order(ctx);
 	test_screen_bad_render_order(ctx);
@@ -31,11 +31,13 @@
 #include <signal.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 
 #include "src/compositor.h"
 #include "weston-test-server-protocol.h"
 #include "ivi-test.h"
 #include "ivi-shell/ivi-layout-export.h"
+#include "ivi-shell/ivi-layout-private.h"
 #include "shared/helpers.h"
 
 struct test_context;
@@ -356,6 +358,38 @@ RUNNER_TEST(surface_create_p2)
 	runner_assert(ivisurf == NULL);
 }
 
+/* carried from surface_handle_p1 to surface_handle_p2 */
+static uint64_t surface_handle;
+
+RUNNER_TEST(surface_handle_p1)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_surface *ivisurf;
+
+	ivisurf = lyt->get_surface_from_id(IVI_TEST_SURFACE_ID(0));
+	runner_assert(ivisurf);
+
+	surface_handle = lyt->get_handle_of_surface(ivisurf);
+	runner_assert(surface_handle != 0);
+	runner_assert(lyt->get_surface_from_handle(surface_handle) == ivisurf);
+}
+
+RUNNER_TEST(surface_handle_p2)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_surface *ivisurf;
+	uint64_t handle;
+
+	/* a new ivi_surface with the same id, the old handle is stale */
+	ivisurf = lyt->get_surface_from_id(IVI_TEST_SURFACE_ID(0));
+	runner_assert(ivisurf);
+	runner_assert(lyt->get_surface_from_handle(surface_handle) == NULL);
+
+	handle = lyt->get_handle_of_surface(ivisurf);
+	runner_assert(handle != surface_handle);
+	runner_assert(lyt->get_surface_from_handle(handle) == ivisurf);
+}
+
 RUNNER_TEST(surface_visibility)
 {
 	const struct ivi_layout_interface *lyt = ctx->layout_interface;
@@ -1014,3 +1048,222 @@ RUNNER_TEST(surface_bad_properties_changed_notification)
 	runner_assert(lyt->surface_add_listener(
 		      ivisurf, NULL) == IVI_FAILED);
 }
+
+#define INCREMENTAL_LAYER_COUNT 8
+#define INCREMENTAL_BENCH_COMMITS 1000
+
+struct view_snapshot {
+	struct weston_matrix matrix;
+	float alpha;
+	pixman_box32_t mask;
+};
+
+static struct weston_view *
+surface_view(const struct ivi_layout_interface *lyt,
+	     struct ivi_layout_surface *ivisurf)
+{
+	struct weston_surface *surface = lyt->surface_get_weston_surface(ivisurf);
+	struct weston_view *view;
+
+	view = wl_container_of(surface->views.next, view, surface_link);
+
+	return view;
+}
+
+static void
+snapshot_views(const struct ivi_layout_interface *lyt,
+	       struct ivi_layout_surface **ivisurfs,
+	       struct view_snapshot *snapshot)
+{
+	struct weston_view *view;
+	uint32_t i;
+
+	for (i = 0; i < IVI_TEST_MANY_SURFACE_COUNT; i++) {
+		view = surface_view(lyt, ivisurfs[i]);
+		weston_view_update_transform(view);
+
+		snapshot[i].matrix = view->transform.matrix;
+		snapshot[i].alpha = view->alpha;
+		snapshot[i].mask = *pixman_region32_extents(&view->geometry.scissor);
+	}
+}
+
+static void
+mark_all_dirty(struct ivi_layout_surface **ivisurfs,
+	       struct ivi_layout_layer **ivilayers)
+{
+	uint32_t i;
+
+	for (i = 0; i < INCREMENTAL_LAYER_COUNT; i++)
+		ivilayers[i]->dirty = IVI_LAYOUT_DIRTY_ALL;
+
+	for (i = 0; i < IVI_TEST_MANY_SURFACE_COUNT; i++)
+		ivisurfs[i]->dirty = IVI_LAYOUT_DIRTY_ALL;
+}
+
+/*
+ * Commits pending changes, then recomputes every view from scratch and
+ * checks that the incremental update produced exactly the same result.
+ */
+static void
+commit_and_check(struct test_context *ctx,
+		 struct ivi_layout_surface **ivisurfs,
+		 struct ivi_layout_layer **ivilayers,
+		 struct view_snapshot *incremental,
+		 struct view_snapshot *full)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	uint32_t i;
+
+	lyt->commit_changes();
+	snapshot_views(lyt, ivisurfs, incremental);
+
+	mark_all_dirty(ivisurfs, ivilayers);
+	lyt->commit_changes();
+	snapshot_views(lyt, ivisurfs, full);
+
+	for (i = 0; i < IVI_TEST_MANY_SURFACE_COUNT; i++) {
+		runner_assert(memcmp(incremental[i].matrix.d, full[i].matrix.d,
+				     sizeof full[i].matrix.d) == 0);
+		runner_assert(incremental[i].matrix.type == full[i].matrix.type);
+		runner_assert(incremental[i].alpha == full[i].alpha);
+		runner_assert(memcmp(&incremental[i].mask, &full[i].mask,
+				     sizeof full[i].mask) == 0);
+	}
+}
+
+static double
+elapsed_ms(const struct timespec *begin, const struct timespec *end)
+{
+	return (end->tv_sec - begin->tv_sec) * 1e3 +
+	       (end->tv_nsec - begin->tv_nsec) / 1e6;
+}
+
+RUNNER_TEST(incremental_commit)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_surface *ivisurfs[IVI_TEST_MANY_SURFACE_COUNT];
+	struct ivi_layout_layer *ivilayers[INCREMENTAL_LAYER_COUNT];
+	const uint32_t per_layer = IVI_TEST_MANY_SURFACE_COUNT /
+				   INCREMENTAL_LAYER_COUNT;
+	struct view_snapshot *incremental;
+	struct view_snapshot *full;
+	struct weston_output *output;
+	struct timespec begin, end;
+	uint32_t i;
+
+	incremental = zalloc(IVI_TEST_MANY_SURFACE_COUNT * sizeof *incremental);
+	full = zalloc(IVI_TEST_MANY_SURFACE_COUNT * sizeof *full);
+	runner_assert_or_return(incremental && full);
+
+	for (i = 0; i < IVI_TEST_MANY_SURFACE_COUNT; i++) {
+		ivisurfs[i] = lyt->get_surface_from_id(IVI_TEST_SURFACE_ID(i));
+		runner_assert_or_return(ivisurfs[i]);
+
+		lyt->surface_set_source_rectangle(ivisurfs[i], 0, 0, 100, 100);
+		lyt->surface_set_destination_rectangle(ivisurfs[i],
+						       (i % 16) * 40,
+						       (i / 16) * 30,
+						       160, 90);
+		lyt->surface_set_visibility(ivisurfs[i], true);
+	}
+
+	output = wl_container_of(
+		lyt->surface_get_weston_surface(ivisurfs[0])->compositor->output_list.next,
+		output, link);
+
+	for (i = 0; i < INCREMENTAL_LAYER_COUNT; i++) {
+		ivilayers[i] = lyt->layer_create_with_dimension(
+					IVI_TEST_LAYER_ID(i), 1024, 768);
+		runner_assert_or_return(ivilayers[i]);
+
+		lyt->layer_set_destination_rectangle(ivilayers[i],
+						     i * 8, i * 6, 800, 600);
+		lyt->layer_set_visibility(ivilayers[i], true);
+		lyt->layer_set_render_order(ivilayers[i],
+					    &ivisurfs[i * per_layer],
+					    per_layer);
+		lyt->screen_add_layer(output, ivilayers[i]);
+	}
+
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+
+	/* single property changes, each affecting one node or one subtree */
+	lyt->surface_set_opacity(ivisurfs[17], wl_fixed_from_double(0.5));
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+
+	lyt->surface_set_destination_rectangle(ivisurfs[100], 10, 20, 300, 200);
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+
+	lyt->surface_set_orientation(ivisurfs[200], WL_OUTPUT_TRANSFORM_90);
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+
+	lyt->surface_set_source_rectangle(ivisurfs[300], 10, 10, 50, 80);
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+
+	lyt->layer_set_opacity(ivilayers[3], wl_fixed_from_double(0.25));
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+
+	lyt->layer_set_destination_rectangle(ivilayers[5], 100, 50, 640, 480);
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+
+	lyt->layer_set_orientation(ivilayers[6], WL_OUTPUT_TRANSFORM_180);
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+
+	/* changes made while invisible must show up once visible again */
+	lyt->layer_set_visibility(ivilayers[2], false);
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+	lyt->layer_set_source_rectangle(ivilayers[2], 0, 0, 512, 384);
+	lyt->commit_changes();
+	lyt->layer_set_visibility(ivilayers[2], true);
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+
+	lyt->surface_set_visibility(ivisurfs[5], false);
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+	lyt->surface_set_destination_rectangle(ivisurfs[5], 0, 0, 50, 50);
+	lyt->commit_changes();
+	lyt->surface_set_visibility(ivisurfs[5], true);
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+
+	/* move a surface to another layer */
+	lyt->layer_remove_surface(ivilayers[0], ivisurfs[1]);
+	lyt->layer_add_surface(ivilayers[7], ivisurfs[1]);
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+
+	/* no layer property changes, but the output moves under them */
+	weston_output_move(output, output->x + 200, output->y + 100);
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+	weston_output_move(output, output->x - 200, output->y - 100);
+	commit_and_check(ctx, ivisurfs, ivilayers, incremental, full);
+
+	/* benchmark: one surface property per commit */
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < INCREMENTAL_BENCH_COMMITS; i++) {
+		lyt->surface_set_destination_rectangle(ivisurfs[i % 64],
+						       i % 200, 0, 160, 90);
+		lyt->commit_changes();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	weston_log("%d single-property commits with %d surfaces: %.2f ms\n",
+		   INCREMENTAL_BENCH_COMMITS, IVI_TEST_MANY_SURFACE_COUNT,
+		   elapsed_ms(&begin, &end));
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < INCREMENTAL_BENCH_COMMITS; i++) {
+		lyt->surface_set_destination_rectangle(ivisurfs[i % 64],
+						       i % 200, 10, 160, 90);
+		mark_all_dirty(ivisurfs, ivilayers);
+		lyt->commit_changes();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	weston_log("%d full recompute commits with %d surfaces: %.2f ms\n",
+		   INCREMENTAL_BENCH_COMMITS, IVI_TEST_MANY_SURFACE_COUNT,
+		   elapsed_ms(&begin, &end));
+
+	for (i = 0; i < INCREMENTAL_LAYER_COUNT; i++)
+		lyt->layer_destroy(ivilayers[i]);
+	lyt->commit_changes();
+
+	free(incremental);
+	free(full);
+}
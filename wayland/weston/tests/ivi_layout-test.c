@@ -255,6 +255,50 @@ TEST(ivi_layout_surface_create)
 	runner_destroy(runner);
 }
 
+TEST(ivi_layout_surface_handle)
+{
+	struct client *client;
+	struct runner *runner;
+	struct ivi_window *wnd;
+
+	client = create_client();
+	runner = client_create_runner(client);
+
+	wnd = client_create_ivi_window(client, IVI_TEST_SURFACE_ID(0));
+
+	runner_run(runner, "surface_handle_p1");
+
+	ivi_window_destroy(wnd);
+	wnd = client_create_ivi_window(client, IVI_TEST_SURFACE_ID(0));
+
+	runner_run(runner, "surface_handle_p2");
+
+	ivi_window_destroy(wnd);
+	runner_destroy(runner);
+}
+
+TEST(ivi_layout_incremental_commit)
+{
+	struct client *client;
+	struct runner *runner;
+	struct ivi_window *winds[IVI_TEST_MANY_SURFACE_COUNT];
+	int i;
+
+	client = create_client();
+	runner = client_create_runner(client);
+
+	for (i = 0; i < IVI_TEST_MANY_SURFACE_COUNT; i++)
+		winds[i] = client_create_ivi_window(client,
+						    IVI_TEST_SURFACE_ID(i));
+
+	runner_run(runner, "incremental_commit");
+
+	for (i = 0; i < IVI_TEST_MANY_SURFACE_COUNT; i++)
+		ivi_window_destroy(winds[i]);
+
+	runner_destroy(runner);
+}
+
 TEST_P(commit_changes_after_properties_set_surface_destroy, surface_property_commit_changes_test_names)
 {
 	/* an element from surface_property_commit_changes_test_names */
@@ -243,6 +243,181 @@ test(void)
 	return TEST_FAIL;
 }
 
+/* v <- m * v, by the book */
+static void
+reference_transform(const struct weston_matrix *m, struct weston_vector *v)
+{
+	struct weston_vector t;
+	int i, j;
+
+	for (i = 0; i < 4; i++) {
+		t.f[i] = 0;
+		for (j = 0; j < 4; j++)
+			t.f[i] += v->f[j] * m->d[i + j * 4];
+	}
+
+	*v = t;
+}
+
+/* inverse through the LU decomposition, whatever the matrix type */
+static int
+reference_invert(struct weston_matrix *inverse, const struct weston_matrix *m)
+{
+	struct inverse_matrix q;
+	unsigned i;
+
+	if (matrix_invert(q.LU, q.perm, m) != 0)
+		return -1;
+
+	weston_matrix_init(inverse);
+	for (i = 0; i < 4; ++i)
+		inverse_transform(q.LU, q.perm, &inverse->d[i * 4]);
+	inverse->type = m->type;
+
+	return 0;
+}
+
+/* A random matrix built like the compositor builds them, so that the
+ * type is set; types selects the transformations to use. */
+static void
+random_typed_matrix(struct weston_matrix *m, unsigned types)
+{
+	int i, k;
+	double a;
+
+	weston_matrix_init(m);
+	for (i = 0; i < 4; i++) {
+		k = random() % 3;
+		if (!(types & (1 << k)))
+			continue;
+
+		switch (1 << k) {
+		case WESTON_MATRIX_TRANSFORM_TRANSLATE:
+			weston_matrix_translate(m, 2000 * frand(),
+						2000 * frand(), frand());
+			break;
+		case WESTON_MATRIX_TRANSFORM_SCALE:
+			weston_matrix_scale(m, 0.1 + 4 * fabs(frand()),
+					    0.1 + 4 * fabs(frand()), 1);
+			break;
+		case WESTON_MATRIX_TRANSFORM_ROTATE:
+			/* half of them by multiples of 90 degrees */
+			if (random() % 2)
+				a = (random() % 4) * M_PI / 2;
+			else
+				a = M_PI * frand();
+			weston_matrix_rotate_xy(m, cos(a), sin(a));
+			break;
+		}
+	}
+}
+
+static double
+max_abs_difference(const float *a, const float *b, int n)
+{
+	double err = 0.0;
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (fabs(a[i] - b[i]) > err)
+			err = fabs(a[i] - b[i]);
+
+	return err;
+}
+
+/* Checks the fast paths against the general code, returns the number
+ * of failures. */
+static int
+test_fast_paths(void)
+{
+	struct weston_matrix m, inv, ref;
+	struct weston_vector v, w;
+	float x[8], y[8], scale;
+	double err_inv = 0.0, err_tr = 0.0, err_xy = 0.0, err;
+	int failures = 0, i, j;
+	unsigned types;
+
+	printf("\nChecking the fast paths against the general code...\n");
+
+	for (i = 0; i < 100000; i++) {
+		types = i % 8;
+		random_typed_matrix(&m, types);
+		if (i % 16 == 15) {
+			randomize_matrix(&m);
+			m.type = WESTON_MATRIX_TRANSFORM_OTHER;
+		}
+
+		/* the error grows with the size of the entries */
+		scale = 1.0;
+		for (j = 0; j < 16; j++)
+			scale = fmax(scale, fabs(m.d[j]));
+
+		if (weston_matrix_invert(&inv, &m) !=
+		    reference_invert(&ref, &m)) {
+			printf("invertible differs, type %#x\n", m.type);
+			print_matrix(&m);
+			failures++;
+			continue;
+		}
+		if (inv.type != m.type)
+			failures++;
+		if (m.type != WESTON_MATRIX_TRANSFORM_OTHER) {
+			err = max_abs_difference(inv.d, ref.d, 16) / scale;
+			err_inv = fmax(err_inv, err);
+			if (err > 1e-5) {
+				printf("inverse differs by %g, type %#x\n",
+				       err, m.type);
+				print_matrix(&m);
+				failures++;
+			}
+		}
+
+		v.f[0] = 1000 * frand();
+		v.f[1] = 1000 * frand();
+		v.f[2] = frand();
+		v.f[3] = 1.0;
+		w = v;
+		weston_matrix_transform(&m, &v);
+		reference_transform(&m, &w);
+		err = max_abs_difference(v.f, w.f, 4) / (1000 * scale);
+		err_tr = fmax(err_tr, err);
+		if (err > 1e-6) {
+			printf("transform differs by %g, type %#x\n",
+			       err, m.type);
+			failures++;
+		}
+
+		for (j = 0; j < 8; j++) {
+			x[j] = 1000 * frand();
+			y[j] = 1000 * frand();
+		}
+		v.f[0] = x[7];
+		v.f[1] = y[7];
+		v.f[2] = 0.0;
+		v.f[3] = 1.0;
+		reference_transform(&m, &v);
+		if (weston_matrix_transform_xy(&m, x, y, 8) == 0 &&
+		    fabs(v.f[3]) > 1e-3) {
+			w.f[0] = v.f[0] / v.f[3];
+			w.f[1] = v.f[1] / v.f[3];
+			err = fmax(fabs(x[7] - w.f[0]), fabs(y[7] - w.f[1])) /
+			      fmax(1.0, fmax(fabs(w.f[0]), fabs(w.f[1])));
+			err_xy = fmax(err_xy, err);
+			if (err > 1e-5) {
+				printf("transform_xy differs by %g, "
+				       "type %#x\n", err, m.type);
+				failures++;
+			}
+		}
+	}
+
+	printf("max relative error: inverse %g, transform %g, "
+	       "transform_xy %g, %d failures.\n",
+	       err_inv, err_tr, err_xy, failures);
+
+	return failures;
+}
+
 static int running;
 static void
 stopme(int n)
@@ -280,7 +455,9 @@ test_loop_speed_matrixvector(void)
 
 	printf("\nRunning 3 s test on weston_matrix_transform()...\n");
 
+	/* the general case, identity has a fast path */
 	weston_matrix_init(&m);
+	m.type = WESTON_MATRIX_TRANSFORM_OTHER;
 
 	running = 1;
 	alarm(3);
@@ -357,6 +534,7 @@ test_loop_speed_invert_explicit(void)
 	printf("\nRunning 3 s test on weston_matrix_invert()...\n");
 
 	weston_matrix_init(&m);
+	m.type = WESTON_MATRIX_TRANSFORM_OTHER;
 
 	running = 1;
 	alarm(3);
@@ -371,6 +549,73 @@ test_loop_speed_invert_explicit(void)
 	       count, t, 1e9 * t / count);
 }
 
+static void __attribute__((noinline))
+test_loop_speed_invert_affine(void)
+{
+	struct weston_matrix m;
+	unsigned long count = 0;
+	double t;
+
+	printf("\nRunning 3 s test on weston_matrix_invert(), 2D affine...\n");
+
+	weston_matrix_init(&m);
+	weston_matrix_rotate_xy(&m, 0, 1);
+	weston_matrix_translate(&m, 100, 200, 0);
+
+	running = 1;
+	alarm(3);
+	reset_timer();
+	while (running) {
+		weston_matrix_invert(&m, &m);
+		count++;
+	}
+	t = read_timer();
+
+	printf("%lu iterations in %f seconds, avg. %.1f ns/iter.\n",
+	       count, t, 1e9 * t / count);
+}
+
+/* Throughput of transforming the corners of a clipped polygon, the
+ * way the renderer does for every damaged rectangle. */
+static void __attribute__((noinline))
+test_loop_speed_transform_vertices(unsigned type, const char *name)
+{
+	struct weston_matrix m;
+	float x[8], y[8];
+	unsigned long count = 0;
+	double t;
+	int i;
+
+	printf("\nRunning 3 s test on weston_matrix_transform_xy(), "
+	       "8 vertices, %s...\n", name);
+
+	if (type & WESTON_MATRIX_TRANSFORM_OTHER)
+		randomize_matrix(&m);
+	else
+		random_typed_matrix(&m, type);
+	m.type = type;
+	for (i = 0; i < 8; i++) {
+		x[i] = i;
+		y[i] = 8 - i;
+	}
+
+	running = 1;
+	alarm(3);
+	reset_timer();
+	while (running) {
+		weston_matrix_transform_xy(&m, x, y, 8);
+		for (i = 0; i < 8; i++) {
+			x[i] = i;
+			y[i] = 8 - i;
+		}
+		count++;
+	}
+	t = read_timer();
+
+	printf("%lu iterations in %f seconds, avg. %.1f Mvertices/s.\n",
+	       count, t, 8e-6 * count / t);
+}
+
 int main(void)
 {
 	struct sigaction ding;
@@ -414,11 +659,20 @@ int main(void)
 	print_matrix(&M);
 	printf("max abs error: %g, original determinant %g\n", errsup, det);
 
+	if (test_fast_paths() != 0)
+		return 1;
+
 	test_loop_precision();
 	test_loop_speed_matrixvector();
 	test_loop_speed_inversetransform();
 	test_loop_speed_invert();
 	test_loop_speed_invert_explicit();
+	test_loop_speed_invert_affine();
+	test_loop_speed_transform_vertices(WESTON_MATRIX_TRANSFORM_TRANSLATE |
+					   WESTON_MATRIX_TRANSFORM_ROTATE,
+					   "2D affine");
+	test_loop_speed_transform_vertices(WESTON_MATRIX_TRANSFORM_OTHER,
+					   "projective");
 
 	return 0;
 }
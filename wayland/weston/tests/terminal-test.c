@@ -0,0 +1,564 @@
+/*
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Feeds escape sequences to the weston-terminal emulator core without a
+ * window and checks the cell contents, the scrollback ring and the
+ * compressed history behind it, and the dirty line tracking the
+ * renderer relies on. Also measures the parsing throughput.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "weston-test-runner.h"
+
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+#include "clients/terminal-emulator.h"
+
+static struct color_scheme test_colors = {
+	{ { 0, 0, 0, 1 } },
+	0,
+	{ 7, 0, 0, }
+};
+
+/* The frontend hooks, there is no window here */
+
+void
+terminal_resize(struct terminal *terminal, int columns, int rows)
+{
+	terminal_resize_cells(terminal, columns, rows);
+}
+
+void
+terminal_schedule_resize(struct terminal *terminal,
+			 int32_t width, int32_t height)
+{
+}
+
+void
+terminal_get_allocation(struct terminal *terminal,
+			struct rectangle *allocation)
+{
+	memset(allocation, 0, sizeof *allocation);
+}
+
+void
+terminal_set_title(struct terminal *terminal, const char *title)
+{
+}
+
+struct test_terminal {
+	struct terminal *terminal;
+	int reply;	/* reads what the terminal writes to the pty */
+};
+
+static struct terminal *
+create_terminal(struct test_terminal *tt, int width, int height,
+		int history)
+{
+	struct terminal *terminal;
+	int fds[2];
+
+	terminal = xzalloc(sizeof *terminal);
+	terminal->color_scheme = &test_colors;
+	terminal->buffer_height = TERMINAL_BUFFER_HEIGHT;
+	terminal->history.size = history;
+	terminal_init(terminal);
+	terminal->margin_top = 0;
+	terminal->margin_bottom = -1;
+	terminal->end = 1;
+	terminal_resize_cells(terminal, width, height);
+
+	assert(pipe(fds) == 0);
+	tt->reply = fds[0];
+	terminal->master = fds[1];
+	tt->terminal = terminal;
+
+	return terminal;
+}
+
+static void
+destroy_terminal(struct test_terminal *tt)
+{
+	close(tt->reply);
+	close(tt->terminal->master);
+	terminal_free_cells(tt->terminal);
+	free(tt->terminal->title);
+	free(tt->terminal);
+}
+
+static void
+feed(struct terminal *terminal, const char *s)
+{
+	terminal_data(terminal, s, strlen(s));
+}
+
+/* The text of a visible row, without the trailing blanks */
+static const char *
+row_text(struct terminal *terminal, int row)
+{
+	static char text[1024];
+	union utf8_char *data;
+	struct attr *attr;
+	int col, len = 0, end = 0, n;
+
+	terminal_get_view_row(terminal, row, &data, &attr);
+	for (col = 0; col < terminal->width; col++) {
+		n = strnlen((char *) data[col].byte, 4);
+		if (n == 0) {
+			text[len++] = ' ';
+			continue;
+		}
+		memcpy(text + len, data[col].byte, n);
+		len += n;
+		end = len;
+	}
+	text[end] = '\0';
+
+	return text;
+}
+
+static struct attr
+cell_attr(struct terminal *terminal, int row, int col)
+{
+	union utf8_char *data;
+	struct attr *attr;
+
+	terminal_get_view_row(terminal, row, &data, &attr);
+
+	return attr[col];
+}
+
+TEST(terminal_text)
+{
+	struct test_terminal tt;
+	struct terminal *terminal = create_terminal(&tt, 20, 5, 100);
+
+	feed(terminal, "hello\r\nworld");
+	assert(strcmp(row_text(terminal, 0), "hello") == 0);
+	assert(strcmp(row_text(terminal, 1), "world") == 0);
+	assert(strcmp(row_text(terminal, 2), "") == 0);
+	assert(terminal->row == 1 && terminal->column == 5);
+
+	/* wrapping at the right margin */
+	feed(terminal, "\r\n0123456789012345678901");
+	assert(strcmp(row_text(terminal, 2), "01234567890123456789") == 0);
+	assert(strcmp(row_text(terminal, 3), "01") == 0);
+
+	destroy_terminal(&tt);
+}
+
+TEST(terminal_erase)
+{
+	struct test_terminal tt;
+	struct terminal *terminal = create_terminal(&tt, 20, 5, 100);
+	int row;
+
+	feed(terminal, "abcdef\r\nghijkl\x1b[1;3H\x1b[K");
+	assert(strcmp(row_text(terminal, 0), "ab") == 0);
+	assert(strcmp(row_text(terminal, 1), "ghijkl") == 0);
+
+	feed(terminal, "\x1b[2;4H\x1b[1K");
+	assert(strcmp(row_text(terminal, 1), "    kl") == 0);
+
+	feed(terminal, "\x1b[2J");
+	for (row = 0; row < terminal->height; row++)
+		assert(strcmp(row_text(terminal, row), "") == 0);
+
+	destroy_terminal(&tt);
+}
+
+TEST(terminal_decaln_after_scroll)
+{
+	struct test_terminal tt;
+	struct terminal *terminal = create_terminal(&tt, 20, 5, 100);
+	union utf8_char *data;
+	struct attr *attr;
+	char line[64];
+	uint32_t id;
+	int i, row;
+
+	/* past the end of the ring, so the screen starts mid-buffer */
+	for (i = 0; i < TERMINAL_BUFFER_HEIGHT + 100; i++) {
+		snprintf(line, sizeof line, "line %d\r\n", i);
+		feed(terminal, line);
+	}
+	assert(terminal->start % TERMINAL_BUFFER_HEIGHT != 0);
+
+	terminal_clear_dirty(terminal);
+	feed(terminal, "\x1b#8");
+	for (row = 0; row < terminal->height; row++) {
+		assert(strcmp(row_text(terminal, row),
+			      "EEEEEEEEEEEEEEEEEEEE") == 0);
+		id = terminal_get_view_row(terminal, row, &data, &attr);
+		assert(terminal_line_is_dirty(terminal, id));
+	}
+
+	/* the scrollback above the screen is left alone */
+	terminal_scroll_view(terminal, 1);
+	snprintf(line, sizeof line, "line %d", TERMINAL_BUFFER_HEIGHT + 95);
+	assert(strcmp(row_text(terminal, 0), line) == 0);
+	assert(strcmp(row_text(terminal, 1),
+		      "EEEEEEEEEEEEEEEEEEEE") == 0);
+
+	destroy_terminal(&tt);
+}
+
+TEST(terminal_reverse_scroll_selection)
+{
+	struct test_terminal tt;
+	struct terminal *terminal = create_terminal(&tt, 20, 5, 100);
+
+	feed(terminal, "a\r\nb\r\nc\r\nd\r\ne");
+	terminal->selection_start_row = 1;
+	terminal->selection_end_row = 2;
+
+	/* RI at the top row moves the screen down by one */
+	feed(terminal, "\x1b[1;1H\x1bM");
+	assert(strcmp(row_text(terminal, 0), "") == 0);
+	assert(terminal->selection_start_row == 2);
+	assert(terminal->selection_end_row == 3);
+	assert(strcmp(row_text(terminal, 2), "b") == 0);
+	assert(strcmp(row_text(terminal, 3), "c") == 0);
+
+	/* SD by two, then SU by one */
+	feed(terminal, "\x1b[2T");
+	assert(terminal->selection_start_row == 4);
+	assert(strcmp(row_text(terminal, 4), "b") == 0);
+	feed(terminal, "\x1b[S");
+	assert(terminal->selection_start_row == 3);
+	assert(terminal->selection_end_row == 4);
+	assert(strcmp(row_text(terminal, 2), "a") == 0);
+	assert(strcmp(row_text(terminal, 3), "b") == 0);
+
+	destroy_terminal(&tt);
+}
+
+TEST(terminal_erase_display_after_scroll_up)
+{
+	struct test_terminal tt;
+	struct terminal *terminal = create_terminal(&tt, 20, 5, 100);
+	int row;
+
+	/* SU moves the screen past the last written line, so the used
+	 * part of the screen is empty when ED 2 comes */
+	feed(terminal, "a\r\nb\x1b[3S");
+	assert(terminal->scrollback == 3);
+	terminal->selection_start_row = 1;
+	terminal->selection_end_row = 1;
+
+	feed(terminal, "\x1b[2J");
+	for (row = 0; row < terminal->height; row++)
+		assert(strcmp(row_text(terminal, row), "") == 0);
+	assert(terminal->scrollback == 3);
+	assert(terminal->selection_start_row == 1);
+
+	assert(terminal_scroll_view(terminal, 100) == 3);
+	assert(strcmp(row_text(terminal, 0), "a") == 0);
+	assert(strcmp(row_text(terminal, 1), "b") == 0);
+	assert(strcmp(row_text(terminal, 2), "") == 0);
+
+	destroy_terminal(&tt);
+}
+
+TEST(terminal_scroll_region)
+{
+	struct test_terminal tt;
+	struct terminal *terminal = create_terminal(&tt, 20, 10, 100);
+	static const char *const inserted[] = {
+		"0", "1", "", "2", "3", "4", "6", "7", "8", "9"
+	};
+	static const char *const deleted[] = {
+		"0", "1", "2", "3", "4", "", "6", "7", "8", "9"
+	};
+	int row;
+
+	feed(terminal, "0\r\n1\r\n2\r\n3\r\n4\r\n5\r\n6\r\n7\r\n8\r\n9");
+
+	/* rows 3 to 6, insert a line at the top of the region */
+	feed(terminal, "\x1b[3;6r\x1b[3;1H\x1b[L");
+	for (row = 0; row < terminal->height; row++)
+		assert(strcmp(row_text(terminal, row), inserted[row]) == 0);
+
+	feed(terminal, "\x1b[M");
+	for (row = 0; row < terminal->height; row++)
+		assert(strcmp(row_text(terminal, row), deleted[row]) == 0);
+
+	/* a line feed at the bottom of the region only scrolls the
+	 * region and leaves nothing in the scrollback */
+	feed(terminal, "\x1b[6;1Hx\n");
+	assert(strcmp(row_text(terminal, 1), "1") == 0);
+	assert(strcmp(row_text(terminal, 2), "3") == 0);
+	assert(strcmp(row_text(terminal, 4), "x") == 0);
+	assert(strcmp(row_text(terminal, 5), "") == 0);
+	assert(strcmp(row_text(terminal, 6), "6") == 0);
+	assert(terminal_scroll_view(terminal, 1) == 0);
+
+	destroy_terminal(&tt);
+}
+
+TEST(terminal_scrollback_history)
+{
+	struct test_terminal tt;
+	struct terminal *terminal = create_terminal(&tt, 20, 5, 3000);
+	char line[64];
+	int i, n = 2000;
+
+	for (i = 0; i < n; i++) {
+		if (i == 7)
+			snprintf(line, sizeof line,
+				 "\x1b[31mline %d\x1b[0m\r\n", i);
+		else
+			snprintf(line, sizeof line, "line %d\r\n", i);
+		feed(terminal, line);
+	}
+
+	/* the ring keeps a screen less than its height, older lines
+	 * went to the history */
+	assert(terminal->scrollback ==
+	       TERMINAL_BUFFER_HEIGHT - (uint32_t) terminal->height);
+	assert(terminal->history.count ==
+	       n - 4 - terminal->scrollback);
+
+	assert(terminal_scroll_view(terminal, 100000) == n - 4);
+	assert(strcmp(row_text(terminal, 0), "line 0") == 0);
+	assert(strcmp(row_text(terminal, 4), "line 4") == 0);
+
+	terminal_scroll_view(terminal, -7);
+	assert(strcmp(row_text(terminal, 0), "line 7") == 0);
+	assert(cell_attr(terminal, 0, 0).fg == 1);
+	assert(cell_attr(terminal, 0, 5).fg == 1);
+	assert(cell_attr(terminal, 0, 6).fg == 7);
+	assert(cell_attr(terminal, 1, 0).fg == 7);
+
+	/* across the boundary between the history and the ring */
+	terminal_scroll_view(terminal, -(int) terminal->view +
+			     (int) terminal->scrollback + 2);
+	assert(strcmp(row_text(terminal, 0), "line 975") == 0);
+	assert(strcmp(row_text(terminal, 1), "line 976") == 0);
+	assert(strcmp(row_text(terminal, 2), "line 977") == 0);
+	assert(strcmp(row_text(terminal, 4), "line 979") == 0);
+
+	assert(terminal_scroll_view(terminal, -100000) < 0);
+	assert(terminal->view == 0);
+	assert(strcmp(row_text(terminal, 3), "line 1999") == 0);
+
+	destroy_terminal(&tt);
+}
+
+TEST(terminal_output_snaps_view)
+{
+	struct test_terminal tt;
+	struct terminal *terminal = create_terminal(&tt, 20, 5, 100);
+	char line[64];
+	int i;
+
+	for (i = 0; i < 20; i++) {
+		snprintf(line, sizeof line, "line %d\r\n", i);
+		feed(terminal, line);
+	}
+
+	/* select the line shown on the top row of a view 6 lines back */
+	assert(terminal_scroll_view(terminal, 6) == 6);
+	assert(strcmp(row_text(terminal, 0), "line 10") == 0);
+	terminal->selection_start_row = 0;
+	terminal->selection_end_row = 0;
+
+	/* output without a line feed still brings the view back */
+	feed(terminal, "more");
+	assert(terminal->view == 0);
+	assert(strcmp(row_text(terminal, 4), "more") == 0);
+	assert(terminal->selection_start_row == -6);
+	assert(terminal->selection_end_row == -6);
+
+	/* and a scroll moves the selection along with the lines */
+	assert(terminal_scroll_view(terminal, 3) == 3);
+	feed(terminal, "\r\nnext\r\n");
+	assert(terminal->view == 0);
+	assert(strcmp(row_text(terminal, 2), "more") == 0);
+	assert(strcmp(row_text(terminal, 3), "next") == 0);
+	assert(terminal->selection_start_row == -8);
+	terminal_scroll_view(terminal, 8);
+	assert(strcmp(row_text(terminal, terminal->selection_start_row),
+		      "line 10") == 0);
+
+	destroy_terminal(&tt);
+}
+
+TEST(terminal_history_limit)
+{
+	struct test_terminal tt;
+	struct terminal *terminal = create_terminal(&tt, 20, 5, 100);
+	char line[64];
+	int i;
+
+	for (i = 0; i < 3000; i++) {
+		snprintf(line, sizeof line, "line %d\r\n", i);
+		feed(terminal, line);
+	}
+
+	assert(terminal->history.count == 100);
+	assert(terminal_scroll_view(terminal, 100000) ==
+	       (int) terminal->scrollback + 100);
+	snprintf(line, sizeof line, "line %d",
+		 3000 - 4 - (int) terminal->scrollback - 100);
+	assert(strcmp(row_text(terminal, 0), line) == 0);
+
+	destroy_terminal(&tt);
+}
+
+TEST(terminal_dirty_lines)
+{
+	struct test_terminal tt;
+	struct terminal *terminal = create_terminal(&tt, 20, 5, 100);
+	union utf8_char *data;
+	struct attr *attr;
+	uint32_t line[5], moved;
+	int row;
+
+	feed(terminal, "a\r\nb\r\nc\r\nd\r\ne");
+	terminal_clear_dirty(terminal);
+	for (row = 0; row < 5; row++) {
+		line[row] = terminal_get_view_row(terminal, row, &data, &attr);
+		assert(!terminal_line_is_dirty(terminal, line[row]));
+	}
+
+	feed(terminal, "\x1b[3;1Hx");
+	assert(terminal_line_is_dirty(terminal, line[2]));
+	assert(!terminal_line_is_dirty(terminal, line[1]));
+	assert(!terminal_line_is_dirty(terminal, line[3]));
+
+	/* scrolling moves the lines up without touching them */
+	terminal_clear_dirty(terminal);
+	feed(terminal, "\x1b[5;1H\n");
+	for (row = 0; row < 4; row++) {
+		moved = terminal_get_view_row(terminal, row, &data, &attr);
+		assert(moved == line[row + 1]);
+		assert(!terminal_line_is_dirty(terminal, moved));
+	}
+	moved = terminal_get_view_row(terminal, 4, &data, &attr);
+	assert(terminal_line_is_dirty(terminal, moved));
+
+	destroy_terminal(&tt);
+}
+
+TEST(terminal_cursor_report)
+{
+	struct test_terminal tt;
+	struct terminal *terminal = create_terminal(&tt, 20, 5, 100);
+	char reply[32];
+	int len;
+
+	feed(terminal, "\x1b[3;5H\x1b[6n");
+	len = read(tt.reply, reply, sizeof reply - 1);
+	assert(len > 0);
+	reply[len] = '\0';
+	assert(strcmp(reply, "\x1b[3;5R") == 0);
+
+	destroy_terminal(&tt);
+}
+
+TEST(terminal_resize_keeps_scrollback)
+{
+	struct test_terminal tt;
+	struct terminal *terminal = create_terminal(&tt, 20, 5, 100);
+	char line[64];
+	int i;
+
+	for (i = 0; i < 50; i++) {
+		snprintf(line, sizeof line, "line %d\r\n", i);
+		feed(terminal, line);
+	}
+	assert(strcmp(row_text(terminal, 3), "line 49") == 0);
+
+	/* taller, the rows come back from the scrollback */
+	terminal_resize_cells(terminal, 20, 10);
+	assert(strcmp(row_text(terminal, terminal->row - 1), "line 49") == 0);
+	assert(strcmp(row_text(terminal, terminal->row - 9), "line 41") == 0);
+
+	/* wider, the cells are reallocated */
+	terminal_resize_cells(terminal, 30, 10);
+	assert(strcmp(row_text(terminal, terminal->row - 1), "line 49") == 0);
+	terminal_scroll_view(terminal, 100000);
+	assert(strcmp(row_text(terminal, 0), "line 0") == 0);
+	terminal_scroll_view(terminal, -100000);
+
+	/* shorter again */
+	terminal_resize_cells(terminal, 30, 5);
+	assert(strcmp(row_text(terminal, terminal->row - 1), "line 49") == 0);
+	terminal_scroll_view(terminal, 100000);
+	assert(strcmp(row_text(terminal, 0), "line 0") == 0);
+
+	destroy_terminal(&tt);
+}
+
+static double
+elapsed(const struct timespec *begin, const struct timespec *end)
+{
+	return end->tv_sec - begin->tv_sec +
+		(end->tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+TEST(terminal_data_benchmark)
+{
+	struct test_terminal tt;
+	struct terminal *terminal = create_terminal(&tt, 80, 24, 10000);
+	struct timespec begin, end;
+	char *buffer;
+	size_t size = 4 << 20, len = 0;
+	int i = 0;
+
+	buffer = xmalloc(size + 128);
+	while (len < size) {
+		if (i % 8 == 0)
+			len += sprintf(buffer + len,
+				       "\x1b[1;3%dmbuild\x1b[0m: step %d of "
+				       "the compilation of a rather long "
+				       "file name.c\r\n", i % 8, i);
+		else
+			len += sprintf(buffer + len,
+				       "  CC       src/module-%d.lo\r\n", i);
+		i++;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	terminal_data(terminal, buffer, len);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	fprintf(stderr, "%.1f MB of output parsed at %.1f MB/s, "
+		"%u lines in the history\n", len / 1e6,
+		len / 1e6 / elapsed(&begin, &end), terminal->history.count);
+
+	free(buffer);
+	destroy_terminal(&tt);
+}
@@ -0,0 +1,418 @@
+/*
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Runs repaint loops on the headless backend with the timeline enabled,
+ * checks that the binary log holds every point with its objects described
+ * before use, checks the frame statistics, and measures what tracing
+ * costs per repaint.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "src/compositor.h"
+#include "src/frame-stats.h"
+#include "src/timeline.h"
+#include "src/timeline-binary.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+
+#define REPAINTS 500
+#define BENCH_FRAMES 2000
+#define MAX_IDS 256
+
+struct test {
+	struct weston_compositor *compositor;
+	struct weston_output *output;
+	struct weston_layer layer;
+	struct weston_surface *surface;
+	char dir[64];
+};
+
+struct log_summary {
+	char *names[MAX_IDS];		/* by id */
+	bool described[MAX_IDS];	/* output and surface ids */
+	uint32_t output_id;
+	int begin;
+	int posted;
+	int finished;
+	int flush_damage;
+	uint32_t dropped;
+	uint64_t last_time[16];		/* by thread */
+};
+
+static struct test test;
+
+/* Same as in view-list-test: a frame that finished one refresh period
+ * ago makes weston_output_finish_frame() repaint right away.
+ */
+static void
+repaint(struct test *t)
+{
+	struct weston_output *output = t->output;
+	int64_t refresh = millihz_to_nsec(output->current_mode->refresh);
+	struct timespec now, period, stamp;
+
+	weston_compositor_read_presentation_clock(t->compositor, &now);
+	period.tv_sec = refresh / NSEC_PER_SEC;
+	period.tv_nsec = refresh % NSEC_PER_SEC;
+	timespec_sub(&stamp, &now, &period);
+
+	weston_surface_damage(t->surface);
+	output->repaint_needed = 1;
+	weston_output_finish_frame(output, &stamp, 0);
+	assert(!output->repaint_needed);
+}
+
+static void
+create_scene(struct test *t)
+{
+	struct weston_view *view;
+
+	weston_layer_init(&t->layer, &t->compositor->layer_list);
+
+	t->surface = weston_surface_create(t->compositor);
+	assert(t->surface);
+	view = weston_view_create(t->surface);
+	assert(view);
+
+	t->surface->width = 64;
+	t->surface->height = 64;
+	weston_view_set_position(view, 10, 10);
+	weston_layer_entry_insert(&t->layer.view_list, &view->layer_link);
+}
+
+static void
+destroy_scene(struct test *t)
+{
+	weston_surface_destroy(t->surface);
+	wl_list_remove(&t->layer.link);
+}
+
+/* the name of the single timeline log in the current directory */
+static char *
+find_log(void)
+{
+	DIR *dir;
+	struct dirent *ent;
+	char *name = NULL;
+
+	dir = opendir(".");
+	assert(dir);
+
+	while ((ent = readdir(dir))) {
+		if (!strstr(ent->d_name, ".wtl"))
+			continue;
+
+		assert(!name);
+		name = strdup(ent->d_name);
+	}
+	closedir(dir);
+
+	assert(name);
+
+	return name;
+}
+
+static const char *
+record_string(const struct weston_timeline_record *rec, size_t offset)
+{
+	const char *str = (const char *)rec + offset;
+
+	assert(offset < rec->size);
+	assert(memchr(str, '\0', rec->size - offset));
+
+	return str;
+}
+
+static void
+check_point(struct log_summary *s, uint32_t thread,
+	    const struct weston_timeline_point_record *pt)
+{
+	const char *name;
+
+	assert(pt->base.size >= sizeof *pt);
+	assert(pt->base.id < MAX_IDS && s->names[pt->base.id]);
+	name = s->names[pt->base.id];
+
+	/* objects are described before the first point using them */
+	if (pt->output)
+		assert(pt->output < MAX_IDS && s->described[pt->output]);
+	if (pt->surface)
+		assert(pt->surface < MAX_IDS && s->described[pt->surface]);
+
+	/* a thread records in order */
+	assert(thread < ARRAY_LENGTH(s->last_time));
+	assert(pt->time >= s->last_time[thread]);
+	s->last_time[thread] = pt->time;
+
+	if (strcmp(name, "core_repaint_begin") == 0) {
+		assert(pt->output == s->output_id);
+		assert(s->begin == s->posted);
+		s->begin++;
+	} else if (strcmp(name, "core_repaint_posted") == 0) {
+		assert(pt->output == s->output_id);
+		s->posted++;
+		assert(s->begin == s->posted);
+	} else if (strcmp(name, "core_repaint_finished") == 0) {
+		assert(pt->output == s->output_id);
+		assert(pt->vblank != WESTON_TIMELINE_NO_VBLANK);
+		s->finished++;
+	} else if (strcmp(name, "core_flush_damage") == 0) {
+		assert(pt->surface != 0);
+		s->flush_damage++;
+	}
+}
+
+static void
+check_records(struct log_summary *s, uint32_t thread,
+	      const uint8_t *data, uint32_t size)
+{
+	const struct weston_timeline_record *rec;
+	const struct weston_timeline_surface_record *srec;
+	const char *str;
+	uint32_t pos;
+
+	for (pos = 0; pos < size; pos += rec->size) {
+		rec = (const struct weston_timeline_record *)(data + pos);
+		assert(rec->size >= sizeof *rec && rec->size % 8 == 0);
+		assert(rec->size <= size - pos);
+
+		switch (rec->type) {
+		case WESTON_TIMELINE_RECORD_NAME:
+			assert(rec->id < MAX_IDS && !s->names[rec->id]);
+			s->names[rec->id] = strdup(record_string(rec,
+								 sizeof *rec));
+			break;
+		case WESTON_TIMELINE_RECORD_OUTPUT:
+			str = record_string(rec, sizeof *rec);
+			assert(rec->id < MAX_IDS);
+			if (strcmp(str, test.output->name) == 0)
+				s->output_id = rec->id;
+			s->described[rec->id] = true;
+			break;
+		case WESTON_TIMELINE_RECORD_SURFACE:
+			srec = (const struct weston_timeline_surface_record *)
+				rec;
+			record_string(rec, sizeof *srec);
+			assert(rec->id < MAX_IDS);
+			assert(!srec->main_surface ||
+			       s->described[srec->main_surface]);
+			s->described[rec->id] = true;
+			break;
+		case WESTON_TIMELINE_RECORD_POINT:
+			check_point(s, thread,
+				    (const struct weston_timeline_point_record *)
+				    rec);
+			break;
+		default:
+			assert(0 && "unexpected record type");
+		}
+	}
+}
+
+static void
+check_log(const char *filename)
+{
+	struct weston_timeline_file_header header;
+	struct weston_timeline_chunk chunk;
+	struct log_summary s;
+	uint8_t *data;
+	FILE *fp;
+	int i;
+
+	memset(&s, 0, sizeof s);
+
+	fp = fopen(filename, "rb");
+	assert(fp);
+
+	assert(fread(&header, sizeof header, 1, fp) == 1);
+	assert(header.magic == WESTON_TIMELINE_MAGIC);
+	assert(header.version == WESTON_TIMELINE_VERSION);
+
+	while (fread(&chunk, sizeof chunk, 1, fp) == 1) {
+		assert(chunk.type == WESTON_TIMELINE_CHUNK_RECORDS);
+		s.dropped += chunk.dropped;
+
+		data = malloc(chunk.size);
+		assert(data || chunk.size == 0);
+		assert(fread(data, 1, chunk.size, fp) == chunk.size);
+		check_records(&s, chunk.thread, data, chunk.size);
+		free(data);
+	}
+	assert(feof(fp));
+	fclose(fp);
+
+	fprintf(stderr, "log: %d repaints, %d finished, %d damage flushes\n",
+		s.begin, s.finished, s.flush_damage);
+
+	assert(s.dropped == 0);
+	assert(s.output_id != 0);
+	assert(s.begin == REPAINTS);
+	assert(s.posted == REPAINTS);
+	assert(s.finished == REPAINTS);
+	assert(s.flush_damage >= REPAINTS);
+
+	for (i = 0; i < MAX_IDS; i++)
+		free(s.names[i]);
+}
+
+static void
+check_frame_stats(struct test *t)
+{
+	struct weston_frame_stats *stats = t->output->frame_stats;
+	struct weston_frame_histogram *h;
+	uint32_t sum;
+	int i, j;
+
+	assert(stats);
+
+	/* a repaint per frame; the first frame was presented before any
+	 * repaint was submitted and without a previous presentation */
+	assert(stats->stage[WESTON_FRAME_STAGE_REPAINT].samples == REPAINTS);
+	assert(stats->stage[WESTON_FRAME_STAGE_LATENCY].samples ==
+	       REPAINTS - 1);
+	assert(stats->stage[WESTON_FRAME_STAGE_INTERVAL].samples ==
+	       REPAINTS - 1);
+
+	for (i = 0; i < WESTON_FRAME_STAGE_COUNT; i++) {
+		h = &stats->stage[i];
+
+		sum = 0;
+		for (j = 0; j < WESTON_FRAME_STATS_BUCKETS; j++)
+			sum += h->buckets[j];
+		assert(sum == h->samples);
+		assert(h->min_nsec <= h->max_nsec);
+		assert(h->sum_nsec >= h->min_nsec * h->samples);
+
+		fprintf(stderr, "stage %d: %u samples, %.1f us mean, "
+			"%.1f us max\n", i, h->samples,
+			h->sum_nsec / 1e3 / h->samples, h->max_nsec / 1e3);
+	}
+}
+
+static double
+elapsed_us(const struct timespec *begin, const struct timespec *end)
+{
+	return (end->tv_sec - begin->tv_sec) * 1e6 +
+	       (end->tv_nsec - begin->tv_nsec) / 1e3;
+}
+
+static double
+bench(struct test *t)
+{
+	struct timespec begin, end;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < BENCH_FRAMES; i++)
+		repaint(t);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return elapsed_us(&begin, &end) / BENCH_FRAMES;
+}
+
+static void
+remove_log(void)
+{
+	char *name = find_log();
+
+	unlink(name);
+	free(name);
+}
+
+static void
+timeline_test(void *data)
+{
+	struct test *t = data;
+	char *name;
+	double off, on;
+	int i;
+
+	t->output = container_of(t->compositor->output_list.next,
+				 struct weston_output, link);
+
+	/* the log is written to the current directory */
+	snprintf(t->dir, sizeof t->dir, "timeline-test-XXXXXX");
+	assert(mkdtemp(t->dir));
+	assert(chdir(t->dir) == 0);
+
+	create_scene(t);
+	repaint(t);
+
+	weston_frame_stats_loop_idle(t->output->frame_stats);
+	weston_frame_stats_reset(t->output->frame_stats);
+
+	weston_timeline_open(t->compositor);
+	assert(weston_timeline_enabled_);
+	for (i = 0; i < REPAINTS; i++)
+		repaint(t);
+	weston_timeline_close();
+
+	check_frame_stats(t);
+
+	name = find_log();
+	check_log(name);
+	unlink(name);
+	free(name);
+
+	off = bench(t);
+	weston_timeline_open(t->compositor);
+	on = bench(t);
+	weston_timeline_close();
+	remove_log();
+
+	fprintf(stderr, "repaint: %.2f us untraced, %.2f us traced, "
+		"%.2f us overhead\n", off, on, on - off);
+
+	destroy_scene(t);
+
+	assert(chdir("..") == 0);
+	assert(rmdir(t->dir) == 0);
+
+	wl_display_terminate(t->compositor->wl_display);
+}
+
+WL_EXPORT int
+module_init(struct weston_compositor *compositor, int *argc, char *argv[])
+{
+	struct wl_event_loop *loop;
+
+	test.compositor = compositor;
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+
+	wl_event_loop_add_idle(loop, timeline_test, &test);
+
+	return 0;
+}
@@ -26,7 +26,11 @@
 #include "config.h"
 
 #include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "weston-test-runner.h"
 
@@ -221,3 +225,214 @@ TEST(float_difference_same)
 	assert(float_difference(1.0f, 1.0f) == 0.0f);
 }
 
+
+/* What the gl-renderer did for each quad before clip_quads(). */
+static int
+reference_clip_quad(struct clip_context *ctx, const struct clip_quad *quad,
+		    int transformed, float *ex, float *ey)
+{
+	struct polygon8 polygon;
+	float min_x, max_x, min_y, max_y;
+	int i, n;
+
+	memcpy(polygon.x, quad->x, sizeof quad->x);
+	memcpy(polygon.y, quad->y, sizeof quad->y);
+	polygon.n = 4;
+
+	min_x = max_x = polygon.x[0];
+	min_y = max_y = polygon.y[0];
+	for (i = 1; i < 4; i++) {
+		min_x = fminf(min_x, polygon.x[i]);
+		max_x = fmaxf(max_x, polygon.x[i]);
+		min_y = fminf(min_y, polygon.y[i]);
+		max_y = fmaxf(max_y, polygon.y[i]);
+	}
+
+	if ((min_x >= ctx->clip.x2) || (max_x <= ctx->clip.x1) ||
+	    (min_y >= ctx->clip.y2) || (max_y <= ctx->clip.y1))
+		return 0;
+
+	if (!transformed)
+		return clip_simple(ctx, &polygon, ex, ey);
+
+	n = clip_transformed(ctx, &polygon, ex, ey);
+
+	return n < 3 ? 0 : n;
+}
+
+/* Same polygon, maybe starting from another vertex. */
+static int
+same_polygon(const float *ax, const float *ay,
+	     const float *bx, const float *by, int n)
+{
+	int start, i;
+
+	for (start = 0; start < n; start++) {
+		for (i = 0; i < n; i++)
+			if (ax[i] != bx[(start + i) % n] ||
+			    ay[i] != by[(start + i) % n])
+				break;
+		if (i == n)
+			return 1;
+	}
+
+	return 0;
+}
+
+static float
+frand(float scale)
+{
+	return scale * (random() / (float) RAND_MAX);
+}
+
+/* Surface rectangles, moved and maybe turned by a random angle: a
+ * multiple of 90 degrees half of the time, and rounded to integers
+ * then, so that some come out axis aligned. */
+static void
+random_quads(struct clip_quad *quads, int n, int *transformed)
+{
+	float a, c, s, tx, ty, x1, y1, x2, y2, x, y;
+	int i, k, rounded;
+
+	*transformed = random() % 4 != 0;
+	rounded = random() % 2;
+	a = rounded ? (random() % 4) * M_PI / 2 : frand(2 * M_PI);
+	c = cosf(a);
+	s = sinf(a);
+	tx = frand(400) - 100;
+	ty = frand(400) - 100;
+	if (!*transformed) {
+		c = 1;
+		s = 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		x1 = floorf(frand(200));
+		y1 = floorf(frand(200));
+		x2 = x1 + 1 + floorf(frand(100));
+		y2 = y1 + 1 + floorf(frand(100));
+
+		quads[i].x[0] = quads[i].x[3] = x1;
+		quads[i].x[1] = quads[i].x[2] = x2;
+		quads[i].y[0] = quads[i].y[1] = y1;
+		quads[i].y[2] = quads[i].y[3] = y2;
+
+		for (k = 0; k < 4; k++) {
+			x = c * quads[i].x[k] - s * quads[i].y[k] + tx;
+			y = s * quads[i].x[k] + c * quads[i].y[k] + ty;
+			if (rounded) {
+				x = roundf(x);
+				y = roundf(y);
+			}
+			quads[i].x[k] = x;
+			quads[i].y[k] = y;
+		}
+	}
+}
+
+static void
+random_clip(struct clip_context *ctx)
+{
+	ctx->clip.x1 = floorf(frand(300)) - 50;
+	ctx->clip.y1 = floorf(frand(300)) - 50;
+	ctx->clip.x2 = ctx->clip.x1 + 1 + floorf(frand(200));
+	ctx->clip.y2 = ctx->clip.y1 + 1 + floorf(frand(200));
+}
+
+TEST(clip_quads_matches_scalar)
+{
+	struct clip_quad quads[23];
+	struct clip_context ctx;
+	struct clip_arena arena;
+	float ex[8], ey[8];
+	int iteration, i, j, n, transformed, first, polygons = 0;
+
+	srandom(42);
+	clip_arena_init(&arena);
+
+	for (iteration = 0; iteration < 20000; iteration++) {
+		n = 1 + random() % ARRAY_LENGTH(quads);
+		random_quads(quads, n, &transformed);
+		random_clip(&ctx);
+
+		clip_arena_reset(&arena);
+		assert(clip_quads(&ctx, quads, n, transformed, &arena) ==
+		       arena.npolygons);
+
+		j = 0;
+		first = 0;
+		for (i = 0; i < n; i++) {
+			int m = reference_clip_quad(&ctx, &quads[i],
+						    transformed, ex, ey);
+			if (m == 0)
+				continue;
+
+			assert(j < arena.npolygons);
+			assert(arena.quad[j] == i);
+			assert(arena.n[j] == m);
+			assert(same_polygon(ex, ey, arena.x + first,
+					    arena.y + first, m));
+			first += m;
+			j++;
+		}
+		assert(j == arena.npolygons);
+		assert(first == arena.nvertices);
+		polygons += j;
+	}
+
+	/* the comparison is not vacuous */
+	assert(polygons > 10000);
+
+	clip_arena_release(&arena);
+}
+
+static double
+seconds_since(const struct timespec *begin)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - begin->tv_sec) +
+	       (now.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+TEST(clip_quads_benchmark)
+{
+	struct clip_quad quads[64];
+	struct clip_context ctx;
+	struct clip_arena arena;
+	struct timespec begin;
+	float ex[8], ey[8];
+	int i, k, transformed, sink = 0, rounds = 20000;
+	double scalar, batched;
+
+	srandom(7);
+	clip_arena_init(&arena);
+	do {
+		random_quads(quads, ARRAY_LENGTH(quads), &transformed);
+	} while (!transformed);
+	random_clip(&ctx);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (k = 0; k < rounds; k++)
+		for (i = 0; i < (int) ARRAY_LENGTH(quads); i++)
+			sink += reference_clip_quad(&ctx, &quads[i], 1,
+						    ex, ey);
+	scalar = seconds_since(&begin);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (k = 0; k < rounds; k++) {
+		clip_arena_reset(&arena);
+		clip_quads(&ctx, quads, ARRAY_LENGTH(quads), 1, &arena);
+		sink -= arena.nvertices;
+	}
+	batched = seconds_since(&begin);
+
+	assert(sink == 0);
+	fprintf(stderr, "transformed quads: %.1f Mquads/s one by one, "
+		"%.1f Mquads/s batched\n",
+		rounds * ARRAY_LENGTH(quads) / scalar / 1e6,
+		rounds * ARRAY_LENGTH(quads) / batched / 1e6);
+
+	clip_arena_release(&arena);
+}
@@ -0,0 +1,427 @@
+/*
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Checks that reusing the view list and the clip regions between
+ * repaints gives the same damage as rebuilding them on every repaint,
+ * and measures what the reuse saves with a few hundred views.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "src/compositor.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+
+#define NUM_VIEWS 400
+#define BENCH_FRAMES 200
+
+struct test {
+	struct weston_compositor *compositor;
+	struct weston_output *output;
+	int (*repaint)(struct weston_output *output,
+		       pixman_region32_t *damage);
+	pixman_region32_t damage;	/* of the last repaint */
+
+	struct weston_layer layer;
+	struct weston_surface *backdrop;
+	struct weston_surface *surfaces[NUM_VIEWS];
+	struct weston_view *views[NUM_VIEWS];
+
+	/* saved by the operations to undo themselves */
+	struct weston_view *above;
+};
+
+struct snapshot {
+	struct weston_view *order[NUM_VIEWS];
+	int count;
+	pixman_region32_t clip[NUM_VIEWS];
+};
+
+static struct test test;
+
+static int
+recording_repaint(struct weston_output *output, pixman_region32_t *damage)
+{
+	pixman_region32_copy(&test.damage, damage);
+
+	return test.repaint(output, damage);
+}
+
+/* Repaints synchronously: a frame that finished one refresh period ago
+ * makes weston_output_finish_frame() repaint right away.
+ */
+static void
+repaint(struct test *t)
+{
+	struct weston_output *output = t->output;
+	int64_t refresh = millihz_to_nsec(output->current_mode->refresh);
+	struct timespec now, period, stamp;
+
+	weston_compositor_read_presentation_clock(t->compositor, &now);
+	period.tv_sec = refresh / NSEC_PER_SEC;
+	period.tv_nsec = refresh % NSEC_PER_SEC;
+	timespec_sub(&stamp, &now, &period);
+
+	pixman_region32_clear(&t->damage);
+	output->repaint_needed = 1;
+	weston_output_finish_frame(output, &stamp, 0);
+	assert(!output->repaint_needed);
+}
+
+/* makes the next repaint take the path it took before caching */
+static void
+force_rebuild(struct test *t)
+{
+	t->compositor->scene_generation++;
+}
+
+static void
+snapshot_take(struct test *t, struct snapshot *s)
+{
+	struct weston_view *view;
+	int i;
+
+	s->count = 0;
+	wl_list_for_each(view, &t->compositor->view_list, link) {
+		for (i = 0; i < NUM_VIEWS; i++) {
+			if (view == t->views[i]) {
+				s->order[s->count++] = view;
+				break;
+			}
+		}
+	}
+
+	for (i = 0; i < NUM_VIEWS; i++) {
+		pixman_region32_init(&s->clip[i]);
+		pixman_region32_copy(&s->clip[i], &t->views[i]->clip);
+	}
+}
+
+static void
+snapshot_release(struct snapshot *s)
+{
+	int i;
+
+	for (i = 0; i < NUM_VIEWS; i++)
+		pixman_region32_fini(&s->clip[i]);
+}
+
+static void
+snapshot_assert_equal(struct snapshot *a, struct snapshot *b)
+{
+	int i;
+
+	assert(a->count == b->count);
+	for (i = 0; i < a->count; i++)
+		assert(a->order[i] == b->order[i]);
+
+	for (i = 0; i < NUM_VIEWS; i++)
+		assert(pixman_region32_equal(&a->clip[i], &b->clip[i]));
+}
+
+static struct weston_surface *
+create_surface(struct test *t, int x, int y, int width, int height,
+	       bool opaque)
+{
+	struct weston_surface *surface;
+	struct weston_view *view;
+
+	surface = weston_surface_create(t->compositor);
+	assert(surface);
+	view = weston_view_create(surface);
+	assert(view);
+
+	surface->width = width;
+	surface->height = height;
+	if (opaque) {
+		pixman_region32_fini(&surface->opaque);
+		pixman_region32_init_rect(&surface->opaque,
+					  0, 0, width, height);
+	}
+
+	weston_view_set_position(view, x, y);
+	weston_layer_entry_insert(&t->layer.view_list, &view->layer_link);
+
+	return surface;
+}
+
+static void
+create_scene(struct test *t)
+{
+	pixman_box32_t *area = pixman_region32_extents(&t->output->region);
+	uint32_t seed = 1;
+	int i, x, y, w, h;
+
+	weston_layer_init(&t->layer, &t->compositor->layer_list);
+
+	/* Hides whatever the shell has below, only the views of the test
+	 * contribute damage.
+	 */
+	t->backdrop = create_surface(t, area->x1, area->y1,
+				     area->x2 - area->x1,
+				     area->y2 - area->y1, true);
+
+	for (i = 0; i < NUM_VIEWS; i++) {
+		seed = seed * 1103515245 + 12345;
+		w = 32 + (seed >> 8) % 160;
+		seed = seed * 1103515245 + 12345;
+		h = 32 + (seed >> 8) % 160;
+		seed = seed * 1103515245 + 12345;
+		x = area->x1 + (seed >> 8) % (area->x2 - area->x1 - w);
+		seed = seed * 1103515245 + 12345;
+		y = area->y1 + (seed >> 8) % (area->y2 - area->y1 - h);
+
+		t->surfaces[i] = create_surface(t, x, y, w, h, i % 3 == 0);
+		t->views[i] = container_of(t->surfaces[i]->views.next,
+					   struct weston_view, surface_link);
+	}
+}
+
+static void
+destroy_scene(struct test *t)
+{
+	int i;
+
+	for (i = 0; i < NUM_VIEWS; i++)
+		weston_surface_destroy(t->surfaces[i]);
+	weston_surface_destroy(t->backdrop);
+
+	wl_list_remove(&t->layer.link);
+}
+
+/* views[0] is opaque, views[1] is not */
+static void
+op_move_opaque(struct test *t, int apply)
+{
+	struct weston_view *view = t->views[0];
+	int d = apply ? 37 : -37;
+
+	weston_view_set_position(view, view->geometry.x + d,
+				 view->geometry.y + d);
+}
+
+static void
+op_move_translucent(struct test *t, int apply)
+{
+	struct weston_view *view = t->views[1];
+	int d = apply ? -29 : 29;
+
+	weston_view_set_position(view, view->geometry.x + d,
+				 view->geometry.y - d);
+}
+
+static void
+op_damage(struct test *t, int apply)
+{
+	int i;
+
+	if (!apply)
+		return;
+
+	for (i = 0; i < NUM_VIEWS; i += 7)
+		pixman_region32_union_rect(&t->surfaces[i]->damage,
+					   &t->surfaces[i]->damage,
+					   i % 13, i % 11, 20, 20);
+}
+
+static void
+op_raise(struct test *t, int apply)
+{
+	struct weston_view *view = t->views[NUM_VIEWS / 2];
+	struct wl_list *prev = view->layer_link.link.prev;
+
+	if (apply) {
+		t->above = container_of(prev, struct weston_view,
+					layer_link.link);
+		weston_layer_entry_remove(&view->layer_link);
+		weston_layer_entry_insert(&t->layer.view_list,
+					  &view->layer_link);
+	} else {
+		weston_layer_entry_remove(&view->layer_link);
+		weston_layer_entry_insert(&t->above->layer_link,
+					  &view->layer_link);
+	}
+	weston_view_geometry_dirty(view);
+}
+
+static void
+op_unmap(struct test *t, int apply)
+{
+	struct weston_view *view = t->views[NUM_VIEWS / 3];
+
+	if (apply) {
+		t->above = container_of(view->layer_link.link.prev,
+					struct weston_view, layer_link.link);
+		weston_view_unmap(view);
+	} else {
+		weston_layer_entry_insert(&t->above->layer_link,
+					  &view->layer_link);
+		weston_view_geometry_dirty(view);
+	}
+}
+
+static void
+op_opaque_region(struct test *t, int apply)
+{
+	struct weston_surface *surface = t->surfaces[NUM_VIEWS - 2];
+
+	pixman_region32_fini(&surface->opaque);
+	if (apply)
+		pixman_region32_init_rect(&surface->opaque, 0, 0,
+					  surface->width / 2,
+					  surface->height);
+	else
+		pixman_region32_init(&surface->opaque);
+	weston_view_geometry_dirty(t->views[NUM_VIEWS - 2]);
+}
+
+static void
+check_op(struct test *t, const char *name,
+	 void (*op)(struct test *t, int apply))
+{
+	struct snapshot cached, rebuilt;
+	pixman_region32_t cached_damage;
+	int nrects;
+
+	pixman_region32_init(&cached_damage);
+
+	op(t, 1);
+	repaint(t);
+	pixman_region32_copy(&cached_damage, &t->damage);
+	snapshot_take(t, &cached);
+
+	op(t, 0);
+	repaint(t);
+
+	op(t, 1);
+	force_rebuild(t);
+	repaint(t);
+	snapshot_take(t, &rebuilt);
+
+	pixman_region32_rectangles(&t->damage, &nrects);
+	fprintf(stderr, "%s: %d damage rectangles\n", name, nrects);
+	assert(pixman_region32_equal(&cached_damage, &t->damage));
+	snapshot_assert_equal(&cached, &rebuilt);
+
+	/* nothing changed since, so nothing to repaint */
+	repaint(t);
+	assert(!pixman_region32_not_empty(&t->damage));
+
+	op(t, 0);
+	repaint(t);
+
+	snapshot_release(&cached);
+	snapshot_release(&rebuilt);
+	pixman_region32_fini(&cached_damage);
+}
+
+static double
+elapsed_us(const struct timespec *begin, const struct timespec *end)
+{
+	return (end->tv_sec - begin->tv_sec) * 1e6 +
+	       (end->tv_nsec - begin->tv_nsec) / 1e3;
+}
+
+static void
+bench(struct test *t, const char *name,
+      void (*op)(struct test *t, int apply), bool rebuild)
+{
+	struct timespec begin, end;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < BENCH_FRAMES; i++) {
+		if (op)
+			op(t, i & 1);
+		if (rebuild)
+			force_rebuild(t);
+		repaint(t);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	fprintf(stderr, "%s, %s: %.1f us per repaint (%d views)\n",
+		name, rebuild ? "rebuilt" : "cached",
+		elapsed_us(&begin, &end) / BENCH_FRAMES, NUM_VIEWS);
+}
+
+static void
+view_list_test(void *data)
+{
+	struct test *t = data;
+
+	t->output = container_of(t->compositor->output_list.next,
+				 struct weston_output, link);
+	t->repaint = t->output->repaint;
+	t->output->repaint = recording_repaint;
+	pixman_region32_init(&t->damage);
+
+	create_scene(t);
+	repaint(t);
+
+	/* the view list is reused as long as nothing changes */
+	repaint(t);
+	assert(!pixman_region32_not_empty(&t->damage));
+	assert(t->compositor->view_list_generation ==
+	       t->compositor->scene_generation);
+
+	check_op(t, "move opaque", op_move_opaque);
+	check_op(t, "move translucent", op_move_translucent);
+	check_op(t, "surface damage", op_damage);
+	check_op(t, "raise", op_raise);
+	check_op(t, "unmap", op_unmap);
+	check_op(t, "opaque region", op_opaque_region);
+
+	bench(t, "idle", NULL, false);
+	bench(t, "idle", NULL, true);
+	bench(t, "window move", op_move_opaque, false);
+	bench(t, "window move", op_move_opaque, true);
+
+	destroy_scene(t);
+	repaint(t);
+
+	t->output->repaint = t->repaint;
+	pixman_region32_fini(&t->damage);
+
+	wl_display_terminate(t->compositor->wl_display);
+}
+
+WL_EXPORT int
+module_init(struct weston_compositor *compositor, int *argc, char *argv[])
+{
+	struct wl_event_loop *loop;
+
+	test.compositor = compositor;
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+
+	wl_event_loop_add_idle(loop, view_list_test, &test);
+
+	return 0;
+}
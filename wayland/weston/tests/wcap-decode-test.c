@@ -0,0 +1,475 @@
+/*
+ * Copyright © 2017 NVIDIA Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Encodes frames the way the recorder in screenshooter.c does, and checks
+ * that the decoder gives them back, single and multi-threaded, through
+ * the frame index and its cache, and when seeking. Also compares the
+ * decoding speed with the previous pixel by pixel decoder.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "weston-test-runner.h"
+
+#include "shared/helpers.h"
+#include "wcap/wcap-decode.h"
+
+#define TILE_W 64
+#define TILE_H 48
+
+struct capture {
+	char filename[64];
+	int width, height;
+	int nframes;
+	uint32_t **frames;	/* what was recorded, X bytes undefined */
+	bool **touched;		/* pixels damaged up to each frame */
+
+	uint32_t *cur, *prev;
+	bool *mask;
+	FILE *fp;
+	uint32_t *encoded;
+	uint32_t seed;
+};
+
+static uint32_t
+rnd(struct capture *c)
+{
+	c->seed = c->seed * 1103515245 + 12345;
+	return c->seed >> 8;
+}
+
+/* same as the recorder */
+static uint32_t *
+output_run(uint32_t *p, uint32_t delta, int run)
+{
+	int i;
+
+	while (run > 0) {
+		if (run <= 0xe0) {
+			*p++ = delta | ((uint32_t) (run - 1) << 24);
+			break;
+		}
+
+		i = 24 - __builtin_clz(run);
+		*p++ = delta | ((uint32_t) (i + 0xe0) << 24);
+		run -= 1 << (7 + i);
+	}
+
+	return p;
+}
+
+static uint32_t
+component_delta(uint32_t next, uint32_t prev)
+{
+	unsigned char dr, dg, db;
+
+	dr = (next >> 16) - (prev >> 16);
+	dg = (next >>  8) - (prev >>  8);
+	db = (next >>  0) - (prev >>  0);
+
+	return (dr << 16) | (dg << 8) | (db << 0);
+}
+
+/* Encodes a rectangle bottom row first, as the recorder does. */
+static void
+encode_rectangle(struct capture *c, const struct wcap_rectangle *r)
+{
+	uint32_t *p = c->encoded, *d, *s;
+	uint32_t delta, prev = 0, next;
+	int j, k, run = 0, y;
+
+	for (j = 0; j < r->y2 - r->y1; j++) {
+		y = r->y2 - j - 1;
+		s = c->cur + y * c->width + r->x1;
+		d = c->prev + y * c->width + r->x1;
+
+		for (k = 0; k < r->x2 - r->x1; k++) {
+			next = *s++;
+			delta = component_delta(next, *d);
+			*d++ = next;
+			if (run == 0 || delta == prev) {
+				run++;
+			} else {
+				p = output_run(p, prev, run);
+				run = 1;
+			}
+			prev = delta;
+		}
+	}
+
+	p = output_run(p, prev, run);
+
+	assert(fwrite(c->encoded, 4, p - c->encoded, c->fp) ==
+	       (size_t) (p - c->encoded));
+}
+
+static void
+paint_rectangle(struct capture *c, const struct wcap_rectangle *r)
+{
+	uint32_t color = rnd(c), *row;
+	int kind = rnd(c) % 4, x, y;
+
+	for (y = r->y1; y < r->y2; y++) {
+		row = c->cur + y * c->width;
+		for (x = r->x1; x < r->x2; x++) {
+			switch (kind) {
+			case 0:		/* solid, long runs */
+				row[x] = color;
+				break;
+			case 1:		/* noise, no runs */
+				row[x] = rnd(c) ^ (rnd(c) << 16);
+				break;
+			case 2:		/* gradient */
+				row[x] = color + x * 0x010203 + y * 0x030100;
+				break;
+			default:	/* unchanged but damaged */
+				break;
+			}
+			c->mask[y * c->width + x] = true;
+		}
+	}
+}
+
+static void
+capture_add_frame(struct capture *c, int index, bool full)
+{
+	struct wcap_rectangle rects[256];
+	struct wcap_frame_header header;
+	int tx, ty, n = 0, i;
+
+	if (full) {
+		rects[n].x1 = 0;
+		rects[n].y1 = 0;
+		rects[n].x2 = c->width;
+		rects[n].y2 = c->height;
+		n++;
+	} else {
+		/* disjoint tiles, clipped to the frame */
+		for (ty = 0; ty < c->height; ty += TILE_H) {
+			for (tx = 0; tx < c->width; tx += TILE_W) {
+				if (rnd(c) % 3 != 0 || n == ARRAY_LENGTH(rects))
+					continue;
+				rects[n].x1 = tx + rnd(c) % 8;
+				rects[n].y1 = ty + rnd(c) % 8;
+				rects[n].x2 = tx + TILE_W - rnd(c) % 8;
+				rects[n].y2 = ty + TILE_H - rnd(c) % 8;
+				rects[n].x2 = MIN(rects[n].x2, c->width);
+				rects[n].y2 = MIN(rects[n].y2, c->height);
+				/* the recorder never sends empty ones */
+				if (rects[n].x1 < rects[n].x2 &&
+				    rects[n].y1 < rects[n].y2)
+					n++;
+			}
+		}
+	}
+
+	for (i = 0; i < n; i++)
+		paint_rectangle(c, &rects[i]);
+
+	header.msecs = 1000 + index * 16 + rnd(c) % 8;
+	header.nrects = n;
+	assert(fwrite(&header, sizeof header, 1, c->fp) == 1);
+	assert(fwrite(rects, sizeof rects[0], n, c->fp) == (size_t) n);
+	for (i = 0; i < n; i++)
+		encode_rectangle(c, &rects[i]);
+}
+
+static struct capture *
+capture_create(int width, int height, int nframes, uint32_t seed)
+{
+	struct wcap_header header;
+	struct capture *c;
+	size_t pixels = width * height;
+	int fd, i;
+
+	c = calloc(1, sizeof *c);
+	assert(c);
+	c->width = width;
+	c->height = height;
+	c->nframes = nframes;
+	c->seed = seed;
+	c->cur = calloc(pixels, 4);
+	c->prev = calloc(pixels, 4);
+	c->mask = calloc(pixels, sizeof *c->mask);
+	c->encoded = malloc(pixels * 4 + 4);
+	c->frames = calloc(nframes, sizeof *c->frames);
+	c->touched = calloc(nframes, sizeof *c->touched);
+	assert(c->cur && c->prev && c->mask && c->encoded);
+	assert(c->frames && c->touched);
+
+	snprintf(c->filename, sizeof c->filename, "wcap-decode-test-XXXXXX");
+	fd = mkstemp(c->filename);
+	assert(fd >= 0);
+	c->fp = fdopen(fd, "wb");
+	assert(c->fp);
+
+	header.magic = WCAP_HEADER_MAGIC;
+	header.format = WCAP_FORMAT_XRGB8888;
+	header.width = width;
+	header.height = height;
+	assert(fwrite(&header, sizeof header, 1, c->fp) == 1);
+
+	for (i = 0; i < nframes; i++) {
+		capture_add_frame(c, i, i == 0 || i % 7 == 3);
+
+		c->frames[i] = malloc(pixels * 4);
+		c->touched[i] = malloc(pixels * sizeof *c->mask);
+		assert(c->frames[i] && c->touched[i]);
+		memcpy(c->frames[i], c->cur, pixels * 4);
+		memcpy(c->touched[i], c->mask, pixels * sizeof *c->mask);
+	}
+
+	assert(fclose(c->fp) == 0);
+
+	return c;
+}
+
+static void
+capture_destroy(struct capture *c)
+{
+	int i;
+
+	unlink(c->filename);
+	for (i = 0; i < c->nframes; i++) {
+		free(c->frames[i]);
+		free(c->touched[i]);
+	}
+	free(c->frames);
+	free(c->touched);
+	free(c->cur);
+	free(c->prev);
+	free(c->mask);
+	free(c->encoded);
+	free(c);
+}
+
+static void
+assert_frame(struct capture *c, struct wcap_decoder *decoder, int index)
+{
+	size_t i, pixels = c->width * c->height;
+	uint32_t expected;
+
+	assert(decoder->count == (uint32_t) index + 1);
+	for (i = 0; i < pixels; i++) {
+		if (c->touched[index][i])
+			expected = 0xff000000 |
+				(c->frames[index][i] & 0x00ffffff);
+		else
+			expected = 0;
+		assert(decoder->frame[i] == expected);
+	}
+}
+
+static void
+check_all_frames(struct capture *c, int nthreads)
+{
+	struct wcap_decoder *decoder;
+	int i;
+
+	decoder = wcap_decoder_create(c->filename);
+	assert(decoder);
+	assert(decoder->width == c->width && decoder->height == c->height);
+	assert(wcap_decoder_set_threads(decoder, nthreads) == 0);
+
+	for (i = 0; i < c->nframes; i++) {
+		assert(wcap_decoder_get_frame(decoder) == 1);
+		assert_frame(c, decoder, i);
+	}
+	assert(wcap_decoder_get_frame(decoder) == 0);
+
+	wcap_decoder_destroy(decoder);
+}
+
+TEST(wcap_round_trip)
+{
+	struct capture *c;
+
+	/* odd sizes leave partial vectors at the end of rows */
+	c = capture_create(333, 199, 24, 1);
+	check_all_frames(c, 1);
+	capture_destroy(c);
+}
+
+TEST(wcap_round_trip_threads)
+{
+	struct capture *c;
+
+	c = capture_create(1021, 611, 12, 2);
+	check_all_frames(c, 4);
+	capture_destroy(c);
+}
+
+TEST(wcap_index_and_seek)
+{
+	struct wcap_decoder *decoder;
+	struct capture *c;
+	char cache[80];
+	int i, order[] = { 5, 9, 2, 2, 0, 13 };
+
+	c = capture_create(257, 130, 16, 3);
+	snprintf(cache, sizeof cache, "%s.idx", c->filename);
+
+	decoder = wcap_decoder_create(c->filename);
+	assert(decoder);
+	assert(wcap_decoder_seek(decoder, 0) < 0);	/* no index yet */
+	assert(wcap_decoder_load_index(decoder, cache) == 0);
+	assert(decoder->nframes == (uint32_t) c->nframes);
+	assert(access(cache, R_OK) == 0);
+
+	for (i = 0; i < (int) ARRAY_LENGTH(order); i++) {
+		assert(wcap_decoder_seek(decoder, order[i]) == 0);
+		assert_frame(c, decoder, order[i]);
+	}
+	assert(wcap_decoder_seek(decoder, c->nframes) < 0);
+	wcap_decoder_destroy(decoder);
+
+	/* the second decoder reads the cached index */
+	decoder = wcap_decoder_create(c->filename);
+	assert(decoder);
+	assert(wcap_decoder_load_index(decoder, cache) == 0);
+	assert(decoder->nframes == (uint32_t) c->nframes);
+	assert(decoder->index[0].offset == sizeof(struct wcap_header));
+	for (i = 1; i < c->nframes; i++)
+		assert(decoder->index[i].offset > decoder->index[i - 1].offset);
+	assert(wcap_decoder_seek(decoder, c->nframes - 1) == 0);
+	assert_frame(c, decoder, c->nframes - 1);
+	wcap_decoder_destroy(decoder);
+
+	unlink(cache);
+	capture_destroy(c);
+}
+
+/* the decoder before it was vectorized */
+static void
+reference_decode_rectangle(struct wcap_decoder *decoder,
+			   struct wcap_rectangle *rect)
+{
+	uint32_t v, *p = decoder->p, *d;
+	int width = rect->x2 - rect->x1, height = rect->y2 - rect->y1;
+	int x, i, j, k, l, count = width * height;
+	unsigned char r, g, b, dr, dg, db;
+
+	d = decoder->frame + (rect->y2 - 1) * decoder->width;
+	x = rect->x1;
+	i = 0;
+	while (i < count) {
+		v = *p++;
+		l = v >> 24;
+		if (l < 0xe0) {
+			j = l + 1;
+		} else {
+			j = 1 << (l - 0xe0 + 7);
+		}
+
+		dr = (v >> 16);
+		dg = (v >>  8);
+		db = (v >>  0);
+		for (k = 0; k < j; k++) {
+			r = (d[x] >> 16) + dr;
+			g = (d[x] >>  8) + dg;
+			b = (d[x] >>  0) + db;
+			d[x] = 0xff000000 | (r << 16) | (g << 8) | b;
+			x++;
+			if (x == rect->x2) {
+				x = rect->x1;
+				d -= decoder->width;
+			}
+		}
+		i += j;
+	}
+
+	decoder->p = p;
+}
+
+static int
+reference_get_frame(struct wcap_decoder *decoder)
+{
+	struct wcap_rectangle *rects;
+	struct wcap_frame_header *header;
+	uint32_t i;
+
+	if (decoder->p == decoder->end)
+		return 0;
+
+	header = decoder->p;
+	decoder->msecs = header->msecs;
+	decoder->count++;
+
+	rects = (void *) (header + 1);
+	decoder->p = (uint32_t *) (rects + header->nrects);
+	for (i = 0; i < header->nrects; i++)
+		reference_decode_rectangle(decoder, &rects[i]);
+
+	return 1;
+}
+
+static double
+decode_all(struct capture *c, int nthreads, bool reference)
+{
+	struct wcap_decoder *decoder;
+	struct timespec begin, end;
+	int n = 0;
+
+	decoder = wcap_decoder_create(c->filename);
+	assert(decoder);
+	assert(wcap_decoder_set_threads(decoder, nthreads) == 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	while (reference ? reference_get_frame(decoder) :
+	       wcap_decoder_get_frame(decoder))
+		n++;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	assert(n == c->nframes);
+	assert_frame(c, decoder, n - 1);
+	wcap_decoder_destroy(decoder);
+
+	return n / ((end.tv_sec - begin.tv_sec) +
+		    (end.tv_nsec - begin.tv_nsec) / 1e9);
+}
+
+TEST(wcap_decode_benchmark)
+{
+	struct capture *c;
+
+	c = capture_create(1280, 720, 60, 4);
+
+	fprintf(stderr, "1280x720: %.0f frames/s pixel by pixel, "
+		"%.0f frames/s vectorized, %.0f frames/s on 4 threads\n",
+		decode_all(c, 1, true), decode_all(c, 1, false),
+		decode_all(c, 4, false));
+
+	capture_destroy(c);
+}
@@ -53,6 +53,8 @@ t_ilm_bool ilm_isInitialized(void);
 /**
  * \brief Commit all changes and execute all enqueued commands since last commit.
  * \ingroup ilmCommon
+ * Commands are buffered on the client until this call, which sends them
+ * in one batch and waits for the compositor once.
  * \return ILM_SUCCESS if the method call was successful
  * \return ILM_FAILED if the client can not call the method on the service.
  */
@@ -144,6 +144,9 @@ struct ilm_control_context {
     pthread_mutex_t mutex;
     int shutdown_fd;
     uint32_t internal_id_surface;
+
+    /* requests were sent since the last roundtrip */
+    bool pending_requests;
 };
 
 struct seat_context {
@@ -176,14 +179,27 @@ struct surface_context {
     bool is_surface_creation_noticed;
 };
 
+/*
+ * The scene mirrored in wayland_context is kept current by the receive
+ * thread, so reading it does not need a roundtrip to the compositor.
+ *
+ * impl_sync_and_acquire_instance always does a roundtrip before taking
+ * the lock. impl_acquire_instance only does one if requests are pending,
+ * so that their effects are visible to the caller. Calls that only send
+ * requests use impl_acquire_instance_for_request, which does not wait at
+ * all: the requests are buffered and go out together with the next
+ * ilm_commitChanges, which does the single flush and roundtrip.
+ */
 ilmErrorTypes impl_sync_and_acquire_instance(struct ilm_control_context *ctx);
+ilmErrorTypes impl_acquire_instance(struct ilm_control_context *ctx);
+ilmErrorTypes impl_acquire_instance_for_request(struct ilm_control_context *ctx);
 
 void release_instance(void);
 
-#define sync_and_acquire_instance() ({ \
+#define acquire_instance_with(impl) ({ \
     struct ilm_control_context *ctx = &ilm_context; \
     { \
-        ilmErrorTypes status = impl_sync_and_acquire_instance(ctx); \
+        ilmErrorTypes status = impl(ctx); \
         if (status != ILM_SUCCESS) { \
             return status; \
         } \
@@ -191,6 +207,15 @@ void release_instance(void);
     ctx; \
 })
 
+#define sync_and_acquire_instance() \
+    acquire_instance_with(impl_sync_and_acquire_instance)
+
+#define acquire_instance() \
+    acquire_instance_with(impl_acquire_instance)
+
+#define acquire_instance_for_request() \
+    acquire_instance_with(impl_acquire_instance_for_request)
+
 #ifdef __cplusplus
 } /**/
 #endif /* __cplusplus */
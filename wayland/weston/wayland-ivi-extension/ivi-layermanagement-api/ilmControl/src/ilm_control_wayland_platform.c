@@ -1323,6 +1323,19 @@ init_control(void)
     return 0;
 }
 
+static int
+sync_instance(struct ilm_control_context *ctx)
+{
+    if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) == -1) {
+        int err = wl_display_get_error(ctx->wl.display);
+        fprintf(stderr, "Error communicating with wayland: %s\n", strerror(err));
+        return -1;
+    }
+
+    ctx->pending_requests = false;
+    return 0;
+}
+
 ilmErrorTypes impl_sync_and_acquire_instance(struct ilm_control_context *ctx)
 {
     if (! ctx->initialized) {
@@ -1332,9 +1345,7 @@ ilmErrorTypes impl_sync_and_acquire_instance(struct ilm_control_context *ctx)
 
     lock_context(ctx);
 
-    if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) == -1) {
-        int err = wl_display_get_error(ctx->wl.display);
-        fprintf(stderr, "Error communicating with wayland: %s\n", strerror(err));
+    if (sync_instance(ctx) == -1) {
         unlock_context(ctx);
         return ILM_FAILED;
     }
@@ -1342,6 +1353,36 @@ ilmErrorTypes impl_sync_and_acquire_instance(struct ilm_control_context *ctx)
     return ILM_SUCCESS;
 }
 
+ilmErrorTypes impl_acquire_instance(struct ilm_control_context *ctx)
+{
+    if (! ctx->initialized) {
+        fprintf(stderr, "Not initialized\n");
+        return ILM_FAILED;
+    }
+
+    lock_context(ctx);
+
+    if (ctx->pending_requests && sync_instance(ctx) == -1) {
+        unlock_context(ctx);
+        return ILM_FAILED;
+    }
+
+    return ILM_SUCCESS;
+}
+
+ilmErrorTypes impl_acquire_instance_for_request(struct ilm_control_context *ctx)
+{
+    if (! ctx->initialized) {
+        fprintf(stderr, "Not initialized\n");
+        return ILM_FAILED;
+    }
+
+    lock_context(ctx);
+    ctx->pending_requests = true;
+
+    return ILM_SUCCESS;
+}
+
 void release_instance(void)
 {
     struct ilm_control_context *ctx = &ilm_context;
@@ -1410,19 +1451,48 @@ get_screen_context_by_id(struct wayland_context *ctx, uint32_t id_screen)
     return NULL;
 }
 
+/*
+ * An id missing from the mirrored scene may belong to an object another
+ * client has just created, whose creation event is not dispatched yet:
+ * sync once and look again before giving up.
+ */
+static struct layer_context*
+lookup_layer_context(struct ilm_control_context *ctx, uint32_t id_layer)
+{
+    struct layer_context *ctx_layer =
+        wayland_controller_get_layer_context(&ctx->wl, id_layer);
+
+    if (ctx_layer == NULL && sync_instance(ctx) == 0) {
+        ctx_layer = wayland_controller_get_layer_context(&ctx->wl, id_layer);
+    }
+
+    return ctx_layer;
+}
+
+static struct surface_context*
+lookup_surface_context(struct ilm_control_context *ctx, uint32_t id_surface)
+{
+    struct surface_context *ctx_surf =
+        get_surface_context(&ctx->wl, id_surface);
+
+    if (ctx_surf == NULL && sync_instance(ctx) == 0) {
+        ctx_surf = get_surface_context(&ctx->wl, id_surface);
+    }
+
+    return ctx_surf;
+}
+
 ILM_EXPORT ilmErrorTypes
 ilm_getPropertiesOfLayer(t_ilm_uint layerID,
                          struct ilmLayerProperties* pLayerProperties)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
     struct layer_context *ctx_layer = NULL;
 
     if (pLayerProperties != NULL) {
 
-        ctx_layer = (struct layer_context*)
-                    wayland_controller_get_layer_context(
-                        &ctx->wl, (uint32_t)layerID);
+        ctx_layer = lookup_layer_context(ctx, (uint32_t)layerID);
 
         if (ctx_layer != NULL) {
             *pLayerProperties = ctx_layer->prop;
@@ -1472,7 +1542,7 @@ ilm_getPropertiesOfScreen(t_ilm_display screenID,
         return ILM_ERROR_INVALID_ARGUMENTS;
     }
 
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
 
     struct screen_context *ctx_screen = NULL;
     ctx_screen = get_screen_context_by_id(&ctx->wl, (uint32_t)screenID);
@@ -1491,7 +1561,7 @@ ILM_EXPORT ilmErrorTypes
 ilm_getScreenIDs(t_ilm_uint* pNumberOfIDs, t_ilm_uint** ppIDs)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
 
     if ((pNumberOfIDs != NULL) && (ppIDs != NULL)) {
         struct screen_context *ctx_scrn = NULL;
@@ -1521,7 +1591,7 @@ ILM_EXPORT ilmErrorTypes
 ilm_getScreenResolution(t_ilm_uint screenID, t_ilm_uint* pWidth, t_ilm_uint* pHeight)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
 
     if ((pWidth != NULL) && (pHeight != NULL))
     {
@@ -1544,7 +1614,7 @@ ILM_EXPORT ilmErrorTypes
 ilm_getLayerIDs(t_ilm_int* pLength, t_ilm_layer** ppArray)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
 
     if ((pLength != NULL) && (ppArray != NULL)) {
         struct layer_context *ctx_layer = NULL;
@@ -1577,7 +1647,7 @@ ilm_getLayerIDsOnScreen(t_ilm_uint screenId,
                             t_ilm_layer** ppArray)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
 
     if ((pLength != NULL) && (ppArray != NULL)) {
         struct screen_context *ctx_screen = NULL;
@@ -1619,7 +1689,7 @@ ILM_EXPORT ilmErrorTypes
 ilm_getSurfaceIDs(t_ilm_int* pLength, t_ilm_surface** ppArray)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
 
     if ((pLength != NULL) && (ppArray != NULL)) {
         struct surface_context *ctx_surf = NULL;
@@ -1648,7 +1718,7 @@ ilm_getSurfaceIDsOnLayer(t_ilm_layer layer,
                              t_ilm_int* pLength,
                              t_ilm_surface** ppArray)
 {
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
     struct layer_context *ctx_layer = NULL;
     struct surface_context *ctx_surf = NULL;
     t_ilm_uint length = 0;
@@ -1659,8 +1729,7 @@ ilm_getSurfaceIDsOnLayer(t_ilm_layer layer,
         return ILM_FAILED;
     }
 
-    ctx_layer = (struct layer_context*)wayland_controller_get_layer_context(
-                    &ctx->wl, (uint32_t)layer);
+    ctx_layer = lookup_layer_context(ctx, (uint32_t)layer);
 
     if (ctx_layer == NULL) {
         release_instance();
@@ -1726,7 +1795,7 @@ ilm_layerCreateWithDimension(t_ilm_layer* pLayerId,
                                  t_ilm_uint height)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     uint32_t layerid = 0;
     int32_t is_inside = 0;
 
@@ -1753,6 +1822,8 @@ ilm_layerCreateWithDimension(t_ilm_layer* pLayerId,
 
         if (create_controller_layer(&ctx->wl, width, height, layerid) == 0)
         {
+           /* other clients may look for the layer before our next commit */
+           wl_display_flush(ctx->wl.display);
            returnValue = ILM_SUCCESS;
         }
     } while(0);
@@ -1765,7 +1836,7 @@ ILM_EXPORT ilmErrorTypes
 ilm_layerRemove(t_ilm_layer layerId)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct layer_context *ctx_layer = NULL;
     struct layer_context *ctx_next = NULL;
     struct surface_context *ctx_surf = NULL;
@@ -1775,6 +1846,7 @@ ilm_layerRemove(t_ilm_layer layerId)
             &ctx->wl.list_layer, link) {
         if (ctx_layer->id_layer == layerId) {
             ivi_controller_layer_destroy(ctx_layer->controller, 1);
+            wl_display_flush(ctx->wl.display);
 
             wl_list_remove(&ctx_layer->order.link);
             wl_list_remove(&ctx_layer->link);
@@ -1799,11 +1871,10 @@ ILM_EXPORT ilmErrorTypes
 ilm_layerSetVisibility(t_ilm_layer layerId, t_ilm_bool newVisibility)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct layer_context *ctx_layer = NULL;
 
-    ctx_layer = (struct layer_context*)wayland_controller_get_layer_context(
-                    &ctx->wl, (uint32_t)layerId);
+    ctx_layer = lookup_layer_context(ctx, (uint32_t)layerId);
 
     if (ctx_layer != NULL) {
         uint32_t visibility = 0;
@@ -1823,14 +1894,12 @@ ILM_EXPORT ilmErrorTypes
 ilm_layerGetVisibility(t_ilm_layer layerId, t_ilm_bool *pVisibility)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
 
     if (pVisibility != NULL) {
         struct layer_context *ctx_layer = NULL;
 
-        ctx_layer = (struct layer_context*)
-                    wayland_controller_get_layer_context(
-                        &ctx->wl, (uint32_t)layerId);
+        ctx_layer = lookup_layer_context(ctx, (uint32_t)layerId);
 
         if (ctx_layer != NULL) {
             *pVisibility = ctx_layer->prop.visibility;
@@ -1846,11 +1915,10 @@ ILM_EXPORT ilmErrorTypes
 ilm_layerSetOpacity(t_ilm_layer layerId, t_ilm_float opacity)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct layer_context *ctx_layer = NULL;
 
-    ctx_layer = (struct layer_context*)wayland_controller_get_layer_context(
-                    &ctx->wl, (uint32_t)layerId);
+    ctx_layer = lookup_layer_context(ctx, (uint32_t)layerId);
 
     if (ctx_layer != NULL) {
         wl_fixed_t opacity_fixed = wl_fixed_from_double((double)opacity);
@@ -1867,14 +1935,12 @@ ILM_EXPORT ilmErrorTypes
 ilm_layerGetOpacity(t_ilm_layer layerId, t_ilm_float *pOpacity)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
 
     if (pOpacity != NULL) {
         struct layer_context *ctx_layer = NULL;
 
-        ctx_layer = (struct layer_context*)
-                    wayland_controller_get_layer_context(
-                        &ctx->wl, (uint32_t)layerId);
+        ctx_layer = lookup_layer_context(ctx, (uint32_t)layerId);
 
         if (ctx_layer != NULL) {
             *pOpacity = ctx_layer->prop.opacity;
@@ -1892,11 +1958,10 @@ ilm_layerSetSourceRectangle(t_ilm_layer layerId,
                                 t_ilm_uint width, t_ilm_uint height)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct layer_context *ctx_layer = NULL;
 
-    ctx_layer = (struct layer_context*)wayland_controller_get_layer_context(
-                    &ctx->wl, (uint32_t)layerId);
+    ctx_layer = lookup_layer_context(ctx, (uint32_t)layerId);
 
     if (ctx_layer != NULL) {
         ivi_controller_layer_set_source_rectangle(ctx_layer->controller,
@@ -1917,11 +1982,10 @@ ilm_layerSetDestinationRectangle(t_ilm_layer layerId,
                                  t_ilm_int width, t_ilm_int height)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct layer_context *ctx_layer = NULL;
 
-    ctx_layer = (struct layer_context*)wayland_controller_get_layer_context(
-                    &ctx->wl, (uint32_t)layerId);
+    ctx_layer = lookup_layer_context(ctx, (uint32_t)layerId);
     if (ctx_layer != NULL) {
         ivi_controller_layer_set_destination_rectangle(
                                          ctx_layer->controller,
@@ -1939,7 +2003,7 @@ ILM_EXPORT ilmErrorTypes
 ilm_layerSetOrientation(t_ilm_layer layerId, ilmOrientation orientation)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct layer_context *ctx_layer = NULL;
     int32_t iviorientation = 0;
 
@@ -1962,8 +2026,7 @@ ilm_layerSetOrientation(t_ilm_layer layerId, ilmOrientation orientation)
             break;
         }
 
-        ctx_layer = (struct layer_context*)wayland_controller_get_layer_context(
-                        &ctx->wl, (uint32_t)layerId);
+        ctx_layer = lookup_layer_context(ctx, (uint32_t)layerId);
         if (ctx_layer == NULL) {
             returnValue = ILM_FAILED;
             break;
@@ -1983,13 +2046,11 @@ ILM_EXPORT ilmErrorTypes
 ilm_layerGetOrientation(t_ilm_layer layerId, ilmOrientation *pOrientation)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
     struct layer_context *ctx_layer = NULL;
 
     if (pOrientation != NULL) {
-        ctx_layer = (struct layer_context*)
-                    wayland_controller_get_layer_context(
-                        &ctx->wl, (uint32_t)layerId);
+        ctx_layer = lookup_layer_context(ctx, (uint32_t)layerId);
         if (ctx_layer != NULL) {
             *pOrientation = ctx_layer->prop.orientation;
             returnValue = ILM_SUCCESS;
@@ -2006,11 +2067,10 @@ ilm_layerSetRenderOrder(t_ilm_layer layerId,
                         t_ilm_int number)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct layer_context *ctx_layer = NULL;
 
-    ctx_layer = (struct layer_context*)wayland_controller_get_layer_context(
-                    &ctx->wl, (uint32_t)layerId);
+    ctx_layer = lookup_layer_context(ctx, (uint32_t)layerId);
 
     if (ctx_layer)
     {
@@ -2032,14 +2092,14 @@ ILM_EXPORT ilmErrorTypes
 ilm_surfaceSetVisibility(t_ilm_surface surfaceId, t_ilm_bool newVisibility)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct surface_context *ctx_surf = NULL;
     uint32_t visibility = 0;
 
     if (newVisibility == ILM_TRUE) {
         visibility = 1;
     }
-    ctx_surf = get_surface_context(&ctx->wl, surfaceId);
+    ctx_surf = lookup_surface_context(ctx, surfaceId);
     if (ctx_surf) {
         if (ctx_surf->controller != NULL) {
             ivi_controller_surface_set_visibility(ctx_surf->controller,
@@ -2056,12 +2116,12 @@ ILM_EXPORT ilmErrorTypes
 ilm_surfaceSetOpacity(t_ilm_surface surfaceId, t_ilm_float opacity)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct surface_context *ctx_surf = NULL;
     wl_fixed_t opacity_fixed = 0;
 
     opacity_fixed = wl_fixed_from_double((double)opacity);
-    ctx_surf = get_surface_context(&ctx->wl, surfaceId);
+    ctx_surf = lookup_surface_context(ctx, surfaceId);
     if (ctx_surf) {
         if (ctx_surf->controller != NULL) {
             ivi_controller_surface_set_opacity(ctx_surf->controller,
@@ -2078,11 +2138,11 @@ ILM_EXPORT ilmErrorTypes
 ilm_surfaceGetOpacity(t_ilm_surface surfaceId, t_ilm_float *pOpacity)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
 
     if (pOpacity != NULL) {
         struct surface_context *ctx_surf = NULL;
-        ctx_surf = get_surface_context(&ctx->wl, surfaceId);
+        ctx_surf = lookup_surface_context(ctx, surfaceId);
         if (ctx_surf) {
             *pOpacity = ctx_surf->prop.opacity;
             returnValue = ILM_SUCCESS;
@@ -2099,10 +2159,10 @@ ilm_surfaceSetDestinationRectangle(t_ilm_surface surfaceId,
                                    t_ilm_int width, t_ilm_int height)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct surface_context *ctx_surf = NULL;
 
-    ctx_surf = get_surface_context(&ctx->wl, surfaceId);
+    ctx_surf = lookup_surface_context(ctx, surfaceId);
     if (ctx_surf) {
         if (ctx_surf->controller != NULL) {
             ivi_controller_surface_set_destination_rectangle(
@@ -2121,7 +2181,7 @@ ilm_surfaceSetOrientation(t_ilm_surface surfaceId,
                               ilmOrientation orientation)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct surface_context *ctx_surf = NULL;
     int32_t iviorientation = 0;
 
@@ -2144,7 +2204,7 @@ ilm_surfaceSetOrientation(t_ilm_surface surfaceId,
             break;
         }
 
-        ctx_surf = get_surface_context(&ctx->wl, surfaceId);
+        ctx_surf = lookup_surface_context(ctx, surfaceId);
         if (ctx_surf == NULL) {
             returnValue = ILM_FAILED;
             break;
@@ -2165,11 +2225,11 @@ ilm_surfaceGetOrientation(t_ilm_surface surfaceId,
                               ilmOrientation *pOrientation)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
 
     if (pOrientation != NULL) {
         struct surface_context *ctx_surf = NULL;
-        ctx_surf = get_surface_context(&ctx->wl, surfaceId);
+        ctx_surf = lookup_surface_context(ctx, surfaceId);
         if (ctx_surf) {
             *pOrientation = ctx_surf->prop.orientation;
             returnValue = ILM_SUCCESS;
@@ -2185,11 +2245,11 @@ ilm_surfaceGetPixelformat(t_ilm_layer surfaceId,
                               ilmPixelFormat *pPixelformat)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
 
     if (pPixelformat != NULL) {
         struct surface_context *ctx_surf = NULL;
-        ctx_surf = get_surface_context(&ctx->wl, surfaceId);
+        ctx_surf = lookup_surface_context(ctx, surfaceId);
         if (ctx_surf) {
             *pPixelformat = ctx_surf->prop.pixelformat;
             returnValue = ILM_SUCCESS;
@@ -2205,7 +2265,7 @@ ilm_displaySetRenderOrder(t_ilm_display display,
                           t_ilm_layer *pLayerId, const t_ilm_uint number)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct screen_context *ctx_scrn = NULL;
 
     ctx_scrn = get_screen_context_by_id(&ctx->wl, (uint32_t)display);
@@ -2228,7 +2288,7 @@ ILM_EXPORT ilmErrorTypes
 ilm_takeScreenshot(t_ilm_uint screen, t_ilm_const_string filename)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct screen_context *ctx_scrn = NULL;
 
     ctx_scrn = get_screen_context_by_id(&ctx->wl, (uint32_t)screen);
@@ -2247,11 +2307,10 @@ ILM_EXPORT ilmErrorTypes
 ilm_takeLayerScreenshot(t_ilm_const_string filename, t_ilm_layer layerid)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct layer_context *ctx_layer = NULL;
 
-    ctx_layer = (struct layer_context*)wayland_controller_get_layer_context(
-                    &ctx->wl, (uint32_t)layerid);
+    ctx_layer = lookup_layer_context(ctx, (uint32_t)layerid);
     if (ctx_layer != NULL) {
         ivi_controller_layer_screenshot(ctx_layer->controller,
                                         filename);
@@ -2268,10 +2327,10 @@ ilm_takeSurfaceScreenshot(t_ilm_const_string filename,
                               t_ilm_surface surfaceid)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct surface_context *ctx_surf = NULL;
 
-    ctx_surf = get_surface_context(&ctx->wl, (uint32_t)surfaceid);
+    ctx_surf = lookup_surface_context(ctx, (uint32_t)surfaceid);
     if (ctx_surf) {
         ivi_controller_surface_screenshot(ctx_surf->controller,
                                           filename);
@@ -2288,11 +2347,10 @@ ilm_layerAddNotification(t_ilm_layer layer,
                              layerNotificationFunc callback)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
     struct layer_context *ctx_layer = NULL;
 
-    ctx_layer = (struct layer_context*)wayland_controller_get_layer_context(
-                    &ctx->wl, (uint32_t)layer);
+    ctx_layer = lookup_layer_context(ctx, (uint32_t)layer);
     if (ctx_layer == NULL) {
         returnValue = ILM_ERROR_INVALID_ARGUMENTS;
     } else {
@@ -2336,7 +2394,7 @@ create_surface_context(struct wayland_context *ctx, uint32_t id_surface)
 ILM_EXPORT ilmErrorTypes
 ilm_registerNotification(notificationFunc callback, void *user_data)
 {
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
     struct layer_context *ctx_layer = NULL;
     struct surface_context *ctx_surf = NULL;
 
@@ -2370,11 +2428,10 @@ ilm_surfaceAddNotification(t_ilm_surface surface,
                              surfaceNotificationFunc callback)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
     struct surface_context *ctx_surf = NULL;
 
-    ctx_surf = (struct surface_context*)get_surface_context(
-                    &ctx->wl, (uint32_t)surface);
+    ctx_surf = lookup_surface_context(ctx, (uint32_t)surface);
     if (ctx_surf == NULL) {
         if (callback != NULL) {
             callback((uint32_t)surface, NULL, ILM_NOTIFICATION_CONTENT_REMOVED);
@@ -2406,11 +2463,10 @@ ILM_EXPORT ilmErrorTypes
 ilm_surfaceRemoveNotification(t_ilm_surface surface)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
     struct surface_context *ctx_surf = NULL;
 
-    ctx_surf = (struct surface_context*)get_surface_context(
-                    &ctx->wl, (uint32_t)surface);
+    ctx_surf = lookup_surface_context(ctx, (uint32_t)surface);
     if (ctx_surf != NULL) {
         if (ctx_surf->notification != NULL) {
             ctx_surf->notification = NULL;
@@ -2429,17 +2485,17 @@ ilm_getPropertiesOfSurface(t_ilm_uint surfaceID,
                         struct ilmSurfaceProperties* pSurfaceProperties)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
 
     if (pSurfaceProperties != NULL) {
         struct surface_context *ctx_surf = NULL;
 
-        ctx_surf = get_surface_context(&ctx->wl, (uint32_t)surfaceID);
+        ctx_surf = lookup_surface_context(ctx, (uint32_t)surfaceID);
         if (ctx_surf != NULL) {
             // request statistics for surface
             ivi_controller_surface_send_stats(ctx_surf->controller);
             // force submission
-            int ret = wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
+            int ret = sync_instance(ctx);
 
             // If we got an error here, there is really no sense
             // in returning the properties as something is fundamentally
@@ -2461,13 +2517,12 @@ ilm_layerAddSurface(t_ilm_layer layerId,
                         t_ilm_surface surfaceId)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct layer_context *ctx_layer = NULL;
     struct surface_context *ctx_surf = NULL;
 
-    ctx_layer = (struct layer_context*)wayland_controller_get_layer_context(
-                    &ctx->wl, (uint32_t)layerId);
-    ctx_surf = get_surface_context(&ctx->wl, (uint32_t)surfaceId);
+    ctx_layer = lookup_layer_context(ctx, (uint32_t)layerId);
+    ctx_surf = lookup_surface_context(ctx, (uint32_t)surfaceId);
     if ((ctx_layer != NULL) && (ctx_surf != NULL)) {
         ivi_controller_layer_add_surface(ctx_layer->controller,
                                          ctx_surf->controller);
@@ -2483,13 +2538,12 @@ ilm_layerRemoveSurface(t_ilm_layer layerId,
                            t_ilm_surface surfaceId)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct layer_context *ctx_layer = NULL;
     struct surface_context *ctx_surf = NULL;
 
-    ctx_layer = (struct layer_context*)wayland_controller_get_layer_context(
-                    &ctx->wl, (uint32_t)layerId);
-    ctx_surf = get_surface_context(&ctx->wl, (uint32_t)surfaceId);
+    ctx_layer = lookup_layer_context(ctx, (uint32_t)layerId);
+    ctx_surf = lookup_surface_context(ctx, (uint32_t)surfaceId);
     if ((ctx_layer != NULL) && (ctx_surf != NULL)) {
         ivi_controller_layer_remove_surface(ctx_layer->controller,
                                             ctx_surf->controller);
@@ -2505,11 +2559,11 @@ ilm_surfaceGetVisibility(t_ilm_surface surfaceId,
                              t_ilm_bool *pVisibility)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance();
     struct surface_context *ctx_surf = NULL;
 
     if (pVisibility != NULL) {
-        ctx_surf = get_surface_context(&ctx->wl, (uint32_t)surfaceId);
+        ctx_surf = lookup_surface_context(ctx, (uint32_t)surfaceId);
         if (ctx_surf != NULL) {
             *pVisibility = (t_ilm_bool)ctx_surf->prop.visibility;
             returnValue = ILM_SUCCESS;
@@ -2526,10 +2580,10 @@ ilm_surfaceSetSourceRectangle(t_ilm_surface surfaceId,
                                   t_ilm_int width, t_ilm_int height)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
     struct surface_context *ctx_surf = NULL;
 
-    ctx_surf = get_surface_context(&ctx->wl, (uint32_t)surfaceId);
+    ctx_surf = lookup_surface_context(ctx, (uint32_t)surfaceId);
     if (ctx_surf != NULL) {
         if (ctx_surf->controller != NULL) {
             ivi_controller_surface_set_source_rectangle(
@@ -2547,12 +2601,13 @@ ILM_EXPORT ilmErrorTypes
 ilm_commitChanges(void)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct ilm_control_context *ctx = acquire_instance_for_request();
 
     if (ctx->wl.controller != NULL) {
+        /* one flush and roundtrip for everything requested since the last */
         ivi_controller_commit_changes(ctx->wl.controller);
 
-        if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) != -1)
+        if (sync_instance(ctx) != -1)
         {
             returnValue = ILM_SUCCESS;
         }
@@ -20,6 +20,9 @@
 
 #include <gtest/gtest.h>
 #include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
 
 #include <unistd.h>
 #include <sys/types.h>
@@ -1121,3 +1124,170 @@ TEST_F(IlmCommandTest, LayerSetRenderOrder_empty) {
 
     ASSERT_EQ(0, layerSurfaceCount);
 }
+
+TEST_F(IlmCommandTest, BatchedSetsAppliedOnCommit) {
+    t_ilm_layer layer = 4316;
+    t_ilm_float opacity;
+    t_ilm_bool visibility;
+    ilmLayerProperties props;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerCreateWithDimension(&layer, 800, 480));
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerSetOpacity(layer, 0.25f));
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+
+    // nothing is applied before the commit, only the last value counts
+    for (int i = 0; i < 100; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_layerSetOpacity(layer, 0.01f * i));
+        ASSERT_EQ(ILM_SUCCESS, ilm_layerSetVisibility(layer, i % 2));
+        ASSERT_EQ(ILM_SUCCESS, ilm_layerSetDestinationRectangle(layer, i, i, 100 + i, 50 + i));
+    }
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerGetOpacity(layer, &opacity));
+    EXPECT_NEAR(0.25, opacity, 0.01);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerGetOpacity(layer, &opacity));
+    EXPECT_NEAR(0.99, opacity, 0.01);
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerGetVisibility(layer, &visibility));
+    EXPECT_EQ(ILM_TRUE, visibility);
+    ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfLayer(layer, &props));
+    EXPECT_EQ(99u, props.destX);
+    EXPECT_EQ(99u, props.destY);
+    EXPECT_EQ(199u, props.destWidth);
+    EXPECT_EQ(149u, props.destHeight);
+}
+
+TEST_F(IlmCommandTest, SetOnSurfaceOfOtherClientWithoutSync) {
+    t_ilm_surface surface = 36;
+    t_ilm_float opacity;
+
+    // the control connection has not seen the surface yet
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceCreate((t_ilm_nativehandle)wlSurfaces[0], 0, 0, ILM_PIXELFORMAT_RGBA_8888, &surface));
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(surface, 0.5f));
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceGetOpacity(surface, &opacity));
+    EXPECT_NEAR(0.5, opacity, 0.01);
+}
+
+static double elapsed_seconds(const struct timespec &begin,
+                              const struct timespec &end)
+{
+    return (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9;
+}
+
+TEST_F(IlmCommandTest, QueriesPerSecond) {
+    const int queries = 10000;
+    const int layerCount = 32;
+    t_ilm_layer layers[layerCount];
+    struct timespec begin, end;
+    ilmLayerProperties props;
+    t_ilm_float opacity;
+
+    for (int i = 0; i < layerCount; ++i)
+    {
+        layers[i] = 1000 + i;
+        ASSERT_EQ(ILM_SUCCESS, ilm_layerCreateWithDimension(layers + i, 800, 480));
+    }
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (int i = 0; i < queries; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfLayer(layers[i % layerCount], &props));
+        ASSERT_EQ(ILM_SUCCESS, ilm_layerGetOpacity(layers[i % layerCount], &opacity));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("[ INFO     ] %.0f queries per second\n",
+           2 * queries / elapsed_seconds(begin, end));
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (int i = 0; i < queries; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_layerSetOpacity(layers[i % layerCount], (i % 100) * 0.01f));
+    }
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("[ INFO     ] %.0f batched set calls per second\n",
+           queries / elapsed_seconds(begin, end));
+}
+
+static bool read_file(const char *name, std::vector<unsigned char> &data)
+{
+    // screenshots appear under their name only once completely written
+    for (int i = 0; i < 500; ++i)
+    {
+        FILE *f = fopen(name, "r");
+        if (f != NULL)
+        {
+            unsigned char buf[4096];
+            size_t n;
+            data.clear();
+            while ((n = fread(buf, 1, sizeof buf, f)) > 0)
+                data.insert(data.end(), buf, buf + n);
+            fclose(f);
+            return true;
+        }
+        usleep(10000);
+    }
+    return false;
+}
+
+static bool raw_matches_bmp(const std::vector<unsigned char> &raw,
+                            const unsigned char *bmp,
+                            t_ilm_uint width, t_ilm_uint height, bool flip)
+{
+    for (t_ilm_uint y = 0; y < height; ++y)
+    {
+        const unsigned char *r = &raw[y * width * 4];
+        const unsigned char *b = bmp + (flip ? height - 1 - y : y) * width * 4;
+        for (t_ilm_uint x = 0; x < width * 4; x += 4)
+        {
+            // the bitmap keeps the B, G, R, A order of the read back
+            if (r[x] != b[x + 2] || r[x + 1] != b[x + 1] ||
+                r[x + 2] != b[x] || r[x + 3] != b[x + 3])
+                return false;
+        }
+    }
+    return true;
+}
+
+TEST_F(IlmCommandTest, ilm_takeScreenshot_FormatsMatch) {
+    const char* bmpFile = "/tmp/test-formats.bmp";
+    const char* rawFile = "/tmp/test-formats.raw";
+    t_ilm_uint width, height;
+    std::vector<unsigned char> bmp, raw;
+    struct timespec begin, end;
+    double stall = 0;
+
+    remove(bmpFile);
+    remove(rawFile);
+    ASSERT_EQ(ILM_SUCCESS, ilm_getScreenResolution(0, &width, &height));
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeScreenshot(0, bmpFile));
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeScreenshot(0, rawFile));
+
+    // the compositor must stay responsive while the files are written
+    for (int i = 0; i < 20; ++i)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        stall = std::max(stall, elapsed_seconds(begin, end));
+    }
+    printf("[ INFO     ] longest roundtrip while taking screenshots: %.0f us\n",
+           stall * 1e6);
+
+    ASSERT_TRUE(read_file(bmpFile, bmp));
+    ASSERT_TRUE(read_file(rawFile, raw));
+
+    // 54 byte headers, then the 32 bit rows exactly as read back
+    ASSERT_EQ(54 + width * height * 4, bmp.size());
+    ASSERT_EQ(width * height * 4, raw.size());
+
+    // the raw file is always top row first, the bitmap as read back
+    EXPECT_TRUE(raw_matches_bmp(raw, &bmp[54], width, height, true) ||
+                raw_matches_bmp(raw, &bmp[54], width, height, false));
+
+    remove(bmpFile);
+    remove(rawFile);
+}
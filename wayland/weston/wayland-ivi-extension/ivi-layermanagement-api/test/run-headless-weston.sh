@@ -0,0 +1,72 @@
+#!/bin/sh
+############################################################################
+#
+# Copyright (C) 2017 NVIDIA Corporation
+#
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#               http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+############################################################################
+#
+# Runs a test binary against a private headless weston using ivi-shell
+# and ivi-controller, so the testsuite does not need a running compositor.
+#
+# Usage: run-headless-weston.sh <weston> <test binary> [test arguments]
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 <weston> <test binary> [test arguments]" >&2
+    exit 2
+fi
+
+WESTON=$1
+shift
+
+RUNTIME_DIR=$(mktemp -d "${TMPDIR:-/tmp}/ilm-test.XXXXXX") || exit 1
+SOCKET=ilm-test-$$
+
+cat > "$RUNTIME_DIR/weston.ini" <<EOF
+[core]
+shell=ivi-shell.so
+
+[ivi-shell]
+ivi-module=ivi-controller.so
+EOF
+
+XDG_RUNTIME_DIR=$RUNTIME_DIR "$WESTON" \
+    --backend=headless-backend.so \
+    --config="$RUNTIME_DIR/weston.ini" \
+    --socket=$SOCKET \
+    --log="$RUNTIME_DIR/weston.log" &
+WESTON_PID=$!
+
+cleanup()
+{
+    kill $WESTON_PID 2>/dev/null
+    wait $WESTON_PID 2>/dev/null
+    rm -rf "$RUNTIME_DIR"
+}
+trap cleanup EXIT INT TERM
+
+# wait up to five seconds for the compositor to come up
+i=0
+while [ ! -S "$RUNTIME_DIR/$SOCKET" ]; do
+    if [ $i -ge 50 ] || ! kill -0 $WESTON_PID 2>/dev/null; then
+        echo "weston did not start:" >&2
+        cat "$RUNTIME_DIR/weston.log" >&2
+        exit 1
+    fi
+    sleep 0.1
+    i=$((i + 1))
+done
+
+XDG_RUNTIME_DIR=$RUNTIME_DIR WAYLAND_DISPLAY=$SOCKET "$@"
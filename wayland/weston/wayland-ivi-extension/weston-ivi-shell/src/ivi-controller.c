@@ -32,7 +32,7 @@
 #include <compositor.h>
 #include <ivi-layout-export.h>
 #include "ivi-controller-server-protocol.h"
-#include "bitmap.h"
+#include "screenshot.h"
 
 #include "wayland-util.h"
 #ifdef IVI_SHARE_ENABLE
@@ -94,11 +94,14 @@ struct ivishell {
 
     struct wl_listener layer_created;
     struct wl_listener layer_removed;
+
+    struct screenshot_service *screenshot;
 };
 
 struct screenshot_frame_listener {
         struct wl_listener listener;
 	char *filename;
+	struct screenshot_service *service;
 };
 
 static void
@@ -487,71 +490,49 @@ controller_surface_screenshot(struct wl_client *client,
     int32_t result = IVI_FAILED;
     struct ivisurface *ivisurf = wl_resource_get_user_data(resource);
     struct weston_surface *weston_surface = NULL;
-    int32_t width = 0;
-    int32_t height = 0;
-    int32_t stride = 0;
-    int32_t size = 0;
+    struct screenshot_format format = {};
+    struct screenshot_job *job = NULL;
     const struct ivi_layout_interface *lyt = ivisurf->shell->interface;
-    char *buffer = NULL;
-    int32_t image_stride = 0;
-    int32_t image_size = 0;
-    char *image_buffer = NULL;
-    int32_t row = 0;
-    int32_t col = 0;
-    int32_t offset = 0;
-    int32_t image_offset = 0;
-
-    result = lyt->surface_get_size(ivisurf->layout_surface, &width,
-                                   &height, &stride);
+    (void)client;
+
+    result = lyt->surface_get_size(ivisurf->layout_surface, &format.width,
+                                   &format.height, &format.stride);
     if (result != IVI_SUCCEEDED) {
         weston_log("failed to get surface size\n");
         return;
     }
 
-    size = stride * height;
-    image_stride = (((width * 3) + 31) & ~31);
-    image_size = image_stride * height;
+    if (format.width <= 0 || format.height <= 0) {
+        weston_log("surface has no content to take a screenshot of\n");
+        return;
+    }
 
-    buffer = malloc(size);
-    image_buffer = malloc(image_size);
-    if (buffer == NULL || image_buffer == NULL) {
-        free(image_buffer);
-        free(buffer);
+    /* surface_dump gives R, G, B, A rows, top row first */
+    format.bottom_up = false;
+    format.bgra = false;
+    format.bmp_bpp = 24;
+
+    job = screenshot_job_create(ivisurf->shell->screenshot, filename, &format);
+    if (job == NULL) {
         weston_log("failed to allocate memory\n");
         return;
     }
 
     weston_surface = lyt->surface_get_weston_surface(ivisurf->layout_surface);
 
-    result = lyt->surface_dump(weston_surface, buffer, size, 0, 0,
-                               width, height);
+    result = lyt->surface_dump(weston_surface,
+                               screenshot_job_get_pixels(job),
+                               format.stride * format.height, 0, 0,
+                               format.width, format.height);
 
     if (result != IVI_SUCCEEDED) {
-        free(image_buffer);
-        free(buffer);
+        screenshot_job_cancel(job);
         weston_log("failed to dump surface\n");
         return;
     }
 
-    for (row = 0; row < height; ++row) {
-        for (col = 0; col < width; ++col) {
-            offset = row * width + col;
-            image_offset = (height - row - 1) * width + col;
-
-            image_buffer[image_offset * 3] = buffer[offset * 4 + 2];
-            image_buffer[image_offset * 3 + 1] = buffer[offset * 4 + 1];
-            image_buffer[image_offset * 3 + 2] = buffer[offset * 4];
-        }
-    }
-
-    free(buffer);
-
-    if (save_as_bitmap(filename, (const char *)image_buffer,
-                       image_size, width, height, 24) != 0) {
-        weston_log("failed to take screenshot\n");
-    }
-
-    free(image_buffer);
+    /* encoded and written by the screenshot worker */
+    screenshot_job_submit(job);
 }
 
 
@@ -839,38 +820,42 @@ controller_screenshot_notify(struct wl_listener *listener, void *data)
     char *filename = l->filename;
 
     struct weston_output *output = data;
-    int32_t width = 0;
-    int32_t height = 0;
-    int32_t stride = 0;
-    uint8_t *readpixs = NULL;
+    struct weston_compositor *compositor = output->compositor;
+    pixman_format_code_t read_format = compositor->read_format;
+    struct screenshot_format format = {};
+    struct screenshot_job *job = NULL;
 
     --output->disable_planes;
     wl_list_remove(&listener->link);
 
-    width = output->current_mode->width;
-    height = output->current_mode->height;
-    stride = width * (PIXMAN_FORMAT_BPP(output->compositor->read_format) / 8);
-
-    readpixs = malloc(stride * height);
-    if (readpixs == NULL) {
+    format.width = output->current_mode->width;
+    format.height = output->current_mode->height;
+    format.stride = format.width * (PIXMAN_FORMAT_BPP(read_format) / 8);
+    format.bottom_up =
+        (compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP) != 0;
+    format.bgra = read_format == PIXMAN_a8r8g8b8 ||
+                  read_format == PIXMAN_x8r8g8b8;
+    format.bmp_bpp = PIXMAN_FORMAT_BPP(read_format);
+
+    job = screenshot_job_create(l->service, filename, &format);
+    if (job == NULL) {
         weston_log("fails to allocate memory\n");
         free(l->filename);
         free(l);
         return;
     }
 
-    output->compositor->renderer->read_pixels(
+    compositor->renderer->read_pixels(
             output,
-            output->compositor->read_format,
-            readpixs,
+            read_format,
+            screenshot_job_get_pixels(job),
             0,
             0,
-            width,
-            height);
+            format.width,
+            format.height);
 
-    save_as_bitmap(filename, (const char*)readpixs, stride * height, width, height,
-                   PIXMAN_FORMAT_BPP(output->compositor->read_format));
-    free(readpixs);
+    /* only the read back stalls the compositor, the rest is threaded */
+    screenshot_job_submit(job);
     free(l->filename);
     free(l);
 }
@@ -897,6 +882,7 @@ controller_screen_screenshot(struct wl_client *client,
         return;
     }
 
+    l->service = iviscrn->shell->screenshot;
     l->listener.notify = controller_screenshot_notify;
     wl_signal_add(&iviscrn->output->frame_signal, &l->listener);
     iviscrn->output->disable_planes++;
@@ -1534,6 +1520,13 @@ controller_module_init(struct weston_compositor *compositor,
 
     shell->interface = interface;
 
+    shell->screenshot = screenshot_service_create(compositor);
+    if (shell->screenshot == NULL) {
+        weston_log("ivi-controller: failed to start screenshot worker\n");
+        free(shell);
+        return -1;
+    }
+
     init_ivi_shell(compositor, shell);
 
 #ifdef IVI_SHARE_ENABLE
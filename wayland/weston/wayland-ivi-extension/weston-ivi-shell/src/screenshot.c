@@ -0,0 +1,686 @@
+/*
+ * Copyright (C) 2017 NVIDIA Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#if defined(__SSSE3__)
+#  include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#endif
+
+#ifdef HAVE_ZLIB
+#  include <zlib.h>
+#endif
+
+#include <compositor.h>
+
+#include "screenshot.h"
+#include "bitmap.h"
+
+/* free buffers kept around for the next screenshot */
+#define SCREENSHOT_POOL_SIZE 2
+
+/* size of the deflate output, and so of the PNG IDAT chunks */
+#define PNG_IDAT_SIZE (64 * 1024)
+
+enum screenshot_file_type {
+    SCREENSHOT_FILE_BMP,
+    SCREENSHOT_FILE_PNG,
+    SCREENSHOT_FILE_RAW
+};
+
+struct screenshot_buffer {
+    struct wl_list link;
+    size_t size;
+    uint8_t *data;
+};
+
+struct screenshot_job {
+    struct wl_list link;
+    struct screenshot_service *service;
+    char *filename;
+    enum screenshot_file_type type;
+    struct screenshot_format format;
+    struct screenshot_buffer *buffer;
+    int result;
+};
+
+struct screenshot_service {
+    struct weston_compositor *compositor;
+    struct wl_listener destroy_listener;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    struct wl_list queue;       /* jobs waiting for the worker */
+    struct wl_list done;        /* jobs written, waiting to be released */
+    bool stopping;
+
+    int done_fd;
+    struct wl_event_source *done_source;
+
+    /* only touched on the compositor thread */
+    struct wl_list pool;
+    int pool_count;
+};
+
+static void
+put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/*
+ * Copies a row of pixels as R, G, B, A, swapping red and blue if the
+ * capture is B, G, R, A.
+ */
+static void
+copy_row_rgba(uint8_t *dst, const uint8_t *src, int32_t width, bool bgra)
+{
+    int32_t i = 0;
+
+    if (!bgra) {
+        memcpy(dst, src, (size_t)width * 4);
+        return;
+    }
+
+#if defined(__SSSE3__)
+    {
+        const __m128i swap = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                           10, 9, 8, 11, 14, 13, 12, 15);
+
+        for (; i + 4 <= width; i += 4) {
+            __m128i p = _mm_loadu_si128((const __m128i *)(src + i * 4));
+            _mm_storeu_si128((__m128i *)(dst + i * 4),
+                             _mm_shuffle_epi8(p, swap));
+        }
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= width; i += 16) {
+        uint8x16x4_t p = vld4q_u8(src + i * 4);
+        uint8x16_t t = p.val[0];
+
+        p.val[0] = p.val[2];
+        p.val[2] = t;
+        vst4q_u8(dst + i * 4, p);
+    }
+#endif
+
+    for (; i < width; i++) {
+        dst[i * 4] = src[i * 4 + 2];
+        dst[i * 4 + 1] = src[i * 4 + 1];
+        dst[i * 4 + 2] = src[i * 4];
+        dst[i * 4 + 3] = src[i * 4 + 3];
+    }
+}
+
+static const uint8_t *
+source_row(const struct screenshot_job *job, int32_t y)
+{
+    const struct screenshot_format *f = &job->format;
+
+    if (f->bottom_up)
+        y = f->height - 1 - y;
+
+    return job->buffer->data + (size_t)y * f->stride;
+}
+
+static int
+write_raw(FILE *fp, const struct screenshot_job *job)
+{
+    const struct screenshot_format *f = &job->format;
+    size_t row_size = (size_t)f->width * 4;
+    uint8_t *row;
+    int32_t y;
+    int ret = 0;
+
+    row = malloc(row_size);
+    if (row == NULL)
+        return -1;
+
+    for (y = 0; y < f->height; y++) {
+        copy_row_rgba(row, source_row(job, y), f->width, f->bgra);
+        if (fwrite(row, row_size, 1, fp) != 1) {
+            ret = -1;
+            break;
+        }
+    }
+
+    free(row);
+    return ret;
+}
+
+#ifdef HAVE_ZLIB
+static int
+png_write_chunk(FILE *fp, const char *type, const uint8_t *data,
+                uint32_t length)
+{
+    uint8_t be[4];
+    uLong crc;
+
+    /* crc32() restarts when given a NULL buffer, as for IEND */
+    crc = crc32(0, (const Bytef *)type, 4);
+    if (length > 0)
+        crc = crc32(crc, data, length);
+
+    put_be32(be, length);
+    if (fwrite(be, 4, 1, fp) != 1 || fwrite(type, 4, 1, fp) != 1)
+        return -1;
+    if (length > 0 && fwrite(data, length, 1, fp) != 1)
+        return -1;
+    put_be32(be, crc);
+    if (fwrite(be, 4, 1, fp) != 1)
+        return -1;
+
+    return 0;
+}
+
+static int
+png_deflate(FILE *fp, z_stream *zs, uint8_t *out, int flush)
+{
+    size_t have;
+
+    do {
+        zs->next_out = out;
+        zs->avail_out = PNG_IDAT_SIZE;
+        if (deflate(zs, flush) == Z_STREAM_ERROR)
+            return -1;
+
+        have = PNG_IDAT_SIZE - zs->avail_out;
+        if (have > 0 && png_write_chunk(fp, "IDAT", out, have) < 0)
+            return -1;
+    } while (zs->avail_out == 0);
+
+    return 0;
+}
+
+/*
+ * Screenshots are mostly flat UI, for which the "up" filter and the
+ * fastest deflate level compress nearly as well as adaptive filtering at
+ * the default level, for a fraction of the time.
+ */
+static int
+write_png(FILE *fp, const struct screenshot_job *job)
+{
+    static const uint8_t signature[8] = {
+        0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+    };
+    const struct screenshot_format *f = &job->format;
+    size_t row_size = (size_t)f->width * 4;
+    uint8_t ihdr[13];
+    uint8_t *rows, *cur, *prev, *filtered, *idat, *tmp;
+    z_stream zs;
+    int32_t y;
+    size_t i;
+    int ret = -1;
+
+    memset(&zs, 0, sizeof zs);
+    if (deflateInit(&zs, Z_BEST_SPEED) != Z_OK)
+        return -1;
+
+    rows = malloc(row_size * 2 + row_size + 1 + PNG_IDAT_SIZE);
+    if (rows == NULL)
+        goto out;
+
+    cur = rows;
+    prev = rows + row_size;
+    filtered = prev + row_size;
+    idat = filtered + row_size + 1;
+
+    put_be32(ihdr, f->width);
+    put_be32(ihdr + 4, f->height);
+    ihdr[8] = 8;        /* bit depth */
+    ihdr[9] = 6;        /* RGBA */
+    ihdr[10] = 0;       /* deflate */
+    ihdr[11] = 0;       /* adaptive filtering */
+    ihdr[12] = 0;       /* not interlaced */
+
+    if (fwrite(signature, sizeof signature, 1, fp) != 1 ||
+        png_write_chunk(fp, "IHDR", ihdr, sizeof ihdr) < 0)
+        goto out;
+
+    for (y = 0; y < f->height; y++) {
+        copy_row_rgba(cur, source_row(job, y), f->width, f->bgra);
+
+        if (y == 0) {
+            filtered[0] = 0;        /* none */
+            memcpy(filtered + 1, cur, row_size);
+        } else {
+            filtered[0] = 2;        /* up */
+            for (i = 0; i < row_size; i++)
+                filtered[i + 1] = cur[i] - prev[i];
+        }
+
+        zs.next_in = filtered;
+        zs.avail_in = row_size + 1;
+        if (png_deflate(fp, &zs, idat, Z_NO_FLUSH) < 0)
+            goto out;
+
+        tmp = prev;
+        prev = cur;
+        cur = tmp;
+    }
+
+    zs.avail_in = 0;
+    if (png_deflate(fp, &zs, idat, Z_FINISH) < 0)
+        goto out;
+
+    if (png_write_chunk(fp, "IEND", NULL, 0) < 0)
+        goto out;
+
+    ret = 0;
+
+out:
+    deflateEnd(&zs);
+    free(rows);
+    return ret;
+}
+#endif
+
+/* the conversion the surface screenshot used to do inline */
+static int
+write_bmp24(const char *filename, const struct screenshot_job *job)
+{
+    const struct screenshot_format *f = &job->format;
+    int32_t image_stride = (((f->width * 3) + 31) & ~31);
+    int32_t image_size = image_stride * f->height;
+    uint8_t *image;
+    int32_t row, col;
+    int ret;
+
+    image = calloc(1, image_size);
+    if (image == NULL)
+        return -1;
+
+    for (row = 0; row < f->height; ++row) {
+        const uint8_t *src = job->buffer->data + (size_t)row * f->stride;
+        uint8_t *dst = image + (size_t)(f->height - row - 1) * f->width * 3;
+
+        for (col = 0; col < f->width; ++col) {
+            dst[col * 3] = src[col * 4 + 2];
+            dst[col * 3 + 1] = src[col * 4 + 1];
+            dst[col * 3 + 2] = src[col * 4];
+        }
+    }
+
+    ret = save_as_bitmap(filename, (const char *)image, image_size,
+                         f->width, f->height, 24);
+    free(image);
+    return ret;
+}
+
+static int
+write_file(const char *filename, const struct screenshot_job *job)
+{
+    const struct screenshot_format *f = &job->format;
+    FILE *fp;
+    int ret = -1;
+
+    if (job->type == SCREENSHOT_FILE_BMP) {
+        if (f->bmp_bpp == 24)
+            return write_bmp24(filename, job);
+
+        return save_as_bitmap(filename, (const char *)job->buffer->data,
+                              f->stride * f->height, f->width, f->height,
+                              f->bmp_bpp);
+    }
+
+    fp = fopen(filename, "w");
+    if (fp == NULL)
+        return -1;
+
+    switch (job->type) {
+    case SCREENSHOT_FILE_RAW:
+        ret = write_raw(fp, job);
+        break;
+#ifdef HAVE_ZLIB
+    case SCREENSHOT_FILE_PNG:
+        ret = write_png(fp, job);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    if (fclose(fp) != 0)
+        ret = -1;
+
+    return ret;
+}
+
+static void
+encode_job(struct screenshot_job *job)
+{
+    size_t len = strlen(job->filename);
+    char *tmp_name;
+
+    job->result = -1;
+    tmp_name = malloc(len + sizeof ".tmp");
+    if (tmp_name != NULL) {
+        memcpy(tmp_name, job->filename, len);
+        memcpy(tmp_name + len, ".tmp", sizeof ".tmp");
+
+        if (write_file(tmp_name, job) == 0 &&
+            rename(tmp_name, job->filename) == 0)
+            job->result = 0;
+        else
+            unlink(tmp_name);
+
+        free(tmp_name);
+    }
+}
+
+static void *
+screenshot_worker(void *data)
+{
+    struct screenshot_service *service = data;
+    struct screenshot_job *job;
+    uint64_t one = 1;
+
+    pthread_mutex_lock(&service->mutex);
+    for (;;) {
+        while (wl_list_empty(&service->queue) && !service->stopping)
+            pthread_cond_wait(&service->cond, &service->mutex);
+
+        /* pending jobs are still written when stopping */
+        if (wl_list_empty(&service->queue))
+            break;
+
+        job = wl_container_of(service->queue.next, job, link);
+        wl_list_remove(&job->link);
+        pthread_mutex_unlock(&service->mutex);
+
+        encode_job(job);
+
+        pthread_mutex_lock(&service->mutex);
+        wl_list_insert(service->done.prev, &job->link);
+        /* only fails if the counter would overflow, it is drained anyway */
+        (void)write(service->done_fd, &one, sizeof one);
+    }
+    pthread_mutex_unlock(&service->mutex);
+
+    return NULL;
+}
+
+static struct screenshot_buffer *
+get_buffer(struct screenshot_service *service, size_t size)
+{
+    struct screenshot_buffer *buffer;
+
+    wl_list_for_each(buffer, &service->pool, link) {
+        if (buffer->size >= size) {
+            wl_list_remove(&buffer->link);
+            service->pool_count--;
+            return buffer;
+        }
+    }
+
+    buffer = malloc(sizeof *buffer);
+    if (buffer == NULL)
+        return NULL;
+
+    buffer->data = malloc(size);
+    if (buffer->data == NULL) {
+        free(buffer);
+        return NULL;
+    }
+    buffer->size = size;
+
+    return buffer;
+}
+
+static void
+free_buffer(struct screenshot_buffer *buffer)
+{
+    free(buffer->data);
+    free(buffer);
+}
+
+static void
+put_buffer(struct screenshot_service *service,
+           struct screenshot_buffer *buffer)
+{
+    struct screenshot_buffer *pooled, *smallest;
+
+    if (service->pool_count < SCREENSHOT_POOL_SIZE) {
+        wl_list_insert(&service->pool, &buffer->link);
+        service->pool_count++;
+        return;
+    }
+
+    /* keep the larger buffers, they fit any screenshot a smaller one does */
+    smallest = buffer;
+    wl_list_for_each(pooled, &service->pool, link) {
+        if (pooled->size < smallest->size)
+            smallest = pooled;
+    }
+
+    if (smallest != buffer) {
+        wl_list_remove(&smallest->link);
+        wl_list_insert(&service->pool, &buffer->link);
+    }
+    free_buffer(smallest);
+}
+
+static void
+free_job(struct screenshot_job *job)
+{
+    if (job->buffer != NULL)
+        put_buffer(job->service, job->buffer);
+    free(job->filename);
+    free(job);
+}
+
+static void
+release_done_jobs(struct screenshot_service *service)
+{
+    struct screenshot_job *job, *next;
+    struct wl_list done;
+
+    wl_list_init(&done);
+
+    pthread_mutex_lock(&service->mutex);
+    wl_list_insert_list(&done, &service->done);
+    wl_list_init(&service->done);
+    pthread_mutex_unlock(&service->mutex);
+
+    wl_list_for_each_safe(job, next, &done, link) {
+        if (job->result != 0)
+            weston_log("failed to take screenshot %s\n", job->filename);
+
+        free_job(job);
+    }
+}
+
+static int
+screenshot_done(int fd, uint32_t mask, void *data)
+{
+    struct screenshot_service *service = data;
+    uint64_t count;
+    (void)mask;
+
+    if (read(fd, &count, sizeof count) != sizeof count)
+        return 0;
+
+    release_done_jobs(service);
+
+    return 0;
+}
+
+static void
+compositor_destroyed(struct wl_listener *listener, void *data)
+{
+    struct screenshot_service *service =
+        wl_container_of(listener, service, destroy_listener);
+    (void)data;
+
+    screenshot_service_destroy(service);
+}
+
+struct screenshot_service *
+screenshot_service_create(struct weston_compositor *compositor)
+{
+    struct screenshot_service *service;
+    struct wl_event_loop *loop;
+
+    service = calloc(1, sizeof *service);
+    if (service == NULL)
+        return NULL;
+
+    service->compositor = compositor;
+    wl_list_init(&service->queue);
+    wl_list_init(&service->done);
+    wl_list_init(&service->pool);
+    pthread_mutex_init(&service->mutex, NULL);
+    pthread_cond_init(&service->cond, NULL);
+
+    service->done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (service->done_fd < 0)
+        goto err_free;
+
+    loop = wl_display_get_event_loop(compositor->wl_display);
+    service->done_source = wl_event_loop_add_fd(loop, service->done_fd,
+                                                WL_EVENT_READABLE,
+                                                screenshot_done, service);
+    if (service->done_source == NULL)
+        goto err_fd;
+
+    if (pthread_create(&service->thread, NULL,
+                       screenshot_worker, service) != 0)
+        goto err_source;
+
+    service->destroy_listener.notify = compositor_destroyed;
+    wl_signal_add(&compositor->destroy_signal, &service->destroy_listener);
+
+    return service;
+
+err_source:
+    wl_event_source_remove(service->done_source);
+err_fd:
+    close(service->done_fd);
+err_free:
+    pthread_cond_destroy(&service->cond);
+    pthread_mutex_destroy(&service->mutex);
+    free(service);
+    return NULL;
+}
+
+void
+screenshot_service_destroy(struct screenshot_service *service)
+{
+    struct screenshot_buffer *buffer, *next;
+
+    pthread_mutex_lock(&service->mutex);
+    service->stopping = true;
+    pthread_cond_signal(&service->cond);
+    pthread_mutex_unlock(&service->mutex);
+
+    pthread_join(service->thread, NULL);
+    release_done_jobs(service);
+
+    wl_list_for_each_safe(buffer, next, &service->pool, link)
+        free_buffer(buffer);
+
+    wl_list_remove(&service->destroy_listener.link);
+    wl_event_source_remove(service->done_source);
+    close(service->done_fd);
+    pthread_cond_destroy(&service->cond);
+    pthread_mutex_destroy(&service->mutex);
+    free(service);
+}
+
+static enum screenshot_file_type
+file_type_from_name(const char *filename)
+{
+    const char *ext = strrchr(filename, '.');
+
+    if (ext != NULL && strcasecmp(ext, ".raw") == 0)
+        return SCREENSHOT_FILE_RAW;
+
+    if (ext != NULL && strcasecmp(ext, ".png") == 0) {
+#ifdef HAVE_ZLIB
+        return SCREENSHOT_FILE_PNG;
+#else
+        weston_log("ivi-controller: built without zlib, "
+                   "writing %s as bitmap\n", filename);
+#endif
+    }
+
+    return SCREENSHOT_FILE_BMP;
+}
+
+struct screenshot_job *
+screenshot_job_create(struct screenshot_service *service,
+                      const char *filename,
+                      const struct screenshot_format *format)
+{
+    struct screenshot_job *job;
+
+    job = calloc(1, sizeof *job);
+    if (job == NULL)
+        return NULL;
+
+    job->service = service;
+    job->format = *format;
+    job->type = file_type_from_name(filename);
+    job->filename = strdup(filename);
+    job->buffer = get_buffer(service, (size_t)format->stride * format->height);
+    if (job->filename == NULL || job->buffer == NULL) {
+        free_job(job);
+        return NULL;
+    }
+
+    return job;
+}
+
+uint8_t *
+screenshot_job_get_pixels(struct screenshot_job *job)
+{
+    return job->buffer->data;
+}
+
+void
+screenshot_job_submit(struct screenshot_job *job)
+{
+    struct screenshot_service *service = job->service;
+
+    pthread_mutex_lock(&service->mutex);
+    wl_list_insert(service->queue.prev, &job->link);
+    pthread_cond_signal(&service->cond);
+    pthread_mutex_unlock(&service->mutex);
+}
+
+void
+screenshot_job_cancel(struct screenshot_job *job)
+{
+    free_job(job);
+}
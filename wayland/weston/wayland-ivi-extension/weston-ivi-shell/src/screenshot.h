@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2017 NVIDIA Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef IVICONTROLLER_SCREENSHOT_H_
+#define IVICONTROLLER_SCREENSHOT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Screenshots are read back on the compositor thread into a pooled buffer,
+ * then encoded and written by a worker thread, so that the compositor
+ * only stalls for the read back. The file format follows the extension
+ * of the file name:
+ *   .png  PNG, RGBA (only if built with zlib)
+ *   .raw  headerless RGBA rows, top row first
+ *   else  bitmap, byte for byte what save_as_bitmap wrote before
+ * Files are written under a temporary name and renamed once complete.
+ */
+
+struct weston_compositor;
+struct screenshot_service;
+struct screenshot_job;
+
+/* layout of the captured pixels, 32 bits each */
+struct screenshot_format {
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    bool bottom_up;     /* the first row in memory is the bottom one */
+    bool bgra;          /* bytes are B, G, R, A rather than R, G, B, A */
+    int16_t bmp_bpp;    /* 32: bitmap of the rows as captured,
+                           24: flipped and converted to BGR */
+};
+
+struct screenshot_service *
+screenshot_service_create(struct weston_compositor *compositor);
+
+void
+screenshot_service_destroy(struct screenshot_service *service);
+
+struct screenshot_job *
+screenshot_job_create(struct screenshot_service *service,
+                      const char *filename,
+                      const struct screenshot_format *format);
+
+/* stride * height bytes to capture into */
+uint8_t *
+screenshot_job_get_pixels(struct screenshot_job *job);
+
+/* hands the job over to the worker; the job must not be used after */
+void
+screenshot_job_submit(struct screenshot_job *job);
+
+void
+screenshot_job_cancel(struct screenshot_job *job);
+
+#endif /* IVICONTROLLER_SCREENSHOT_H_*/
@@ -36,17 +36,19 @@
 #include <string.h>
 #include <fcntl.h>
 #include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
 
 #include <cairo.h>
 
 #include "wcap-decode.h"
 
 static void
-write_png(struct wcap_decoder *decoder, const char *filename)
+write_png(struct wcap_decoder *decoder, uint32_t *frame, const char *filename)
 {
 	cairo_surface_t *surface;
 
-	surface = cairo_image_surface_create_for_data((unsigned char *) decoder->frame,
+	surface = cairo_image_surface_create_for_data((unsigned char *) frame,
 						      CAIRO_FORMAT_ARGB32,
 						      decoder->width,
 						      decoder->height,
@@ -99,7 +101,8 @@ int clamp_uv(int u)
 }
 
 static void
-convert_to_yv12(struct wcap_decoder *decoder, unsigned char *out)
+convert_to_yv12(struct wcap_decoder *decoder, uint32_t *frame,
+		unsigned char *out)
 {
 	unsigned char *y1, *y2, *u, *v;
 	uint32_t *p1, *p2, *end;
@@ -113,7 +116,7 @@ convert_to_yv12(struct wcap_decoder *decoder, unsigned char *out)
 		y2 = y1 + stride0;
 		v = out + stride0 * decoder->height + stride1 * i / 2;
 		u = v + stride1 * decoder->height / 2;
-		p1 = decoder->frame + decoder->width * i;
+		p1 = frame + decoder->width * i;
 		p2 = p1 + decoder->width;
 		end = p1 + decoder->width;
 
@@ -138,7 +141,8 @@ convert_to_yv12(struct wcap_decoder *decoder, unsigned char *out)
 }
 
 static void
-convert_to_yuv444(struct wcap_decoder *decoder, unsigned char *out)
+convert_to_yuv444(struct wcap_decoder *decoder, uint32_t *frame,
+		  unsigned char *out)
 {
 
 	unsigned char *yp, *up, *vp;
@@ -153,7 +157,7 @@ convert_to_yuv444(struct wcap_decoder *decoder, unsigned char *out)
 		yp = out + stride * i;
 		up = yp + (psize * 2);
 		vp = yp + (psize * 1);
-		rp = decoder->frame + decoder->width * i;
+		rp = frame + decoder->width * i;
 		end = rp + decoder->width;
 		while (rp < end) {
 			u = 0;
@@ -170,7 +174,7 @@ convert_to_yuv444(struct wcap_decoder *decoder, unsigned char *out)
 }
 
 static void
-output_yuv_frame(struct wcap_decoder *decoder, int depth)
+output_yuv_frame(struct wcap_decoder *decoder, uint32_t *frame, int depth)
 {
 	static unsigned char *out;
 	int size;
@@ -184,28 +188,200 @@ output_yuv_frame(struct wcap_decoder *decoder, int depth)
 		out = malloc(size);
 
 	if (depth == 444) {
-		convert_to_yuv444(decoder, out);
+		convert_to_yuv444(decoder, frame, out);
 	} else {
-		convert_to_yv12(decoder, out);
+		convert_to_yv12(decoder, frame, out);
 	}
 
 	printf("FRAME\n");
 	fwrite(out, 1, size, stdout);
 }
 
+struct output {
+	struct wcap_decoder *decoder;
+	int yuv4mpeg2;
+	int all, frame;
+};
+
+static void
+write_frame(struct output *output, uint32_t *frame, int i)
+{
+	char filename[200];
+
+	if (output->all || i == output->frame) {
+		snprintf(filename, sizeof filename, "wcap-frame-%d.png", i);
+		write_png(output->decoder, frame, filename);
+		fprintf(stderr, "wrote %s\n", filename);
+	}
+	if (output->yuv4mpeg2)
+		output_yuv_frame(output->decoder, frame, output->yuv4mpeg2);
+}
+
+/* With several threads, frames are converted and written by a thread of
+ * their own while the next ones are decoded, in the order they come. */
+#define WRITER_QUEUE_LENGTH 4
+
+struct writer {
+	struct output *output;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	uint32_t *frames[WRITER_QUEUE_LENGTH];
+	int numbers[WRITER_QUEUE_LENGTH];
+	int head, tail;		/* queued frames are head .. tail - 1 */
+	bool done;
+};
+
+static void *
+writer_thread(void *data)
+{
+	struct writer *writer = data;
+	int slot;
+
+	pthread_mutex_lock(&writer->mutex);
+	while (1) {
+		while (!writer->done && writer->head == writer->tail)
+			pthread_cond_wait(&writer->cond, &writer->mutex);
+		if (writer->head == writer->tail)
+			break;
+
+		slot = writer->head % WRITER_QUEUE_LENGTH;
+		pthread_mutex_unlock(&writer->mutex);
+
+		write_frame(writer->output, writer->frames[slot],
+			    writer->numbers[slot]);
+
+		pthread_mutex_lock(&writer->mutex);
+		writer->head++;
+		pthread_cond_signal(&writer->cond);
+	}
+	pthread_mutex_unlock(&writer->mutex);
+
+	return NULL;
+}
+
+static struct writer *
+writer_create(struct output *output)
+{
+	struct wcap_decoder *decoder = output->decoder;
+	struct writer *writer;
+	int i;
+
+	writer = calloc(1, sizeof *writer);
+	if (writer == NULL)
+		return NULL;
+
+	/* convert_to_yv12() reads a row and a pixel past odd sized frames */
+	writer->output = output;
+	for (i = 0; i < WRITER_QUEUE_LENGTH; i++) {
+		writer->frames[i] = calloc(decoder->width * (decoder->height + 1)
+					   + 1, 4);
+		if (writer->frames[i] == NULL)
+			goto err;
+	}
+
+	pthread_mutex_init(&writer->mutex, NULL);
+	pthread_cond_init(&writer->cond, NULL);
+	if (pthread_create(&writer->thread, NULL, writer_thread, writer) != 0) {
+		pthread_cond_destroy(&writer->cond);
+		pthread_mutex_destroy(&writer->mutex);
+		goto err;
+	}
+
+	return writer;
+
+err:
+	for (i = 0; i < WRITER_QUEUE_LENGTH; i++)
+		free(writer->frames[i]);
+	free(writer);
+
+	return NULL;
+}
+
+static void
+writer_queue(struct writer *writer, int i)
+{
+	struct wcap_decoder *decoder = writer->output->decoder;
+	int slot;
+
+	pthread_mutex_lock(&writer->mutex);
+	while (writer->tail - writer->head == WRITER_QUEUE_LENGTH)
+		pthread_cond_wait(&writer->cond, &writer->mutex);
+	pthread_mutex_unlock(&writer->mutex);
+
+	/* the writer does not touch the free slots */
+	slot = writer->tail % WRITER_QUEUE_LENGTH;
+	memcpy(writer->frames[slot], decoder->frame,
+	       decoder->width * decoder->height * 4);
+	writer->numbers[slot] = i;
+
+	pthread_mutex_lock(&writer->mutex);
+	writer->tail++;
+	pthread_cond_signal(&writer->cond);
+	pthread_mutex_unlock(&writer->mutex);
+}
+
+static void
+writer_destroy(struct writer *writer)
+{
+	int i;
+
+	pthread_mutex_lock(&writer->mutex);
+	writer->done = true;
+	pthread_cond_signal(&writer->cond);
+	pthread_mutex_unlock(&writer->mutex);
+
+	pthread_join(writer->thread, NULL);
+
+	pthread_cond_destroy(&writer->cond);
+	pthread_mutex_destroy(&writer->mutex);
+	for (i = 0; i < WRITER_QUEUE_LENGTH; i++)
+		free(writer->frames[i]);
+	free(writer);
+}
+
+/* Finds which capture frame becomes output frame i at the replay rate,
+ * from the timestamps in the index. Returns -1 past the end. */
+static int
+find_frame(struct wcap_decoder *decoder, int i, uint32_t frame_time)
+{
+	uint32_t k = 0, msecs;
+	int n;
+
+	if (decoder->nframes == 0)
+		return -1;
+
+	msecs = decoder->index[0].msecs;
+	for (n = 0; n < i; n++) {
+		msecs += frame_time;
+		while (decoder->index[k].msecs < msecs) {
+			if (k + 1 == decoder->nframes)
+				return -1;
+			k++;
+		}
+	}
+
+	return k;
+}
+
 static void
 usage(int exit_code)
 {
 	fprintf(stderr, "usage: wcap-decode "
 		"[--help] [--yuv4mpeg2] [--frame=<frame>] [--all] \n"
-		"\t[--rate=<num:denom>] <wcap file>\n\n"
+		"\t[--rate=<num:denom>] [--threads=<n>] [--index] <wcap file>\n\n"
 		"\t--help\t\t\tthis help text\n"
 		"\t--yuv4mpeg2\t\tdump wcap file to stdout in yuv4mpeg2 format\n"
 		"\t--yuv4mpeg2-444\t\tdump wcap file to stdout in yuv4mpeg2 444 format\n"
 		"\t--frame=<frame>\t\twrite out the given frame number as png\n"
 		"\t--all\t\t\twrite all frames as pngs\n"
 		"\t--rate=<num:denom>\treplay frame rate for yuv4mpeg2,\n"
-		"\t\t\t\tspecified as an integer fraction\n\n");
+		"\t\t\t\tspecified as an integer fraction\n"
+		"\t--threads=<n>\t\tdecode on n threads and write frames\n"
+		"\t\t\t\twhile the next ones are decoded\n"
+		"\t--index\t\t\tindex the frames, cached in <wcap file>.idx,\n"
+		"\t\t\t\tto extract a single frame without writing\n"
+		"\t\t\t\tthe ones before it\n\n");
 
 	exit(exit_code);
 }
@@ -213,10 +389,11 @@ usage(int exit_code)
 int main(int argc, char *argv[])
 {
 	struct wcap_decoder *decoder;
+	struct output output;
+	struct writer *writer = NULL;
 	int i, j, output_frame = -1, yuv4mpeg2 = 0, all = 0, has_frame;
-	int num = 30, denom = 1;
-	char filename[200];
-	char *mode;
+	int num = 30, denom = 1, nthreads = 1, use_index = 0, target;
+	char *mode, *cache;
 	uint32_t msecs, frame_time;
 
 	for (i = 1, j = 1; i < argc; i++) {
@@ -228,8 +405,12 @@ int main(int argc, char *argv[])
 			usage(EXIT_SUCCESS);
 		} else if (strcmp(argv[i], "--all") == 0) {
 			all = 1;
+		} else if (strcmp(argv[i], "--index") == 0) {
+			use_index = 1;
 		} else if (sscanf(argv[i], "--frame=%d", &output_frame) == 1) {
 			;
+		} else if (sscanf(argv[i], "--threads=%d", &nthreads) == 1) {
+			;
 		} else if (sscanf(argv[i], "--rate=%d", &num) == 1) {
 			;
 		} else if (sscanf(argv[i], "--rate=%d:%d", &num, &denom) == 2) {
@@ -252,6 +433,10 @@ int main(int argc, char *argv[])
 		fprintf(stderr, "invalid rate, denom can not be 0\n");
 		exit(EXIT_FAILURE);
 	}
+	if (nthreads < 1) {
+		fprintf(stderr, "invalid number of threads\n");
+		exit(EXIT_FAILURE);
+	}
 
 	decoder = wcap_decoder_create(argv[1]);
 	if (decoder == NULL) {
@@ -268,6 +453,41 @@ int main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 
+	if (wcap_decoder_set_threads(decoder, nthreads) < 0)
+		fprintf(stderr, "failed to start decoding threads\n");
+
+	frame_time = 1000 * denom / num;
+
+	if (use_index) {
+		if (asprintf(&cache, "%s.idx", argv[1]) < 0 ||
+		    wcap_decoder_load_index(decoder, cache) < 0) {
+			fprintf(stderr, "indexing the wcap file failed\n");
+			exit(EXIT_FAILURE);
+		}
+		free(cache);
+
+		/* only one frame to write, skip straight to it */
+		if (!all && !yuv4mpeg2 && output_frame >= 0) {
+			target = find_frame(decoder, output_frame,
+					    frame_time);
+			if (target >= 0 &&
+			    wcap_decoder_seek(decoder, target) == 0) {
+				output.decoder = decoder;
+				output.yuv4mpeg2 = 0;
+				output.all = 0;
+				output.frame = output_frame;
+				write_frame(&output, decoder->frame,
+					    output_frame);
+			}
+			fprintf(stderr, "wcap file: size %dx%d, %u frames "
+				"recorded\n", decoder->width, decoder->height,
+				decoder->nframes);
+			wcap_decoder_destroy(decoder);
+
+			return EXIT_SUCCESS;
+		}
+	}
+
 	if (yuv4mpeg2) {
 		if (yuv4mpeg2 == 444) {
 			mode = "C444";
@@ -279,25 +499,30 @@ int main(int argc, char *argv[])
 		fflush(stdout);
 	}
 
+	output.decoder = decoder;
+	output.yuv4mpeg2 = yuv4mpeg2;
+	output.all = all;
+	output.frame = output_frame;
+	if (nthreads > 1 && (all || yuv4mpeg2))
+		writer = writer_create(&output);
+
 	i = 0;
 	has_frame = wcap_decoder_get_frame(decoder);
 	msecs = decoder->msecs;
-	frame_time = 1000 * denom / num;
 	while (has_frame) {
-		if (all || i == output_frame) {
-			snprintf(filename, sizeof filename,
-				 "wcap-frame-%d.png", i);
-			write_png(decoder, filename);
-			fprintf(stderr, "wrote %s\n", filename);
-		}
-		if (yuv4mpeg2)
-			output_yuv_frame(decoder, yuv4mpeg2);
+		if (writer)
+			writer_queue(writer, i);
+		else
+			write_frame(&output, decoder->frame, i);
 		i++;
 		msecs += frame_time;
 		while (decoder->msecs < msecs && has_frame)
 			has_frame = wcap_decoder_get_frame(decoder);
 	}
 
+	if (writer)
+		writer_destroy(writer);
+
 	fprintf(stderr, "wcap file: size %dx%d, %d frames\n",
 		decoder->width, decoder->height, i);
 
@@ -28,31 +28,132 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
-#include <sys/mman.h>
+#include <stdbool.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <string.h>
 #include <fcntl.h>
+#include <pthread.h>
 
-#include <cairo.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
 
 #include "wcap-decode.h"
 
-static void
-wcap_decoder_decode_rectangle(struct wcap_decoder *decoder,
-			      struct wcap_rectangle *rect)
+#define WCAP_INDEX_MAGIC	0x58494357	/* "WCIX" */
+#define WCAP_INDEX_VERSION	1
+
+/* frames smaller than this are not worth waking the threads for */
+#define PARALLEL_MIN_PIXELS	(128 * 128)
+/* larger rectangles are split in spans of about this many pixels */
+#define PARALLEL_SPAN_PIXELS	(64 * 1024)
+
+struct wcap_index_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t capture_size;
+	int64_t capture_mtime_sec;
+	int64_t capture_mtime_nsec;
+	uint32_t nframes;
+	uint32_t reserved;
+};
+
+/* part of a rectangle, see decode_span() */
+struct rect_job {
+	const struct wcap_rectangle *rect;
+	const uint32_t *data;
+	int first;
+	int count;
+	int skip;
+};
+
+struct wcap_worker_pool {
+	struct wcap_decoder *decoder;
+	pthread_t *threads;
+	int nthreads;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+	struct rect_job *jobs;
+	uint32_t jobs_size;
+	uint32_t njobs;
+	uint32_t next;		/* first job not taken yet */
+	uint32_t pending;	/* jobs not finished yet */
+	bool stop;
+};
+
+/* bytewise add without carries between the bytes */
+static inline uint32_t
+add_delta(uint32_t pixel, uint32_t delta)
+{
+	delta &= 0x00ffffff;
+
+	return (((pixel & 0x7f7f7f7f) + (delta & 0x7f7f7f7f)) ^
+		((pixel ^ delta) & 0x80808080)) | 0xff000000;
+}
+
+/* Adds the delta to the R, G and B bytes of n pixels and sets X to 0xff,
+ * the same as doing it component by component. */
+static inline void
+apply_delta(uint32_t *d, int n, uint32_t delta)
 {
-	uint32_t v, *p = decoder->p, *d;
-	int width = rect->x2 - rect->x1, height = rect->y2 - rect->y1;
-	int x, i, j, k, l, count = width * height;
-	unsigned char r, g, b, dr, dg, db;
+	delta &= 0x00ffffff;
 
-	d = decoder->frame + (rect->y2 - 1) * decoder->width;
-	x = rect->x1;
+#if defined(__SSE2__)
+	{
+		__m128i dv = _mm_set1_epi32(delta);
+		__m128i alpha = _mm_set1_epi32(0xff000000);
+		__m128i x;
+
+		for (; n >= 4; n -= 4, d += 4) {
+			x = _mm_loadu_si128((const __m128i *) d);
+			x = _mm_or_si128(_mm_add_epi8(x, dv), alpha);
+			_mm_storeu_si128((__m128i *) d, x);
+		}
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	{
+		uint8x16_t dv = vreinterpretq_u8_u32(vdupq_n_u32(delta));
+		uint8x16_t alpha =
+			vreinterpretq_u8_u32(vdupq_n_u32(0xff000000));
+		uint8x16_t x;
+
+		for (; n >= 4; n -= 4, d += 4) {
+			x = vld1q_u8((const uint8_t *) d);
+			x = vorrq_u8(vaddq_u8(x, dv), alpha);
+			vst1q_u8((uint8_t *) d, x);
+		}
+	}
+#endif
+
+	for (; n > 0; n--, d++)
+		*d = add_delta(*d, delta);
+}
+
+/* Decodes count pixels of a rectangle, from pixel first in encoding
+ * order, whose run-length encoded data starts at p with skip pixels of
+ * the first run already decoded. Returns where the data ends. Rectangles
+ * of a frame do not overlap, so they, and spans of one, can be decoded
+ * in any order. */
+static const uint32_t *
+decode_span(struct wcap_decoder *decoder, const struct wcap_rectangle *rect,
+	    int first, int count, int skip,
+	    const uint32_t *p, const uint32_t *end)
+{
+	uint32_t v, *d;
+	int width = rect->x2 - rect->x1;
+	int x, i, j, n, l;
+
+	d = decoder->frame + (rect->y2 - 1 - first / width) * decoder->width;
+	x = rect->x1 + first % width;
 	i = 0;
-	while (i < count) {
+	while (i < count && p < end) {
 		v = *p++;
 		l = v >> 24;
 		if (l < 0xe0) {
@@ -60,53 +161,551 @@ wcap_decoder_decode_rectangle(struct wcap_decoder *decoder,
 		} else {
 			j = 1 << (l - 0xe0 + 7);
 		}
+		j -= skip;
+		skip = 0;
+
+		if (j > count - i) {
+			if (first + count == width * (rect->y2 - rect->y1))
+				printf("rle encoding longer than expected "
+				       "(%d expected %d)\n",
+				       first + i + j, first + count);
+			j = count - i;
+		}
+		i += j;
 
-		dr = (v >> 16);
-		dg = (v >>  8);
-		db = (v >>  0);
-		for (k = 0; k < j; k++) {
-			r = (d[x] >> 16) + dr;
-			g = (d[x] >>  8) + dg;
-			b = (d[x] >>  0) + db;
-			d[x] = 0xff000000 | (r << 16) | (g << 8) | b;
-			x++;
+		/* a run can wrap around several rows */
+		while (j > 0) {
+			n = rect->x2 - x;
+			if (n > j)
+				n = j;
+
+			if (n == 1)
+				d[x] = add_delta(d[x], v);
+			else
+				apply_delta(d + x, n, v);
+			x += n;
+			j -= n;
 			if (x == rect->x2) {
 				x = rect->x1;
 				d -= decoder->width;
 			}
 		}
-		i += j;
 	}
 
 	if (i != count)
-		printf("rle encoding longer than expected (%d expected %d)\n",
-		       i, count);
+		printf("rle encoding shorter than expected (%d expected %d)\n",
+		       first + i, first + count);
+
+	return p;
+}
+
+static const uint32_t *
+decode_rectangle(struct wcap_decoder *decoder,
+		 const struct wcap_rectangle *rect,
+		 const uint32_t *p, const uint32_t *end)
+{
+	return decode_span(decoder, rect, 0,
+			   (rect->x2 - rect->x1) * (rect->y2 - rect->y1), 0,
+			   p, end);
+}
+
+/* Where the encoded pixels of a rectangle end, without decoding them. */
+static const uint32_t *
+skip_rectangle(const struct wcap_rectangle *rect,
+	       const uint32_t *p, const uint32_t *end)
+{
+	int64_t count = (int64_t) (rect->x2 - rect->x1) *
+		(rect->y2 - rect->y1);
+	int l;
+
+	while (count > 0 && p < end) {
+		l = *p++ >> 24;
+		if (l < 0xe0)
+			count -= l + 1;
+		else
+			count -= 1 << (l - 0xe0 + 7);
+	}
+
+	return count > 0 ? NULL : p;
+}
+
+static bool
+rectangle_is_valid(struct wcap_decoder *decoder,
+		   const struct wcap_rectangle *rect)
+{
+	return rect->x1 >= 0 && rect->y1 >= 0 &&
+	       rect->x1 < rect->x2 && rect->y1 < rect->y2 &&
+	       rect->x2 <= decoder->width && rect->y2 <= decoder->height;
+}
+
+/* Checks the header and rectangles of the frame at p, returns the
+ * rectangles or NULL. */
+static const struct wcap_rectangle *
+frame_rectangles(struct wcap_decoder *decoder, const void *p,
+		 const struct wcap_frame_header **header_out)
+{
+	const struct wcap_frame_header *header = p;
+	const struct wcap_rectangle *rects = (const void *) (header + 1);
+	size_t left = (const char *) decoder->end - (const char *) p;
+	uint32_t i;
+
+	if (left < sizeof *header ||
+	    (left - sizeof *header) / sizeof *rects < header->nrects)
+		return NULL;
+
+	for (i = 0; i < header->nrects; i++)
+		if (!rectangle_is_valid(decoder, &rects[i]))
+			return NULL;
+
+	*header_out = header;
+
+	return rects;
+}
+
+static void
+pool_run_jobs(struct wcap_worker_pool *pool)
+{
+	struct wcap_decoder *decoder = pool->decoder;
+	struct rect_job *job;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->next < pool->njobs) {
+		job = &pool->jobs[pool->next++];
+		pthread_mutex_unlock(&pool->mutex);
+
+		decode_span(decoder, job->rect, job->first, job->count,
+			    job->skip, job->data, decoder->end);
+
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->pending == 0)
+			pthread_cond_signal(&pool->done_cond);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+static void *
+pool_worker(void *data)
+{
+	struct wcap_worker_pool *pool = data;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (1) {
+		while (!pool->stop && pool->next == pool->njobs)
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+		if (pool->stop)
+			break;
+
+		pthread_mutex_unlock(&pool->mutex);
+		pool_run_jobs(pool);
+		pthread_mutex_lock(&pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+static void
+pool_destroy(struct wcap_worker_pool *pool)
+{
+	int i;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (i = 0; i < pool->nthreads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->threads);
+	free(pool->jobs);
+	free(pool);
+}
+
+static struct wcap_worker_pool *
+pool_create(struct wcap_decoder *decoder, int nthreads)
+{
+	struct wcap_worker_pool *pool;
+
+	pool = calloc(1, sizeof *pool);
+	if (pool == NULL)
+		return NULL;
+
+	pool->decoder = decoder;
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->work_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	pool->threads = calloc(nthreads, sizeof *pool->threads);
+	if (pool->threads == NULL) {
+		pool_destroy(pool);
+		return NULL;
+	}
+
+	/* the thread calling into the decoder works too */
+	for (pool->nthreads = 0; pool->nthreads < nthreads - 1;
+	     pool->nthreads++) {
+		if (pthread_create(&pool->threads[pool->nthreads], NULL,
+				   pool_worker, pool) != 0) {
+			pool_destroy(pool);
+			return NULL;
+		}
+	}
+
+	return pool;
+}
+
+/* The workers do not look at the jobs while pool->njobs is 0. */
+static struct rect_job *
+add_job(struct wcap_worker_pool *pool, uint32_t *njobs)
+{
+	struct rect_job *jobs;
+	uint32_t size;
+
+	if (*njobs == pool->jobs_size) {
+		size = pool->jobs_size ? pool->jobs_size * 2 : 64;
+		jobs = realloc(pool->jobs, size * sizeof *jobs);
+		if (jobs == NULL)
+			return NULL;
+		pool->jobs = jobs;
+		pool->jobs_size = size;
+	}
+
+	return &pool->jobs[(*njobs)++];
+}
+
+/* Cuts the rectangles in spans, walking the runs once to find where
+ * each span starts. Returns where the frame ends. */
+static const uint32_t *
+split_rectangles(struct wcap_decoder *decoder,
+		 const struct wcap_rectangle *rects, uint32_t nrects,
+		 const uint32_t *p, uint32_t *njobs)
+{
+	struct wcap_worker_pool *pool = decoder->pool;
+	struct rect_job *job;
+	uint32_t i;
+	int count, done, next, j, l;
+
+	*njobs = 0;
+	for (i = 0; i < nrects; i++) {
+		count = (rects[i].x2 - rects[i].x1) *
+			(rects[i].y2 - rects[i].y1);
+		done = 0;
+		next = 0;
+		while (done < count) {
+			if (p == decoder->end)
+				return NULL;
+
+			l = *p >> 24;
+			if (l < 0xe0)
+				j = l + 1;
+			else
+				j = 1 << (l - 0xe0 + 7);
 
-	decoder->p = p;
+			/* a span starts inside this run */
+			while (next < count && next < done + j) {
+				job = add_job(pool, njobs);
+				if (job == NULL)
+					return NULL;
+				job->rect = &rects[i];
+				job->data = p;
+				job->first = next;
+				job->skip = next - done;
+				job->count = count - next;
+				if (job->count > PARALLEL_SPAN_PIXELS)
+					job->count = PARALLEL_SPAN_PIXELS;
+				next += job->count;
+			}
+
+			done += j;
+			p++;
+		}
+	}
+
+	return p;
+}
+
+/* Decodes the rectangles on the pool, returns where the frame ends. */
+static const uint32_t *
+decode_rectangles_parallel(struct wcap_decoder *decoder,
+			   const struct wcap_rectangle *rects,
+			   uint32_t nrects, const uint32_t *p)
+{
+	struct wcap_worker_pool *pool = decoder->pool;
+	uint32_t njobs;
+
+	p = split_rectangles(decoder, rects, nrects, p, &njobs);
+	if (p == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->njobs = njobs;
+	pool->next = 0;
+	pool->pending = njobs;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	pool_run_jobs(pool);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->pending > 0)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	pool->njobs = 0;
+	pool->next = 0;
+	pthread_mutex_unlock(&pool->mutex);
+
+	return p;
 }
 
 int
 wcap_decoder_get_frame(struct wcap_decoder *decoder)
 {
-	struct wcap_rectangle *rects;
-	struct wcap_frame_header *header;
+	const struct wcap_rectangle *rects;
+	const struct wcap_frame_header *header;
+	const uint32_t *p;
+	uint64_t pixels = 0;
 	uint32_t i;
 
 	if (decoder->p == decoder->end)
 		return 0;
 
-	header = decoder->p;
+	rects = frame_rectangles(decoder, decoder->p, &header);
+	if (rects == NULL) {
+		printf("invalid frame header at offset %ld\n",
+		       (long) ((char *) decoder->p - (char *) decoder->map));
+		decoder->p = decoder->end;
+		return 0;
+	}
+
 	decoder->msecs = header->msecs;
 	decoder->count++;
 
-	rects = (void *) (header + 1);
-	decoder->p = (uint32_t *) (rects + header->nrects);
-	for (i = 0; i < header->nrects; i++)
-		wcap_decoder_decode_rectangle(decoder, &rects[i]);
+	p = (const uint32_t *) (rects + header->nrects);
+
+	if (decoder->pool) {
+		for (i = 0; i < header->nrects; i++)
+			pixels += (uint64_t) (rects[i].x2 - rects[i].x1) *
+				(rects[i].y2 - rects[i].y1);
+	}
+
+	if (pixels >= PARALLEL_MIN_PIXELS) {
+		p = decode_rectangles_parallel(decoder, rects,
+					       header->nrects, p);
+	} else {
+		for (i = 0; i < header->nrects; i++)
+			p = decode_rectangle(decoder, &rects[i], p,
+					     decoder->end);
+	}
+
+	decoder->p = p ? (void *) p : decoder->end;
 
 	return 1;
 }
 
+int
+wcap_decoder_set_threads(struct wcap_decoder *decoder, int nthreads)
+{
+	if (decoder->pool) {
+		pool_destroy(decoder->pool);
+		decoder->pool = NULL;
+	}
+
+	if (nthreads <= 1)
+		return 0;
+
+	decoder->pool = pool_create(decoder, nthreads);
+
+	return decoder->pool ? 0 : -1;
+}
+
+static void
+index_header_init(struct wcap_decoder *decoder,
+		  struct wcap_index_header *header)
+{
+	struct stat buf;
+
+	memset(header, 0, sizeof *header);
+	header->magic = WCAP_INDEX_MAGIC;
+	header->version = WCAP_INDEX_VERSION;
+	header->capture_size = decoder->size;
+	if (fstat(decoder->fd, &buf) == 0) {
+		header->capture_mtime_sec = buf.st_mtim.tv_sec;
+		header->capture_mtime_nsec = buf.st_mtim.tv_nsec;
+	}
+}
+
+static int
+index_read(struct wcap_decoder *decoder, const char *filename)
+{
+	struct wcap_index_header expected, header;
+	struct wcap_frame_index *index;
+	FILE *fp;
+	int ret = -1;
+
+	fp = fopen(filename, "rb");
+	if (fp == NULL)
+		return -1;
+
+	index_header_init(decoder, &expected);
+	if (fread(&header, sizeof header, 1, fp) != 1 ||
+	    header.magic != expected.magic ||
+	    header.version != expected.version ||
+	    header.capture_size != expected.capture_size ||
+	    header.capture_mtime_sec != expected.capture_mtime_sec ||
+	    header.capture_mtime_nsec != expected.capture_mtime_nsec ||
+	    header.nframes > decoder->size / sizeof(struct wcap_frame_header))
+		goto out;
+
+	index = malloc((header.nframes + 1) * sizeof *index);
+	if (index == NULL)
+		goto out;
+
+	if (fread(index, sizeof *index, header.nframes, fp) !=
+	    header.nframes) {
+		free(index);
+		goto out;
+	}
+
+	decoder->index = index;
+	decoder->nframes = header.nframes;
+	ret = 0;
+
+out:
+	fclose(fp);
+
+	return ret;
+}
+
+static void
+index_write(struct wcap_decoder *decoder, const char *filename)
+{
+	struct wcap_index_header header;
+	char *tmp;
+	FILE *fp;
+	bool ok;
+
+	if (asprintf(&tmp, "%s.tmp", filename) < 0)
+		return;
+
+	fp = fopen(tmp, "wb");
+	if (fp == NULL) {
+		free(tmp);
+		return;
+	}
+
+	index_header_init(decoder, &header);
+	header.nframes = decoder->nframes;
+
+	ok = fwrite(&header, sizeof header, 1, fp) == 1 &&
+	     fwrite(decoder->index, sizeof *decoder->index,
+		    decoder->nframes, fp) == decoder->nframes;
+	ok = fclose(fp) == 0 && ok;
+
+	/* a cache is best effort, a reader never sees half of one */
+	if (!ok || rename(tmp, filename) < 0)
+		unlink(tmp);
+	free(tmp);
+}
+
+static int
+index_build(struct wcap_decoder *decoder)
+{
+	const struct wcap_frame_header *header;
+	const struct wcap_rectangle *rects;
+	struct wcap_frame_index *index = NULL, *tmp;
+	const uint32_t *p;
+	const void *frame;
+	uint32_t n = 0, size = 0, i;
+
+	frame = (const struct wcap_header *) decoder->map + 1;
+	while (frame != decoder->end) {
+		rects = frame_rectangles(decoder, frame, &header);
+		if (rects == NULL)
+			break;
+
+		p = (const uint32_t *) (rects + header->nrects);
+		for (i = 0; i < header->nrects && p; i++)
+			p = skip_rectangle(&rects[i], p, decoder->end);
+		if (p == NULL)
+			break;
+
+		if (n == size) {
+			size = size ? size * 2 : 256;
+			tmp = realloc(index, (size + 1) * sizeof *index);
+			if (tmp == NULL) {
+				free(index);
+				return -1;
+			}
+			index = tmp;
+		}
+
+		index[n].offset = (const char *) frame -
+			(const char *) decoder->map;
+		index[n].msecs = header->msecs;
+		index[n].nrects = header->nrects;
+		n++;
+
+		frame = p;
+	}
+
+	if (frame != decoder->end)
+		fprintf(stderr, "capture truncated after %u frames\n", n);
+
+	if (index == NULL)
+		index = malloc(sizeof *index);
+	if (index == NULL)
+		return -1;
+
+	decoder->index = index;
+	decoder->nframes = n;
+
+	return 0;
+}
+
+int
+wcap_decoder_load_index(struct wcap_decoder *decoder,
+			const char *cache_filename)
+{
+	if (decoder->index)
+		return 0;
+
+	if (cache_filename && index_read(decoder, cache_filename) == 0)
+		return 0;
+
+	if (index_build(decoder) < 0)
+		return -1;
+
+	if (cache_filename)
+		index_write(decoder, cache_filename);
+
+	return 0;
+}
+
+int
+wcap_decoder_seek(struct wcap_decoder *decoder, uint32_t frame)
+{
+	if (decoder->index == NULL || frame >= decoder->nframes)
+		return -1;
+
+	/* the decoded frame is frame count - 1 */
+	if (decoder->count > frame + 1) {
+		memset(decoder->frame, 0,
+		       decoder->width * decoder->height * 4);
+		decoder->p = (struct wcap_header *) decoder->map + 1;
+		decoder->count = 0;
+	}
+
+	while (decoder->count < frame + 1) {
+		if (!wcap_decoder_get_frame(decoder))
+			return -1;
+	}
+
+	return 0;
+}
+
 struct wcap_decoder *
 wcap_decoder_create(const char *filename)
 {
@@ -115,7 +714,7 @@ wcap_decoder_create(const char *filename)
 	int frame_size;
 	struct stat buf;
 
-	decoder = malloc(sizeof *decoder);
+	decoder = calloc(1, sizeof *decoder);
 	if (decoder == NULL)
 		return NULL;
 
@@ -127,14 +726,25 @@ wcap_decoder_create(const char *filename)
 
 	fstat(decoder->fd, &buf);
 	decoder->size = buf.st_size;
+	if (decoder->size < sizeof *header) {
+		fprintf(stderr, "file too short for a wcap header\n");
+		close(decoder->fd);
+		free(decoder);
+		return NULL;
+	}
+
 	decoder->map = mmap(NULL, decoder->size,
 			    PROT_READ, MAP_PRIVATE, decoder->fd, 0);
 	if (decoder->map == MAP_FAILED) {
 		fprintf(stderr, "mmap failed\n");
+		close(decoder->fd);
 		free(decoder);
 		return NULL;
 	}
 
+	/* decoding streams through the capture once */
+	madvise(decoder->map, decoder->size, MADV_SEQUENTIAL);
+
 	header = decoder->map;
 	decoder->format = header->format;
 	decoder->count = 0;
@@ -146,6 +756,8 @@ wcap_decoder_create(const char *filename)
 	frame_size = header->width * header->height * 4;
 	decoder->frame = malloc(frame_size);
 	if (decoder->frame == NULL) {
+		munmap(decoder->map, decoder->size);
+		close(decoder->fd);
 		free(decoder);
 		return NULL;
 	}
@@ -157,6 +769,9 @@ wcap_decoder_create(const char *filename)
 void
 wcap_decoder_destroy(struct wcap_decoder *decoder)
 {
+	if (decoder->pool)
+		pool_destroy(decoder->pool);
+	free(decoder->index);
 	munmap(decoder->map, decoder->size);
 	close(decoder->fd);
 	free(decoder->frame);
@@ -48,6 +48,17 @@ struct wcap_rectangle {
 	int32_t x1, y1, x2, y2;
 };
 
+/* Where a frame starts, as found by a first pass over the capture. The
+ * format has no key frames: every frame is a delta to the previous one,
+ * so decoding a frame still needs all the frames before it. */
+struct wcap_frame_index {
+	uint64_t offset;	/* of the wcap_frame_header */
+	uint32_t msecs;
+	uint32_t nrects;
+};
+
+struct wcap_worker_pool;
+
 struct wcap_decoder {
 	int fd;
 	size_t size;
@@ -57,10 +68,27 @@ struct wcap_decoder {
 	uint32_t msecs;
 	uint32_t count;
 	int width, height;
+
+	struct wcap_frame_index *index;	/* NULL until loaded */
+	uint32_t nframes;
+	struct wcap_worker_pool *pool;	/* NULL when single threaded */
 };
 
 int wcap_decoder_get_frame(struct wcap_decoder *decoder);
 struct wcap_decoder *wcap_decoder_create(const char *filename);
 void wcap_decoder_destroy(struct wcap_decoder *decoder);
 
+/* Decodes the rectangles of large frames on nthreads threads. */
+int wcap_decoder_set_threads(struct wcap_decoder *decoder, int nthreads);
+
+/* Builds the frame index, or reads it from cache_filename if that was
+ * written for this capture. A new index is saved to cache_filename,
+ * which may be NULL to not cache it. */
+int wcap_decoder_load_index(struct wcap_decoder *decoder,
+			    const char *cache_filename);
+
+/* Makes the given frame, counted from 0, the decoded one. Needs the
+ * index; going backwards decodes again from the first frame. */
+int wcap_decoder_seek(struct wcap_decoder *decoder, uint32_t frame);
+
 #endif